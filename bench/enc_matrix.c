@@ -0,0 +1,473 @@
+// bench/enc_matrix.c
+/*
+ * 编码配置矩阵基准：合成（或 --video-file 回放）源尽快（--realtime 时按名义帧率）喂给完整视频流水线，
+ * 逐个组合 分辨率 × 编码格式 × 码率控制 × 在途帧数 × sink 跑一遍，每个组合输出一行 CSV / JSON，
+ * 用来在选定量产参数之前、以及换固件 / SDK 之后对比（同一组参数两次输出可直接 diff）。
+ *
+ * 每行：
+ *   fps              尽快出帧时的输出帧率 = 该组合可持续帧率的上限（drops > 0 说明采集侧已经在丢帧）
+ *   cpu_<阶段>       各角色线程的 CPU 时间 / 墙钟时间（%，单核 = 100），
+ *                    other = 进程总 CPU 减去各角色（MPP 内部线程、主线程、日志线程）
+ *   raw_mbps         原始 NV12 帧速率（MB/s）
+ *   est_cpu_mbps     CPU 侧内存流量估计：repack 读写各一遍原始帧 + 码流拷进 slot（读写）再写出（读）
+ *   est_vpu_mbps     VPU 侧内存流量下限估计：输入帧读一遍 + 参考帧读一遍 + 重建帧写一遍 + 码流写出（MJPEG 只有输入与码流）
+ *   ddr_load         实测 DDR 负载：运行期间 /sys/class/devfreq/dmc/load 的平均值（%），没有该节点时为空
+ *   enc_*_ms         提交 -> 取到 packet 的 p50 / p99 / max；sink_wr_p99_ms 为单次写出（含背压等待）的 p99
+ *   e2e_p99_ms       采集 -> 首字节交给 sink 的 p99，只在 --realtime 时有意义（尽快出帧时源的 PTS 跑在时钟前面），否则为空
+ * 合成源自己写帧的流量不计入估计。CSV 第一行以 "# " 开头记录运行环境（构建目标、内核、机型、--tag），
+ * JSON 为每行一个对象，第一行 "type":"env"。
+ *
+ * 用法：enc_matrix [--sizes 720p,1080p,4k] [--codecs h264,h265] [--rc cbr,vbr] [--depths 1,2,4]
+ *                  [--sinks none,file,ts] [--frames n] [--fps n] [--bitrate bps] [--video-file f]
+ *                  [--realtime] [--out-dir dir] [--format csv|json] [--out file] [--tag label]
+ */
+#include "app_config.h"
+#include "av_stats.h"
+#include "encoder_mpp.h"
+#include "lat_hist.h"
+#include "log.h"
+#include "media_clock.h"
+#include "reactor.h"
+#include "rt_sched.h"
+#include "sink.h"
+#include "video_pipeline.h"
+
+#include <getopt.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+#ifndef RK_BUILD_TARGET
+#define RK_BUILD_TARGET "unknown"
+#endif
+
+#define MATRIX_MAX_ITEMS   8
+#define MATRIX_REF_BPS     4000000          // --bitrate 0：1080p 的码率，其他分辨率按像素数缩放
+#define DMC_LOAD_PATH      "/sys/class/devfreq/dmc/load"
+#define DMC_SAMPLE_US      100000
+
+typedef struct {
+    char        buf[128];
+    const char *item[MATRIX_MAX_ITEMS];
+    int         n;
+} MatrixList;
+
+typedef struct {
+    MatrixList   sizes, codecs, rcs, depths, sinks;
+    unsigned int frames;
+    int          fps, bitrate;
+    const char  *video_file;
+    const char  *out_dir;
+    const char  *out_path;
+    const char  *tag;
+    int          realtime;
+    int          json;
+} MatrixArgs;
+
+/* 一个组合的结果 */
+typedef struct {
+    int         width, height, depth, bitrate;
+    const char *size, *codec, *rc, *sink;
+    const char *status;          // "ok" / "skipped"（流水线启动失败，例如编码器不可用）
+    uint64_t    frames, drops, bytes;
+    double      sec, ddr_load;   // ddr_load < 0 = 不可用
+    double      cpu[RT_ROLE_COUNT], cpu_other, cpu_total;
+    LatHistSnap enc, e2e, sink_wr;
+} MatrixResult;
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "usage: %s [--sizes 720p,1080p,4k|WxH,...] [--codecs h264,h265] [--rc cbr,vbr,avbr,fixqp]\n"
+        "          [--depths 1,2,4] [--sinks none,file,async,ts] [--frames n] [--fps n] [--bitrate bps]\n"
+        "          [--video-file nv12] [--realtime] [--out-dir dir] [--format csv|json] [--out file] [--tag label]\n",
+        prog);
+}
+
+/* 逗号分隔的列表，最多 MATRIX_MAX_ITEMS 项。@return 0 成功；-1 为空或过长 */
+static int list_parse(MatrixList *l, const char *spec)
+{
+    if (!spec || strlen(spec) >= sizeof(l->buf)) return -1;
+    strcpy(l->buf, spec);
+    l->n = 0;
+    char *save = NULL;
+    for (char *tok = strtok_r(l->buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        if (l->n == MATRIX_MAX_ITEMS) return -1;
+        l->item[l->n++] = tok;
+    }
+    return l->n ? 0 : -1;
+}
+
+/* "720p" / "1080p" / "4k" / "WxH" -> 宽高。@return 0 成功；-1 格式错误 */
+static int size_parse(const char *s, int *w, int *h)
+{
+    if (strcmp(s, "720p") == 0)  { *w = 1280; *h = 720;  return 0; }
+    if (strcmp(s, "1080p") == 0) { *w = 1920; *h = 1080; return 0; }
+    if (strcmp(s, "4k") == 0)    { *w = 3840; *h = 2160; return 0; }
+    if (sscanf(s, "%dx%d", w, h) != 2 || *w <= 0 || *h <= 0) return -1;
+    return 0;
+}
+
+/* 先把所有列表项校验一遍，避免跑了一半才发现参数错误。@return 0 成功；-1 有非法项 */
+static int validate(const MatrixArgs *a)
+{
+    int w, h;
+    MppCodingType coding;
+    EncRcMode rc;
+    EncSinkType sink;
+    for (int i = 0; i < a->sizes.n; i++) {
+        if (size_parse(a->sizes.item[i], &w, &h) != 0) {
+            fprintf(stderr, "invalid size: %s\n", a->sizes.item[i]);
+            return -1;
+        }
+    }
+    for (int i = 0; i < a->codecs.n; i++) {
+        if (encoder_mpp_coding_from_name(a->codecs.item[i], &coding) != 0) {
+            fprintf(stderr, "invalid codec: %s\n", a->codecs.item[i]);
+            return -1;
+        }
+    }
+    for (int i = 0; i < a->rcs.n; i++) {
+        if (encoder_mpp_rc_from_name(a->rcs.item[i], &rc) != 0) {
+            fprintf(stderr, "invalid rc: %s\n", a->rcs.item[i]);
+            return -1;
+        }
+    }
+    for (int i = 0; i < a->depths.n; i++) {
+        int d = atoi(a->depths.item[i]);
+        if (d < 1 || d > 4) {
+            fprintf(stderr, "invalid depth: %s (1..4)\n", a->depths.item[i]);
+            return -1;
+        }
+    }
+    for (int i = 0; i < a->sinks.n; i++) {
+        if (enc_sink_type_from_name(a->sinks.item[i], &sink) != 0 ||
+            (sink != ENC_SINK_NONE && sink != ENC_SINK_FILE && sink != ENC_SINK_ASYNC_FILE &&
+             sink != ENC_SINK_TS_FILE)) {
+            fprintf(stderr, "invalid sink: %s (none, file, async, ts)\n", a->sinks.item[i]);
+            return -1;
+        }
+    }
+    if (a->video_file && a->sizes.n != 1) {
+        fprintf(stderr, "--video-file needs exactly one --sizes entry (the file's size)\n");
+        return -1;
+    }
+    return 0;
+}
+
+static int parse_args(MatrixArgs *a, int argc, char **argv)
+{
+    enum { O_SIZES = 1000, O_CODECS, O_RC, O_DEPTHS, O_SINKS, O_FRAMES, O_FPS, O_BITRATE,
+           O_VIDEO_FILE, O_REALTIME, O_OUT_DIR, O_FORMAT, O_OUT, O_TAG };
+    static const struct option opts[] = {
+        {"sizes",      required_argument, 0, O_SIZES},
+        {"codecs",     required_argument, 0, O_CODECS},
+        {"rc",         required_argument, 0, O_RC},
+        {"depths",     required_argument, 0, O_DEPTHS},
+        {"sinks",      required_argument, 0, O_SINKS},
+        {"frames",     required_argument, 0, O_FRAMES},
+        {"fps",        required_argument, 0, O_FPS},
+        {"bitrate",    required_argument, 0, O_BITRATE},
+        {"video-file", required_argument, 0, O_VIDEO_FILE},
+        {"realtime",   no_argument,       0, O_REALTIME},
+        {"out-dir",    required_argument, 0, O_OUT_DIR},
+        {"format",     required_argument, 0, O_FORMAT},
+        {"out",        required_argument, 0, O_OUT},
+        {"tag",        required_argument, 0, O_TAG},
+        {"help",       no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "h", opts, NULL)) != -1) {
+        switch (c) {
+        case O_SIZES:      if (list_parse(&a->sizes, optarg) != 0) return -1; break;
+        case O_CODECS:     if (list_parse(&a->codecs, optarg) != 0) return -1; break;
+        case O_RC:         if (list_parse(&a->rcs, optarg) != 0) return -1; break;
+        case O_DEPTHS:     if (list_parse(&a->depths, optarg) != 0) return -1; break;
+        case O_SINKS:      if (list_parse(&a->sinks, optarg) != 0) return -1; break;
+        case O_FRAMES:     a->frames = (unsigned int)atoi(optarg); break;
+        case O_FPS:        a->fps = atoi(optarg); break;
+        case O_BITRATE:    a->bitrate = atoi(optarg); break;
+        case O_VIDEO_FILE: a->video_file = optarg; break;
+        case O_REALTIME:   a->realtime = 1; break;
+        case O_OUT_DIR:    a->out_dir = optarg; break;
+        case O_FORMAT:
+            if (strcmp(optarg, "csv") == 0) a->json = 0;
+            else if (strcmp(optarg, "json") == 0) a->json = 1;
+            else return -1;
+            break;
+        case O_OUT:        a->out_path = optarg; break;
+        case O_TAG:        a->tag = optarg; break;
+        default:           return -1;
+        }
+    }
+    if (a->frames == 0 || a->fps <= 0 || a->bitrate < 0) return -1;
+    return validate(a);
+}
+
+/* ===================== 采样：DDR 负载 ===================== */
+
+typedef struct {
+    volatile sig_atomic_t stop;
+    double   sum;
+    unsigned n;
+} DmcSampler;
+
+/* "35@1056000000Hz"：@ 前为负载百分比。@return 负载；-1 不可用 */
+static int dmc_load_read(void)
+{
+    FILE *fp = fopen(DMC_LOAD_PATH, "r");
+    if (!fp) return -1;
+    int load = -1;
+    if (fscanf(fp, "%d", &load) != 1) load = -1;
+    fclose(fp);
+    return load;
+}
+
+static void *dmc_thread(void *arg)
+{
+    DmcSampler *s = (DmcSampler *)arg;
+    while (!s->stop) {
+        int load = dmc_load_read();
+        if (load >= 0) {
+            s->sum += load;
+            s->n++;
+        }
+        usleep(DMC_SAMPLE_US);
+    }
+    return NULL;
+}
+
+/* ===================== 一个组合 ===================== */
+
+static int64_t process_cpu_us(void)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (int64_t)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000 + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+/*
+ * 跑一个组合，结果写入 r（r 的配置字段由调用者填好）。
+ * @return 0 成功；1 跳过（流水线启动失败）；-1 失败
+ */
+static int run_one(const MatrixArgs *a, MatrixResult *r)
+{
+    static AvStats stats;
+    av_stats_init(&stats);
+
+    Reactor reactor = { .stop_fd = -1 };
+    if (reactor_init(&reactor, &stats) != 0) return -1;
+
+    EncSinkType sink_type = ENC_SINK_FILE;
+    enc_sink_type_from_name(r->sink, &sink_type);
+    char out[512];
+    snprintf(out, sizeof(out), "%s/enc_matrix.%s", a->out_dir,
+             sink_type == ENC_SINK_TS_FILE ? "ts" : r->codec);
+
+    AppConfig cfg;
+    app_config_load_default(&cfg);
+    cfg.width        = r->width;
+    cfg.height       = r->height;
+    cfg.fps          = a->fps;
+    cfg.bitrate      = r->bitrate;
+    cfg.codec        = r->codec;
+    cfg.rc_mode      = r->rc;
+    cfg.enc_depth    = r->depth;
+    cfg.sink_type    = r->sink;
+    cfg.video_src    = a->video_file ? "replay" : "synthetic";
+    cfg.video_file   = a->video_file;
+    cfg.src_realtime = a->realtime;
+    cfg.output_path_h264 = out;
+    /* 流水线按 sec * fps 计算目标帧数 */
+    cfg.duration_sec = (a->frames + (unsigned int)a->fps - 1) / (unsigned int)a->fps;
+
+    uint64_t role0[RT_ROLE_COUNT], role1[RT_ROLE_COUNT];
+    rt_sched_cpu_usage(role0);
+    int64_t cpu0 = process_cpu_us();
+
+    DmcSampler dmc = { .stop = 0 };
+    pthread_t th_dmc;
+    int dmc_started = pthread_create(&th_dmc, NULL, dmc_thread, &dmc) == 0;
+
+    volatile sig_atomic_t stop = 0;
+    VideoPipeline vp;
+    int64_t t0 = media_clock_now_us();
+    int ret = 0;
+    if (video_pipeline_start(&vp, &cfg, &stats, &stop, &reactor, NULL, NULL) != 0) {
+        r->status = "skipped";
+        ret = 1;
+    } else {
+        video_pipeline_join(&vp);   // 全部流水线线程在这里退出，CPU 时间已计入各角色
+        r->status = "ok";
+    }
+    int64_t wall_us = media_clock_now_us() - t0;
+    int64_t cpu_us  = process_cpu_us() - cpu0;
+    rt_sched_cpu_usage(role1);
+
+    dmc.stop = 1;
+    if (dmc_started) pthread_join(th_dmc, NULL);
+    r->ddr_load = dmc.n ? dmc.sum / dmc.n : -1.0;
+
+    r->sec    = (double)wall_us / 1e6;
+    r->frames = atomic_load(&stats.video_frames);
+    r->drops  = atomic_load(&stats.drop_count);
+    r->bytes  = atomic_load(&stats.enc_bytes);
+    double wall = wall_us > 0 ? (double)wall_us : 1.0;
+    double roles = 0;
+    for (int i = 0; i < RT_ROLE_COUNT; i++) {
+        r->cpu[i] = (double)(role1[i] - role0[i]) * 100.0 / wall;
+        roles += r->cpu[i];
+    }
+    r->cpu_total = (double)cpu_us * 100.0 / wall;
+    r->cpu_other = r->cpu_total > roles ? r->cpu_total - roles : 0.0;
+    lat_hist_drain(&stats.hist[AV_HIST_ENCODE], &r->enc);
+    lat_hist_drain(&stats.hist[AV_HIST_FIRST_BYTE], &r->e2e);
+    lat_hist_drain(&stats.hist[AV_HIST_SINK_WRITE], &r->sink_wr);
+
+    reactor_close(&reactor);
+    return ret;
+}
+
+/* ===================== 输出 ===================== */
+
+/* 读一行文本文件（去掉末尾换行，设备树字符串末尾的 NUL 也一并截断）；读不到时为 "unknown" */
+static void read_line(const char *path, char *buf, size_t cap)
+{
+    snprintf(buf, cap, "unknown");
+    FILE *fp = fopen(path, "r");
+    if (!fp) return;
+    if (fgets(buf, (int)cap, fp)) buf[strcspn(buf, "\r\n")] = 0;
+    fclose(fp);
+}
+
+static void print_env(FILE *fp, const MatrixArgs *a)
+{
+    struct utsname u;
+    if (uname(&u) != 0) snprintf(u.release, sizeof(u.release), "unknown");
+    char model[128];
+    read_line("/proc/device-tree/model", model, sizeof(model));
+    int dmc = dmc_load_read() >= 0;
+    if (a->json) {
+        fprintf(fp, "{\"type\":\"env\",\"tag\":\"%s\",\"build\":\"%s\",\"kernel\":\"%s\",\"model\":\"%s\","
+                    "\"ddr_load\":%s,\"frames\":%u,\"fps\":%d,\"src\":\"%s\",\"rate\":\"%s\"}\n",
+                a->tag, RK_BUILD_TARGET, u.release, model, dmc ? "true" : "false", a->frames, a->fps,
+                a->video_file ? "replay" : "synthetic", a->realtime ? "realtime" : "fast");
+        return;
+    }
+    fprintf(fp, "# tag=%s build=%s kernel=%s model=%s ddr_load=%s frames=%u fps=%d src=%s rate=%s\n",
+            a->tag, RK_BUILD_TARGET, u.release, model, dmc ? "yes" : "no", a->frames, a->fps,
+            a->video_file ? "replay" : "synthetic", a->realtime ? "realtime" : "fast");
+    fprintf(fp, "tag,size,codec,rc,depth,sink,bitrate,status,frames,drops,sec,fps,out_mbps,raw_mbps,"
+                "est_cpu_mbps,est_vpu_mbps,ddr_load,cpu_capture,cpu_encode,cpu_sink,cpu_other,cpu_total,"
+                "enc_p50_ms,enc_p99_ms,enc_max_ms,e2e_p99_ms,sink_wr_p99_ms\n");
+}
+
+static double ms(uint64_t us)
+{
+    return (double)us / 1000.0;
+}
+
+static void print_result(FILE *fp, const MatrixArgs *a, const MatrixResult *r)
+{
+    double sec = r->sec > 0 ? r->sec : 1.0;
+    double raw = (double)r->width * r->height * 1.5 * (double)r->frames;
+    double out = (double)r->bytes;
+    int    ref = strcmp(r->codec, "mjpeg") != 0 && strcmp(r->codec, "jpeg") != 0;
+    double fps      = (double)r->frames / sec;
+    double out_mbps = out / sec / 1e6;
+    double raw_mbps = raw / sec / 1e6;
+    double cpu_mbps = (raw * 2 + out * 3) / sec / 1e6;
+    double vpu_mbps = (raw * (ref ? 3 : 1) + out) / sec / 1e6;
+    double enc_p50  = ms(lat_hist_percentile(&r->enc, 0.50));
+    double enc_p99  = ms(lat_hist_percentile(&r->enc, 0.99));
+    double wr_p99   = ms(lat_hist_percentile(&r->sink_wr, 0.99));
+    char ddr[16] = "";
+    if (r->ddr_load >= 0) snprintf(ddr, sizeof(ddr), "%.1f", r->ddr_load);
+    char e2e[16] = "";
+    if (a->realtime) snprintf(e2e, sizeof(e2e), "%.3f", ms(lat_hist_percentile(&r->e2e, 0.99)));
+
+    if (a->json) {
+        fprintf(fp, "{\"type\":\"result\",\"tag\":\"%s\",\"size\":\"%s\",\"width\":%d,\"height\":%d,"
+                    "\"codec\":\"%s\",\"rc\":\"%s\",\"depth\":%d,\"sink\":\"%s\",\"bitrate\":%d,\"status\":\"%s\","
+                    "\"frames\":%llu,\"drops\":%llu,\"sec\":%.3f,\"fps\":%.1f,\"out_mbps\":%.2f,\"raw_mbps\":%.1f,"
+                    "\"est_cpu_mbps\":%.1f,\"est_vpu_mbps\":%.1f,\"ddr_load\":%s,"
+                    "\"cpu\":{\"capture\":%.1f,\"encode\":%.1f,\"sink\":%.1f,\"other\":%.1f,\"total\":%.1f},"
+                    "\"enc_ms\":{\"p50\":%.3f,\"p99\":%.3f,\"max\":%.3f},\"e2e_p99_ms\":%s,\"sink_wr_p99_ms\":%.3f}\n",
+                a->tag, r->size, r->width, r->height, r->codec, r->rc, r->depth, r->sink, r->bitrate, r->status,
+                (unsigned long long)r->frames, (unsigned long long)r->drops, r->sec, fps, out_mbps, raw_mbps,
+                cpu_mbps, vpu_mbps, ddr[0] ? ddr : "null",
+                r->cpu[RT_ROLE_CAPTURE], r->cpu[RT_ROLE_ENCODE], r->cpu[RT_ROLE_SINK], r->cpu_other, r->cpu_total,
+                enc_p50, enc_p99, ms(r->enc.max), e2e[0] ? e2e : "null", wr_p99);
+    } else {
+        fprintf(fp, "%s,%s,%s,%s,%d,%s,%d,%s,%llu,%llu,%.3f,%.1f,%.2f,%.1f,%.1f,%.1f,%s,%.1f,%.1f,%.1f,%.1f,%.1f,"
+                    "%.3f,%.3f,%.3f,%s,%.3f\n",
+                a->tag, r->size, r->codec, r->rc, r->depth, r->sink, r->bitrate, r->status,
+                (unsigned long long)r->frames, (unsigned long long)r->drops, r->sec, fps, out_mbps, raw_mbps,
+                cpu_mbps, vpu_mbps, ddr,
+                r->cpu[RT_ROLE_CAPTURE], r->cpu[RT_ROLE_ENCODE], r->cpu[RT_ROLE_SINK], r->cpu_other, r->cpu_total,
+                enc_p50, enc_p99, ms(r->enc.max), e2e, wr_p99);
+    }
+    fflush(fp);   // 中途中断时已跑完的组合不丢
+}
+
+int main(int argc, char **argv)
+{
+    MatrixArgs a = {
+        .frames = 300, .fps = 30, .bitrate = 0,
+        .video_file = NULL, .out_dir = "/tmp", .out_path = NULL, .tag = "-", .realtime = 0, .json = 0,
+    };
+    list_parse(&a.sizes, "720p,1080p,4k");
+    list_parse(&a.codecs, "h264,h265");
+    list_parse(&a.rcs, "cbr,vbr");
+    list_parse(&a.depths, "1,2,4");
+    list_parse(&a.sinks, "none,file");
+    if (parse_args(&a, argc, argv) != 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    FILE *fp = stdout;
+    if (a.out_path && !(fp = fopen(a.out_path, "w"))) {
+        fprintf(stderr, "open %s failed\n", a.out_path);
+        return 1;
+    }
+    media_clock_init();
+    log_init();   // 流水线日志走 stderr，结果写 stdout / --out
+
+    print_env(fp, &a);
+    int rc = 0, ok = 0, total = 0;
+    for (int si = 0; si < a.sizes.n; si++)
+    for (int ci = 0; ci < a.codecs.n; ci++)
+    for (int ri = 0; ri < a.rcs.n; ri++)
+    for (int di = 0; di < a.depths.n; di++)
+    for (int ki = 0; ki < a.sinks.n; ki++) {
+        static MatrixResult r;
+        memset(&r, 0, sizeof(r));
+        r.size  = a.sizes.item[si];
+        r.codec = a.codecs.item[ci];
+        r.rc    = a.rcs.item[ri];
+        r.depth = atoi(a.depths.item[di]);
+        r.sink  = a.sinks.item[ki];
+        size_parse(r.size, &r.width, &r.height);
+        r.bitrate = a.bitrate ? a.bitrate
+                  : (int)((double)MATRIX_REF_BPS * r.width * r.height / (1920.0 * 1080.0));
+        int ret = run_one(&a, &r);
+        if (ret < 0) {
+            rc = 1;
+            continue;
+        }
+        print_result(fp, &a, &r);
+        total++;
+        if (ret == 0) ok++;
+    }
+    if (fp != stdout) fclose(fp);
+    fprintf(stderr, "enc_matrix: %d/%d combinations ran%s\n", ok, total,
+            ok ? "" : " (encoder not available?)");
+    return rc;
+}
@@ -0,0 +1,299 @@
+// bench/pipeline_bench.c
+/*
+ * 无硬件的吞吐基准：不需要摄像头 / 声卡，可以在裸板或 CI 上跑，用来发现吞吐回退。
+ *
+ *   encode : 合成（或 --video-file 回放）NV12 源 -> 完整视频流水线（repack / MPP 异步编码 / 写出）
+ *            默认尽快出帧，得到编码路径的帧率上限；需要 MPP，编码器不可用时跳过
+ *   sink   : 按码率生成的假 AU（每 GOP 一个 4 倍大小的关键帧）+ 20ms PCM 段，
+ *            尽快写入各个 sink，测写出路径本身的吞吐和单次写延迟（含背压等待）
+ *
+ * 用法：pipeline_bench [--frames n] [--size WxH] [--fps n] [--bitrate bps] [--video-file f]
+ *                      [--sinks file,async,ts] [--out-dir dir] [--realtime] [--no-encode] [--no-sink]
+ */
+#include "app_config.h"
+#include "av_stats.h"
+#include "lat_hist.h"
+#include "log.h"
+#include "media_clock.h"
+#include "reactor.h"
+#include "sink.h"
+#include "video_pipeline.h"
+
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_AUDIO_MS 20
+
+typedef struct {
+    unsigned int frames;
+    int          width, height, fps, bitrate;
+    const char  *video_file;
+    const char  *sinks;
+    const char  *out_dir;
+    int          realtime;
+    int          run_encode, run_sink;
+} BenchArgs;
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "usage: %s [--frames n] [--size WxH] [--fps n] [--bitrate bps] [--video-file nv12]\n"
+        "          [--sinks file,async,ts] [--out-dir dir] [--realtime] [--no-encode] [--no-sink]\n",
+        prog);
+}
+
+static int parse_args(BenchArgs *a, int argc, char **argv)
+{
+    enum { O_FRAMES = 1000, O_SIZE, O_FPS, O_BITRATE, O_VIDEO_FILE, O_SINKS, O_OUT_DIR,
+           O_REALTIME, O_NO_ENCODE, O_NO_SINK };
+    static const struct option opts[] = {
+        {"frames",     required_argument, 0, O_FRAMES},
+        {"size",       required_argument, 0, O_SIZE},
+        {"fps",        required_argument, 0, O_FPS},
+        {"bitrate",    required_argument, 0, O_BITRATE},
+        {"video-file", required_argument, 0, O_VIDEO_FILE},
+        {"sinks",      required_argument, 0, O_SINKS},
+        {"out-dir",    required_argument, 0, O_OUT_DIR},
+        {"realtime",   no_argument,       0, O_REALTIME},
+        {"no-encode",  no_argument,       0, O_NO_ENCODE},
+        {"no-sink",    no_argument,       0, O_NO_SINK},
+        {"help",       no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "h", opts, NULL)) != -1) {
+        switch (c) {
+        case O_FRAMES:     a->frames = (unsigned int)atoi(optarg); break;
+        case O_SIZE:
+            if (sscanf(optarg, "%dx%d", &a->width, &a->height) != 2) return -1;
+            break;
+        case O_FPS:        a->fps = atoi(optarg); break;
+        case O_BITRATE:    a->bitrate = atoi(optarg); break;
+        case O_VIDEO_FILE: a->video_file = optarg; break;
+        case O_SINKS:      a->sinks = optarg; break;
+        case O_OUT_DIR:    a->out_dir = optarg; break;
+        case O_REALTIME:   a->realtime = 1; break;
+        case O_NO_ENCODE:  a->run_encode = 0; break;
+        case O_NO_SINK:    a->run_sink = 0; break;
+        default:           return -1;
+        }
+    }
+    if (a->frames == 0 || a->width <= 0 || a->height <= 0 || a->fps <= 0 || a->bitrate <= 0) return -1;
+    return 0;
+}
+
+/* 一行分布：n avg p50 p99 max（时间类换算为 ms） */
+static void print_dist(const char *name, const LatHistSnap *h, int is_time)
+{
+    double k = is_time ? 1000.0 : 1.0;
+    printf("  %-9s n=%-7llu avg=%-8.3f p50=%-8.3f p99=%-8.3f max=%-8.3f%s\n", name,
+           (unsigned long long)h->count,
+           h->count ? (double)h->sum / (double)h->count / k : 0.0,
+           (double)lat_hist_percentile(h, 0.50) / k,
+           (double)lat_hist_percentile(h, 0.99) / k,
+           (double)h->max / k,
+           is_time ? " ms" : "");
+}
+
+/* ===================== Encode path ===================== */
+
+static int bench_encode(const BenchArgs *a)
+{
+    static AvStats stats;
+    static LatHistSnap snap;
+    av_stats_init(&stats);
+
+    Reactor reactor = { .stop_fd = -1 };
+    if (reactor_init(&reactor, &stats) != 0) return -1;
+
+    char out[512];
+    snprintf(out, sizeof(out), "%s/bench_encode.h264", a->out_dir);
+
+    AppConfig cfg;
+    app_config_load_default(&cfg);
+    cfg.width        = a->width;
+    cfg.height       = a->height;
+    cfg.fps          = a->fps;
+    cfg.bitrate      = a->bitrate;
+    cfg.video_src    = a->video_file ? "replay" : "synthetic";
+    cfg.video_file   = a->video_file;
+    cfg.src_realtime = a->realtime;
+    cfg.output_path_h264 = out;
+    /* 流水线按 sec * fps 计算目标帧数 */
+    cfg.duration_sec = (a->frames + (unsigned int)a->fps - 1) / (unsigned int)a->fps;
+
+    volatile sig_atomic_t stop = 0;
+    VideoPipeline vp;
+    int64_t t0 = media_clock_now_us();
+    if (video_pipeline_start(&vp, &cfg, &stats, &stop, &reactor, NULL, NULL) != 0) {
+        printf("encode: skipped (pipeline start failed, encoder not available?)\n");
+        reactor_close(&reactor);
+        return 1;
+    }
+    video_pipeline_join(&vp);
+    double sec = (double)(media_clock_now_us() - t0) / 1e6;
+
+    uint64_t frames = atomic_load(&stats.video_frames);
+    uint64_t bytes  = atomic_load(&stats.enc_bytes);
+    printf("encode: %s %dx%d@%d bitrate=%d %s frames=%llu drops=%llu\n",
+           cfg.video_src, a->width, a->height, a->fps, a->bitrate,
+           a->realtime ? "realtime" : "fast",
+           (unsigned long long)frames, (unsigned long long)atomic_load(&stats.drop_count));
+    printf("  throughput: %.1f frames/s  %.2f MB/s out  %.1f MB/s raw in  (%.2f s)\n",
+           (double)frames / sec, (double)bytes / sec / 1e6,
+           (double)frames * a->width * a->height * 1.5 / sec / 1e6, sec);
+    for (int i = 0; i < AV_HIST_COUNT; i++) {
+        if (i == AV_HIST_AUDIO_READ || i == AV_HIST_AUDIO_ENC) continue;
+        lat_hist_drain(&stats.hist[i], &snap);
+        if (snap.count) print_dist(av_stats_hist_name((AvHistId)i), &snap, av_stats_hist_is_time((AvHistId)i));
+    }
+
+    reactor_close(&reactor);
+    return 0;
+}
+
+/* ===================== Sink path ===================== */
+
+static uint32_t xorshift(uint32_t *s)
+{
+    uint32_t x = *s;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *s = x;
+}
+
+/* 写一个单元，背压时等待重试；返回写入耗时（微秒），失败返回 -1 */
+static int64_t timed_write(EncSink *s, const uint8_t *data, size_t len, const EncSinkMeta *meta)
+{
+    int64_t t0 = media_clock_now_us();
+    int ret;
+    while ((ret = enc_sink_write_ex(s, data, len, meta)) == 1) {
+        if (enc_sink_wait_writable(s, len, 1000) < 0) return -1;
+    }
+    if (ret != 0) return -1;
+    return media_clock_now_us() - t0;
+}
+
+static int bench_sink(const BenchArgs *a, const char *name)
+{
+    EncSinkType type;
+    if (enc_sink_type_from_name(name, &type) != 0 || type == ENC_SINK_NONE || type == ENC_SINK_PIPE_FFMPEG) {
+        printf("sink %s: skipped (unsupported in bench)\n", name);
+        return 1;
+    }
+
+    static AvStats stats;
+    static LatHist hist;
+    static LatHistSnap snap;
+    av_stats_init(&stats);
+    lat_hist_init(&hist);
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/bench_sink_%s.%s", a->out_dir, name,
+             type == ENC_SINK_TS_FILE ? "ts" : "bin");
+
+    EncSink sink;
+    enc_sink_init(&sink, type, path);
+    SinkAsyncOpts aopts;
+    sink_async_default_opts(&aopts);
+    aopts.stats = &stats;
+    enc_sink_set_async_opts(&sink, &aopts);
+    TsMuxStreams st = { .video = 1, .audio_rate = 48000, .audio_channels = 2 };
+    enc_sink_set_ts_streams(&sink, &st);
+    if (enc_sink_open(&sink) != 0) {
+        printf("sink %s: open %s failed\n", name, path);
+        return -1;
+    }
+
+    /* 平均帧大小按码率；GOP = 2 × fps，关键帧为平均大小的 4 倍 */
+    size_t avg = (size_t)a->bitrate / 8 / (size_t)a->fps;
+    unsigned int gop = 2 * (unsigned int)a->fps;
+    size_t p_len = avg * gop / (gop + 3);
+    size_t i_len = p_len * 4;
+    uint8_t *au = (uint8_t *)malloc(i_len);
+    size_t pcm_len = 48000 / (1000 / BENCH_AUDIO_MS) * 4;
+    uint8_t *pcm = (uint8_t *)calloc(1, pcm_len);
+    if (!au || !pcm) {
+        free(au);
+        free(pcm);
+        enc_sink_close(&sink);
+        return -1;
+    }
+    uint32_t seed = 0x12345678u;
+    for (size_t i = 0; i < i_len; i++) au[i] = (uint8_t)xorshift(&seed);
+
+    uint64_t bytes = 0, failed = 0;
+    int64_t  audio_pts = 0, frame_us = 1000000 / a->fps;
+    int64_t  t0 = media_clock_now_us();
+    for (unsigned int f = 0; f < a->frames; f++) {
+        int64_t pts = (int64_t)f * frame_us;
+        /* 音频按 PTS 交织在视频之间 */
+        while (audio_pts <= pts) {
+            EncSinkMeta am = { .stream = ENC_STREAM_AUDIO, .pts_us = audio_pts, .keyframe = 0 };
+            int64_t us = timed_write(&sink, pcm, pcm_len, &am);
+            if (us < 0) failed++;
+            else bytes += pcm_len;
+            audio_pts += BENCH_AUDIO_MS * 1000;
+        }
+        int key = (f % gop) == 0;
+        size_t len = key ? i_len : p_len;
+        EncSinkMeta vm = { .stream = ENC_STREAM_VIDEO, .pts_us = pts, .keyframe = key };
+        int64_t us = timed_write(&sink, au, len, &vm);
+        if (us < 0) {
+            failed++;
+            continue;
+        }
+        lat_hist_record(&hist, (uint64_t)us);
+        bytes += len;
+    }
+    int64_t t_close = media_clock_now_us();
+    enc_sink_close(&sink);   // 异步 sink 在这里排空写线程
+    int64_t t1 = media_clock_now_us();
+    double sec = (double)(t1 - t0) / 1e6;
+
+    printf("sink %s: %s frames=%u failed=%llu\n", name, path, a->frames, (unsigned long long)failed);
+    printf("  throughput: %.1f frames/s  %.2f MB/s  (%.3f s, close/flush %.1f ms)\n",
+           (double)a->frames / sec, (double)bytes / sec / 1e6, sec, (double)(t1 - t_close) / 1000.0);
+    lat_hist_drain(&hist, &snap);
+    print_dist("video_wr", &snap, 1);
+    uint64_t bp = atomic_load(&stats.sink_backpressure);
+    if (type == ENC_SINK_ASYNC_FILE)
+        printf("  async: backpressure=%llu fill_max=%lluKB batch_wr_max=%.1f ms\n",
+               (unsigned long long)bp, (unsigned long long)(atomic_load(&stats.sink_fill_max) >> 10),
+               (double)atomic_load(&stats.sink_write_max_us) / 1000.0);
+
+    free(au);
+    free(pcm);
+    return failed ? -1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    BenchArgs a = {
+        .frames = 600, .width = 1280, .height = 720, .fps = 30, .bitrate = 2000000,
+        .video_file = NULL, .sinks = "file,async,ts", .out_dir = "/tmp",
+        .realtime = 0, .run_encode = 1, .run_sink = 1,
+    };
+    if (parse_args(&a, argc, argv) != 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    media_clock_init();
+    log_init();   // 与主程序一样由输出线程写日志，热路径上的日志不计入被测耗时
+
+    int rc = 0;
+    if (a.run_encode && bench_encode(&a) < 0) rc = 1;
+
+    if (a.run_sink) {
+        char list[256];
+        snprintf(list, sizeof(list), "%s", a.sinks);
+        for (char *save = NULL, *tok = strtok_r(list, ",", &save); tok; tok = strtok_r(NULL, ",", &save))
+            if (bench_sink(&a, tok) < 0) rc = 1;
+    }
+    return rc;
+}
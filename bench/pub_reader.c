@@ -0,0 +1,202 @@
+// bench/pub_reader.c
+/*
+ * 共享内存分发（--pub-sock）的读者基准：连上正在运行的 rkav_repro，按读者统计收到的包 / 原始帧、
+ * 交付延迟（采集时刻 -> 读者拿到，含编码）与被覆盖的次数。--slow-ms 让每个包之后睡一会儿，
+ * 模拟跟不上的读者，用来确认慢读者只会自己丢、不影响录制（对照 rkav_repro 的 STAT 行）。
+ *
+ * 用法：pub_reader --sock path [--readers n] [--sec n] [--raw] [--slow-ms n] [--out file]
+ *   --out 只写第一个读者收到的包（例如 .h264，可以直接用 ffprobe 检查）
+ */
+#include "lat_hist.h"
+#include "shm_pub.h"
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PUB_READER_MAX   SHM_PUB_MAX_READERS
+#define PUB_READER_BUF   (4u << 20)
+
+typedef struct {
+    const char  *sock;
+    int          readers;
+    int          sec;
+    int          raw;
+    int          slow_ms;
+    const char  *out;
+} ReaderArgs;
+
+typedef struct {
+    const ReaderArgs *a;
+    int               id;
+    uint64_t          packets, bytes, keyframes, too_big;
+    uint64_t          frames, torn;
+    uint64_t          drops, raw_missed;
+    LatHist           pkt_lat, raw_lat;
+    int               ret;
+} ReaderCtx;
+
+static int64_t mono_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+        "usage: %s --sock path [--readers n] [--sec n] [--raw] [--slow-ms n] [--out file]\n", prog);
+}
+
+static int parse_args(ReaderArgs *a, int argc, char **argv)
+{
+    enum { O_SOCK = 1000, O_READERS, O_SEC, O_RAW, O_SLOW_MS, O_OUT };
+    static const struct option opts[] = {
+        {"sock",    required_argument, 0, O_SOCK},
+        {"readers", required_argument, 0, O_READERS},
+        {"sec",     required_argument, 0, O_SEC},
+        {"raw",     no_argument,       0, O_RAW},
+        {"slow-ms", required_argument, 0, O_SLOW_MS},
+        {"out",     required_argument, 0, O_OUT},
+        {"help",    no_argument,       0, 'h'},
+        {0, 0, 0, 0}
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "h", opts, NULL)) != -1) {
+        switch (c) {
+        case O_SOCK:    a->sock = optarg; break;
+        case O_READERS: a->readers = atoi(optarg); break;
+        case O_SEC:     a->sec = atoi(optarg); break;
+        case O_RAW:     a->raw = 1; break;
+        case O_SLOW_MS: a->slow_ms = atoi(optarg); break;
+        case O_OUT:     a->out = optarg; break;
+        default:        return -1;
+        }
+    }
+    if (!a->sock || a->readers < 1 || a->readers > PUB_READER_MAX || a->sec <= 0 || a->slow_ms < 0) return -1;
+    return 0;
+}
+
+/* 原始帧：读一遍 Y 平面（模拟分析模型取数），读完核对版本号 */
+static void read_frame(ReaderCtx *r, ShmSub *s, int64_t base_us)
+{
+    ShmSubFrame f;
+    if (shm_sub_frame_begin(s, &f) != 0) return;
+    lat_hist_record(&r->raw_lat, (uint64_t)(mono_us() - (f.pts_us + base_us)));
+    volatile uint32_t sum = 0;
+    for (unsigned int y = 0; y < f.height; y += 8) sum += f.y[(size_t)y * f.y_stride];
+    if (shm_sub_frame_end(s, &f) != 0) r->torn++;
+    r->frames++;
+}
+
+static void *reader_thread(void *arg)
+{
+    ReaderCtx *r = (ReaderCtx *)arg;
+    const ReaderArgs *a = r->a;
+    ShmSub s;
+    r->ret = -1;
+    if (shm_sub_open(&s, a->sock, a->raw) != 0) return NULL;
+
+    uint8_t *buf = (uint8_t *)malloc(PUB_READER_BUF);
+    FILE *fp = (r->id == 0 && a->out) ? fopen(a->out, "wb") : NULL;
+    if (!buf) {
+        shm_sub_close(&s);
+        return NULL;
+    }
+
+    int64_t base_us = s.hdr->clock_base_us;
+    int64_t end_us  = mono_us() + (int64_t)a->sec * 1000000;
+    int closed = 0;
+    while (!closed && mono_us() < end_us) {
+        ShmSubPacket pkt;
+        int ret;
+        while ((ret = shm_sub_read_packet(&s, buf, PUB_READER_BUF, &pkt)) != 1) {
+            if (ret < 0) {
+                if (pkt.len == 0) {
+                    closed = 1;   // 发布者已关闭
+                    break;
+                }
+                r->too_big++;
+                continue;
+            }
+            lat_hist_record(&r->pkt_lat, (uint64_t)(mono_us() - (pkt.pts_us + base_us)));
+            r->packets++;
+            r->bytes += pkt.len;
+            r->keyframes += (uint64_t)pkt.keyframe;
+            if (fp) fwrite(buf, 1, pkt.len, fp);
+            if (a->slow_ms) {
+                struct timespec ts = { .tv_sec = a->slow_ms / 1000, .tv_nsec = (long)(a->slow_ms % 1000) * 1000000L };
+                nanosleep(&ts, NULL);
+            }
+            if (a->raw) read_frame(r, &s, base_us);
+        }
+        if (a->raw) read_frame(r, &s, base_us);
+        if (!closed && shm_sub_wait(&s, 100) < 0) closed = 1;
+    }
+
+    r->drops      = s.drops;
+    r->raw_missed = s.raw_missed;
+    r->ret        = 0;
+    if (fp) fclose(fp);
+    free(buf);
+    shm_sub_close(&s);
+    return NULL;
+}
+
+/* 一行分布：n avg p50 p99 max（ms） */
+static void print_dist(const char *name, LatHist *h)
+{
+    LatHistSnap snap;
+    lat_hist_drain(h, &snap);
+    printf("  %-8s n=%-7llu avg=%-8.3f p50=%-8.3f p99=%-8.3f max=%-8.3f ms\n", name,
+           (unsigned long long)snap.count,
+           snap.count ? (double)snap.sum / (double)snap.count / 1000.0 : 0.0,
+           (double)lat_hist_percentile(&snap, 0.50) / 1000.0,
+           (double)lat_hist_percentile(&snap, 0.99) / 1000.0,
+           (double)snap.max / 1000.0);
+}
+
+int main(int argc, char **argv)
+{
+    ReaderArgs a = { .readers = 1, .sec = 10 };
+    if (parse_args(&a, argc, argv) != 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    static ReaderCtx ctx[PUB_READER_MAX];
+    pthread_t th[PUB_READER_MAX];
+    int started = 0;
+    for (int i = 0; i < a.readers; i++) {
+        ctx[i].a  = &a;
+        ctx[i].id = i;
+        lat_hist_init(&ctx[i].pkt_lat);
+        lat_hist_init(&ctx[i].raw_lat);
+        if (pthread_create(&th[i], NULL, reader_thread, &ctx[i]) != 0) break;
+        started++;
+    }
+
+    int rc = started == a.readers ? 0 : 1;
+    for (int i = 0; i < started; i++) {
+        pthread_join(th[i], NULL);
+        ReaderCtx *r = &ctx[i];
+        if (r->ret != 0) {
+            printf("reader %d: connect %s failed\n", i, a.sock);
+            rc = 1;
+            continue;
+        }
+        printf("reader %d: packets=%llu (key %llu) %.1f kbps drops=%llu too_big=%llu | raw frames=%llu missed=%llu torn=%llu\n",
+               i, (unsigned long long)r->packets, (unsigned long long)r->keyframes,
+               (double)r->bytes * 8.0 / 1000.0 / (double)a.sec, (unsigned long long)r->drops,
+               (unsigned long long)r->too_big, (unsigned long long)r->frames,
+               (unsigned long long)r->raw_missed, (unsigned long long)r->torn);
+        print_dist("pkt_lat", &r->pkt_lat);
+        if (a.raw) print_dist("raw_lat", &r->raw_lat);
+    }
+    return rc;
+}
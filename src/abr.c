@@ -0,0 +1,133 @@
+// abr.c
+#include "abr.h"
+#include "log.h"
+
+#include <string.h>
+
+#define TAG "abr"
+
+void abr_default_opts(AbrOpts *o)
+{
+    if (!o) return;
+    memset(o, 0, sizeof(*o));
+    o->down_pct      = 25;
+    o->up_pct        = 10;
+    o->fill_high_pct = 50;
+    o->fill_low_pct  = 15;
+    o->up_windows    = 5;
+    o->hold_windows  = 3;
+}
+
+static int clamp_bps(const AbrOpts *o, int64_t bps)
+{
+    if (bps < o->min_bps) return o->min_bps;
+    if (bps > o->max_bps) return o->max_bps;
+    return (int)bps;
+}
+
+int abr_init(AbrController *a, const AbrOpts *o)
+{
+    if (!a || !o || o->min_bps <= 0 || o->min_bps > o->max_bps) return -1;
+    memset(a, 0, sizeof(*a));
+    a->o = *o;
+    if (a->o.down_pct == 0 || a->o.down_pct >= 100) a->o.down_pct = 25;
+    if (a->o.up_pct == 0) a->o.up_pct = 10;
+    if (a->o.fill_low_pct >= a->o.fill_high_pct) a->o.fill_low_pct = a->o.fill_high_pct / 2;
+    if (a->o.up_windows == 0) a->o.up_windows = 1;
+    a->cur_bps = clamp_bps(&a->o, o->start_bps > 0 ? o->start_bps : o->max_bps);
+
+    LOGI("[%s] range %d..%d bps, start %d, down %u%% / up %u%% after %u idle windows, fill %u..%u%%",
+         TAG, a->o.min_bps, a->o.max_bps, a->cur_bps, a->o.down_pct, a->o.up_pct,
+         a->o.up_windows, a->o.fill_low_pct, a->o.fill_high_pct);
+    return 0;
+}
+
+/* 积压占容量的百分比；cap 为 0 时不参与 */
+static unsigned int fill_pct(uint64_t used, uint64_t cap)
+{
+    if (!cap) return 0;
+    uint64_t p = used * 100 / cap;
+    return p > 1000 ? 1000 : (unsigned int)p;
+}
+
+/*
+ * 最拥挤的一项及其名称（用于日志）。
+ * 推流延迟扣除观测到的最低值：批量写管道与封装带来的固定延迟不随码率变化，不算积压。
+ */
+static unsigned int worst_fill(AbrController *a, const AvStatsWindow *w, const char **what)
+{
+    const AbrOpts *o = &a->o;
+    if (w->net_lat_us && (!a->lat_floor_us || w->net_lat_us < a->lat_floor_us))
+        a->lat_floor_us = w->net_lat_us;
+    uint64_t lat = w->net_lat_us > a->lat_floor_us ? w->net_lat_us - a->lat_floor_us : 0;
+    uint64_t budget = o->net_latency_us > (int64_t)a->lat_floor_us
+                    ? (uint64_t)o->net_latency_us - a->lat_floor_us : 0;
+
+    unsigned int best = 0;
+    *what = "-";
+    struct { const char *name; unsigned int pct; } k[] = {
+        { "sink_fill", fill_pct(w->sink_fill, o->sink_ring_bytes) },
+        { "net_q",     fill_pct(w->net_q, o->net_queue_bytes) },
+        { "net_lat",   fill_pct(lat, budget) },
+        { "q_sink",    fill_pct(w->q_sink, o->pkt_slots) },
+    };
+    for (size_t i = 0; i < sizeof(k) / sizeof(k[0]); i++) {
+        if (k[i].pct > best) {
+            best  = k[i].pct;
+            *what = k[i].name;
+        }
+    }
+    return best;
+}
+
+AbrDecision abr_update(AbrController *a, const AvStatsWindow *w, int *bps)
+{
+    if (!a || !w) return ABR_HOLD;
+
+    const AbrOpts *o = &a->o;
+    const char *what;
+    unsigned int fill = worst_fill(a, w, &what);
+    int hard = w->drops || w->sink_bp || w->net_drop;
+    int hold = a->hold_left > 0;
+    if (a->hold_left) a->hold_left--;
+
+    int64_t next = a->cur_bps;
+    const char *why = NULL;
+    if (hard) {
+        if (!hold) {
+            next = (int64_t)a->cur_bps * (100 - o->down_pct) / 100;
+            why  = w->net_drop ? "net_drop" : w->sink_bp ? "sink_bp" : "drops";
+        }
+    } else if (fill >= o->fill_high_pct) {
+        if (!hold) {
+            next = (int64_t)a->cur_bps * (100 - o->down_pct / 2) / 100;
+            why  = what;
+        }
+    } else if (fill <= o->fill_low_pct) {
+        if (++a->idle_windows >= o->up_windows) {
+            next = (int64_t)a->cur_bps * (100 + o->up_pct) / 100;
+            why  = "idle";
+        }
+    }
+    if (hard || fill > o->fill_low_pct) a->idle_windows = 0;
+
+    int nb = clamp_bps(o, next);
+    if (!why || nb == a->cur_bps) return ABR_HOLD;
+
+    AbrDecision d = nb < a->cur_bps ? ABR_DOWN : ABR_UP;
+    LOGI("[%s] %s %d -> %d bps (%s: fill=%u%% drops=%llu sink_bp=%llu net_drop=%llu)", TAG,
+         d == ABR_DOWN ? "down" : "up", a->cur_bps, nb, why, fill,
+         (unsigned long long)w->drops, (unsigned long long)w->sink_bp,
+         (unsigned long long)w->net_drop);
+
+    a->cur_bps = nb;
+    a->idle_windows = 0;
+    if (d == ABR_DOWN) {
+        a->hold_left = o->hold_windows;
+        a->downs++;
+    } else {
+        a->ups++;
+    }
+    if (bps) *bps = nb;
+    return d;
+}
@@ -0,0 +1,78 @@
+// abr.h
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "av_stats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 自适应码率：每个统计窗口（约 1 秒）根据下游积压与丢弃调整编码器的 rc:bps_target。
+ *
+ * 信号（均取自 AvStatsWindow）：
+ * - 硬拥塞：drop_count / sink_bp（异步 sink 背压）/ net_drop（推流丢 GOP）非零
+ *   -> 按 down_pct 降码率；
+ * - 软拥塞：积压比例（异步环 / 推流队列 / 推流延迟 / 写出队列深度，取最大者）超过 fill_high_pct
+ *   -> 按 down_pct 的一半降码率；
+ * - 任何一次下降后 hold_windows 个窗口内不再下降：丢弃与积压的统计比码率变化滞后一个窗口
+ *   （丢掉的 GOP 在后一个窗口里才计入 drop_count），等新码率生效、积压排空后再判断；
+ * - 空闲：积压低于 fill_low_pct 且无丢弃，连续 up_windows 个窗口后按 up_pct 升码率；
+ * - 介于两者之间：保持，并重新开始计数空闲窗口。
+ * 快降慢升 + 两个阈值之间的死区构成滞回，避免在临界带宽上来回振荡。
+ */
+
+typedef struct {
+    int          min_bps;
+    int          max_bps;
+    int          start_bps;       // 初始码率（编码器启动时的码率），夹在 [min, max] 内
+
+    unsigned int down_pct;        // 硬拥塞时每次下降的百分比，默认 25
+    unsigned int up_pct;          // 每次上升的百分比，默认 10
+    unsigned int fill_high_pct;   // 积压比例高于此值视为软拥塞，默认 50
+    unsigned int fill_low_pct;    // 积压比例低于此值视为空闲，默认 15
+    unsigned int up_windows;      // 连续空闲多少个窗口才升码率，默认 5
+    unsigned int hold_windows;    // 每次降码率后的观察期（窗口数），默认 3
+
+    /* 积压比例的分母；0 表示该项不参与 */
+    size_t       sink_ring_bytes; // 异步 sink 环大小
+    size_t       net_queue_bytes; // 推流发送队列大小
+    int64_t      net_latency_us;  // 推流延迟预算（超过观测到的最低延迟的部分才算积压）
+    unsigned int pkt_slots;       // 编码 -> 写出队列容量
+} AbrOpts;
+
+typedef enum {
+    ABR_HOLD = 0,
+    ABR_DOWN,
+    ABR_UP,
+} AbrDecision;
+
+typedef struct {
+    AbrOpts      o;
+    int          cur_bps;
+    unsigned int idle_windows;    // 连续空闲窗口数
+    unsigned int hold_left;       // 剩余观察期窗口数
+    uint64_t     lat_floor_us;    // 观测到的最低推流延迟（批量写、封装等固有部分）
+    uint64_t     downs;
+    uint64_t     ups;
+} AbrController;
+
+void abr_default_opts(AbrOpts *o);
+
+/*
+ * @return  0 成功；-1 参数非法（min > max 或 min <= 0）
+ */
+int  abr_init(AbrController *a, const AbrOpts *o);
+
+/*
+ * 输入一个统计窗口，返回决策；DOWN / UP 时 *bps 为新的目标码率（调用者负责下发给编码器）。
+ * 每个非 HOLD 决策打印一行 [abr] 日志，注明触发信号。
+ */
+AbrDecision abr_update(AbrController *a, const AvStatsWindow *w, int *bps);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,12 +1,19 @@
 // app_config.c
 #include "app_config.h"
+#include "encoder_mpp.h"
 #include "log.h"
+#include "sink.h"
+#include "v4l2_capture.h"
+#include "video_pipeline.h"
 
+#include <errno.h>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <getopt.h>
 
+#include <linux/videodev2.h>
+
 /*
  * 解析形如 "WxH" 的分辨率字符串（例如 "1920x1080"）。
  *
@@ -26,6 +33,124 @@ static int parse_size(const char *s, int *w, int *h)
     return 0;
 }
 
+/*
+ * 解析 --sink-sync 取值。
+ *
+ * @return  0 成功；-1 未知取值
+ */
+static int parse_sync_mode(const char *s, SinkSyncMode *mode)
+{
+    if (!s || !mode) return -1;
+    if (strcmp(s, "none") == 0)      { *mode = SINK_SYNC_NONE;      return 0; }
+    if (strcmp(s, "range") == 0)     { *mode = SINK_SYNC_RANGE;     return 0; }
+    if (strcmp(s, "fdatasync") == 0) { *mode = SINK_SYNC_FDATASYNC; return 0; }
+    return -1;
+}
+
+/*
+ * 编码格式与输出 sink 的组合校验：TS（含推流、事件片段）只封装 H.264 / H.265（MJPEG 没有对应的 stream_type）。
+ *
+ * @return  0 合法；-1 非法
+ */
+static int check_codec_sink(MppCodingType type, EncSinkType st)
+{
+    if (enc_sink_type_is_muxed(st) && type == MPP_VIDEO_CodingMJPEG)
+        return -1;
+    return 0;
+}
+
+/*
+ * 解析一段 --simulcast："WxH[,bitrate=N][,codec=h264|h265|mjpeg][,sink=file|async|ts|pipe][,out=path|url]"。
+ * 字符串复制一份保存（配置生命周期内不释放），默认值与合法性在 parse_args 末尾统一处理。
+ *
+ * @return  0 成功；-1 格式错误
+ */
+static int parse_simulcast(const char *arg, AppSimulcast *sc)
+{
+    char *dup = strdup(arg);
+    if (!dup) return -1;
+
+    memset(sc, 0, sizeof(*sc));
+    char *save = NULL;
+    char *tok = strtok_r(dup, ",", &save);
+    int ok = tok && parse_size(tok, &sc->width, &sc->height) == 0;
+
+    while (ok && (tok = strtok_r(NULL, ",", &save)) != NULL) {
+        char *val = strchr(tok, '=');
+        if (!val) {
+            ok = 0;
+            break;
+        }
+        *val++ = '\0';
+        if (strcmp(tok, "bitrate") == 0)    sc->bitrate = atoi(val);
+        else if (strcmp(tok, "codec") == 0) sc->codec = val;
+        else if (strcmp(tok, "sink") == 0)  sc->sink_type = val;
+        else if (strcmp(tok, "out") == 0)   sc->output = val;
+        else ok = 0;
+    }
+    if (!ok) {
+        free(dup);
+        memset(sc, 0, sizeof(*sc));
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * 补齐一路子码流的默认值并校验。
+ *
+ * @return  0 成功；-1 非法组合
+ */
+static int finish_simulcast(const AppConfig *cfg, AppSimulcast *sc)
+{
+    if ((sc->width & 1) || (sc->height & 1)) {
+        LOGE("[CFG] simulcast %dx%d: width/height must be even", sc->width, sc->height);
+        return -1;
+    }
+    MppCodingType type = MPP_VIDEO_CodingAVC;
+    if (sc->codec && encoder_mpp_coding_from_name(sc->codec, &type) != 0) {
+        LOGE("[CFG] simulcast %dx%d: invalid codec %s", sc->width, sc->height, sc->codec);
+        return -1;
+    }
+    sc->codec = encoder_mpp_coding_name(type);   // 统一成规范名（也用作默认扩展名）
+    if (!sc->sink_type) sc->sink_type = "file";
+    EncSinkType st;
+    if (enc_sink_type_from_name(sc->sink_type, &st) != 0) {
+        LOGE("[CFG] simulcast %dx%d: invalid sink %s", sc->width, sc->height, sc->sink_type);
+        return -1;
+    }
+    if (check_codec_sink(type, st) != 0) {
+        LOGE("[CFG] simulcast %dx%d: sink %s requires codec h264 or h265",
+             sc->width, sc->height, sc->sink_type);
+        return -1;
+    }
+    if (st == ENC_SINK_EVENT) {
+        LOGE("[CFG] simulcast %dx%d: sink event is only supported on the main stream", sc->width, sc->height);
+        return -1;
+    }
+    if ((cfg->segment_sec || cfg->segment_mb) && st != ENC_SINK_FILE && st != ENC_SINK_TS_FILE) {
+        LOGE("[CFG] simulcast %dx%d: segmented recording requires sink file or ts", sc->width, sc->height);
+        return -1;
+    }
+    if (st == ENC_SINK_PIPE_FFMPEG && !sc->output) {
+        LOGE("[CFG] simulcast %dx%d: sink pipe requires out=<url>", sc->width, sc->height);
+        return -1;
+    }
+    if (!sc->output) {
+        char name[64];
+        snprintf(name, sizeof(name), "out_%dx%d.%s", sc->width, sc->height,
+                 st == ENC_SINK_TS_FILE ? "ts" : sc->codec);
+        sc->output = strdup(name);
+        if (!sc->output) return -1;
+    }
+    if (sc->bitrate <= 0) {
+        /* 按面积等比例换算，下限 200kbps */
+        int64_t bps = (int64_t)cfg->bitrate * sc->width * sc->height / ((int64_t)cfg->width * cfg->height);
+        sc->bitrate = bps < 200000 ? 200000 : (int)bps;
+    }
+    return 0;
+}
+
 /*
  * 加载默认配置。
  *
@@ -45,16 +170,78 @@ int app_config_load_default(AppConfig *cfg) //预设默认值
     cfg->height       = 720;
     cfg->fps          = 30;
     cfg->bitrate      = 2000000;   // 2Mbps default
+    cfg->codec        = "h264";
+    cfg->rc_mode      = "cbr";
+    cfg->gop          = 0;         // 2 × fps
+    cfg->qp           = 0;
+    cfg->abr          = 0;
+    cfg->abr_min      = 0;         // bitrate / 4
+    cfg->abr_max      = 0;         // bitrate
+    cfg->v4l2_bufs    = 0;         // V4L2_DEFAULT_BUFS
     cfg->v4l2_fourcc  = 0;         // auto
+    cfg->v4l2_io      = "mmap";
+    cfg->drop_policy  = "none";    // 不主动丢帧，与之前的行为一致
+    cfg->drop_depth   = VP_DROP_DEPTH_DEFAULT;
+    cfg->motion          = "off";
+    cfg->motion_thresh   = MOTION_THRESH_DEFAULT;
+    cfg->motion_area     = MOTION_AREA_DEFAULT;
+    cfg->motion_hold_ms  = MOTION_HOLD_DEFAULT;
+    cfg->motion_idle_fps = 1;
+    cfg->motion_idle_pct = 25;
+    cfg->pub_sock        = NULL;
+    cfg->pub_ring_kb     = SHM_PUB_RING_KB_DEFAULT;
+    cfg->pub_raw_fps     = 0;
+    cfg->pub_raw_slots   = SHM_PUB_RAW_SLOTS_DEFAULT;
+    cfg->zero_copy    = 0;         // 默认走拷贝路径（兼容只支持 NV12M 的驱动）
+    cfg->enc_depth    = 2;         // 2 帧在途：VPU 编码当前帧时 CPU 处理上一帧 packet
+    cfg->enc_slices   = 0;
+    cfg->video_src    = "v4l2";
+    cfg->video_file   = NULL;
+    cfg->src_realtime = 1;
 
     cfg->audio_device   = "hw:0,0";
     cfg->sample_rate    = 48000;
     cfg->channels       = 2;
     cfg->audio_chunk_ms = 20;
+    cfg->audio_src      = "alsa";
+    cfg->audio_file     = NULL;
+    cfg->audio_period   = AUDIO_CAPTURE_PERIOD_FRAMES;
+    cfg->audio_buffer   = 0;
+    cfg->audio_mmap     = 0;
+    cfg->audio_ring     = 0;
+    cfg->audio_codec    = "pcm";
+    cfg->audio_bitrate  = 0;
+    cfg->audio_gain_db  = 0.0f;
+    cfg->audio_out_ch   = 0;
 
     cfg->sink_type        = "file";
+    cfg->sink_ring_kb     = 8192;      // 8MB：2Mbps 下约 30 秒的磁盘抖动缓冲
+    cfg->sink_sync        = "range";
+    cfg->sink_sync_kb     = 4096;
     cfg->output_path_h264 = "out.h264";
     cfg->output_path_pcm  = "out.pcm";
+    cfg->output_path_ts   = "out.ts";
+    cfg->stream_url        = NULL;
+    cfg->stream_latency_ms = 200;
+    cfg->ffmpeg_path       = "ffmpeg";
+    cfg->output_path_event = "event_%Y%m%d-%H%M%S.ts";
+    cfg->event_pre_sec     = 10;
+    cfg->event_post_sec    = 5;
+    cfg->event_ring_kb     = 0;        // 按码率与 GOP 估算
+    cfg->event_sock        = NULL;
+    cfg->standby           = 0;
+    cfg->segment_sec       = 0;
+    cfg->segment_mb        = 0;
+    cfg->segment_keep      = 0;
+    cfg->rt_prio           = NULL;
+    cfg->cpu_affinity      = NULL;
+    cfg->mlock             = 0;
+    cfg->mem_budget_mb     = 0;
+    cfg->hugepages         = "off";
+    cfg->channels_file     = NULL;
+    cfg->vpu_slots         = 0;
+    cfg->stats_json        = NULL;
+    cfg->metrics           = NULL;
     cfg->duration_sec     = 10;
 
     return 0;
@@ -74,18 +261,109 @@ void app_config_print_usage(const char *prog) //当用户传 -h/--help 或者遇
         "  --video-dev <path>       Video device node (default: /dev/video0)\n"
         "  --size <WxH>             Capture size (default: 1280x720)\n"
         "  --fps <n>                Capture fps (default: 30)\n"
-        "  --bitrate <bps>          H.264 target bitrate (default: 2000000)\n"
+        "  --bitrate <bps>          Target bitrate (default: 2000000)\n"
+        "  --codec <name>           Encoder: h264 | h265 | mjpeg (default: h264)\n"
+        "  --rc <mode>              Rate control: cbr | vbr | avbr | fixqp (default: cbr)\n"
+        "  --gop <n>                I-frame interval in frames (default: 2 x fps)\n"
+        "  --qp <n>                 QP for --rc fixqp / quality factor 1..99 for mjpeg (default: encoder)\n"
+        "  --abr                    Adapt the main stream bitrate to sink backlog and drops\n"
+        "  --abr-min <bps>          Lower bound for --abr (default: bitrate / 4)\n"
+        "  --abr-max <bps>          Upper bound for --abr (default: bitrate)\n"
+        "  --zero-copy              Import V4L2 DMABUF into MPP, no CPU copy (needs NV12 single-plane)\n"
+        "  --enc-depth <n>          Frames in flight in the async encoder, 1..4 (default: 2)\n"
+        "  --enc-slices <n>         Low-latency mode: split each frame into n slices (2..16) and write\n"
+        "                           each slice as soon as it is encoded (default: 0 = whole frames)\n"
+        "  --v4l2-bufs <n>          V4L2 capture buffers, 2..32 (default: 8; synthetic/replay: 4)\n"
+        "  --v4l2-fmt <fmt>         Capture format: auto | nv12 | nv12m | yuyv (default: auto;\n"
+        "                           yuyv is converted to NV12 on dequeue, no --zero-copy)\n"
+        "  --v4l2-io <mode>         Capture buffer memory: mmap | userptr | dmabuf (default: mmap;\n"
+        "                           dmabuf allocates from " V4L2_DMA_HEAP_PATH ")\n"
+        "  --drop-policy <p>        When encode falls behind: none | newest | oldest | latest (default: none)\n"
+        "  --drop-depth <n>         Queued frames per stream before newest/oldest start dropping (default: 2)\n"
+        "  --motion <mode>          Static-scene gate: off | skip | rate (default: off; skip encodes only\n"
+        "                           --motion-idle-fps while idle, rate lowers bitrate to --motion-idle-pct)\n"
+        "  --motion-thresh <n>      Mean luma difference of a 128x128 block that counts as change (default: 10)\n"
+        "  --motion-area <pct>      Changed blocks that count as motion, 1..100 (default: 1)\n"
+        "  --motion-hold <ms>       Stay active this long after the last motion (default: 2000)\n"
+        "  --motion-idle-fps <n>    Frames kept per second while idle, 0 = none (default: 1)\n"
+        "  --motion-idle-pct <pct>  Bitrate while idle for --motion rate, 1..100 (default: 25)\n"
+        "  --pub-sock <path>        Publish encoded packets (and raw frames) to local readers over shared memory\n"
+        "  --pub-ring-kb <n>        Shared packet ring size, 256..262144 (default: 4096)\n"
+        "  --pub-raw-fps <n>        Raw NV12 frames published per second, 0 = packets only (default: 0)\n"
+        "  --pub-raw-slots <n>      Raw frame buffers readers pick the latest from, 2..8 (default: 4)\n"
+        "  --video-src <src>        Video source: v4l2 | synthetic | replay (default: v4l2)\n"
+        "  --video-file <file>      NV12 frames (--size, tightly packed) for --video-src replay\n"
+        "  --simulcast <spec>       Extra encode of the same capture, repeatable (up to 3):\n"
+        "                           WxH[,bitrate=N][,codec=h264|h265|mjpeg][,sink=file|async|ts|pipe][,out=path|url]\n"
         "  --audio-dev <dev>        ALSA capture device (default: hw:0,0)\n"
         "  --sr <hz>                Audio sample rate (default: 48000)\n"
         "  --ch <n>                 Audio channels (default: 2)\n"
+        "  --audio-src <src>        Audio source: alsa | synthetic | replay (default: alsa)\n"
+        "  --audio-file <file>      S16LE interleaved PCM for --audio-src replay\n"
+        "  --audio-period <frames>  ALSA period size (default: 1024)\n"
+        "  --audio-buffer <n>       ALSA buffer size in periods (default: driver default)\n"
+        "  --audio-mmap             Capture with mmap access instead of readi\n"
+        "  --audio-ring <n>         Capture thread + lock-free ring of n periods in front of the writer (default: 0, off)\n"
+        "  --audio-codec <name>     Audio encoder: pcm | aac | opus (default: pcm; aac needs AAC=1, opus needs OPUS=1)\n"
+        "  --audio-bitrate <bps>    AAC / Opus bitrate (default: 64000 / 48000 per channel)\n"
+        "  --audio-gain-db <dB>     Gain applied before encoding, -60..18 (default: 0)\n"
+        "  --audio-out-ch <n>       Encoded channels: 1 downmixes to mono (default: same as --ch)\n"
+        "  --src-rate <mode>        Non-device sources: realtime | fast (default: realtime)\n"
         "  --sec <n>                Record duration seconds (default: 10)\n"
-        "  --out-h264 <file>        Output H.264 file (default: out.h264)\n"
-        "  --out-pcm <file>         Output PCM file (default: out.pcm)\n"
+        "  --out-h264 <file>        Output elementary stream file (default: out.<codec>)\n"
+        "  --out-pcm <file>         Output audio file (default: out.pcm, out.aac for --audio-codec aac)\n"
+        "  --out-ts <file>          Output MPEG-TS file for --sink ts (default: out.ts)\n"
+        "  --sink <type>            Output sink: file | async | ts | pipe | event (default: file)\n"
+        "  --sink-ring-kb <n>       Async sink ring size in KB (default: 8192)\n"
+        "  --sink-sync <mode>       Async sink sync pacing: none | range | fdatasync (default: range)\n"
+        "  --sink-sync-kb <n>       Async sink sync every n KB written (default: 4096)\n"
+        "  --stream-url <url>       Push target for --sink pipe (rtmp:// srt:// rtsp:// udp://)\n"
+        "  --stream-latency-ms <n>  Drop the oldest GOP once queued data is older than n ms (default: 200)\n"
+        "  --ffmpeg <path>          ffmpeg binary for --sink pipe (default: ffmpeg)\n"
+        "  --out-event <pattern>    Clip file name for --sink event, strftime pattern (default: event_%%Y%%m%%d-%%H%%M%%S.ts)\n"
+        "  --event-pre <sec>        --sink event: seconds kept in memory before a trigger (default: 10)\n"
+        "  --event-post <sec>       --sink event: seconds recorded after a trigger (default: 5)\n"
+        "  --event-ring-kb <n>      --sink event: pre-roll ring size in KB (default: from bitrate and GOP)\n"
+        "  --event-sock <path>      UNIX datagram socket accepting \"trigger\" (--sink event, SIGUSR1 always works)\n"
+        "                           and \"record start|stop\" (--standby, SIGUSR1 / SIGUSR2 always work)\n"
+        "  --standby                Keep capture and encoder running without writing; each \"record start\" opens a\n"
+        "                           new timestamped file and forces an IDR (sink file | async | ts)\n"
+        "  --segment-sec <n>        file / ts: start a new file every n seconds, cut on IDR (default: 0, off)\n"
+        "  --segment-mb <n>         file / ts: start a new file once a segment reaches n MB (default: 0, off)\n"
+        "  --segment-keep <n>       Keep only the newest n segments, delete older ones (default: 0, keep all)\n"
+        "  --rt-prio <spec>         SCHED_FIFO priority per thread role, e.g. capture=80,encode=70,sink=60,audio=85,stats=0\n"
+        "  --cpu-affinity <spec>    CPU list per thread role, e.g. capture=2,encode=2-3,sink=1,audio=3,stats=0 ('+' joins: 0+2)\n"
+        "  --mlock                  mlockall and pre-fault memory at startup (no page faults mid-frame)\n"
+        "  --mem-budget <MB>        Cap all pipeline buffers (arena + V4L2 / MPP ION buffers); startup fails\n"
+        "                           when the configuration does not fit (default: 0, no cap)\n"
+        "  --hugepages <mode>       Buffer arena pages: off | thp | hugetlb (hugetlb needs --mem-budget; default: off)\n"
+        "  --channels <file>        Run several cameras in one process, one \"<name> [options]\" line per channel;\n"
+        "                           a channel that fails is restarted without stopping the others\n"
+        "  --vpu-slots <n>          --channels: frames in flight on the VPU across all channels (default: channels + 1)\n"
+        "  --stats-json <file|->    Append one JSON stats line per second (histograms included)\n"
+        "  --metrics <[addr:]port>  Serve Prometheus metrics at http://addr:port/metrics (IPv4, default addr: all)\n"
         "  -h, --help               Show this help\n\n"
         "Examples:\n"
         "  %s --video-dev /dev/video0 --size 1920x1080 --fps 30 --bitrate 4000000 --sec 10\n"
-        "  %s --out-h264 out.h264 --out-pcm out.pcm --sec 10\n",
-        prog, prog, prog);
+        "  %s --out-h264 out.h264 --out-pcm out.pcm --sec 10\n"
+        "  %s --sink async --sink-sync range --sec 60\n"
+        "  %s --sink ts --out-ts out.ts --sec 10\n"
+        "  %s --sink pipe --stream-url srt://192.168.1.10:9000 --sec 0\n"
+        "  %s --video-src synthetic --audio-src synthetic --src-rate fast --sec 10\n"
+        "  %s --size 1920x1080 --simulcast 1280x720,bitrate=1500000 --simulcast 640x360,codec=h265\n"
+        "  %s --codec h265 --rc vbr --gop 60 --bitrate 3000000 --sink ts\n"
+        "  %s --sink pipe --stream-url srt://192.168.1.10:9000 --abr --abr-min 500000 --bitrate 4000000 --sec 0\n"
+        "  %s --sink ts --motion skip --motion-idle-fps 1 --motion-hold 3000 --sec 0\n"
+        "  %s --sink ts --pub-sock /tmp/rkav-pub.sock --pub-raw-fps 5 --sec 0\n"
+        "  %s --sink event --event-pre 10 --event-post 5 --event-sock /tmp/rkav.sock --sec 0\n"
+        "  %s --sink ts --segment-sec 600 --segment-keep 144 --sec 0\n"
+        "  %s --audio-mmap --audio-period 480 --audio-buffer 4 --audio-ring 64 --sink async --sec 0\n"
+        "  %s --sink ts --audio-codec aac --audio-bitrate 128000 --audio-gain-db 6\n"
+        "  %s --rt-prio capture=80,encode=70,audio=85 --cpu-affinity capture=3,encode=2-3,audio=1,stats=0 --mlock\n"
+        "  %s --channels cams.conf --sink ts --sec 0\n"
+        "  %s --standby --sink ts --out-ts cam.ts --event-sock /tmp/rkav.sock --sec 0\n",
+        prog, prog, prog, prog, prog, prog, prog, prog, prog, prog, prog, prog, prog, prog, prog, prog, prog, prog,
+        prog);
 }
 
 /*
@@ -115,12 +393,77 @@ int app_config_parse_args(AppConfig *cfg, int argc, char **argv)
         OPT_SIZE,
         OPT_FPS,
         OPT_BITRATE,
+        OPT_ZERO_COPY,
+        OPT_ENC_DEPTH,
+        OPT_ENC_SLICES,
         OPT_AUDIO_DEV,
         OPT_SR,
         OPT_CH,
         OPT_SEC,
         OPT_OUT_H264,
         OPT_OUT_PCM,
+        OPT_OUT_TS,
+        OPT_SINK,
+        OPT_SINK_RING_KB,
+        OPT_SINK_SYNC,
+        OPT_SINK_SYNC_KB,
+        OPT_STREAM_URL,
+        OPT_STREAM_LATENCY_MS,
+        OPT_FFMPEG,
+        OPT_STATS_JSON,
+        OPT_METRICS,
+        OPT_VIDEO_SRC,
+        OPT_VIDEO_FILE,
+        OPT_AUDIO_SRC,
+        OPT_AUDIO_FILE,
+        OPT_SRC_RATE,
+        OPT_SIMULCAST,
+        OPT_CODEC,
+        OPT_RC,
+        OPT_GOP,
+        OPT_QP,
+        OPT_ABR,
+        OPT_ABR_MIN,
+        OPT_ABR_MAX,
+        OPT_OUT_EVENT,
+        OPT_EVENT_PRE,
+        OPT_EVENT_POST,
+        OPT_EVENT_RING_KB,
+        OPT_EVENT_SOCK,
+        OPT_SEGMENT_SEC,
+        OPT_SEGMENT_MB,
+        OPT_SEGMENT_KEEP,
+        OPT_AUDIO_PERIOD,
+        OPT_AUDIO_BUFFER,
+        OPT_AUDIO_MMAP,
+        OPT_AUDIO_RING,
+        OPT_AUDIO_CODEC,
+        OPT_AUDIO_BITRATE,
+        OPT_AUDIO_GAIN_DB,
+        OPT_AUDIO_OUT_CH,
+        OPT_RT_PRIO,
+        OPT_CPU_AFFINITY,
+        OPT_MLOCK,
+        OPT_MEM_BUDGET,
+        OPT_HUGEPAGES,
+        OPT_CHANNELS,
+        OPT_VPU_SLOTS,
+        OPT_STANDBY,
+        OPT_V4L2_BUFS,
+        OPT_V4L2_FMT,
+        OPT_V4L2_IO,
+        OPT_DROP_POLICY,
+        OPT_DROP_DEPTH,
+        OPT_MOTION,
+        OPT_MOTION_THRESH,
+        OPT_MOTION_AREA,
+        OPT_MOTION_HOLD,
+        OPT_MOTION_IDLE_FPS,
+        OPT_MOTION_IDLE_PCT,
+        OPT_PUB_SOCK,
+        OPT_PUB_RING_KB,
+        OPT_PUB_RAW_FPS,
+        OPT_PUB_RAW_SLOTS,
     };
 
     /*
@@ -135,16 +478,83 @@ int app_config_parse_args(AppConfig *cfg, int argc, char **argv)
         {"size",      required_argument, 0, OPT_SIZE},
         {"fps",       required_argument, 0, OPT_FPS},
         {"bitrate",   required_argument, 0, OPT_BITRATE},
+        {"zero-copy", no_argument,       0, OPT_ZERO_COPY},
+        {"enc-depth", required_argument, 0, OPT_ENC_DEPTH},
+        {"enc-slices", required_argument, 0, OPT_ENC_SLICES},
+        {"v4l2-bufs",   required_argument, 0, OPT_V4L2_BUFS},
+        {"v4l2-fmt",    required_argument, 0, OPT_V4L2_FMT},
+        {"v4l2-io",     required_argument, 0, OPT_V4L2_IO},
+        {"drop-policy", required_argument, 0, OPT_DROP_POLICY},
+        {"drop-depth",  required_argument, 0, OPT_DROP_DEPTH},
+        {"motion",          required_argument, 0, OPT_MOTION},
+        {"motion-thresh",   required_argument, 0, OPT_MOTION_THRESH},
+        {"motion-area",     required_argument, 0, OPT_MOTION_AREA},
+        {"motion-hold",     required_argument, 0, OPT_MOTION_HOLD},
+        {"motion-idle-fps", required_argument, 0, OPT_MOTION_IDLE_FPS},
+        {"motion-idle-pct", required_argument, 0, OPT_MOTION_IDLE_PCT},
+        {"pub-sock",        required_argument, 0, OPT_PUB_SOCK},
+        {"pub-ring-kb",     required_argument, 0, OPT_PUB_RING_KB},
+        {"pub-raw-fps",     required_argument, 0, OPT_PUB_RAW_FPS},
+        {"pub-raw-slots",   required_argument, 0, OPT_PUB_RAW_SLOTS},
         {"audio-dev", required_argument, 0, OPT_AUDIO_DEV},
         {"sr",        required_argument, 0, OPT_SR},
         {"ch",        required_argument, 0, OPT_CH},
         {"sec",       required_argument, 0, OPT_SEC},
         {"out-h264",  required_argument, 0, OPT_OUT_H264},
         {"out-pcm",   required_argument, 0, OPT_OUT_PCM},
+        {"out-ts",    required_argument, 0, OPT_OUT_TS},
+        {"sink",         required_argument, 0, OPT_SINK},
+        {"sink-ring-kb", required_argument, 0, OPT_SINK_RING_KB},
+        {"sink-sync",    required_argument, 0, OPT_SINK_SYNC},
+        {"sink-sync-kb", required_argument, 0, OPT_SINK_SYNC_KB},
+        {"stream-url",        required_argument, 0, OPT_STREAM_URL},
+        {"stream-latency-ms", required_argument, 0, OPT_STREAM_LATENCY_MS},
+        {"ffmpeg",            required_argument, 0, OPT_FFMPEG},
+        {"stats-json",        required_argument, 0, OPT_STATS_JSON},
+        {"metrics",           required_argument, 0, OPT_METRICS},
+        {"video-src",  required_argument, 0, OPT_VIDEO_SRC},
+        {"video-file", required_argument, 0, OPT_VIDEO_FILE},
+        {"audio-src",  required_argument, 0, OPT_AUDIO_SRC},
+        {"audio-file", required_argument, 0, OPT_AUDIO_FILE},
+        {"audio-period", required_argument, 0, OPT_AUDIO_PERIOD},
+        {"audio-buffer", required_argument, 0, OPT_AUDIO_BUFFER},
+        {"audio-mmap",   no_argument,       0, OPT_AUDIO_MMAP},
+        {"audio-ring",   required_argument, 0, OPT_AUDIO_RING},
+        {"audio-codec",   required_argument, 0, OPT_AUDIO_CODEC},
+        {"audio-bitrate", required_argument, 0, OPT_AUDIO_BITRATE},
+        {"audio-gain-db", required_argument, 0, OPT_AUDIO_GAIN_DB},
+        {"audio-out-ch",  required_argument, 0, OPT_AUDIO_OUT_CH},
+        {"src-rate",   required_argument, 0, OPT_SRC_RATE},
+        {"simulcast",  required_argument, 0, OPT_SIMULCAST},
+        {"codec",      required_argument, 0, OPT_CODEC},
+        {"rc",         required_argument, 0, OPT_RC},
+        {"gop",        required_argument, 0, OPT_GOP},
+        {"qp",         required_argument, 0, OPT_QP},
+        {"abr",        no_argument,       0, OPT_ABR},
+        {"abr-min",    required_argument, 0, OPT_ABR_MIN},
+        {"abr-max",    required_argument, 0, OPT_ABR_MAX},
+        {"out-event",     required_argument, 0, OPT_OUT_EVENT},
+        {"event-pre",     required_argument, 0, OPT_EVENT_PRE},
+        {"event-post",    required_argument, 0, OPT_EVENT_POST},
+        {"event-ring-kb", required_argument, 0, OPT_EVENT_RING_KB},
+        {"event-sock",    required_argument, 0, OPT_EVENT_SOCK},
+        {"segment-sec",   required_argument, 0, OPT_SEGMENT_SEC},
+        {"segment-mb",    required_argument, 0, OPT_SEGMENT_MB},
+        {"segment-keep",  required_argument, 0, OPT_SEGMENT_KEEP},
+        {"rt-prio",       required_argument, 0, OPT_RT_PRIO},
+        {"cpu-affinity",  required_argument, 0, OPT_CPU_AFFINITY},
+        {"mlock",         no_argument,       0, OPT_MLOCK},
+        {"mem-budget",    required_argument, 0, OPT_MEM_BUDGET},
+        {"hugepages",     required_argument, 0, OPT_HUGEPAGES},
+        {"channels",      required_argument, 0, OPT_CHANNELS},
+        {"vpu-slots",     required_argument, 0, OPT_VPU_SLOTS},
+        {"standby",       no_argument,       0, OPT_STANDBY},
         {"help",      no_argument,       0, 'h'},
         {0,0,0,0}
     };
 
+    int out_set = 0;   // --out-h264 未指定时按 --codec 决定默认扩展名
+    int pcm_set = 0;   // --out-pcm 未指定时按 --audio-codec 决定默认扩展名
     int c;
     /*
      * 解析循环：
@@ -162,12 +572,101 @@ int app_config_parse_args(AppConfig *cfg, int argc, char **argv)
             break;
         case OPT_FPS:       cfg->fps = atoi(optarg); break;
         case OPT_BITRATE:   cfg->bitrate = atoi(optarg); break;
+        case OPT_ZERO_COPY: cfg->zero_copy = 1; break;
+        case OPT_ENC_DEPTH: cfg->enc_depth = atoi(optarg); break;
+        case OPT_ENC_SLICES: cfg->enc_slices = atoi(optarg); break;
+        case OPT_V4L2_BUFS: cfg->v4l2_bufs = atoi(optarg); break;
+        case OPT_V4L2_FMT:
+            if (v4l2_fourcc_from_name(optarg, &cfg->v4l2_fourcc) != 0) {
+                LOGE("[CFG] invalid --v4l2-fmt: %s", optarg);
+                return -1;
+            }
+            break;
+        case OPT_V4L2_IO:     cfg->v4l2_io = optarg; break;
+        case OPT_DROP_POLICY: cfg->drop_policy = optarg; break;
+        case OPT_DROP_DEPTH:  cfg->drop_depth = atoi(optarg); break;
+        case OPT_MOTION:          cfg->motion = optarg; break;
+        case OPT_MOTION_THRESH:   cfg->motion_thresh = atoi(optarg); break;
+        case OPT_MOTION_AREA:     cfg->motion_area = atoi(optarg); break;
+        case OPT_MOTION_HOLD:     cfg->motion_hold_ms = atoi(optarg); break;
+        case OPT_MOTION_IDLE_FPS: cfg->motion_idle_fps = atoi(optarg); break;
+        case OPT_MOTION_IDLE_PCT: cfg->motion_idle_pct = atoi(optarg); break;
+        case OPT_PUB_SOCK:        cfg->pub_sock = optarg; break;
+        case OPT_PUB_RING_KB:     cfg->pub_ring_kb = atoi(optarg); break;
+        case OPT_PUB_RAW_FPS:     cfg->pub_raw_fps = atoi(optarg); break;
+        case OPT_PUB_RAW_SLOTS:   cfg->pub_raw_slots = atoi(optarg); break;
         case OPT_AUDIO_DEV: cfg->audio_device = optarg; break;
         case OPT_SR:        cfg->sample_rate = (unsigned int)atoi(optarg); break;
         case OPT_CH:        cfg->channels = (unsigned int)atoi(optarg); break;
         case OPT_SEC:       cfg->duration_sec = (unsigned int)atoi(optarg); break;
-        case OPT_OUT_H264:  cfg->output_path_h264 = optarg; break;
-        case OPT_OUT_PCM:   cfg->output_path_pcm = optarg; break;
+        case OPT_OUT_H264:  cfg->output_path_h264 = optarg; out_set = 1; break;
+        case OPT_OUT_PCM:   cfg->output_path_pcm = optarg; pcm_set = 1; break;
+        case OPT_OUT_TS:    cfg->output_path_ts = optarg; break;
+        case OPT_SINK:         cfg->sink_type = optarg; break;
+        case OPT_SINK_RING_KB: cfg->sink_ring_kb = (unsigned int)atoi(optarg); break;
+        case OPT_SINK_SYNC:    cfg->sink_sync = optarg; break;
+        case OPT_SINK_SYNC_KB: cfg->sink_sync_kb = (unsigned int)atoi(optarg); break;
+        case OPT_STREAM_URL:        cfg->stream_url = optarg; break;
+        case OPT_STREAM_LATENCY_MS: cfg->stream_latency_ms = (unsigned int)atoi(optarg); break;
+        case OPT_FFMPEG:            cfg->ffmpeg_path = optarg; break;
+        case OPT_STATS_JSON:        cfg->stats_json = optarg; break;
+        case OPT_METRICS:           cfg->metrics = optarg; break;
+        case OPT_VIDEO_SRC:  cfg->video_src = optarg; break;
+        case OPT_VIDEO_FILE: cfg->video_file = optarg; break;
+        case OPT_AUDIO_SRC:  cfg->audio_src = optarg; break;
+        case OPT_AUDIO_FILE: cfg->audio_file = optarg; break;
+        case OPT_AUDIO_PERIOD: cfg->audio_period = (unsigned int)atoi(optarg); break;
+        case OPT_AUDIO_BUFFER: cfg->audio_buffer = (unsigned int)atoi(optarg); break;
+        case OPT_AUDIO_MMAP:   cfg->audio_mmap = 1; break;
+        case OPT_AUDIO_RING:   cfg->audio_ring = (unsigned int)atoi(optarg); break;
+        case OPT_AUDIO_CODEC:   cfg->audio_codec = optarg; break;
+        case OPT_AUDIO_BITRATE: cfg->audio_bitrate = (unsigned int)atoi(optarg); break;
+        case OPT_AUDIO_GAIN_DB: cfg->audio_gain_db = strtof(optarg, NULL); break;
+        case OPT_AUDIO_OUT_CH:  cfg->audio_out_ch = (unsigned int)atoi(optarg); break;
+        case OPT_SRC_RATE:
+            if (strcmp(optarg, "realtime") == 0) {
+                cfg->src_realtime = 1;
+            } else if (strcmp(optarg, "fast") == 0) {
+                cfg->src_realtime = 0;
+            } else {
+                LOGE("[CFG] invalid --src-rate: %s", optarg);
+                return -1;
+            }
+            break;
+        case OPT_SIMULCAST:
+            if (cfg->simulcast_count >= APP_MAX_SIMULCAST) {
+                LOGE("[CFG] too many --simulcast (max %d)", APP_MAX_SIMULCAST);
+                return -1;
+            }
+            if (parse_simulcast(optarg, &cfg->simulcast[cfg->simulcast_count]) != 0) {
+                LOGE("[CFG] invalid --simulcast: %s", optarg);
+                return -1;
+            }
+            cfg->simulcast_count++;
+            break;
+        case OPT_CODEC: cfg->codec = optarg; break;
+        case OPT_RC:    cfg->rc_mode = optarg; break;
+        case OPT_GOP:   cfg->gop = atoi(optarg); break;
+        case OPT_QP:    cfg->qp = atoi(optarg); break;
+        case OPT_ABR:     cfg->abr = 1; break;
+        case OPT_ABR_MIN: cfg->abr_min = atoi(optarg); break;
+        case OPT_ABR_MAX: cfg->abr_max = atoi(optarg); break;
+        case OPT_OUT_EVENT:     cfg->output_path_event = optarg; break;
+        case OPT_EVENT_PRE:     cfg->event_pre_sec = (unsigned int)atoi(optarg); break;
+        case OPT_EVENT_POST:    cfg->event_post_sec = (unsigned int)atoi(optarg); break;
+        case OPT_EVENT_RING_KB: cfg->event_ring_kb = (unsigned int)atoi(optarg); break;
+        case OPT_EVENT_SOCK:    cfg->event_sock = optarg; break;
+        case OPT_SEGMENT_SEC:   cfg->segment_sec = (unsigned int)atoi(optarg); break;
+        case OPT_SEGMENT_MB:    cfg->segment_mb = (unsigned int)atoi(optarg); break;
+        case OPT_SEGMENT_KEEP:  cfg->segment_keep = (unsigned int)atoi(optarg); break;
+        case OPT_RT_PRIO:       cfg->rt_prio = optarg; break;
+        case OPT_CPU_AFFINITY:  cfg->cpu_affinity = optarg; break;
+        case OPT_MLOCK:         cfg->mlock = 1; break;
+        case OPT_MEM_BUDGET:    cfg->mem_budget_mb = (unsigned int)atoi(optarg); break;
+        case OPT_HUGEPAGES:     cfg->hugepages = optarg; break;
+        case OPT_CHANNELS:      cfg->channels_file = optarg; break;
+        case OPT_VPU_SLOTS:     cfg->vpu_slots = atoi(optarg); break;
+        case OPT_STANDBY:       cfg->standby = 1; break;
         case 'h':
         default:
             /* -h/--help 或未知参数：打印用法并退出进程。 */
@@ -182,13 +681,652 @@ int app_config_parse_args(AppConfig *cfg, int argc, char **argv)
         LOGE("[CFG] invalid size: %dx%d", cfg->width, cfg->height);
         return -1;
     }
+    /* NV12 的 UV 为 2x2 子采样：奇数宽高会在 repack 时被截掉一行 / 一列，直接拒绝 */
+    if ((cfg->width & 1) || (cfg->height & 1)) {
+        LOGE("[CFG] invalid size: %dx%d (width/height must be even)", cfg->width, cfg->height);
+        return -1;
+    }
     if (cfg->bitrate <= 0) cfg->bitrate = 2000000;
+    if (cfg->enc_depth < 1) cfg->enc_depth = 1;
+    if (cfg->enc_depth > 4) cfg->enc_depth = 4;
     if (cfg->sample_rate == 0) cfg->sample_rate = 48000;
     if (cfg->channels == 0) cfg->channels = 2;
+    if (cfg->audio_period < 32 || cfg->audio_period > 16384) {
+        LOGE("[CFG] invalid --audio-period: %u (32..16384 frames)", cfg->audio_period);
+        return -1;
+    }
+    if (cfg->audio_buffer == 1) cfg->audio_buffer = 2;   // 至少两个 period，否则每次读都可能 overrun
+    if (cfg->audio_ring > 4096) cfg->audio_ring = 4096;
+
+    EncSinkType st;
+    if (enc_sink_type_from_name(cfg->sink_type, &st) != 0) {
+        LOGE("[CFG] invalid --sink: %s", cfg->sink_type);
+        return -1;
+    }
+    AudioCodec ac;
+    if (audio_enc_codec_from_name(cfg->audio_codec, &ac) != 0) {
+        LOGE("[CFG] invalid --audio-codec: %s", cfg->audio_codec);
+        return -1;
+    }
+    cfg->audio_codec = audio_enc_codec_name(ac);
+    if (!audio_enc_codec_available(ac)) {
+        LOGE("[CFG] --audio-codec %s not built in (make %s=1)", cfg->audio_codec,
+             ac == AUDIO_CODEC_AAC ? "AAC" : "OPUS");
+        return -1;
+    }
+    if (ac == AUDIO_CODEC_OPUS && !enc_sink_type_is_muxed(st)) {
+        /* 裸 Opus 包没有自定界的帧头，只能封装进 TS */
+        LOGE("[CFG] --audio-codec opus requires --sink ts, pipe or event");
+        return -1;
+    }
+    if (cfg->audio_out_ch && cfg->audio_out_ch != 1 && cfg->audio_out_ch != cfg->channels) {
+        LOGE("[CFG] invalid --audio-out-ch: %u (1 or --ch)", cfg->audio_out_ch);
+        return -1;
+    }
+    if (cfg->audio_out_ch == cfg->channels) cfg->audio_out_ch = 0;
+    if (cfg->audio_gain_db < -60.0f || cfg->audio_gain_db > 18.0f) {
+        LOGE("[CFG] invalid --audio-gain-db: %.1f (-60..18)", cfg->audio_gain_db);
+        return -1;
+    }
+    if (!pcm_set && ac == AUDIO_CODEC_AAC) cfg->output_path_pcm = "out.aac";
+    if (st == ENC_SINK_PIPE_FFMPEG && (!cfg->stream_url || !cfg->stream_url[0])) {
+        LOGE("[CFG] --sink pipe requires --stream-url");
+        return -1;
+    }
+    if (cfg->stream_latency_ms < 50) cfg->stream_latency_ms = 50;
+    if (st == ENC_SINK_EVENT && (!cfg->output_path_event || !cfg->output_path_event[0])) {
+        LOGE("[CFG] --sink event requires --out-event");
+        return -1;
+    }
+    if ((cfg->segment_sec || cfg->segment_mb) && st != ENC_SINK_FILE && st != ENC_SINK_TS_FILE) {
+        LOGE("[CFG] --segment-sec / --segment-mb require --sink file or ts");
+        return -1;
+    }
+
+    MppCodingType type;
+    if (encoder_mpp_coding_from_name(cfg->codec, &type) != 0) {
+        LOGE("[CFG] invalid --codec: %s", cfg->codec);
+        return -1;
+    }
+    cfg->codec = encoder_mpp_coding_name(type);
+    if (check_codec_sink(type, st) != 0) {
+        LOGE("[CFG] --sink %s requires --codec h264 or h265", cfg->sink_type);
+        return -1;
+    }
+    if (cfg->enc_slices == 1) cfg->enc_slices = 0;
+    if (cfg->enc_slices < 0 || cfg->enc_slices > 16) {
+        LOGE("[CFG] invalid --enc-slices: %d (2..16, 0 = off)", cfg->enc_slices);
+        return -1;
+    }
+    if (cfg->enc_slices && type == MPP_VIDEO_CodingMJPEG) {
+        LOGE("[CFG] --enc-slices requires --codec h264 or h265");
+        return -1;
+    }
+    if (cfg->enc_slices && st == ENC_SINK_EVENT) {
+        /* 预录环按整帧保存、按 GOP 回收，分片对事件片段也没有意义 */
+        LOGE("[CFG] --enc-slices is not supported with --sink event");
+        return -1;
+    }
+    if (!out_set) {
+        if (type == MPP_VIDEO_CodingHEVC)       cfg->output_path_h264 = "out.h265";
+        else if (type == MPP_VIDEO_CodingMJPEG) cfg->output_path_h264 = "out.mjpeg";
+    }
+    EncRcMode rc;
+    if (encoder_mpp_rc_from_name(cfg->rc_mode, &rc) != 0) {
+        LOGE("[CFG] invalid --rc: %s", cfg->rc_mode);
+        return -1;
+    }
+    if (cfg->gop < 0) cfg->gop = 0;
+    if (cfg->qp < 0 || cfg->qp > 99 || (type != MPP_VIDEO_CodingMJPEG && cfg->qp > 51)) {
+        LOGE("[CFG] invalid --qp: %d", cfg->qp);
+        return -1;
+    }
+    if (cfg->abr) {
+        if (rc == ENC_RC_FIXQP) {
+            LOGE("[CFG] --abr needs a bitrate-controlled --rc (cbr / vbr / avbr)");
+            return -1;
+        }
+        if (cfg->abr_max <= 0) cfg->abr_max = cfg->bitrate;
+        if (cfg->abr_min <= 0) cfg->abr_min = cfg->abr_max / 4;
+        if (cfg->abr_min > cfg->abr_max) {
+            LOGE("[CFG] --abr-min %d > --abr-max %d", cfg->abr_min, cfg->abr_max);
+            return -1;
+        }
+    }
+    SinkSyncMode sm;
+    if (parse_sync_mode(cfg->sink_sync, &sm) != 0) {
+        LOGE("[CFG] invalid --sink-sync: %s", cfg->sink_sync);
+        return -1;
+    }
+    if (cfg->sink_ring_kb < 512) cfg->sink_ring_kb = 512;
+
+    if (cfg->v4l2_bufs && (cfg->v4l2_bufs < V4L2_MIN_BUFS || cfg->v4l2_bufs > V4L2_MAX_BUFS)) {
+        LOGE("[CFG] invalid --v4l2-bufs: %d (%d..%d)", cfg->v4l2_bufs, V4L2_MIN_BUFS, V4L2_MAX_BUFS);
+        return -1;
+    }
+    V4L2IoMode io;
+    if (v4l2_io_from_name(cfg->v4l2_io, &io) != 0) {
+        LOGE("[CFG] invalid --v4l2-io: %s", cfg->v4l2_io);
+        return -1;
+    }
+    if (cfg->zero_copy && cfg->v4l2_fourcc && cfg->v4l2_fourcc != V4L2_PIX_FMT_NV12) {
+        LOGE("[CFG] --zero-copy needs --v4l2-fmt nv12 or auto");
+        return -1;
+    }
+    if (cfg->zero_copy && io == V4L2_IO_USERPTR) {
+        LOGE("[CFG] --zero-copy needs --v4l2-io mmap or dmabuf");
+        return -1;
+    }
+    VpDropPolicy dp;
+    if (vp_drop_policy_from_name(cfg->drop_policy, &dp) != 0) {
+        LOGE("[CFG] invalid --drop-policy: %s", cfg->drop_policy);
+        return -1;
+    }
+    if (cfg->drop_depth < 1 || cfg->drop_depth > V4L2_MAX_BUFS) {
+        LOGE("[CFG] invalid --drop-depth: %d (1..%d)", cfg->drop_depth, V4L2_MAX_BUFS);
+        return -1;
+    }
+    MotionMode mm;
+    if (motion_mode_from_name(cfg->motion, &mm) != 0) {
+        LOGE("[CFG] invalid --motion: %s", cfg->motion);
+        return -1;
+    }
+    if (cfg->motion_thresh < 1 || cfg->motion_thresh > 255) {
+        LOGE("[CFG] invalid --motion-thresh: %d (1..255)", cfg->motion_thresh);
+        return -1;
+    }
+    if (cfg->motion_area < 1 || cfg->motion_area > 100) {
+        LOGE("[CFG] invalid --motion-area: %d (1..100)", cfg->motion_area);
+        return -1;
+    }
+    if (cfg->motion_hold_ms < 0) cfg->motion_hold_ms = 0;
+    if (cfg->motion_idle_fps < 0 || cfg->motion_idle_fps > cfg->fps) {
+        LOGE("[CFG] invalid --motion-idle-fps: %d (0..%d)", cfg->motion_idle_fps, cfg->fps);
+        return -1;
+    }
+    if (cfg->motion_idle_pct < 1 || cfg->motion_idle_pct > 100) {
+        LOGE("[CFG] invalid --motion-idle-pct: %d (1..100)", cfg->motion_idle_pct);
+        return -1;
+    }
+    if (mm == MOTION_RATE && rc == ENC_RC_FIXQP) {
+        LOGE("[CFG] --motion rate needs a bitrate-controlled --rc (cbr / vbr / avbr)");
+        return -1;
+    }
+    if (mm == MOTION_RATE && cfg->abr) {
+        LOGE("[CFG] --motion rate and --abr both drive the bitrate, pick one");
+        return -1;
+    }
+    if (cfg->pub_ring_kb < 256 || cfg->pub_ring_kb > 262144) {
+        LOGE("[CFG] invalid --pub-ring-kb: %d (256..262144)", cfg->pub_ring_kb);
+        return -1;
+    }
+    if (cfg->pub_raw_fps < 0 || cfg->pub_raw_fps > cfg->fps) {
+        LOGE("[CFG] invalid --pub-raw-fps: %d (0..%d)", cfg->pub_raw_fps, cfg->fps);
+        return -1;
+    }
+    if (cfg->pub_raw_slots < 2 || cfg->pub_raw_slots > SHM_PUB_MAX_RAW) {
+        LOGE("[CFG] invalid --pub-raw-slots: %d (2..%d)", cfg->pub_raw_slots, SHM_PUB_MAX_RAW);
+        return -1;
+    }
+
+    CaptureSourceType vs, as;
+    if (capture_source_type_from_name(cfg->video_src, &vs) != 0) {
+        LOGE("[CFG] invalid --video-src: %s", cfg->video_src);
+        return -1;
+    }
+    if (capture_source_type_from_name(cfg->audio_src, &as) != 0) {
+        LOGE("[CFG] invalid --audio-src: %s", cfg->audio_src);
+        return -1;
+    }
+    if (vs == CAPTURE_SRC_REPLAY && !cfg->video_file) {
+        LOGE("[CFG] --video-src replay requires --video-file");
+        return -1;
+    }
+    if (as == CAPTURE_SRC_REPLAY && !cfg->audio_file) {
+        LOGE("[CFG] --audio-src replay requires --audio-file");
+        return -1;
+    }
+    for (int i = 0; i < cfg->simulcast_count; i++) {
+        if (finish_simulcast(cfg, &cfg->simulcast[i]) != 0) return -1;
+    }
+    RtProfile prof;
+    if (app_config_rt_profile(cfg, &prof) != 0) return -1;
+    MemArenaOpts mem;
+    if (app_config_mem_arena_opts(cfg, &mem) != 0) return -1;
+    if (cfg->vpu_slots < 0) {
+        LOGE("[CFG] invalid --vpu-slots: %d", cfg->vpu_slots);
+        return -1;
+    }
+    MetricsHttpOpts mo;
+    if (cfg->metrics && metrics_http_parse_addr(cfg->metrics, &mo) != 0) {
+        LOGE("[CFG] invalid --metrics: %s ([addr:]port, IPv4)", cfg->metrics);
+        return -1;
+    }
+    if (cfg->standby) {
+        /* 每次录制另开文件：推流与事件片段没有“一次录制”的概念；子码流的 sink 不随录制切换 */
+        if (st != ENC_SINK_FILE && st != ENC_SINK_ASYNC_FILE && st != ENC_SINK_TS_FILE) {
+            LOGE("[CFG] --standby requires --sink file, async or ts");
+            return -1;
+        }
+        if (cfg->simulcast_count) {
+            LOGE("[CFG] --standby does not support --simulcast");
+            return -1;
+        }
+    }
 
     return 0;
 }
 
+/* 通道名：字母、数字、'-'、'_'，用作统计标签与重启后的文件名 */
+static int valid_channel_name(const char *name)
+{
+    size_t n = strlen(name);
+    if (n == 0 || n >= sizeof(((AppChannel *)0)->name)) return 0;
+    for (size_t i = 0; i < n; i++) {
+        char c = name[i];
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '-' || c == '_'))
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * 一路通道实际占用的设备与输出（按 sink 类型取用到的那几项）。
+ * @return 项数
+ */
+static int channel_resources(const AppConfig *cfg, const char **res, int max)
+{
+    int n = 0;
+    EncSinkType st = ENC_SINK_FILE;
+    enc_sink_type_from_name(cfg->sink_type, &st);
+    if (strcmp(cfg->video_src, "v4l2") == 0 && n < max) res[n++] = cfg->video_device;
+    if (strcmp(cfg->audio_src, "alsa") == 0 && n < max) res[n++] = cfg->audio_device;
+    if (st == ENC_SINK_TS_FILE && n < max) res[n++] = cfg->output_path_ts;
+    else if (st == ENC_SINK_EVENT && n < max) res[n++] = cfg->output_path_event;
+    else if (st == ENC_SINK_PIPE_FFMPEG && n < max) res[n++] = cfg->stream_url;
+    if (!enc_sink_type_is_muxed(st) && n + 1 < max) {
+        res[n++] = cfg->output_path_h264;
+        res[n++] = cfg->output_path_pcm;
+    }
+    for (int i = 0; i < cfg->simulcast_count && n < max; i++) res[n++] = cfg->simulcast[i].output;
+    if (cfg->pub_sock && n < max) res[n++] = cfg->pub_sock;
+    return n;
+}
+
+/*
+ * 读取通道列表文件，见 app_config.h。
+ * 行内容与拼出的参数数组在进程退出前一直有效（cfg 里的字符串指向它们）。
+ */
+int app_config_load_channels(const char *path, int argc, char **argv, AppChannel *out, int max)
+{
+    if (!path || !out || max <= 0) return -1;
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        LOGE("[CFG] open %s failed: %s", path, strerror(errno));
+        return -1;
+    }
+
+    int n = 0, lineno = 0, ret = 0;
+    char buf[1024];
+    while (ret == 0 && fgets(buf, sizeof(buf), fp)) {
+        lineno++;
+        char *hash = strchr(buf, '#');
+        if (hash) *hash = '\0';
+
+        char *line = strdup(buf);
+        char **args = (char **)calloc((size_t)argc + sizeof(buf) / 2 + 1, sizeof(char *));
+        if (!line || !args) {
+            free(line);
+            free(args);
+            ret = -1;
+            break;
+        }
+        for (int i = 0; i < argc; i++) args[i] = argv[i];
+        int nargs = argc;
+        char *name = NULL, *save = NULL;
+        for (char *tok = strtok_r(line, " \t\r\n", &save); tok; tok = strtok_r(NULL, " \t\r\n", &save)) {
+            if (!name) name = tok;
+            else args[nargs++] = tok;
+        }
+        if (!name) {
+            free(line);
+            free(args);
+            continue;
+        }
+
+        if (n >= max) {
+            LOGE("[CFG] %s:%d: too many channels (max %d)", path, lineno, max);
+            ret = -1;
+        } else if (!valid_channel_name(name)) {
+            LOGE("[CFG] %s:%d: invalid channel name \"%s\" (letters, digits, '-', '_')", path, lineno, name);
+            ret = -1;
+        } else {
+            for (int i = 0; i < n; i++) {
+                if (strcmp(out[i].name, name) == 0) {
+                    LOGE("[CFG] %s:%d: duplicate channel name %s", path, lineno, name);
+                    ret = -1;
+                }
+            }
+        }
+        if (ret == 0) {
+            AppChannel *ch = &out[n];
+            snprintf(ch->name, sizeof(ch->name), "%s", name);
+            app_config_load_default(&ch->cfg);
+            optind = 0;   // 重新开始解析（glibc / musl 均支持）
+            if (app_config_parse_args(&ch->cfg, nargs, args) != 0) {
+                LOGE("[CFG] %s:%d: invalid options for channel %s", path, lineno, name);
+                ret = -1;
+            } else {
+                n++;
+            }
+        }
+    }
+    fclose(fp);
+    if (ret != 0) return -1;
+    if (n == 0) {
+        LOGE("[CFG] %s: no channels", path);
+        return -1;
+    }
+
+    /* 同一设备 / 输出不能被两路同时使用 */
+    for (int i = 0; i < n; i++) {
+        const char *ri[8 + APP_MAX_SIMULCAST];
+        int ni = channel_resources(&out[i].cfg, ri, 8 + APP_MAX_SIMULCAST);
+        for (int j = i + 1; j < n; j++) {
+            const char *rj[8 + APP_MAX_SIMULCAST];
+            int nj = channel_resources(&out[j].cfg, rj, 8 + APP_MAX_SIMULCAST);
+            for (int a = 0; a < ni; a++) {
+                for (int b = 0; b < nj; b++) {
+                    if (ri[a] && rj[b] && strcmp(ri[a], rj[b]) == 0) {
+                        LOGE("[CFG] channels %s and %s both use %s", out[i].name, out[j].name, ri[a]);
+                        return -1;
+                    }
+                }
+            }
+        }
+    }
+    return n;
+}
+
+/*
+ * 由配置生成异步 sink 参数；未在命令行暴露的字段保持 sink_async_default_opts 的默认值。
+ *
+ * @param cfg    配置
+ * @param stats  统计对象（可为 NULL）
+ * @param opts   输出
+ */
+void app_config_sink_async_opts(const AppConfig *cfg, AvStats *stats, SinkAsyncOpts *opts)
+{
+    if (!cfg || !opts) return;
+    sink_async_default_opts(opts);
+    opts->ring_bytes = (size_t)cfg->sink_ring_kb << 10;
+    opts->sync_bytes = (size_t)cfg->sink_sync_kb << 10;
+    parse_sync_mode(cfg->sink_sync, &opts->sync_mode);
+    opts->stats = stats;
+}
+
+/*
+ * 由配置生成推流 sink 参数；节目流由调用者按 enc_sink_set_ts_streams 设置。
+ *
+ * @param cfg    配置
+ * @param stats  统计对象（可为 NULL）
+ * @param opts   输出
+ */
+void app_config_sink_pipe_opts(const AppConfig *cfg, AvStats *stats, SinkPipeOpts *opts)
+{
+    if (!cfg || !opts) return;
+    sink_pipe_default_opts(opts);
+    opts->ffmpeg         = cfg->ffmpeg_path;
+    opts->max_latency_ms = cfg->stream_latency_ms;
+    opts->stats          = stats;
+}
+
+/* 音频输出的字节率：编码时按码率（默认同 audio_enc），否则为 PCM */
+static uint64_t audio_bytes_per_sec(const AppConfig *cfg)
+{
+    AudioCodec ac = AUDIO_CODEC_PCM;
+    audio_enc_codec_from_name(cfg->audio_codec, &ac);
+    unsigned int ch = cfg->audio_out_ch ? cfg->audio_out_ch : cfg->channels;
+    if (ac == AUDIO_CODEC_PCM) return (uint64_t)cfg->sample_rate * ch * 2;
+    unsigned int bps = cfg->audio_bitrate ? cfg->audio_bitrate : (ac == AUDIO_CODEC_AAC ? 64000u : 48000u) * ch;
+    return bps / 8;
+}
+
+/*
+ * 由配置生成事件 sink 参数。--event-ring-kb 未指定时按最高码率估算：
+ * 预录秒数 + 两个 GOP（回收以 GOP 为单位）+ 1 秒余量，视频按 1.5 倍平均码率（I 帧 / VBR 上限）加音频。
+ *
+ * @param cfg    配置
+ * @param stats  统计对象（可为 NULL）
+ * @param opts   输出
+ */
+void app_config_sink_event_opts(const AppConfig *cfg, AvStats *stats, SinkEventOpts *opts)
+{
+    if (!cfg || !opts) return;
+    sink_event_default_opts(opts);
+    opts->pre_sec  = cfg->event_pre_sec;
+    opts->post_sec = cfg->event_post_sec;
+    opts->stats    = stats;
+
+    if (cfg->event_ring_kb) {
+        opts->ring_bytes = (size_t)cfg->event_ring_kb << 10;
+        return;
+    }
+    int bps = (cfg->abr && cfg->abr_max > cfg->bitrate) ? cfg->abr_max : cfg->bitrate;
+    int fps = cfg->fps > 0 ? cfg->fps : 30;
+    unsigned int gop_sec = (unsigned int)(((cfg->gop > 0 ? cfg->gop : 2 * fps) + fps - 1) / fps);
+    uint64_t per_sec = (uint64_t)bps / 8 * 3 / 2 + audio_bytes_per_sec(cfg);
+    opts->ring_bytes = (size_t)(per_sec * (cfg->event_pre_sec + 2 * gop_sec + 1));
+}
+
+/*
+ * 由配置生成分段录制参数。预分配按一段的预计大小 × 1.125：
+ * 按时长分段时为 码率 × 时长（启用 --abr 时按上限），只按大小分段时为 --segment-mb；
+ * 纯 PCM 输出按时长或 leader 视频段的时长换算。多出的部分在段结束时截掉。
+ *
+ * @param cfg         配置
+ * @param video_bps   该路视频码率，0 = 不含视频
+ * @param with_audio  输出里是否含 PCM
+ * @param opts        输出
+ */
+void app_config_segment_opts(const AppConfig *cfg, int video_bps, int with_audio, SinkSegmentOpts *opts)
+{
+    if (!cfg || !opts) return;
+    sink_segment_default_opts(opts);
+    opts->seg_sec   = cfg->segment_sec;
+    opts->seg_bytes = (uint64_t)cfg->segment_mb << 20;
+    opts->keep      = cfg->segment_keep;
+    opts->follow    = video_bps == 0;
+    if (!sink_segment_enabled(opts)) return;
+
+    int main_bps = (cfg->abr && cfg->abr_max > cfg->bitrate) ? cfg->abr_max : cfg->bitrate;
+    if (video_bps > 0 && video_bps == cfg->bitrate) video_bps = main_bps;
+    uint64_t per_sec = (uint64_t)video_bps / 8;
+    if (with_audio) per_sec += audio_bytes_per_sec(cfg);
+    if (!per_sec) return;
+
+    uint64_t sec = cfg->segment_sec;
+    if (!sec) {
+        uint64_t lead = (uint64_t)(video_bps > 0 ? video_bps : main_bps) / 8;
+        sec = lead ? opts->seg_bytes / lead + 1 : 0;
+    }
+    uint64_t bytes = per_sec * sec * 9 / 8;
+    if (opts->seg_bytes && !opts->follow && bytes > opts->seg_bytes) bytes = opts->seg_bytes;
+    opts->prealloc_bytes = bytes;
+}
+
+/*
+ * 由配置生成自适应码率参数：范围取 --abr-min/--abr-max，起点为 --bitrate；
+ * 异步 sink 以环大小、推流 sink 以发送队列大小与延迟预算作为积压比例的分母。
+ *
+ * @param cfg   配置
+ * @param opts  输出
+ */
+void app_config_abr_opts(const AppConfig *cfg, AbrOpts *opts)
+{
+    if (!cfg || !opts) return;
+    abr_default_opts(opts);
+    opts->min_bps   = cfg->abr_min;
+    opts->max_bps   = cfg->abr_max;
+    opts->start_bps = cfg->bitrate;
+
+    EncSinkType st = ENC_SINK_FILE;
+    enc_sink_type_from_name(cfg->sink_type, &st);
+    if (st == ENC_SINK_ASYNC_FILE) {
+        opts->sink_ring_bytes = (size_t)cfg->sink_ring_kb << 10;
+    } else if (st == ENC_SINK_PIPE_FFMPEG) {
+        SinkPipeOpts po;
+        app_config_sink_pipe_opts(cfg, NULL, &po);
+        opts->net_queue_bytes = po.queue_bytes;
+        opts->net_latency_us  = (int64_t)po.max_latency_ms * 1000;
+    }
+}
+
+/*
+ * 由配置生成音频采集参数。
+ *
+ * @param cfg    配置
+ * @param stats  统计对象（xrun 次数与采集环深度，可为 NULL）
+ * @param opts   输出
+ */
+void app_config_audio_capture_opts(const AppConfig *cfg, AvStats *stats, AudioCaptureOpts *opts)
+{
+    if (!cfg || !opts) return;
+    audio_capture_default_opts(opts);
+    opts->period_frames  = cfg->audio_period;
+    opts->buffer_periods = cfg->audio_buffer;
+    opts->mmap           = cfg->audio_mmap;
+    opts->ring_periods   = cfg->audio_ring;
+    opts->stats          = stats;
+}
+
+/*
+ * 由配置生成音频编码参数。
+ *
+ * @param cfg   配置
+ * @param opts  输出（sample_rate / in_channels / max_input_frames 为配置值，设备实际参数不同时由调用者覆盖）
+ */
+void app_config_audio_enc_opts(const AppConfig *cfg, AudioEncOpts *opts)
+{
+    if (!cfg || !opts) return;
+    audio_enc_default_opts(opts);
+    audio_enc_codec_from_name(cfg->audio_codec, &opts->codec);
+    opts->sample_rate      = cfg->sample_rate;
+    opts->in_channels      = cfg->channels;
+    opts->out_channels     = cfg->audio_out_ch;
+    opts->bitrate          = cfg->audio_bitrate;
+    opts->gain_db          = cfg->audio_gain_db;
+    opts->max_input_frames = cfg->audio_period;
+}
+
+int app_config_audio_enc_needed(const AppConfig *cfg)
+{
+    if (!cfg) return 0;
+    AudioCodec ac = AUDIO_CODEC_PCM;
+    audio_enc_codec_from_name(cfg->audio_codec, &ac);
+    return ac != AUDIO_CODEC_PCM || cfg->audio_gain_db != 0.0f || cfg->audio_out_ch != 0;
+}
+
+/*
+ * 由配置生成线程调度 / 内存锁定参数。
+ *
+ * @param cfg   配置
+ * @param prof  输出
+ * @return      0 成功；-1 --rt-prio / --cpu-affinity 格式错误
+ */
+int app_config_rt_profile(const AppConfig *cfg, RtProfile *prof)
+{
+    if (!cfg || !prof) return -1;
+    rt_profile_default(prof);
+    prof->mlock = cfg->mlock;
+    if (cfg->rt_prio && rt_profile_parse_prio(prof, cfg->rt_prio) != 0) {
+        LOGE("[CFG] invalid --rt-prio: %s (role=0..99, roles: capture encode sink audio stats)", cfg->rt_prio);
+        return -1;
+    }
+    if (cfg->cpu_affinity && rt_profile_parse_cpus(prof, cfg->cpu_affinity) != 0) {
+        LOGE("[CFG] invalid --cpu-affinity: %s (role=N[-M][+...], roles: capture encode sink audio stats)",
+             cfg->cpu_affinity);
+        return -1;
+    }
+    return 0;
+}
+
+int app_config_mem_arena_opts(const AppConfig *cfg, MemArenaOpts *opts)
+{
+    if (!cfg || !opts) return -1;
+    mem_arena_default_opts(opts);
+    opts->budget = (uint64_t)cfg->mem_budget_mb << 20;
+    if (cfg->hugepages && mem_pages_from_name(cfg->hugepages, &opts->pages) != 0) {
+        LOGE("[CFG] invalid --hugepages: %s (off | thp | hugetlb)", cfg->hugepages);
+        return -1;
+    }
+    if (opts->pages == MEM_PAGES_HUGETLB && !opts->budget) {
+        LOGE("[CFG] --hugepages hugetlb requires --mem-budget (the pages are reserved up front)");
+        return -1;
+    }
+    return 0;
+}
+
+void app_config_motion_opts(const AppConfig *cfg, MotionOpts *opts)
+{
+    if (!cfg || !opts) return;
+    motion_default_opts(opts);
+    opts->threshold        = (unsigned int)cfg->motion_thresh;
+    opts->area_pct         = (unsigned int)cfg->motion_area;
+    opts->hold_ms          = (unsigned int)cfg->motion_hold_ms;
+    opts->idle_interval_us = cfg->motion_idle_fps > 0 ? 1000000 / cfg->motion_idle_fps : 0;
+}
+
+void app_config_pub_opts(const AppConfig *cfg, ShmPubOpts *opts)
+{
+    if (!cfg || !opts) return;
+    memset(opts, 0, sizeof(*opts));
+    opts->sock_path  = cfg->pub_sock;
+    opts->ring_bytes = (size_t)cfg->pub_ring_kb * 1024;
+    opts->raw_fps    = (unsigned int)cfg->pub_raw_fps;
+    opts->raw_slots  = (unsigned int)cfg->pub_raw_slots;
+}
+
+int app_config_metrics_opts(const AppConfig *cfg, MetricsHttpOpts *opts)
+{
+    if (!cfg || !opts || !cfg->metrics) return -1;
+    return metrics_http_parse_addr(cfg->metrics, opts);
+}
+
+/*
+ * 由配置生成采集源参数（名称已在 parse_args 中校验，未知名称按设备处理）。
+ *
+ * @param cfg  配置
+ * @param src  输出
+ */
+void app_config_video_source(const AppConfig *cfg, CaptureSourceOpts *src)
+{
+    if (!cfg || !src) return;
+    memset(src, 0, sizeof(*src));
+    capture_source_type_from_name(cfg->video_src, &src->type);
+    src->path     = cfg->video_file;
+    src->realtime = cfg->src_realtime;
+}
+
+void app_config_audio_source(const AppConfig *cfg, CaptureSourceOpts *src)
+{
+    if (!cfg || !src) return;
+    memset(src, 0, sizeof(*src));
+    capture_source_type_from_name(cfg->audio_src, &src->type);
+    src->path     = cfg->audio_file;
+    src->realtime = cfg->src_realtime;
+}
+
+/* 摘要里的采集源：设备名、"synthetic" 或回放文件 */
+static const char *source_label(const char *src, const char *file, const char *device)
+{
+    CaptureSourceType t = CAPTURE_SRC_DEVICE;
+    capture_source_type_from_name(src, &t);
+    if (t == CAPTURE_SRC_SYNTHETIC) return "synthetic";
+    if (t == CAPTURE_SRC_REPLAY) return file ? file : "(null)";
+    return device ? device : "(null)";
+}
+
 /*
  * 打印配置摘要（方便启动时确认最终生效的参数）。
  *
@@ -197,13 +1335,73 @@ int app_config_parse_args(AppConfig *cfg, int argc, char **argv)
 void app_config_print_summary(const AppConfig *cfg)
 {
     if (!cfg) return;
-    LOGI("[CFG] video=%s %dx%d@%d bitrate=%d | audio=%s %uHz ch=%u | out=%s,%s | sec=%u",
-         cfg->video_device ? cfg->video_device : "(null)",
-         cfg->width, cfg->height, cfg->fps,
-         cfg->bitrate,
-         cfg->audio_device ? cfg->audio_device : "(null)",
+    int ts    = cfg->sink_type && strcmp(cfg->sink_type, "ts") == 0;
+    int pipe  = cfg->sink_type && strcmp(cfg->sink_type, "pipe") == 0;
+    int event = cfg->sink_type && strcmp(cfg->sink_type, "event") == 0;
+    LOGI("[CFG] video=%s %dx%d@%d %s rc=%s bitrate=%d gop=%d qp=%d zero_copy=%d enc_depth=%d | audio=%s %uHz ch=%u | out=%s,%s sink=%s | sec=%u%s",
+         source_label(cfg->video_src, cfg->video_file, cfg->video_device),
+         cfg->width, cfg->height, cfg->fps, cfg->codec, cfg->rc_mode,
+         cfg->bitrate, cfg->gop > 0 ? cfg->gop : cfg->fps * 2, cfg->qp, cfg->zero_copy, cfg->enc_depth,
+         source_label(cfg->audio_src, cfg->audio_file, cfg->audio_device),
          cfg->sample_rate, cfg->channels,
-         cfg->output_path_h264 ? cfg->output_path_h264 : "(null)",
-         cfg->output_path_pcm ? cfg->output_path_pcm : "(null)",
-         cfg->duration_sec);
+         pipe ? cfg->stream_url
+              : event ? cfg->output_path_event
+              : ts ? (cfg->output_path_ts ? cfg->output_path_ts : "(null)")
+                   : (cfg->output_path_h264 ? cfg->output_path_h264 : "(null)"),
+         (ts || pipe || event) ? "-" : (cfg->output_path_pcm ? cfg->output_path_pcm : "(null)"),
+         cfg->sink_type ? cfg->sink_type : "(null)",
+         cfg->duration_sec, cfg->src_realtime ? "" : " src_rate=fast");
+    if (cfg->audio_period != AUDIO_CAPTURE_PERIOD_FRAMES || cfg->audio_buffer || cfg->audio_mmap || cfg->audio_ring)
+        LOGI("[CFG] audio period=%u buffer=%u%s access=%s ring=%u", cfg->audio_period, cfg->audio_buffer,
+             cfg->audio_buffer ? "" : "(driver)", cfg->audio_mmap ? "mmap" : "readi", cfg->audio_ring);
+    if (app_config_audio_enc_needed(cfg))
+        LOGI("[CFG] audio codec=%s bitrate=%u gain=%.1fdB out_ch=%u", cfg->audio_codec, cfg->audio_bitrate,
+             cfg->audio_gain_db, cfg->audio_out_ch ? cfg->audio_out_ch : cfg->channels);
+    if (cfg->v4l2_bufs || cfg->v4l2_fourcc || strcmp(cfg->v4l2_io, "mmap") != 0 ||
+        strcmp(cfg->drop_policy, "none") != 0) {
+        char fourcc[5] = "auto";
+        if (cfg->v4l2_fourcc) v4l2_fourcc_str(cfg->v4l2_fourcc, fourcc);
+        LOGI("[CFG] v4l2 bufs=%d%s fmt=%s io=%s | drop policy=%s depth=%d", cfg->v4l2_bufs,
+             cfg->v4l2_bufs ? "" : "(default)", fourcc, cfg->v4l2_io, cfg->drop_policy, cfg->drop_depth);
+    }
+    if (cfg->abr)
+        LOGI("[CFG] abr bitrate %d..%d", cfg->abr_min, cfg->abr_max);
+    if (strcmp(cfg->motion, "off") != 0)
+        LOGI("[CFG] motion %s thresh=%d area=%d%% hold=%dms idle_fps=%d idle_pct=%d%%", cfg->motion,
+             cfg->motion_thresh, cfg->motion_area, cfg->motion_hold_ms, cfg->motion_idle_fps,
+             cfg->motion_idle_pct);
+    if (cfg->pub_sock)
+        LOGI("[CFG] pub %s ring=%dKB raw_fps=%d raw_slots=%d", cfg->pub_sock, cfg->pub_ring_kb,
+             cfg->pub_raw_fps, cfg->pub_raw_slots);
+    if (cfg->enc_slices)
+        LOGI("[CFG] enc_slices=%d (low-latency slice output)", cfg->enc_slices);
+    if (event) {
+        SinkEventOpts eo;
+        app_config_sink_event_opts(cfg, NULL, &eo);
+        LOGI("[CFG] event pre=%us post=%us ring=%zuKB trigger=SIGUSR1%s%s", cfg->event_pre_sec,
+             cfg->event_post_sec, eo.ring_bytes >> 10, cfg->event_sock ? ",unix:" : "",
+             cfg->event_sock ? cfg->event_sock : "");
+    }
+    if (cfg->standby)
+        LOGI("[CFG] standby control=SIGUSR1/SIGUSR2%s%s", cfg->event_sock ? ",unix:" : "",
+             cfg->event_sock ? cfg->event_sock : "");
+    if (cfg->segment_sec || cfg->segment_mb)
+        LOGI("[CFG] segment sec=%u mb=%u keep=%u", cfg->segment_sec, cfg->segment_mb, cfg->segment_keep);
+    if (cfg->channels_file)
+        LOGI("[CFG] channels=%s vpu_slots=%d%s", cfg->channels_file, cfg->vpu_slots,
+             cfg->vpu_slots ? "" : "(auto)");
+    MetricsHttpOpts mo;
+    if (app_config_metrics_opts(cfg, &mo) == 0)
+        LOGI("[CFG] metrics http://%s:%u/metrics", mo.host[0] ? mo.host : "0.0.0.0", mo.port);
+    if (cfg->rt_prio || cfg->cpu_affinity || cfg->mlock)
+        LOGI("[CFG] rt prio=%s affinity=%s mlock=%d", cfg->rt_prio ? cfg->rt_prio : "-",
+             cfg->cpu_affinity ? cfg->cpu_affinity : "-", cfg->mlock);
+    if (cfg->mem_budget_mb || (cfg->hugepages && strcmp(cfg->hugepages, "off") != 0))
+        LOGI("[CFG] mem budget=%uMB%s hugepages=%s", cfg->mem_budget_mb, cfg->mem_budget_mb ? "" : "(none)",
+             cfg->hugepages);
+    for (int i = 0; i < cfg->simulcast_count; i++) {
+        const AppSimulcast *sc = &cfg->simulcast[i];
+        LOGI("[CFG] simulcast[%d] %dx%d %s bitrate=%d sink=%s out=%s", i + 1,
+             sc->width, sc->height, sc->codec, sc->bitrate, sc->sink_type, sc->output);
+    }
 }
@@ -3,10 +3,37 @@
 
 #include <stdint.h>
 
+#include "abr.h"
+#include "audio_capture.h"
+#include "audio_enc.h"
+#include "capture_source.h"
+#include "mem_arena.h"
+#include "metrics_http.h"
+#include "motion.h"
+#include "rt_sched.h"
+#include "shm_pub.h"
+#include "sink_async.h"
+#include "sink_event.h"
+#include "sink_segment.h"
+#include "sink_pipe.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#define APP_MAX_SIMULCAST 3   // 主码流之外最多几路子码流
+#define APP_MAX_CHANNELS  8   // --channels 最多几路通道
+
+/* 一路 simulcast 子码流（--simulcast）：与主码流共用同一路采集，独立编码与输出 */
+typedef struct {
+    int         width;
+    int         height;
+    int         bitrate;           // bps；未指定时按主码流码率与面积比例换算
+    const char *codec;             // "h264" / "h265" / "mjpeg"（码率控制模式与 GOP 跟随主码流）
+    const char *sink_type;         // "file" / "async" / "ts" / "pipe"
+    const char *output;            // 文件路径或推流地址（未指定时为 out_<W>x<H>.<ext>）
+} AppSimulcast;
+
 typedef struct {
     /* video */
     const char *video_device;      // e.g. "/dev/video0"
@@ -14,26 +41,142 @@ typedef struct {
     int         height;
     int         fps;
     int         bitrate;           // bps, e.g. 2000000
-    uint32_t    v4l2_fourcc;       // 0=auto（预留）
+    const char *codec;             // "h264" / "h265" / "mjpeg"
+    const char *rc_mode;           // "cbr" / "vbr" / "avbr" / "fixqp"
+    int         gop;               // I 帧间隔（帧）；0 = 2 × fps
+    int         qp;                // fixqp 的 QP / mjpeg 的质量因子；0 = 编码器默认
+    int         abr;               // 1=按下游积压 / 丢弃自动调整主码流码率
+    int         abr_min;           // bps；0 = bitrate / 4
+    int         abr_max;           // bps；0 = bitrate
+    int         v4l2_bufs;         // 采集 buffer 数；0 = 默认（设备 V4L2_DEFAULT_BUFS，非设备源 4）
+    uint32_t    v4l2_fourcc;       // 采集格式（V4L2_PIX_FMT_*）；0 = 自动协商
+    const char *v4l2_io;           // "mmap" / "userptr" / "dmabuf"
+    const char *drop_policy;       // "none" / "newest" / "oldest" / "latest"（见 VpDropPolicy）
+    int         drop_depth;        // 丢帧策略的队列深度阈值（帧）
+    const char *motion;            // "off" / "skip" / "rate"（见 MotionMode）
+    int         motion_thresh;     // 块内平均亮度差阈值
+    int         motion_area;       // 变化块占比阈值（%）
+    int         motion_hold_ms;    // 最后一次运动之后保持活跃的时间
+    int         motion_idle_fps;   // 空闲时保留的帧率（skip 送编码；rate 更新参考）；0 = 不保留
+    int         motion_idle_pct;   // rate：空闲时各路码率降到配置值的百分比
+    const char *pub_sock;          // 本机共享内存分发的 UNIX socket（见 shm_pub.h）；NULL 不发布
+    int         pub_ring_kb;       // 编码包共享环大小
+    int         pub_raw_fps;       // 原始帧发布帧率；0 = 只发布编码包
+    int         pub_raw_slots;     // 原始帧槽数
+    int         zero_copy;         // 1=V4L2 DMABUF 直接导入 MPP（单平面 NV12，无 CPU 拷贝）
+    int         enc_depth;         // 异步编码在途帧数（1..4）
+    int         enc_slices;        // 低延迟分片输出：每帧 slice 数（2..16）；0 = 整帧输出
+    const char *video_src;         // "v4l2" / "synthetic" / "replay"
+    const char *video_file;        // replay：紧密排列的 NV12 帧文件（--size 尺寸）
+    AppSimulcast simulcast[APP_MAX_SIMULCAST];
+    int          simulcast_count;
 
     /* audio */
     const char *audio_device;      // e.g. "hw:0,0"
     unsigned int sample_rate;      // e.g. 48000
     unsigned int channels;         // e.g. 2
     unsigned int audio_chunk_ms;   // stats purpose (best-effort)
+    const char *audio_src;         // "alsa" / "synthetic" / "replay"
+    const char *audio_file;        // replay：S16LE 交错 PCM（--sr / --ch 格式）
+    int          src_realtime;     // 非设备源：1=按名义速率出数据，0=尽快（--src-rate fast）
+    unsigned int audio_period;     // 采集 period（帧）
+    unsigned int audio_buffer;     // 设备缓冲（period 数），0 = 驱动默认
+    int          audio_mmap;       // 1 = mmap 访问
+    unsigned int audio_ring;       // 采集环（period 数），0 = 音频线程直接读设备
+    const char  *audio_codec;      // "pcm" / "aac" / "opus"
+    unsigned int audio_bitrate;    // bps，0 = 编码器默认
+    float        audio_gain_db;    // 编码前增益
+    unsigned int audio_out_ch;     // 0 = 与 --ch 相同；1 = 下混为单声道
 
     /* output */
-    const char *sink_type;         // "file" / "pipe" (reserved)
+    const char *sink_type;         // "file" / "async" / "ts" / "pipe" / "event"
+    unsigned int sink_ring_kb;     // async：环大小
+    const char *sink_sync;         // async："none" / "range" / "fdatasync"
+    unsigned int sink_sync_kb;     // async：每写出多少 KB sync 一次
     const char *output_path_h264;  // e.g. "out.h264"
     const char *output_path_pcm;   // e.g. "out.pcm"
+    const char *output_path_ts;    // --sink ts：音视频封装输出，e.g. "out.ts"
+    const char *stream_url;        // --sink pipe：推流地址，e.g. "rtmp://host/live/key"
+    unsigned int stream_latency_ms;// --sink pipe：发送队列延迟预算，超出丢最老 GOP
+    const char *ffmpeg_path;       // --sink pipe：ffmpeg 可执行文件
+    const char *output_path_event; // --sink event：片段文件名（strftime 格式）
+    unsigned int event_pre_sec;    // --sink event：触发前保留的秒数
+    unsigned int event_post_sec;   // --sink event：触发后继续录制的秒数
+    unsigned int event_ring_kb;    // --sink event：预录环大小；0 = 按码率与 GOP 估算
+    const char *event_sock;        // --sink event / --standby：接收控制命令的 UNIX datagram socket；NULL 不监听
+    int          standby;          // 1 = 待机：采集与编码器常驻、不写出，收到 "record start" 后另开文件录制
+    unsigned int segment_sec;      // file / ts：每段时长（秒），0 = 不按时长分段
+    unsigned int segment_mb;       // file / ts：每段大小上限（MB），0 = 不按大小分段
+    unsigned int segment_keep;     // 分段时最多保留的段数，0 = 全部保留
+    /* scheduling */
+    const char *rt_prio;           // "capture=80,encode=70,..."：各角色 SCHED_FIFO 优先级；NULL 不设置
+    const char *cpu_affinity;      // "capture=2,encode=2-3,..."：各角色 CPU 亲和性；NULL 不设置
+    int         mlock;             // 1 = mlockall 并预先缺页
+    unsigned int mem_budget_mb;    // 流水线缓冲（arena + V4L2 / ION 记账）的总上限（MB），0 = 不限
+    const char *hugepages;         // arena 的页类型："off" / "thp" / "hugetlb"（需要 --mem-budget）
+    /* multi-channel */
+    const char *channels_file;     // 通道列表文件（每行一路采集 + 编码 + 输出）；NULL = 单通道
+    int         vpu_slots;         // 全部通道同时在 VPU 上的帧数上限；0 = 通道数 + 1
+
+    const char *stats_json;        // 每秒一行 JSON 统计的输出文件，"-" 为 stdout；NULL 不输出
+    const char *metrics;           // --metrics "[addr:]port"：Prometheus /metrics 监听地址；NULL 不导出
     unsigned int duration_sec;     // default 10
 } AppConfig;
 
+/* --channels 中的一路通道 */
+typedef struct {
+    char      name[32];
+    AppConfig cfg;
+} AppChannel;
+
 int  app_config_load_default(AppConfig *cfg);
 int  app_config_parse_args(AppConfig *cfg, int argc, char **argv);
+/*
+ * 读取通道列表文件。每个非空行是一路通道："<名字> [选项...]"，# 之后为注释；
+ * 每路按 "命令行参数 + 该行选项" 重新解析（同名选项以该行为准），
+ * 调度 / mlock / 内存预算 / --stats-json / --event-sock / --vpu-slots 等进程级选项只取命令行的值。
+ * 各路的设备与输出不能重复。
+ *
+ * @param out  输出，至少 max 个
+ * @return     通道数（1..max）；-1 文件读取失败或某一行的选项不合法
+ */
+int  app_config_load_channels(const char *path, int argc, char **argv, AppChannel *out, int max);
 void app_config_print_summary(const AppConfig *cfg);
 void app_config_print_usage(const char *prog);
 
+/* 由配置生成异步 sink 参数（stats 可为 NULL）。 */
+void app_config_sink_async_opts(const AppConfig *cfg, AvStats *stats, SinkAsyncOpts *opts);
+/* 由配置生成推流 sink 参数（stats 可为 NULL）。 */
+void app_config_sink_pipe_opts(const AppConfig *cfg, AvStats *stats, SinkPipeOpts *opts);
+/* 由配置生成事件 sink 参数（节目流由调用者设置，stats 可为 NULL）。 */
+void app_config_sink_event_opts(const AppConfig *cfg, AvStats *stats, SinkEventOpts *opts);
+/*
+ * 由配置生成分段录制参数（未启用分段时 seg_sec / seg_bytes 均为 0）。
+ * video_bps 为该路视频码率（0 = 纯 PCM 输出），with_audio 表示输出里含 PCM；clock 由调用者设置。
+ */
+void app_config_segment_opts(const AppConfig *cfg, int video_bps, int with_audio, SinkSegmentOpts *opts);
+/* 由配置生成自适应码率参数（积压比例的分母按所选 sink 填写，pkt_slots 由调用者补充）。 */
+void app_config_abr_opts(const AppConfig *cfg, AbrOpts *opts);
+/* 由配置生成音频采集参数（period / 缓冲 / mmap / 采集环，stats 可为 NULL）。 */
+void app_config_audio_capture_opts(const AppConfig *cfg, AvStats *stats, AudioCaptureOpts *opts);
+/* 由配置生成音频编码参数（采样率 / 输入声道 / period 由调用者按设备实际参数填写）。 */
+void app_config_audio_enc_opts(const AppConfig *cfg, AudioEncOpts *opts);
+/* 是否需要音频编码阶段（编码为 AAC/Opus，或 PCM 需要增益 / 下混）。 */
+int  app_config_audio_enc_needed(const AppConfig *cfg);
+/* 由配置生成线程调度 / 内存锁定参数。@return 0 成功；-1 --rt-prio / --cpu-affinity 格式错误 */
+int  app_config_rt_profile(const AppConfig *cfg, RtProfile *prof);
+/* 由配置生成内存区参数（--mem-budget / --hugepages，已在 parse_args 中校验）。@return 0 成功；-1 不合法 */
+int  app_config_mem_arena_opts(const AppConfig *cfg, MemArenaOpts *opts);
+/* 由配置生成运动检测参数。 */
+void app_config_motion_opts(const AppConfig *cfg, MotionOpts *opts);
+/* 由配置生成共享内存分发参数（尺寸 / 编码格式 / 归还回调由调用者填写）。 */
+void app_config_pub_opts(const AppConfig *cfg, ShmPubOpts *opts);
+/* --metrics 的监听地址（已在 parse_args 中校验）。@return 0 启用；-1 未设置 */
+int  app_config_metrics_opts(const AppConfig *cfg, MetricsHttpOpts *opts);
+/* 由配置生成视频 / 音频采集源参数。 */
+void app_config_video_source(const AppConfig *cfg, CaptureSourceOpts *src);
+void app_config_audio_source(const AppConfig *cfg, CaptureSourceOpts *src);
+
 #ifdef __cplusplus
 }
 #endif
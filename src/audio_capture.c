@@ -1,8 +1,17 @@
 // src/audio_capture.c
 #include "audio_capture.h"
 #include "log.h"
+#include "media_clock.h"
+#include "mem_arena.h"
+#include "rt_sched.h"
+#include "trace.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 /* ssize_t 在不同平台的声明位置不同：
  * - Linux/Unix: 通常来自 <sys/types.h>
@@ -17,6 +26,15 @@ typedef SSIZE_T ssize_t;
 
 #define TAG "audio"
 
+/* xrun 只在第 1、2、4、8… 次打印，持续 overrun 时不刷屏 */
+static void count_xrun(AudioCapture *ac, const char *what)
+{
+    ac->xruns++;
+    if (ac->opts.stats) av_stats_inc_audio_xrun(ac->opts.stats);
+    if ((ac->xruns & (ac->xruns - 1)) == 0)
+        LOGW("[%s] %s (%llu so far)", TAG, what, (unsigned long long)ac->xruns);
+}
+
 #if !RK_ALSA_AVAILABLE
 
 /*
@@ -28,17 +46,20 @@ typedef SSIZE_T ssize_t;
  * @param device      ALSA 设备名（未使用）
  * @param sample_rate 采样率（未使用）
  * @param channels    声道数（未使用）
+ * @param opts        period / 缓冲参数（未使用）
  * @return            -1 表示不可用
  */
-int audio_capture_open(AudioCapture *ac,
-                       const char *device,
-                       unsigned int sample_rate,
-                       int channels)
+static int alsa_open(AudioCapture *ac,
+                     const char *device,
+                     unsigned int sample_rate,
+                     int channels,
+                     const AudioCaptureOpts *opts)
 {
     (void)ac;
     (void)device;
     (void)sample_rate;
     (void)channels;
+    (void)opts;
     LOGE("[%s] ALSA headers not found. Please install ALSA dev package.", TAG);
     return -1;
 }
@@ -51,7 +72,7 @@ int audio_capture_open(AudioCapture *ac,
  * @param bytes  期望读取字节数（未使用）
  * @return       -1 表示不可用
  */
-ssize_t audio_capture_read(AudioCapture *ac, uint8_t *buf, size_t bytes)
+static ssize_t alsa_read(AudioCapture *ac, uint8_t *buf, size_t bytes)
 {
     (void)ac;
     (void)buf;
@@ -60,10 +81,24 @@ ssize_t audio_capture_read(AudioCapture *ac, uint8_t *buf, size_t bytes)
     return -1;
 }
 
+static ssize_t alsa_read_ts(AudioCapture *ac, uint8_t *buf, size_t bytes, int64_t *pts_us)
+{
+    (void)pts_us;
+    return alsa_read(ac, buf, bytes);
+}
+
+static int alsa_poll_fds(AudioCapture *ac, struct pollfd *fds, int max)
+{
+    (void)ac;
+    (void)fds;
+    (void)max;
+    return -1;
+}
+
 /*
  * 关闭音频采集（当 ALSA 不可用时为 no-op）。
  */
-void audio_capture_close(AudioCapture *ac)
+static void alsa_close(AudioCapture *ac)
 {
     (void)ac;
 }
@@ -75,35 +110,41 @@ void audio_capture_close(AudioCapture *ac)
  *
  * 典型流程：
  * 1) snd_pcm_open 打开采集设备
- * 2) 配置硬件参数（交错格式/采样格式/声道/采样率/period size）
+ * 2) 配置硬件参数（访问方式/采样格式/声道/采样率/period 与缓冲大小）
  * 3) 计算 bytes_per_frame（每个采样帧字节数）
  *
  * @param ac          输出：采集上下文
  * @param device      ALSA 设备名（例如 "hw:0,0"）
  * @param sample_rate 期望采样率（驱动可能会近似调整）
  * @param channels    声道数
+ * @param opts        period / 缓冲大小与访问方式
  * @return            0 成功；-1 失败
  */
-int audio_capture_open(AudioCapture *ac,
-                       const char *device,
-                       unsigned int sample_rate,
-                       int channels)
+static int alsa_open(AudioCapture *ac,
+                     const char *device,
+                     unsigned int sample_rate,
+                     int channels,
+                     const AudioCaptureOpts *opts)
 {
     if (!ac || !device) return -1;
     memset(ac, 0, sizeof(*ac));
+    ac->opts = *opts;
 
     ac->sample_rate = sample_rate;
     ac->channels    = channels;
     /* 当前固定为 16-bit little-endian，交错格式（LRLR...）。 */
     ac->format      = SND_PCM_FORMAT_S16_LE;  // 16bit 小端
     /* period 可以按延迟/吞吐需求调整：越小延迟越低但系统开销越大。 */
-    ac->frames_per_period = 1024;            // 可以随便调
+    ac->frames_per_period = opts->period_frames;
 
     int err;
 
-    /* 1) 打开 PCM 采集设备 */
+    /*
+     * 1) 打开 PCM 采集设备（非阻塞）：
+     *    读不到数据时立即返回 -EAGAIN，由调用者 poll 设备描述符等待下一个 period。
+     */
     if ((err = snd_pcm_open(&ac->handle, device,
-                            SND_PCM_STREAM_CAPTURE, 0)) < 0) {
+                            SND_PCM_STREAM_CAPTURE, SND_PCM_NONBLOCK)) < 0) {
         LOGE("[%s] snd_pcm_open(%s) failed: %s",
              TAG, device, snd_strerror(err));
         return -1;
@@ -114,14 +155,25 @@ int audio_capture_open(AudioCapture *ac,
     snd_pcm_hw_params_alloca(&hwparams);
 
     snd_pcm_hw_params_any(ac->handle, hwparams);
-    snd_pcm_hw_params_set_access(ac->handle, hwparams,
-                                 SND_PCM_ACCESS_RW_INTERLEAVED);
+    /* mmap：直接从 DMA 缓冲拷出，省掉 readi 在内核里的一次拷贝；插件 / 驱动不支持时退回 readi */
+    if (opts->mmap &&
+        snd_pcm_hw_params_set_access(ac->handle, hwparams, SND_PCM_ACCESS_MMAP_INTERLEAVED) == 0) {
+        ac->mmap = 1;
+    } else {
+        if (opts->mmap) LOGW("[%s] %s: mmap access not supported, using readi", TAG, device);
+        snd_pcm_hw_params_set_access(ac->handle, hwparams,
+                                     SND_PCM_ACCESS_RW_INTERLEAVED);
+    }
     snd_pcm_hw_params_set_format(ac->handle, hwparams, ac->format);
     snd_pcm_hw_params_set_channels(ac->handle, hwparams, ac->channels);
     snd_pcm_hw_params_set_rate_near(ac->handle, hwparams,
                                     &ac->sample_rate, NULL);
     snd_pcm_hw_params_set_period_size_near(ac->handle, hwparams,
                                            &ac->frames_per_period, NULL);
+    if (opts->buffer_periods) {
+        ac->buffer_frames = ac->frames_per_period * opts->buffer_periods;
+        snd_pcm_hw_params_set_buffer_size_near(ac->handle, hwparams, &ac->buffer_frames);
+    }
 
     if ((err = snd_pcm_hw_params(ac->handle, hwparams)) < 0) {
         LOGE("[%s] snd_pcm_hw_params failed: %s",
@@ -130,27 +182,140 @@ int audio_capture_open(AudioCapture *ac,
         ac->handle = NULL;
         return -1;
     }
+    /* 驱动给出的实际值（near 系列可能调整） */
+    snd_pcm_hw_params_get_period_size(hwparams, &ac->frames_per_period, NULL);
+    snd_pcm_hw_params_get_buffer_size(hwparams, &ac->buffer_frames);
+
+    /*
+     * 3) 软件参数：开启 MONOTONIC 时间戳，使 snd_pcm_htimestamp 与 V4L2 buffer timestamp
+     *    落在同一时间轴。老内核/插件不支持时不影响采集，只是 PTS 退化为估算值。
+     */
+    snd_pcm_sw_params_t *swparams = NULL;
+    snd_pcm_sw_params_alloca(&swparams);
+    if (snd_pcm_sw_params_current(ac->handle, swparams) == 0 &&
+        snd_pcm_sw_params_set_tstamp_mode(ac->handle, swparams, SND_PCM_TSTAMP_ENABLE) == 0 &&
+        snd_pcm_sw_params_set_tstamp_type(ac->handle, swparams, SND_PCM_TSTAMP_TYPE_MONOTONIC) == 0 &&
+        snd_pcm_sw_params(ac->handle, swparams) == 0) {
+        ac->htstamp = 1;
+    } else {
+        LOGW("[%s] monotonic htimestamp not supported, PTS will be estimated", TAG);
+    }
 
     /* bytes_per_frame：每个“采样帧”的字节数 = (位宽/8) * 声道数 */
     ac->bytes_per_frame =
         snd_pcm_format_width(ac->format) / 8 * ac->channels; // e.g. 2ch*2B = 4B
 
-    LOGI("[%s] opened device=%s, %u Hz, ch=%d, period=%lu frames, %zu B/frame",
+    LOGI("[%s] opened device=%s, %u Hz, ch=%d, period=%lu frames, buffer=%lu frames, %zu B/frame, %s",
          TAG, device, ac->sample_rate, ac->channels,
-         (unsigned long)ac->frames_per_period, ac->bytes_per_frame);
+         (unsigned long)ac->frames_per_period, (unsigned long)ac->buffer_frames,
+         ac->bytes_per_frame, ac->mmap ? "mmap" : "readi");
+
+    return 0;
+}
+
+static ssize_t alsa_read(AudioCapture *ac, uint8_t *buf, size_t bytes);
+
+/*
+ * 推算下一个待读取采样帧的采集时间（CLOCK_MONOTONIC 微秒）。
+ *
+ * htimestamp 给出“硬件指针位置”的时间与此刻已就绪的 avail 帧数；
+ * 下一个要读的帧是这 avail 帧中最早的一帧，因此时间为 tstamp - avail / rate。
+ */
+static int64_t next_frame_time_us(AudioCapture *ac)
+{
+    snd_pcm_uframes_t avail = 0;
+    snd_htimestamp_t  ts;
+    if (ac->htstamp && snd_pcm_htimestamp(ac->handle, &avail, &ts) == 0 && (ts.tv_sec || ts.tv_nsec))
+        return media_clock_timespec_us(&ts) - (int64_t)avail * 1000000 / ac->sample_rate;
+
+    /* stream 尚未启动或不支持：用当前时间与 avail 估算 */
+    snd_pcm_sframes_t a = snd_pcm_avail_update(ac->handle);
+    if (a < 0) a = 0;
+    return media_clock_now_us() - (int64_t)a * 1000000 / ac->sample_rate;
+}
+
+/*
+ * 读取音频数据并给出本段第一个采样的采集时间。
+ *
+ * @param pts_us  输出：CLOCK_MONOTONIC 微秒（可为 NULL；返回值 <=0 时不修改）
+ * @return        同 audio_capture_read
+ */
+static ssize_t alsa_read_ts(AudioCapture *ac, uint8_t *buf, size_t bytes, int64_t *pts_us)
+{
+    if (!ac || !ac->handle) return -1;
+
+    int64_t t = pts_us ? next_frame_time_us(ac) : 0;
+    ssize_t n = alsa_read(ac, buf, bytes);
+    if (n > 0 && pts_us) *pts_us = t;
+    return n;
+}
 
+/*
+ * 读设备出错时的恢复：overrun（-EPIPE）/ 挂起（-ESTRPIPE）计入 xrun 后 snd_pcm_recover 重新 prepare，
+ * 缓冲里未读的数据随之丢弃；mmap 模式下次读时重新 start。
+ *
+ * @return  0 已恢复（本次无数据）；-1 无法恢复
+ */
+static ssize_t alsa_recover(AudioCapture *ac, int err)
+{
+    if (err == -EAGAIN) return 0;
+    if (err == -EPIPE) count_xrun(ac, "capture overrun, buffered audio lost");
+    else if (err == -ESTRPIPE) count_xrun(ac, "device suspended, buffered audio lost");
+    err = snd_pcm_recover(ac->handle, err, 1);
+    if (err < 0) {
+        LOGE("[%s] capture recover failed: %s", TAG, snd_strerror(err));
+        return -1;
+    }
     return 0;
 }
 
+/*
+ * mmap 读取：avail 够 frames 帧时从 DMA 缓冲拷出（可能分两段，跨缓冲尾部），
+ * 不足时返回 0，由调用者 poll。mmap 访问不会由读操作自动启动 stream，第一次读时显式 start。
+ */
+static ssize_t alsa_read_mmap(AudioCapture *ac, uint8_t *buf, snd_pcm_uframes_t frames)
+{
+    if (snd_pcm_state(ac->handle) == SND_PCM_STATE_PREPARED) {
+        int err = snd_pcm_start(ac->handle);
+        if (err < 0) return alsa_recover(ac, err);
+    }
+
+    snd_pcm_sframes_t avail = snd_pcm_avail_update(ac->handle);
+    if (avail < 0) return alsa_recover(ac, (int)avail);
+    if ((snd_pcm_uframes_t)avail < frames) return 0;
+
+    snd_pcm_uframes_t done = 0;
+    while (done < frames) {
+        const snd_pcm_channel_area_t *areas;
+        snd_pcm_uframes_t offset, n = frames - done;
+        TRACE_BEGIN("snd_pcm_mmap");
+        int err = snd_pcm_mmap_begin(ac->handle, &areas, &offset, &n);
+        TRACE_END();
+        if (err < 0) return alsa_recover(ac, err);
+
+        /* 交错格式：所有声道都在 areas[0]，相邻两帧相隔 step 位 */
+        const uint8_t *src = (const uint8_t *)areas[0].addr + (areas[0].first + offset * areas[0].step) / 8;
+        memcpy(buf + done * ac->bytes_per_frame, src, n * ac->bytes_per_frame);
+
+        snd_pcm_sframes_t c = snd_pcm_mmap_commit(ac->handle, offset, n);
+        if (c < 0 || (snd_pcm_uframes_t)c != n) return alsa_recover(ac, c < 0 ? (int)c : -EPIPE);
+        done += n;
+    }
+    return (ssize_t)(done * ac->bytes_per_frame);
+}
+
 /*
  * 从 ALSA 采集设备读取音频数据。
  *
+ * 非阻塞模式：第一次调用时 readi 会启动 stream（PREPARED -> RUNNING），
+ * 因此调用者应先读、读到 0 再 poll，而不是一开始就 poll。
+ *
  * @param ac     采集上下文
  * @param buf    输出缓冲
  * @param bytes  期望读取字节数（会按 bytes_per_frame 换算为帧数读取）
- * @return       >0 实际读取字节数；0 表示本次请求不足以构成 1 帧；-1 失败
+ * @return       >0 实际读取字节数；0 表示暂时无数据、刚从 overrun 恢复或本次请求不足以构成 1 帧；-1 失败
  */
-ssize_t audio_capture_read(AudioCapture *ac, uint8_t *buf, size_t bytes)
+static ssize_t alsa_read(AudioCapture *ac, uint8_t *buf, size_t bytes)
 {
     if (!ac || !ac->handle || !buf || bytes == 0) return -1;
 
@@ -158,25 +323,46 @@ ssize_t audio_capture_read(AudioCapture *ac, uint8_t *buf, size_t bytes)
     size_t frames_to_read = bytes / ac->bytes_per_frame;
     if (frames_to_read == 0) return 0;
 
+    if (ac->mmap) return alsa_read_mmap(ac, buf, frames_to_read);
+
+    TRACE_BEGIN("snd_pcm_readi");
     snd_pcm_sframes_t n = snd_pcm_readi(ac->handle, buf, frames_to_read);
-    if (n < 0) {
-        /* 发生 underrun/设备暂停等错误时，尝试恢复一次（允许重启 stream）。 */
-        n = snd_pcm_recover(ac->handle, n, 1);
-        if (n < 0) {
-            LOGE("[%s] snd_pcm_readi failed: %s",
-                 TAG, snd_strerror((int)n));
-            return -1;
-        }
-    }
+    TRACE_END();
+    if (n < 0) return alsa_recover(ac, (int)n);
 
     /* 返回实际读取到的字节数。 */
     return n * ac->bytes_per_frame;
 }
 
+/*
+ * 取得 PCM 的 poll 描述符，供调用者与其他 fd（如 stop eventfd）一起等待。
+ *
+ * @param ac    采集上下文
+ * @param fds   输出数组
+ * @param max   数组容量
+ * @return      填充个数；-1 失败
+ */
+static int alsa_poll_fds(AudioCapture *ac, struct pollfd *fds, int max)
+{
+    if (!ac || !ac->handle || !fds || max <= 0) return -1;
+
+    int cnt = snd_pcm_poll_descriptors_count(ac->handle);
+    if (cnt <= 0 || cnt > max) {
+        LOGE("[%s] poll descriptors count=%d (max %d)", TAG, cnt, max);
+        return -1;
+    }
+    int err = snd_pcm_poll_descriptors(ac->handle, fds, (unsigned int)cnt);
+    if (err < 0) {
+        LOGE("[%s] snd_pcm_poll_descriptors failed: %s", TAG, snd_strerror(err));
+        return -1;
+    }
+    return err;
+}
+
 /*
  * 关闭 ALSA 采集并清理上下文。
  */
-void audio_capture_close(AudioCapture *ac)
+static void alsa_close(AudioCapture *ac)
 {
     if (!ac) return;
 
@@ -190,3 +376,361 @@ void audio_capture_close(AudioCapture *ac)
 }
 
 #endif
+
+/* ===================== Synthetic / replay source ===================== */
+/*
+ * 非设备源：采样按名义速率“到达”（realtime）或随读随有（尽快模式），
+ * 时间戳为 起始时刻 + 已交付采样数 / 采样率，与 ALSA htimestamp 同一时间轴。
+ */
+#define SRC_BUFFER_PERIODS 8   // realtime：未指定缓冲大小时，积压超过这么多 period 视为 overrun，跳到最新
+
+static int src_open(AudioCapture *ac, unsigned int sample_rate, int channels,
+                    const CaptureSourceOpts *src, const AudioCaptureOpts *opts)
+{
+    memset(ac, 0, sizeof(*ac));
+    ac->opts   = *opts;
+    ac->src    = *src;
+    ac->src_fd = -1;
+    ac->pacer.fd = -1;
+    if (!sample_rate || channels <= 0) return -1;
+
+    ac->sample_rate       = sample_rate;
+    ac->channels          = channels;
+#if RK_ALSA_AVAILABLE
+    ac->format            = SND_PCM_FORMAT_S16_LE;
+#endif
+    ac->frames_per_period = opts->period_frames;
+    ac->buffer_frames     = ac->frames_per_period * (opts->buffer_periods ? opts->buffer_periods : SRC_BUFFER_PERIODS);
+    ac->bytes_per_frame   = 2 * (size_t)channels;
+    ac->htstamp           = 1;
+
+    if (src->type == CAPTURE_SRC_REPLAY) {
+        if (!src->path) {
+            LOGE("[%s] replay source needs a file", TAG);
+            return -1;
+        }
+        ac->src_fd = open(src->path, O_RDONLY | O_CLOEXEC);
+        if (ac->src_fd < 0) {
+            LOGE("[%s] open %s failed: %s", TAG, src->path, strerror(errno));
+            return -1;
+        }
+    }
+
+    int64_t period_us = (int64_t)ac->frames_per_period * 1000000 / sample_rate;
+    if (capture_pacer_open(&ac->pacer, src->realtime, period_us) != 0)
+        return -1;   // 由调用者 src_close 清理
+    /* 尽快模式：fd 一直可读，读到 0 的情况不会出现 */
+    capture_pacer_kick(&ac->pacer);
+
+    LOGI("[%s] %s source: %u Hz, ch=%d, S16_LE, %s%s%s", TAG, capture_source_name(src->type),
+         sample_rate, channels, src->realtime ? "realtime" : "as fast as possible",
+         ac->src_fd >= 0 ? ", file=" : "", ac->src_fd >= 0 ? src->path : "");
+    return 0;
+}
+
+static ssize_t src_read_ts(AudioCapture *ac, uint8_t *buf, size_t bytes, int64_t *pts_us)
+{
+    if (!buf || bytes == 0) return -1;
+    size_t frames = bytes / ac->bytes_per_frame;
+    if (frames == 0) return 0;
+
+    /* 与 ALSA 一样，第一次读时启动 */
+    if (!ac->src_started) {
+        ac->src_started  = 1;
+        ac->src_start_us = media_clock_now_us();
+        if (capture_pacer_start(&ac->pacer) != 0) return -1;
+    }
+
+    if (ac->src.realtime) {
+        capture_pacer_take(&ac->pacer);
+        uint64_t arrived = (uint64_t)(media_clock_now_us() - ac->src_start_us) * ac->sample_rate / 1000000;
+        uint64_t avail   = arrived > ac->src_frames ? arrived - ac->src_frames : 0;
+        if (avail > ac->buffer_frames) {
+            /* 读得太慢：像 ALSA overrun 恢复一样丢掉积压，只保留一个 period */
+            count_xrun(ac, "source overrun, backlog skipped");
+            ac->src_frames += avail - ac->frames_per_period;
+            avail = ac->frames_per_period;
+        }
+        if (avail < frames) return 0;
+    }
+
+    size_t n = frames * ac->bytes_per_frame;
+    if (ac->src.type == CAPTURE_SRC_REPLAY) {
+        if (capture_source_read_loop(ac->src_fd, buf, n) != 0) return -1;
+    } else {
+        capture_source_synth_pcm((int16_t *)(void *)buf, frames, ac->channels, ac->sample_rate, &ac->src_phase);
+    }
+
+    if (pts_us) *pts_us = ac->src_start_us + (int64_t)(ac->src_frames * 1000000 / ac->sample_rate);
+    ac->src_frames += frames;
+    return (ssize_t)n;
+}
+
+static void src_close(AudioCapture *ac)
+{
+    capture_pacer_close(&ac->pacer);
+    if (ac->src_fd >= 0) close(ac->src_fd);
+    memset(ac, 0, sizeof(*ac));
+    LOGI("[%s] audio capture closed", TAG);
+}
+
+/* ===================== Capture ring ===================== */
+/*
+ * ring_periods > 0：采集线程只做“读设备 -> 拷进环槽位”，写出线程卡住（磁盘抖动、sink 背压）时
+ * 设备照常被读空，不会 overrun；环满时丢掉新读到的 period 并计入 drop_count。
+ */
+
+static int is_src(const AudioCapture *ac)
+{
+    return ac && ac->src.type != CAPTURE_SRC_DEVICE;
+}
+
+static ssize_t dev_read_ts(AudioCapture *ac, uint8_t *buf, size_t bytes, int64_t *pts_us)
+{
+    if (is_src(ac)) return src_read_ts(ac, buf, bytes, pts_us);
+    return alsa_read_ts(ac, buf, bytes, pts_us);
+}
+
+static int dev_poll_fds(AudioCapture *ac, struct pollfd *fds, int max)
+{
+    if (is_src(ac)) {
+        if (!fds || max <= 0) return -1;
+        fds[0].fd      = ac->pacer.fd;
+        fds[0].events  = POLLIN;
+        fds[0].revents = 0;
+        return 1;
+    }
+    return alsa_poll_fds(ac, fds, max);
+}
+
+static void *ring_thread(void *arg)
+{
+    AudioCapture *ac = (AudioCapture *)arg;
+    rt_sched_apply(RT_ROLE_AUDIO, "a-capture");
+    size_t chunk = (size_t)ac->frames_per_period * ac->bytes_per_frame;
+    int period_ms = (int)((uint64_t)ac->frames_per_period * 1000U / (ac->sample_rate ? ac->sample_rate : 1U));
+    if (period_ms < 1) period_ms = 1;
+
+    /* 设备描述符之后放 stop eventfd；取不到设备描述符时按 period 时长定时重试 */
+    struct pollfd pfds[9];
+    int n = dev_poll_fds(ac, pfds, 8);
+    if (n < 0) n = 0;
+    pfds[n].fd      = ac->stop_fd;
+    pfds[n].events  = POLLIN;
+    pfds[n].revents = 0;
+
+    while (!atomic_load_explicit(&ac->th_stop, memory_order_acquire)) {
+        uint8_t *dst = pcm_ring_write_ptr(&ac->ring);
+        int64_t pts = 0;
+        ssize_t r = dev_read_ts(ac, dst ? dst : ac->scratch, chunk, &pts);
+        if (r == 0) {
+            poll(pfds, (nfds_t)(n + 1), n ? 1000 : period_ms);
+            continue;
+        }
+        if (r < 0) {
+            /* 恢复失败时退避一个 period，避免错误状态下空转 */
+            poll(&pfds[n], 1, period_ms);
+            continue;
+        }
+        if (!dst) {
+            if (ac->ring_drops++ == 0)
+                LOGW("[%s] capture ring full (%u periods), dropping audio until the writer catches up",
+                     TAG, pcm_ring_capacity(&ac->ring));
+            if (ac->opts.stats) av_stats_add_drop(ac->opts.stats, 1);
+            continue;
+        }
+        pcm_ring_commit(&ac->ring, (uint32_t)r, pts);
+        if (ac->opts.stats)
+            av_stats_observe_max(&ac->opts.stats->audio_ring_max, pcm_ring_depth(&ac->ring));
+    }
+    return NULL;
+}
+
+static int ring_start(AudioCapture *ac)
+{
+    size_t chunk = (size_t)ac->frames_per_period * ac->bytes_per_frame;
+    ac->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ac->scratch = (uint8_t *)mem_arena_alloc(MEM_STAGE_AUDIO, chunk, 0);
+    if (ac->stop_fd < 0 || !ac->scratch || pcm_ring_init(&ac->ring, ac->opts.ring_periods, chunk) != 0) {
+        LOGE("[%s] capture ring setup failed", TAG);
+        return -1;
+    }
+    atomic_store(&ac->th_stop, 0);
+    if (pthread_create(&ac->th, NULL, ring_thread, ac) != 0) {
+        LOGE("[%s] pthread_create capture thread failed", TAG);
+        return -1;
+    }
+    ac->th_started = 1;
+    LOGI("[%s] capture ring: %u periods x %zu B (%u ms)", TAG, pcm_ring_capacity(&ac->ring), chunk,
+         (unsigned int)((uint64_t)pcm_ring_capacity(&ac->ring) * ac->frames_per_period * 1000U /
+                        (ac->sample_rate ? ac->sample_rate : 1U)));
+    return 0;
+}
+
+/* 停止采集线程并释放环；环里未取走的数据丢弃 */
+static void ring_stop(AudioCapture *ac)
+{
+    if (ac->th_started) {
+        atomic_store_explicit(&ac->th_stop, 1, memory_order_release);
+        uint64_t one = 1;
+        ssize_t n = write(ac->stop_fd, &one, sizeof(one));
+        (void)n;
+        pthread_join(ac->th, NULL);
+        ac->th_started = 0;
+        if (ac->ring_drops)
+            LOGW("[%s] capture ring dropped %llu periods", TAG, (unsigned long long)ac->ring_drops);
+    }
+    if (ac->opts.ring_periods) pcm_ring_free(&ac->ring);
+    if (ac->stop_fd >= 0) close(ac->stop_fd);
+    ac->stop_fd = -1;
+    mem_arena_free(ac->scratch);
+    ac->scratch = NULL;
+}
+
+/* ===================== Public API ===================== */
+
+void audio_capture_default_opts(AudioCaptureOpts *opts)
+{
+    if (!opts) return;
+    memset(opts, 0, sizeof(*opts));
+    opts->period_frames = AUDIO_CAPTURE_PERIOD_FRAMES;
+}
+
+int audio_capture_open(AudioCapture *ac,
+                       const char *device,
+                       unsigned int sample_rate,
+                       int channels)
+{
+    return audio_capture_open_ex(ac, device, sample_rate, channels, NULL, NULL);
+}
+
+int audio_capture_open_opts(AudioCapture *ac,
+                            const char *device,
+                            unsigned int sample_rate,
+                            int channels,
+                            const CaptureSourceOpts *src)
+{
+    return audio_capture_open_ex(ac, device, sample_rate, channels, src, NULL);
+}
+
+/*
+ * 打开音频采集：src 为 NULL 或 DEVICE 时打开 ALSA 设备，否则打开合成 / 回放源（device 被忽略）；
+ * opts->ring_periods > 0 时再启动采集线程。
+ *
+ * @return  0 成功；-1 失败
+ */
+int audio_capture_open_ex(AudioCapture *ac,
+                          const char *device,
+                          unsigned int sample_rate,
+                          int channels,
+                          const CaptureSourceOpts *src,
+                          const AudioCaptureOpts *opts)
+{
+    if (!ac) return -1;
+    AudioCaptureOpts o;
+    if (opts) o = *opts;
+    else audio_capture_default_opts(&o);
+    if (!o.period_frames) o.period_frames = AUDIO_CAPTURE_PERIOD_FRAMES;
+
+    if (src && src->type != CAPTURE_SRC_DEVICE) {
+        if (src_open(ac, sample_rate, channels, src, &o) != 0) {
+            src_close(ac);
+            return -1;
+        }
+    } else if (alsa_open(ac, device, sample_rate, channels, &o) != 0) {
+        return -1;
+    }
+    ac->stop_fd  = -1;
+    ac->ring.efd = -1;
+
+    ac->pbuf = (uint8_t *)mem_arena_alloc(MEM_STAGE_AUDIO, (size_t)ac->frames_per_period * ac->bytes_per_frame, 0);
+    if (!ac->pbuf || (o.ring_periods && ring_start(ac) != 0)) {
+        audio_capture_close(ac);
+        return -1;
+    }
+    return 0;
+}
+
+ssize_t audio_capture_peek(AudioCapture *ac, const uint8_t **data, int64_t *pts_us)
+{
+    if (!ac || !data) return -1;
+    if (ac->opts.ring_periods) {
+        uint32_t bytes = 0;
+        const uint8_t *p = pcm_ring_read_ptr(&ac->ring, &bytes, pts_us);
+        if (!p) {
+            /* 先清通知再复查：清之后提交的数据会重新置位 eventfd，poll 不会错过 */
+            pcm_ring_clear(&ac->ring);
+            p = pcm_ring_read_ptr(&ac->ring, &bytes, pts_us);
+            if (!p) return 0;
+        }
+        *data = p;
+        return (ssize_t)bytes;
+    }
+
+    if (!ac->peeked) {
+        size_t chunk = (size_t)ac->frames_per_period * ac->bytes_per_frame;
+        ssize_t n = dev_read_ts(ac, ac->pbuf, chunk, &ac->pbuf_pts);
+        if (n <= 0) return n;
+        ac->pbuf_len = (size_t)n;
+        ac->peeked = 1;
+    }
+    *data = ac->pbuf;
+    if (pts_us) *pts_us = ac->pbuf_pts;
+    return (ssize_t)ac->pbuf_len;
+}
+
+void audio_capture_release(AudioCapture *ac)
+{
+    if (!ac) return;
+    if (ac->opts.ring_periods) {
+        if (pcm_ring_depth(&ac->ring)) pcm_ring_release(&ac->ring);
+        return;
+    }
+    ac->peeked = 0;
+}
+
+ssize_t audio_capture_read(AudioCapture *ac, uint8_t *buf, size_t bytes)
+{
+    return audio_capture_read_ts(ac, buf, bytes, NULL);
+}
+
+/* 环模式下取出一整个 period 并释放槽位（bytes 小于一个 period 时返回 -1） */
+ssize_t audio_capture_read_ts(AudioCapture *ac, uint8_t *buf, size_t bytes, int64_t *pts_us)
+{
+    if (ac && ac->opts.ring_periods) {
+        if (!buf) return -1;
+        const uint8_t *p;
+        ssize_t n = audio_capture_peek(ac, &p, pts_us);
+        if (n <= 0) return n;
+        if ((size_t)n > bytes) return -1;
+        memcpy(buf, p, (size_t)n);
+        audio_capture_release(ac);
+        return n;
+    }
+    return dev_read_ts(ac, buf, bytes, pts_us);
+}
+
+int audio_capture_poll_fds(AudioCapture *ac, struct pollfd *fds, int max)
+{
+    if (ac && ac->opts.ring_periods) {
+        if (!fds || max <= 0) return -1;
+        fds[0].fd      = ac->ring.efd;
+        fds[0].events  = POLLIN;
+        fds[0].revents = 0;
+        return 1;
+    }
+    return dev_poll_fds(ac, fds, max);
+}
+
+void audio_capture_close(AudioCapture *ac)
+{
+    if (!ac) return;
+    ring_stop(ac);
+    mem_arena_free(ac->pbuf);
+    ac->pbuf = NULL;
+    if (is_src(ac)) {
+        src_close(ac);
+        return;
+    }
+    alsa_close(ac);
+}
@@ -1,8 +1,16 @@
 // src/audio_capture.h
 #pragma once
 
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <poll.h>
+#include <sys/types.h>
+
+#include "av_stats.h"
+#include "capture_source.h"
+#include "pcm_ring.h"
 
 #if defined(__has_include)
 #  if __has_include(<alsa/asoundlib.h>)
@@ -23,15 +31,56 @@ typedef unsigned long snd_pcm_uframes_t;
 typedef long snd_pcm_sframes_t;
 #endif
 
+#define AUDIO_CAPTURE_PERIOD_FRAMES 1024
+
+typedef struct {
+    unsigned int period_frames;   // period 大小（帧），默认 1024；驱动可能取近似值
+    unsigned int buffer_periods;  // 设备缓冲 = period × n；0 = 驱动默认
+    int          mmap;            // 1 = MMAP_INTERLEAVED，直接从 DMA 缓冲拷出（驱动不支持时退回 readi）
+    unsigned int ring_periods;    // >0：独立采集线程把 period 写进 PCM 环，读接口从环里取；0 = 调用线程直接读设备
+    AvStats     *stats;           // xrun 次数与环深度（可为 NULL）
+} AudioCaptureOpts;
+
 typedef struct {
     snd_pcm_t          *handle;
     unsigned int        sample_rate;
     int                 channels;
     snd_pcm_format_t    format;
     snd_pcm_uframes_t   frames_per_period;
+    snd_pcm_uframes_t   buffer_frames;
     size_t              bytes_per_frame;
+    int                 htstamp;      // 1=已开启 MONOTONIC 硬件时间戳（snd_pcm_htimestamp 可用）
+    int                 mmap;         // 1=实际使用 mmap 访问
+    AudioCaptureOpts    opts;
+    uint64_t            xruns;        // 设备 overrun / 源读得太慢被跳过的次数（读设备的线程写）
+
+    /* 非设备源（合成 / 文件回放）：poll 的是 pacer.fd */
+    CaptureSourceOpts   src;
+    CapturePacer        pacer;
+    int                 src_fd;       // 回放文件
+    int                 src_started;
+    int64_t             src_start_us;
+    uint64_t            src_frames;   // 已交付的采样帧数
+    uint32_t            src_phase;    // 合成正弦的相位
+
+    /* ring_periods > 0：采集线程 -> PCM 环 -> peek/release（读接口所在线程） */
+    PcmRing             ring;
+    pthread_t           th;
+    int                 th_started;
+    atomic_int          th_stop;
+    int                 stop_fd;      // eventfd：唤醒采集线程退出
+    uint8_t            *scratch;      // 环满时承接要丢弃的 period，设备照常被读空
+    uint64_t            ring_drops;
+
+    /* 直接读模式下 peek 的缓冲 */
+    uint8_t            *pbuf;
+    size_t              pbuf_len;
+    int64_t             pbuf_pts;
+    int                 peeked;
 } AudioCapture;
 
+void audio_capture_default_opts(AudioCaptureOpts *opts);
+
 /**
  * 打开 ALSA 采集设备
  *  device: "hw:0,0" 这种
@@ -42,12 +91,56 @@ int audio_capture_open(AudioCapture *ac,
                        int channels);
 
 /**
- * 从设备读取一段 PCM 数据（阻塞）
+ * 同 audio_capture_open，src 非 NULL 且不是 DEVICE 时打开合成 / 回放源（device 被忽略；
+ * 格式固定为 S16_LE 交错，回放文件需与 sample_rate/channels 一致）
+ */
+int audio_capture_open_opts(AudioCapture *ac,
+                            const char *device,
+                            unsigned int sample_rate,
+                            int channels,
+                            const CaptureSourceOpts *src);
+
+/**
+ * 同 audio_capture_open_opts，并指定 period / 缓冲大小、访问方式与采集环（opts 为 NULL 时取默认值）。
+ * ring_periods > 0 时启动采集线程，poll_fds 返回环的通知 fd。
+ */
+int audio_capture_open_ex(AudioCapture *ac,
+                          const char *device,
+                          unsigned int sample_rate,
+                          int channels,
+                          const CaptureSourceOpts *src,
+                          const AudioCaptureOpts *opts);
+
+/**
+ * 取下一个 period，不拷贝：环模式下直接指向环内槽位，否则读进内部缓冲。
+ * 用完调用 audio_capture_release；release 之前再次 peek 得到同一段。
+ *  data:   输出数据指针
+ *  pts_us: 输出本段第一个采样的采集时间（可为 NULL）
+ * 返回: 字节数；0 表示暂时无数据（应 poll 后再取）；<0 表示出错
+ */
+ssize_t audio_capture_peek(AudioCapture *ac, const uint8_t **data, int64_t *pts_us);
+void    audio_capture_release(AudioCapture *ac);
+
+/**
+ * 从设备读取一段 PCM 数据（非阻塞，设备以 SND_PCM_NONBLOCK 打开）
  *  buf:   输出缓冲区
  *  bytes: 期望读取的字节数（建议是 frames_per_period * bytes_per_frame 的整数倍）
- * 返回: 实际读取的字节数，<0 表示出错
+ * 返回: 实际读取的字节数；0 表示暂时无数据（应 poll 后再读）；<0 表示出错
  */
 ssize_t audio_capture_read(AudioCapture *ac, uint8_t *buf, size_t bytes);
 
+/**
+ * 同 audio_capture_read，并给出本段第一个采样的采集时间
+ *  pts_us: 输出 CLOCK_MONOTONIC 微秒（由 snd_pcm_htimestamp 推算；不可用时按当前时间与 avail 估算）
+ */
+ssize_t audio_capture_read_ts(AudioCapture *ac, uint8_t *buf, size_t bytes, int64_t *pts_us);
+
+/**
+ * 取得用于 poll 的描述符（snd_pcm_poll_descriptors）
+ *  fds: 输出数组，max: 数组容量
+ * 返回: 填充的个数，<0 表示出错
+ */
+int audio_capture_poll_fds(AudioCapture *ac, struct pollfd *fds, int max);
+
 /** 关闭设备，释放资源 */
 void audio_capture_close(AudioCapture *ac);
@@ -0,0 +1,450 @@
+// audio_enc.c
+#include "audio_enc.h"
+#include "log.h"
+#include "mem_arena.h"
+#include "pcm_convert.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * 编码器为可选依赖：make AAC=1 定义 RK_AAC_ENABLE 并链接 -lfdk-aac，
+ * make OPUS=1 定义 RK_OPUS_ENABLE 并链接 -lopus；头文件不存在时对应编码器不可用。
+ */
+#if defined(RK_AAC_ENABLE) && RK_AAC_ENABLE && defined(__has_include)
+#  if __has_include(<fdk-aac/aacenc_lib.h>)
+#    include <fdk-aac/aacenc_lib.h>
+#    define RK_AAC_AVAILABLE 1
+#  endif
+#endif
+#ifndef RK_AAC_AVAILABLE
+#  define RK_AAC_AVAILABLE 0
+#endif
+
+#if defined(RK_OPUS_ENABLE) && RK_OPUS_ENABLE && defined(__has_include)
+#  if __has_include(<opus/opus.h>)
+#    include <opus/opus.h>
+#    define RK_OPUS_AVAILABLE 1
+#  endif
+#endif
+#ifndef RK_OPUS_AVAILABLE
+#  define RK_OPUS_AVAILABLE 0
+#endif
+
+#define TAG "audio_enc"
+
+#define AUDIO_ENC_DEFAULT_MAX_FRAMES 4096
+#define AAC_MAX_PKT_PER_CH  768     // 每声道每帧上限 6144 bit（ISO/IEC 14496-3）
+#define OPUS_MAX_PKT        4000    // libopus 推荐的输出缓冲
+
+void audio_enc_default_opts(AudioEncOpts *opts)
+{
+    if (!opts) return;
+    memset(opts, 0, sizeof(*opts));
+    opts->codec       = AUDIO_CODEC_PCM;
+    opts->sample_rate = 48000;
+    opts->in_channels = 2;
+}
+
+int audio_enc_codec_from_name(const char *name, AudioCodec *codec)
+{
+    if (!name || !codec) return -1;
+    if (strcmp(name, "pcm") == 0) *codec = AUDIO_CODEC_PCM;
+    else if (strcmp(name, "aac") == 0) *codec = AUDIO_CODEC_AAC;
+    else if (strcmp(name, "opus") == 0) *codec = AUDIO_CODEC_OPUS;
+    else return -1;
+    return 0;
+}
+
+const char *audio_enc_codec_name(AudioCodec codec)
+{
+    switch (codec) {
+    case AUDIO_CODEC_PCM:  return "pcm";
+    case AUDIO_CODEC_AAC:  return "aac";
+    case AUDIO_CODEC_OPUS: return "opus";
+    default:               return "?";
+    }
+}
+
+int audio_enc_codec_available(AudioCodec codec)
+{
+    switch (codec) {
+    case AUDIO_CODEC_PCM:  return 1;
+    case AUDIO_CODEC_AAC:  return RK_AAC_AVAILABLE;
+    case AUDIO_CODEC_OPUS: return RK_OPUS_AVAILABLE;
+    default:               return 0;
+    }
+}
+
+/* ===================== 编码器后端 ===================== */
+/*
+ * 每个后端：open 设置 frame_size / max_pkt；encode 编一帧（samples 为每声道采样数，
+ * AAC 传 -1 表示取空延迟帧），返回输出字节数（0 = 本次没有出包），-1 失败。
+ */
+
+#if RK_AAC_AVAILABLE
+
+static int aac_open(AudioEnc *e, unsigned int bitrate)
+{
+    if (e->out_ch > 2) {
+        LOGE("[%s] aac: %u channels not supported (mono/stereo only)", TAG, e->out_ch);
+        return -1;
+    }
+    HANDLE_AACENCODER h = NULL;
+    if (aacEncOpen(&h, 0, e->out_ch) != AACENC_OK) return -1;
+    e->impl = h;
+
+    if (aacEncoder_SetParam(h, AACENC_AOT, 2) != AACENC_OK ||                  // AAC-LC
+        aacEncoder_SetParam(h, AACENC_SAMPLERATE, e->opts.sample_rate) != AACENC_OK ||
+        aacEncoder_SetParam(h, AACENC_CHANNELMODE, e->out_ch == 1 ? MODE_1 : MODE_2) != AACENC_OK ||
+        aacEncoder_SetParam(h, AACENC_CHANNELORDER, 1) != AACENC_OK ||          // WAV 交织顺序
+        aacEncoder_SetParam(h, AACENC_BITRATE, bitrate) != AACENC_OK ||
+        aacEncoder_SetParam(h, AACENC_TRANSMUX, TT_MP4_ADTS) != AACENC_OK ||
+        aacEncoder_SetParam(h, AACENC_AFTERBURNER, 1) != AACENC_OK) {
+        LOGE("[%s] aac: unsupported parameters (%uHz ch=%u %ubps)", TAG,
+             e->opts.sample_rate, e->out_ch, bitrate);
+        return -1;
+    }
+    if (aacEncEncode(h, NULL, NULL, NULL, NULL) != AACENC_OK) return -1;
+
+    AACENC_InfoStruct info;
+    memset(&info, 0, sizeof(info));
+    if (aacEncInfo(h, &info) != AACENC_OK) return -1;
+    e->frame_size = info.frameLength ? info.frameLength : 1024;
+    e->max_pkt    = info.maxOutBufBytes ? info.maxOutBufBytes : (size_t)AAC_MAX_PKT_PER_CH * e->out_ch;
+    return 0;
+}
+
+static int aac_encode(AudioEnc *e, const int16_t *pcm, int samples, uint8_t *out)
+{
+    void *in_ptr  = (void *)pcm;
+    int   in_id   = IN_AUDIO_DATA;
+    int   in_size = samples > 0 ? samples * (int)e->out_ch * 2 : 0;
+    int   in_el   = 2;
+    void *out_ptr  = out;
+    int   out_id   = OUT_BITSTREAM_DATA;
+    int   out_size = (int)e->max_pkt;
+    int   out_el   = 1;
+
+    AACENC_BufDesc in_buf = { 0 }, out_buf = { 0 };
+    in_buf.numBufs            = samples > 0 ? 1 : 0;
+    in_buf.bufs               = &in_ptr;
+    in_buf.bufferIdentifiers  = &in_id;
+    in_buf.bufSizes           = &in_size;
+    in_buf.bufElSizes         = &in_el;
+    out_buf.numBufs           = 1;
+    out_buf.bufs              = &out_ptr;
+    out_buf.bufferIdentifiers = &out_id;
+    out_buf.bufSizes          = &out_size;
+    out_buf.bufElSizes        = &out_el;
+
+    AACENC_InArgs  in_args  = { 0 };
+    AACENC_OutArgs out_args = { 0 };
+    in_args.numInSamples = samples > 0 ? samples * (int)e->out_ch : -1;
+
+    AACENC_ERROR err = aacEncEncode((HANDLE_AACENCODER)e->impl, &in_buf, &out_buf, &in_args, &out_args);
+    if (err == AACENC_ENCODE_EOF) return 0;
+    if (err != AACENC_OK) {
+        LOGE("[%s] aacEncEncode failed: 0x%x", TAG, (unsigned int)err);
+        return -1;
+    }
+    return out_args.numOutBytes;
+}
+
+static void aac_close(AudioEnc *e)
+{
+    HANDLE_AACENCODER h = (HANDLE_AACENCODER)e->impl;
+    if (h) aacEncClose(&h);
+}
+
+#else
+
+static int aac_open(AudioEnc *e, unsigned int bitrate)
+{
+    (void)e; (void)bitrate;
+    LOGE("[%s] built without fdk-aac (make AAC=1)", TAG);
+    return -1;
+}
+
+static int aac_encode(AudioEnc *e, const int16_t *pcm, int samples, uint8_t *out)
+{
+    (void)e; (void)pcm; (void)samples; (void)out;
+    return -1;
+}
+
+static void aac_close(AudioEnc *e)
+{
+    (void)e;
+}
+
+#endif
+
+#if RK_OPUS_AVAILABLE
+
+static int opus_open(AudioEnc *e, unsigned int bitrate)
+{
+    unsigned int sr = e->opts.sample_rate;
+    if (sr != 8000 && sr != 12000 && sr != 16000 && sr != 24000 && sr != 48000) {
+        LOGE("[%s] opus: %uHz not supported (8/12/16/24/48 kHz)", TAG, sr);
+        return -1;
+    }
+    if (e->out_ch > 2) {
+        LOGE("[%s] opus: %u channels not supported (mono/stereo only)", TAG, e->out_ch);
+        return -1;
+    }
+    int err = 0;
+    OpusEncoder *enc = opus_encoder_create((opus_int32)sr, (int)e->out_ch, OPUS_APPLICATION_AUDIO, &err);
+    if (!enc || err != OPUS_OK) {
+        LOGE("[%s] opus_encoder_create failed: %d", TAG, err);
+        return -1;
+    }
+    e->impl = enc;
+    opus_encoder_ctl(enc, OPUS_SET_BITRATE((opus_int32)bitrate));
+
+    e->frame_size = sr / 50;   // 20ms
+    e->max_pkt    = OPUS_MAX_PKT;
+    e->fbuf = (float *)mem_arena_alloc(MEM_STAGE_AUDIO, (size_t)e->frame_size * e->out_ch * sizeof(float), 0);
+    return e->fbuf ? 0 : -1;
+}
+
+static int opus_encode_frame(AudioEnc *e, const int16_t *pcm, int samples, uint8_t *out)
+{
+    if (samples <= 0) return 0;
+    pcm_s16_to_f32(pcm, e->fbuf, (size_t)samples * e->out_ch);
+    opus_int32 n = opus_encode_float((OpusEncoder *)e->impl, e->fbuf, samples, out, (opus_int32)e->max_pkt);
+    if (n < 0) {
+        LOGE("[%s] opus_encode_float failed: %d", TAG, (int)n);
+        return -1;
+    }
+    return (int)n;
+}
+
+static void opus_close(AudioEnc *e)
+{
+    if (e->impl) opus_encoder_destroy((OpusEncoder *)e->impl);
+}
+
+#else
+
+static int opus_open(AudioEnc *e, unsigned int bitrate)
+{
+    (void)e; (void)bitrate;
+    LOGE("[%s] built without libopus (make OPUS=1)", TAG);
+    return -1;
+}
+
+static int opus_encode_frame(AudioEnc *e, const int16_t *pcm, int samples, uint8_t *out)
+{
+    (void)e; (void)pcm; (void)samples; (void)out;
+    return -1;
+}
+
+static void opus_close(AudioEnc *e)
+{
+    (void)e;
+}
+
+#endif
+
+/* ===================== 帧缓冲与包队列 ===================== */
+
+static int64_t frames_to_us(const AudioEnc *e, uint64_t frames)
+{
+    return (int64_t)(frames * 1000000u / e->opts.sample_rate);
+}
+
+static void pts_push(AudioEnc *e, int64_t pts_us)
+{
+    if (e->pts_head - e->pts_tail >= AUDIO_ENC_PTS_QUEUE) e->pts_tail++;   // 不会发生：编码器延迟远小于队列
+    e->pts_q[e->pts_head++ % AUDIO_ENC_PTS_QUEUE] = pts_us;
+}
+
+static int64_t pts_pop(AudioEnc *e)
+{
+    if (e->pts_head == e->pts_tail) return e->last_pts + frames_to_us(e, e->frame_size);
+    return e->pts_q[e->pts_tail++ % AUDIO_ENC_PTS_QUEUE];
+}
+
+/* 给下一个包预留输出空间。@return 写入位置；包队列或缓冲已满返回 NULL */
+static uint8_t *out_reserve(AudioEnc *e)
+{
+    if (e->pkt_n >= e->pkt_cap || e->out_len + e->max_pkt > e->out_cap) return NULL;
+    return e->out + e->out_len;
+}
+
+static void out_commit(AudioEnc *e, size_t len, int64_t pts_us)
+{
+    AudioEncPacket *p = &e->pkts[e->pkt_n++];
+    p->data   = e->out + e->out_len;
+    p->len    = len;
+    p->pts_us = pts_us;
+    e->out_len += len;
+    e->last_pts = pts_us;
+    e->packets++;
+    e->bytes += len;
+}
+
+/* 编一帧（acc 或 samples<0 时的 AAC 延迟帧），出包则追加到本次的包队列。@return 0 成功；-1 失败 */
+static int encode_one(AudioEnc *e, const int16_t *pcm, int samples, int *got)
+{
+    uint8_t *dst = out_reserve(e);
+    if (!dst) {
+        LOGW("[%s] output queue full, frame dropped", TAG);
+        return 0;
+    }
+    if (samples > 0) pts_push(e, e->acc_pts);
+
+    int n = e->opts.codec == AUDIO_CODEC_AAC ? aac_encode(e, pcm, samples, dst)
+                                             : opus_encode_frame(e, pcm, samples, dst);
+    if (n < 0) return -1;
+    if (samples > 0) e->frames_in += (uint64_t)samples;
+    if (got) *got = n > 0;
+    if (n > 0) out_commit(e, (size_t)n, pts_pop(e));
+    return 0;
+}
+
+/* ===================== 对外接口 ===================== */
+
+int audio_enc_open(AudioEnc *e, const AudioEncOpts *opts)
+{
+    if (!e || !opts) return -1;
+    memset(e, 0, sizeof(*e));
+    e->opts = *opts;
+    if (!e->opts.max_input_frames) e->opts.max_input_frames = AUDIO_ENC_DEFAULT_MAX_FRAMES;
+
+    unsigned int in_ch = opts->in_channels;
+    e->out_ch = audio_enc_out_channels(opts);
+    if (!opts->sample_rate || in_ch < 1 || in_ch > 8 || (e->out_ch != in_ch && e->out_ch != 1)) {
+        LOGE("[%s] unsupported %uHz ch=%u -> %u", TAG, opts->sample_rate, in_ch, e->out_ch);
+        return -1;
+    }
+    e->gain_q12 = pcm_gain_q12(opts->gain_db);
+
+    unsigned int bitrate = opts->bitrate;
+    int ret = 0;
+    switch (opts->codec) {
+    case AUDIO_CODEC_PCM:
+        e->frame_size = 0;
+        e->max_pkt    = (size_t)e->opts.max_input_frames * e->out_ch * 2;
+        break;
+    case AUDIO_CODEC_AAC:
+        if (!bitrate) bitrate = 64000u * e->out_ch;
+        ret = aac_open(e, bitrate);
+        break;
+    case AUDIO_CODEC_OPUS:
+        if (!bitrate) bitrate = 48000u * e->out_ch;
+        ret = opus_open(e, bitrate);
+        break;
+    default:
+        ret = -1;
+        break;
+    }
+    if (ret != 0) {
+        audio_enc_close(e);
+        return -1;
+    }
+
+    /* 一次 put 最多凑满 max_input_frames / frame_size + 1 帧 */
+    e->pkt_cap = e->frame_size ? e->opts.max_input_frames / e->frame_size + 2 : 1;
+    e->out_cap = (size_t)e->pkt_cap * e->max_pkt;
+    e->out     = (uint8_t *)mem_arena_alloc(MEM_STAGE_AUDIO, e->out_cap, 0);
+    e->pkts    = (AudioEncPacket *)mem_arena_alloc(MEM_STAGE_AUDIO, e->pkt_cap * sizeof(*e->pkts), 0);
+    if (e->frame_size)
+        e->acc = (int16_t *)mem_arena_alloc(MEM_STAGE_AUDIO, (size_t)e->frame_size * e->out_ch * sizeof(int16_t), 0);
+    if (!e->out || !e->pkts || (e->frame_size && !e->acc)) {
+        audio_enc_close(e);
+        return -1;
+    }
+
+    LOGI("[%s] open %s %uHz ch=%u->%u gain=%.1fdB frame=%u bitrate=%u convert=%s", TAG,
+         audio_enc_codec_name(opts->codec), opts->sample_rate, in_ch, e->out_ch, opts->gain_db,
+         e->frame_size, opts->codec == AUDIO_CODEC_PCM ? 0 : bitrate, pcm_convert_impl());
+    return 0;
+}
+
+int audio_enc_put(AudioEnc *e, const uint8_t *pcm, size_t bytes, int64_t pts_us)
+{
+    if (!e || !e->out || !pcm) return -1;
+    e->pkt_n   = 0;
+    e->pkt_rd  = 0;
+    e->out_len = 0;
+
+    unsigned int in_ch = e->opts.in_channels;
+    size_t frames = bytes / ((size_t)in_ch * 2);
+    if (frames > e->opts.max_input_frames) {
+        LOGE("[%s] put %zu frames > max %u", TAG, frames, e->opts.max_input_frames);
+        return -1;
+    }
+    const int16_t *s = (const int16_t *)pcm;
+
+    if (!e->frame_size) {
+        /* PCM：转换后原样输出 */
+        if (pcm_convert_s16(s, (int16_t *)e->out, frames, in_ch, e->out_ch, e->gain_q12) != 0) return -1;
+        e->frames_in += frames;
+        out_commit(e, frames * e->out_ch * 2, pts_us);
+        return 1;
+    }
+
+    size_t done = 0;
+    while (done < frames) {
+        size_t n = frames - done;
+        if (n > e->frame_size - e->acc_frames) n = e->frame_size - e->acc_frames;
+        if (!e->acc_frames) e->acc_pts = pts_us + frames_to_us(e, done);
+        pcm_convert_s16(s + done * in_ch, e->acc + (size_t)e->acc_frames * e->out_ch, n,
+                        in_ch, e->out_ch, e->gain_q12);
+        e->acc_frames += (unsigned int)n;
+        done += n;
+        if (e->acc_frames == e->frame_size) {
+            if (encode_one(e, e->acc, (int)e->frame_size, NULL) != 0) return -1;
+            e->acc_frames = 0;
+        }
+    }
+    return (int)e->pkt_n;
+}
+
+int audio_enc_get(AudioEnc *e, AudioEncPacket *pkt)
+{
+    if (!e || !pkt || e->pkt_rd >= e->pkt_n) return -1;
+    *pkt = e->pkts[e->pkt_rd++];
+    return 0;
+}
+
+int audio_enc_flush(AudioEnc *e)
+{
+    if (!e || !e->out) return -1;
+    e->pkt_n   = 0;
+    e->pkt_rd  = 0;
+    e->out_len = 0;
+    if (!e->frame_size) return 0;
+
+    if (e->acc_frames) {
+        memset(e->acc + (size_t)e->acc_frames * e->out_ch, 0,
+               (size_t)(e->frame_size - e->acc_frames) * e->out_ch * sizeof(int16_t));
+        if (encode_one(e, e->acc, (int)e->frame_size, NULL) != 0) return -1;
+        e->acc_frames = 0;
+    }
+    if (e->opts.codec == AUDIO_CODEC_AAC) {
+        int got = 1;
+        while (got && e->pkt_n < e->pkt_cap) {
+            got = 0;
+            if (encode_one(e, NULL, -1, &got) != 0) return -1;
+        }
+    }
+    return (int)e->pkt_n;
+}
+
+void audio_enc_close(AudioEnc *e)
+{
+    if (!e) return;
+    if (e->out) {
+        LOGI("[%s] close %s frames=%llu packets=%llu bytes=%llu", TAG, audio_enc_codec_name(e->opts.codec),
+             (unsigned long long)e->frames_in, (unsigned long long)e->packets, (unsigned long long)e->bytes);
+    }
+    if (e->opts.codec == AUDIO_CODEC_AAC) aac_close(e);
+    else if (e->opts.codec == AUDIO_CODEC_OPUS) opus_close(e);
+    mem_arena_free(e->acc);
+    mem_arena_free(e->fbuf);
+    mem_arena_free(e->out);
+    mem_arena_free(e->pkts);
+    memset(e, 0, sizeof(*e));
+}
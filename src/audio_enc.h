@@ -0,0 +1,118 @@
+// audio_enc.h
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 音频编码阶段：AudioCapture 的 period -> 增益 / 下混（pcm_convert，NEON）-> AAC 或 Opus 编码 -> 带 PTS 的包。
+ *
+ * - 采样在转换时直接写进编码器的帧缓冲（AAC 1024 帧，Opus 20ms），凑满一帧就编码，
+ *   一次 put 送入整个 period，可能产出 0..N 个包，由 get 依次取出；
+ * - 包的 PTS 为该帧第一个采样的采集时间；编码器有延迟（FDK 前几帧不出包）时按提交顺序对应；
+ * - AAC 输出 ADTS 帧（可直接写 .aac 文件或封装进 TS），Opus 输出裸包（只能封装进 TS）；
+ * - PCM 编解码器只做增益 / 下混，每次 put 原样输出一个包，不引入延迟；
+ * - 编码器为可选依赖：AAC 需 make AAC=1（fdk-aac），Opus 需 make OPUS=1（libopus）；open 时分配全部缓冲。
+ *
+ * 非线程安全：put/get/flush 由音频线程调用。
+ */
+
+typedef enum {
+    AUDIO_CODEC_PCM = 0,
+    AUDIO_CODEC_AAC,
+    AUDIO_CODEC_OPUS,
+} AudioCodec;
+
+typedef struct {
+    AudioCodec   codec;
+    unsigned int sample_rate;
+    unsigned int in_channels;      // 输入 S16LE 交织声道数
+    unsigned int out_channels;     // 0 = 与输入相同；1 = 下混为单声道
+    unsigned int bitrate;          // bps；0 = 按声道取默认（AAC 64k/声道，Opus 48k/声道）
+    float        gain_db;          // 编码前增益（-60 .. +18）
+    unsigned int max_input_frames; // 一次 put 的最大帧数（period 大小），决定输出缓冲
+} AudioEncOpts;
+
+typedef struct {
+    const uint8_t *data;           // 在下一次 put / flush 之前有效
+    size_t         len;
+    int64_t        pts_us;
+} AudioEncPacket;
+
+#define AUDIO_ENC_PTS_QUEUE 16     // 已提交未出包的帧 PTS（覆盖编码器延迟）
+
+typedef struct {
+    AudioEncOpts    opts;
+    unsigned int    out_ch;
+    int32_t         gain_q12;
+    unsigned int    frame_size;    // 每个编码帧的采样帧数（PCM 为 0：不攒帧）
+    size_t          max_pkt;       // 单个包的最大字节数
+
+    int16_t        *acc;           // 正在攒的一帧（已转换）
+    unsigned int    acc_frames;
+    int64_t         acc_pts;
+    float          *fbuf;          // Opus：float 输入
+
+    uint8_t        *out;           // 本次 put 产出的包
+    size_t          out_cap;
+    size_t          out_len;
+    AudioEncPacket *pkts;
+    unsigned int    pkt_cap;
+    unsigned int    pkt_n;
+    unsigned int    pkt_rd;
+
+    int64_t         pts_q[AUDIO_ENC_PTS_QUEUE];
+    unsigned int    pts_head;
+    unsigned int    pts_tail;
+    int64_t         last_pts;      // 最近一个包的 PTS（FDK 尾部延迟帧没有对应的提交时按帧长递推）
+
+    void           *impl;          // HANDLE_AACENCODER / OpusEncoder *
+    uint64_t        frames_in;     // 已编码的采样帧数
+    uint64_t        packets;
+    uint64_t        bytes;
+} AudioEnc;
+
+void        audio_enc_default_opts(AudioEncOpts *opts);
+
+/* "pcm" / "aac" / "opus" -> AudioCodec。@return 0 成功；-1 未知名字 */
+int         audio_enc_codec_from_name(const char *name, AudioCodec *codec);
+const char *audio_enc_codec_name(AudioCodec codec);
+/* 本次构建是否带该编码器（PCM 总是可用） */
+int         audio_enc_codec_available(AudioCodec codec);
+
+/*
+ * 打开编码器并分配缓冲。
+ *
+ * @return  0 成功；-1 参数不支持或编码器初始化失败
+ */
+int  audio_enc_open(AudioEnc *e, const AudioEncOpts *opts);
+
+/*
+ * 送入一段 S16LE 交织 PCM（in_channels 声道，整帧）；之前取出的包随之失效。
+ *
+ * @param pts_us  第一个采样帧的 PTS
+ * @return        本次产出的包数（用 get 取出）；-1 编码失败
+ */
+int  audio_enc_put(AudioEnc *e, const uint8_t *pcm, size_t bytes, int64_t pts_us);
+
+/* 取下一个包。@return 0 取到；-1 没有了 */
+int  audio_enc_get(AudioEnc *e, AudioEncPacket *pkt);
+
+/* 把不足一帧的尾巴补零编码，并取空编码器内部延迟的帧。@return 产出的包数；-1 失败 */
+int  audio_enc_flush(AudioEnc *e);
+
+void audio_enc_close(AudioEnc *e);
+
+/* 编码后的声道数 */
+static inline unsigned int audio_enc_out_channels(const AudioEncOpts *opts)
+{
+    return opts->out_channels ? opts->out_channels : opts->in_channels;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -2,6 +2,36 @@
 #include "av_stats.h"
 #include "log.h"
 
+#include <string.h>
+#include <time.h>
+
+/* 直方图名称与单位（与 AvHistId 顺序一致） */
+static const struct {
+    const char *name;
+    int         is_time;   // 1=微秒（打印为 ms），0=计数
+} k_hist_info[AV_HIST_COUNT] = {
+    [AV_HIST_DQBUF_WAIT] = { "dqbuf",    1 },
+    [AV_HIST_COPY]       = { "copy",     1 },
+    [AV_HIST_SCALE]      = { "scale",    1 },
+    [AV_HIST_ENC_PUT]    = { "enc_put",  1 },
+    [AV_HIST_ENC_GET]    = { "enc_get",  1 },
+    [AV_HIST_ENCODE]     = { "encode",   1 },
+    [AV_HIST_SINK_WRITE] = { "sink_wr",  1 },
+    [AV_HIST_AUDIO_READ] = { "audio_rd", 1 },
+    [AV_HIST_AUDIO_ENC]  = { "audio_enc", 1 },
+    [AV_HIST_Q_ENC]      = { "q_enc",    0 },
+    [AV_HIST_Q_SINK]     = { "q_sink",   0 },
+    [AV_HIST_MOTION]     = { "motion",   1 },
+    [AV_HIST_FIRST_BYTE] = { "first_b",  1 },
+};
+
+static int64_t stats_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 /*
  * 初始化统计结构体：将各计数器清零。
  *
@@ -15,41 +45,346 @@ void av_stats_init(AvStats *s)
     atomic_store(&s->video_frames, 0);
     atomic_store(&s->enc_bytes, 0);
     atomic_store(&s->audio_chunks, 0);
+    atomic_store(&s->audio_xruns, 0);
+    atomic_store(&s->audio_ring_max, 0);
     atomic_store(&s->drop_count, 0);
+    atomic_store(&s->shed_count, 0);
+    atomic_store(&s->skip_count, 0);
+    atomic_store(&s->motion_max, 0);
+    atomic_store(&s->enc_queue_max, 0);
+    atomic_store(&s->sink_queue_max, 0);
+    atomic_store(&s->enc_lat_sum_us, 0);
+    atomic_store(&s->enc_lat_cnt, 0);
+    atomic_store(&s->enc_lat_max_us, 0);
+    atomic_store(&s->enc_inflight_max, 0);
+    atomic_store(&s->wakeups, 0);
+    atomic_store(&s->sink_backpressure, 0);
+    atomic_store(&s->sink_fill_max, 0);
+    atomic_store(&s->sink_write_max_us, 0);
+    atomic_store(&s->net_queue_max, 0);
+    atomic_store(&s->net_lat_max_us, 0);
+    atomic_store(&s->net_drop_gops, 0);
+    atomic_store(&s->v_clock_err_us, 0);
+    atomic_store(&s->a_clock_err_us, 0);
+    atomic_store(&s->v_jitter_max_us, 0);
+    atomic_store(&s->a_jitter_max_us, 0);
+    atomic_store(&s->clock_valid, 0);
+
+    for (int i = 0; i < AV_HIST_COUNT; i++) {
+        lat_hist_init(&s->hist[i]);
+        lat_hist_snap_reset(&s->win[i]);
+        lat_hist_snap_reset(&s->cum[i]);
+    }
+    s->start_us           = stats_now_us();
+    s->last_tick_us       = s->start_us;
+    s->total_frames       = 0;
+    s->total_bytes        = 0;
+    s->total_audio_chunks = 0;
+    s->total_audio_xruns  = 0;
+    s->total_drops        = 0;
+    s->total_shed         = 0;
+    s->total_skip         = 0;
+    s->total_wakeups      = 0;
+    s->total_sink_bp      = 0;
+    s->total_net_drop     = 0;
+    s->json_fp            = NULL;
+    s->label[0]           = '\0';
+    memset(&s->last, 0, sizeof(s->last));
+}
+
+void av_stats_set_json(AvStats *s, FILE *fp)
+{
+    if (s) s->json_fp = fp;
+}
+
+void av_stats_set_label(AvStats *s, const char *label)
+{
+    if (s) snprintf(s->label, sizeof(s->label), "%s", label ? label : "");
+}
+
+/* 行首标签："[STAT]" 或 "[STAT cam0]" */
+static const char *line_tag(const AvStats *s, const char *kind, char *buf, size_t cap)
+{
+    snprintf(buf, cap, s->label[0] ? "[%s %s]" : "[%s]", kind, s->label);
+    return buf;
+}
+
+const char *av_stats_hist_name(AvHistId id)
+{
+    return ((unsigned int)id < AV_HIST_COUNT) ? k_hist_info[id].name : "?";
+}
+
+int av_stats_hist_is_time(AvHistId id)
+{
+    return ((unsigned int)id < AV_HIST_COUNT) ? k_hist_info[id].is_time : 0;
+}
+
+/* 一个分布的 avg（单位同样本） */
+static double snap_avg(const LatHistSnap *h)
+{
+    return h->count ? (double)h->sum / (double)h->count : 0.0;
 }
 
 /*
- * 每秒打印一次统计信息。
+ * 拼接各阶段的 avg/p99/max（时间类为 ms，队列深度为个）；无样本的阶段跳过。
+ *
+ * @param snaps  AV_HIST_COUNT 个快照
+ */
+static void format_hist_line(char *buf, size_t cap, const LatHistSnap *snaps)
+{
+    size_t off = 0;
+    buf[0] = '\0';
+    for (int i = 0; i < AV_HIST_COUNT && off < cap; i++) {
+        const LatHistSnap *h = &snaps[i];
+        if (!h->count) continue;
+        double k = k_hist_info[i].is_time ? 1000.0 : 1.0;
+        int n = snprintf(buf + off, cap - off, " %s=%.1f/%.1f/%.1f", k_hist_info[i].name,
+                         snap_avg(h) / k, (double)lat_hist_percentile(h, 0.99) / k, (double)h->max / k);
+        if (n < 0) break;
+        off += (size_t)n;
+    }
+}
+
+/* 一个分布的 JSON 对象：本窗口 + 累计 */
+static void json_hist(FILE *fp, const char *name, const LatHistSnap *w, const LatHistSnap *c)
+{
+    fprintf(fp, "\"%s\":{\"n\":%llu,\"min\":%llu,\"avg\":%.1f,\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"max\":%llu,"
+                "\"total_n\":%llu,\"total_avg\":%.1f,\"total_p99\":%llu,\"total_max\":%llu}",
+            name,
+            (unsigned long long)w->count, (unsigned long long)w->min, snap_avg(w),
+            (unsigned long long)lat_hist_percentile(w, 0.50),
+            (unsigned long long)lat_hist_percentile(w, 0.90),
+            (unsigned long long)lat_hist_percentile(w, 0.99),
+            (unsigned long long)w->max,
+            (unsigned long long)c->count, snap_avg(c),
+            (unsigned long long)lat_hist_percentile(c, 0.99),
+            (unsigned long long)c->max);
+}
+
+/*
+ * 打印一个统计窗口。
  *
  * 设计：
- * - 使用 atomic_exchange 将计数器“读取并清零”，把累计值按 1 秒窗口输出。
- * - 这样多线程只负责累加，打印线程负责按周期归零，得到近似实时速率。
+ * - 使用 atomic_exchange 将计数器“读取并清零”，按窗口输出；多线程只负责累加。
+ * - 速率按两次调用之间实际经过的时间计算（reactor 等待可能提前/推迟返回），不假设正好 1 秒。
+ * - 直方图每个窗口交换清零后并入累计分布，累计值在 JSON 与退出时的 [TOTAL] 中输出。
  *
  * 指标解释：
- * - video_fps：过去 1 秒编码成功的视频帧数
- * - enc_bitrate：过去 1 秒编码输出字节数换算的 kbps（按 1000 进位）
- * - audio_chunks_per_sec：过去 1 秒写入的音频 chunk 数
- * - drop_count：过去 1 秒检测到的丢帧/异常次数
+ * - video_fps：窗口内编码成功的视频帧数 / 经过时间
+ * - enc_bitrate：窗口内编码输出字节数换算的 kbps（按 1000 进位）
+ * - audio_chunks_per_sec：窗口内写入的音频 chunk 数 / 经过时间
+ * - drop_count：窗口内检测到的丢帧/异常次数
+ * - v_shed：其中按 --drop-policy 主动丢弃的视频帧（其余为驱动丢帧、背压丢弃等）
+ * - v_motion / v_skip：--motion 时窗口内的最大运动 score（变化块占比 %）、跳过的静止帧数（不计入 drop）
+ * - a_xrun / a_ring：窗口内音频采集 overrun 次数、PCM 采集环最大积压（period 数，未启用采集环时为 0）
+ * - q_enc / q_sink：窗口内流水线各级队列的最大深度（越接近容量越说明下游跟不上）
+ * - enc_lat：窗口内每帧编码延迟（提交 -> 取到 packet）的平均/最大值，单位 ms
+ * - inflight：窗口内编码器内同时在途的最大帧数
+ * - wakeups：窗口内各线程从 poll/信号量等待中返回的总次数（衡量空闲时的 CPU 唤醒开销）
+ * - sink_fill / sink_bp / sink_wr_max：异步 sink 环内最大积压、被背压拒绝的次数、单次批量写最大耗时
+ * - net_q / net_lat / net_drop：推流发送队列最大积压、采集到写入 ffmpeg 管道的最大延迟、丢弃的 GOP 数
+ * - av_drift：按帧数/采样数定速回放时视频相对音频的偏移（视频 PTS 偏差 - 音频 PTS 偏差），
+ *   正值表示视频落后于音频；两路都有数据前为 0
+ * - v_jit / a_jit：窗口内相邻两帧/两段 PCM 的 PTS 间隔与名义间隔之差的最大值
+ * - [LAT]：各阶段 avg/p99/max（见 AvHistId）
  *
  * @param s  统计对象指针
  */
 void av_stats_tick_print(AvStats *s)
 {
     if (!s) return;
+    int64_t  now       = stats_now_us();
+    int64_t  dt_us     = now - s->last_tick_us;
+    s->last_tick_us    = now;
+    if (dt_us <= 0) dt_us = 1;
+    double   dt        = (double)dt_us / 1e6;
+
     uint64_t frames = atomic_exchange(&s->video_frames, 0);
     uint64_t bytes  = atomic_exchange(&s->enc_bytes, 0);
     uint64_t achk   = atomic_exchange(&s->audio_chunks, 0);
+    uint64_t axrun  = atomic_exchange(&s->audio_xruns, 0);
+    uint64_t aring  = atomic_exchange(&s->audio_ring_max, 0);
     uint64_t drops  = atomic_exchange(&s->drop_count, 0);
+    uint64_t shed   = atomic_exchange(&s->shed_count, 0);
+    uint64_t skip   = atomic_exchange(&s->skip_count, 0);
+    uint64_t motion = atomic_exchange(&s->motion_max, 0);
+    uint64_t q_enc  = atomic_exchange(&s->enc_queue_max, 0);
+    uint64_t q_sink = atomic_exchange(&s->sink_queue_max, 0);
+    uint64_t lat_sum = atomic_exchange(&s->enc_lat_sum_us, 0);
+    uint64_t lat_cnt = atomic_exchange(&s->enc_lat_cnt, 0);
+    uint64_t lat_max = atomic_exchange(&s->enc_lat_max_us, 0);
+    uint64_t inflight = atomic_exchange(&s->enc_inflight_max, 0);
+    uint64_t wakeups  = atomic_exchange(&s->wakeups, 0);
+    uint64_t sink_bp   = atomic_exchange(&s->sink_backpressure, 0);
+    uint64_t sink_fill = atomic_exchange(&s->sink_fill_max, 0);
+    uint64_t sink_wr   = atomic_exchange(&s->sink_write_max_us, 0);
+    uint64_t net_q     = atomic_exchange(&s->net_queue_max, 0);
+    uint64_t net_lat   = atomic_exchange(&s->net_lat_max_us, 0);
+    uint64_t net_drop  = atomic_exchange(&s->net_drop_gops, 0);
+    uint64_t v_jit     = atomic_exchange(&s->v_jitter_max_us, 0);
+    uint64_t a_jit     = atomic_exchange(&s->a_jitter_max_us, 0);
+    int64_t  drift_us  = 0;
+    if (atomic_load(&s->clock_valid) == 3)
+        drift_us = (int64_t)atomic_load(&s->v_clock_err_us) - (int64_t)atomic_load(&s->a_clock_err_us);
+    double   lat_avg_ms = lat_cnt ? (double)lat_sum / (double)lat_cnt / 1000.0 : 0.0;
+
+    for (int i = 0; i < AV_HIST_COUNT; i++) {
+        lat_hist_drain(&s->hist[i], &s->win[i]);
+        lat_hist_snap_merge(&s->cum[i], &s->win[i]);
+    }
+    s->total_frames       += frames;
+    s->total_bytes        += bytes;
+    s->total_audio_chunks += achk;
+    s->total_audio_xruns  += axrun;
+    s->total_drops        += drops;
+    s->total_shed         += shed;
+    s->total_skip         += skip;
+    s->total_wakeups      += wakeups;
+    s->total_sink_bp      += sink_bp;
+    s->total_net_drop     += net_drop;
+
+    AvStatsWindow *w = &s->last;
+    w->dt_us          = dt_us;
+    w->frames         = frames;
+    w->bytes          = bytes;
+    w->drops          = drops;
+    w->q_sink         = q_sink;
+    w->sink_bp        = sink_bp;
+    w->sink_fill      = sink_fill;
+    w->net_q          = net_q;
+    w->net_lat_us     = net_lat;
+    w->net_drop       = net_drop;
+    w->audio_chunks   = achk;
+    w->audio_xruns    = axrun;
+    w->q_enc          = q_enc;
+    w->inflight       = inflight;
+    w->wakeups        = wakeups;
+    w->motion         = motion;
+    w->enc_lat_max_us = lat_max;
+    w->av_drift_us    = drift_us;
+
+    double fps  = (double)frames / dt;
+    double kbps = (double)bytes * 8.0 / 1000.0 / dt;
+    double acps = (double)achk / dt;
+
+    char tag[48];
+    LOGI("%s video_fps=%.1f enc_bitrate=%.0fkbps audio_chunks_per_sec=%.1f a_xrun=%llu a_ring=%llu"
+         " drop_count=%llu v_shed=%llu v_motion=%llu v_skip=%llu q_enc=%llu q_sink=%llu enc_lat_avg=%.1fms enc_lat_max=%.1fms inflight=%llu wakeups=%llu"
+         " sink_fill=%lluKB sink_bp=%llu sink_wr_max=%.1fms net_q=%lluKB net_lat=%.1fms net_drop=%llu"
+         " av_drift=%+.1fms v_jit=%.1fms a_jit=%.1fms",
+         line_tag(s, "STAT", tag, sizeof(tag)), fps, kbps, acps,
+         (unsigned long long)axrun,
+         (unsigned long long)aring,
+         (unsigned long long)drops,
+         (unsigned long long)shed,
+         (unsigned long long)motion,
+         (unsigned long long)skip,
+         (unsigned long long)q_enc,
+         (unsigned long long)q_sink,
+         lat_avg_ms, (double)lat_max / 1000.0,
+         (unsigned long long)inflight,
+         (unsigned long long)wakeups,
+         (unsigned long long)(sink_fill >> 10),
+         (unsigned long long)sink_bp,
+         (double)sink_wr / 1000.0,
+         (unsigned long long)(net_q >> 10),
+         (double)net_lat / 1000.0,
+         (unsigned long long)net_drop,
+         (double)drift_us / 1000.0,
+         (double)v_jit / 1000.0,
+         (double)a_jit / 1000.0);
+
+    char line[1024];
+    format_hist_line(line, sizeof(line), s->win);
+    if (line[0]) LOGI("%s avg/p99/max(ms)%s", line_tag(s, "LAT", tag, sizeof(tag)), line);
+
+    if (s->json_fp) {
+        FILE *fp = s->json_fp;
+        fputc('{', fp);
+        if (s->label[0]) fprintf(fp, "\"channel\":\"%s\",", s->label);
+        fprintf(fp, "\"t_ms\":%lld,\"interval_ms\":%.1f,\"video_fps\":%.2f,\"enc_kbps\":%.1f,"
+                    "\"audio_chunks_per_sec\":%.2f,\"audio_xruns\":%llu,\"audio_ring_max\":%llu,\"drops\":%llu,\"shed\":%llu,\"motion_max\":%llu,\"skip\":%llu,\"q_enc_max\":%llu,\"q_sink_max\":%llu,"
+                    "\"inflight_max\":%llu,\"wakeups\":%llu,\"sink_fill_kb\":%llu,\"sink_bp\":%llu,"
+                    "\"net_q_kb\":%llu,\"net_lat_max_ms\":%.1f,\"net_drop_gops\":%llu,\"av_drift_ms\":%.1f,"
+                    "\"totals\":{\"video_frames\":%llu,\"enc_bytes\":%llu,\"audio_chunks\":%llu,\"audio_xruns\":%llu,\"drops\":%llu,\"shed\":%llu,\"skip\":%llu},"
+                    "\"hist\":{",
+                (long long)((now - s->start_us) / 1000), (double)dt_us / 1000.0, fps, kbps, acps,
+                (unsigned long long)axrun, (unsigned long long)aring,
+                (unsigned long long)drops, (unsigned long long)shed,
+                (unsigned long long)motion, (unsigned long long)skip,
+                (unsigned long long)q_enc, (unsigned long long)q_sink,
+                (unsigned long long)inflight, (unsigned long long)wakeups,
+                (unsigned long long)(sink_fill >> 10), (unsigned long long)sink_bp,
+                (unsigned long long)(net_q >> 10), (double)net_lat / 1000.0, (unsigned long long)net_drop,
+                (double)drift_us / 1000.0,
+                (unsigned long long)s->total_frames, (unsigned long long)s->total_bytes,
+                (unsigned long long)s->total_audio_chunks, (unsigned long long)s->total_audio_xruns,
+                (unsigned long long)s->total_drops, (unsigned long long)s->total_shed,
+                (unsigned long long)s->total_skip);
+        for (int i = 0; i < AV_HIST_COUNT; i++) {
+            if (i) fputc(',', fp);
+            json_hist(fp, k_hist_info[i].name, &s->win[i], &s->cum[i]);
+        }
+        fputs("}}\n", fp);
+        fflush(fp);
+    }
+}
+
+/*
+ * 导出快照：累计计数直接取 total_*，直方图的 count/sum 取累计分布、分位数取最近一个窗口
+ * （与 Prometheus summary 的约定一致：_count/_sum 单调递增，quantile 反映近况）。
+ */
+void av_stats_export(const AvStats *s, AvStatsExport *out)
+{
+    if (!s || !out) return;
+    memset(out, 0, sizeof(*out));
+    snprintf(out->label, sizeof(out->label), "%s", s->label);
+    out->uptime_us     = s->last_tick_us - s->start_us;
+    out->video_frames  = s->total_frames;
+    out->enc_bytes     = s->total_bytes;
+    out->audio_chunks  = s->total_audio_chunks;
+    out->audio_xruns   = s->total_audio_xruns;
+    out->drops         = s->total_drops;
+    out->shed          = s->total_shed;
+    out->skip          = s->total_skip;
+    out->wakeups       = s->total_wakeups;
+    out->sink_bp       = s->total_sink_bp;
+    out->net_drop_gops = s->total_net_drop;
+    out->last          = s->last;
+    for (int i = 0; i < AV_HIST_COUNT; i++) {
+        const LatHistSnap *w = &s->win[i];
+        AvStatsHistExport *h = &out->hist[i];
+        h->count     = s->cum[i].count;
+        h->sum       = s->cum[i].sum;
+        h->win_count = w->count;
+        h->p50       = lat_hist_percentile(w, 0.50);
+        h->p90       = lat_hist_percentile(w, 0.90);
+        h->p99       = lat_hist_percentile(w, 0.99);
+        h->max       = w->max;
+    }
+}
+
+/*
+ * 打印累计值：总帧数/字节数/平均码率，以及各阶段启动以来的 avg/p99/max。
+ */
+void av_stats_print_totals(AvStats *s)
+{
+    if (!s) return;
+    double secs = (double)(s->last_tick_us - s->start_us) / 1e6;
+    char tag[48];
+    line_tag(s, "TOTAL", tag, sizeof(tag));
+    LOGI("%s sec=%.1f video_frames=%llu enc_bytes=%llu avg_kbps=%.0f audio_chunks=%llu audio_xruns=%llu drops=%llu shed=%llu skip=%llu",
+         tag, secs,
+         (unsigned long long)s->total_frames,
+         (unsigned long long)s->total_bytes,
+         secs > 0 ? (double)s->total_bytes * 8.0 / 1000.0 / secs : 0.0,
+         (unsigned long long)s->total_audio_chunks,
+         (unsigned long long)s->total_audio_xruns,
+         (unsigned long long)s->total_drops,
+         (unsigned long long)s->total_shed,
+         (unsigned long long)s->total_skip);
 
-    /*
-     * 假设 tick 周期为 1 秒：
-     * kbps = (bytes * 8) / 1000
-     */
-    uint64_t kbps = (bytes * 8) / 1000; // assume 1s
-
-    LOGI("[STAT] video_fps=%llu enc_bitrate=%llukbps audio_chunks_per_sec=%llu drop_count=%llu",
-         (unsigned long long)frames,
-         (unsigned long long)kbps,
-         (unsigned long long)achk,
-         (unsigned long long)drops);
+    char line[1024];
+    format_hist_line(line, sizeof(line), s->cum);
+    if (line[0]) LOGI("%s avg/p99/max(ms)%s", tag, line);
 }
@@ -3,20 +3,172 @@
 
 #include <stdatomic.h>
 #include <stdint.h>
+#include <stdio.h>
+
+#include "lat_hist.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/*
+ * 分阶段直方图。约定每个直方图只由一个线程写入（括号内为写入线程），
+ * 时间类单位为微秒，队列深度类单位为个。
+ */
+typedef enum {
+    AV_HIST_DQBUF_WAIT = 0,  // 采集：开始等待 -> DQBUF 成功（capture）
+    AV_HIST_COPY,            // 编码提交：repack 进 MPP 输入 buffer（encode，仅拷贝路径）
+    AV_HIST_SCALE,           // simulcast：缩放进子码流输入 buffer（RGA 或 CPU 回退）
+    AV_HIST_ENC_PUT,         // 编码提交：encode_put_frame 调用（encode）
+    AV_HIST_ENC_GET,         // 取包：返回 packet 的 encode_get_packet 调用（packet）
+    AV_HIST_ENCODE,          // 提交 -> 取到 packet（packet）
+    AV_HIST_SINK_WRITE,      // 写出：enc_sink_write_ex，含背压等待（sink）
+    AV_HIST_AUDIO_READ,      // 音频：开始等待 -> 读到一个 period（audio）
+    AV_HIST_AUDIO_ENC,       // 音频：一个 period 的转换 + 编码（audio_enc_put，仅编码阶段启用时）
+    AV_HIST_Q_ENC,           // 采集 -> 编码队列入队后深度（capture）
+    AV_HIST_Q_SINK,          // 取包 -> 写出队列入队后深度（packet）
+    AV_HIST_MOTION,          // --motion：一帧的抽样 + 分块比较（capture）
+    AV_HIST_FIRST_BYTE,      // 采集时刻 -> 这一帧的第一个字节交给 sink（sink；--enc-slices 时为开头一片）
+    AV_HIST_COUNT
+} AvHistId;
+
+/* 最近一个统计窗口的计数（由 av_stats_tick_print 填写，供同一线程里的控制逻辑使用，例如 abr） */
+typedef struct {
+    int64_t  dt_us;          // 窗口时长
+    uint64_t frames;
+    uint64_t bytes;
+    uint64_t drops;
+    uint64_t q_sink;         // 编码 -> 写出队列最大深度
+    uint64_t sink_bp;
+    uint64_t sink_fill;      // 字节
+    uint64_t net_q;          // 字节
+    uint64_t net_lat_us;
+    uint64_t net_drop;
+    uint64_t audio_chunks;
+    uint64_t audio_xruns;
+    uint64_t q_enc;          // 采集 -> 编码队列最大深度
+    uint64_t inflight;
+    uint64_t wakeups;
+    uint64_t motion;         // --motion 最大 score
+    uint64_t enc_lat_max_us;
+    int64_t  av_drift_us;
+} AvStatsWindow;
+
+/* 一个直方图的导出值：累计计数与总和，分位数取最近一个窗口（win_count 为 0 时无意义） */
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t win_count;
+    uint64_t p50, p90, p99, max;
+} AvStatsHistExport;
+
+/*
+ * 一路统计的导出快照（av_stats_export 填写，见 metrics_http.h）：
+ * 纯数据，可以整体拷贝给其他线程，读取方不接触 AvStats 本身。
+ */
+typedef struct {
+    char              label[32];
+    int64_t           uptime_us;
+    uint64_t          video_frames;    // 以下为启动以来累计
+    uint64_t          enc_bytes;
+    uint64_t          audio_chunks;
+    uint64_t          audio_xruns;
+    uint64_t          drops;
+    uint64_t          shed;
+    uint64_t          skip;
+    uint64_t          wakeups;
+    uint64_t          sink_bp;
+    uint64_t          net_drop_gops;
+    AvStatsWindow     last;            // 最近一个窗口
+    AvStatsHistExport hist[AV_HIST_COUNT];
+} AvStatsExport;
+
 typedef struct {
     atomic_uint_fast64_t video_frames;   // per 1s
     atomic_uint_fast64_t enc_bytes;      // per 1s
     atomic_uint_fast64_t audio_chunks;   // per 1s
+    atomic_uint_fast64_t audio_xruns;    // per 1s，采集设备 overrun（含合成源读得太慢）
+    atomic_uint_fast64_t audio_ring_max; // per 1s，PCM 采集环内最大积压（period 数）
     atomic_uint_fast64_t drop_count;     // per 1s
+    atomic_uint_fast64_t shed_count;     // per 1s，--drop-policy 主动丢弃的视频帧（同时计入 drop_count）
+    atomic_uint_fast64_t skip_count;     // per 1s，--motion skip 跳过的静止帧（不计入 drop_count）
+    atomic_uint_fast64_t motion_max;     // per 1s，--motion 的最大 score（0..100）
+
+    /* 流水线队列深度（per 1s 窗口内观测到的最大值） */
+    atomic_uint_fast64_t enc_queue_max;  // 采集 -> 编码
+    atomic_uint_fast64_t sink_queue_max; // 编码 -> 写出
+
+    /* 编码延迟（提交 -> 取到 packet，per 1s） */
+    atomic_uint_fast64_t enc_lat_sum_us;
+    atomic_uint_fast64_t enc_lat_cnt;
+    atomic_uint_fast64_t enc_lat_max_us;
+    atomic_uint_fast64_t enc_inflight_max; // 编码器内在途帧数最大值
+
+    atomic_uint_fast64_t wakeups;        // per 1s，各线程从等待中返回的次数
+
+    /* 异步 sink（per 1s） */
+    atomic_uint_fast64_t sink_backpressure; // 超过高水位被拒绝的写入次数
+    atomic_uint_fast64_t sink_fill_max;     // 环内待写字节数最大值
+    atomic_uint_fast64_t sink_write_max_us; // 单次批量写耗时最大值
+
+    /* 推流 sink（per 1s，见 sink_pipe.h） */
+    atomic_uint_fast64_t net_queue_max;     // 发送队列字节数最大值
+    atomic_uint_fast64_t net_lat_max_us;    // 采集 -> 交给 ffmpeg 的最大延迟
+    atomic_uint_fast64_t net_drop_gops;     // 超延迟/队列满时丢弃的 GOP 数
+
+    /*
+     * 媒体时钟（见 media_clock.h）：
+     * *_clock_err_us 为最新值（不清零），*_jitter_max_us 为 per 1s 最大值
+     */
+    atomic_int_fast64_t  v_clock_err_us;
+    atomic_int_fast64_t  a_clock_err_us;
+    atomic_uint_fast64_t v_jitter_max_us;
+    atomic_uint_fast64_t a_jitter_max_us;
+    atomic_int           clock_valid;       // bit0=视频已有数据，bit1=音频已有数据
+
+    LatHist              hist[AV_HIST_COUNT];
+
+    /* 以下仅统计线程（av_stats_tick_print）读写 */
+    int64_t              start_us;
+    int64_t              last_tick_us;
+    uint64_t             total_frames;
+    uint64_t             total_bytes;
+    uint64_t             total_audio_chunks;
+    uint64_t             total_audio_xruns;
+    uint64_t             total_drops;
+    uint64_t             total_shed;
+    uint64_t             total_skip;
+    uint64_t             total_wakeups;
+    uint64_t             total_sink_bp;
+    uint64_t             total_net_drop;
+    LatHistSnap          win[AV_HIST_COUNT];  // 本窗口快照
+    LatHistSnap          cum[AV_HIST_COUNT];  // 启动以来累计
+    AvStatsWindow        last;                // 最近一个窗口
+    FILE                *json_fp;             // 非 NULL 时每个窗口追加一行 JSON
+    char                 label[32];           // 通道名（--channels）；非空时输出为 [STAT <label>]，JSON 带 "channel"
 } AvStats;
 
 void av_stats_init(AvStats *s);
+/*
+ * 打印一个统计窗口：[STAT] 计数与速率（按实际经过时间计算）、[LAT] 各阶段 avg/p99/max，
+ * 设置了 JSON 输出时再追加一行 JSON 快照（含累计值）。
+ */
 void av_stats_tick_print(AvStats *s);
+/* 打印启动以来的累计值与各阶段分布（退出前调用一次）。 */
+void av_stats_print_totals(AvStats *s);
+/* 取一份导出快照（累计值、最近一个窗口、各直方图）。与 av_stats_tick_print 同一线程调用。 */
+void av_stats_export(const AvStats *s, AvStatsExport *out);
+/* 设置 JSON Lines 快照输出（NULL 关闭；文件由调用者打开/关闭）。多个 AvStats 可共用一个文件（同一线程输出）。 */
+void av_stats_set_json(AvStats *s, FILE *fp);
+/* 设置通道名（NULL / "" 为不带标签，与单通道输出一致）。 */
+void av_stats_set_label(AvStats *s, const char *label);
+/* 直方图名称（[LAT] / JSON 中使用的 key）与单位：1=微秒，0=计数。 */
+const char *av_stats_hist_name(AvHistId id);
+int         av_stats_hist_is_time(AvHistId id);
+
+static inline void av_stats_record(AvStats *s, AvHistId id, uint64_t v) {
+    lat_hist_record(&s->hist[id], v);
+}
 
 static inline void av_stats_inc_video_frame(AvStats *s) {
     atomic_fetch_add_explicit(&s->video_frames, 1, memory_order_relaxed);
@@ -27,9 +179,47 @@ static inline void av_stats_add_enc_bytes(AvStats *s, uint64_t bytes) {
 static inline void av_stats_inc_audio_chunk(AvStats *s) {
     atomic_fetch_add_explicit(&s->audio_chunks, 1, memory_order_relaxed);
 }
+static inline void av_stats_inc_audio_xrun(AvStats *s) {
+    atomic_fetch_add_explicit(&s->audio_xruns, 1, memory_order_relaxed);
+}
 static inline void av_stats_add_drop(AvStats *s, uint64_t n) {
     atomic_fetch_add_explicit(&s->drop_count, n, memory_order_relaxed);
 }
+/* 按丢帧策略主动丢弃：计入 drop 的同时单独计数，与驱动丢帧（sequence 跳变）区分 */
+static inline void av_stats_add_shed(AvStats *s, uint64_t n) {
+    atomic_fetch_add_explicit(&s->drop_count, n, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->shed_count, n, memory_order_relaxed);
+}
+/* --motion skip 跳过的静止帧：画面没有变化、有意不编码，不是丢帧 */
+static inline void av_stats_add_skip(AvStats *s, uint64_t n) {
+    atomic_fetch_add_explicit(&s->skip_count, n, memory_order_relaxed);
+}
+/* 记录一个观测值，保留窗口内最大值（CAS 循环，仅在变大时写入）。 */
+static inline void av_stats_observe_max(atomic_uint_fast64_t *slot, uint64_t v) {
+    uint_fast64_t cur = atomic_load_explicit(slot, memory_order_relaxed);
+    while (v > cur &&
+           !atomic_compare_exchange_weak_explicit(slot, &cur, v,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed)) {
+    }
+}
+
+static inline void av_stats_add_enc_latency(AvStats *s, uint64_t us) {
+    atomic_fetch_add_explicit(&s->enc_lat_sum_us, us, memory_order_relaxed);
+    atomic_fetch_add_explicit(&s->enc_lat_cnt, 1, memory_order_relaxed);
+    av_stats_observe_max(&s->enc_lat_max_us, us);
+    lat_hist_record(&s->hist[AV_HIST_ENCODE], us);
+}
+/* 更新一路流的时钟偏差与抖动（audio=0 视频，1 音频） */
+static inline void av_stats_set_clock(AvStats *s, int audio, int64_t err_us, int64_t jitter_us) {
+    atomic_store_explicit(audio ? &s->a_clock_err_us : &s->v_clock_err_us, err_us, memory_order_relaxed);
+    av_stats_observe_max(audio ? &s->a_jitter_max_us : &s->v_jitter_max_us,
+                         (uint64_t)(jitter_us > 0 ? jitter_us : 0));
+    atomic_fetch_or_explicit(&s->clock_valid, audio ? 2 : 1, memory_order_relaxed);
+}
+static inline void av_stats_inc_wakeup(AvStats *s) {
+    atomic_fetch_add_explicit(&s->wakeups, 1, memory_order_relaxed);
+}
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,178 @@
+// capture_source.c
+#include "capture_source.h"
+#include "log.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#define TAG "src"
+
+int capture_source_type_from_name(const char *name, CaptureSourceType *out)
+{
+    if (!name || !out) return -1;
+    if (strcmp(name, "v4l2") == 0 || strcmp(name, "alsa") == 0 || strcmp(name, "device") == 0) {
+        *out = CAPTURE_SRC_DEVICE;
+    } else if (strcmp(name, "synthetic") == 0) {
+        *out = CAPTURE_SRC_SYNTHETIC;
+    } else if (strcmp(name, "replay") == 0) {
+        *out = CAPTURE_SRC_REPLAY;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+const char *capture_source_name(CaptureSourceType type)
+{
+    switch (type) {
+    case CAPTURE_SRC_SYNTHETIC: return "synthetic";
+    case CAPTURE_SRC_REPLAY:    return "replay";
+    default:                    return "device";
+    }
+}
+
+/* ===================== Pacer ===================== */
+
+int capture_pacer_open(CapturePacer *p, int realtime, int64_t period_us)
+{
+    if (!p) return -1;
+    p->realtime  = realtime;
+    p->period_us = period_us > 0 ? period_us : 1;
+    p->fd = realtime ? timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)
+                     : eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (p->fd < 0) {
+        LOGE("[%s] %s failed: %s", TAG, realtime ? "timerfd_create" : "eventfd", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int capture_pacer_start(CapturePacer *p)
+{
+    if (!p || p->fd < 0) return -1;
+    if (!p->realtime) return 0;
+
+    struct itimerspec its;
+    its.it_interval.tv_sec  = p->period_us / 1000000;
+    its.it_interval.tv_nsec = (p->period_us % 1000000) * 1000;
+    its.it_value = its.it_interval;
+    if (timerfd_settime(p->fd, 0, &its, NULL) != 0) {
+        LOGE("[%s] timerfd_settime failed: %s", TAG, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+uint64_t capture_pacer_take(CapturePacer *p)
+{
+    if (!p || p->fd < 0) return 0;
+    uint64_t n = 0;
+    if (read(p->fd, &n, sizeof(n)) != (ssize_t)sizeof(n)) return 0;
+    return n;
+}
+
+void capture_pacer_kick(CapturePacer *p)
+{
+    if (!p || p->fd < 0 || p->realtime) return;
+    uint64_t one = 1;
+    ssize_t r = write(p->fd, &one, sizeof(one));
+    (void)r;
+}
+
+void capture_pacer_close(CapturePacer *p)
+{
+    if (!p) return;
+    if (p->fd >= 0) close(p->fd);
+    p->fd = -1;
+}
+
+/* ===================== Synthetic content ===================== */
+
+/* 8 条彩条的 (U, V)：白 黄 青 绿 品 红 蓝 黑（BT.601 近似值） */
+static const uint8_t k_bar_uv[8][2] = {
+    { 128, 128 }, {  16, 146 }, { 166,  16 }, {  54,  34 },
+    { 202, 222 }, {  90, 240 }, { 240, 110 }, { 128, 128 },
+};
+
+void capture_source_synth_nv12(const Nv12Planes *dst, unsigned int width, unsigned int height,
+                               uint64_t seq, int with_uv)
+{
+    if (!dst || !dst->y || !width || !height) return;
+
+    /* Y：16..235 的锯齿斜纹，每帧整体右移 2 像素，编码器有稳定的运动可估计 */
+    unsigned int shift = (unsigned int)(seq * 2);
+    for (unsigned int r = 0; r < height; r++) {
+        uint8_t *row = dst->y + (size_t)r * dst->y_stride;
+        unsigned int base = r + shift;
+        for (unsigned int x = 0; x < width; x++)
+            row[x] = (uint8_t)(16 + ((((x + base) & 0xff) * 219) >> 8));
+    }
+
+    if (!with_uv || !dst->uv) return;
+    for (unsigned int r = 0; r < height / 2; r++) {
+        uint8_t *row = dst->uv + (size_t)r * dst->uv_stride;
+        for (unsigned int x = 0; x + 1 < width; x += 2) {
+            unsigned int bar = x * 8 / width;
+            row[x]     = k_bar_uv[bar][0];
+            row[x + 1] = k_bar_uv[bar][1];
+        }
+    }
+}
+
+/* 一个周期 64 点的正弦，幅度 8192（-12dBFS） */
+static const int16_t k_sine64[64] = {
+         0,    803,   1598,   2378,   3135,   3862,   4551,   5197,
+      5793,   6333,   6811,   7225,   7568,   7839,   8035,   8153,
+      8192,   8153,   8035,   7839,   7568,   7225,   6811,   6333,
+      5793,   5197,   4551,   3862,   3135,   2378,   1598,    803,
+         0,   -803,  -1598,  -2378,  -3135,  -3862,  -4551,  -5197,
+     -5793,  -6333,  -6811,  -7225,  -7568,  -7839,  -8035,  -8153,
+     -8192,  -8153,  -8035,  -7839,  -7568,  -7225,  -6811,  -6333,
+     -5793,  -5197,  -4551,  -3862,  -3135,  -2378,  -1598,   -803,
+};
+
+void capture_source_synth_pcm(int16_t *dst, size_t frames, int channels, unsigned int rate,
+                              uint32_t *phase)
+{
+    if (!dst || !phase || channels <= 0 || !rate) return;
+
+    /* 32 位相位累加器，高 6 位查表 */
+    uint32_t step = (uint32_t)((1000ull << 32) / rate);
+    uint32_t ph = *phase;
+    for (size_t i = 0; i < frames; i++) {
+        int16_t s = k_sine64[ph >> 26];
+        for (int c = 0; c < channels; c++) *dst++ = s;
+        ph += step;
+    }
+    *phase = ph;
+}
+
+/* ===================== Replay ===================== */
+
+int capture_source_read_loop(int fd, uint8_t *dst, size_t len)
+{
+    if (fd < 0 || !dst) return -1;
+
+    size_t got = 0;
+    int rewound = 0;
+    while (got < len) {
+        ssize_t n = read(fd, dst + got, len - got);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOGE("[%s] replay read failed: %s", TAG, strerror(errno));
+            return -1;
+        }
+        if (n == 0) {
+            /* 文件尾：从头继续；连续两次读到 0 说明文件为空 */
+            if (rewound || lseek(fd, 0, SEEK_SET) != 0) return -1;
+            rewound = 1;
+            continue;
+        }
+        rewound = 0;
+        got += (size_t)n;
+    }
+    return 0;
+}
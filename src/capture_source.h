@@ -0,0 +1,82 @@
+// capture_source.h
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "nv12_repack.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 采集源：V4L2Capture / AudioCapture 除了真实设备外，还可以接两种无硬件的源，
+ * 接口（dqbuf/qbuf/poll fd、read/poll_fds）与设备完全一致，流水线无需区分：
+ *
+ * - SYNTHETIC：视频为移动的斜向灰阶 + 彩条，音频为 1kHz 正弦；
+ * - REPLAY：循环回放录好的文件（视频为紧密排列的 NV12 帧，音频为 S16LE 交错 PCM）。
+ *
+ * realtime=1 时按名义速率（fps / 采样率）出数据，节拍来自 timerfd，取不走的帧像驱动一样丢弃
+ * （sequence 跳变，计入 drop_count）；realtime=0 时尽快出数据，只受下游归还 buffer 的速度限制，
+ * 用来测吞吐上限。两种模式的时间戳都按“序号 × 名义间隔”生成，落盘文件的 PTS 与速率无关。
+ */
+
+typedef enum {
+    CAPTURE_SRC_DEVICE = 0,   // 真实设备（V4L2 / ALSA）
+    CAPTURE_SRC_SYNTHETIC,    // 合成图案 / 正弦
+    CAPTURE_SRC_REPLAY,       // 文件回放
+} CaptureSourceType;
+
+typedef struct {
+    CaptureSourceType type;
+    const char       *path;      // REPLAY：输入文件
+    int               realtime;  // 1=按名义速率；0=尽快
+} CaptureSourceOpts;
+
+/*
+ * 源名称 -> 类型："v4l2" / "alsa" / "device"、"synthetic"、"replay"。
+ * @return  0 成功；-1 未知名称
+ */
+int         capture_source_type_from_name(const char *name, CaptureSourceType *out);
+const char *capture_source_name(CaptureSourceType type);
+
+/* 节拍：realtime 为周期 timerfd，否则为 eventfd（由使用者 kick 唤醒）。fd 可直接 poll。 */
+typedef struct {
+    int     fd;
+    int     realtime;
+    int64_t period_us;
+} CapturePacer;
+
+int      capture_pacer_open(CapturePacer *p, int realtime, int64_t period_us);
+/* realtime：启动周期定时器。 */
+int      capture_pacer_start(CapturePacer *p);
+/* 读出并清零节拍数（realtime 为到期次数，否则为 kick 次数）；没有节拍时返回 0。 */
+uint64_t capture_pacer_take(CapturePacer *p);
+/* 非 realtime：让 fd 变为可读。可在任意线程调用。 */
+void     capture_pacer_kick(CapturePacer *p);
+void     capture_pacer_close(CapturePacer *p);
+
+/*
+ * 填充一帧合成 NV12：Y 为随 seq 移动的斜向灰阶，UV 为 8 条竖直彩条。
+ * @param with_uv  0 时只改写 Y（UV 在 buffer 首次使用时写一次即可）
+ */
+void capture_source_synth_nv12(const Nv12Planes *dst, unsigned int width, unsigned int height,
+                               uint64_t seq, int with_uv);
+
+/*
+ * 生成 1kHz 正弦（-12dBFS，各声道相同）。
+ * @param phase  相位累加器，跨调用保持连续
+ */
+void capture_source_synth_pcm(int16_t *dst, size_t frames, int channels, unsigned int rate,
+                              uint32_t *phase);
+
+/*
+ * 从回放文件读满 len 字节，读到文件尾时从头继续。
+ * @return  0 成功；-1 读失败或文件为空
+ */
+int  capture_source_read_loop(int fd, uint8_t *dst, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,683 @@
+// channel.c
+#include "channel.h"
+#include "audio_capture.h"
+#include "audio_enc.h"
+#include "log.h"
+#include "media_clock.h"
+#include "rt_sched.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#define TAG "channel"
+
+/* 看护模式下音频设备连续读失败多久后认为设备已失效 */
+#define CH_AUDIO_ERR_FATAL_MS 2000
+
+static int64_t now_ms(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* ===================== Audio Thread ===================== */
+/*
+ * 写一个音频单元。异步 sink 背压：直接读设备时最多等一个 period，再等下去 ALSA 缓冲会溢出，
+ * 所以宁可丢弃这一段并计入 drop；有采集环（wait=1）时设备照常被采集线程读走，
+ * 这里一直等到 sink 可写，积压由环吸收（环满时由采集线程丢弃新数据）。
+ *
+ * @return  0 已写入；1 背压下丢弃；-1 写出失败
+ */
+static int audio_sink_write(EncSink *as, const uint8_t *data, size_t len, int64_t pts_us, int period_ms, int wait,
+                            volatile sig_atomic_t *stop)
+{
+    EncSinkMeta meta = { .stream = ENC_STREAM_AUDIO, .pts_us = pts_us, .keyframe = 0 };
+    TRACE_BEGIN("audio_write f=%lld len=%zu", (long long)pts_us, len);
+    int wr = enc_sink_write_ex(as, data, len, &meta);
+    while (wr == 1) {
+        if (enc_sink_wait_writable(as, len, period_ms) == 0)
+            wr = enc_sink_write_ex(as, data, len, &meta);
+        if (!wait || *stop) break;
+    }
+    TRACE_END();
+    if (wr == 1) TRACE_INSTANT("audio_drop f=%lld", (long long)pts_us);
+    return wr;
+}
+
+/* 写出编码器本次产出的全部包。@return 0 全部写入；1 有包因背压丢弃；-1 写出失败 */
+static int audio_write_encoded(AudioEnc *enc, EncSink *as, int period_ms, int wait, volatile sig_atomic_t *stop)
+{
+    AudioEncPacket pkt;
+    int ret = 0;
+    while (audio_enc_get(enc, &pkt) == 0) {
+        int wr = audio_sink_write(as, pkt.data, pkt.len, pkt.pts_us, period_ms, wait, stop);
+        if (wr < 0) return -1;
+        if (wr == 1) ret = 1;
+    }
+    return ret;
+}
+
+/*
+ * 音频线程主体：
+ * - 打开 ALSA 音频采集（非阻塞；--audio-ring 时由采集线程读设备、这里从 PCM 环取）
+ * - 按 period 取 PCM 并写入 sink（不拷贝）；无数据时 poll ALSA 描述符（或环通知 fd）+ 本通道 stop eventfd
+ * - 达到时长限制或收到停止信号后退出
+ *
+ * @return  0 正常结束；-1 出错（打开失败、写出失败，或看护模式下设备持续出错）
+ */
+static int audio_run(Channel *ch)
+{
+    const AppConfig *cfg = &ch->cfg;
+    AvStats *stats = &ch->stats;
+
+    AudioCapture ac;
+    CaptureSourceOpts src;
+    app_config_audio_source(cfg, &src);
+    AudioCaptureOpts cap_opts;
+    app_config_audio_capture_opts(cfg, stats, &cap_opts);
+    if (audio_capture_open_ex(&ac, cfg->audio_device, cfg->sample_rate, cfg->channels, &src, &cap_opts) != 0) {
+        LOGE("[audio] audio_capture_open failed");
+        av_stats_add_drop(stats, 1);
+        return -1;
+    }
+
+    /*
+     * TS 的 PMT 按配置的采样率/声道声明；驱动实际参数不同时不能混进 TS，
+     * 退回单独写 PCM 文件，保证录制本身不受影响。
+     */
+    EncSink *shared = ch->shared;
+    if (shared && (ac.sample_rate != cfg->sample_rate || (unsigned int)ac.channels != cfg->channels)) {
+        LOGW("[audio] device runs %uHz ch=%d, not %uHz ch=%u: writing %s instead of muxing",
+             ac.sample_rate, ac.channels, cfg->sample_rate, cfg->channels, cfg->output_path_pcm);
+        shared = NULL;
+    }
+
+    /*
+     * 编码阶段（AAC / Opus，或 PCM 的增益 / 下混）按设备实际参数打开；
+     * 退回单独写文件时裸 Opus 无法落盘，改写 PCM。
+     */
+    AudioEnc enc;
+    int use_enc = app_config_audio_enc_needed(cfg);
+    if (use_enc) {
+        AudioEncOpts enc_opts;
+        app_config_audio_enc_opts(cfg, &enc_opts);
+        enc_opts.sample_rate      = ac.sample_rate;
+        enc_opts.in_channels      = (unsigned int)ac.channels;
+        enc_opts.max_input_frames = (unsigned int)ac.frames_per_period;
+        if (!shared && enc_opts.codec == AUDIO_CODEC_OPUS) {
+            LOGW("[audio] opus needs the TS sink, writing PCM");
+            enc_opts.codec = AUDIO_CODEC_PCM;
+        }
+        if (audio_enc_open(&enc, &enc_opts) != 0) {
+            LOGE("[audio] audio_enc_open failed");
+            audio_capture_close(&ac);
+            av_stats_add_drop(stats, 1);
+            return -1;
+        }
+    }
+
+    /* 与视频使用同一种 sink：--sink async 时 PCM 也由写线程批量落盘。 */
+    EncSinkType sink_type = ENC_SINK_FILE;
+    enc_sink_type_from_name(cfg->sink_type, &sink_type);
+    if (enc_sink_type_is_muxed(sink_type)) sink_type = ENC_SINK_FILE;
+    EncSink own;
+    EncSink *as = shared ? shared : &own;
+    if (!shared) {
+        enc_sink_init(&own, sink_type, cfg->output_path_pcm);
+        SinkAsyncOpts sink_opts;
+        app_config_sink_async_opts(cfg, stats, &sink_opts);
+        enc_sink_set_async_opts(&own, &sink_opts);
+        SinkSegmentOpts seg_opts;
+        app_config_segment_opts(cfg, 0, 1, &seg_opts);
+        seg_opts.clock = &ch->vp.seg_clock;
+        enc_sink_set_segment_opts(&own, &seg_opts);
+        if (enc_sink_open(&own) != 0) {
+            LOGE("[audio] open %s failed", cfg->output_path_pcm);
+            if (use_enc) audio_enc_close(&enc);
+            audio_capture_close(&ac);
+            av_stats_add_drop(stats, 1);
+            return -1;
+        }
+    }
+
+    LOGI("[audio] start capture -> %s", as->target);
+
+    /*
+     * 计算目标写入字节数：duration_sec>0 则按秒数限制（待机模式的一次录制由 record stop 结束，不限制）；
+     * 否则认为无限（直到外部 stop）。
+     * bytes_per_frame 表示“每个采样帧”的字节数（与位深/声道有关）。
+     */
+    size_t bytes_per_sec = (size_t)ac.sample_rate * (size_t)ac.bytes_per_frame;
+    size_t total_bytes   = (cfg->duration_sec > 0 && !cfg->standby) ? (bytes_per_sec * (size_t)cfg->duration_sec)
+                                                                    : (size_t)-1;
+
+    /* 取不到 poll 描述符时退化为按 period 时长定时等待。 */
+    struct pollfd pfds[REACTOR_MAX_FDS];
+    int npfds = audio_capture_poll_fds(&ac, pfds, REACTOR_MAX_FDS);
+    int period_ms = (int)((uint64_t)ac.frames_per_period * 1000U / (ac.sample_rate ? ac.sample_rate : 1U));
+    if (period_ms < 1) period_ms = 1;
+
+    MediaTrack track;
+    media_track_init(&track, ac.sample_rate);
+
+    size_t written = 0;
+    int ret = 0;
+    int64_t err_since = 0;   // 连续读失败的起始时间
+    int64_t wait_start = media_clock_now_us();
+    while (!ch->stop && !ch->audio_stop && written < total_bytes) {
+        int64_t cap_us = 0;
+        const uint8_t *buf;
+        ssize_t n = audio_capture_peek(&ac, &buf, &cap_us);
+        if (n == 0) {
+            /* 暂时无数据：等下一个 period 就绪或 stop。 */
+            if (npfds > 0) reactor_wait(&ch->reactor, pfds, npfds, 1000);
+            else reactor_wait(&ch->reactor, NULL, 0, period_ms);
+            continue;
+        }
+        if (n < 0) {
+            /* 恢复失败时退避一个 period，避免错误状态下空转；看护模式下持续失败则退出，由看护线程重启 */
+            int64_t t = media_clock_now_us();
+            if (!err_since) err_since = t;
+            if (ch->supervised && t - err_since >= (int64_t)CH_AUDIO_ERR_FATAL_MS * 1000) {
+                LOGE("[audio] %s: capture failing for %d ms, giving up", cfg->audio_device, CH_AUDIO_ERR_FATAL_MS);
+                ret = -1;
+                break;
+            }
+            reactor_wait(&ch->reactor, NULL, 0, period_ms);
+            continue;
+        }
+        err_since = 0;
+        /* audio_rd：从开始等待到读到一段 PCM 的时间（约等于 chunk 时长） */
+        int64_t now = media_clock_now_us();
+        av_stats_record(stats, AV_HIST_AUDIO_READ, (uint64_t)(now - wait_start));
+        wait_start = now;
+
+        /* 时钟统计：按采样数推算的名义时间 vs 硬件时间戳 */
+        int64_t pts = media_clock_pts(cap_us);
+        int64_t err, jitter;
+        media_track_update(&track, pts, (uint32_t)((size_t)n / ac.bytes_per_frame), &err, &jitter);
+        av_stats_set_clock(stats, 1, err, jitter);
+
+        int wr;
+        if (use_enc) {
+            /* 编码器把 period 转换进自己的帧缓冲，之后采集槽位即可归还 */
+            int np = audio_enc_put(&enc, buf, (size_t)n, pts);
+            av_stats_record(stats, AV_HIST_AUDIO_ENC, (uint64_t)(media_clock_now_us() - now));
+            audio_capture_release(&ac);
+            wr = np < 0 ? -1 : audio_write_encoded(&enc, as, period_ms, cfg->audio_ring, &ch->stop);
+        } else {
+            wr = audio_sink_write(as, buf, (size_t)n, pts, period_ms, cfg->audio_ring, &ch->stop);
+            audio_capture_release(&ac);
+        }
+        if (wr == 1) {
+            av_stats_add_drop(stats, 1);
+            continue;
+        }
+        if (wr != 0) {
+            LOGE("[audio] %s failed", use_enc ? "encode / sink write" : "sink write");
+            av_stats_add_drop(stats, 1);
+            ret = -1;
+            break;
+        }
+        written += (size_t)n;
+        /* 音频 chunk 统计：用于每秒打印的速率与累计。 */
+        av_stats_inc_audio_chunk(stats);
+    }
+
+    if (use_enc) {
+        /* 不足一帧的尾巴补零编码，取空编码器延迟 */
+        if (audio_enc_flush(&enc) > 0) audio_write_encoded(&enc, as, period_ms, 0, &ch->stop);
+        audio_enc_close(&enc);
+    }
+    if (!shared) enc_sink_close(&own);
+    audio_capture_close(&ac);
+
+    LOGI("[audio] done, bytes=%zu", written);
+    return ret;
+}
+
+/* 音频线程：结束时（正常或出错）通知看护线程 */
+static void *audio_thread(void *arg)
+{
+    Channel *ch = (Channel *)arg;
+    rt_sched_apply(RT_ROLE_AUDIO, "a-writer");
+    if (audio_run(ch) != 0) atomic_store(&ch->audio_failed, 1);
+    uint64_t one = 1;
+    ssize_t n = write(ch->exit_fd, &one, sizeof(one));
+    (void)n;
+    return NULL;
+}
+
+/* ===================== Lifecycle ===================== */
+
+/* 通道名（日志用），单通道为 "main" */
+static const char *ch_name(const Channel *ch)
+{
+    return ch->name[0] ? ch->name : "main";
+}
+
+/*
+ * 第 n 次重启后的文件名：<主名>.<n><扩展名>，例如 cam0.ts -> cam0.1.ts。
+ * 路径里没有扩展名时直接追加 .<n>。
+ */
+static const char *restart_path(char *dst, size_t cap, const char *path, unsigned int n)
+{
+    const char *base = strrchr(path, '/');
+    const char *dot  = strrchr(base ? base + 1 : path, '.');
+    if (!dot || dot == (base ? base + 1 : path)) snprintf(dst, cap, "%s.%u", path, n);
+    else snprintf(dst, cap, "%.*s.%u%s", (int)(dot - path), path, n, dot);
+    return dst;
+}
+
+/* 重启前改写文件类输出路径（推流地址与带时间戳的事件 / 分段文件名不变） */
+static void rename_outputs(Channel *ch)
+{
+    AppConfig *cfg = &ch->cfg;
+    const AppConfig *base = &ch->base;
+    unsigned int n = ch->restarts;
+    cfg->output_path_h264 = restart_path(ch->paths[0], sizeof(ch->paths[0]), base->output_path_h264, n);
+    cfg->output_path_pcm  = restart_path(ch->paths[1], sizeof(ch->paths[1]), base->output_path_pcm, n);
+    cfg->output_path_ts   = restart_path(ch->paths[2], sizeof(ch->paths[2]), base->output_path_ts, n);
+    for (int i = 0; i < cfg->simulcast_count; i++) {
+        EncSinkType st = ENC_SINK_FILE;
+        enc_sink_type_from_name(base->simulcast[i].sink_type, &st);
+        if (st == ENC_SINK_PIPE_FFMPEG) continue;
+        cfg->simulcast[i].output = restart_path(ch->paths[3 + i], sizeof(ch->paths[3 + i]),
+                                                base->simulcast[i].output, n);
+    }
+}
+
+/*
+ * --standby 一次录制的文件名：<主名>-YYYYmmdd-HHMMSS<扩展名>，例如 cam0.ts -> cam0-20260101-120000.ts；
+ * 同一秒内已有同名文件时再追加 -<录制序号>。
+ */
+static const char *record_path(char *dst, size_t cap, const char *path, const char *stamp, unsigned int n)
+{
+    const char *base = strrchr(path, '/');
+    const char *dot  = strrchr(base ? base + 1 : path, '.');
+    int stem = (!dot || dot == (base ? base + 1 : path)) ? (int)strlen(path) : (int)(dot - path);
+    const char *ext = path + stem;
+    snprintf(dst, cap, "%.*s-%s%s", stem, path, stamp, ext);
+    if (access(dst, F_OK) == 0) snprintf(dst, cap, "%.*s-%s-%u%s", stem, path, stamp, n, ext);
+    return dst;
+}
+
+static void record_outputs(Channel *ch)
+{
+    AppConfig *cfg = &ch->cfg;
+    const AppConfig *base = &ch->base;
+    char stamp[32];
+    time_t t = time(NULL);
+    struct tm tm;
+    localtime_r(&t, &tm);
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+    unsigned int n = ch->records + 1;
+    cfg->output_path_h264 = record_path(ch->paths[0], sizeof(ch->paths[0]), base->output_path_h264, stamp, n);
+    cfg->output_path_pcm  = record_path(ch->paths[1], sizeof(ch->paths[1]), base->output_path_pcm, stamp, n);
+    cfg->output_path_ts   = record_path(ch->paths[2], sizeof(ch->paths[2]), base->output_path_ts, stamp, n);
+}
+
+static void ctl_attach(Channel *ch, VideoPipeline *vp)
+{
+    pthread_mutex_lock(&ch->ctl_lock);
+    ch->ctl_vp = vp;
+    pthread_mutex_unlock(&ch->ctl_lock);
+}
+
+/*
+ * --sink ts / pipe / event：打开音视频共用的封装 sink。
+ * @return 0 成功或不需要；-1 打开失败
+ */
+static int open_mux(Channel *ch)
+{
+    const AppConfig *cfg = &ch->cfg;
+    EncSinkType sink_type = ENC_SINK_FILE;
+    enc_sink_type_from_name(cfg->sink_type, &sink_type);
+    if (!enc_sink_type_is_muxed(sink_type)) return 0;
+
+    AudioCodec acodec = AUDIO_CODEC_PCM;
+    audio_enc_codec_from_name(cfg->audio_codec, &acodec);
+    TsMuxStreams st = { .video = 1, .hevc = strcmp(cfg->codec, "h265") == 0,
+                        .audio_rate = cfg->sample_rate,
+                        .audio_channels = cfg->audio_out_ch ? cfg->audio_out_ch : cfg->channels,
+                        .audio_codec = acodec == AUDIO_CODEC_AAC ? TS_AUDIO_AAC
+                                     : acodec == AUDIO_CODEC_OPUS ? TS_AUDIO_OPUS : TS_AUDIO_S302M };
+    const char *target = (sink_type == ENC_SINK_TS_FILE) ? cfg->output_path_ts
+                       : (sink_type == ENC_SINK_EVENT) ? cfg->output_path_event : cfg->stream_url;
+    enc_sink_init(&ch->mux, sink_type, target);
+    enc_sink_set_ts_streams(&ch->mux, &st);
+    SinkPipeOpts pipe_opts;
+    app_config_sink_pipe_opts(cfg, &ch->stats, &pipe_opts);
+    enc_sink_set_pipe_opts(&ch->mux, &pipe_opts);
+    SinkEventOpts event_opts;
+    app_config_sink_event_opts(cfg, &ch->stats, &event_opts);
+    enc_sink_set_event_opts(&ch->mux, &event_opts);
+    SinkSegmentOpts seg_opts;
+    app_config_segment_opts(cfg, cfg->bitrate, 1, &seg_opts);
+    enc_sink_set_segment_opts(&ch->mux, &seg_opts);
+    if (enc_sink_open(&ch->mux) != 0) {
+        LOGE("[%s] %s: open %s failed", TAG, ch_name(ch), target);
+        return -1;
+    }
+    ch->shared = &ch->mux;
+    if (sink_type == ENC_SINK_EVENT) ch->event_sink = ch->shared;
+    return 0;
+}
+
+/* 清掉音频线程的退出通知 */
+static void drain_exit_fd(Channel *ch)
+{
+    uint64_t v;
+    ssize_t n = read(ch->exit_fd, &v, sizeof(v));
+    (void)n;
+}
+
+/* 启动本次录制（或本实例）的音频线程。@return 0 成功；-1 失败 */
+static int start_audio(Channel *ch)
+{
+    drain_exit_fd(ch);
+    atomic_store(&ch->audio_failed, 0);
+    ch->audio_stop = 0;
+    if (pthread_create(&ch->th_audio, NULL, audio_thread, ch) != 0) {
+        LOGE("[%s] %s: pthread_create audio failed", TAG, ch_name(ch));
+        return -1;
+    }
+    ch->audio_started = 1;
+    return 0;
+}
+
+/*
+ * --standby：结束本次录制——视频排空并撤下 sink（返回时写出线程已确认不再写它），
+ * 停掉音频线程，两边都不再使用之后才关闭共用 sink。
+ */
+static void record_end(Channel *ch)
+{
+    if (!ch->recording) return;
+    video_pipeline_record_stop(&ch->vp);
+    ch->audio_stop = 1;
+    if (ch->audio_started) pthread_join(ch->th_audio, NULL);
+    ch->audio_started = 0;
+    drain_exit_fd(ch);
+    if (ch->shared) enc_sink_close(ch->shared);
+    ch->shared = NULL;
+    ch->recording = 0;
+    LOGI("[%s] %s: recording #%u stopped, standby", TAG, ch_name(ch), ch->records);
+}
+
+/*
+ * --standby：开始一次录制。采集与编码器已在运行，这里只打开新文件、请求 IDR 并放行帧。
+ * @return 0 成功；-1 失败（已回到待机）
+ */
+static int record_begin(Channel *ch)
+{
+    int64_t t0 = media_clock_now_us();
+    record_outputs(ch);
+    if (open_mux(ch) != 0) return -1;
+    if (video_pipeline_record_start(&ch->vp, ch->shared) != 0) {
+        LOGE("[%s] %s: video record start failed", TAG, ch_name(ch));
+        if (ch->shared) enc_sink_close(ch->shared);
+        ch->shared = NULL;
+        return -1;
+    }
+    ch->recording = 1;
+    ch->records++;
+    /* 音频起不来时只录视频 */
+    if (start_audio(ch) != 0) av_stats_add_drop(&ch->stats, 1);
+    LOGI("[%s] %s: recording #%u -> %s (armed in %.1f ms)", TAG, ch_name(ch), ch->records,
+         ch->shared ? ch->shared->target : ch->cfg.output_path_h264,
+         (double)(media_clock_now_us() - t0) / 1000.0);
+    return 0;
+}
+
+/* 执行控制入口的录制请求（channel_run 线程内调用） */
+static void record_apply(Channel *ch)
+{
+    uint64_t v;
+    ssize_t n = read(ch->ctl_fd, &v, sizeof(v));
+    (void)n;
+    int want = atomic_load(&ch->rec_req);
+    if (want && !ch->recording) {
+        if (record_begin(ch) != 0) {
+            LOGE("[%s] %s: record start failed, staying in standby", TAG, ch_name(ch));
+            atomic_store(&ch->rec_req, 0);
+        }
+    } else if (!want && ch->recording) {
+        record_end(ch);
+    }
+}
+
+/* 停掉正在运行的实例：通知 stop，等音频线程与视频流水线排空退出，再关闭共用 sink。 */
+static void channel_teardown(Channel *ch)
+{
+    record_end(ch);
+    channel_request_stop(ch);
+    ctl_attach(ch, NULL);
+    if (ch->audio_started) pthread_join(ch->th_audio, NULL);
+    ch->audio_started = 0;
+    if (ch->video_ok) video_pipeline_join(&ch->vp);
+    ch->video_ok = 0;
+    ch->event_sink = NULL;
+    if (ch->shared) enc_sink_close(ch->shared);
+    ch->shared = NULL;
+}
+
+/*
+ * 启动一个实例：共用 sink -> 视频流水线 -> 音频线程。
+ * 单通道时视频打开失败不影响音频录制（与之前的行为一致）；看护模式下视为本次启动失败。
+ *
+ * @return 0 成功；-1 失败（已停掉启动了的部分）
+ */
+static int channel_start(Channel *ch)
+{
+    /* 待机：只启动视频流水线（采集与编码器常驻），sink 与音频随每次录制打开 */
+    int standby = ch->cfg.standby;
+    if (!standby && open_mux(ch) != 0) return -1;
+
+    if (video_pipeline_start(&ch->vp, &ch->cfg, &ch->stats, &ch->stop, &ch->reactor, ch->shared, ch->vpu) != 0) {
+        LOGE("[%s] %s: video pipeline start failed", TAG, ch_name(ch));
+        av_stats_add_drop(&ch->stats, 1);
+        if (ch->supervised || standby) {
+            channel_teardown(ch);
+            return -1;
+        }
+    } else {
+        ch->video_ok = 1;
+        ctl_attach(ch, &ch->vp);
+    }
+
+    if (standby) {
+        LOGI("[%s] %s: standby, waiting for record start", TAG, ch_name(ch));
+        if (atomic_load(&ch->rec_req)) record_apply(ch);   // 重启前正在录制：接着录新的一段
+        return 0;
+    }
+    if (start_audio(ch) != 0) {
+        channel_teardown(ch);
+        return -1;
+    }
+    return 0;
+}
+
+/* 清除上一个实例留下的 stop 通知；进程级 stop 已置位时重新通知（与信号处理函数并发时不丢失） */
+static void channel_reset(Channel *ch)
+{
+    reactor_reset(&ch->reactor);
+    ch->stop = 0;
+    if (*ch->global_stop) channel_request_stop(ch);
+}
+
+int channel_init(Channel *ch, const char *name, const AppConfig *cfg, int supervised,
+                 volatile sig_atomic_t *global_stop, VpuSched *vpu)
+{
+    if (!ch || !cfg || !global_stop) return -1;
+    memset(ch, 0, sizeof(*ch));
+    snprintf(ch->name, sizeof(ch->name), "%s", name ? name : "");
+    ch->cfg         = *cfg;
+    ch->base        = *cfg;
+    ch->supervised  = supervised;
+    ch->global_stop = global_stop;
+    ch->vpu         = vpu;
+    ch->exit_fd     = -1;
+    ch->ctl_fd      = -1;
+    ch->reactor.stop_fd = -1;
+
+    av_stats_init(&ch->stats);
+    av_stats_set_label(&ch->stats, ch->name);
+    pthread_mutex_init(&ch->ctl_lock, NULL);
+    if (reactor_init(&ch->reactor, &ch->stats) != 0) {
+        pthread_mutex_destroy(&ch->ctl_lock);
+        return -1;
+    }
+    ch->exit_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ch->ctl_fd  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (ch->exit_fd < 0 || ch->ctl_fd < 0) {
+        LOGE("[%s] eventfd failed: %s", TAG, strerror(errno));
+        channel_destroy(ch);
+        return -1;
+    }
+
+    if (cfg->abr) {
+        AbrOpts abr_opts;
+        app_config_abr_opts(cfg, &abr_opts);
+        abr_opts.pkt_slots = VP_PKT_SLOTS;
+        ch->abr_enabled = abr_init(&ch->abr, &abr_opts) == 0;
+    }
+    return 0;
+}
+
+void channel_destroy(Channel *ch)
+{
+    if (!ch) return;
+    reactor_close(&ch->reactor);
+    if (ch->exit_fd >= 0) close(ch->exit_fd);
+    if (ch->ctl_fd >= 0) close(ch->ctl_fd);
+    ch->exit_fd = -1;
+    ch->ctl_fd  = -1;
+    pthread_mutex_destroy(&ch->ctl_lock);
+}
+
+void channel_request_stop(Channel *ch)
+{
+    ch->stop = 1;
+    reactor_signal_stop(&ch->reactor);
+}
+
+int channel_trigger(Channel *ch)
+{
+    if (ch && ch->cfg.standby) return channel_record(ch, 1);
+    EncSink *s = ch ? ch->event_sink : NULL;
+    return s ? enc_sink_trigger(s) : -1;
+}
+
+int channel_record(Channel *ch, int on)
+{
+    if (!ch || !ch->cfg.standby || ch->ctl_fd < 0) return -1;
+    atomic_store(&ch->rec_req, on ? 1 : 0);
+    uint64_t one = 1;
+    ssize_t n = write(ch->ctl_fd, &one, sizeof(one));
+    (void)n;
+    return 0;
+}
+
+void channel_stats_tick(Channel *ch)
+{
+    av_stats_tick_print(&ch->stats);
+    if (!ch->abr_enabled) return;
+    pthread_mutex_lock(&ch->ctl_lock);
+    int bps = 0;
+    if (ch->ctl_vp && abr_update(&ch->abr, &ch->stats.last, &bps) != ABR_HOLD) {
+        if (video_pipeline_set_bitrate(ch->ctl_vp, 0, bps) != 0)
+            LOGW("[%s] %s: apply bitrate %d failed", TAG, ch_name(ch), bps);
+    }
+    pthread_mutex_unlock(&ch->ctl_lock);
+}
+
+/*
+ * 启动并看护本通道（见 channel.h）。
+ * --sec 从第一次启动算起，重启不延长总时长。
+ *
+ * @return 0 正常结束；-1 单通道启动失败
+ */
+int channel_run(Channel *ch)
+{
+    if (!ch) return -1;
+    int64_t t0 = now_ms();
+    int64_t deadline = ch->cfg.duration_sec > 0 ? t0 + (int64_t)ch->cfg.duration_sec * 1000 : 0;
+    int backoff = CH_RESTART_MIN_MS;
+    int ret = 0;
+
+    while (!ch->stop) {
+        int64_t t_run = now_ms();
+        int failed = channel_start(ch) != 0;
+        if (!failed) {
+            if (ch->name[0])
+                LOGI("[%s] %s: running (video=%s, restarts=%u)", TAG, ch->name, ch->video_ok ? "on" : "off",
+                     ch->restarts);
+            int standby = ch->cfg.standby;
+            int check   = ch->supervised || standby;
+            while (!ch->stop) {
+                /*
+                 * 单通道只等音频线程退出 / stop / 截止时间；看护或待机时定期检查视频是否出错，
+                 * 待机时还等录制请求。
+                 */
+                int timeout = check ? CH_CHECK_MS : -1;
+                if (deadline) {
+                    int64_t left = deadline - now_ms();
+                    if (left <= 0) break;
+                    if (timeout < 0 || left < timeout) timeout = (int)left;
+                }
+                struct pollfd pfds[2] = {
+                    { .fd = ch->exit_fd, .events = POLLIN },
+                    { .fd = ch->ctl_fd,  .events = POLLIN },
+                };
+                int r = reactor_wait(&ch->reactor, pfds, 2, timeout);
+                if (r < 0) break;
+                if (pfds[1].revents & POLLIN) record_apply(ch);
+                if (!standby && (pfds[0].revents & POLLIN)) {
+                    failed = ch->supervised && atomic_load(&ch->audio_failed);
+                    break;
+                }
+                /* 待机：音频线程只会因出错提前退出（record_end 自己会清掉通知），只结束本次录制 */
+                if (standby && ch->recording && (pfds[0].revents & POLLIN)) {
+                    LOGW("[%s] %s: audio stopped during recording #%u", TAG, ch_name(ch), ch->records);
+                    atomic_store(&ch->rec_req, 0);
+                    record_end(ch);
+                }
+                if (check && ch->video_ok && video_pipeline_failed(&ch->vp)) {
+                    failed = 1;
+                    break;
+                }
+            }
+            channel_teardown(ch);
+        } else if (!ch->supervised) {
+            ret = -1;
+        }
+
+        if (!failed || !ch->supervised || *ch->global_stop) break;
+
+        /* 出错重启：连续正常运行足够久则退避复位；退避不越过截止时间 */
+        if (now_ms() - t_run >= CH_HEALTHY_MS) backoff = CH_RESTART_MIN_MS;
+        int wait_ms = backoff;
+        if (deadline) {
+            int64_t left = deadline - now_ms();
+            if (left <= wait_ms) {
+                LOGW("[%s] %s: failed, deadline reached before restart", TAG, ch_name(ch));
+                break;
+            }
+        }
+        channel_reset(ch);
+        ch->restarts++;
+        LOGW("[%s] %s: failed, restart #%u in %d ms", TAG, ch_name(ch), ch->restarts, wait_ms);
+        if (reactor_wait(&ch->reactor, NULL, 0, wait_ms) < 0) break;
+        backoff = backoff * 2 > CH_RESTART_MAX_MS ? CH_RESTART_MAX_MS : backoff * 2;
+        rename_outputs(ch);
+    }
+
+    if (ch->name[0]) LOGI("[%s] %s: stopped, restarts=%u", TAG, ch->name, ch->restarts);
+    return ret;
+}
@@ -0,0 +1,115 @@
+// channel.h
+#pragma once
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
+
+#include "abr.h"
+#include "app_config.h"
+#include "av_stats.h"
+#include "reactor.h"
+#include "sink.h"
+#include "video_pipeline.h"
+#include "vpu_sched.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 一路通道：一个 AppConfig 对应的完整采集链路（视频流水线 + 音频线程 + sink），
+ * 自带 stop 标志、reactor 与统计，可以单独停止、重启，不影响同进程里的其他通道。
+ *
+ * channel_run 在调用线程里启动并看护这一路，直到结束：
+ * - 正常结束：音频线程退出（到达 --sec 或 stop），或到达 --sec 的截止时间；
+ * - 出错（supervised=1 时）：视频打开失败、采集设备持续出错（video_pipeline_failed）或音频线程出错退出，
+ *   停掉这一路（排空已编码的数据、关闭 sink）后按退避时间（1s 起倍增，最长 CH_RESTART_MAX_MS）重新启动；
+ *   重启后文件类输出改名为 <主名>.<重启次数><扩展名>，不覆盖出错之前录下的文件。
+ * supervised=0（单通道）与之前的行为一致：视频失败不影响音频，音频结束即结束。
+ *
+ * --standby（cfg->standby）：启动时只打开并常驻采集与编码器（STREAMON，帧直接归还），不写出；
+ * channel_record(ch, 1) 时按当前时间另开一组文件（<主名>-YYYYmmdd-HHMMSS<扩展名>），强制 IDR 后开始写出，
+ * 同时启动本次录制的音频线程；channel_record(ch, 0) 排空在途帧后关闭这组文件，回到待机。
+ * 重启后如果仍处于录制请求状态，自动开始新的一段。
+ */
+#define CH_CHECK_MS        1000    // 看护时检查出错标志的间隔
+#define CH_RESTART_MIN_MS  1000
+#define CH_RESTART_MAX_MS  30000
+#define CH_HEALTHY_MS      30000   // 连续正常运行这么久后退避时间复位
+
+typedef struct {
+    char                  name[32];     // 通道名（统计标签），单通道为空
+    AppConfig             cfg;          // 本通道配置（重启时改写文件类输出路径）
+    AppConfig             base;         // 原始配置
+    int                   supervised;   // 1 = 出错时重启
+    volatile sig_atomic_t *global_stop; // 进程级停止标志（置位后不再重启）
+    VpuSched             *vpu;          // 多通道共用的 VPU 配额（可为 NULL）
+
+    volatile sig_atomic_t stop;         // 本通道停止标志
+    Reactor               reactor;      // 本通道 stop eventfd
+    AvStats               stats;        // 跨重启累计
+
+    /* 运行中的实例（channel_run 线程内访问） */
+    VideoPipeline         vp;
+    int                   video_ok;
+    EncSink               mux;          // --sink ts / pipe / event：音视频共用
+    EncSink              *shared;
+    pthread_t             th_audio;
+    int                   audio_started;
+    int                   exit_fd;      // 音频线程退出时写入（eventfd），看护线程 poll
+    atomic_int            audio_failed;
+    EncSink *volatile     event_sink;   // --sink event：打开后发布、关闭前撤回，供触发入口使用
+
+    /* --standby：控制入口（信号处理函数 / 事件控制线程）只写请求与 eventfd，由 channel_run 线程执行 */
+    atomic_int            rec_req;      // 请求的录制状态（1 = 录制）
+    int                   ctl_fd;       // 唤醒 channel_run 线程的 eventfd
+    int                   recording;    // 实际状态（channel_run 线程内访问）
+    volatile sig_atomic_t audio_stop;   // 结束本次录制的音频线程
+    unsigned int          records;
+
+    /* 自适应码率：统计线程驱动，lock 保证 vp 撤回后不再下发 */
+    pthread_mutex_t       ctl_lock;
+    VideoPipeline        *ctl_vp;
+    AbrController         abr;
+    int                   abr_enabled;
+
+    unsigned int          restarts;
+    char                  paths[3 + APP_MAX_SIMULCAST][512];  // 重启后的输出路径
+} Channel;
+
+/*
+ * 初始化（不启动）。
+ *
+ * @param name        通道名（NULL 或 "" 表示单通道，统计不带标签）
+ * @param cfg         已校验的配置（复制一份）
+ * @param supervised  1 = 出错时重启
+ * @param global_stop 进程级停止标志
+ * @param vpu         共用的 VPU 配额（可为 NULL）
+ * @return            0 成功；-1 失败
+ */
+int  channel_init(Channel *ch, const char *name, const AppConfig *cfg, int supervised,
+                  volatile sig_atomic_t *global_stop, VpuSched *vpu);
+void channel_destroy(Channel *ch);
+
+/* 启动并看护本通道，直到正常结束或进程级 stop（见上）。阻塞。@return 0 正常结束；-1 单通道启动失败 */
+int  channel_run(Channel *ch);
+
+/* 通知本通道停止。只写 sig_atomic_t 与 eventfd，可在信号处理函数里调用。 */
+void channel_request_stop(Channel *ch);
+
+/*
+ * 请求写出一个事件片段（仅 --sink event 且正在运行时有效；--standby 时等价于 channel_record(ch, 1)）。
+ * 异步信号安全。@return 0 已请求；-1 无事件 sink，也不是待机通道
+ */
+int  channel_trigger(Channel *ch);
+
+/* --standby：请求开始（on=1）/ 停止（on=0）录制，异步执行。异步信号安全。@return 0 已请求；-1 不是待机通道 */
+int  channel_record(Channel *ch, int on);
+
+/* 统计线程：打印本通道一个窗口，并驱动自适应码率。 */
+void channel_stats_tick(Channel *ch);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,11 +1,75 @@
 // src/encoder_mpp.c
 #include "encoder_mpp.h"
 #include "log.h"
+#include "mem_arena.h"
+#include "trace.h"
 
+#include <errno.h>
 #include <string.h>
+#include <time.h>
 
 #define TAG "mpp_enc"
 
+void encoder_mpp_default_opts(EncoderMppOpts *o)
+{
+    if (!o) return;
+    memset(o, 0, sizeof(*o));
+    o->type    = MPP_VIDEO_CodingAVC;
+    o->fps     = 30;
+    o->rc_mode = ENC_RC_CBR;
+}
+
+int encoder_mpp_coding_from_name(const char *name, MppCodingType *type)
+{
+    if (!name || !type) return -1;
+    if (strcmp(name, "h264") == 0 || strcmp(name, "avc") == 0) {
+        *type = MPP_VIDEO_CodingAVC;
+    } else if (strcmp(name, "h265") == 0 || strcmp(name, "hevc") == 0) {
+        *type = MPP_VIDEO_CodingHEVC;
+    } else if (strcmp(name, "mjpeg") == 0 || strcmp(name, "jpeg") == 0) {
+        *type = MPP_VIDEO_CodingMJPEG;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+const char *encoder_mpp_coding_name(MppCodingType type)
+{
+    switch (type) {
+    case MPP_VIDEO_CodingHEVC:  return "h265";
+    case MPP_VIDEO_CodingMJPEG: return "mjpeg";
+    default:                    return "h264";
+    }
+}
+
+int encoder_mpp_rc_from_name(const char *name, EncRcMode *mode)
+{
+    if (!name || !mode) return -1;
+    if (strcmp(name, "cbr") == 0) {
+        *mode = ENC_RC_CBR;
+    } else if (strcmp(name, "vbr") == 0) {
+        *mode = ENC_RC_VBR;
+    } else if (strcmp(name, "avbr") == 0) {
+        *mode = ENC_RC_AVBR;
+    } else if (strcmp(name, "fixqp") == 0) {
+        *mode = ENC_RC_FIXQP;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+const char *encoder_mpp_rc_name(EncRcMode mode)
+{
+    switch (mode) {
+    case ENC_RC_VBR:   return "vbr";
+    case ENC_RC_AVBR:  return "avbr";
+    case ENC_RC_FIXQP: return "fixqp";
+    default:           return "cbr";
+    }
+}
+
 #if !RK_MPP_AVAILABLE
 
 /*
@@ -38,6 +102,46 @@ int encoder_mpp_init(EncoderMPP *enc,
     return -1;
 }
 
+int encoder_mpp_init_ex(EncoderMPP *enc,
+                        int width, int height,
+                        int hor_stride, int ver_stride,
+                        int fps,
+                        int bitrate_bps,
+                        MppCodingType type)
+{
+    (void)hor_stride;
+    (void)ver_stride;
+    return encoder_mpp_init(enc, width, height, fps, bitrate_bps, type);
+}
+
+int encoder_mpp_init_opts(EncoderMPP *enc, const EncoderMppOpts *o)
+{
+    if (!o) return -1;
+    return encoder_mpp_init(enc, o->width, o->height, o->fps, o->bitrate, o->type);
+}
+
+int encoder_mpp_import_dmabuf(EncoderMPP *enc, int index, int fd, size_t size)
+{
+    (void)enc;
+    (void)index;
+    (void)fd;
+    (void)size;
+    LOGE("[%s] MPP not available.", TAG);
+    return -1;
+}
+
+int encoder_mpp_encode_ext(EncoderMPP *enc, int index,
+                           EncSink *sink,
+                           size_t *out_bytes)
+{
+    (void)enc;
+    (void)index;
+    (void)sink;
+    if (out_bytes) *out_bytes = 0;
+    LOGE("[%s] MPP not available.", TAG);
+    return -1;
+}
+
 /*
  * 编码一帧（当 RK_MPP 不可用时的占位实现）。
  *
@@ -63,6 +167,132 @@ int encoder_mpp_encode(EncoderMPP *enc,
     return -1;
 }
 
+int encoder_mpp_encode_frame(EncoderMPP *enc,
+                             const uint8_t *frame_data,
+                             size_t frame_size,
+                             EncPacket *pkt)
+{
+    (void)enc;
+    (void)frame_data;
+    (void)frame_size;
+    if (pkt) memset(pkt, 0, sizeof(*pkt));
+    LOGE("[%s] MPP not available.", TAG);
+    return -1;
+}
+
+int encoder_mpp_encode_ext_frame(EncoderMPP *enc, int index, EncPacket *pkt)
+{
+    (void)enc;
+    (void)index;
+    if (pkt) memset(pkt, 0, sizeof(*pkt));
+    LOGE("[%s] MPP not available.", TAG);
+    return -1;
+}
+
+void encoder_mpp_packet_release(EncPacket *pkt)
+{
+    if (pkt) memset(pkt, 0, sizeof(*pkt));
+}
+
+int encoder_mpp_setup_async(EncoderMPP *enc, int depth, int with_input_pool,
+                            int poll_timeout_ms)
+{
+    (void)enc;
+    (void)depth;
+    (void)with_input_pool;
+    (void)poll_timeout_ms;
+    LOGE("[%s] MPP not available.", TAG);
+    return -1;
+}
+
+int encoder_mpp_submit(EncoderMPP *enc, const uint8_t *frame_data, size_t frame_size,
+                       int64_t pts, int timeout_ms)
+{
+    (void)enc;
+    (void)frame_data;
+    (void)frame_size;
+    (void)pts;
+    (void)timeout_ms;
+    return -1;
+}
+
+int encoder_mpp_submit_ext(EncoderMPP *enc, int index, int64_t pts, int timeout_ms)
+{
+    (void)enc;
+    (void)index;
+    (void)pts;
+    (void)timeout_ms;
+    return -1;
+}
+
+int encoder_mpp_submit_nv12(EncoderMPP *enc, const Nv12Planes *src,
+                            unsigned int src_width, unsigned int src_height,
+                            int64_t pts, int timeout_ms)
+{
+    (void)enc;
+    (void)src;
+    (void)src_width;
+    (void)src_height;
+    (void)pts;
+    (void)timeout_ms;
+    return -1;
+}
+
+int encoder_mpp_acquire_input(EncoderMPP *enc, int timeout_ms, EncInputBuf *in)
+{
+    (void)enc;
+    (void)timeout_ms;
+    if (in) memset(in, 0, sizeof(*in));
+    return -1;
+}
+
+int encoder_mpp_submit_input(EncoderMPP *enc, const EncInputBuf *in, int64_t pts)
+{
+    (void)enc;
+    (void)in;
+    (void)pts;
+    return -1;
+}
+
+void encoder_mpp_cancel_input(EncoderMPP *enc, const EncInputBuf *in)
+{
+    (void)enc;
+    (void)in;
+}
+
+int encoder_mpp_poll_packet(EncoderMPP *enc, EncPacket *pkt)
+{
+    (void)enc;
+    if (pkt) memset(pkt, 0, sizeof(*pkt));
+    return -1;
+}
+
+int encoder_mpp_inflight(EncoderMPP *enc)
+{
+    (void)enc;
+    return 0;
+}
+
+int encoder_mpp_set_bitrate(EncoderMPP *enc, int bitrate_bps)
+{
+    (void)enc;
+    (void)bitrate_bps;
+    return -1;
+}
+
+int encoder_mpp_set_fps(EncoderMPP *enc, int fps)
+{
+    (void)enc;
+    (void)fps;
+    return -1;
+}
+
+int encoder_mpp_request_idr(EncoderMPP *enc)
+{
+    (void)enc;
+    return -1;
+}
+
 /*
  * 释放编码器资源（当 RK_MPP 不可用时为 no-op）。
  */
@@ -81,8 +311,9 @@ void encoder_mpp_deinit(EncoderMPP *enc)
  *
  * 当前实现：
  * - 输入格式假定为 NV12（MPP_FMT_YUV420SP）
- * - rate control 使用 CBR
- * - 申请 ION buffer group，并分配一块帧缓冲（frm_buf）用于输入帧拷贝
+ * - rate control 为默认的 CBR（EncoderMppOpts.rc_mode 可选 VBR / AVBR / FIXQP，需走 encoder_mpp_init_opts）
+ * - 申请 ION buffer group；同步拷贝路径的帧缓冲（frm_buf）在第一次 encoder_mpp_encode_frame 时才分配，
+ *   异步输入池 / 零拷贝导入模式下不占这块 ION
  *
  * @param enc          输出：编码器实例
  * @param width        输入宽度
@@ -98,16 +329,177 @@ int encoder_mpp_init(EncoderMPP *enc,
                      int bitrate_bps,
                      MppCodingType type)
 {
-    if (!enc) return -1;
+    return encoder_mpp_init_ex(enc, width, height, 0, 0, fps, bitrate_bps, type);
+}
+
+/*
+ * 初始化 MPP 硬编码器，并允许调用者指定输入 stride（rate control 为默认的 CBR，GOP = 2 × fps；
+ * 其他模式见 EncRcMode，通过 encoder_mpp_init_opts 的 rc_mode 选择）。
+ *
+ * @param hor_stride  输入行跨度（字节）；<=0 表示按 16 对齐自动计算
+ * @param ver_stride  输入列跨度（行数，决定 UV 起始偏移）；<=0 表示按 16 对齐自动计算
+ * 其余参数与 encoder_mpp_init 相同。
+ */
+int encoder_mpp_init_ex(EncoderMPP *enc,
+                        int width, int height,
+                        int hor_stride, int ver_stride,
+                        int fps,
+                        int bitrate_bps,
+                        MppCodingType type)
+{
+    EncoderMppOpts o;
+    encoder_mpp_default_opts(&o);
+    o.type       = type;
+    o.width      = width;
+    o.height     = height;
+    o.hor_stride = hor_stride;
+    o.ver_stride = ver_stride;
+    o.fps        = fps;
+    o.bitrate    = bitrate_bps;
+    return encoder_mpp_init_opts(enc, &o);
+}
+
+/* 当前 fps 下的 GOP 长度 */
+static int effective_gop(const EncoderMPP *enc)
+{
+    return enc->gop > 0 ? enc->gop : enc->fps * 2;
+}
+
+/*
+ * 把 rc（码率 / 帧率 / GOP / QP）写入 enc->cfg。
+ * init 与运行时调整共用，保证两条路径下各模式的上下限算法一致。
+ */
+static void fill_rc_cfg(EncoderMPP *enc)
+{
+    MppEncCfg cfg = enc->cfg;
+    RK_S32 bps = enc->bitrate;
+
+    switch (enc->rc_mode) {
+    case ENC_RC_VBR:
+    case ENC_RC_AVBR:
+        /* VBR：允许复杂画面冲到 17/16，简单画面降到很低；AVBR 在静止时进一步压码率 */
+        mpp_enc_cfg_set_s32(cfg, "rc:mode", enc->rc_mode == ENC_RC_VBR ? MPP_ENC_RC_MODE_VBR
+                                                                         : MPP_ENC_RC_MODE_AVBR);
+        mpp_enc_cfg_set_s32(cfg, "rc:bps_target", bps);
+        mpp_enc_cfg_set_s32(cfg, "rc:bps_max",    bps * 17 / 16);
+        mpp_enc_cfg_set_s32(cfg, "rc:bps_min",    bps * 1 / 16);
+        break;
+    case ENC_RC_FIXQP: {
+        int qp = enc->qp > 0 ? enc->qp : 26;
+        mpp_enc_cfg_set_s32(cfg, "rc:mode",     MPP_ENC_RC_MODE_FIXQP);
+        mpp_enc_cfg_set_s32(cfg, "rc:qp_init",  qp);
+        mpp_enc_cfg_set_s32(cfg, "rc:qp_min",   qp);
+        mpp_enc_cfg_set_s32(cfg, "rc:qp_max",   qp);
+        mpp_enc_cfg_set_s32(cfg, "rc:qp_min_i", qp);
+        mpp_enc_cfg_set_s32(cfg, "rc:qp_max_i", qp);
+        break;
+    }
+    default:
+        mpp_enc_cfg_set_s32(cfg, "rc:mode",       MPP_ENC_RC_MODE_CBR);
+        mpp_enc_cfg_set_s32(cfg, "rc:bps_target", bps);
+        mpp_enc_cfg_set_s32(cfg, "rc:bps_max",    bps * 17 / 16);
+        mpp_enc_cfg_set_s32(cfg, "rc:bps_min",    bps * 15 / 16);
+        break;
+    }
+
+    mpp_enc_cfg_set_s32(cfg, "rc:fps_in_flex",    0);
+    mpp_enc_cfg_set_s32(cfg, "rc:fps_in_num",     enc->fps);
+    mpp_enc_cfg_set_s32(cfg, "rc:fps_in_denorm",  1);
+    mpp_enc_cfg_set_s32(cfg, "rc:fps_out_flex",   0);
+    mpp_enc_cfg_set_s32(cfg, "rc:fps_out_num",    enc->fps);
+    mpp_enc_cfg_set_s32(cfg, "rc:fps_out_denorm", 1);
+    mpp_enc_cfg_set_s32(cfg, "rc:gop",            effective_gop(enc));
+
+    if (enc->type == MPP_VIDEO_CodingMJPEG) {
+        /* MJPEG 没有 GOP / 帧间预测，质量由 q_factor 决定（FIXQP 时取 qp，否则给 RC 留出全范围） */
+        int qf = (enc->rc_mode == ENC_RC_FIXQP && enc->qp > 0) ? enc->qp : 80;
+        if (qf > 99) qf = 99;
+        mpp_enc_cfg_set_s32(cfg, "jpeg:q_factor", qf);
+        mpp_enc_cfg_set_s32(cfg, "jpeg:qf_max",   99);
+        mpp_enc_cfg_set_s32(cfg, "jpeg:qf_min",   1);
+    }
+}
+
+/*
+ * 低延迟分片：按 CTU 行切 slice（H.264 宏块 16x16，H.265 CTU 64x64），每片整行、行数尽量均分；
+ * LOWDELAY 输出让每片编完即可由 encode_get_packet 取走（mpp_packet_is_partition / is_eoi），
+ * 帧头的数据不必等帧尾编完。MPP 不认识 split 配置（旧版本）时告警并退回整帧输出。
+ */
+static void fill_split_cfg(EncoderMPP *enc, int slices)
+{
+    if (enc->type == MPP_VIDEO_CodingMJPEG) {
+        LOGW("[%s] slice output not supported for mjpeg, encoding whole frames", TAG);
+        return;
+    }
+    int ctu  = enc->type == MPP_VIDEO_CodingHEVC ? 64 : 16;
+    int cols = (enc->width  + ctu - 1) / ctu;
+    int rows = (enc->height + ctu - 1) / ctu;
+    if (slices > rows) slices = rows;
+    int rows_per = (rows + slices - 1) / slices;
+
+    MppEncCfg cfg = enc->cfg;
+    if (mpp_enc_cfg_set_u32(cfg, "split:mode", MPP_ENC_SPLIT_BY_CTU) ||
+        mpp_enc_cfg_set_u32(cfg, "split:arg",  (RK_U32)(rows_per * cols)) ||
+        mpp_enc_cfg_set_u32(cfg, "split:out",  MPP_ENC_SPLIT_OUT_LOWDELAY)) {
+        LOGW("[%s] split output not supported by this MPP, encoding whole frames", TAG);
+        mpp_enc_cfg_set_u32(cfg, "split:mode", MPP_ENC_SPLIT_NONE);
+        return;
+    }
+    enc->slices = (rows + rows_per - 1) / rows_per;
+}
+
+/*
+ * 从 buf_grp 取一块输入帧大小的 buffer。ION 内存不在 arena 里，只计入内存预算（--mem-budget）。
+ * @return MPP_OK 成功；超出预算时为 MPP_NOK
+ */
+static MPP_RET input_buf_get(EncoderMPP *enc, MppBuffer *buf)
+{
+    if (mem_arena_charge(MEM_STAGE_ENCODE, enc->frame_size) != 0) return MPP_NOK;
+    MPP_RET ret = mpp_buffer_get(enc->buf_grp, buf, enc->frame_size);
+    if (ret) {
+        mem_arena_uncharge(MEM_STAGE_ENCODE, enc->frame_size);
+        return ret;
+    }
+    enc->ion_charged += enc->frame_size;
+    return MPP_OK;
+}
+
+/*
+ * 按 opts 初始化 MPP 硬编码器。
+ *
+ * 当前实现：
+ * - 输入格式假定为 NV12（MPP_FMT_YUV420SP）
+ * - 编码格式 H.264 / H.265 / MJPEG，rate control 见 EncRcMode
+ * - 申请 ION buffer group；同步拷贝路径的帧缓冲（frm_buf）在第一次 encoder_mpp_encode_frame 时才分配，
+ *   异步输入池 / 零拷贝导入模式下不占这块 ION
+ * - 配置句柄保留在 enc->cfg，供运行时调整复用
+ *
+ * @return  0 成功；-1 失败
+ */
+int encoder_mpp_init_opts(EncoderMPP *enc, const EncoderMppOpts *o)
+{
+    if (!enc || !o) return -1;
     memset(enc, 0, sizeof(*enc));
 
-    enc->width  = width;
-    enc->height = height;
-    enc->type   = type;
+    int width  = o->width;
+    int height = o->height;
+    enc->width   = width;
+    enc->height  = height;
+    enc->type    = o->type;
+    enc->rc_mode = o->rc_mode;
+    enc->fps     = o->fps > 0 ? o->fps : 30;
+    enc->bitrate = o->bitrate > 0 ? o->bitrate : width * height * 5;
+    enc->gop     = o->gop > 0 ? o->gop : 0;
+    enc->qp      = o->qp;
 
-    /* MPP 通常要求 stride 16 对齐（便于硬件处理）。 */
-    enc->hor_stride = (width  + 15) & (~15);
-    enc->ver_stride = (height + 15) & (~15);
+    /* MPP 通常要求 stride 16 对齐（便于硬件处理）；外部指定时以外部布局为准。 */
+    enc->hor_stride = (o->hor_stride > 0) ? o->hor_stride : ((width  + 15) & (~15));
+    enc->ver_stride = (o->ver_stride > 0) ? o->ver_stride : ((height + 15) & (~15));
+    if (enc->hor_stride < width || enc->ver_stride < height) {
+        LOGE("[%s] invalid stride %dx%d for %dx%d", TAG,
+             enc->hor_stride, enc->ver_stride, width, height);
+        return -1;
+    }
     enc->frame_size = (size_t)enc->hor_stride * (size_t)enc->ver_stride * 3 / 2;
 
     MPP_RET ret;
@@ -118,9 +510,9 @@ int encoder_mpp_init(EncoderMPP *enc,
         return -1;
     }
 
-    ret = mpp_init(enc->ctx, MPP_CTX_ENC, type);
+    ret = mpp_init(enc->ctx, MPP_CTX_ENC, enc->type);
     if (ret) {
-        LOGE("[%s] mpp_init failed: %d", TAG, ret);
+        LOGE("[%s] mpp_init(%s) failed: %d", TAG, encoder_mpp_coding_name(enc->type), ret);
         mpp_destroy(enc->ctx);
         enc->ctx = NULL;
         enc->mpi = NULL;
@@ -137,66 +529,355 @@ int encoder_mpp_init(EncoderMPP *enc,
         return -1;
     }
 
-    /* 为输入帧申请一块连续缓冲，后续每帧把 NV12 数据 memcpy 进来。 */
-    ret = mpp_buffer_get(enc->buf_grp, &enc->frm_buf, enc->frame_size);
-    if (ret) {
-        LOGE("[%s] mpp_buffer_get failed: %d", TAG, ret);
-        mpp_buffer_group_put(enc->buf_grp);
-        enc->buf_grp = NULL;
-        mpp_destroy(enc->ctx);
-        enc->ctx = NULL;
-        enc->mpi = NULL;
-        return -1;
-    }
-
-    /* 获取编码器配置句柄。 */
-    MppEncCfg cfg = NULL;
-
-    ret = mpp_enc_cfg_init(&cfg);
-    if (ret || !cfg) {
+    /* 获取编码器配置句柄（保留到 deinit，运行时调整在其上修改）。 */
+    ret = mpp_enc_cfg_init(&enc->cfg);
+    if (ret || !enc->cfg) {
         LOGE("[%s] mpp_enc_cfg_init failed: %d", TAG, ret);
+        enc->cfg = NULL;
+        encoder_mpp_deinit(enc);
         return -1;
     }
 
-    ret = enc->mpi->control(enc->ctx, MPP_ENC_GET_CFG, cfg);
+    ret = enc->mpi->control(enc->ctx, MPP_ENC_GET_CFG, enc->cfg);
     if (ret) {
         LOGE("[%s] MPP_ENC_GET_CFG failed: %d", TAG, ret);
-        mpp_enc_cfg_deinit(cfg);
+        encoder_mpp_deinit(enc);
         return -1;
     }
 
 
     /* prep：输入图像参数与格式。 */
-    mpp_enc_cfg_set_s32(cfg, "prep:width",       enc->width);
-    mpp_enc_cfg_set_s32(cfg, "prep:height",      enc->height);
-    mpp_enc_cfg_set_s32(cfg, "prep:hor_stride",  enc->hor_stride);
-    mpp_enc_cfg_set_s32(cfg, "prep:ver_stride",  enc->ver_stride);
-    mpp_enc_cfg_set_s32(cfg, "prep:format",      ENC_INPUT_FMT);
-
-    /* rc：码率控制（CBR），并设置 fps/gop 等关键参数。 */
-    RK_S32 bps = (bitrate_bps > 0) ? bitrate_bps : (enc->width * enc->height * 5);
-    mpp_enc_cfg_set_s32(cfg, "rc:mode",          MPP_ENC_RC_MODE_CBR);
-    mpp_enc_cfg_set_s32(cfg, "rc:bps_target",    bps);
-    mpp_enc_cfg_set_s32(cfg, "rc:bps_max",       bps * 17 / 16);
-    mpp_enc_cfg_set_s32(cfg, "rc:bps_min",       bps * 15 / 16);
-    mpp_enc_cfg_set_s32(cfg, "rc:fps_in_num",    fps > 0 ? fps : 30);
-    mpp_enc_cfg_set_s32(cfg, "rc:fps_in_denorm", 1);
-    mpp_enc_cfg_set_s32(cfg, "rc:fps_out_num",   fps > 0 ? fps : 30);
-    mpp_enc_cfg_set_s32(cfg, "rc:fps_out_denorm",1);
-    mpp_enc_cfg_set_s32(cfg, "rc:gop",           (fps > 0 ? fps : 30) * 2);
+    mpp_enc_cfg_set_s32(enc->cfg, "prep:width",       enc->width);
+    mpp_enc_cfg_set_s32(enc->cfg, "prep:height",      enc->height);
+    mpp_enc_cfg_set_s32(enc->cfg, "prep:hor_stride",  enc->hor_stride);
+    mpp_enc_cfg_set_s32(enc->cfg, "prep:ver_stride",  enc->ver_stride);
+    mpp_enc_cfg_set_s32(enc->cfg, "prep:format",      ENC_INPUT_FMT);
+
+    /* rc：码率控制模式、fps/gop 等关键参数。 */
+    fill_rc_cfg(enc);
+
+    /* split：低延迟分片输出（可选）。 */
+    if (o->slices > 1) fill_split_cfg(enc, o->slices);
 
     /* 应用配置到编码器。 */
-    ret = enc->mpi->control(enc->ctx, MPP_ENC_SET_CFG, cfg);
+    ret = enc->mpi->control(enc->ctx, MPP_ENC_SET_CFG, enc->cfg);
     if (ret) {
         LOGE("[%s] MPP_ENC_SET_CFG failed: %d", TAG, ret);
         encoder_mpp_deinit(enc);
         return -1;
     }
 
-    LOGI("[%s] init ok %dx%d fps=%d bitrate=%d", TAG, enc->width, enc->height, fps, bps);
+    /*
+     * 每个 IDR 前都输出 SPS/PPS（HEVC 还有 VPS）：TS 等流式封装与从中间截断的裸流都需要
+     * 在任一关键帧处可独立解码。失败只告警（仅首帧带头，文件开头仍可播）。MJPEG 每帧独立，无需设置。
+     */
+    if (enc->type != MPP_VIDEO_CodingMJPEG) {
+        MppEncHeaderMode hdr_mode = MPP_ENC_HEADER_MODE_EACH_IDR;
+        ret = enc->mpi->control(enc->ctx, MPP_ENC_SET_HEADER_MODE, &hdr_mode);
+        if (ret) LOGW("[%s] MPP_ENC_SET_HEADER_MODE failed: %d", TAG, ret);
+    }
+
+    if (enc->rc_mode == ENC_RC_FIXQP) {
+        LOGI("[%s] init ok %s %dx%d stride=%dx%d fps=%d rc=fixqp qp=%d gop=%d", TAG,
+             encoder_mpp_coding_name(enc->type), enc->width, enc->height,
+             enc->hor_stride, enc->ver_stride, enc->fps, enc->qp > 0 ? enc->qp : 26, effective_gop(enc));
+    } else {
+        LOGI("[%s] init ok %s %dx%d stride=%dx%d fps=%d rc=%s bitrate=%d gop=%d", TAG,
+             encoder_mpp_coding_name(enc->type), enc->width, enc->height,
+             enc->hor_stride, enc->ver_stride, enc->fps, encoder_mpp_rc_name(enc->rc_mode),
+             enc->bitrate, effective_gop(enc));
+    }
+    if (enc->slices > 1) LOGI("[%s] low-latency slice output: %d slices/frame", TAG, enc->slices);
+    return 0;
+}
+
+/*
+ * 取走运行时调整请求并在当前帧之前生效。只在提交线程（put_frame 之前）调用，
+ * 因此 cfg 不需要加锁，且新参数从下一帧开始，不会落在一帧的中途。
+ * SET_CFG 失败时回滚到旧值并告警，编码继续。
+ */
+static void apply_pending(EncoderMPP *enc)
+{
+    int bps = atomic_exchange_explicit(&enc->req_bitrate, 0, memory_order_acq_rel);
+    int fps = atomic_exchange_explicit(&enc->req_fps, 0, memory_order_acq_rel);
+    int idr = atomic_exchange_explicit(&enc->req_idr, 0, memory_order_acq_rel);
+
+    if ((bps > 0 && bps != enc->bitrate) || (fps > 0 && fps != enc->fps)) {
+        int old_bps = enc->bitrate, old_fps = enc->fps;
+        if (bps > 0) enc->bitrate = bps;
+        if (fps > 0) enc->fps = fps;
+        fill_rc_cfg(enc);
+        MPP_RET ret = enc->mpi->control(enc->ctx, MPP_ENC_SET_CFG, enc->cfg);
+        if (ret) {
+            LOGW("[%s] runtime MPP_ENC_SET_CFG failed: %d, keep bitrate=%d fps=%d", TAG,
+                 ret, old_bps, old_fps);
+            enc->bitrate = old_bps;
+            enc->fps     = old_fps;
+            fill_rc_cfg(enc);
+        } else {
+            LOGI("[%s] reconfigured bitrate=%d fps=%d gop=%d", TAG,
+                 enc->bitrate, enc->fps, effective_gop(enc));
+        }
+    }
+
+    if (idr) {
+        MPP_RET ret = enc->mpi->control(enc->ctx, MPP_ENC_SET_IDR_FRAME, NULL);
+        if (ret) LOGW("[%s] MPP_ENC_SET_IDR_FRAME failed: %d", TAG, ret);
+    }
+}
+
+int encoder_mpp_set_bitrate(EncoderMPP *enc, int bitrate_bps)
+{
+    if (!enc || !enc->ctx || bitrate_bps <= 0) return -1;
+    atomic_store_explicit(&enc->req_bitrate, bitrate_bps, memory_order_release);
+    return 0;
+}
+
+int encoder_mpp_set_fps(EncoderMPP *enc, int fps)
+{
+    if (!enc || !enc->ctx || fps <= 0 || fps > 240) return -1;
+    atomic_store_explicit(&enc->req_fps, fps, memory_order_release);
+    return 0;
+}
+
+int encoder_mpp_request_idr(EncoderMPP *enc)
+{
+    if (!enc || !enc->ctx) return -1;
+    atomic_store_explicit(&enc->req_idr, 1, memory_order_release);
+    return 0;
+}
+
+/*
+ * 导入一个外部 DMABUF 作为输入 buffer。
+ *
+ * 实现：
+ * - 首次调用时创建 external buffer group（DRM 类型，内存由外部提供，MPP 不分配）
+ * - 以 MPP_BUFFER_TYPE_EXT_DMA 导入 fd，按 index 保存，之后每帧只传句柄
+ * - 将输出超时设为阻塞：encode_ext 必须等到 packet 产出后才能返回，
+ *   以保证调用者 QBUF 时硬件已经读完该帧
+ *
+ * @param enc    编码器实例
+ * @param index  外部 buffer 索引（通常为 V4L2 buffer index）
+ * @param fd     DMABUF fd（导入后 MPP 自行 dup，调用者仍负责关闭原 fd）
+ * @param size   buffer 大小（字节，需覆盖 hor_stride*ver_stride*3/2）
+ * @return       0 成功；-1 失败
+ */
+int encoder_mpp_import_dmabuf(EncoderMPP *enc, int index, int fd, size_t size)
+{
+    if (!enc || !enc->ctx || index < 0 || index >= ENC_MAX_EXT_BUFS || fd < 0) return -1;
+    if (size < enc->frame_size) {
+        LOGE("[%s] dmabuf[%d] too small: %zu < %zu", TAG, index, size, enc->frame_size);
+        return -1;
+    }
+
+    MPP_RET ret;
+
+    if (!enc->ext_grp) {
+        ret = mpp_buffer_group_get_external(&enc->ext_grp, MPP_BUFFER_TYPE_DRM);
+        if (ret) {
+            LOGE("[%s] mpp_buffer_group_get_external failed: %d", TAG, ret);
+            enc->ext_grp = NULL;
+            return -1;
+        }
+
+        MppPollType timeout = MPP_POLL_BLOCK;
+        ret = enc->mpi->control(enc->ctx, MPP_SET_OUTPUT_TIMEOUT, &timeout);
+        if (ret) {
+            LOGE("[%s] MPP_SET_OUTPUT_TIMEOUT failed: %d", TAG, ret);
+            return -1;
+        }
+    }
+
+    MppBufferInfo info;
+    memset(&info, 0, sizeof(info));
+    info.type  = MPP_BUFFER_TYPE_EXT_DMA;
+    info.fd    = fd;
+    info.size  = size;
+    info.index = index;
+
+    ret = mpp_buffer_import_with_tag(enc->ext_grp, &info, &enc->ext_bufs[index],
+                                     TAG, __FUNCTION__);
+    if (ret) {
+        LOGE("[%s] mpp_buffer_import[%d] fd=%d failed: %d", TAG, index, fd, ret);
+        enc->ext_bufs[index] = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * packet 是否为关键帧：优先看输出 meta 的 KEY_OUTPUT_INTRA，退化为 packet flag。
+ */
+static int packet_is_intra(MppPacket p)
+{
+    RK_S32 intra = 0;
+    MppMeta meta = mpp_packet_get_meta(p);
+    if (meta && mpp_meta_get_s32(meta, KEY_OUTPUT_INTRA, &intra) == MPP_OK && intra)
+        return 1;
+    return (mpp_packet_get_flag(p) & MPP_PACKET_FLAG_INTRA) ? 1 : 0;
+}
+
+/*
+ * 分片 AU 的开头一片是否属于关键帧：输出 meta 可能要到最后一片才齐，这里按第一个 NAL 的类型判断
+ * （每个 IDR 前都带参数集，见 MPP_ENC_HEADER_MODE_EACH_IDR）。
+ * H.264：IDR(5) / SPS(7) / PPS(8)；H.265：IRAP(16..21) / VPS / SPS / PPS(32..34)。
+ */
+static int slice_is_intra(const uint8_t *d, size_t len, int hevc)
+{
+    size_t i = 0;
+    while (i + 3 < len && !(d[i] == 0 && d[i + 1] == 0 && d[i + 2] == 1)) i++;
+    if (i + 3 >= len) return 0;
+    uint8_t b = d[i + 3];
+    if (hevc) {
+        int t = (b >> 1) & 0x3F;
+        return (t >= 16 && t <= 21) || (t >= 32 && t <= 34);
+    }
+    int t = b & 0x1F;
+    return t == 5 || t == 7 || t == 8;
+}
+
+/*
+ * 把一个已就绪的输入 MppBuffer 送入编码器并取回 packet：
+ * 1) 构造 MppFrame 并 encode_put_frame
+ * 2) encode_get_packet 获取编码输出（可能暂时拿不到 packet，此时 pkt->len == 0）
+ */
+static int encode_mpp_buffer(EncoderMPP *enc, MppBuffer buf, EncPacket *pkt)
+{
+    memset(pkt, 0, sizeof(*pkt));
+    if (enc->slices > 1) {
+        /* 同步接口一次只取一个 packet，分片输出会把一帧拆散 */
+        LOGE("[%s] slice output requires async mode", TAG);
+        return -1;
+    }
+
+    /* 构造 MppFrame 元数据，并绑定输入 buffer。 */
+    MppFrame frame = NULL;
+    MPP_RET ret = mpp_frame_init(&frame);
+    if (ret) {
+        LOGE("[%s] mpp_frame_init failed: %d", TAG, ret);
+        return -1;
+    }
+
+    mpp_frame_set_width(frame, enc->width);
+    mpp_frame_set_height(frame, enc->height);
+    mpp_frame_set_hor_stride(frame, enc->hor_stride);
+    mpp_frame_set_ver_stride(frame, enc->ver_stride);
+    mpp_frame_set_fmt(frame, ENC_INPUT_FMT);
+    mpp_frame_set_buffer(frame, buf);
+    mpp_frame_set_eos(frame, 0);
+
+    /* 投递一帧到编码器。 */
+    apply_pending(enc);
+    TRACE_BEGIN("encode_put_frame");
+    ret = enc->mpi->encode_put_frame(enc->ctx, frame);
+    TRACE_END();
+    mpp_frame_deinit(&frame);
+    if (ret) {
+        LOGE("[%s] encode_put_frame failed: %d", TAG, ret);
+        return -1;
+    }
+
+    /* 拉取编码输出 packet。 */
+    MppPacket out = NULL;
+    TRACE_BEGIN("encode_get_packet");
+    ret = enc->mpi->encode_get_packet(enc->ctx, &out);
+    TRACE_END();
+    if (ret || !out) {
+        // no packet ready is OK, but usually should not happen for realtime
+        return 0;
+    }
+
+    pkt->handle   = out;
+    pkt->data     = (const uint8_t *)mpp_packet_get_pos(out);
+    pkt->len      = pkt->data ? mpp_packet_get_length(out) : 0;
+    pkt->keyframe = enc->type == MPP_VIDEO_CodingMJPEG || packet_is_intra(out);
     return 0;
 }
 
+/*
+ * 将 packet 写入 sink 并归还给 MPP。
+ */
+static int write_packet_to_sink(EncPacket *pkt, EncSink *sink, size_t *out_bytes)
+{
+    int sink_ret = 0;
+    if (pkt->data && pkt->len > 0 && sink) {
+        /* 将编码后的字节流写入下游（例如文件）。 */
+        sink_ret = enc_sink_write(sink, pkt->data, pkt->len);
+        if (sink_ret == 0 && out_bytes) *out_bytes = pkt->len;
+    }
+
+    encoder_mpp_packet_release(pkt);
+
+    return (sink_ret != 0) ? -1 : 0;
+}
+
+/*
+ * 将一帧连续 NV12 数据复制到指定的 MPP 输入缓冲（不足则补 0；按 stride 重排时 stride / ver_stride 填充区清零）。
+ */
+static int copy_input_frame(EncoderMPP *enc, MppBuffer buf,
+                            const uint8_t *frame_data, size_t frame_size)
+{
+    if (!enc || !enc->ctx || !enc->mpi || !buf) {
+        LOGE("[%s] encoder_mpp_encode: invalid encoder", TAG);
+        return -1;
+    }
+    if (!frame_data || frame_size == 0) {
+        LOGE("[%s] encoder_mpp_encode: no input data", TAG);
+        return -1;
+    }
+
+    void  *dst = mpp_buffer_get_ptr(buf);
+
+    /*
+     * 紧密排列（stride == width）的 NV12 且编码器 stride 有对齐填充时，
+     * 整块 memcpy 会把 UV 与后续各行错位，必须按行写到 hor_stride/ver_stride 位置。
+     */
+    size_t packed_size = (size_t)enc->width * (size_t)enc->height * 3 / 2;
+    if (frame_size == packed_size && packed_size != enc->frame_size) {
+        Nv12Planes s = {
+            .y         = (uint8_t *)frame_data,
+            .uv        = (uint8_t *)frame_data + (size_t)enc->width * enc->height,
+            .y_stride  = (unsigned int)enc->width,
+            .uv_stride = (unsigned int)enc->width,
+        };
+        Nv12Planes d = {
+            .y         = (uint8_t *)dst,
+            .uv        = (uint8_t *)dst + (size_t)enc->hor_stride * enc->ver_stride,
+            .y_stride  = (unsigned int)enc->hor_stride,
+            .uv_stride = (unsigned int)enc->hor_stride,
+        };
+        if (nv12_repack(&s, &d, (unsigned int)enc->width, (unsigned int)enc->height, 0, 0) != 0) return -1;
+        /* 与整块拷贝路径一样不留残留：输入池 buffer 复用，stride / ver_stride 填充区每帧清零 */
+        nv12_clear_padding(&d, (unsigned int)enc->width, (unsigned int)enc->height, (unsigned int)enc->ver_stride);
+        return 0;
+    }
+
+    size_t copy_size = frame_size > enc->frame_size ? enc->frame_size : frame_size;
+    memcpy(dst, frame_data, copy_size);
+    if (copy_size < enc->frame_size) {
+        /* 输入不足时补 0，避免读到未初始化内容。 */
+        memset((uint8_t *)dst + copy_size, 0, enc->frame_size - copy_size);
+    }
+    return 0;
+}
+
+/*
+ * 按 index 取出已导入的外部 buffer，不存在则返回 NULL。
+ */
+static MppBuffer ext_buffer_at(EncoderMPP *enc, int index)
+{
+    if (!enc || !enc->ctx || !enc->mpi) {
+        LOGE("[%s] encoder_mpp_encode_ext: invalid encoder", TAG);
+        return NULL;
+    }
+    if (index < 0 || index >= ENC_MAX_EXT_BUFS || !enc->ext_bufs[index]) {
+        LOGE("[%s] encoder_mpp_encode_ext: buffer %d not imported", TAG, index);
+        return NULL;
+    }
+    return enc->ext_bufs[index];
+}
+
 /*
  * 编码一帧 NV12 数据：
  * 1) 将输入 frame_data 复制到 MPP buffer（不足则补 0）
@@ -216,29 +897,202 @@ int encoder_mpp_encode(EncoderMPP *enc,
 {
     if (out_bytes) *out_bytes = 0;
 
-    if (!enc || !enc->ctx || !enc->mpi || !enc->frm_buf) {
-        LOGE("[%s] encoder_mpp_encode: invalid encoder", TAG);
+    EncPacket pkt;
+    if (encoder_mpp_encode_frame(enc, frame_data, frame_size, &pkt) != 0)
+        return -1;
+
+    return write_packet_to_sink(&pkt, sink, out_bytes);
+}
+
+/*
+ * 编码一帧已导入的外部 buffer：直接把导入的 MppBuffer 绑定到 MppFrame，无 CPU 拷贝。
+ *
+ * 返回值约定同 encoder_mpp_encode。
+ */
+int encoder_mpp_encode_ext(EncoderMPP *enc, int index,
+                           EncSink *sink,
+                           size_t *out_bytes)
+{
+    if (out_bytes) *out_bytes = 0;
+
+    EncPacket pkt;
+    if (encoder_mpp_encode_ext_frame(enc, index, &pkt) != 0)
+        return -1;
+
+    return write_packet_to_sink(&pkt, sink, out_bytes);
+}
+
+/*
+ * 编码一帧连续 NV12 数据，packet 交给调用者（不写 sink）。
+ *
+ * @param pkt  输出：packet 视图；len==0 表示暂时没有 packet
+ * @return     0 成功；-1 失败
+ */
+int encoder_mpp_encode_frame(EncoderMPP *enc,
+                             const uint8_t *frame_data,
+                             size_t frame_size,
+                             EncPacket *pkt)
+{
+    if (!pkt) return -1;
+    memset(pkt, 0, sizeof(*pkt));
+
+    /* 同步拷贝路径才用 frm_buf：第一帧时申请一块连续缓冲，之后每帧把 NV12 数据拷进来 */
+    if (enc && enc->buf_grp && !enc->frm_buf && input_buf_get(enc, &enc->frm_buf) != MPP_OK) {
+        LOGE("[%s] mpp_buffer_get frame buffer failed", TAG);
+        enc->frm_buf = NULL;
         return -1;
     }
-    if (!frame_data || frame_size == 0) {
-        LOGE("[%s] encoder_mpp_encode: no input data", TAG);
+    if (copy_input_frame(enc, enc ? enc->frm_buf : NULL, frame_data, frame_size) != 0)
         return -1;
+
+    return encode_mpp_buffer(enc, enc->frm_buf, pkt);
+}
+
+/*
+ * 编码一帧已导入的外部 buffer，packet 交给调用者（不写 sink）。
+ * 返回时 MPP 已不再读取该 buffer。
+ */
+int encoder_mpp_encode_ext_frame(EncoderMPP *enc, int index, EncPacket *pkt)
+{
+    if (!pkt) return -1;
+    memset(pkt, 0, sizeof(*pkt));
+
+    MppBuffer buf = ext_buffer_at(enc, index);
+    if (!buf) return -1;
+
+    return encode_mpp_buffer(enc, buf, pkt);
+}
+
+/*
+ * 归还 packet（mpp_packet_deinit），并清空视图。
+ */
+void encoder_mpp_packet_release(EncPacket *pkt)
+{
+    if (!pkt) return;
+    if (pkt->handle) {
+        MppPacket p = pkt->handle;
+        mpp_packet_deinit(&p);
     }
+    memset(pkt, 0, sizeof(*pkt));
+}
 
-    /* 将一帧输入数据拷贝到 MPP 的输入缓冲。 */
-    void  *dst = mpp_buffer_get_ptr(enc->frm_buf);
-    size_t copy_size = frame_size > enc->frame_size ? enc->frame_size : frame_size;
-    memcpy(dst, frame_data, copy_size);
-    if (copy_size < enc->frame_size) {
-        /* 输入不足时补 0，避免读到未初始化内容。 */
-        memset((uint8_t *)dst + copy_size, 0, enc->frame_size - copy_size);
+/* ===================== Async API ===================== */
+
+static int64_t mono_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/*
+ * 开启异步模式。
+ *
+ * - 输入超时设为阻塞：MPP 任务队列满时 put_frame 等待，形成自然背压
+ * - 输出超时设为 poll_timeout_ms：取包线程可以周期性检查退出条件
+ * - with_input_pool=1 时为每个在途槽分配一块输入 buffer（拷贝路径）
+ *
+ * @param enc              已初始化的编码器
+ * @param depth            在途帧数上限（1..ENC_MAX_INFLIGHT）
+ * @param with_input_pool  是否分配输入池
+ * @param poll_timeout_ms  encoder_mpp_poll_packet 的最长阻塞时间
+ * @return                 0 成功；-1 失败
+ */
+int encoder_mpp_setup_async(EncoderMPP *enc, int depth, int with_input_pool,
+                            int poll_timeout_ms)
+{
+    if (!enc || !enc->ctx || !enc->mpi || enc->async_depth > 0) return -1;
+    if (depth < 1) depth = 1;
+    if (depth > ENC_MAX_INFLIGHT) depth = ENC_MAX_INFLIGHT;
+
+    MppPollType in_timeout  = MPP_POLL_BLOCK;
+    MppPollType out_timeout = (MppPollType)(poll_timeout_ms > 0 ? poll_timeout_ms : MPP_POLL_NON_BLOCK);
+    MPP_RET ret = enc->mpi->control(enc->ctx, MPP_SET_INPUT_TIMEOUT, &in_timeout);
+    if (!ret) ret = enc->mpi->control(enc->ctx, MPP_SET_OUTPUT_TIMEOUT, &out_timeout);
+    if (ret) {
+        LOGE("[%s] set async timeout failed: %d", TAG, ret);
+        return -1;
     }
 
-    /* 构造 MppFrame 元数据，并绑定输入 buffer。 */
+    for (int i = 0; i < depth; i++) {
+        EncInflight *f = &enc->inflight[i];
+        f->buf = NULL;
+        f->ext_index = -1;
+        atomic_store(&f->busy, 0);
+        if (with_input_pool) {
+            ret = input_buf_get(enc, &f->buf);
+            if (ret) {
+                LOGE("[%s] mpp_buffer_get(input pool %d) failed: %d", TAG, i, ret);
+                for (int j = 0; j < i; j++) {
+                    mpp_buffer_put(enc->inflight[j].buf);
+                    enc->inflight[j].buf = NULL;
+                }
+                f->buf = NULL;
+                return -1;
+            }
+        }
+    }
+
+    sem_init(&enc->in_free, 0, (unsigned int)depth);
+    atomic_store(&enc->inflight_count, 0);
+    enc->submit_seq  = 0;
+    enc->async_depth = depth;
+
+    LOGI("[%s] async mode: depth=%d input_pool=%d poll_timeout=%dms", TAG,
+         depth, with_input_pool, poll_timeout_ms);
+    return 0;
+}
+
+/*
+ * 等待并占用一个空闲在途槽（仅提交线程调用）。
+ * @return 槽指针；超时返回 NULL
+ */
+static EncInflight *acquire_inflight(EncoderMPP *enc, int timeout_ms)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += (long)(timeout_ms > 0 ? timeout_ms : 0) * 1000000L;
+    while (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    if (sem_timedwait(&enc->in_free, &ts) != 0) return NULL;
+
+    for (int i = 0; i < enc->async_depth; i++) {
+        if (!atomic_load_explicit(&enc->inflight[i].busy, memory_order_acquire))
+            return &enc->inflight[i];
+    }
+    /* 信号量与 busy 标志一一对应，不应走到这里 */
+    sem_post(&enc->in_free);
+    return NULL;
+}
+
+/* 归还在途槽（取包线程调用，或提交失败时由提交线程调用） */
+static void release_inflight(EncoderMPP *enc, EncInflight *f)
+{
+    atomic_store_explicit(&f->busy, 0, memory_order_release);
+    atomic_fetch_sub(&enc->inflight_count, 1);
+    sem_post(&enc->in_free);
+}
+
+/*
+ * 把 buf 作为一帧投递给 MPP，并登记到在途槽 f。
+ */
+static int submit_inflight(EncoderMPP *enc, EncInflight *f, MppBuffer buf,
+                           int ext_index, int64_t pts)
+{
+    f->ext_index = ext_index;
+    f->pts       = pts;
+    f->seq       = enc->submit_seq++;
+    f->submit_us = mono_now_us();
+    atomic_store_explicit(&f->busy, 1, memory_order_release);
+    atomic_fetch_add(&enc->inflight_count, 1);
+
     MppFrame frame = NULL;
     MPP_RET ret = mpp_frame_init(&frame);
     if (ret) {
         LOGE("[%s] mpp_frame_init failed: %d", TAG, ret);
+        release_inflight(enc, f);
         return -1;
     }
 
@@ -247,46 +1101,227 @@ int encoder_mpp_encode(EncoderMPP *enc,
     mpp_frame_set_hor_stride(frame, enc->hor_stride);
     mpp_frame_set_ver_stride(frame, enc->ver_stride);
     mpp_frame_set_fmt(frame, ENC_INPUT_FMT);
-    mpp_frame_set_buffer(frame, enc->frm_buf);
+    mpp_frame_set_buffer(frame, buf);
+    mpp_frame_set_pts(frame, pts);
     mpp_frame_set_eos(frame, 0);
 
-    /* 投递一帧到编码器。 */
+    apply_pending(enc);
+    int64_t t0 = mono_now_us();
+    TRACE_BEGIN("encode_put_frame f=%lld", (long long)pts);
     ret = enc->mpi->encode_put_frame(enc->ctx, frame);
+    TRACE_END();
+    enc->last_put_us = mono_now_us() - t0;
     mpp_frame_deinit(&frame);
     if (ret) {
         LOGE("[%s] encode_put_frame failed: %d", TAG, ret);
+        release_inflight(enc, f);
         return -1;
     }
+    return 0;
+}
 
-    /* 拉取编码输出 packet。 */
-    MppPacket pkt = NULL;
-    ret = enc->mpi->encode_get_packet(enc->ctx, &pkt);
+/*
+ * 异步提交一帧连续 NV12 数据（拷贝到输入池）。
+ */
+int encoder_mpp_submit(EncoderMPP *enc, const uint8_t *frame_data, size_t frame_size,
+                       int64_t pts, int timeout_ms)
+{
+    if (!enc || enc->async_depth <= 0) return -1;
+
+    EncInflight *f = acquire_inflight(enc, timeout_ms);
+    if (!f) return 1;
+
+    int64_t t0 = mono_now_us();
+    TRACE_BEGIN("copy f=%lld", (long long)pts);
+    int ret = !f->buf || copy_input_frame(enc, f->buf, frame_data, frame_size) != 0;
+    TRACE_END();
     if (ret) {
-        // no packet ready is OK, but usually should not happen for realtime
-        return 0;
+        sem_post(&enc->in_free);
+        return -1;
     }
+    enc->last_copy_us = mono_now_us() - t0;
 
-    if (pkt) {
-        void  *ptr = mpp_packet_get_pos(pkt);
-        size_t len = mpp_packet_get_length(pkt);
+    return submit_inflight(enc, f, f->buf, -1, pts);
+}
 
-        int sink_ret = 0;
-        if (ptr && len > 0 && sink) {
-            /* 将编码后的字节流写入下游（例如文件）。 */
-            sink_ret = enc_sink_write(sink, (const uint8_t *)ptr, len);
-            if (sink_ret == 0 && out_bytes) *out_bytes = len;
-        }
+/*
+ * 异步提交一帧平面描述的 NV12：直接从源平面 repack 进输入池 buffer（单次拷贝）。
+ */
+int encoder_mpp_submit_nv12(EncoderMPP *enc, const Nv12Planes *src,
+                            unsigned int src_width, unsigned int src_height,
+                            int64_t pts, int timeout_ms)
+{
+    if (!enc || enc->async_depth <= 0 || !src) return -1;
+    if (src_width < (unsigned int)enc->width || src_height < (unsigned int)enc->height) {
+        LOGE("[%s] source %ux%u smaller than encoder %dx%d", TAG, src_width, src_height,
+             enc->width, enc->height);
+        return -1;
+    }
 
-        mpp_packet_deinit(&pkt);
+    EncInflight *f = acquire_inflight(enc, timeout_ms);
+    if (!f) return 1;
 
-        if (sink_ret != 0) {
-            return -1;
+    uint8_t *dst = f->buf ? (uint8_t *)mpp_buffer_get_ptr(f->buf) : NULL;
+    Nv12Planes d = {
+        .y         = dst,
+        .uv        = dst ? dst + (size_t)enc->hor_stride * enc->ver_stride : NULL,
+        .y_stride  = (unsigned int)enc->hor_stride,
+        .uv_stride = (unsigned int)enc->hor_stride,
+    };
+    /* 居中裁剪：偏移在 nv12_repack 内向下取偶 */
+    unsigned int crop_x = (src_width  - (unsigned int)enc->width)  / 2;
+    unsigned int crop_y = (src_height - (unsigned int)enc->height) / 2;
+    int64_t t0 = mono_now_us();
+    TRACE_BEGIN("copy f=%lld", (long long)pts);
+    int ret = !dst || nv12_repack(src, &d, (unsigned int)enc->width, (unsigned int)enc->height,
+                                  crop_x, crop_y) != 0;
+    if (!ret)
+        nv12_clear_padding(&d, (unsigned int)enc->width, (unsigned int)enc->height, (unsigned int)enc->ver_stride);
+    TRACE_END();
+    if (ret) {
+        LOGE("[%s] repack input failed", TAG);
+        sem_post(&enc->in_free);
+        return -1;
+    }
+    enc->last_copy_us = mono_now_us() - t0;
+
+    return submit_inflight(enc, f, f->buf, -1, pts);
+}
+
+/*
+ * 异步提交一帧已导入的外部 buffer（零拷贝）。
+ */
+int encoder_mpp_submit_ext(EncoderMPP *enc, int index, int64_t pts, int timeout_ms)
+{
+    if (!enc || enc->async_depth <= 0) return -1;
+
+    MppBuffer buf = ext_buffer_at(enc, index);
+    if (!buf) return -1;
+
+    EncInflight *f = acquire_inflight(enc, timeout_ms);
+    if (!f) return 1;
+
+    enc->last_copy_us = 0;
+    return submit_inflight(enc, f, buf, index, pts);
+}
+
+/*
+ * 交出一个输入池 buffer 给外部写入（不经 CPU repack）。
+ * 在途槽在 submit_input / cancel_input 之前一直被占用。
+ */
+int encoder_mpp_acquire_input(EncoderMPP *enc, int timeout_ms, EncInputBuf *in)
+{
+    if (!enc || enc->async_depth <= 0 || !in) return -1;
+
+    EncInflight *f = acquire_inflight(enc, timeout_ms);
+    if (!f) return 1;
+    if (!f->buf) {
+        sem_post(&enc->in_free);
+        return -1;
+    }
+
+    in->slot       = (int)(f - enc->inflight);
+    in->fd         = mpp_buffer_get_fd(f->buf);
+    in->ptr        = (uint8_t *)mpp_buffer_get_ptr(f->buf);
+    in->width      = enc->width;
+    in->height     = enc->height;
+    in->hor_stride = enc->hor_stride;
+    in->ver_stride = enc->ver_stride;
+    return 0;
+}
+
+/*
+ * 投递外部写好的输入池 buffer。
+ */
+int encoder_mpp_submit_input(EncoderMPP *enc, const EncInputBuf *in, int64_t pts)
+{
+    if (!enc || !in || in->slot < 0 || in->slot >= enc->async_depth) return -1;
+
+    EncInflight *f = &enc->inflight[in->slot];
+    enc->last_copy_us = 0;
+    return submit_inflight(enc, f, f->buf, -1, pts);
+}
+
+void encoder_mpp_cancel_input(EncoderMPP *enc, const EncInputBuf *in)
+{
+    if (!enc || !in || in->slot < 0 || in->slot >= enc->async_depth) return;
+    /* 槽未登记为 busy，只需归还信号量 */
+    sem_post(&enc->in_free);
+}
+
+/*
+ * 取一个 packet 并回收对应的在途槽。
+ *
+ * 按 pts 匹配在途帧（MPP 会把输入帧 pts 带到输出 packet）；
+ * 匹配不到时回收最早提交的那一帧（编码器不重排序，输出顺序即输入顺序）。
+ * 分片输出时每一片都带着帧的 pts，只在最后一片（is_eoi）回收。
+ */
+int encoder_mpp_poll_packet(EncoderMPP *enc, EncPacket *pkt)
+{
+    if (!pkt) return -1;
+    memset(pkt, 0, sizeof(*pkt));
+    pkt->ext_index = -1;
+
+    if (!enc || enc->async_depth <= 0) return -1;
+
+    MppPacket out = NULL;
+    TRACE_BEGIN("encode_get_packet");
+    MPP_RET ret = enc->mpi->encode_get_packet(enc->ctx, &out);
+    TRACE_END();
+    if (ret || !out) return 1;
+
+    pkt->handle   = out;
+    pkt->data     = (const uint8_t *)mpp_packet_get_pos(out);
+    pkt->len      = pkt->data ? mpp_packet_get_length(out) : 0;
+    pkt->pts      = mpp_packet_get_pts(out);
+    pkt->keyframe = enc->type == MPP_VIDEO_CodingMJPEG || packet_is_intra(out);
+
+    if (enc->slices > 1 && mpp_packet_is_partition(out)) {
+        int eoi = mpp_packet_is_eoi(out) ? 1 : 0;
+        if (!enc->part_open) {
+            pkt->part = eoi ? TS_AU_WHOLE : TS_AU_FIRST;
+            enc->part_key = pkt->keyframe ||
+                            slice_is_intra(pkt->data, pkt->len, enc->type == MPP_VIDEO_CodingHEVC);
+            pkt->keyframe = enc->part_key;
+        } else {
+            pkt->part     = eoi ? TS_AU_LAST : TS_AU_MID;
+            pkt->keyframe = 0;
         }
+        enc->part_open = !eoi;
+    } else if (enc->part_open) {
+        /* 上一帧没收到最后一片（不应发生）：按新的整帧处理 */
+        LOGW("[%s] slice output: frame ended without eoi", TAG);
+        enc->part_open = 0;
     }
 
+    EncInflight *hit = NULL, *oldest = NULL;
+    for (int i = 0; i < enc->async_depth; i++) {
+        EncInflight *f = &enc->inflight[i];
+        if (!atomic_load_explicit(&f->busy, memory_order_acquire)) continue;
+        if (f->pts == pkt->pts) {
+            hit = f;
+            break;
+        }
+        if (!oldest || f->seq < oldest->seq) oldest = f;
+    }
+    if (!hit) hit = oldest;
+
+    if (hit) {
+        pkt->latency_us = mono_now_us() - hit->submit_us;
+        if (TS_AU_ENDS(pkt->part)) {
+            pkt->ext_index = hit->ext_index;
+            release_inflight(enc, hit);
+        }
+    }
     return 0;
 }
 
+int encoder_mpp_inflight(EncoderMPP *enc)
+{
+    if (!enc || enc->async_depth <= 0) return 0;
+    return atomic_load(&enc->inflight_count);
+}
+
 /*
  * 释放编码器资源：buffer、buffer group、MPP ctx，并将 enc 清零。
  */
@@ -296,14 +1331,41 @@ void encoder_mpp_deinit(EncoderMPP *enc)
 
     LOGI("[%s] encoder_mpp_deinit", TAG);
 
+    if (enc->async_depth > 0) {
+        for (int i = 0; i < enc->async_depth; i++) {
+            if (enc->inflight[i].buf) {
+                mpp_buffer_put(enc->inflight[i].buf);
+                enc->inflight[i].buf = NULL;
+            }
+        }
+        sem_destroy(&enc->in_free);
+        enc->async_depth = 0;
+    }
+
+    for (int i = 0; i < ENC_MAX_EXT_BUFS; i++) {
+        if (enc->ext_bufs[i]) {
+            mpp_buffer_put(enc->ext_bufs[i]);
+            enc->ext_bufs[i] = NULL;
+        }
+    }
+    if (enc->ext_grp) {
+        mpp_buffer_group_put(enc->ext_grp);
+        enc->ext_grp = NULL;
+    }
     if (enc->frm_buf) {
         mpp_buffer_put(enc->frm_buf);
         enc->frm_buf = NULL;
     }
+    if (enc->cfg) {
+        mpp_enc_cfg_deinit(enc->cfg);
+        enc->cfg = NULL;
+    }
     if (enc->buf_grp) {
         mpp_buffer_group_put(enc->buf_grp);
         enc->buf_grp = NULL;
     }
+    mem_arena_uncharge(MEM_STAGE_ENCODE, enc->ion_charged);
+    enc->ion_charged = 0;
     if (enc->ctx) {
         mpp_destroy(enc->ctx);
         enc->ctx = NULL;
@@ -1,6 +1,10 @@
 // encoder_mpp.h
 #pragma once
 
+#include <semaphore.h>
+#include <stdatomic.h>
+
+#include "nv12_repack.h"
 #include <stdint.h>
 #include <stddef.h>
 
@@ -24,18 +28,123 @@ typedef void *MppCtx;
 typedef struct MppApi MppApi;
 typedef void *MppBufferGroup;
 typedef void *MppBuffer;
+typedef void *MppPacket;
+typedef void *MppEncCfg;
 typedef int MppCodingType;
-enum { MPP_VIDEO_CodingAVC = 7 };
+enum { MPP_VIDEO_CodingAVC = 7, MPP_VIDEO_CodingMJPEG = 8, MPP_VIDEO_CodingHEVC = 0x1000004 };
 #endif
 
 #include "sink.h"
 
+/* 零拷贝模式下最多导入的外部输入 buffer 数（与 V4L2_MAX_BUFS 保持一致） */
+#define ENC_MAX_EXT_BUFS 32
+
+/* 异步模式下最多同时在编码器内的帧数 */
+#define ENC_MAX_INFLIGHT 4
+
+/* 码率控制模式 */
+typedef enum {
+    ENC_RC_CBR = 0,   // 恒定码率
+    ENC_RC_VBR,       // 可变码率（bitrate 为上限附近的目标）
+    ENC_RC_AVBR,      // 自适应 VBR：静止画面降码率
+    ENC_RC_FIXQP,     // 固定 QP（不控码率）
+} EncRcMode;
+
+/* 编码参数，见 encoder_mpp_init_opts */
+typedef struct {
+    MppCodingType type;         // MPP_VIDEO_CodingAVC / HEVC / MJPEG
+    int           width;
+    int           height;
+    int           hor_stride;   // <=0 按 16 对齐自动计算
+    int           ver_stride;
+    int           fps;          // <=0 按 30
+    int           bitrate;      // bps；<=0 按分辨率估算（FIXQP 不使用）
+    EncRcMode     rc_mode;
+    int           gop;          // I 帧间隔（帧）；0 = 2 × fps（运行时改 fps 时跟随）
+    int           qp;           // FIXQP 的 QP / MJPEG 的质量因子（1..99）；0 = 默认
+    int           slices;       // 低延迟分片：每帧按 CTU 行切成的 slice 数，每片编完即输出；<=1 = 整帧输出
+                                // （仅异步模式；MJPEG 不支持）
+} EncoderMppOpts;
+
+/*
+ * 一个编码输出 packet 的视图。data 指向 MPP 内部内存，
+ * 用完必须调用 encoder_mpp_packet_release 归还。
+ */
+typedef struct {
+    MppPacket      handle;
+    const uint8_t *data;
+    size_t         len;
+    int            keyframe;    // 1=IDR/I 帧（KEY_OUTPUT_INTRA）；分片时只在开头一片上置位
+
+    /* 以下字段仅异步模式（encoder_mpp_poll_packet）有效 */
+    int64_t        pts;         // 提交时传入的 pts（采集 PTS，微秒）
+    TsAuPart       part;        // 分片输出时为 AU 的第几片，否则 TS_AU_WHOLE
+    int            ext_index;   // 零拷贝输入的外部 buffer 索引；-1=内部输入池或不是最后一片
+    int64_t        latency_us;  // 提交 -> 取到 packet 的耗时（分片时为提交 -> 取到这一片）
+} EncPacket;
+
+/* 异步模式下一个“在途帧”的记录 */
+typedef struct {
+    MppBuffer      buf;         // 输入池 buffer（拷贝路径使用）
+    atomic_int     busy;        // 1=已提交，等待 packet
+    int            ext_index;   // 外部 buffer 索引；-1=输入池
+    int64_t        pts;
+    uint64_t       seq;         // 提交序号：pts 匹配不到时按 FIFO 回收
+    int64_t        submit_us;
+} EncInflight;
+
+/*
+ * 由外部填充的输入池 buffer（例如 RGA 直接缩放写入），见 encoder_mpp_acquire_input。
+ * 布局与编码器一致：NV12，UV 平面紧接在 hor_stride * ver_stride 之后。
+ */
+typedef struct {
+    int            slot;        // 在途槽下标（内部使用）
+    int            fd;          // DMABUF fd；-1=不可导出
+    uint8_t       *ptr;         // CPU 地址
+    int            width;
+    int            height;
+    int            hor_stride;
+    int            ver_stride;
+} EncInputBuf;
+
 typedef struct {
     MppCtx         ctx;
     MppApi        *mpi;
 
     MppBufferGroup buf_grp;
-    MppBuffer      frm_buf;
+    MppBuffer      frm_buf;       // 同步拷贝路径的输入帧，第一次 encoder_mpp_encode_frame 时分配
+    size_t         ion_charged;   // 输入 buffer（ION）计入内存预算的字节，deinit 时归还
+
+    /* 零拷贝：从外部（V4L2 DMABUF）导入的输入 buffer，按采集 buffer 索引存放 */
+    MppBufferGroup ext_grp;
+    MppBuffer      ext_bufs[ENC_MAX_EXT_BUFS];
+
+    /* 异步模式：输入池 + 在途帧表（提交线程与取包线程共享） */
+    int            async_depth;   // 0 = 同步模式
+    EncInflight    inflight[ENC_MAX_INFLIGHT];
+    sem_t          in_free;       // 空闲在途槽计数
+    atomic_int     inflight_count;
+    uint64_t       submit_seq;    // 仅提交线程写
+    int64_t        last_copy_us;  // 最近一次提交的 repack 耗时（0=零拷贝），仅提交线程写
+    int64_t        last_put_us;   // 最近一次 encode_put_frame 耗时，仅提交线程写
+
+    /* 编码配置：运行时调整在 cfg 上修改后重新 SET_CFG（仅提交线程） */
+    MppEncCfg      cfg;
+    EncRcMode      rc_mode;
+    int            fps;
+    int            bitrate;
+    int            gop;           // 0 = 2 × fps
+    int            qp;
+
+    /* 低延迟分片输出（slices > 1 时有效）；part_* 仅取包线程访问 */
+    int            slices;        // 实际每帧 slice 数（按 CTU 行数取整后）
+    int            part_open;     // 当前 AU 已取到开头一片、还没到最后一片
+    int            part_key;      // 当前 AU 是否为关键帧
+
+    /* 运行时调整请求（任意线程写，提交线程在下一帧之前取走）；0 = 无 */
+    atomic_int     req_bitrate;
+    atomic_int     req_fps;
+    atomic_int     req_idr;
 
     int            width;
     int            height;
@@ -46,16 +155,143 @@ typedef struct {
     MppCodingType  type;
 } EncoderMPP;
 
+/* 默认参数：H.264、CBR、GOP = 2 × fps。 */
+void encoder_mpp_default_opts(EncoderMppOpts *o);
+
+/*
+ * 按 opts 初始化编码器（编码格式 / 码率控制 / GOP / stride）。
+ * @return 0 成功；-1 失败
+ */
+int encoder_mpp_init_opts(EncoderMPP *enc, const EncoderMppOpts *o);
+
+/* 名称 <-> 编码格式："h264" / "h265" / "mjpeg"。@return 0 成功；-1 未知名称 */
+int         encoder_mpp_coding_from_name(const char *name, MppCodingType *type);
+const char *encoder_mpp_coding_name(MppCodingType type);
+/* 名称 <-> 码率控制模式："cbr" / "vbr" / "avbr" / "fixqp"。@return 0 成功；-1 未知名称 */
+int         encoder_mpp_rc_from_name(const char *name, EncRcMode *mode);
+const char *encoder_mpp_rc_name(EncRcMode mode);
+
 int encoder_mpp_init(EncoderMPP *enc,
                      int width, int height,
                      int fps,
                      int bitrate_bps,
                      MppCodingType type);
 
+/*
+ * 与 encoder_mpp_init 相同，但允许指定输入 stride（hor_stride 为字节数）。
+ * hor_stride/ver_stride <= 0 时按 16 对齐自动计算。
+ * 零拷贝模式下应传入采集端的 bytesperline/height，使 MPP 直接按 V4L2 布局读取。
+ */
+int encoder_mpp_init_ex(EncoderMPP *enc,
+                        int width, int height,
+                        int hor_stride, int ver_stride,
+                        int fps,
+                        int bitrate_bps,
+                        MppCodingType type);
+
+/*
+ * 将一个外部 DMABUF（例如 V4L2 EXPBUF 导出的 fd）导入为 MPP 输入 buffer。
+ * 只在启动阶段调用一次；之后按 index 用 encoder_mpp_encode_ext 编码。
+ */
+int encoder_mpp_import_dmabuf(EncoderMPP *enc, int index, int fd, size_t size);
+
+/*
+ * 编码一帧已导入的外部 buffer（无 CPU 拷贝）。
+ * 返回时 MPP 已输出该帧对应的 packet，即硬件不再读取该 buffer，
+ * 调用者此后才可以把对应的 V4L2 buffer 重新 QBUF。
+ */
+int encoder_mpp_encode_ext(EncoderMPP *enc, int index,
+                           EncSink *sink,
+                           size_t *out_bytes);
+
 int encoder_mpp_encode(EncoderMPP *enc,
                        const uint8_t *frame_data,
                        size_t frame_size,
                        EncSink *sink,
                        size_t *out_bytes);
 
+/*
+ * 与 encoder_mpp_encode / encoder_mpp_encode_ext 相同，但不写 sink，
+ * 而是把 packet 交给调用者（用于把“编码”和“写出”拆到不同线程）。
+ * 暂时没有 packet 时返回 0 且 pkt->len == 0。
+ */
+int encoder_mpp_encode_frame(EncoderMPP *enc,
+                             const uint8_t *frame_data,
+                             size_t frame_size,
+                             EncPacket *pkt);
+int encoder_mpp_encode_ext_frame(EncoderMPP *enc, int index, EncPacket *pkt);
+void encoder_mpp_packet_release(EncPacket *pkt);
+
+/*
+ * 异步编码 API：提交与取包分离，允许最多 depth 帧同时在编码器内。
+ *
+ * 用法：
+ *   encoder_mpp_setup_async(enc, depth, with_input_pool, poll_timeout_ms);
+ *   线程 A：encoder_mpp_submit() / encoder_mpp_submit_ext()
+ *   线程 B：encoder_mpp_poll_packet() -> 处理 -> encoder_mpp_packet_release()
+ *
+ * - with_input_pool=1 时分配 depth 块输入 MppBuffer（拷贝路径），同步路径的 frm_buf 不再分配；
+ *   纯零拷贝时可传 0。
+ * - 实际并发数还受 MPP 内部任务队列限制：put_frame 在编码器来不及时会阻塞。
+ * - 异步模式下不要再调用同步的 encoder_mpp_encode*。
+ */
+int encoder_mpp_setup_async(EncoderMPP *enc, int depth, int with_input_pool,
+                            int poll_timeout_ms);
+
+/*
+ * 提交一帧（拷贝进空闲的输入池 buffer 后投递）。返回后 frame_data 即可复用。
+ * @return 0 成功；1 timeout_ms 内没有空闲在途槽；-1 失败
+ */
+int encoder_mpp_submit(EncoderMPP *enc, const uint8_t *frame_data, size_t frame_size,
+                       int64_t pts, int timeout_ms);
+
+/*
+ * 提交一帧已导入的外部 buffer（零拷贝）。该 buffer 在对应 packet 取出前不可归还。
+ * @return 0 成功；1 timeout_ms 内没有空闲在途槽；-1 失败
+ */
+int encoder_mpp_submit_ext(EncoderMPP *enc, int index, int64_t pts, int timeout_ms);
+
+/*
+ * 提交一帧按平面描述的 NV12（例如直接指向 V4L2 buffer）：
+ * 按 src 行跨度读取、按编码器 hor_stride/ver_stride 写入空闲输入池 buffer，一次完成；
+ * 源尺寸大于编码尺寸时居中裁剪。返回后源 buffer 即可归还。
+ * @return 0 成功；1 timeout_ms 内没有空闲在途槽；-1 失败（含源尺寸小于编码尺寸）
+ */
+int encoder_mpp_submit_nv12(EncoderMPP *enc, const Nv12Planes *src,
+                            unsigned int src_width, unsigned int src_height,
+                            int64_t pts, int timeout_ms);
+
+/*
+ * 占用一个空闲在途槽并交出它的输入池 buffer，由调用者直接写入像素
+ * （RGA 缩放、外部转换等），之后必须调用 encoder_mpp_submit_input 或 encoder_mpp_cancel_input。
+ * 需 with_input_pool=1。
+ * @return 0 成功；1 timeout_ms 内没有空闲在途槽；-1 失败
+ */
+int  encoder_mpp_acquire_input(EncoderMPP *enc, int timeout_ms, EncInputBuf *in);
+/* 投递 acquire_input 得到的 buffer。@return 0 成功；-1 失败（在途槽已归还） */
+int  encoder_mpp_submit_input(EncoderMPP *enc, const EncInputBuf *in, int64_t pts);
+/* 放弃 acquire_input 得到的 buffer（不投递）。 */
+void encoder_mpp_cancel_input(EncoderMPP *enc, const EncInputBuf *in);
+
+/*
+ * 取一个编码输出 packet（最多阻塞 poll_timeout_ms），并回收对应的在途槽。
+ * 分片输出时每次取到一片（pkt->part），只有最后一片回收在途槽并带回 ext_index，
+ * 即 AU 的前几片已经可以写出，而输入 buffer 要等整帧编完才能归还。
+ * @return 0 取到 packet；1 暂时没有；-1 失败
+ */
+int encoder_mpp_poll_packet(EncoderMPP *enc, EncPacket *pkt);
+
+/* 当前在途帧数 */
+int encoder_mpp_inflight(EncoderMPP *enc);
+
+/*
+ * 运行时调整（可在任意线程调用，不重建编码器）：
+ * 请求先记下，由提交线程在下一帧 put_frame 之前经 MPP_ENC_SET_CFG / MPP_ENC_SET_IDR_FRAME 生效，
+ * 因此总是落在帧边界上，也不会与正在进行的提交交错。连续多次请求只保留最后一次。
+ * @return 0 已受理；-1 参数非法或编码器未初始化
+ */
+int encoder_mpp_set_bitrate(EncoderMPP *enc, int bitrate_bps);
+int encoder_mpp_set_fps(EncoderMPP *enc, int fps);
+int encoder_mpp_request_idr(EncoderMPP *enc);
+
 void encoder_mpp_deinit(EncoderMPP *enc);
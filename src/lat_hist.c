@@ -0,0 +1,82 @@
+// lat_hist.c
+#include "lat_hist.h"
+
+#include <string.h>
+
+/* 桶 i 覆盖的区间 [low, low + width) */
+static uint64_t bucket_low(uint32_t i, uint64_t *width)
+{
+    if (i < LAT_HIST_SUB) {
+        *width = 1;
+        return i;
+    }
+    uint32_t shift = i / LAT_HIST_SUB - 1;
+    *width = 1ull << shift;
+    return (uint64_t)(LAT_HIST_SUB + i % LAT_HIST_SUB) << shift;
+}
+
+void lat_hist_init(LatHist *h)
+{
+    if (!h) return;
+    for (uint32_t i = 0; i < LAT_HIST_BUCKETS; i++) atomic_store(&h->b[i], 0);
+    atomic_store(&h->sum, 0);
+    atomic_store(&h->min, UINT64_MAX);
+    atomic_store(&h->max, 0);
+}
+
+/*
+ * 逐桶交换清零。与记录端并发时，某个样本可能计入桶但 sum/min/max 落到下一个窗口，
+ * 对秒级统计无影响。
+ */
+void lat_hist_drain(LatHist *h, LatHistSnap *out)
+{
+    if (!h || !out) return;
+    out->count = 0;
+    for (uint32_t i = 0; i < LAT_HIST_BUCKETS; i++) {
+        uint64_t n = atomic_exchange_explicit(&h->b[i], 0, memory_order_relaxed);
+        out->b[i] = n;
+        out->count += n;
+    }
+    out->sum = atomic_exchange_explicit(&h->sum, 0, memory_order_relaxed);
+    out->min = atomic_exchange_explicit(&h->min, UINT64_MAX, memory_order_relaxed);
+    out->max = atomic_exchange_explicit(&h->max, 0, memory_order_relaxed);
+    if (!out->count) out->min = 0;
+}
+
+void lat_hist_snap_reset(LatHistSnap *s)
+{
+    if (!s) return;
+    memset(s, 0, sizeof(*s));
+}
+
+void lat_hist_snap_merge(LatHistSnap *dst, const LatHistSnap *src)
+{
+    if (!dst || !src || !src->count) return;
+    for (uint32_t i = 0; i < LAT_HIST_BUCKETS; i++) dst->b[i] += src->b[i];
+    if (!dst->count || src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+    dst->count += src->count;
+    dst->sum   += src->sum;
+}
+
+uint64_t lat_hist_percentile(const LatHistSnap *s, double q)
+{
+    if (!s || !s->count) return 0;
+    if (q <= 0.0) return s->min;
+    if (q >= 1.0) return s->max;
+
+    uint64_t rank = (uint64_t)(q * (double)s->count + 0.5);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < LAT_HIST_BUCKETS; i++) {
+        seen += s->b[i];
+        if (seen >= rank) {
+            uint64_t width;
+            uint64_t v = bucket_low(i, &width) + width / 2;
+            if (v < s->min) v = s->min;
+            if (v > s->max) v = s->max;
+            return v;
+        }
+    }
+    return s->max;
+}
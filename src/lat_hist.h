@@ -0,0 +1,86 @@
+// lat_hist.h
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * HDR 风格的对数-线性直方图（无锁）：
+ *
+ * - 每个 2 的幂区间再均分 16 个子桶，相对误差 ≤ 1/16（约 6%），0..15 精确；
+ * - 取值上限 2^32（按微秒约 71 分钟），超出计入最后一个桶；
+ * - 记录端只有 relaxed fetch_add + CAS 更新 min/max，约定每个直方图由一个线程写入
+ *   （多个写入者同样正确，只是多一些 cache line 争用）；
+ * - 统计线程用 lat_hist_drain 交换清零，得到一个时间窗口的快照，再自行累加出累计分布。
+ */
+
+#define LAT_HIST_SUB_BITS 4
+#define LAT_HIST_SUB      (1u << LAT_HIST_SUB_BITS)
+#define LAT_HIST_MAX_BITS 32
+#define LAT_HIST_BUCKETS  ((LAT_HIST_MAX_BITS - LAT_HIST_SUB_BITS + 1) * LAT_HIST_SUB)
+
+typedef struct {
+    atomic_uint_fast32_t b[LAT_HIST_BUCKETS];
+    atomic_uint_fast64_t sum;
+    atomic_uint_fast64_t min;
+    atomic_uint_fast64_t max;
+} LatHist;
+
+/* 非原子快照（仅统计线程使用） */
+typedef struct {
+    uint64_t b[LAT_HIST_BUCKETS];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+} LatHistSnap;
+
+static inline uint32_t lat_hist_bucket(uint64_t v)
+{
+    if (v < LAT_HIST_SUB) return (uint32_t)v;
+    uint32_t msb = 63u - (uint32_t)__builtin_clzll(v);
+    if (msb >= LAT_HIST_MAX_BITS) return LAT_HIST_BUCKETS - 1;
+    uint32_t shift = msb - LAT_HIST_SUB_BITS;
+    return (shift + 1) * LAT_HIST_SUB + (uint32_t)((v >> shift) & (LAT_HIST_SUB - 1));
+}
+
+/* 记录一个值（热路径：一次 fetch_add 桶 + 一次 sum，min/max 只在变化时 CAS）。 */
+static inline void lat_hist_record(LatHist *h, uint64_t v)
+{
+    atomic_fetch_add_explicit(&h->b[lat_hist_bucket(v)], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum, v, memory_order_relaxed);
+
+    uint_fast64_t cur = atomic_load_explicit(&h->max, memory_order_relaxed);
+    while (v > cur && !atomic_compare_exchange_weak_explicit(&h->max, &cur, v,
+                                                             memory_order_relaxed, memory_order_relaxed)) {
+    }
+    cur = atomic_load_explicit(&h->min, memory_order_relaxed);
+    while (v < cur && !atomic_compare_exchange_weak_explicit(&h->min, &cur, v,
+                                                             memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+void     lat_hist_init(LatHist *h);
+
+/* 取出当前窗口并清零。 */
+void     lat_hist_drain(LatHist *h, LatHistSnap *out);
+
+/* 清空快照。 */
+void     lat_hist_snap_reset(LatHistSnap *s);
+
+/* dst += src（用于累计分布）。 */
+void     lat_hist_snap_merge(LatHistSnap *dst, const LatHistSnap *src);
+
+/*
+ * 分位数（q 取 0..1，例如 0.99），返回所在桶的中点并夹到 [min, max]。
+ * @return  无样本时返回 0
+ */
+uint64_t lat_hist_percentile(const LatHistSnap *s, double q);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,19 +1,274 @@
 // src/log.c
 #include "log.h"
+
+#include <poll.h>
+#include <pthread.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define LOG_DRAIN_NICE   10      // 输出线程的 nice 值（低于采集 / 编码线程）
+#define LOG_OUT_BUF      8192    // 输出线程一次 fwrite 的批量
+
+/*
+ * 有界 MPSC 环（Vyukov）：每个槽位带序号，生产者 CAS 抢占 tail 后填槽，
+ * 用 release 写序号发布；唯一的消费者按 head 顺序取，用序号判断是否已发布。
+ */
+typedef struct {
+    atomic_size_t   seq;
+    struct timespec ts;
+    int             level;
+    unsigned int    suppressed;
+    char            msg[LOG_MSG_MAX];
+} LogRecord;
+
+static struct {
+    LogRecord      slots[LOG_RING_SLOTS];
+    _Alignas(64) atomic_size_t tail;   // 生产者
+    _Alignas(64) size_t        head;   // 消费者（仅输出线程）
+    atomic_uint    dropped;            // 环满丢弃的条数
+    atomic_int     sleeping;           // 输出线程准备 poll
+    atomic_int     active;             // 1 = 走环；0 = 同步输出
+    atomic_int     stop;
+    int            efd;
+    pthread_t      th;
+    int            started;
+} g_log = { .efd = -1 };
+
+static const char *level_tag(int level)
+{
+    if (level == LOG_LEVEL_WARN)  return "W";
+    if (level == LOG_LEVEL_ERROR) return "E";
+    return "I";
+}
+
+const char *log_timestamp(char *buf, size_t cap, const struct timespec *ts)
+{
+    struct tm tm_now;
+    localtime_r(&ts->tv_sec, &tm_now);
+    snprintf(buf, cap, "%02d:%02d:%02d.%03d",
+             tm_now.tm_hour, tm_now.tm_min, tm_now.tm_sec, (int)(ts->tv_nsec / 1000000));
+    return buf;
+}
+
+/* 一条记录格式化为一行，@return 行长度（不含结尾 NUL） */
+static size_t format_line(char *out, size_t cap, int level, const struct timespec *ts,
+                          const char *msg, unsigned int suppressed)
+{
+    char tbuf[32];
+    int n;
+    if (suppressed)
+        n = snprintf(out, cap, "[%s %s] %s (+%u suppressed)\n", level_tag(level),
+                     log_timestamp(tbuf, sizeof(tbuf), ts), msg, suppressed);
+    else
+        n = snprintf(out, cap, "[%s %s] %s\n", level_tag(level), log_timestamp(tbuf, sizeof(tbuf), ts), msg);
+    if (n < 0) return 0;
+    if ((size_t)n >= cap) {
+        out[cap - 2] = '\n';
+        return cap - 1;
+    }
+    return (size_t)n;
+}
+
+/*
+ * 调用点限流。@return 1 输出（*suppressed 为上一窗口之后被抑制的条数）；0 抑制
+ */
+static int rate_allow(LogSite *site, unsigned int *suppressed)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    long long sec = (long long)now.tv_sec;
+
+    *suppressed = 0;
+    long long w = atomic_load_explicit(&site->window, memory_order_relaxed);
+    if (w != sec && atomic_compare_exchange_strong(&site->window, &w, sec)) {
+        atomic_store_explicit(&site->count, 0, memory_order_relaxed);
+        *suppressed = atomic_exchange(&site->suppressed, 0);
+    }
+    if (atomic_fetch_add_explicit(&site->count, 1, memory_order_relaxed) >= LOG_RATE_BURST) {
+        atomic_fetch_add_explicit(&site->suppressed, 1, memory_order_relaxed);
+        return 0;
+    }
+    return 1;
+}
+
+/* 生产者：抢一个空槽。@return 槽位；环满返回 NULL */
+static LogRecord *ring_claim(size_t *pos_out)
+{
+    size_t pos = atomic_load_explicit(&g_log.tail, memory_order_relaxed);
+    for (;;) {
+        LogRecord *r = &g_log.slots[pos & (LOG_RING_SLOTS - 1)];
+        size_t seq = atomic_load_explicit(&r->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&g_log.tail, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                *pos_out = pos;
+                return r;
+            }
+        } else if (diff < 0) {
+            return NULL;
+        } else {
+            pos = atomic_load_explicit(&g_log.tail, memory_order_relaxed);
+        }
+    }
+}
+
+static void ring_publish(LogRecord *r, size_t pos)
+{
+    /* seq_cst 发布：与输出线程的 sleeping=1 / 重查构成 store-load 顺序，不会丢唤醒 */
+    atomic_store(&r->seq, pos + 1);
+    /* 输出线程已宣布要睡眠时才写 eventfd，忙时不产生系统调用 */
+    if (atomic_load(&g_log.sleeping) &&
+        atomic_exchange(&g_log.sleeping, 0)) {
+        uint64_t one = 1;
+        ssize_t n = write(g_log.efd, &one, sizeof(one));
+        (void)n;
+    }
+}
 
-void log_print(int level, const char *fmt, ...)
+void log_print(LogSite *site, int level, const char *fmt, ...)
 {
-    const char *lv = "I";
-    if (level == LOG_LEVEL_WARN)  lv = "W";
-    if (level == LOG_LEVEL_ERROR) lv = "E";
+    unsigned int suppressed = 0;
+    if (site && !rate_allow(site, &suppressed)) return;
 
-    fprintf(stderr, "[%s %s] ", lv, log_timestamp());
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
 
     va_list args;
+    if (atomic_load_explicit(&g_log.active, memory_order_acquire)) {
+        size_t pos;
+        LogRecord *r = ring_claim(&pos);
+        if (!r) {
+            atomic_fetch_add_explicit(&g_log.dropped, 1, memory_order_relaxed);
+            return;
+        }
+        r->ts         = ts;
+        r->level      = level;
+        r->suppressed = suppressed;
+        va_start(args, fmt);
+        vsnprintf(r->msg, sizeof(r->msg), fmt, args);
+        va_end(args);
+        ring_publish(r, pos);
+        return;
+    }
+
+    /* 同步输出：先拼成一行再一次写出 */
+    char msg[LOG_MSG_MAX];
+    char line[LOG_MSG_MAX + 64];
     va_start(args, fmt);
-    vfprintf(stderr, fmt, args);
+    vsnprintf(msg, sizeof(msg), fmt, args);
     va_end(args);
+    size_t n = format_line(line, sizeof(line), level, &ts, msg, suppressed);
+    fwrite(line, 1, n, stderr);
+}
+
+/* 输出线程：取出已发布的记录，批量写 stderr。@return 取到的条数 */
+static int drain_once(void)
+{
+    char out[LOG_OUT_BUF];
+    size_t len = 0;
+    int taken = 0;
 
-    fprintf(stderr, "\n");
+    for (;;) {
+        LogRecord *r = &g_log.slots[g_log.head & (LOG_RING_SLOTS - 1)];
+        size_t seq = atomic_load(&r->seq);
+        if (seq != g_log.head + 1) break;
+
+        if (len + LOG_MSG_MAX + 64 > sizeof(out)) {
+            fwrite(out, 1, len, stderr);
+            len = 0;
+        }
+        len += format_line(out + len, sizeof(out) - len, r->level, &r->ts, r->msg, r->suppressed);
+        atomic_store_explicit(&r->seq, g_log.head + LOG_RING_SLOTS, memory_order_release);
+        g_log.head++;
+        taken++;
+    }
+
+    unsigned int dropped = atomic_exchange(&g_log.dropped, 0);
+    if (dropped) {
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+        char msg[64];
+        snprintf(msg, sizeof(msg), "[log] ring full, %u messages dropped", dropped);
+        if (len + 128 > sizeof(out)) {
+            fwrite(out, 1, len, stderr);
+            len = 0;
+        }
+        len += format_line(out + len, sizeof(out) - len, LOG_LEVEL_WARN, &ts, msg, 0);
+    }
+    if (len) fwrite(out, 1, len, stderr);
+    return taken;
+}
+
+static void *drain_thread(void *arg)
+{
+    (void)arg;
+    pthread_setname_np(pthread_self(), "log");
+    setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), LOG_DRAIN_NICE);
+
+    while (!atomic_load(&g_log.stop)) {
+        if (drain_once() > 0) continue;
+
+        /* 宣布睡眠后再查一次，避免与生产者的发布交错丢唤醒 */
+        atomic_store(&g_log.sleeping, 1);
+        if (drain_once() > 0) {
+            atomic_store(&g_log.sleeping, 0);
+            continue;
+        }
+        struct pollfd pfd = { .fd = g_log.efd, .events = POLLIN };
+        poll(&pfd, 1, 200);
+        atomic_store(&g_log.sleeping, 0);
+        uint64_t v;
+        ssize_t n = read(g_log.efd, &v, sizeof(v));
+        (void)n;
+    }
+    drain_once();
+    return NULL;
+}
+
+int log_init(void)
+{
+    if (g_log.started) return 0;
+    for (size_t i = 0; i < LOG_RING_SLOTS; i++) atomic_store_explicit(&g_log.slots[i].seq, i, memory_order_relaxed);
+    atomic_store(&g_log.tail, 0);
+    g_log.head = 0;
+    atomic_store(&g_log.stop, 0);
+
+    g_log.efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (g_log.efd < 0) return -1;
+    if (pthread_create(&g_log.th, NULL, drain_thread, NULL) != 0) {
+        close(g_log.efd);
+        g_log.efd = -1;
+        return -1;
+    }
+    g_log.started = 1;
+    atomic_store_explicit(&g_log.active, 1, memory_order_release);
+
+    static int at_exit_registered = 0;
+    if (!at_exit_registered) {
+        atexit(log_shutdown);
+        at_exit_registered = 1;
+    }
+    return 0;
+}
+
+void log_shutdown(void)
+{
+    if (!g_log.started) return;
+    atomic_store_explicit(&g_log.active, 0, memory_order_release);
+    atomic_store(&g_log.stop, 1);
+    uint64_t one = 1;
+    ssize_t n = write(g_log.efd, &one, sizeof(one));
+    (void)n;
+    pthread_join(g_log.th, NULL);
+    drain_once();   // 切换到同步输出之前已抢到槽位的记录
+    close(g_log.efd);
+    g_log.efd     = -1;
+    g_log.started = 0;
 }
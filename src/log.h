@@ -1,24 +1,25 @@
 // src/log.h
 #pragma once
 
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <time.h>
 
-/* 打印当前时间，格式：HH:MM:SS.mmm */
-static inline const char *log_timestamp(void)
-{
-    static char buf[32];
-    struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
+/*
+ * 日志：调用线程在 log_print 里取时间戳（clock_gettime）并 vsnprintf，记录放进无锁多生产者环；
+ * 低优先级的输出线程只负责把记录里的时间戳格式化成行首并写 stderr，
+ * 写日志不会因为终端 / 串口慢而卡住采集或编码，时间戳也不受输出线程排队延迟影响。
+ *
+ * - log_init 之前、log_shutdown 之后同步写 stderr（单次 fwrite，不与其他线程交错）；
+ * - 环满时丢弃并计数，输出线程随后打印一行丢弃数，从不阻塞调用者；
+ * - 每个调用点（LOGI/LOGW/LOGE 所在的那一行）每秒最多输出 LOG_RATE_BURST 条，
+ *   超出的被抑制，下一秒第一条带上被抑制的条数（磁盘满之类的错误风暴不会刷屏）。
+ */
 
-    struct tm tm_now;
-    localtime_r(&ts.tv_sec, &tm_now);
-
-    snprintf(buf, sizeof(buf), "%02d:%02d:%02d.%03d",
-             tm_now.tm_hour, tm_now.tm_min, tm_now.tm_sec,
-             (int)(ts.tv_nsec / 1000000));
-    return buf;
-}
+#define LOG_MSG_MAX     512    // 单条消息上限（超出截断）
+#define LOG_RING_SLOTS  256    // 环槽位数（2 的幂）
+#define LOG_RATE_BURST  20     // 每个调用点每秒最多条数
 
 /* 日志级别 */
 enum {
@@ -27,10 +28,36 @@ enum {
     LOG_LEVEL_ERROR = 3,
 };
 
-/* 实际的打印函数，在 log.c 里实现 */
-void log_print(int level, const char *fmt, ...);
+/* 调用点的限流状态（宏里的 static 变量，零初始化即可用） */
+typedef struct {
+    atomic_llong window;       // 当前计数窗口（CLOCK_MONOTONIC 秒）
+    atomic_uint  count;        // 窗口内已输出条数
+    atomic_uint  suppressed;   // 被抑制、尚未报告的条数
+} LogSite;
+
+/*
+ * 格式化时间，格式：HH:MM:SS.mmm。
+ *
+ * @param buf  输出缓冲（至少 16 字节）
+ * @param ts   CLOCK_REALTIME 时刻
+ * @return     buf
+ */
+const char *log_timestamp(char *buf, size_t cap, const struct timespec *ts);
+
+/* 启动输出线程（程序开始时调用一次；同时用 atexit 注册 log_shutdown）。@return 0 成功；-1 失败（保持同步输出） */
+int  log_init(void);
+/* 输出环里剩余的记录并停止输出线程，之后回到同步输出。可重复调用。 */
+void log_shutdown(void);
+
+/* 实际的打印函数，在 log.c 里实现；site 为 NULL 时不限流 */
+void log_print(LogSite *site, int level, const char *fmt, ...) __attribute__((format(printf, 3, 4)));
+
+#define LOG_AT(level, fmt, ...) do {                          \
+        static LogSite log_site_;                             \
+        log_print(&log_site_, level, fmt, ##__VA_ARGS__);     \
+    } while (0)
 
 /* 对外用的简化宏 */
-#define LOGI(fmt, ...) log_print(LOG_LEVEL_INFO,  fmt, ##__VA_ARGS__)
-#define LOGW(fmt, ...) log_print(LOG_LEVEL_WARN,  fmt, ##__VA_ARGS__)
-#define LOGE(fmt, ...) log_print(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#define LOGI(fmt, ...) LOG_AT(LOG_LEVEL_INFO,  fmt, ##__VA_ARGS__)
+#define LOGW(fmt, ...) LOG_AT(LOG_LEVEL_WARN,  fmt, ##__VA_ARGS__)
+#define LOGE(fmt, ...) LOG_AT(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
@@ -1,3 +1,4 @@
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -5,251 +6,179 @@
 #include <signal.h>
 #include <pthread.h>
 #include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 #include "log.h"
 #include "app_config.h"
 #include "av_stats.h"
-#include "v4l2_capture.h"
-#include "encoder_mpp.h"
-#include "sink.h"
-#include "audio_capture.h"
+#include "channel.h"
+#include "reactor.h"
+#include "media_clock.h"
+#include "mem_arena.h"
+#include "metrics_http.h"
+#include "rt_sched.h"
+#include "trace.h"
+#include "vpu_sched.h"
 
 static volatile sig_atomic_t g_stop = 0;
-static AvStats g_stats;
+static Reactor g_reactor = { .stop_fd = -1 };   // 统计 / 事件控制线程
+static MetricsHttp g_metrics;                   // --metrics：统计线程发布，服务线程只读快照
+
+/* 全部通道（单通道时只有一路）；初始化完成后才发布数量，信号处理函数据此遍历 */
+static Channel g_channels[APP_MAX_CHANNELS];
+static volatile sig_atomic_t g_nchannels = 0;
+
+/*
+ * 置位全局停止标志、通知每一路通道，并通过 eventfd 唤醒所有等待中的线程。
+ * 只有 sig_atomic_t 写入与 write()，可在信号处理函数中调用。
+ */
+static void request_stop(void)
+{
+    g_stop = 1;
+    for (int i = 0; i < g_nchannels; i++) channel_request_stop(&g_channels[i]);
+    reactor_signal_stop(&g_reactor);
+}
 
 /*
  * 信号处理函数：收到 SIGINT/SIGTERM 时设置全局停止标志。
  *
  * 约束：信号处理上下文里应尽量只做“最小且异步安全”的操作。
- * 这里仅写一个 sig_atomic_t 标志位，供各线程轮询并退出。
+ * 这里只写 sig_atomic_t 标志位并写 eventfd，poll 中的线程立即返回并退出。
  */
 static void on_sigint(int signo)
 {
     (void)signo;
-    g_stop = 1;
+    request_stop();
 }
 
-/* ===================== Timer Thread ===================== */
-typedef struct {
-    unsigned int sec;
-} TimerArgs;
-
+/* ===================== Event Trigger ===================== */
 /*
- * 计时器线程：睡眠指定秒数后将 g_stop 置 1，触发全局停止。
- *
- * @param arg  TimerArgs*，包含录制时长（秒）
+ * --sink event 的触发入口：SIGUSR1（触发全部通道），或 --event-sock 上收到 "trigger [通道名]"。
+ * 各通道的 sink 在打开成功后发布、关闭之前撤回；enc_sink_trigger 只写一个原子变量，信号处理函数可以直接调用。
+ * --standby 时 SIGUSR1 / "record start" 开始录制，SIGUSR2 / "record stop" 停止（只写请求与 eventfd）。
  */
-static void *timer_thread(void *arg)
+static void on_sigusr1(int signo)
 {
-    TimerArgs *t = (TimerArgs *)arg;
-    if (!t || t->sec == 0) return NULL;
-    sleep(t->sec);
-    g_stop = 1;
-    return NULL;
+    (void)signo;
+    for (int i = 0; i < g_nchannels; i++) channel_trigger(&g_channels[i]);
+}
+
+static void on_sigusr2(int signo)
+{
+    (void)signo;
+    for (int i = 0; i < g_nchannels; i++) channel_record(&g_channels[i], 0);
 }
 
-/* ===================== Stats Thread ===================== */
 /*
- * 统计线程：每秒打印一次统计信息，直到 g_stop 被置位。
+ * 执行一条控制命令："trigger" / "record start" / "record stop"，后面可跟通道名只作用于一路。
+ * @return 生效的通道数
  */
-static void *stats_thread(void *arg)
+static int ctl_command(const char *cmd)
 {
-    (void)arg;
-    while (!g_stop) {
-        sleep(1);
-        av_stats_tick_print(&g_stats);
+    static const struct { const char *verb; int op; } verbs[] = {
+        { "trigger", 0 }, { "record start", 1 }, { "record stop", 2 },
+    };
+    for (size_t v = 0; v < sizeof(verbs) / sizeof(verbs[0]); v++) {
+        size_t len = strlen(verbs[v].verb);
+        if (strncmp(cmd, verbs[v].verb, len) != 0 || (cmd[len] != '\0' && cmd[len] != ' ')) continue;
+        const char *only = cmd[len] ? cmd + len + 1 : NULL;
+        int hits = 0;
+        for (int i = 0; i < g_nchannels; i++) {
+            Channel *ch = &g_channels[i];
+            if (only && strcmp(only, ch->name) != 0) continue;
+            int r = verbs[v].op == 0 ? channel_trigger(ch) : channel_record(ch, verbs[v].op == 1);
+            if (r == 0) hits++;
+        }
+        return hits;
     }
-    return NULL;
+    return 0;
 }
 
-/* ===================== Audio Thread ===================== */
-typedef struct {
-    const AppConfig *cfg;
-} AudioArgs;
-
 /*
- * 音频线程：
- * - 打开 ALSA 音频采集
- * - 按 chunk 读取 PCM 并写入文件
- * - 达到时长限制或收到停止信号后退出
+ * 事件控制线程：在 UNIX datagram socket 上等命令（见 ctl_command，例如 "trigger" 触发全部通道，
+ * "record start cam0" 只让一路开始录制），stop 通知后退出并删除 socket 文件。
+ * 例如：echo trigger | socat - UNIX-SENDTO:/tmp/rkav.sock
  *
- * @param arg  AudioArgs*，包含 AppConfig 指针
+ * @param arg  socket 路径
  */
-static void *audio_thread(void *arg)
+static void *event_ctl_thread(void *arg)
 {
-    AudioArgs *a = (AudioArgs *)arg;
-    const AppConfig *cfg = a ? a->cfg : NULL;
-    if (!cfg) return NULL;
-
-    AudioCapture ac;
-    if (audio_capture_open(&ac, cfg->audio_device, cfg->sample_rate, cfg->channels) != 0) {
-        LOGE("[audio] audio_capture_open failed");
-        av_stats_add_drop(&g_stats, 1);
+    const char *path = (const char *)arg;
+    rt_sched_apply(RT_ROLE_STATS, "event-ctl");
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        LOGE("[event] socket path too long: %s", path);
         return NULL;
     }
+    strcpy(addr.sun_path, path);
 
-    FILE *af = fopen(cfg->output_path_pcm, "wb");
-    if (!af) {
-        LOGE("[audio] fopen %s failed", cfg->output_path_pcm);
-        audio_capture_close(&ac);
-        av_stats_add_drop(&g_stats, 1);
+    int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        LOGE("[event] socket failed: %s", strerror(errno));
         return NULL;
     }
-
-    LOGI("[audio] start capture -> %s", cfg->output_path_pcm);
-
-    /*
-     * 计算目标写入字节数：duration_sec>0 则按秒数限制；否则认为无限（直到外部 stop）。
-     * bytes_per_frame 表示“每个采样帧”的字节数（与位深/声道有关）。
-     */
-    size_t bytes_per_sec = (size_t)ac.sample_rate * (size_t)ac.bytes_per_frame;
-    size_t total_bytes   = (cfg->duration_sec > 0) ? (bytes_per_sec * (size_t)cfg->duration_sec) : (size_t)-1;
-
-    /* 单次读写的 chunk 大小（按 ALSA period 计算）。 */
-    size_t chunk = (size_t)ac.frames_per_period * (size_t)ac.bytes_per_frame;
-    uint8_t *buf = (uint8_t *)malloc(chunk);
-    if (!buf) {
-        LOGE("[audio] malloc failed");
-        fclose(af);
-        audio_capture_close(&ac);
-        av_stats_add_drop(&g_stats, 1);
+    unlink(path);   // 上次异常退出留下的 socket 文件
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        LOGE("[event] bind %s failed: %s", path, strerror(errno));
+        close(fd);
         return NULL;
     }
-
-    size_t written = 0;
-    while (!g_stop && written < total_bytes) {
-        ssize_t n = audio_capture_read(&ac, buf, chunk);
-        if (n <= 0) {
-            /* 读不到数据就小睡一下，避免忙等占满 CPU。 */
-            struct timespec ts = { .tv_sec = 0, .tv_nsec = 1000 * 1000 }; // 1ms
-            nanosleep(&ts, NULL);
-
-            continue;
-        }
-        size_t wn = fwrite(buf, 1, (size_t)n, af);
-        if (wn != (size_t)n) {
-            LOGE("[audio] fwrite failed");
-            av_stats_add_drop(&g_stats, 1);
-            break;
-        }
-        written += wn;
-        /* 音频 chunk 统计：用于每秒打印的速率与累计。 */
-        av_stats_inc_audio_chunk(&g_stats);
+    LOGI("[event] listening on %s", path);
+
+    while (reactor_wait_fd(&g_reactor, fd, POLLIN, -1) > 0) {
+        char cmd[64];
+        ssize_t n = recv(fd, cmd, sizeof(cmd) - 1, MSG_DONTWAIT);
+        if (n <= 0) continue;
+        while (n > 0 && (cmd[n - 1] == '\n' || cmd[n - 1] == '\r' || cmd[n - 1] == ' ')) n--;
+        cmd[n] = '\0';
+        int hits = ctl_command(cmd);
+        if (hits) LOGI("[event] %s via %s (%d channel%s)", cmd, path, hits, hits > 1 ? "s" : "");
+        else LOGW("[event] ignored command \"%s\"", cmd);
     }
 
-    free(buf);
-    fclose(af);
-    audio_capture_close(&ac);
-
-    LOGI("[audio] done, bytes=%zu", written);
+    close(fd);
+    unlink(path);
     return NULL;
 }
 
-/* ===================== Video Thread ===================== */
-typedef struct {
-    const AppConfig *cfg;
-} VideoArgs;
-
+/* ===================== Stats Thread ===================== */
 /*
- * 视频线程：
- * - 打开 V4L2 采集（当前使用 NV12M 多平面，内部合成为连续 NV12）
- * - 初始化 MPP H.264 编码器
- * - 采集帧 -> 编码 -> 写入 sink（文件）
- * - 达到时长/帧数限制或收到停止信号后退出
- *
- * @param arg  VideoArgs*，包含 AppConfig 指针
+ * 统计线程：每秒为每一路打印一次统计信息（并驱动各自的自适应码率），
+ * 开启 --metrics 时再把快照发布给 HTTP 服务线程；stop 通知后立即退出。
+ * 第一个统计窗口结束时各路已经打开完毕：打印内存报告并 seal，之后的分配计为运行期分配。
  */
-static void *video_thread(void *arg)
+static void *stats_thread(void *arg)
 {
-    VideoArgs *v = (VideoArgs *)arg;
-    const AppConfig *cfg = v ? v->cfg : NULL;
-    if (!cfg) return NULL;
-
-    V4L2Capture cap;
-    EncoderMPP  enc;
-    EncSink     sink;
-
-    int ret;
-
-    ret = v4l2_capture_open(&cap, cfg->video_device, (unsigned int)cfg->width, (unsigned int)cfg->height);
-    if (ret) {
-        LOGE("[video] v4l2_capture_open failed: %s", cfg->video_device);
-        av_stats_add_drop(&g_stats, 1);
-        return NULL;
-    }
-    v4l2_capture_start(&cap);
-
-    /* 初始化硬编码器：当前选择 AVC(H.264)。 */
-    ret = encoder_mpp_init(&enc, cfg->width, cfg->height, cfg->fps, cfg->bitrate, MPP_VIDEO_CodingAVC);
-    if (ret) {
-        LOGE("[video] encoder_mpp_init failed");
-        v4l2_capture_close(&cap);
-        av_stats_add_drop(&g_stats, 1);
-        return NULL;
-    }
-
-    /* 输出端：当前落盘为 .h264 文件。 */
-    enc_sink_init(&sink, ENC_SINK_FILE, cfg->output_path_h264);
-    if (enc_sink_open(&sink) != 0) {
-        LOGE("[video] enc_sink_open failed: %s", cfg->output_path_h264);
-        encoder_mpp_deinit(&enc);
-        v4l2_capture_close(&cap);
-        av_stats_add_drop(&g_stats, 1);
-        return NULL;
-    }
-
-    LOGI("[video] start encode -> %s (%dx%d@%d)", cfg->output_path_h264, cfg->width, cfg->height, cfg->fps);
-
-    uint32_t last_seq = 0;
-    int      has_seq = 0;
-    /* 若配置了 sec 与 fps，则将录制时长转换为目标帧数；0 表示不限制（直到 stop）。 */
-    int      frames_target = (cfg->duration_sec > 0 && cfg->fps > 0) ? (int)(cfg->duration_sec * (unsigned int)cfg->fps) : 0;
-    int      frames = 0;
-
-    while (!g_stop && (frames_target == 0 || frames < frames_target)) {
-        int index;
-        void *data;
-        size_t len;
-
-        ret = v4l2_capture_dqbuf(&cap, &index, &data, &len);
-        if (ret != 0) {
-            /* 非阻塞采集：可能暂时无帧（EAGAIN），小睡一下再试。 */
-            struct timespec ts = { .tv_sec = 0, .tv_nsec = 1000 * 1000 }; // 1ms
-            nanosleep(&ts, NULL);
-
-            continue;
-        }
-
-        /* drop 统计：根据 v4l2 sequence 检测丢帧（序号跳变）。 */
-        if (!has_seq) {
-            last_seq = cap.last_sequence;
-            has_seq = 1;
-        } else {
-            uint32_t cur = cap.last_sequence;
-            if (cur > last_seq + 1) {
-                av_stats_add_drop(&g_stats, (uint64_t)(cur - last_seq - 1));
-            }
-            last_seq = cur;
+    (void)arg;
+    rt_sched_apply(RT_ROLE_STATS, "stats");
+    int sealed = 0;
+    while (!g_stop) {
+        if (reactor_wait(&g_reactor, NULL, 0, 1000) != 0) break;
+        for (int i = 0; i < g_nchannels; i++) {
+            channel_stats_tick(&g_channels[i]);
+            metrics_http_publish(&g_metrics, i, &g_channels[i].stats);
         }
-
-        size_t out_bytes = 0;
-        ret = encoder_mpp_encode(&enc, (const uint8_t *)data, len, &sink, &out_bytes);
-        if (ret != 0) {
-            av_stats_add_drop(&g_stats, 1);
-        } else {
-            av_stats_inc_video_frame(&g_stats);
-            av_stats_add_enc_bytes(&g_stats, (uint64_t)out_bytes);
+        if (!sealed) {
+            mem_arena_seal();
+            mem_arena_report("startup done");
+            sealed = 1;
         }
-
-        v4l2_capture_qbuf(&cap, index);
-        frames++;
     }
+    return NULL;
+}
 
-    LOGI("[video] done, frames=%d", frames);
-
-    enc_sink_close(&sink);
-    encoder_mpp_deinit(&enc);
-    v4l2_capture_close(&cap);
+/* ===================== Channel Threads ===================== */
+/* --channels：每一路一个看护线程 */
+static void *channel_thread(void *arg)
+{
+    Channel *ch = (Channel *)arg;
+    char name[16];
+    snprintf(name, sizeof(name), "ch-%.12s", ch->name);
+    rt_sched_apply(RT_ROLE_STATS, name);
+    channel_run(ch);
     return NULL;
 }
 
@@ -257,14 +186,17 @@ static void *video_thread(void *arg)
 /*
  * 程序入口：
  * - 注册信号处理（Ctrl+C 停止）
- * - 加载默认配置并解析命令行
- * - 启动线程：统计/定时停止/视频/音频
+ * - 加载默认配置并解析命令行；--channels 时再按列表文件生成每一路的配置
+ * - 启动线程：统计 / 事件控制，以及每一路的视频流水线（采集/编码/写出）与音频
+ * - 单通道在主线程里运行；多通道每路一个看护线程，出错的一路单独重启
  * - 等待线程退出并收尾
  */
 int main(int argc, char **argv)
 {
     signal(SIGINT, on_sigint);
     signal(SIGTERM, on_sigint);
+    signal(SIGUSR1, on_sigusr1);
+    signal(SIGUSR2, on_sigusr2);
 
     AppConfig cfg;
     /* 先加载默认值，再用命令行参数覆盖。 */
@@ -273,59 +205,141 @@ int main(int argc, char **argv)
         app_config_print_usage(argv[0]);
         return -1;
     }
+    /* 通道列表也在日志线程启动前解析，错误与用法同步输出 */
+    static AppChannel list[APP_MAX_CHANNELS];
+    int nch = 1;
+    if (cfg.channels_file) {
+        nch = app_config_load_channels(cfg.channels_file, argc, argv, list, APP_MAX_CHANNELS);
+        if (nch < 0) return -1;
+    }
+    int multi = cfg.channels_file != NULL;
+    /*
+     * 调度 / mlock 在任何线程创建之前设置：mlockall(MCL_FUTURE) 与默认栈大小
+     * 对之后创建的所有线程（含日志输出线程）生效。
+     */
+    RtProfile rt;
+    app_config_rt_profile(&cfg, &rt);
+    rt_sched_setup(&rt);
+    /*
+     * 参数错误与用法同步输出（保持先后顺序）；之后日志走输出线程，
+     * 退出（含各个错误返回路径）时由 atexit 输出剩余记录。
+     */
+    log_init();
+    TRACE_INIT();
+
+    /* 流水线缓冲的内存区：在任何通道打开之前保留（参数已在 parse_args 中校验） */
+    MemArenaOpts mem;
+    app_config_mem_arena_opts(&cfg, &mem);
+    if (mem_arena_setup(&mem) != 0) {
+        LOGE("[main] mem_arena_setup failed");
+        return -1;
+    }
 
     // 最终配置摘要（你要求的那一行）
-    app_config_print_summary(&cfg);
-
-    av_stats_init(&g_stats);
-
-    pthread_t th_v, th_a, th_s, th_t;
-    TimerArgs targs = { .sec = cfg.duration_sec };
-
-    // stats thread
-    if (pthread_create(&th_s, NULL, stats_thread, NULL) != 0) {
-        LOGE("[main] pthread_create stats failed");
-        return -1;
+    if (!multi) app_config_print_summary(&cfg);
+    for (int i = 0; multi && i < nch; i++) {
+        LOGI("[CFG] channel %s:", list[i].name);
+        app_config_print_summary(&list[i].cfg);
     }
 
-    // timer thread（录制到点自动停）
-    if (cfg.duration_sec > 0) {
-        if (pthread_create(&th_t, NULL, timer_thread, &targs) != 0) {
-            LOGE("[main] pthread_create timer failed");
-            g_stop = 1;
-            pthread_join(th_s, NULL);
+    /* 多通道共用一个 VPU 在途帧配额 */
+    VpuSched vpu;
+    int vpu_slots = cfg.vpu_slots > 0 ? cfg.vpu_slots : nch + 1;
+    if (multi) {
+        if (vpu_sched_init(&vpu, vpu_slots) != 0) {
+            LOGE("[main] vpu_sched_init failed");
             return -1;
         }
+        LOGI("[main] %d channels, vpu_slots=%d", nch, vpu_slots);
     }
 
-    VideoArgs vargs = { .cfg = &cfg };
-    AudioArgs aargs = { .cfg = &cfg };
+    media_clock_init();
+    for (int i = 0; i < nch; i++) {
+        if (channel_init(&g_channels[i], multi ? list[i].name : NULL, multi ? &list[i].cfg : &cfg, multi,
+                         &g_stop, multi ? &vpu : NULL) != 0) {
+            LOGE("[main] channel_init %d failed", i);
+            return -1;
+        }
+    }
+    g_nchannels = nch;
 
-    if (pthread_create(&th_v, NULL, video_thread, &vargs) != 0) {
-        LOGE("[main] pthread_create video failed");
-        g_stop = 1;
-        pthread_join(th_s, NULL);
-        if (cfg.duration_sec > 0) pthread_join(th_t, NULL);
+    FILE *json_fp = NULL;
+    if (cfg.stats_json) {
+        json_fp = strcmp(cfg.stats_json, "-") == 0 ? stdout : fopen(cfg.stats_json, "w");
+        if (!json_fp) LOGW("[main] open %s failed: %s, JSON stats disabled", cfg.stats_json, strerror(errno));
+        for (int i = 0; i < nch; i++) av_stats_set_json(&g_channels[i].stats, json_fp);
+    }
+    /* 单通道时统计线程的唤醒也计入该路（与之前一致） */
+    if (reactor_init(&g_reactor, multi ? NULL : &g_channels[0].stats) != 0) {
+        LOGE("[main] reactor_init failed");
         return -1;
     }
-    if (pthread_create(&th_a, NULL, audio_thread, &aargs) != 0) {
-        LOGE("[main] pthread_create audio failed");
-        g_stop = 1;
-        pthread_join(th_v, NULL);
-        pthread_join(th_s, NULL);
-        if (cfg.duration_sec > 0) pthread_join(th_t, NULL);
+
+    MetricsHttpOpts mo;
+    if (app_config_metrics_opts(&cfg, &mo) == 0 && metrics_http_open(&g_metrics, &mo) != 0)
+        LOGW("[main] metrics endpoint disabled");
+
+    pthread_t th_s;
+    // stats thread
+    if (pthread_create(&th_s, NULL, stats_thread, NULL) != 0) {
+        LOGE("[main] pthread_create stats failed");
         return -1;
     }
 
-    pthread_join(th_a, NULL);
-    /* 音频线程结束后，确保停止标志置位，促使其他线程尽快退出。 */
-    g_stop = 1; // ensure stop
-    pthread_join(th_v, NULL);
+    int want_ctl = 0;
+    for (int i = 0; i < nch; i++)
+        want_ctl |= strcmp(g_channels[i].cfg.sink_type, "event") == 0 || g_channels[i].cfg.standby;
+    pthread_t th_e;
+    int ctl_started = want_ctl && cfg.event_sock &&
+                      pthread_create(&th_e, NULL, event_ctl_thread, (void *)cfg.event_sock) == 0;
+
+    int ret = 0;
+    if (!multi) {
+        ret = channel_run(&g_channels[0]);
+    } else {
+        pthread_t th_ch[APP_MAX_CHANNELS];
+        int started = 0;
+        for (; started < nch; started++) {
+            if (pthread_create(&th_ch[started], NULL, channel_thread, &g_channels[started]) != 0) {
+                LOGE("[main] pthread_create channel %s failed", g_channels[started].name);
+                request_stop();
+                ret = -1;
+                break;
+            }
+        }
+        rt_sched_report("startup done");
+        for (int i = 0; i < started; i++) pthread_join(th_ch[i], NULL);
+    }
+
+    /* 全部通道结束后置位停止标志，促使统计 / 事件控制线程退出。 */
+    request_stop(); // ensure stop
+    if (ctl_started) pthread_join(th_e, NULL);
 
     // stop stats
     pthread_join(th_s, NULL);
-    if (cfg.duration_sec > 0) pthread_join(th_t, NULL);
+    metrics_http_close(&g_metrics);
 
-    LOGI("[main] done. video=%s audio=%s", cfg.output_path_h264, cfg.output_path_pcm);
-    return 0;
+    /* 最后一个不满 1 秒的窗口也计入；速率按实际时长计算 */
+    for (int i = 0; i < nch; i++) {
+        av_stats_tick_print(&g_channels[i].stats);
+        av_stats_print_totals(&g_channels[i].stats);
+    }
+    rt_sched_report("exit");
+    mem_arena_report("exit");
+    if (json_fp && json_fp != stdout) fclose(json_fp);
+
+    reactor_close(&g_reactor);
+    for (int i = 0; i < nch; i++) {
+        const Channel *ch = &g_channels[i];
+        if (enc_sink_type_is_muxed(ch->mux.type))
+            LOGI("[main] done.%s%s out=%s", multi ? " " : "", ch->name, ch->mux.target);
+        else LOGI("[main] done.%s%s video=%s audio=%s", multi ? " " : "", ch->name, ch->cfg.output_path_h264,
+                  ch->cfg.output_path_pcm);
+    }
+    g_nchannels = 0;
+    for (int i = 0; i < nch; i++) channel_destroy(&g_channels[i]);
+    if (multi) vpu_sched_destroy(&vpu);
+    mem_arena_teardown();
+    TRACE_CLOSE();
+    return ret;
 }
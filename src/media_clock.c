@@ -0,0 +1,62 @@
+// src/media_clock.c
+#include "media_clock.h"
+
+#include <stdatomic.h>
+
+/* 时间原点只在启动时写一次，之后各线程只读 */
+static atomic_llong g_base_us;
+
+void media_clock_init(void)
+{
+    atomic_store(&g_base_us, (long long)media_clock_now_us());
+}
+
+int64_t media_clock_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return media_clock_timespec_us(&ts);
+}
+
+int64_t media_clock_pts(int64_t mono_us)
+{
+    return mono_us - (int64_t)atomic_load_explicit(&g_base_us, memory_order_relaxed);
+}
+
+void media_track_init(MediaTrack *t, uint32_t rate)
+{
+    if (!t) return;
+    t->started   = 0;
+    t->first_pts = 0;
+    t->last_pts  = 0;
+    t->units     = 0;
+    t->last_n    = 0;
+    t->rate      = rate ? rate : 1;
+}
+
+void media_track_update(MediaTrack *t, int64_t pts, uint32_t n,
+                        int64_t *err_us, int64_t *jitter_us)
+{
+    if (!t) return;
+
+    int64_t err = 0, jitter = 0;
+    if (!t->started) {
+        t->started   = 1;
+        t->first_pts = pts;
+    } else {
+        int64_t nominal = t->first_pts + (int64_t)(t->units * 1000000ull / t->rate);
+        err = pts - nominal;
+
+        /* 与上一段的名义时长比较 */
+        int64_t expect = (int64_t)((uint64_t)t->last_n * 1000000ull / t->rate);
+        int64_t delta  = pts - t->last_pts;
+        jitter = delta > expect ? delta - expect : expect - delta;
+    }
+
+    t->last_pts = pts;
+    t->last_n   = n;
+    t->units   += n;
+
+    if (err_us) *err_us = err;
+    if (jitter_us) *jitter_us = jitter;
+}
@@ -0,0 +1,67 @@
+// media_clock.h
+#pragma once
+
+#include <stdint.h>
+#include <sys/time.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 媒体时钟：进程内共享的单调时钟（CLOCK_MONOTONIC，微秒）。
+ *
+ * - V4L2 buffer 的 timestamp（驱动为 MONOTONIC 时）与 ALSA htimestamp（tstamp_type=MONOTONIC）
+ *   都落在同一时间轴上，换算为相对 media_clock_init() 时刻的 PTS 后可以直接比较；
+ * - PTS 经 mpp_frame_set_pts 带到 packet，再随写出传给 sink。
+ */
+
+/* 记录时间原点（main 中启动采集线程前调用一次）。 */
+void    media_clock_init(void);
+
+/* 当前单调时间（微秒，绝对值）。 */
+int64_t media_clock_now_us(void);
+
+/* 绝对单调时间 -> 媒体 PTS（微秒，相对时间原点）。 */
+int64_t media_clock_pts(int64_t mono_us);
+
+static inline int64_t media_clock_timeval_us(const struct timeval *tv)
+{
+    return (int64_t)tv->tv_sec * 1000000 + tv->tv_usec;
+}
+
+static inline int64_t media_clock_timespec_us(const struct timespec *ts)
+{
+    return (int64_t)ts->tv_sec * 1000000 + ts->tv_nsec / 1000;
+}
+
+/*
+ * 单路流的时间轴跟踪：一路按固定速率计数的流（视频帧 / 音频采样）。
+ *
+ * - err：PTS 相对“按计数推算的名义时间”的偏差。播放器按帧数/采样数定速播放，
+ *        两路 err 之差就是回放时的 A/V 漂移；
+ * - jitter：相邻两次 PTS 间隔与名义间隔之差的绝对值。
+ */
+typedef struct {
+    int      started;
+    int64_t  first_pts;
+    int64_t  last_pts;
+    uint64_t units;        // 已计入的帧数/采样数
+    uint32_t last_n;       // 上一段的 unit 数
+    uint32_t rate;         // 每秒 units 数（fps / sample_rate）
+} MediaTrack;
+
+void media_track_init(MediaTrack *t, uint32_t rate);
+
+/*
+ * 计入一段数据：pts 为其第一个 unit 的时间，n 为 unit 数。
+ * @param err_us     输出：本段 PTS 相对名义时间的偏差（可为 NULL）
+ * @param jitter_us  输出：本段抖动（首段为 0，可为 NULL）
+ */
+void media_track_update(MediaTrack *t, int64_t pts, uint32_t n,
+                        int64_t *err_us, int64_t *jitter_us);
+
+#ifdef __cplusplus
+}
+#endif
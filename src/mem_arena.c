@@ -0,0 +1,442 @@
+// mem_arena.c
+#include "mem_arena.h"
+
+#include "log.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#define TAG "mem"
+
+#define MEM_BLOCK_LIVE 0x6d656d31u   // "mem1"
+#define MEM_BLOCK_FREE 0x6d656d30u   // "mem0"
+
+/* 每个块数据区之前的头；all_next 把全部块（在用与空闲）串起来供报告遍历 */
+typedef struct MemBlock {
+    struct MemBlock *next;       // 空闲链表
+    struct MemBlock *all_next;
+    size_t           cap;        // 数据区字节
+    uint32_t         stage;
+    uint32_t         magic;
+} MemBlock;
+
+static const char *const k_stage_names[MEM_STAGE_COUNT] = {
+    [MEM_STAGE_CAPTURE] = "capture",
+    [MEM_STAGE_ENCODE]  = "encode",
+    [MEM_STAGE_AUDIO]   = "audio",
+    [MEM_STAGE_SINK]    = "sink",
+    [MEM_STAGE_OTHER]   = "other",
+};
+
+static const char *const k_pages_names[] = {
+    [MEM_PAGES_NORMAL]  = "off",
+    [MEM_PAGES_THP]     = "thp",
+    [MEM_PAGES_HUGETLB] = "hugetlb",
+};
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* 以下全部在 g_lock 下访问 */
+static struct {
+    int          ready;
+    MemArenaOpts o;
+    MemPages     pages;          // 实际生效的页类型
+    uint8_t     *base;
+    size_t       size;           // 保留的地址空间
+    size_t       committed;      // 已 mprotect 为可读写
+    size_t       used;           // 已划出（含空闲链表里的块）
+    MemBlock    *free_list;
+    MemBlock    *all;
+    uint64_t     host[MEM_STAGE_COUNT];   // 在用块的字节
+    uint32_t     blocks[MEM_STAGE_COUNT];
+    uint64_t     dev[MEM_STAGE_COUNT];    // mem_arena_charge 记账
+    uint64_t     dev_total;
+    uint64_t     peak;           // used + dev_total 的最大值
+    int          sealed;
+    uint32_t     late_allocs;
+    uint32_t     late_reused;
+    uint64_t     late_bytes;     // seal 之后新划出的字节
+} g_arena;
+
+static size_t round_up(size_t v, size_t a)
+{
+    return (v + a - 1) & ~(a - 1);
+}
+
+void mem_arena_default_opts(MemArenaOpts *o)
+{
+    if (!o) return;
+    memset(o, 0, sizeof(*o));
+    o->pages = MEM_PAGES_NORMAL;
+}
+
+const char *mem_stage_name(MemStage stage)
+{
+    if ((unsigned int)stage >= MEM_STAGE_COUNT) return "?";
+    return k_stage_names[stage];
+}
+
+int mem_pages_from_name(const char *name, MemPages *out)
+{
+    if (!name || !out) return -1;
+    for (size_t i = 0; i < sizeof(k_pages_names) / sizeof(k_pages_names[0]); i++) {
+        if (strcasecmp(name, k_pages_names[i]) == 0) {
+            *out = (MemPages)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *mem_pages_name(MemPages pages)
+{
+    if ((unsigned int)pages >= sizeof(k_pages_names) / sizeof(k_pages_names[0])) return "?";
+    return k_pages_names[pages];
+}
+
+/* /proc/meminfo 的 Hugepagesize（字节），取不到按 2MB */
+static size_t hugepage_size(void)
+{
+    size_t sz = 2u << 20;
+    FILE *fp = fopen("/proc/meminfo", "r");
+    if (!fp) return sz;
+    char line[128];
+    while (fgets(line, sizeof(line), fp)) {
+        unsigned long kb;
+        if (sscanf(line, "Hugepagesize: %lu kB", &kb) == 1 && kb) {
+            sz = (size_t)kb << 10;
+            break;
+        }
+    }
+    fclose(fp);
+    return sz;
+}
+
+/* 保留地址空间（调用者持锁） */
+static int arena_map(const MemArenaOpts *o)
+{
+    uint64_t want = o->budget ? o->budget : MEM_ARENA_RESERVE_DEFAULT;
+    if (want > (uint64_t)SIZE_MAX / 2) want = (uint64_t)SIZE_MAX / 2;
+    size_t size = round_up((size_t)want, MEM_ARENA_COMMIT);
+    MemPages pages = o->pages;
+
+    g_arena.o = *o;
+    if (pages == MEM_PAGES_HUGETLB) {
+        /* 一次性预留并提交：大页池不够时 mmap 直接失败，而不是运行中 SIGBUS */
+        size_t hsize = round_up(size, hugepage_size());
+        void *p = mmap(NULL, hsize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            g_arena.base      = (uint8_t *)p;
+            g_arena.size      = hsize;
+            g_arena.committed = hsize;
+        } else {
+            LOGW("[%s] MAP_HUGETLB %zuKB failed: %s (check /proc/sys/vm/nr_hugepages), using thp", TAG,
+                 hsize >> 10, strerror(errno));
+            pages = MEM_PAGES_THP;
+        }
+    }
+    if (!g_arena.base) {
+        /* 多保留一个提交粒度，把起点对齐到 2MB（THP 只在对齐的 2MB 区间上生效） */
+        size_t span = size + MEM_ARENA_COMMIT;
+        void *p = mmap(NULL, span, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED) {
+            LOGE("[%s] reserve %zuKB failed: %s", TAG, span >> 10, strerror(errno));
+            return -1;
+        }
+        uint8_t *raw  = (uint8_t *)p;
+        uint8_t *base = (uint8_t *)round_up((size_t)(uintptr_t)raw, MEM_ARENA_COMMIT);
+        if (base > raw) munmap(raw, (size_t)(base - raw));
+        if (base + size < raw + span) munmap(base + size, (size_t)(raw + span - (base + size)));
+        g_arena.base = base;
+        g_arena.size = size;
+#ifdef MADV_HUGEPAGE
+        if (pages == MEM_PAGES_THP && madvise(base, size, MADV_HUGEPAGE) != 0) {
+            LOGW("[%s] madvise(MADV_HUGEPAGE) failed: %s, using normal pages", TAG, strerror(errno));
+            pages = MEM_PAGES_NORMAL;
+        }
+#else
+        pages = MEM_PAGES_NORMAL;
+#endif
+    }
+    g_arena.pages = pages;
+    g_arena.ready = 1;
+    return 0;
+}
+
+/* 把 [committed, end) 提交为可读写（调用者持锁）。@return 0 成功；-1 失败 */
+static int arena_commit(size_t end)
+{
+    if (end <= g_arena.committed) return 0;
+    size_t to = round_up(end, MEM_ARENA_COMMIT);
+    if (to > g_arena.size) to = g_arena.size;
+    if (mprotect(g_arena.base + g_arena.committed, to - g_arena.committed, PROT_READ | PROT_WRITE) != 0) {
+        LOGE("[%s] commit %zuKB failed: %s", TAG, (to - g_arena.committed) >> 10, strerror(errno));
+        return -1;
+    }
+    g_arena.committed = to;
+    return 0;
+}
+
+/* "262144KB" / "none"（调用者持锁） */
+static const char *budget_str(char *buf, size_t cap)
+{
+    if (!g_arena.o.budget) return "none";
+    snprintf(buf, cap, "%lluKB", (unsigned long long)(g_arena.o.budget >> 10));
+    return buf;
+}
+
+static void arena_note_peak(void)
+{
+    uint64_t now = (uint64_t)g_arena.used + g_arena.dev_total;
+    if (now > g_arena.peak) g_arena.peak = now;
+}
+
+int mem_arena_setup(const MemArenaOpts *o)
+{
+    MemArenaOpts def;
+    if (!o) {
+        mem_arena_default_opts(&def);
+        o = &def;
+    }
+    pthread_mutex_lock(&g_lock);
+    int ret = 0;
+    if (g_arena.ready) {
+        LOGW("[%s] arena already set up, options ignored", TAG);
+    } else {
+        ret = arena_map(o);
+    }
+    if (ret == 0) {
+        char b[32];
+        LOGI("[%s] arena %zuKB reserved, pages=%s, budget=%s", TAG, g_arena.size >> 10,
+             mem_pages_name(g_arena.pages), budget_str(b, sizeof(b)));
+    }
+    pthread_mutex_unlock(&g_lock);
+    return ret;
+}
+
+void mem_arena_teardown(void)
+{
+    pthread_mutex_lock(&g_lock);
+    if (g_arena.ready) {
+        uint32_t live = 0;
+        for (int i = 0; i < MEM_STAGE_COUNT; i++) live += g_arena.blocks[i];
+        if (live) LOGW("[%s] teardown with %u blocks still in use", TAG, live);
+        munmap(g_arena.base, g_arena.size);
+    }
+    memset(&g_arena, 0, sizeof(g_arena));
+    pthread_mutex_unlock(&g_lock);
+}
+
+/* 各阶段一行（调用者持锁） */
+static void print_stages(void)
+{
+    for (int s = 0; s < MEM_STAGE_COUNT; s++) {
+        if (!g_arena.host[s] && !g_arena.dev[s]) continue;
+        LOGI("[%s]   %-8s host=%lluKB (%u blocks) device=%lluKB", TAG, k_stage_names[s],
+             (unsigned long long)(g_arena.host[s] >> 10), g_arena.blocks[s],
+             (unsigned long long)(g_arena.dev[s] >> 10));
+    }
+}
+
+void *mem_arena_alloc(MemStage stage, size_t size, size_t align)
+{
+    if ((unsigned int)stage >= MEM_STAGE_COUNT) stage = MEM_STAGE_OTHER;
+    if (!align) align = MEM_ARENA_ALIGN;
+    if (align & (align - 1)) return NULL;
+    size = round_up(size ? size : 1, MEM_ARENA_ALIGN);
+
+    pthread_mutex_lock(&g_lock);
+    if (!g_arena.ready) {
+        MemArenaOpts def;
+        mem_arena_default_opts(&def);
+        if (arena_map(&def) != 0) {
+            pthread_mutex_unlock(&g_lock);
+            return NULL;
+        }
+    }
+
+    /* 空闲链表里最小的够用且对齐的块 */
+    MemBlock **best = NULL;
+    for (MemBlock **pp = &g_arena.free_list; *pp; pp = &(*pp)->next) {
+        MemBlock *b = *pp;
+        if (b->cap < size || ((uintptr_t)(b + 1) & (align - 1))) continue;
+        if (!best || b->cap < (*best)->cap) best = pp;
+    }
+
+    MemBlock *b;
+    int reused = best != NULL;
+    if (reused) {
+        b = *best;
+        *best = b->next;
+    } else {
+        uintptr_t start = (uintptr_t)g_arena.base + g_arena.used;
+        uintptr_t data  = (uintptr_t)round_up((size_t)(start + sizeof(MemBlock)), align);
+        size_t    end   = (size_t)(data - (uintptr_t)g_arena.base) + size;
+        uint64_t  total = (uint64_t)end + g_arena.dev_total;
+        if (end > g_arena.size || (g_arena.o.budget && total > g_arena.o.budget)) {
+            char bs[32];
+            LOGE("[%s] %s: %zuKB does not fit (arena %zuKB of %zuKB, device %lluKB, budget %s)", TAG,
+                 k_stage_names[stage], size >> 10, g_arena.used >> 10, g_arena.size >> 10,
+                 (unsigned long long)(g_arena.dev_total >> 10), budget_str(bs, sizeof(bs)));
+            print_stages();
+            pthread_mutex_unlock(&g_lock);
+            return NULL;
+        }
+        if (arena_commit(end) != 0) {
+            pthread_mutex_unlock(&g_lock);
+            return NULL;
+        }
+        b = (MemBlock *)(data - sizeof(MemBlock));
+        b->cap      = size;
+        b->all_next = g_arena.all;
+        g_arena.all = b;
+        g_arena.used = end;
+        arena_note_peak();
+    }
+    b->next  = NULL;
+    b->stage = (uint32_t)stage;
+    b->magic = MEM_BLOCK_LIVE;
+    g_arena.host[stage] += b->cap;
+    g_arena.blocks[stage]++;
+    if (g_arena.sealed) {
+        g_arena.late_allocs++;
+        if (reused) g_arena.late_reused++;
+        else g_arena.late_bytes += b->cap;
+    }
+    pthread_mutex_unlock(&g_lock);
+
+    /* 清零同时让页面在这里缺页（--mlock 时 mprotect 提交即已缺页） */
+    memset(b + 1, 0, b->cap);
+    return b + 1;
+}
+
+void mem_arena_free(void *p)
+{
+    if (!p) return;
+    MemBlock *b = (MemBlock *)p - 1;
+    pthread_mutex_lock(&g_lock);
+    if (!g_arena.ready || (uint8_t *)p < g_arena.base || (uint8_t *)p >= g_arena.base + g_arena.used ||
+        b->magic != MEM_BLOCK_LIVE) {
+        LOGE("[%s] free of %p: not a live arena block", TAG, p);
+        pthread_mutex_unlock(&g_lock);
+        return;
+    }
+    g_arena.host[b->stage] -= b->cap;
+    g_arena.blocks[b->stage]--;
+    b->magic = MEM_BLOCK_FREE;
+    b->next  = g_arena.free_list;
+    g_arena.free_list = b;
+    pthread_mutex_unlock(&g_lock);
+}
+
+int mem_arena_charge(MemStage stage, size_t bytes)
+{
+    if ((unsigned int)stage >= MEM_STAGE_COUNT) stage = MEM_STAGE_OTHER;
+    pthread_mutex_lock(&g_lock);
+    uint64_t total = (uint64_t)g_arena.used + g_arena.dev_total + bytes;
+    if (g_arena.o.budget && total > g_arena.o.budget) {
+        LOGE("[%s] %s: device buffer %zuKB exceeds budget (arena %zuKB, device %lluKB, budget %lluKB)", TAG,
+             k_stage_names[stage], bytes >> 10, g_arena.used >> 10, (unsigned long long)(g_arena.dev_total >> 10),
+             (unsigned long long)(g_arena.o.budget >> 10));
+        print_stages();
+        pthread_mutex_unlock(&g_lock);
+        return -1;
+    }
+    g_arena.dev[stage] += bytes;
+    g_arena.dev_total  += bytes;
+    arena_note_peak();
+    pthread_mutex_unlock(&g_lock);
+    return 0;
+}
+
+void mem_arena_uncharge(MemStage stage, size_t bytes)
+{
+    if ((unsigned int)stage >= MEM_STAGE_COUNT) stage = MEM_STAGE_OTHER;
+    pthread_mutex_lock(&g_lock);
+    if (bytes > g_arena.dev[stage]) bytes = (size_t)g_arena.dev[stage];
+    g_arena.dev[stage] -= bytes;
+    g_arena.dev_total  -= bytes;
+    pthread_mutex_unlock(&g_lock);
+}
+
+void mem_arena_seal(void)
+{
+    pthread_mutex_lock(&g_lock);
+    g_arena.sealed = 1;
+    pthread_mutex_unlock(&g_lock);
+}
+
+/* [p, p+len) 中驻留的字节（mincore，按页） */
+static uint64_t resident_bytes(const uint8_t *p, size_t len, size_t page)
+{
+    uint8_t *start = (uint8_t *)((uintptr_t)p & ~(uintptr_t)(page - 1));
+    size_t   n     = ((size_t)(p + len - start) + page - 1) / page;
+    unsigned char vec[256];
+    uint64_t res = 0;
+    for (size_t off = 0; off < n; off += sizeof(vec)) {
+        size_t k = n - off < sizeof(vec) ? n - off : sizeof(vec);
+        if (mincore(start + off * page, k * page, vec) != 0) return 0;
+        for (size_t i = 0; i < k; i++) res += vec[i] & 1;
+    }
+    return res * page;
+}
+
+/* /proc/self/statm 的 RSS（KB），取不到返回 -1 */
+static long rss_kb(void)
+{
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if (!fp) return -1;
+    long size = 0, rss = -1;
+    if (fscanf(fp, "%ld %ld", &size, &rss) != 2) rss = -1;
+    fclose(fp);
+    return rss < 0 ? -1 : rss * (sysconf(_SC_PAGESIZE) >> 10);
+}
+
+void mem_arena_report(const char *when)
+{
+    pthread_mutex_lock(&g_lock);
+    if (!g_arena.ready) {
+        pthread_mutex_unlock(&g_lock);
+        return;
+    }
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    uint64_t res[MEM_STAGE_COUNT] = { 0 };
+    uint64_t host = 0, res_total = 0;
+    for (const MemBlock *b = g_arena.all; b; b = b->all_next) {
+        if (b->magic != MEM_BLOCK_LIVE) continue;
+        res[b->stage] += resident_bytes((const uint8_t *)(b + 1), b->cap, page);
+    }
+    for (int s = 0; s < MEM_STAGE_COUNT; s++) {
+        host      += g_arena.host[s];
+        res_total += res[s];
+    }
+
+    char bs[32];
+    LOGI("[%s] %s: arena in use %lluKB (resident %lluKB, %zuKB carved, %zuKB committed, pages=%s), "
+         "device %lluKB, peak %lluKB, budget %s, process rss %ldKB", TAG, when ? when : "report",
+         (unsigned long long)(host >> 10), (unsigned long long)(res_total >> 10), g_arena.used >> 10,
+         g_arena.committed >> 10, mem_pages_name(g_arena.pages), (unsigned long long)(g_arena.dev_total >> 10),
+         (unsigned long long)(g_arena.peak >> 10), budget_str(bs, sizeof(bs)), rss_kb());
+    for (int s = 0; s < MEM_STAGE_COUNT; s++) {
+        if (!g_arena.host[s] && !g_arena.dev[s]) continue;
+        LOGI("[%s]   %-8s host=%lluKB resident=%lluKB (%u blocks) device=%lluKB", TAG, k_stage_names[s],
+             (unsigned long long)(g_arena.host[s] >> 10), (unsigned long long)(res[s] >> 10), g_arena.blocks[s],
+             (unsigned long long)(g_arena.dev[s] >> 10));
+    }
+    if (g_arena.sealed) {
+        if (g_arena.late_allocs > g_arena.late_reused)
+            LOGI("[%s]   after startup: %u allocations, %u reused from the pool, %lluKB newly carved", TAG,
+                 g_arena.late_allocs, g_arena.late_reused, (unsigned long long)(g_arena.late_bytes >> 10));
+        else if (g_arena.late_allocs)
+            LOGI("[%s]   after startup: %u allocations, all reused from the pool", TAG, g_arena.late_allocs);
+        else
+            LOGI("[%s]   after startup: no allocations", TAG);
+    }
+    pthread_mutex_unlock(&g_lock);
+}
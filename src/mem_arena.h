@@ -0,0 +1,93 @@
+// mem_arena.h
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 流水线缓冲的统一内存区（--mem-budget / --hugepages）。
+ *
+ * 采集 buffer、合帧缓冲、packet slot、PCM 环、音频编码缓冲、写出环 / 推流与事件缓存、
+ * TS 封装缓冲、stdio 缓冲都从这一块区域里分配，不再各自 malloc：
+ * - 启动时保留一段地址空间（有预算时为预算大小，否则 MEM_ARENA_RESERVE_DEFAULT），按需 mprotect 提交；
+ *   分配时清零，页面在启动阶段就已缺页（配合 --mlock 同时锁定），运行中不再缺页；
+ * - 释放的块挂回空闲链表，之后同样大小的分配（通道重启、待机后的每次录制、sink 重开）直接复用，不再增长；
+ * - 预算：arena 已用（含空闲链表里的块）加上按 mem_arena_charge 记账的设备内存
+ *   （V4L2 MMAP / dma-heap buffer、MPP 的 ION 输入池）不超过 budget，超出时分配失败，启动报错退出；
+ * - 大页：thp = 对整个区域 madvise(MADV_HUGEPAGE)；hugetlb = MAP_HUGETLB 一次性预留（需要 --mem-budget，
+ *   且 /proc/sys/vm/nr_hugepages 足够），预留失败时告警退回 thp；
+ * - 启动完成时 mem_arena_seal，之后的分配单独计数，退出报告里能看出运行期间是否还有分配。
+ *
+ * 分配与释放都在启动 / 关闭路径上，内部用一把锁；采集 / 编码 / 写出线程的稳态路径不调用这里。
+ * 没有调用 mem_arena_setup 时（例如 bench）第一次分配按默认参数初始化。
+ */
+
+#define MEM_ARENA_ALIGN          64                    // 默认对齐（cache line）
+#define MEM_ARENA_COMMIT         (2u << 20)            // 提交粒度（与 2MB 大页对齐，THP 才能生效）
+#define MEM_ARENA_RESERVE_DEFAULT ((uint64_t)(sizeof(void *) >= 8 ? 1024u : 256u) << 20)
+
+typedef enum {
+    MEM_STAGE_CAPTURE = 0,   // 采集 buffer（回放源 / USERPTR）、合帧缓冲、YUYV shadow；MMAP / dma-heap 只记账
+    MEM_STAGE_ENCODE,        // packet slot；MPP ION 输入池只记账
+    MEM_STAGE_AUDIO,         // PCM 环、ALSA 读缓冲、音频编码
+    MEM_STAGE_SINK,          // 写出：TS 封装、异步写盘环、推流 / 事件缓存、stdio 缓冲
+    MEM_STAGE_OTHER,         // 运动检测等
+    MEM_STAGE_COUNT
+} MemStage;
+
+typedef enum {
+    MEM_PAGES_NORMAL = 0,    // 普通页
+    MEM_PAGES_THP,           // 透明大页（madvise）
+    MEM_PAGES_HUGETLB,       // hugetlbfs 大页（MAP_HUGETLB）
+} MemPages;
+
+typedef struct {
+    uint64_t budget;         // 字节；0 = 不限
+    MemPages pages;
+} MemArenaOpts;
+
+void        mem_arena_default_opts(MemArenaOpts *o);
+const char *mem_stage_name(MemStage stage);
+/* 名字 <-> 枚举（"off" / "thp" / "hugetlb"）。@return 0 成功；-1 未知名字 */
+int         mem_pages_from_name(const char *name, MemPages *out);
+const char *mem_pages_name(MemPages pages);
+
+/*
+ * 保留并映射内存区（在任何分配之前调用一次）。
+ * @return 0 成功；-1 失败（保留不到地址空间）
+ */
+int  mem_arena_setup(const MemArenaOpts *o);
+/* 解除映射（全部模块关闭之后调用） */
+void mem_arena_teardown(void);
+
+/*
+ * 分配 size 字节（清零，按 align 对齐，0 = MEM_ARENA_ALIGN；align 须为 2 的幂）。
+ * @return 地址；NULL = 超出预算或区域已满（已打印原因与各阶段占用）
+ */
+void *mem_arena_alloc(MemStage stage, size_t size, size_t align);
+/* 释放（挂回空闲链表）；NULL 为空操作 */
+void  mem_arena_free(void *p);
+
+/*
+ * 记账不在 arena 里的内存（V4L2 / dma-heap / ION），与 arena 共用预算。
+ * @return 0 成功；-1 超出预算
+ */
+int  mem_arena_charge(MemStage stage, size_t bytes);
+void mem_arena_uncharge(MemStage stage, size_t bytes);
+
+/* 启动完成：之后的分配计入 late 计数 */
+void mem_arena_seal(void);
+
+/*
+ * 打印各阶段的 arena 占用（分配量与实际驻留）、记账的设备内存、进程 RSS，
+ * 以及 seal 之后的分配次数（退出时为 0 / 全部复用即说明稳态没有分配）。
+ */
+void mem_arena_report(const char *when);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,506 @@
+// metrics_http.c
+#include "metrics_http.h"
+#include "log.h"
+#include "rt_sched.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#define TAG "metrics"
+
+#define METRICS_POLL_MS 1000
+
+static int64_t mono_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int metrics_http_parse_addr(const char *spec, MetricsHttpOpts *o)
+{
+    if (!spec || !o) return -1;
+    memset(o, 0, sizeof(*o));
+    const char *colon = strrchr(spec, ':');
+    const char *port  = colon ? colon + 1 : spec;
+    if (colon) {
+        size_t n = (size_t)(colon - spec);
+        if (n >= sizeof(o->host)) return -1;
+        memcpy(o->host, spec, n);
+        o->host[n] = '\0';
+        struct in_addr a;
+        if (o->host[0] && inet_pton(AF_INET, o->host, &a) != 1) return -1;
+    }
+    char *end = NULL;
+    long v = strtol(port, &end, 10);
+    if (!port[0] || *end || v < 1 || v > 65535) return -1;
+    o->port = (uint16_t)v;
+    return 0;
+}
+
+/* ===================== Exposition ===================== */
+
+/* 可增长的输出缓冲；内存不足时置 oom，之后的追加全部忽略 */
+typedef struct {
+    char  *p;
+    size_t len;
+    size_t cap;
+    int    oom;
+} MetricsBuf;
+
+__attribute__((format(printf, 2, 3)))
+static void mb_printf(MetricsBuf *b, const char *fmt, ...)
+{
+    for (int pass = 0; pass < 2 && !b->oom; pass++) {
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(b->p ? b->p + b->len : NULL, b->cap - b->len, fmt, ap);
+        va_end(ap);
+        if (n < 0) {
+            b->oom = 1;
+            return;
+        }
+        if (b->len + (size_t)n < b->cap) {
+            b->len += (size_t)n;
+            return;
+        }
+        size_t cap = b->cap ? b->cap : 16384;
+        while (cap <= b->len + (size_t)n) cap *= 2;
+        char *p = (char *)realloc(b->p, cap);
+        if (!p) {
+            b->oom = 1;
+            return;
+        }
+        b->p   = p;
+        b->cap = cap;
+    }
+}
+
+/* 标签集：{channel="x",k="v",quantile="q"}，各项为 NULL / "" 时省略，全部省略时不输出大括号 */
+static void put_labels(MetricsBuf *b, const AvStatsExport *e, const char *k, const char *v, const char *q)
+{
+    int n = 0;
+    if (e->label[0]) mb_printf(b, "%schannel=\"%s\"", n++ ? "," : "{", e->label);
+    if (k) mb_printf(b, "%s%s=\"%s\"", n++ ? "," : "{", k, v);
+    if (q) mb_printf(b, "%squantile=\"%s\"", n++ ? "," : "{", q);
+    if (n) mb_printf(b, "}");
+}
+
+static void put_family(MetricsBuf *b, const char *name, const char *type, const char *help)
+{
+    mb_printf(b, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/* 启动以来的累计值（与 [TOTAL] 一致） */
+static const struct {
+    const char *name;
+    const char *help;
+    size_t      off;
+} k_counters[] = {
+    { "rkav_video_frames_total",      "Encoded video frames (main stream).",
+      offsetof(AvStatsExport, video_frames) },
+    { "rkav_enc_bytes_total",         "Encoded video bytes (main stream).",
+      offsetof(AvStatsExport, enc_bytes) },
+    { "rkav_audio_chunks_total",      "Audio chunks written.",
+      offsetof(AvStatsExport, audio_chunks) },
+    { "rkav_audio_xruns_total",       "Audio capture overruns.",
+      offsetof(AvStatsExport, audio_xruns) },
+    { "rkav_drops_total",             "Dropped video frames and pipeline errors.",
+      offsetof(AvStatsExport, drops) },
+    { "rkav_shed_total",              "Video frames shed by --drop-policy (included in rkav_drops_total).",
+      offsetof(AvStatsExport, shed) },
+    { "rkav_motion_skip_total",       "Static frames skipped by --motion skip (not drops).",
+      offsetof(AvStatsExport, skip) },
+    { "rkav_wakeups_total",           "Thread wakeups from poll / semaphore waits.",
+      offsetof(AvStatsExport, wakeups) },
+    { "rkav_sink_backpressure_total", "Async sink writes rejected above the high watermark.",
+      offsetof(AvStatsExport, sink_bp) },
+    { "rkav_net_drop_gops_total",     "GOPs dropped by the streaming sink.",
+      offsetof(AvStatsExport, net_drop_gops) },
+};
+
+/* 最近一个统计窗口（与 [STAT] 一致） */
+enum {
+    G_UPTIME = 0, G_FPS, G_BITRATE, G_AUDIO_CPS, G_Q_ENC, G_Q_SINK, G_INFLIGHT, G_ENC_LAT_MAX,
+    G_SINK_FILL, G_NET_Q, G_NET_LAT, G_AV_DRIFT, G_MOTION, G_COUNT
+};
+
+static const struct {
+    const char *name;
+    const char *help;
+} k_gauges[G_COUNT] = {
+    [G_UPTIME]      = { "rkav_uptime_seconds",          "Seconds covered by the statistics." },
+    [G_FPS]         = { "rkav_video_fps",               "Encoded frames per second over the last window." },
+    [G_BITRATE]     = { "rkav_enc_bitrate_bps",         "Encoded bitrate over the last window." },
+    [G_AUDIO_CPS]   = { "rkav_audio_chunks_per_second", "Audio chunks per second over the last window." },
+    [G_Q_ENC]       = { "rkav_queue_enc_max",           "Max capture -> encode queue depth in the last window." },
+    [G_Q_SINK]      = { "rkav_queue_sink_max",          "Max encode -> sink queue depth in the last window." },
+    [G_INFLIGHT]    = { "rkav_enc_inflight_max",        "Max frames in flight in the encoder in the last window." },
+    [G_ENC_LAT_MAX] = { "rkav_enc_latency_max_seconds", "Max submit -> packet latency in the last window." },
+    [G_SINK_FILL]   = { "rkav_sink_fill_bytes",         "Max async sink backlog in the last window." },
+    [G_NET_Q]       = { "rkav_net_queue_bytes",         "Max streaming send queue in the last window." },
+    [G_NET_LAT]     = { "rkav_net_latency_max_seconds", "Max capture -> ffmpeg pipe latency in the last window." },
+    [G_AV_DRIFT]    = { "rkav_av_drift_seconds",        "Video minus audio clock error (positive = video behind)." },
+    [G_MOTION]      = { "rkav_motion_score_max",        "Max --motion score (changed block %) in the last window." },
+};
+
+static double gauge_value(const AvStatsExport *e, int g)
+{
+    const AvStatsWindow *w = &e->last;
+    double dt = w->dt_us > 0 ? (double)w->dt_us / 1e6 : 1.0;
+    switch (g) {
+    case G_UPTIME:      return (double)e->uptime_us / 1e6;
+    case G_FPS:         return (double)w->frames / dt;
+    case G_BITRATE:     return (double)w->bytes * 8.0 / dt;
+    case G_AUDIO_CPS:   return (double)w->audio_chunks / dt;
+    case G_Q_ENC:       return (double)w->q_enc;
+    case G_Q_SINK:      return (double)w->q_sink;
+    case G_INFLIGHT:    return (double)w->inflight;
+    case G_ENC_LAT_MAX: return (double)w->enc_lat_max_us / 1e6;
+    case G_SINK_FILL:   return (double)w->sink_fill;
+    case G_NET_Q:       return (double)w->net_q;
+    case G_NET_LAT:     return (double)w->net_lat_us / 1e6;
+    case G_AV_DRIFT:    return (double)w->av_drift_us / 1e6;
+    case G_MOTION:      return (double)w->motion;
+    default:            return 0.0;
+    }
+}
+
+/* 一个分位数；窗口内无样本时为 NaN（Prometheus 的约定） */
+static void put_quantile(MetricsBuf *b, const char *name, const AvStatsExport *e, const char *k, const char *v,
+                         const char *q, uint64_t val, const AvStatsHistExport *h, double scale)
+{
+    mb_printf(b, "%s", name);
+    put_labels(b, e, k, v, q);
+    if (h->win_count) mb_printf(b, " %.9g\n", (double)val / scale);
+    else mb_printf(b, " NaN\n");
+}
+
+/*
+ * 直方图：时间类为 rkav_stage_seconds{stage=...}，队列深度类为 rkav_queue_depth{queue=...}，
+ * 各自再带一个 *_max gauge（最近一个窗口的最大值）。从没有样本的阶段不输出（未启用的功能不占序列）。
+ */
+static void put_summaries(MetricsBuf *b, const AvStatsExport *view, int nchan, int is_time)
+{
+    const char *name  = is_time ? "rkav_stage_seconds" : "rkav_queue_depth";
+    const char *maxn  = is_time ? "rkav_stage_max_seconds" : "rkav_queue_depth_max";
+    const char *key   = is_time ? "stage" : "queue";
+    double      scale = is_time ? 1e6 : 1.0;
+
+    put_family(b, name, "summary", is_time
+               ? "Per-stage latency: _count/_sum since start, quantiles over the last window."
+               : "Queue depth after enqueue: _count/_sum since start, quantiles over the last window.");
+    for (int i = 0; i < AV_HIST_COUNT; i++) {
+        if (av_stats_hist_is_time((AvHistId)i) != is_time) continue;
+        const char *stage = av_stats_hist_name((AvHistId)i);
+        for (int c = 0; c < nchan; c++) {
+            const AvStatsExport *e = &view[c];
+            const AvStatsHistExport *h = &e->hist[i];
+            if (!h->count) continue;
+            put_quantile(b, name, e, key, stage, "0.5", h->p50, h, scale);
+            put_quantile(b, name, e, key, stage, "0.9", h->p90, h, scale);
+            put_quantile(b, name, e, key, stage, "0.99", h->p99, h, scale);
+            mb_printf(b, "%s_sum", name);
+            put_labels(b, e, key, stage, NULL);
+            mb_printf(b, " %.9g\n%s_count", (double)h->sum / scale, name);
+            put_labels(b, e, key, stage, NULL);
+            mb_printf(b, " %llu\n", (unsigned long long)h->count);
+        }
+    }
+
+    put_family(b, maxn, "gauge", "Max sample in the last window.");
+    for (int i = 0; i < AV_HIST_COUNT; i++) {
+        if (av_stats_hist_is_time((AvHistId)i) != is_time) continue;
+        const char *stage = av_stats_hist_name((AvHistId)i);
+        for (int c = 0; c < nchan; c++) {
+            const AvStatsExport *e = &view[c];
+            if (!e->hist[i].count) continue;
+            mb_printf(b, "%s", maxn);
+            put_labels(b, e, key, stage, NULL);
+            mb_printf(b, " %.9g\n", (double)e->hist[i].max / scale);
+        }
+    }
+}
+
+/* 按 Prometheus 文本格式输出全部通道（同名指标的各通道连续输出） */
+static void render(MetricsBuf *b, const AvStatsExport *view, int nchan, double age, uint64_t scrapes)
+{
+    for (size_t k = 0; k < sizeof(k_counters) / sizeof(k_counters[0]); k++) {
+        put_family(b, k_counters[k].name, "counter", k_counters[k].help);
+        for (int c = 0; c < nchan; c++) {
+            uint64_t v;
+            memcpy(&v, (const char *)&view[c] + k_counters[k].off, sizeof(v));
+            mb_printf(b, "%s", k_counters[k].name);
+            put_labels(b, &view[c], NULL, NULL, NULL);
+            mb_printf(b, " %llu\n", (unsigned long long)v);
+        }
+    }
+    for (int g = 0; g < G_COUNT; g++) {
+        put_family(b, k_gauges[g].name, "gauge", k_gauges[g].help);
+        for (int c = 0; c < nchan; c++) {
+            mb_printf(b, "%s", k_gauges[g].name);
+            put_labels(b, &view[c], NULL, NULL, NULL);
+            mb_printf(b, " %.9g\n", gauge_value(&view[c], g));
+        }
+    }
+    put_summaries(b, view, nchan, 1);
+    put_summaries(b, view, nchan, 0);
+    put_family(b, "rkav_stats_age_seconds", "gauge", "Seconds since the stats thread last published (stall detector).");
+    mb_printf(b, "rkav_stats_age_seconds %.3f\n", age);
+    put_family(b, "rkav_metrics_scrapes_total", "counter", "Requests served by this endpoint.");
+    mb_printf(b, "rkav_metrics_scrapes_total %llu\n", (unsigned long long)scrapes);
+}
+
+/* ===================== HTTP ===================== */
+
+static void client_close(MetricsClient *cl)
+{
+    if (cl->fd >= 0) close(cl->fd);
+    free(cl->out);
+    memset(cl, 0, sizeof(*cl));
+    cl->fd = -1;
+}
+
+/* 组一个完整响应（头 + 正文）放进 cl->out */
+static void client_respond(MetricsClient *cl, const char *status, const char *type, const char *body,
+                           size_t body_len, int head_only)
+{
+    MetricsBuf b = { 0 };
+    mb_printf(&b, "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n",
+              status, type, body_len);
+    if (!head_only && body_len && !b.oom) {
+        size_t need = b.len + body_len;
+        char *p = (char *)realloc(b.p, need);
+        if (p) {
+            memcpy(p + b.len, body, body_len);
+            b.p   = p;
+            b.len = need;
+        } else b.oom = 1;
+    }
+    if (b.oom) {
+        free(b.p);
+        b.p   = NULL;
+        b.len = 0;
+    }
+    cl->out     = b.p;
+    cl->out_len = b.len;
+    cl->out_off = 0;
+}
+
+/* 请求头已收齐：只认 GET/HEAD /metrics（可带查询串） */
+static void client_handle(MetricsHttp *m, MetricsClient *cl)
+{
+    static const char k_text[] = "text/plain; charset=utf-8";
+    char method[8] = "", path[256] = "";
+    if (sscanf(cl->in, "%7s %255s", method, path) != 2) {
+        client_respond(cl, "400 Bad Request", k_text, "bad request\n", 12, 0);
+        return;
+    }
+    int head = strcmp(method, "HEAD") == 0;
+    if (!head && strcmp(method, "GET") != 0) {
+        client_respond(cl, "405 Method Not Allowed", k_text, "method not allowed\n", 19, 0);
+        return;
+    }
+    char *q = strchr(path, '?');
+    if (q) *q = '\0';
+    if (strcmp(path, "/metrics") != 0) {
+        client_respond(cl, "404 Not Found", k_text, "try /metrics\n", 13, head);
+        return;
+    }
+
+    pthread_mutex_lock(&m->lock);
+    int nchan = m->nchan;
+    int64_t published = m->publish_us;
+    memcpy(m->view, m->chan, sizeof(m->view[0]) * (size_t)nchan);
+    pthread_mutex_unlock(&m->lock);
+
+    MetricsBuf b = { 0 };
+    double age = nchan ? (double)(mono_us() - published) / 1e6 : 0.0;
+    render(&b, m->view, nchan, age, ++m->scrapes);
+    if (b.oom) client_respond(cl, "500 Internal Server Error", k_text, "out of memory\n", 14, head);
+    else client_respond(cl, "200 OK", "text/plain; version=0.0.4; charset=utf-8", b.p, b.len, head);
+    free(b.p);
+}
+
+/* 读请求头；收齐后生成响应。@return 0 继续；-1 关闭连接 */
+static int client_read(MetricsHttp *m, MetricsClient *cl)
+{
+    for (;;) {
+        size_t room = sizeof(cl->in) - 1 - cl->in_len;
+        if (room == 0) {
+            client_respond(cl, "431 Request Header Fields Too Large", "text/plain; charset=utf-8", "", 0, 0);
+            return 0;
+        }
+        ssize_t n = recv(cl->fd, cl->in + cl->in_len, room, MSG_DONTWAIT);
+        if (n < 0) return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+        if (n == 0) return -1;
+        cl->in_len += (size_t)n;
+        cl->in[cl->in_len] = '\0';
+        if (strstr(cl->in, "\r\n\r\n") || strstr(cl->in, "\n\n")) {
+            client_handle(m, cl);
+            return 0;
+        }
+    }
+}
+
+/* 写响应。@return 0 还没写完；-1 写完或出错（关闭连接） */
+static int client_write(MetricsClient *cl)
+{
+    while (cl->out_off < cl->out_len) {
+        ssize_t n = send(cl->fd, cl->out + cl->out_off, cl->out_len - cl->out_off, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (n < 0) return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) ? 0 : -1;
+        cl->out_off += (size_t)n;
+    }
+    return -1;
+}
+
+/* 新连接：占一个空闲槽；满了直接关闭（抓取方会重试） */
+static void server_accept(MetricsHttp *m)
+{
+    int fd = accept4(m->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) return;
+    for (int i = 0; i < METRICS_MAX_CLIENTS; i++) {
+        MetricsClient *cl = &m->clients[i];
+        if (cl->fd >= 0) continue;
+        cl->fd          = fd;
+        cl->deadline_us = mono_us() + (int64_t)METRICS_CLIENT_TIMEOUT_MS * 1000;
+        return;
+    }
+    close(fd);
+}
+
+/* 服务线程：只读发布好的快照，不接触 AvStats */
+static void *metrics_thread(void *arg)
+{
+    MetricsHttp *m = (MetricsHttp *)arg;
+    rt_sched_apply(RT_ROLE_STATS, "metrics");
+
+    while (!atomic_load(&m->stop)) {
+        struct pollfd pfds[2 + METRICS_MAX_CLIENTS];
+        int slots[2 + METRICS_MAX_CLIENTS];
+        int n = 0;
+        pfds[n++] = (struct pollfd){ .fd = m->wake_fd,   .events = POLLIN };
+        pfds[n++] = (struct pollfd){ .fd = m->listen_fd, .events = POLLIN };
+        for (int i = 0; i < METRICS_MAX_CLIENTS; i++) {
+            MetricsClient *cl = &m->clients[i];
+            if (cl->fd < 0) continue;
+            slots[n] = i;
+            pfds[n++] = (struct pollfd){ .fd = cl->fd, .events = cl->out ? POLLOUT : POLLIN };
+        }
+        if (poll(pfds, (nfds_t)n, METRICS_POLL_MS) < 0) {
+            if (errno == EINTR) continue;
+            LOGE("[%s] poll failed: %s", TAG, strerror(errno));
+            break;
+        }
+        if (pfds[0].revents & POLLIN) break;
+        if (pfds[1].revents & POLLIN) server_accept(m);
+
+        int64_t now = mono_us();
+        for (int k = 2; k < n; k++) {
+            MetricsClient *cl = &m->clients[slots[k]];
+            int close_it = 0;
+            if (pfds[k].revents & (POLLERR | POLLNVAL)) close_it = 1;
+            else if (!cl->out && (pfds[k].revents & (POLLIN | POLLHUP))) close_it = client_read(m, cl) != 0;
+            /* 响应刚生成时多半可以直接写完，不必再等一轮 POLLOUT */
+            if (!close_it && cl->out) close_it = client_write(cl) != 0;
+            if (!close_it && now >= cl->deadline_us) close_it = 1;
+            if (close_it) client_close(cl);
+        }
+    }
+
+    for (int i = 0; i < METRICS_MAX_CLIENTS; i++) client_close(&m->clients[i]);
+    return NULL;
+}
+
+/* ===================== API ===================== */
+
+static int server_listen(MetricsHttp *m)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(m->o.port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (m->o.host[0] && inet_pton(AF_INET, m->o.host, &addr.sin_addr) != 1) {
+        LOGE("[%s] invalid address: %s", TAG, m->o.host);
+        return -1;
+    }
+
+    m->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m->listen_fd < 0) {
+        LOGE("[%s] socket failed: %s", TAG, strerror(errno));
+        return -1;
+    }
+    int one = 1;
+    setsockopt(m->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(m->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(m->listen_fd, 16) != 0) {
+        LOGE("[%s] listen %s:%u failed: %s", TAG, m->o.host[0] ? m->o.host : "0.0.0.0", m->o.port,
+             strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int metrics_http_open(MetricsHttp *m, const MetricsHttpOpts *o)
+{
+    if (!m || !o || !o->port) return -1;
+    memset(m, 0, sizeof(*m));
+    m->o         = *o;
+    m->listen_fd = -1;
+    for (int i = 0; i < METRICS_MAX_CLIENTS; i++) m->clients[i].fd = -1;
+    pthread_mutex_init(&m->lock, NULL);
+
+    m->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m->wake_fd < 0 || server_listen(m) != 0 ||
+        pthread_create(&m->th, NULL, metrics_thread, m) != 0) {
+        if (m->listen_fd >= 0) close(m->listen_fd);
+        if (m->wake_fd >= 0) close(m->wake_fd);
+        pthread_mutex_destroy(&m->lock);
+        m->listen_fd = -1;
+        m->wake_fd   = -1;
+        return -1;
+    }
+    m->started = 1;
+    LOGI("[%s] serving http://%s:%u/metrics", TAG, m->o.host[0] ? m->o.host : "0.0.0.0", m->o.port);
+    return 0;
+}
+
+void metrics_http_close(MetricsHttp *m)
+{
+    if (!m || !m->started) return;
+    atomic_store(&m->stop, 1);
+    uint64_t one = 1;
+    ssize_t n = write(m->wake_fd, &one, sizeof(one));
+    (void)n;
+    pthread_join(m->th, NULL);
+    m->started = 0;
+    LOGI("[%s] closed: %llu scrapes", TAG, (unsigned long long)m->scrapes);
+    close(m->listen_fd);
+    close(m->wake_fd);
+    m->listen_fd = -1;
+    m->wake_fd   = -1;
+    pthread_mutex_destroy(&m->lock);
+}
+
+void metrics_http_publish(MetricsHttp *m, int idx, const AvStats *s)
+{
+    if (!m || !m->started || !s || idx < 0 || idx >= METRICS_MAX_CHANNELS) return;
+    AvStatsExport e;
+    av_stats_export(s, &e);   // 锁外生成（分位数计算），锁内只做一次拷贝
+    pthread_mutex_lock(&m->lock);
+    m->chan[idx] = e;
+    if (m->nchan < idx + 1) m->nchan = idx + 1;
+    m->publish_us = mono_us();
+    pthread_mutex_unlock(&m->lock);
+}
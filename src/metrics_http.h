@@ -0,0 +1,90 @@
+// metrics_http.h
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "av_stats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 统计导出（--metrics）：一个小的 HTTP 服务线程，GET /metrics 返回 Prometheus 文本格式
+ * （text/plain; version=0.0.4），供监控系统直接抓取，不用再从日志里解析 [STAT] 行。
+ *
+ * - 内容：每一路的累计计数（*_total，counter）、最近一个统计窗口的速率与最大值（gauge）、
+ *   各阶段直方图（summary：_count/_sum 为累计，quantile 为最近一个窗口），--channels 时带 channel 标签；
+ * - 数据来源：统计线程每次 tick 之后调用 metrics_http_publish，把 av_stats_export 的快照拷进本模块；
+ *   服务线程只读这份快照。两边共用的只有一把短锁（拷贝一份定长结构体），
+ *   采集 / 编码 / 写出线程完全不参与——它们仍然只做原子累加；
+ * - 服务线程：poll 非阻塞 accept / read / write，最多 METRICS_MAX_CLIENTS 个并发连接，
+ *   每个连接一个请求（Connection: close），METRICS_CLIENT_TIMEOUT_MS 内没完成的连接直接关闭，
+ *   慢客户端不会拖住统计线程。
+ */
+#define METRICS_MAX_CHANNELS       8
+#define METRICS_MAX_CLIENTS        8
+#define METRICS_CLIENT_TIMEOUT_MS  5000
+#define METRICS_REQ_MAX            2048   // 请求头上限（字节），超出回 431
+
+typedef struct {
+    char     host[64];             // 监听地址；"" = 全部地址
+    uint16_t port;
+} MetricsHttpOpts;
+
+/*
+ * 解析 "[addr:]port"（例如 "9100"、"127.0.0.1:9100"）。
+ * @return 0 成功；-1 格式不合法
+ */
+int metrics_http_parse_addr(const char *spec, MetricsHttpOpts *o);
+
+typedef struct {
+    int            fd;             // -1 = 空闲
+    int64_t        deadline_us;
+    size_t         in_len;
+    char           in[METRICS_REQ_MAX];
+    char          *out;            // 响应（malloc），写完即关闭连接
+    size_t         out_len;
+    size_t         out_off;
+} MetricsClient;
+
+typedef struct {
+    MetricsHttpOpts o;
+    int             listen_fd;
+    int             wake_fd;       // eventfd：停止
+    atomic_int      stop;
+    pthread_t       th;
+    int             started;
+
+    /* 统计线程发布、服务线程拷贝；只在这两个线程之间加锁 */
+    pthread_mutex_t lock;
+    int             nchan;
+    int64_t         publish_us;    // 最近一次发布的时刻（单调时钟）
+    AvStatsExport   chan[METRICS_MAX_CHANNELS];
+
+    /* 以下仅服务线程访问 */
+    AvStatsExport   view[METRICS_MAX_CHANNELS];
+    MetricsClient   clients[METRICS_MAX_CLIENTS];
+    uint64_t        scrapes;
+} MetricsHttp;
+
+/*
+ * 监听并启动服务线程。
+ * @return 0 成功；-1 失败（已释放）
+ */
+int  metrics_http_open(MetricsHttp *m, const MetricsHttpOpts *o);
+
+/* 停止服务线程并关闭全部连接。 */
+void metrics_http_close(MetricsHttp *m);
+
+/*
+ * 发布第 idx 路的快照（统计线程，在 av_stats_tick_print 之后调用）。
+ * idx 从 0 开始连续编号，导出的通道数为发布过的最大 idx + 1。
+ */
+void metrics_http_publish(MetricsHttp *m, int idx, const AvStats *s);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,214 @@
+// motion.c
+#include "motion.h"
+#include "log.h"
+#include "mem_arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__aarch64__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#  include <arm_neon.h>
+#  define MOTION_USE_NEON 1
+#else
+#  define MOTION_USE_NEON 0
+#endif
+
+#define TAG "motion"
+
+static const char *const k_mode_names[] = {
+    [MOTION_OFF]  = "off",
+    [MOTION_SKIP] = "skip",
+    [MOTION_RATE] = "rate",
+};
+
+int motion_mode_from_name(const char *name, MotionMode *out)
+{
+    if (!name || !out) return -1;
+    for (int i = 0; i < (int)(sizeof(k_mode_names) / sizeof(k_mode_names[0])); i++) {
+        if (strcmp(name, k_mode_names[i]) == 0) {
+            *out = (MotionMode)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *motion_mode_name(MotionMode mode)
+{
+    if ((int)mode < 0 || (int)mode >= (int)(sizeof(k_mode_names) / sizeof(k_mode_names[0]))) return "?";
+    return k_mode_names[mode];
+}
+
+void motion_default_opts(MotionOpts *o)
+{
+    if (!o) return;
+    memset(o, 0, sizeof(*o));
+    o->threshold        = MOTION_THRESH_DEFAULT;
+    o->area_pct         = MOTION_AREA_DEFAULT;
+    o->hold_ms          = MOTION_HOLD_DEFAULT;
+    o->idle_interval_us = 1000000;
+}
+
+/* ===================== Kernels ===================== */
+
+/* 一行缩略图：每格为 r0、r1 两行各 8 个像素的平均（四舍五入） */
+static void thumb_row_c(uint8_t *dst, const uint8_t *r0, const uint8_t *r1, unsigned int from, unsigned int tw)
+{
+    for (unsigned int c = from; c < tw; c++) {
+        const uint8_t *p = r0 + (size_t)c * 8, *q = r1 + (size_t)c * 8;
+        unsigned int sum = 0;
+        for (int k = 0; k < 8; k++) sum += (unsigned int)p[k] + q[k];
+        dst[c] = (uint8_t)((sum + 8) >> 4);
+    }
+}
+
+/* 参考块与本帧块的 SAD（w x h，行跨度均为 stride） */
+static uint32_t block_sad_c(const uint8_t *a, const uint8_t *b, unsigned int stride,
+                            unsigned int w, unsigned int h)
+{
+    uint32_t sad = 0;
+    for (unsigned int r = 0; r < h; r++) {
+        const uint8_t *p = a + (size_t)r * stride, *q = b + (size_t)r * stride;
+        for (unsigned int x = 0; x < w; x++) sad += (uint32_t)abs((int)p[x] - (int)q[x]);
+    }
+    return sad;
+}
+
+#if MOTION_USE_NEON
+
+const char *motion_impl(void)
+{
+    return "neon";
+}
+
+/* NEON：每次 64 像素 -> 8 格。两行逐对相加后两级 vpaddq 合成 8 像素和，vrshrn 取平均 */
+static void thumb_row(uint8_t *dst, const uint8_t *r0, const uint8_t *r1, unsigned int tw)
+{
+    unsigned int c = 0;
+    for (; c + 8 <= tw; c += 8) {
+        const uint8_t *p = r0 + (size_t)c * 8, *q = r1 + (size_t)c * 8;
+        uint16x8_t s0 = vpadalq_u8(vpaddlq_u8(vld1q_u8(p)),      vld1q_u8(q));
+        uint16x8_t s1 = vpadalq_u8(vpaddlq_u8(vld1q_u8(p + 16)), vld1q_u8(q + 16));
+        uint16x8_t s2 = vpadalq_u8(vpaddlq_u8(vld1q_u8(p + 32)), vld1q_u8(q + 32));
+        uint16x8_t s3 = vpadalq_u8(vpaddlq_u8(vld1q_u8(p + 48)), vld1q_u8(q + 48));
+        uint16x8_t sum = vpaddq_u16(vpaddq_u16(s0, s1), vpaddq_u16(s2, s3));
+        vst1_u8(dst + c, vrshrn_n_u16(sum, 4));
+    }
+    thumb_row_c(dst, r0, r1, c, tw);
+}
+
+/* NEON：整块（16 列）每行一次 vabd + 累加，不足 16 列的边缘块走标量 */
+static uint32_t block_sad(const uint8_t *a, const uint8_t *b, unsigned int stride,
+                          unsigned int w, unsigned int h)
+{
+    if (w != MOTION_BLOCK) return block_sad_c(a, b, stride, w, h);
+    uint16x8_t acc = vdupq_n_u16(0);
+    for (unsigned int r = 0; r < h; r++)
+        acc = vpadalq_u8(acc, vabdq_u8(vld1q_u8(a + (size_t)r * stride), vld1q_u8(b + (size_t)r * stride)));
+    return vaddvq_u16(acc);
+}
+
+#else
+
+const char *motion_impl(void)
+{
+    return "scalar";
+}
+
+static void thumb_row(uint8_t *dst, const uint8_t *r0, const uint8_t *r1, unsigned int tw)
+{
+    thumb_row_c(dst, r0, r1, 0, tw);
+}
+
+static uint32_t block_sad(const uint8_t *a, const uint8_t *b, unsigned int stride,
+                          unsigned int w, unsigned int h)
+{
+    return block_sad_c(a, b, stride, w, h);
+}
+
+#endif
+
+/* ===================== Detector ===================== */
+
+int motion_init(MotionDetector *m, const MotionOpts *o, unsigned int width, unsigned int height)
+{
+    if (!m || width < 16 || height < 16) return -1;
+    memset(m, 0, sizeof(*m));
+    if (o) m->o = *o;
+    else motion_default_opts(&m->o);
+    if (m->o.threshold == 0) m->o.threshold = MOTION_THRESH_DEFAULT;
+    if (m->o.area_pct == 0 || m->o.area_pct > 100) m->o.area_pct = MOTION_AREA_DEFAULT;
+
+    m->tw = width / 8;
+    m->th = height / 8;
+    m->bw = (m->tw + MOTION_BLOCK - 1) / MOTION_BLOCK;
+    m->bh = (m->th + MOTION_BLOCK - 1) / MOTION_BLOCK;
+    size_t n = (size_t)m->tw * m->th;
+    m->cur = (uint8_t *)mem_arena_alloc(MEM_STAGE_OTHER, n, 0);
+    m->ref = (uint8_t *)mem_arena_alloc(MEM_STAGE_OTHER, n, 0);
+    if (!m->cur || !m->ref) {
+        LOGE("[%s] thumbnail alloc %zu failed", TAG, n);
+        motion_close(m);
+        return -1;
+    }
+
+    LOGI("[%s] %ux%u -> thumb %ux%u, %ux%u blocks, thresh=%u area=%u%% hold=%ums idle every %lldms (%s)",
+         TAG, width, height, m->tw, m->th, m->bw, m->bh, m->o.threshold, m->o.area_pct, m->o.hold_ms,
+         (long long)(m->o.idle_interval_us / 1000), motion_impl());
+    return 0;
+}
+
+void motion_close(MotionDetector *m)
+{
+    if (!m) return;
+    mem_arena_free(m->cur);
+    mem_arena_free(m->ref);
+    m->cur = NULL;
+    m->ref = NULL;
+}
+
+/* 变化块占比（0..100），有变化块时向上取整到至少 1 */
+static unsigned int thumb_score(const MotionDetector *m)
+{
+    unsigned int changed = 0;
+    for (unsigned int by = 0; by < m->bh; by++) {
+        unsigned int y0 = by * MOTION_BLOCK;
+        unsigned int h  = m->th - y0 < MOTION_BLOCK ? m->th - y0 : MOTION_BLOCK;
+        for (unsigned int bx = 0; bx < m->bw; bx++) {
+            unsigned int x0 = bx * MOTION_BLOCK;
+            unsigned int w  = m->tw - x0 < MOTION_BLOCK ? m->tw - x0 : MOTION_BLOCK;
+            size_t off = (size_t)y0 * m->tw + x0;
+            uint32_t sad = block_sad(m->ref + off, m->cur + off, m->tw, w, h);
+            if (sad >= m->o.threshold * w * h) changed++;
+        }
+    }
+    unsigned int blocks = m->bw * m->bh;
+    return (changed * 100 + blocks - 1) / blocks;
+}
+
+int motion_update(MotionDetector *m, const uint8_t *y, unsigned int y_stride, int64_t now_us)
+{
+    for (unsigned int r = 0; r < m->th; r++) {
+        const uint8_t *row = y + (size_t)r * 8 * y_stride;
+        thumb_row(m->cur + (size_t)r * m->tw, row, row + (size_t)4 * y_stride, m->tw);
+    }
+
+    /* 第一帧没有参考：按有运动处理 */
+    m->score = m->has_ref ? thumb_score(m) : 100;
+    if (m->score >= m->o.area_pct) m->last_motion_us = now_us;
+    m->active = now_us - m->last_motion_us <= (int64_t)m->o.hold_ms * 1000;
+
+    int keep = m->active ||
+               (m->o.idle_interval_us > 0 && now_us - m->last_keep_us >= m->o.idle_interval_us);
+    if (!keep) {
+        m->skipped++;
+        return 0;
+    }
+    uint8_t *t = m->ref;
+    m->ref = m->cur;
+    m->cur = t;
+    m->has_ref      = 1;
+    m->last_keep_us = now_us;
+    m->kept++;
+    return 1;
+}
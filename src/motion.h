@@ -0,0 +1,86 @@
+// motion.h
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 运动 / 场景变化检测（--motion）：采集线程每帧调用一次，判断画面是否在动。
+ *
+ * - 抽样：亮度按 8x8 取一个像素格（每格取第 0、4 两行各 8 个像素求平均），得到 1/8 缩略图；
+ *   1080p 每帧只读约 1/4 的 Y 行，不读 UV；
+ * - 比较：缩略图按 MOTION_BLOCK x MOTION_BLOCK 分块（原图约 128x128）与参考图求 SAD，
+ *   块内平均差不小于 threshold 记为变化块；score = 变化块占比（0..100，有变化块时至少为 1）；
+ * - 判定：score 不小于 area_pct 视为有运动；最后一次有运动之后 hold_ms 内保持活跃状态，
+ *   避免画面短暂静止（人停下、物体减速）时频繁来回切换；
+ * - 参考图：活跃时每一帧都更新为参考（比较相邻帧）；空闲时只在“保留”的帧上更新
+ *   （每 idle_interval_us 一帧），所以缓慢的变化（光线、慢速移动）累积到阈值后照样会触发。
+ * aarch64/NEON 下抽样与 SAD 均为 16 像素一组的向量实现，否则退化为标量。
+ */
+#define MOTION_BLOCK          16   // 缩略图上的分块边长（像素）
+#define MOTION_THRESH_DEFAULT 10   // 块内平均亮度差（0..255）
+#define MOTION_AREA_DEFAULT   1    // 变化块占比（%）
+#define MOTION_HOLD_DEFAULT   2000 // ms
+
+typedef enum {
+    MOTION_OFF = 0,
+    MOTION_SKIP,    // 空闲时只保留 --motion-idle-fps 的帧送编码，其余直接归还
+    MOTION_RATE,    // 全部帧照常编码，空闲时把各路码率降到 --motion-idle-pct
+} MotionMode;
+
+/* 名字 <-> 枚举（"off" / "skip" / "rate"）。@return 0 成功；-1 未知名字 */
+int         motion_mode_from_name(const char *name, MotionMode *out);
+const char *motion_mode_name(MotionMode mode);
+
+typedef struct {
+    unsigned int threshold;        // 块内平均亮度差阈值，默认 MOTION_THRESH_DEFAULT
+    unsigned int area_pct;         // 有运动的变化块占比阈值，默认 MOTION_AREA_DEFAULT
+    unsigned int hold_ms;          // 默认 MOTION_HOLD_DEFAULT
+    int64_t      idle_interval_us; // 空闲时保留帧的间隔；0 = 空闲时不保留
+} MotionOpts;
+
+typedef struct {
+    MotionOpts   o;
+    unsigned int tw, th;           // 缩略图尺寸
+    unsigned int bw, bh;           // 分块数
+    uint8_t     *cur;              // 本帧缩略图
+    uint8_t     *ref;              // 参考缩略图
+    int          has_ref;
+    int          active;           // 1 = 活跃（hold_ms 内有过运动）
+    unsigned int score;            // 最近一帧的 score
+    int64_t      last_motion_us;
+    int64_t      last_keep_us;     // 空闲时最近一次保留帧的时刻
+    uint64_t     kept;
+    uint64_t     skipped;
+} MotionDetector;
+
+void motion_default_opts(MotionOpts *o);
+
+/*
+ * 按采集尺寸分配缩略图。
+ * @return 0 成功；-1 参数非法（尺寸小于 16x16）或内存不足
+ */
+int  motion_init(MotionDetector *m, const MotionOpts *o, unsigned int width, unsigned int height);
+void motion_close(MotionDetector *m);
+
+/*
+ * 分析一帧亮度并给出保留与否（调用后 m->score / m->active 为本帧结果）。
+ * 活跃时全部保留；空闲时每 idle_interval_us 保留一帧。保留的帧成为新的参考。
+ *
+ * @param y         Y 平面（至少 width x height，见 motion_init）
+ * @param y_stride  Y 行跨度（字节）
+ * @param now_us    当前时刻（单调时钟，微秒）
+ * @return          1 保留；0 空闲且不到保留时刻
+ */
+int  motion_update(MotionDetector *m, const uint8_t *y, unsigned int y_stride, int64_t now_us);
+
+/* 当前编译使用的内核名（"neon" / "scalar"）。 */
+const char *motion_impl(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,207 @@
+// src/nv12_repack.c
+#include "nv12_repack.h"
+
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  include <arm_neon.h>
+#  define NV12_USE_NEON 1
+#else
+#  define NV12_USE_NEON 0
+#endif
+
+/* 一对 YUYV 行 -> 两行 Y + 一行 UV（上下两行色度取平均），标量实现 */
+static void yuyv_row_pair_c(uint8_t *y0, uint8_t *y1, uint8_t *uv,
+                            const uint8_t *s0, const uint8_t *s1, unsigned int width)
+{
+    for (unsigned int x = 0; x < width; x += 2) {
+        const uint8_t *p = s0 + (size_t)x * 2, *q = s1 + (size_t)x * 2;
+        y0[x]     = p[0];
+        y0[x + 1] = p[2];
+        y1[x]     = q[0];
+        y1[x + 1] = q[2];
+        uv[x]     = (uint8_t)((p[1] + q[1] + 1) >> 1);
+        uv[x + 1] = (uint8_t)((p[3] + q[3] + 1) >> 1);
+    }
+}
+
+#if NV12_USE_NEON
+
+/*
+ * NEON 行拷贝：每次 4x16B 读写，提前预取约 4 个 cache line。
+ * 行跨度不等于宽度时 glibc memcpy 每行都要重新判断对齐/长度分支，
+ * 固定宽度的短循环在 A55 上更稳定。
+ */
+void nv12_copy_row(uint8_t *dst, const uint8_t *src, size_t n)
+{
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __builtin_prefetch(src + i + 256);
+        uint8x16_t a = vld1q_u8(src + i);
+        uint8x16_t b = vld1q_u8(src + i + 16);
+        uint8x16_t c = vld1q_u8(src + i + 32);
+        uint8x16_t d = vld1q_u8(src + i + 48);
+        vst1q_u8(dst + i, a);
+        vst1q_u8(dst + i + 16, b);
+        vst1q_u8(dst + i + 32, c);
+        vst1q_u8(dst + i + 48, d);
+    }
+    for (; i + 16 <= n; i += 16)
+        vst1q_u8(dst + i, vld1q_u8(src + i));
+    if (i < n)
+        memcpy(dst + i, src + i, n - i);
+}
+
+/* NEON 行清零：与 nv12_copy_row 相同的 64B 步长 */
+static void zero_row(uint8_t *dst, size_t n)
+{
+    const uint8x16_t z = vdupq_n_u8(0);
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        vst1q_u8(dst + i, z);
+        vst1q_u8(dst + i + 16, z);
+        vst1q_u8(dst + i + 32, z);
+        vst1q_u8(dst + i + 48, z);
+    }
+    for (; i + 16 <= n; i += 16)
+        vst1q_u8(dst + i, z);
+    if (i < n)
+        memset(dst + i, 0, n - i);
+}
+
+const char *nv12_repack_impl(void)
+{
+    return "neon";
+}
+
+/* NEON：每次 vld4 解交织 32 像素，色度用 vrhadd 取上下两行平均 */
+static void yuyv_row_pair(uint8_t *y0, uint8_t *y1, uint8_t *uv,
+                          const uint8_t *s0, const uint8_t *s1, unsigned int width)
+{
+    unsigned int x = 0;
+    for (; x + 32 <= width; x += 32) {
+        /* val[0]=Y 偶数像素，val[1]=U，val[2]=Y 奇数像素，val[3]=V */
+        uint8x16x4_t a = vld4q_u8(s0 + (size_t)x * 2);
+        uint8x16x4_t b = vld4q_u8(s1 + (size_t)x * 2);
+        uint8x16x2_t ya = { { a.val[0], a.val[2] } };
+        uint8x16x2_t yb = { { b.val[0], b.val[2] } };
+        uint8x16x2_t c  = { { vrhaddq_u8(a.val[1], b.val[1]), vrhaddq_u8(a.val[3], b.val[3]) } };
+        vst2q_u8(y0 + x, ya);
+        vst2q_u8(y1 + x, yb);
+        vst2q_u8(uv + x, c);
+    }
+    if (x < width)
+        yuyv_row_pair_c(y0 + x, y1 + x, uv + x, s0 + (size_t)x * 2, s1 + (size_t)x * 2, width - x);
+}
+
+#else
+
+void nv12_copy_row(uint8_t *dst, const uint8_t *src, size_t n)
+{
+    memcpy(dst, src, n);
+}
+
+static void zero_row(uint8_t *dst, size_t n)
+{
+    memset(dst, 0, n);
+}
+
+const char *nv12_repack_impl(void)
+{
+    return "scalar";
+}
+
+static void yuyv_row_pair(uint8_t *y0, uint8_t *y1, uint8_t *uv,
+                          const uint8_t *s0, const uint8_t *s1, unsigned int width)
+{
+    yuyv_row_pair_c(y0, y1, uv, s0, s1, width);
+}
+
+#endif
+
+/*
+ * 拷贝一个平面的 rows 行，每行 row_bytes 字节。
+ * 两侧 stride 都等于 row_bytes 时整块拷贝（无填充的常见情况）。
+ */
+static void copy_plane(uint8_t *dst, unsigned int dst_stride,
+                       const uint8_t *src, unsigned int src_stride,
+                       size_t row_bytes, unsigned int rows)
+{
+    if (dst_stride == row_bytes && src_stride == row_bytes) {
+        nv12_copy_row(dst, src, row_bytes * rows);
+        return;
+    }
+    for (unsigned int r = 0; r < rows; r++) {
+        nv12_copy_row(dst, src, row_bytes);
+        dst += dst_stride;
+        src += src_stride;
+    }
+}
+
+int nv12_repack(const Nv12Planes *src, const Nv12Planes *dst,
+                unsigned int width, unsigned int height,
+                unsigned int crop_x, unsigned int crop_y)
+{
+    if (!src || !dst || !src->y || !src->uv || !dst->y || !dst->uv) return -1;
+
+    width  &= ~1u;
+    height &= ~1u;
+    crop_x &= ~1u;
+    crop_y &= ~1u;
+    if (width == 0 || height == 0) return -1;
+    if (src->y_stride < crop_x + width || src->uv_stride < crop_x + width) return -1;
+    if (dst->y_stride < width || dst->uv_stride < width) return -1;
+
+    /* Y：每像素 1 字节；UV：每 2 个像素共享一对 UV（也是 1 字节/像素），行数减半 */
+    copy_plane(dst->y, dst->y_stride,
+               src->y + (size_t)crop_y * src->y_stride + crop_x, src->y_stride,
+               width, height);
+    copy_plane(dst->uv, dst->uv_stride,
+               src->uv + (size_t)(crop_y / 2) * src->uv_stride + crop_x, src->uv_stride,
+               width, height / 2);
+    return 0;
+}
+
+/*
+ * 清零一个平面的填充：前 rows_used 行的行尾（stride - row_bytes），以及 rows_used..rows_total 整行。
+ */
+static void clear_plane(uint8_t *p, unsigned int stride, size_t row_bytes,
+                        unsigned int rows_used, unsigned int rows_total)
+{
+    if (stride > row_bytes) {
+        for (unsigned int r = 0; r < rows_used; r++)
+            zero_row(p + (size_t)r * stride + row_bytes, stride - row_bytes);
+    }
+    if (rows_total > rows_used)
+        zero_row(p + (size_t)rows_used * stride, (size_t)(rows_total - rows_used) * stride);
+}
+
+void nv12_clear_padding(const Nv12Planes *dst, unsigned int width, unsigned int height, unsigned int rows)
+{
+    if (!dst || !dst->y || !dst->uv) return;
+    width  &= ~1u;
+    height &= ~1u;
+    if (rows < height) rows = height;
+    if (dst->y_stride < width || dst->uv_stride < width) return;
+    clear_plane(dst->y, dst->y_stride, width, height, rows);
+    clear_plane(dst->uv, dst->uv_stride, width, height / 2, rows / 2);
+}
+
+int yuyv_to_nv12(const uint8_t *src, unsigned int src_stride, const Nv12Planes *dst,
+                 unsigned int width, unsigned int height)
+{
+    if (!src || !dst || !dst->y || !dst->uv) return -1;
+
+    width  &= ~1u;
+    height &= ~1u;
+    if (width == 0 || height == 0) return -1;
+    if (src_stride < width * 2 || dst->y_stride < width || dst->uv_stride < width) return -1;
+
+    for (unsigned int r = 0; r < height; r += 2) {
+        const uint8_t *s0 = src + (size_t)r * src_stride;
+        uint8_t *y0 = dst->y + (size_t)r * dst->y_stride;
+        yuyv_row_pair(y0, y0 + dst->y_stride, dst->uv + (size_t)(r / 2) * dst->uv_stride,
+                      s0, s0 + src_stride, width);
+    }
+    return 0;
+}
@@ -0,0 +1,68 @@
+// nv12_repack.h
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * NV12 平面描述：Y 与 UV 各自的起始地址与行跨度（字节）。
+ * NV12M（两个 plane）与单平面 NV12（UV 紧跟 Y 之后）都可以用它描述。
+ */
+typedef struct {
+    uint8_t     *y;
+    uint8_t     *uv;
+    unsigned int y_stride;
+    unsigned int uv_stride;
+} Nv12Planes;
+
+/*
+ * 按行把 src 的 (crop_x, crop_y) 起、width x height 的区域拷到 dst，
+ * 一次完成“去掉驱动行填充 + 写成编码器 stride + 裁剪”，不经过中间连续缓冲。
+ *
+ * - crop_x / crop_y / width / height 会向下取偶数（UV 为 2x2 子采样）：奇数宽高时最后一列 / 一行被丢弃，
+ *   调用者应保证宽高为偶数（--size / simulcast 尺寸在配置阶段已拒绝奇数）；
+ * - dst 行尾的 stride 填充区不写，需要时另调 nv12_clear_padding；
+ * - aarch64/NEON 下每行用 64B 向量拷贝，否则退化为逐行 memcpy。
+ *
+ * @return 0 成功；-1 参数非法（stride 小于 width 等）
+ */
+int  nv12_repack(const Nv12Planes *src, const Nv12Planes *dst,
+                 unsigned int width, unsigned int height,
+                 unsigned int crop_x, unsigned int crop_y);
+
+/*
+ * 把 dst 中 width x height（向下取偶）以外的填充区清零：每行 stride 尾部，以及 Y 平面 height..rows 行、
+ * UV 平面 height/2..rows/2 行。编码器输入池的 buffer 反复复用，不清零的话上一帧 / 别的流的残留
+ * 会被编进填充出来的宏块。aarch64/NEON 下用 64B 向量写零，否则 memset。
+ *
+ * @param rows  Y 平面的总行数（编码器 ver_stride，不小于 height）
+ */
+void nv12_clear_padding(const Nv12Planes *dst, unsigned int width, unsigned int height, unsigned int rows);
+
+/*
+ * 打包 YUYV（YUY2，每 2 像素 4 字节 Y0 U Y1 V）转 NV12：Y 原样取出，
+ * UV 取上下两行的平均（4:2:2 -> 4:2:0）。用于只能输出 YUYV 的采集设备（多为 UVC）。
+ *
+ * - width / height 向下取偶数；dst 行尾的 stride 填充区不写；
+ * - aarch64/NEON 下每次解交织 32 像素，否则逐像素处理。
+ *
+ * @param src         YUYV 数据
+ * @param src_stride  YUYV 行跨度（字节，不小于 width * 2）
+ * @return 0 成功；-1 参数非法
+ */
+int  yuyv_to_nv12(const uint8_t *src, unsigned int src_stride, const Nv12Planes *dst,
+                  unsigned int width, unsigned int height);
+
+/* 单行拷贝内核（导出给 benchmark 使用）。 */
+void nv12_copy_row(uint8_t *dst, const uint8_t *src, size_t n);
+
+/* 当前编译使用的内核名（"neon" / "scalar"）。 */
+const char *nv12_repack_impl(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,137 @@
+// src/pcm_convert.c
+#include "pcm_convert.h"
+
+#include <math.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#  include <arm_neon.h>
+#  define PCM_USE_NEON 1
+#else
+#  define PCM_USE_NEON 0
+#endif
+
+static inline int16_t sat16(int32_t v)
+{
+    return (int16_t)(v > 32767 ? 32767 : v < -32768 ? -32768 : v);
+}
+
+/* 舍入右移（与 vqrshrn 一致：加半个单位后算术右移） */
+static inline int32_t rshr(int32_t v, int n)
+{
+    return (v + (1 << (n - 1))) >> n;
+}
+
+int32_t pcm_gain_q12(float db)
+{
+    if (db < -60.0f) db = -60.0f;
+    if (db > 18.0f) db = 18.0f;
+    long g = lrintf(powf(10.0f, db / 20.0f) * (float)PCM_GAIN_UNITY);
+    return g > 32767 ? 32767 : (int32_t)g;
+}
+
+/* 同声道数：乘增益 */
+static void gain_scalar(const int16_t *in, int16_t *out, size_t n, int32_t g)
+{
+    for (size_t i = 0; i < n; i++) out[i] = sat16(rshr(in[i] * g, 12));
+}
+
+/* 下混为单声道：声道求和 / 声道数，再乘增益 */
+static void mono_scalar(const int16_t *in, int16_t *out, size_t frames, unsigned int ch, int32_t g)
+{
+    for (size_t f = 0; f < frames; f++) {
+        int32_t sum = 0;
+        for (unsigned int c = 0; c < ch; c++) sum += in[c];
+        out[f] = sat16((int32_t)(((int64_t)sum * g / (int32_t)ch + 2048) >> 12));
+        in += ch;
+    }
+}
+
+#if PCM_USE_NEON
+
+static void gain_neon(const int16_t *in, int16_t *out, size_t n, int32_t g)
+{
+    int16_t gs = (int16_t)g;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t x = vld1q_s16(in + i);
+        int32x4_t lo = vmull_n_s16(vget_low_s16(x), gs);
+        int32x4_t hi = vmull_n_s16(vget_high_s16(x), gs);
+        vst1q_s16(out + i, vcombine_s16(vqrshrn_n_s32(lo, 12), vqrshrn_n_s32(hi, 12)));
+    }
+    gain_scalar(in + i, out + i, n - i, g);
+}
+
+/* 双声道 -> 单声道：vld2 拆开 L/R，加宽求和后乘增益，右移 13（/2 与 Q12 合并） */
+static void stereo_mono_neon(const int16_t *in, int16_t *out, size_t frames, int32_t g)
+{
+    size_t f = 0;
+    for (; f + 8 <= frames; f += 8) {
+        int16x8x2_t lr = vld2q_s16(in + 2 * f);
+        int32x4_t lo = vaddl_s16(vget_low_s16(lr.val[0]), vget_low_s16(lr.val[1]));
+        int32x4_t hi = vaddl_s16(vget_high_s16(lr.val[0]), vget_high_s16(lr.val[1]));
+        lo = vmulq_n_s32(lo, g);
+        hi = vmulq_n_s32(hi, g);
+        vst1q_s16(out + f, vcombine_s16(vqrshrn_n_s32(lo, 13), vqrshrn_n_s32(hi, 13)));
+    }
+    for (; f < frames; f++) out[f] = sat16(rshr((in[2 * f] + in[2 * f + 1]) * g, 13));
+}
+
+void pcm_s16_to_f32(const int16_t *in, float *out, size_t n)
+{
+    const float k = 1.0f / 32768.0f;
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int16x8_t x = vld1q_s16(in + i);
+        vst1q_f32(out + i,     vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(x))), k));
+        vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(x))), k));
+    }
+    for (; i < n; i++) out[i] = (float)in[i] * k;
+}
+
+const char *pcm_convert_impl(void)
+{
+    return "neon";
+}
+
+#else
+
+static void gain_neon(const int16_t *in, int16_t *out, size_t n, int32_t g)
+{
+    gain_scalar(in, out, n, g);
+}
+
+static void stereo_mono_neon(const int16_t *in, int16_t *out, size_t frames, int32_t g)
+{
+    for (size_t f = 0; f < frames; f++) out[f] = sat16(rshr((in[2 * f] + in[2 * f + 1]) * g, 13));
+}
+
+void pcm_s16_to_f32(const int16_t *in, float *out, size_t n)
+{
+    const float k = 1.0f / 32768.0f;
+    for (size_t i = 0; i < n; i++) out[i] = (float)in[i] * k;
+}
+
+const char *pcm_convert_impl(void)
+{
+    return "scalar";
+}
+
+#endif
+
+int pcm_convert_s16(const int16_t *in, int16_t *out, size_t frames,
+                    unsigned int in_ch, unsigned int out_ch, int32_t gain_q12)
+{
+    if (!in || !out || !in_ch) return -1;
+    if (out_ch == in_ch) {
+        if (gain_q12 == PCM_GAIN_UNITY) {
+            if (out != in) for (size_t i = 0; i < frames * in_ch; i++) out[i] = in[i];
+            return 0;
+        }
+        gain_neon(in, out, frames * in_ch, gain_q12);
+        return 0;
+    }
+    if (out_ch != 1) return -1;
+    if (in_ch == 2) stereo_mono_neon(in, out, frames, gain_q12);
+    else mono_scalar(in, out, frames, in_ch, gain_q12);
+    return 0;
+}
@@ -0,0 +1,38 @@
+// pcm_convert.h
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 音频编码前的 PCM 处理：增益、下混为单声道、S16 -> float。
+ * aarch64/NEON 下每次处理 8 个采样帧（饱和乘加 + 舍入收窄），否则为等价的标量实现。
+ */
+
+#define PCM_GAIN_UNITY 4096   // 增益为 Q12 定点数：4096 = 0dB
+
+/* dB -> Q12 增益，限制在 -60dB .. +18dB（Q12 的 int16 范围） */
+int32_t pcm_gain_q12(float db);
+
+/*
+ * 交织 S16：out_ch == in_ch 时只乘增益；out_ch == 1 时各声道取平均后乘增益（双声道走向量路径）。
+ * 结果饱和到 int16。out 可以与 in 相同（原地处理）。
+ *
+ * @return 0 成功；-1 声道组合不支持
+ */
+int  pcm_convert_s16(const int16_t *in, int16_t *out, size_t frames,
+                     unsigned int in_ch, unsigned int out_ch, int32_t gain_q12);
+
+/* S16 -> float（[-1, 1)），n 为采样数（不是帧数） */
+void pcm_s16_to_f32(const int16_t *in, float *out, size_t n);
+
+/* 当前编译使用的内核名（"neon" / "scalar"） */
+const char *pcm_convert_impl(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,61 @@
+// pcm_ring.c
+#include "pcm_ring.h"
+#include "mem_arena.h"
+
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+int pcm_ring_init(PcmRing *r, unsigned int slots, size_t slot_bytes)
+{
+    if (!r || !slots || !slot_bytes) return -1;
+    memset(r, 0, sizeof(*r));
+    r->efd = -1;
+
+    unsigned int cap = 1;
+    while (cap < slots) cap <<= 1;
+    r->mask       = cap - 1;
+    r->slot_bytes = slot_bytes;
+    atomic_store_explicit(&r->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&r->tail, 0, memory_order_relaxed);
+
+    r->data  = (uint8_t *)mem_arena_alloc(MEM_STAGE_AUDIO, (size_t)cap * slot_bytes, 0);
+    r->slots = (PcmRingSlot *)mem_arena_alloc(MEM_STAGE_AUDIO, cap * sizeof(*r->slots), 0);
+    r->efd   = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (!r->data || !r->slots || r->efd < 0) {
+        pcm_ring_free(r);
+        return -1;
+    }
+    return 0;
+}
+
+void pcm_ring_free(PcmRing *r)
+{
+    if (!r) return;
+    mem_arena_free(r->data);
+    mem_arena_free(r->slots);
+    if (r->efd >= 0) close(r->efd);
+    r->data  = NULL;
+    r->slots = NULL;
+    r->efd   = -1;
+}
+
+void pcm_ring_commit(PcmRing *r, uint32_t bytes, int64_t pts_us)
+{
+    unsigned int h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    PcmRingSlot *s = &r->slots[h & r->mask];
+    s->bytes  = bytes;
+    s->pts_us = pts_us;
+    atomic_store_explicit(&r->head, h + 1, memory_order_release);
+
+    uint64_t one = 1;
+    ssize_t n = write(r->efd, &one, sizeof(one));
+    (void)n;
+}
+
+void pcm_ring_clear(PcmRing *r)
+{
+    uint64_t v;
+    ssize_t n = read(r->efd, &v, sizeof(v));
+    (void)n;
+}
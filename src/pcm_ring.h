@@ -0,0 +1,93 @@
+// pcm_ring.h
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * PCM period 的单生产者/单消费者无锁环：采集线程把一个 period 直接拷进槽位，
+ * 写出线程就地读出送给 sink，中间不再拷贝。
+ *
+ * - 槽位数为 2 的幂，每个槽位固定 slot_bytes，open 时一次分配；
+ * - 生产者：write_ptr 取空槽 -> 填数据 -> commit；环满时 write_ptr 返回 NULL，由调用者决定丢弃；
+ * - 消费者：read_ptr 取最老的槽 -> 使用 -> release；槽在 release 之前不会被覆盖；
+ * - 内存序同 spsc_ring.h：commit 用 release 发布，read_ptr 用 acquire 读取；
+ * - 每次 commit 写一次 eventfd，消费者可与其他 fd 一起 poll；取空后调用 pcm_ring_clear 再重查一次。
+ */
+typedef struct {
+    int64_t  pts_us;
+    uint32_t bytes;
+} PcmRingSlot;
+
+typedef struct {
+    _Alignas(64) atomic_uint head;   // 生产者提交计数
+    _Alignas(64) atomic_uint tail;   // 消费者释放计数
+    unsigned int mask;
+    size_t       slot_bytes;
+    uint8_t     *data;               // 槽位数据，slots × slot_bytes
+    PcmRingSlot *slots;
+    int          efd;                // eventfd：有新数据
+} PcmRing;
+
+/*
+ * 分配槽位并创建 eventfd。slots 向上取整为 2 的幂。
+ *
+ * @return  0 成功；-1 失败
+ */
+int  pcm_ring_init(PcmRing *r, unsigned int slots, size_t slot_bytes);
+void pcm_ring_free(PcmRing *r);
+
+/* 生产者：提交写好的槽位并通知消费者 */
+void pcm_ring_commit(PcmRing *r, uint32_t bytes, int64_t pts_us);
+/* 消费者：清掉 eventfd 的计数（环为空、准备 poll 之前调用） */
+void pcm_ring_clear(PcmRing *r);
+
+static inline unsigned int pcm_ring_capacity(const PcmRing *r)
+{
+    return r->mask + 1;
+}
+
+/* 当前已提交未释放的槽位数（任意线程可调用，结果为近似快照） */
+static inline unsigned int pcm_ring_depth(PcmRing *r)
+{
+    unsigned int h = atomic_load_explicit(&r->head, memory_order_acquire);
+    unsigned int t = atomic_load_explicit(&r->tail, memory_order_acquire);
+    return h - t;
+}
+
+/* 生产者：下一个空槽。@return 槽位数据（slot_bytes 字节）；环满返回 NULL */
+static inline uint8_t *pcm_ring_write_ptr(PcmRing *r)
+{
+    unsigned int h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    unsigned int t = atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (h - t > r->mask) return NULL;
+    return r->data + (size_t)(h & r->mask) * r->slot_bytes;
+}
+
+/* 消费者：最老的已提交槽位。@return 数据指针；环空返回 NULL */
+static inline const uint8_t *pcm_ring_read_ptr(PcmRing *r, uint32_t *bytes, int64_t *pts_us)
+{
+    unsigned int t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    unsigned int h = atomic_load_explicit(&r->head, memory_order_acquire);
+    if (h == t) return NULL;
+    const PcmRingSlot *s = &r->slots[t & r->mask];
+    if (bytes) *bytes = s->bytes;
+    if (pts_us) *pts_us = s->pts_us;
+    return r->data + (size_t)(t & r->mask) * r->slot_bytes;
+}
+
+/* 消费者：释放 read_ptr 取到的槽位 */
+static inline void pcm_ring_release(PcmRing *r)
+{
+    unsigned int t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    atomic_store_explicit(&r->tail, t + 1, memory_order_release);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,104 @@
+// src/reactor.c
+#include "reactor.h"
+#include "log.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#define TAG "reactor"
+
+/*
+ * 初始化：创建 stop eventfd。
+ *
+ * @param r      reactor 实例
+ * @param stats  统计对象（可为 NULL）
+ * @return       0 成功；-1 失败
+ */
+int reactor_init(Reactor *r, AvStats *stats)
+{
+    if (!r) return -1;
+    r->stats   = stats;
+    r->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (r->stop_fd < 0) {
+        LOGE("[%s] eventfd failed: %s", TAG, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+void reactor_close(Reactor *r)
+{
+    if (!r) return;
+    if (r->stop_fd >= 0) {
+        close(r->stop_fd);
+        r->stop_fd = -1;
+    }
+}
+
+/*
+ * 通知停止：向 eventfd 写入 1。
+ * 之后从不读取，eventfd 保持可读，所有 poll 它的线程都会立即返回。
+ */
+void reactor_signal_stop(Reactor *r)
+{
+    if (!r || r->stop_fd < 0) return;
+    uint64_t one = 1;
+    ssize_t n = write(r->stop_fd, &one, sizeof(one));
+    (void)n;
+}
+
+void reactor_reset(Reactor *r)
+{
+    if (!r || r->stop_fd < 0) return;
+    uint64_t v;
+    ssize_t n = read(r->stop_fd, &v, sizeof(v));   // 非阻塞：未通知时返回 EAGAIN
+    (void)n;
+}
+
+int reactor_stopped(Reactor *r)
+{
+    if (!r || r->stop_fd < 0) return 0;
+    struct pollfd p = { .fd = r->stop_fd, .events = POLLIN };
+    return poll(&p, 1, 0) > 0;
+}
+
+int reactor_wait(Reactor *r, struct pollfd *fds, int nfds, int timeout_ms)
+{
+    if (!r || nfds < 0 || nfds > REACTOR_MAX_FDS) return -1;
+
+    /* 调用者的 fd 在前，stop eventfd 放最后 */
+    struct pollfd set[REACTOR_MAX_FDS + 1];
+    for (int i = 0; i < nfds; i++) {
+        set[i] = fds[i];
+        set[i].revents = 0;
+    }
+    set[nfds].fd      = r->stop_fd;
+    set[nfds].events  = POLLIN;
+    set[nfds].revents = 0;
+
+    int n;
+    do {
+        n = poll(set, (nfds_t)(nfds + 1), timeout_ms);
+    } while (n < 0 && errno == EINTR && !(set[nfds].revents & POLLIN) && !reactor_stopped(r));
+
+    if (r->stats) av_stats_inc_wakeup(r->stats);
+
+    if (n < 0) {
+        if (errno == EINTR) return -1;   // 信号打断且已 stop
+        LOGE("[%s] poll failed: %s", TAG, strerror(errno));
+        return -1;
+    }
+    if (set[nfds].revents & POLLIN) return -1;
+
+    for (int i = 0; i < nfds; i++) fds[i].revents = set[i].revents;
+    return n;
+}
+
+int reactor_wait_fd(Reactor *r, int fd, short events, int timeout_ms)
+{
+    struct pollfd p = { .fd = fd, .events = events, .revents = 0 };
+    return reactor_wait(r, &p, 1, timeout_ms);
+}
@@ -0,0 +1,56 @@
+// reactor.h
+#pragma once
+
+#include <poll.h>
+
+#include "av_stats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 事件等待（per-thread poll + 共享 stop eventfd）。
+ *
+ * 各采集线程不再用 1ms nanosleep 轮询，而是 poll 自己的 fd（V4L2 / ALSA poll descriptors），
+ * 同时把同一个 stop eventfd 加入等待集合：
+ * - 有数据才唤醒，空闲时不产生多余 wakeup；
+ * - reactor_signal_stop() 之后所有等待者立即返回（eventfd 一直保持可读）。
+ */
+#define REACTOR_MAX_FDS 8
+
+typedef struct {
+    int      stop_fd;   // eventfd，写入后保持可读，作为全局停止通知
+    AvStats *stats;     // 可为 NULL；非 NULL 时统计 wakeups
+} Reactor;
+
+int  reactor_init(Reactor *r, AvStats *stats);
+void reactor_close(Reactor *r);
+
+/* 通知所有等待者退出。只调用 write()，可以在信号处理函数里使用。 */
+void reactor_signal_stop(Reactor *r);
+
+/*
+ * 清除 stop 通知，reactor 可以再次使用（通道重启时）。
+ * 调用时不能有线程在等待它；与 reactor_signal_stop 并发时 stop 可能被清掉，调用者需自行重查停止标志。
+ */
+void reactor_reset(Reactor *r);
+
+/* stop 是否已被通知（非阻塞检查）。 */
+int  reactor_stopped(Reactor *r);
+
+/*
+ * 等待 fds 中任意一个就绪（nfds 可以为 0，此时只等 stop 或超时）。
+ * fds[i].revents 会被填充。
+ *
+ * @param timeout_ms  -1 表示无限等待
+ * @return            >0 有 fd 就绪；0 超时；-1 已 stop 或出错
+ */
+int  reactor_wait(Reactor *r, struct pollfd *fds, int nfds, int timeout_ms);
+
+/* 单 fd 版本的 reactor_wait。 */
+int  reactor_wait_fd(Reactor *r, int fd, short events, int timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
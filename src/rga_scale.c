@@ -0,0 +1,135 @@
+// rga_scale.c
+#include "rga_scale.h"
+#include "log.h"
+
+#include <string.h>
+
+#if defined(RK_RGA_ENABLE) && RK_RGA_ENABLE && defined(__has_include)
+#  if __has_include(<rga/im2d.h>)
+#    include <rga/im2d.h>
+#    include <rga/rga.h>
+#    define RK_RGA_AVAILABLE 1
+#  endif
+#endif
+#ifndef RK_RGA_AVAILABLE
+#  define RK_RGA_AVAILABLE 0
+#endif
+
+#define TAG "rga"
+
+int rga_scale_hw_available(void)
+{
+    return RK_RGA_AVAILABLE;
+}
+
+void rga_scaler_init(RgaScaler *s)
+{
+    if (!s) return;
+    memset(s, 0, sizeof(*s));
+    s->hw = RK_RGA_AVAILABLE;
+    if (!s->hw) LOGW("[%s] built without librga, scaling on CPU (nearest)", TAG);
+}
+
+const char *rga_scaler_impl(const RgaScaler *s)
+{
+    return (s && s->hw && !s->hw_failed) ? "rga" : "cpu";
+}
+
+/* ===================== CPU fallback ===================== */
+/*
+ * 最近邻缩放，16.16 定点步进。画质只够预览/调试，simulcast 正式使用应带 RGA 构建。
+ */
+static int cpu_scale_nv12(const RgaImage *src, const RgaImage *dst)
+{
+    const Nv12Planes *sp = &src->planes;
+    const Nv12Planes *dp = &dst->planes;
+    if (!sp->y || !sp->uv || !dp->y || !dp->uv) return -1;
+
+    uint32_t dx = (uint32_t)(((uint64_t)src->width  << 16) / dst->width);
+    uint32_t dy = (uint32_t)(((uint64_t)src->height << 16) / dst->height);
+
+    for (unsigned int r = 0; r < dst->height; r++) {
+        const uint8_t *srow = sp->y + (size_t)((r * (uint64_t)dy) >> 16) * sp->y_stride;
+        uint8_t *drow = dp->y + (size_t)r * dp->y_stride;
+        uint32_t fx = 0;
+        for (unsigned int x = 0; x < dst->width; x++, fx += dx)
+            drow[x] = srow[fx >> 16];
+    }
+
+    /* UV 交错：按色度样点（2 字节一组）取最近邻 */
+    for (unsigned int r = 0; r < dst->height / 2; r++) {
+        const uint8_t *srow = sp->uv + (size_t)((r * (uint64_t)dy) >> 16) * sp->uv_stride;
+        uint8_t *drow = dp->uv + (size_t)r * dp->uv_stride;
+        uint32_t fx = 0;
+        for (unsigned int x = 0; x < dst->width / 2; x++, fx += dx) {
+            const uint8_t *c = srow + (fx >> 16) * 2;
+            drow[2 * x]     = c[0];
+            drow[2 * x + 1] = c[1];
+        }
+    }
+    return 0;
+}
+
+/* ===================== RGA ===================== */
+#if RK_RGA_AVAILABLE
+
+/*
+ * 组 RGA buffer：优先 fd；否则要求 Y/UV 连续（单块虚拟地址），NV12M 这类分离平面交给 CPU。
+ * @return 0 成功；-1 RGA 无法描述该布局
+ */
+static int wrap_image(const RgaImage *img, rga_buffer_t *out)
+{
+    const Nv12Planes *p = &img->planes;
+    int wstride = (int)p->y_stride;
+    int hstride = (int)img->hstride;
+    if (img->fd >= 0) {
+        *out = wrapbuffer_fd_t(img->fd, (int)img->width, (int)img->height, wstride, hstride,
+                               RK_FORMAT_YCbCr_420_SP);
+        return 0;
+    }
+    if (p->y && p->uv == p->y + (size_t)p->y_stride * img->hstride && p->uv_stride == p->y_stride) {
+        *out = wrapbuffer_virtualaddr_t(p->y, (int)img->width, (int)img->height, wstride, hstride,
+                                        RK_FORMAT_YCbCr_420_SP);
+        return 0;
+    }
+    return -1;
+}
+
+static int hw_scale_nv12(RgaScaler *s, const RgaImage *src, const RgaImage *dst)
+{
+    rga_buffer_t sb, db;
+    if (wrap_image(src, &sb) != 0 || wrap_image(dst, &db) != 0) return 1;
+
+    IM_STATUS ret = imresize(sb, db);
+    if (ret != IM_STATUS_SUCCESS && ret != IM_STATUS_NOERROR) {
+        LOGW("[%s] imresize %ux%u -> %ux%u failed: %s, fallback to CPU", TAG,
+             src->width, src->height, dst->width, dst->height, imStrError(ret));
+        s->hw_failed = 1;
+        return 1;
+    }
+    return 0;
+}
+
+#endif
+
+/*
+ * 缩放一帧：RGA 可用且布局可描述时走硬件，否则 CPU。
+ * RGA 失败一次后不再尝试（避免每帧都打一遍失败的 ioctl）。
+ */
+int rga_scale_nv12(RgaScaler *s, const RgaImage *src, const RgaImage *dst)
+{
+    if (!s || !src || !dst) return -1;
+    if (src->width < 2 || src->height < 2 || dst->width < 2 || dst->height < 2) return -1;
+
+#if RK_RGA_AVAILABLE
+    if (s->hw && !s->hw_failed) {
+        if (hw_scale_nv12(s, src, dst) == 0) {
+            s->frames_hw++;
+            return 0;
+        }
+    }
+#endif
+    if (cpu_scale_nv12(src, dst) != 0) return -1;
+    s->frames_cpu++;
+    return 0;
+}
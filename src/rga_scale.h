@@ -0,0 +1,51 @@
+// rga_scale.h
+#pragma once
+
+#include <stdint.h>
+
+#include "nv12_repack.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * NV12 缩放：有 librga（make RGA=1）时交给 RGA 2D 硬件，源与目的都可以直接是 DMABUF，
+ * CPU 不碰像素；没有 librga、或某一帧的布局 RGA 不支持 / 调用失败时，退回 CPU 最近邻缩放。
+ *
+ * 用于 simulcast：一路采集缩放进各子码流编码器的输入池 buffer。
+ */
+
+/* 一幅 NV12 图像 */
+typedef struct {
+    int          fd;        // DMABUF fd；-1=没有（只能用 planes 地址）
+    Nv12Planes   planes;    // CPU 地址（CPU 路径，或无 fd 时给 RGA 的虚拟地址）
+    unsigned int width;
+    unsigned int height;
+    unsigned int hstride;   // 行跨度（行数）：UV 平面起始于 y + y_stride * hstride
+} RgaImage;
+
+typedef struct {
+    int      hw;            // 1=本次构建带 RGA
+    int      hw_failed;     // RGA 调用失败过，之后一直走 CPU
+    uint64_t frames_hw;
+    uint64_t frames_cpu;
+} RgaScaler;
+
+/* 本次构建是否带 RGA（决定采集侧是否需要导出 DMABUF 供 RGA 直接读取） */
+int  rga_scale_hw_available(void);
+
+void rga_scaler_init(RgaScaler *s);
+
+/*
+ * 把 src 缩放到 dst（尺寸取各自 width/height，宽高需为偶数）。
+ * @return  0 成功；-1 失败
+ */
+int  rga_scale_nv12(RgaScaler *s, const RgaImage *src, const RgaImage *dst);
+
+/* 当前实际使用的实现："rga" / "cpu" */
+const char *rga_scaler_impl(const RgaScaler *s);
+
+#ifdef __cplusplus
+}
+#endif
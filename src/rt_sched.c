@@ -0,0 +1,297 @@
+// rt_sched.c
+#include "rt_sched.h"
+#include "log.h"
+
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TAG "rt"
+
+static RtProfile g_profile;   // rt_sched_setup 之后只读
+
+/* 按角色累计已退出线程的 CPU 时间：rt_sched_apply 登记角色，线程退出时由 key 的析构函数加上本线程的总量 */
+static pthread_key_t    g_cpu_key;
+static pthread_once_t   g_cpu_once = PTHREAD_ONCE_INIT;
+static atomic_ullong    g_role_cpu_us[RT_ROLE_COUNT];
+
+static const char *const k_role_names[RT_ROLE_COUNT] = {
+    [RT_ROLE_CAPTURE] = "capture",
+    [RT_ROLE_ENCODE]  = "encode",
+    [RT_ROLE_SINK]    = "sink",
+    [RT_ROLE_AUDIO]   = "audio",
+    [RT_ROLE_STATS]   = "stats",
+};
+
+void rt_profile_default(RtProfile *p)
+{
+    if (!p) return;
+    memset(p, 0, sizeof(*p));
+    p->stack_kb = RT_STACK_KB_DEFAULT;
+}
+
+const char *rt_role_name(RtRole role)
+{
+    return ((unsigned int)role < RT_ROLE_COUNT) ? k_role_names[role] : "?";
+}
+
+int rt_role_from_name(const char *name, RtRole *role)
+{
+    if (!name || !role) return -1;
+    for (int i = 0; i < RT_ROLE_COUNT; i++) {
+        if (strcmp(name, k_role_names[i]) == 0) {
+            *role = (RtRole)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/* "2" / "2-3" / "0+2-3" -> 位图。@return 0 成功；-1 格式错误 */
+static int parse_cpu_list(const char *s, uint64_t *mask)
+{
+    uint64_t m = 0;
+    while (*s) {
+        char *end;
+        long a = strtol(s, &end, 10);
+        if (end == s || a < 0 || a > 63) return -1;
+        long b = a;
+        if (*end == '-') {
+            s = end + 1;
+            b = strtol(s, &end, 10);
+            if (end == s || b < a || b > 63) return -1;
+        }
+        for (long c = a; c <= b; c++) m |= 1ull << c;
+        if (*end == '+') end++;
+        else if (*end) return -1;
+        s = end;
+    }
+    if (!m) return -1;
+    *mask = m;
+    return 0;
+}
+
+/*
+ * 逐项解析 "role=value,..."，value 交给 fn。
+ * @return 0 成功；-1 格式错误
+ */
+static int parse_role_list(RtProfile *p, const char *spec, int (*fn)(RtThreadOpts *o, const char *v))
+{
+    if (!p || !spec) return -1;
+    char buf[256];
+    if (strlen(spec) >= sizeof(buf)) return -1;
+    strcpy(buf, spec);
+
+    char *save = NULL;
+    for (char *tok = strtok_r(buf, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        char *eq = strchr(tok, '=');
+        if (!eq) return -1;
+        *eq = 0;
+        RtRole role;
+        if (rt_role_from_name(tok, &role) != 0) return -1;
+        if (fn(&p->role[role], eq + 1) != 0) return -1;
+    }
+    return 0;
+}
+
+static int set_prio(RtThreadOpts *o, const char *v)
+{
+    char *end;
+    long prio = strtol(v, &end, 10);
+    if (end == v || *end || prio < 0 || prio > 99) return -1;
+    o->prio = (int)prio;
+    return 0;
+}
+
+static int set_cpus(RtThreadOpts *o, const char *v)
+{
+    return parse_cpu_list(v, &o->cpus);
+}
+
+int rt_profile_parse_prio(RtProfile *p, const char *spec)
+{
+    return parse_role_list(p, spec, set_prio);
+}
+
+int rt_profile_parse_cpus(RtProfile *p, const char *spec)
+{
+    return parse_role_list(p, spec, set_cpus);
+}
+
+int rt_profile_enabled(const RtProfile *p)
+{
+    if (!p) return 0;
+    if (p->mlock) return 1;
+    for (int i = 0; i < RT_ROLE_COUNT; i++) {
+        if (p->role[i].prio || p->role[i].cpus) return 1;
+    }
+    return 0;
+}
+
+/* 位图 -> "0,2-3" */
+static const char *format_cpus(const cpu_set_t *set, char *buf, size_t cap)
+{
+    size_t n = 0;
+    buf[0] = 0;
+    for (int c = 0; c < CPU_SETSIZE && n + 12 < cap; c++) {
+        if (!CPU_ISSET(c, set)) continue;
+        int e = c;
+        while (e + 1 < CPU_SETSIZE && CPU_ISSET(e + 1, set)) e++;
+        n += (size_t)snprintf(buf + n, cap - n, e > c ? "%s%d-%d" : "%s%d", n ? "," : "", c, e);
+        c = e;
+    }
+    return buf;
+}
+
+int rt_sched_setup(const RtProfile *p)
+{
+    if (!p) return -1;
+    g_profile = *p;
+    if (!g_profile.stack_kb) g_profile.stack_kb = RT_STACK_KB_DEFAULT;
+
+    long ncpu = sysconf(_SC_NPROCESSORS_CONF);
+    int ret = 0;
+    for (int i = 0; i < RT_ROLE_COUNT; i++) {
+        const RtThreadOpts *o = &g_profile.role[i];
+        if (o->cpus && ncpu > 0 && ncpu < 64 && (o->cpus >> ncpu)) {
+            LOGW("[%s] %s: cpus beyond the %ld configured CPUs are ignored", TAG, k_role_names[i], ncpu);
+        }
+    }
+    if (!g_profile.mlock) return 0;
+
+    /* 释放的内存留在堆里，大块分配也走堆：之后的分配复用已锁定的页，不再缺页 */
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+
+    pthread_attr_t attr;
+    if (pthread_attr_init(&attr) == 0) {
+        if (pthread_attr_setstacksize(&attr, (size_t)g_profile.stack_kb << 10) != 0 ||
+            pthread_setattr_default_np(&attr) != 0) {
+            LOGW("[%s] cannot set default thread stack to %uKB", TAG, g_profile.stack_kb);
+        }
+        pthread_attr_destroy(&attr);
+    }
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        struct rlimit rl;
+        getrlimit(RLIMIT_MEMLOCK, &rl);
+        LOGW("[%s] mlockall failed: %s (RLIMIT_MEMLOCK=%lluKB), memory not locked", TAG, strerror(errno),
+             rl.rlim_cur == RLIM_INFINITY ? 0ull : (unsigned long long)(rl.rlim_cur >> 10));
+        ret = -1;
+    } else {
+        LOGI("[%s] mlockall ok, thread stack=%uKB, malloc trim/mmap off", TAG, g_profile.stack_kb);
+    }
+    return ret;
+}
+
+/* 线程退出时调用（value = 角色 + 1） */
+static void cpu_account_exit(void *value)
+{
+    unsigned int role = (unsigned int)((uintptr_t)value - 1);
+    struct timespec ts;
+    if (role >= RT_ROLE_COUNT || clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return;
+    atomic_fetch_add(&g_role_cpu_us[role], (unsigned long long)ts.tv_sec * 1000000ull +
+                                           (unsigned long long)ts.tv_nsec / 1000ull);
+}
+
+static void cpu_key_create(void)
+{
+    if (pthread_key_create(&g_cpu_key, cpu_account_exit) != 0) LOGW("[%s] cpu accounting unavailable", TAG);
+}
+
+void rt_sched_cpu_usage(uint64_t cpu_us[RT_ROLE_COUNT])
+{
+    for (int i = 0; i < RT_ROLE_COUNT; i++) cpu_us[i] = atomic_load(&g_role_cpu_us[i]);
+}
+
+void rt_sched_apply(RtRole role, const char *name)
+{
+    char tname[16];
+    snprintf(tname, sizeof(tname), "%s", name ? name : rt_role_name(role));
+    pthread_setname_np(pthread_self(), tname);
+
+    if ((unsigned int)role >= RT_ROLE_COUNT) return;
+    pthread_once(&g_cpu_once, cpu_key_create);
+    pthread_setspecific(g_cpu_key, (void *)(uintptr_t)(role + 1));
+    const RtThreadOpts *o = &g_profile.role[role];
+    if (!o->prio && !o->cpus) return;
+
+    char err[96] = "";
+    if (o->cpus) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int c = 0; c < 64; c++) {
+            if (o->cpus & (1ull << c)) CPU_SET(c, &set);
+        }
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (rc != 0) snprintf(err, sizeof(err), " affinity: %s", strerror(rc));
+    }
+    if (o->prio) {
+        struct sched_param sp = { .sched_priority = o->prio };
+        int lo = sched_get_priority_min(SCHED_FIFO), hi = sched_get_priority_max(SCHED_FIFO);
+        if (sp.sched_priority < lo) sp.sched_priority = lo;
+        if (sp.sched_priority > hi) sp.sched_priority = hi;
+        int rc = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+        if (rc != 0) {
+            size_t n = strlen(err);
+            snprintf(err + n, sizeof(err) - n, " SCHED_FIFO %d: %s", sp.sched_priority, strerror(rc));
+        }
+    }
+
+    /* 回读实际生效的值 */
+    int policy = SCHED_OTHER;
+    struct sched_param cur = { 0 };
+    pthread_getschedparam(pthread_self(), &policy, &cur);
+    cpu_set_t now;
+    CPU_ZERO(&now);
+    char cpus[64] = "?";
+    if (pthread_getaffinity_np(pthread_self(), sizeof(now), &now) == 0) format_cpus(&now, cpus, sizeof(cpus));
+
+    if (err[0])
+        LOGW("[%s] %s (%s) tid=%ld: policy=%s prio=%d cpus=%s; failed:%s", TAG, tname, rt_role_name(role),
+             (long)syscall(SYS_gettid), policy == SCHED_FIFO ? "fifo" : "other", cur.sched_priority, cpus, err);
+    else
+        LOGI("[%s] %s (%s) tid=%ld: policy=%s prio=%d cpus=%s", TAG, tname, rt_role_name(role),
+             (long)syscall(SYS_gettid), policy == SCHED_FIFO ? "fifo" : "other", cur.sched_priority, cpus);
+}
+
+/* /proc/self/status 中的一项（KB），取不到返回 -1 */
+static long proc_status_kb(const char *key)
+{
+    FILE *fp = fopen("/proc/self/status", "r");
+    if (!fp) return -1;
+    char line[128];
+    size_t klen = strlen(key);
+    long v = -1;
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, key, klen) == 0 && line[klen] == ':') {
+            v = strtol(line + klen + 1, NULL, 10);
+            break;
+        }
+    }
+    fclose(fp);
+    return v;
+}
+
+void rt_sched_report(const char *when)
+{
+    static long last_min = 0, last_maj = 0;   // 只由主线程调用
+    if (!rt_profile_enabled(&g_profile)) return;
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    LOGI("[%s] %s: mlock=%s VmLck=%ldKB VmRSS=%ldKB minflt=%ld(+%ld) majflt=%ld(+%ld)", TAG,
+         when ? when : "report", g_profile.mlock ? "on" : "off", proc_status_kb("VmLck"),
+         proc_status_kb("VmRSS"), ru.ru_minflt, ru.ru_minflt - last_min, ru.ru_majflt, ru.ru_majflt - last_maj);
+    last_min = ru.ru_minflt;
+    last_maj = ru.ru_majflt;
+}
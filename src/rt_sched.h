@@ -0,0 +1,94 @@
+// rt_sched.h
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 线程实时调度与内存锁定。
+ *
+ * - 每个线程按角色（采集 / 编码 / 写出 / 音频 / 统计）取 SCHED_FIFO 优先级和 CPU 亲和性，
+ *   由线程入口自己调用 rt_sched_apply 设置（模块内部创建的线程不需要传 pthread_attr），并回读实际生效的值打印；
+ * - 没有权限（非 root、无 CAP_SYS_NICE / RLIMIT_RTPRIO）时告警并保持 SCHED_OTHER，不影响运行；
+ * - mlock：启动时关掉 malloc 的 trim / mmap（释放的内存不还给内核，再次使用不缺页），
+ *   mlockall(MCL_CURRENT | MCL_FUTURE) 让之后分配的缓冲和线程栈在映射时就全部缺页并锁定，
+ *   同时把默认线程栈缩小到 stack_kb，避免每个线程锁住 8MB。
+ *
+ * profile 在创建任何工作线程之前由 rt_sched_setup 设置一次，之后只读。
+ */
+
+typedef enum {
+    RT_ROLE_CAPTURE = 0,   // 视频采集
+    RT_ROLE_ENCODE,        // 编码提交 / 取包
+    RT_ROLE_SINK,          // 写出（含异步写盘 / 推流 / 事件录像的后台线程）
+    RT_ROLE_AUDIO,         // 音频采集与写出
+    RT_ROLE_STATS,         // 统计 / 定时 / 控制
+    RT_ROLE_COUNT
+} RtRole;
+
+#define RT_STACK_KB_DEFAULT 512
+
+typedef struct {
+    int      prio;         // 0 = SCHED_OTHER；1..99 = SCHED_FIFO 优先级
+    uint64_t cpus;         // CPU 位图（bit n = CPU n），0 = 不绑定
+} RtThreadOpts;
+
+typedef struct {
+    RtThreadOpts role[RT_ROLE_COUNT];
+    int          mlock;     // 1 = mlockall 并预先缺页
+    unsigned int stack_kb;  // mlock 时的默认线程栈大小
+} RtProfile;
+
+void        rt_profile_default(RtProfile *p);
+const char *rt_role_name(RtRole role);
+/* "capture" / "encode" / "sink" / "audio" / "stats" -> RtRole。@return 0 成功；-1 未知 */
+int         rt_role_from_name(const char *name, RtRole *role);
+
+/*
+ * 解析 "capture=80,encode=70,audio=85"（优先级 0..99，0 = SCHED_OTHER）。
+ * @return 0 成功；-1 格式错误
+ */
+int  rt_profile_parse_prio(RtProfile *p, const char *spec);
+/*
+ * 解析 "capture=2,encode=2-3,stats=0"（CPU 列表，逗号分隔的项用 '+' 连接，如 "sink=0+1"）。
+ * @return 0 成功；-1 格式错误
+ */
+int  rt_profile_parse_cpus(RtProfile *p, const char *spec);
+
+/* 是否设置了任何调度 / 亲和性 / mlock */
+int  rt_profile_enabled(const RtProfile *p);
+
+/*
+ * 保存 profile 并做进程级设置（mlock）。失败只告警。
+ *
+ * @return 0 全部生效；-1 有设置未生效
+ */
+int  rt_sched_setup(const RtProfile *p);
+
+/*
+ * 线程入口调用：设置线程名，按角色设置调度策略与亲和性并打印实际结果（该角色未配置时只设置线程名）。
+ * 同时登记线程的角色，线程退出时它的 CPU 时间计入 rt_sched_cpu_usage。
+ *
+ * @param name  线程名（最多 15 字符，超出截断）
+ */
+void rt_sched_apply(RtRole role, const char *name);
+
+/*
+ * 各角色已退出线程的累计 CPU 时间（用户态 + 内核态，微秒）。还在运行的线程不计入：
+ * 要得到一次运行的分阶段 CPU，在启动前和 join 之后各取一次相减（见 bench/enc_matrix.c）。
+ */
+void rt_sched_cpu_usage(uint64_t cpu_us[RT_ROLE_COUNT]);
+
+/*
+ * 打印锁定内存与缺页计数，以及距上一次调用新增的缺页（启动完成时与退出时各调用一次，
+ * 第二次的增量就是运行期间的缺页，用来确认 mlock 的效果）。未配置任何设置时不打印。
+ */
+void rt_sched_report(const char *when);
+
+#ifdef __cplusplus
+}
+#endif
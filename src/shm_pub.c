@@ -0,0 +1,759 @@
+// shm_pub.c
+#include "shm_pub.h"
+#include "log.h"
+#include "media_clock.h"
+#include "rt_sched.h"
+#include "v4l2_capture.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+
+/* 原始帧槽：有 dma-heap 时分配 DMABUF（读者可以直接交给 NPU / RGA），否则用 memfd */
+#if __has_include(<linux/dma-heap.h>)
+#  include <linux/dma-heap.h>
+#  define SHM_HAVE_DMA_HEAP 1
+#else
+#  define SHM_HAVE_DMA_HEAP 0
+#endif
+#if __has_include(<linux/dma-buf.h>)
+#  include <linux/dma-buf.h>
+#  define SHM_HAVE_DMABUF_SYNC 1
+#else
+#  define SHM_HAVE_DMABUF_SYNC 0
+#endif
+
+#define TAG "shm_pub"
+
+#define SHM_RING_MIN     (64u * 1024u)
+#define SHM_POLL_MS      1000
+
+static size_t rec_size(size_t len)
+{
+    return (sizeof(ShmPubRecord) + len + 7) & ~(size_t)7;
+}
+
+static void futex_wake_all(_Atomic uint32_t *addr)
+{
+    syscall(SYS_futex, (uint32_t *)addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+/* DMABUF 槽：CPU 访问前后同步 cache；memfd 槽什么都不做 */
+static void slot_sync(int fd, int dmabuf, int begin, int write)
+{
+#if SHM_HAVE_DMABUF_SYNC
+    if (!dmabuf || fd < 0) return;
+    struct dma_buf_sync sync = {
+        .flags = (begin ? DMA_BUF_SYNC_START : DMA_BUF_SYNC_END) | (write ? DMA_BUF_SYNC_WRITE : DMA_BUF_SYNC_READ),
+    };
+    while (ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync) < 0 && errno == EINTR) {
+    }
+#else
+    (void)fd;
+    (void)dmabuf;
+    (void)begin;
+    (void)write;
+#endif
+}
+
+/* 写者：计数器加一，有读者睡着时才进内核。与读者 shm_sub_wait 的“先登记 waiters 再看 notify”配对（均为 seq_cst） */
+static void pub_notify(ShmPub *p)
+{
+    atomic_fetch_add(&p->hdr->notify, 1);
+    if (atomic_load(&p->hdr->waiters)) futex_wake_all(&p->hdr->notify);
+}
+
+/* ===================== Publisher: setup ===================== */
+
+/* 原始帧槽：dma-heap 打不开时整体退回 memfd。@return 0 成功；-1 失败 */
+static int pub_alloc_raw(ShmPub *p)
+{
+    ShmPubHeader *h = p->hdr;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t size = ((size_t)h->raw_y_stride * h->raw_height * 3 / 2 + page - 1) & ~(page - 1);
+    h->raw_size = (uint32_t)size;
+
+    int heap_fd = -1;
+#if SHM_HAVE_DMA_HEAP
+    heap_fd = open(V4L2_DMA_HEAP_PATH, O_RDWR | O_CLOEXEC);
+#endif
+    h->raw_dmabuf = heap_fd >= 0;
+
+    for (unsigned int i = 0; i < h->raw_slots; i++) {
+        int fd = -1;
+#if SHM_HAVE_DMA_HEAP
+        if (heap_fd >= 0) {
+            struct dma_heap_allocation_data alloc = { .len = size, .fd_flags = O_RDWR | O_CLOEXEC };
+            if (ioctl(heap_fd, DMA_HEAP_IOCTL_ALLOC, &alloc) < 0) {
+                LOGE("[%s] dma-heap alloc raw slot %u (%zu bytes) failed: %s", TAG, i, size, strerror(errno));
+                close(heap_fd);
+                return -1;
+            }
+            fd = (int)alloc.fd;
+        }
+#endif
+        if (heap_fd < 0) {
+            char name[32];
+            snprintf(name, sizeof(name), "rkav-raw%u", i);
+            fd = memfd_create(name, MFD_CLOEXEC);
+            if (fd < 0 || ftruncate(fd, (off_t)size) != 0) {
+                LOGE("[%s] memfd raw slot %u (%zu bytes) failed: %s", TAG, i, size, strerror(errno));
+                if (fd >= 0) close(fd);
+                return -1;
+            }
+        }
+        p->raw_fds[i] = fd;
+        void *addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            LOGE("[%s] mmap raw slot %u failed: %s", TAG, i, strerror(errno));
+            if (heap_fd >= 0) close(heap_fd);
+            return -1;
+        }
+        p->raw_maps[i] = (uint8_t *)addr;
+    }
+    if (heap_fd >= 0) close(heap_fd);
+    return 0;
+}
+
+static int pub_listen(ShmPub *p)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(p->o.sock_path) >= sizeof(addr.sun_path)) {
+        LOGE("[%s] socket path too long: %s", TAG, p->o.sock_path);
+        return -1;
+    }
+    strcpy(addr.sun_path, p->o.sock_path);
+
+    p->listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (p->listen_fd < 0) {
+        LOGE("[%s] socket failed: %s", TAG, strerror(errno));
+        return -1;
+    }
+    unlink(p->o.sock_path);   // 上次异常退出留下的 socket 文件
+    if (bind(p->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        listen(p->listen_fd, SHM_PUB_MAX_READERS) != 0) {
+        LOGE("[%s] bind / listen %s failed: %s", TAG, p->o.sock_path, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static void pub_free(ShmPub *p)
+{
+    for (int i = 0; i < SHM_PUB_MAX_READERS; i++) {
+        if (p->conn_fds[i] >= 0) close(p->conn_fds[i]);
+        p->conn_fds[i] = -1;
+    }
+    if (p->listen_fd >= 0) {
+        close(p->listen_fd);
+        unlink(p->o.sock_path);
+    }
+    p->listen_fd = -1;
+    for (int i = 0; i < SHM_PUB_MAX_RAW; i++) {
+        if (p->raw_maps[i]) munmap(p->raw_maps[i], p->hdr->raw_size);
+        if (p->raw_fds[i] >= 0) close(p->raw_fds[i]);
+        p->raw_maps[i] = NULL;
+        p->raw_fds[i]  = -1;
+    }
+    if (p->hdr) munmap(p->hdr, p->map_size);
+    p->hdr = NULL;
+    if (p->mem_fd >= 0) close(p->mem_fd);
+    p->mem_fd = -1;
+    if (p->wake_fd >= 0) close(p->wake_fd);
+    p->wake_fd = -1;
+}
+
+/* ===================== Publisher: thread ===================== */
+
+/* 新读者：分配读者槽并把 fd 发过去；读者已满时只回一条 reader=-1 */
+static void pub_accept(ShmPub *p)
+{
+    int fd = accept4(p->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) return;
+
+    int slot = -1;
+    for (int i = 0; i < SHM_PUB_MAX_READERS && slot < 0; i++)
+        if (p->conn_fds[i] < 0) slot = i;
+
+    ShmPubHello hello = { .magic = SHM_PUB_MAGIC, .version = SHM_PUB_VERSION, .reader = slot };
+    int fds[1 + SHM_PUB_MAX_RAW];
+    if (slot >= 0) {
+        fds[hello.nfds++] = p->mem_fd;
+        for (unsigned int i = 0; i < p->hdr->raw_slots; i++) fds[hello.nfds++] = p->raw_fds[i];
+
+        ShmPubReader *r = &p->hdr->readers[slot];
+        atomic_store(&r->flags, 0);
+        atomic_store(&r->drops, 0);
+        atomic_store(&r->raw_seq, 0);
+        atomic_store(&r->pkt_pos, atomic_load(&p->hdr->head));
+        atomic_store(&r->used, 1);
+    }
+
+    char ctrl[CMSG_SPACE(sizeof(fds))];
+    memset(ctrl, 0, sizeof(ctrl));
+    struct iovec iov = { .iov_base = &hello, .iov_len = sizeof(hello) };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1 };
+    if (hello.nfds) {
+        msg.msg_control    = ctrl;
+        msg.msg_controllen = CMSG_SPACE(sizeof(int) * hello.nfds);
+        struct cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+        cm->cmsg_level = SOL_SOCKET;
+        cm->cmsg_type  = SCM_RIGHTS;
+        cm->cmsg_len   = CMSG_LEN(sizeof(int) * hello.nfds);
+        memcpy(CMSG_DATA(cm), fds, sizeof(int) * hello.nfds);
+    }
+    if (sendmsg(fd, &msg, MSG_NOSIGNAL) != (ssize_t)sizeof(hello) || slot < 0) {
+        if (slot < 0) LOGW("[%s] reader rejected: %d readers connected", TAG, SHM_PUB_MAX_READERS);
+        else atomic_store(&p->hdr->readers[slot].used, 0);
+        close(fd);
+        return;
+    }
+    p->conn_fds[slot] = fd;
+    int n = atomic_fetch_add(&p->readers, 1) + 1;
+    LOGI("[%s] reader %d connected (%d total)", TAG, slot, n);
+}
+
+static void pub_drop_reader(ShmPub *p, int slot)
+{
+    ShmPubReader *r = &p->hdr->readers[slot];
+    uint64_t lag = atomic_load(&p->hdr->head) - atomic_load(&r->pkt_pos);
+    LOGI("[%s] reader %d disconnected, drops=%llu lag=%lluB", TAG, slot,
+         (unsigned long long)atomic_load(&r->drops), (unsigned long long)lag);
+    atomic_store(&r->flags, 0);
+    atomic_store(&r->used, 0);
+    close(p->conn_fds[slot]);
+    p->conn_fds[slot] = -1;
+    atomic_fetch_sub(&p->readers, 1);
+}
+
+/*
+ * 拷贝信箱里的一帧：写第 raw_copied % raw_slots 个槽，期间版本号为奇数。
+ * 拷完先归还采集 buffer、清信箱，再发布 raw_count。
+ */
+static void pub_copy_raw(ShmPub *p)
+{
+    ShmPubHeader  *h  = p->hdr;
+    uint64_t       n  = p->raw_copied;
+    unsigned int   s  = (unsigned int)(n % h->raw_slots);
+    ShmPubRawSlot *rs = &h->raw[s];
+
+    uint64_t gen = atomic_load_explicit(&rs->gen, memory_order_relaxed);
+    atomic_store_explicit(&rs->gen, gen + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    int64_t t0 = media_clock_now_us();
+    RgaImage dst = {
+        .fd      = h->raw_dmabuf ? p->raw_fds[s] : -1,
+        .planes  = { .y = p->raw_maps[s], .uv = p->raw_maps[s] + (size_t)h->raw_y_stride * h->raw_height,
+                     .y_stride = h->raw_y_stride, .uv_stride = h->raw_y_stride },
+        .width   = h->raw_width,
+        .height  = h->raw_height,
+        .hstride = h->raw_height,
+    };
+    slot_sync(dst.fd, h->raw_dmabuf, 1, 1);
+    int ret = (p->rga.hw && !p->rga.hw_failed)
+            ? rga_scale_nv12(&p->rga, &p->raw_src, &dst)
+            : nv12_repack(&p->raw_src.planes, &dst.planes, h->raw_width, h->raw_height, 0, 0);
+    slot_sync(dst.fd, h->raw_dmabuf, 0, 1);
+
+    int64_t pts = p->raw_pts;
+    p->o.raw_release(p->o.raw_ctx, p->raw_index);
+    atomic_store_explicit(&p->raw_busy, 0, memory_order_release);
+
+    if (ret == 0) {
+        atomic_store_explicit(&rs->seq, n + 1, memory_order_relaxed);
+        atomic_store_explicit(&rs->pts_us, pts, memory_order_relaxed);
+    }
+    atomic_store_explicit(&rs->gen, gen + 2, memory_order_release);
+    if (ret != 0) {
+        LOGW("[%s] raw copy failed", TAG);
+        return;
+    }
+    p->raw_copied = n + 1;
+    p->raw_copy_us += (uint64_t)(media_clock_now_us() - t0);
+    atomic_store_explicit(&h->raw_count, n + 1, memory_order_release);
+    pub_notify(p);
+}
+
+/* 发布线程：接受 / 回收读者，拷贝原始帧。编码包由取包线程直接写，不经过这里 */
+static void *pub_thread(void *arg)
+{
+    ShmPub *p = (ShmPub *)arg;
+    rt_sched_apply(RT_ROLE_SINK, "v-pub");
+
+    while (!atomic_load(&p->stop)) {
+        struct pollfd pfds[2 + SHM_PUB_MAX_READERS];
+        int slots[2 + SHM_PUB_MAX_READERS];
+        int n = 0;
+        pfds[n++] = (struct pollfd){ .fd = p->wake_fd,   .events = POLLIN };
+        pfds[n++] = (struct pollfd){ .fd = p->listen_fd, .events = POLLIN };
+        for (int i = 0; i < SHM_PUB_MAX_READERS; i++) {
+            if (p->conn_fds[i] < 0) continue;
+            slots[n] = i;
+            pfds[n++] = (struct pollfd){ .fd = p->conn_fds[i], .events = POLLIN };
+        }
+        if (poll(pfds, (nfds_t)n, SHM_POLL_MS) < 0) {
+            if (errno == EINTR) continue;
+            LOGE("[%s] poll failed: %s", TAG, strerror(errno));
+            break;
+        }
+        if (pfds[0].revents & POLLIN) {
+            uint64_t v;
+            ssize_t r = read(p->wake_fd, &v, sizeof(v));
+            (void)r;
+        }
+        if (atomic_load_explicit(&p->raw_busy, memory_order_acquire)) pub_copy_raw(p);
+        if (pfds[1].revents & POLLIN) pub_accept(p);
+        for (int k = 2; k < n; k++) {
+            if (!pfds[k].revents) continue;
+            /* 读者不发数据：可读即对端关闭（或协议错误），都当作断开 */
+            char b;
+            ssize_t r = recv(pfds[k].fd, &b, 1, MSG_DONTWAIT);
+            if (r < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+            pub_drop_reader(p, slots[k]);
+        }
+    }
+
+    if (atomic_load(&p->raw_busy)) {
+        p->o.raw_release(p->o.raw_ctx, p->raw_index);
+        atomic_store(&p->raw_busy, 0);
+    }
+    return NULL;
+}
+
+/* ===================== Publisher: API ===================== */
+
+int shm_pub_open(ShmPub *p, const ShmPubOpts *o)
+{
+    if (!p || !o || !o->sock_path || !o->raw_release) return -1;
+    memset(p, 0, sizeof(*p));
+    p->o         = *o;
+    p->listen_fd = -1;
+    p->mem_fd    = -1;
+    p->wake_fd   = -1;
+    for (int i = 0; i < SHM_PUB_MAX_READERS; i++) p->conn_fds[i] = -1;
+    for (int i = 0; i < SHM_PUB_MAX_RAW; i++) p->raw_fds[i] = -1;
+
+    uint32_t ring = SHM_RING_MIN;
+    while (ring < o->ring_bytes && ring < (1u << 30)) ring <<= 1;
+    size_t page     = (size_t)sysconf(_SC_PAGESIZE);
+    size_t hdr_size = (sizeof(ShmPubHeader) + page - 1) & ~(page - 1);
+    p->map_size  = hdr_size + ring;
+    p->ring_mask = ring - 1;
+
+    p->mem_fd = memfd_create("rkav-pub", MFD_CLOEXEC);
+    if (p->mem_fd < 0 || ftruncate(p->mem_fd, (off_t)p->map_size) != 0) {
+        LOGE("[%s] memfd (%zu bytes) failed: %s", TAG, p->map_size, strerror(errno));
+        pub_free(p);
+        return -1;
+    }
+    void *addr = mmap(NULL, p->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, p->mem_fd, 0);
+    if (addr == MAP_FAILED) {
+        LOGE("[%s] mmap failed: %s", TAG, strerror(errno));
+        pub_free(p);
+        return -1;
+    }
+    p->hdr  = (ShmPubHeader *)addr;
+    p->ring = (uint8_t *)addr + hdr_size;
+
+    /* ftruncate 出来的内存已是零：只写非零字段 */
+    ShmPubHeader *h = p->hdr;
+    h->magic         = SHM_PUB_MAGIC;
+    h->version       = SHM_PUB_VERSION;
+    h->header_size   = (uint32_t)hdr_size;
+    h->ring_size     = ring;
+    h->clock_base_us = -media_clock_pts(0);
+    snprintf(h->codec, sizeof(h->codec), "%s", o->codec ? o->codec : "");
+    if (o->raw_fps > 0) {
+        h->raw_slots    = o->raw_slots < 2 ? 2 : (o->raw_slots > SHM_PUB_MAX_RAW ? SHM_PUB_MAX_RAW : o->raw_slots);
+        h->raw_width    = o->width & ~1u;
+        h->raw_height   = o->height & ~1u;
+        h->raw_y_stride = (h->raw_width + 15) & ~15u;
+        p->raw_interval_us = 1000000 / (int64_t)o->raw_fps;
+        rga_scaler_init(&p->rga);
+        if (pub_alloc_raw(p) != 0) {
+            pub_free(p);
+            return -1;
+        }
+    }
+
+    p->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (p->wake_fd < 0 || pub_listen(p) != 0) {
+        pub_free(p);
+        return -1;
+    }
+    if (pthread_create(&p->th, NULL, pub_thread, p) != 0) {
+        LOGE("[%s] pthread_create failed", TAG);
+        pub_free(p);
+        return -1;
+    }
+    p->started = 1;
+
+    if (h->raw_slots)
+        LOGI("[%s] listening on %s: packet ring %uKB, raw %ux%u @%ufps in %u %s slots (%s copy)", TAG,
+             o->sock_path, ring / 1024, h->raw_width, h->raw_height, o->raw_fps, h->raw_slots,
+             h->raw_dmabuf ? "dmabuf" : "memfd", rga_scaler_impl(&p->rga));
+    else LOGI("[%s] listening on %s: packet ring %uKB, no raw frames", TAG, o->sock_path, ring / 1024);
+    return 0;
+}
+
+void shm_pub_close(ShmPub *p)
+{
+    if (!p || !p->started) return;
+    atomic_store(&p->stop, 1);
+    uint64_t one = 1;
+    ssize_t n = write(p->wake_fd, &one, sizeof(one));
+    (void)n;
+    pthread_join(p->th, NULL);
+    p->started = 0;
+
+    atomic_store(&p->hdr->closed, 1);
+    pub_notify(p);
+    LOGI("[%s] closed: packets=%llu (too big %llu), raw=%llu (copy avg %.2fms)", TAG,
+         (unsigned long long)p->pkt_seq, (unsigned long long)p->pkt_too_big, (unsigned long long)p->raw_copied,
+         p->raw_copied ? (double)p->raw_copy_us / 1000.0 / (double)p->raw_copied : 0.0);
+    pub_free(p);
+}
+
+/* 环形拷贝：pos 为绝对位置 */
+static void ring_write(ShmPub *p, uint64_t pos, const void *src, size_t len)
+{
+    size_t off   = (size_t)(pos & p->ring_mask);
+    size_t first = p->ring_mask + 1 - off;
+    if (first >= len) {
+        memcpy(p->ring + off, src, len);
+        return;
+    }
+    memcpy(p->ring + off, src, first);
+    memcpy(p->ring, (const uint8_t *)src + first, len - first);
+}
+
+/*
+ * 写者一侧（seqlock 式）：reserve 先推到本条记录末尾，release fence 保证它先于数据可见；
+ * 读者读完数据后再看 reserve，发现本条已落在 reserve 一圈之外即知被覆盖。
+ */
+void shm_pub_packet(ShmPub *p, const uint8_t *data, size_t len, int64_t pts_us, int keyframe)
+{
+    if (!p || !p->started || !data) return;
+    ShmPubHeader *h = p->hdr;
+    size_t need = rec_size(len);
+    if (need > (size_t)h->ring_size / 4) {
+        if (p->pkt_too_big++ == 0)
+            LOGW("[%s] %zu-byte packet exceeds 1/4 of the %uKB ring, not published (raise --pub-ring-kb)", TAG,
+                 len, h->ring_size / 1024);
+        return;
+    }
+
+    ShmPubRecord rec = {
+        .len    = (uint32_t)len,
+        .flags  = keyframe ? SHM_PKT_KEY : 0,
+        .pts_us = pts_us,
+        .seq    = ++p->pkt_seq,
+    };
+    uint64_t pos = atomic_load_explicit(&h->head, memory_order_relaxed);
+    atomic_store_explicit(&h->reserve, pos + need, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    ring_write(p, pos, &rec, sizeof(rec));
+    ring_write(p, pos + sizeof(rec), data, len);
+
+    atomic_store_explicit(&h->last_pos, pos, memory_order_relaxed);
+    if (keyframe) atomic_store_explicit(&h->key_pos, pos, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->packets, 1, memory_order_relaxed);
+    atomic_store_explicit(&h->head, pos + need, memory_order_release);
+    pub_notify(p);
+}
+
+int shm_pub_raw_want(ShmPub *p, int64_t now_us)
+{
+    if (!p || !p->started || !p->hdr->raw_slots || now_us < p->raw_next_us) return 0;
+    if (atomic_load_explicit(&p->raw_busy, memory_order_acquire) || atomic_load(&p->readers) == 0) return 0;
+    int want = 0;
+    for (int i = 0; i < SHM_PUB_MAX_READERS && !want; i++) {
+        const ShmPubReader *r = &p->hdr->readers[i];
+        want = atomic_load_explicit(&r->used, memory_order_relaxed) &&
+               (atomic_load_explicit(&r->flags, memory_order_relaxed) & SHM_SUB_WANT_RAW);
+    }
+    if (!want) return 0;
+    /* 按名义间隔推进；落后超过一个间隔（发布线程忙、读者刚连上）时从现在重新计 */
+    p->raw_next_us = now_us - p->raw_next_us < p->raw_interval_us ? p->raw_next_us + p->raw_interval_us
+                                                                  : now_us + p->raw_interval_us;
+    return 1;
+}
+
+void shm_pub_raw_submit(ShmPub *p, int index, const RgaImage *src, int64_t pts_us)
+{
+    p->raw_index = index;
+    p->raw_src   = *src;
+    p->raw_pts   = pts_us;
+    atomic_store_explicit(&p->raw_busy, 1, memory_order_release);
+    uint64_t one = 1;
+    ssize_t n = write(p->wake_fd, &one, sizeof(one));
+    (void)n;
+}
+
+/* ===================== Subscriber ===================== */
+
+static void ring_read(const ShmSub *s, uint64_t pos, void *dst, size_t len)
+{
+    size_t off   = (size_t)(pos & s->ring_mask);
+    size_t first = s->ring_mask + 1 - off;
+    if (first >= len) {
+        memcpy(dst, s->ring + off, len);
+        return;
+    }
+    memcpy(dst, s->ring + off, first);
+    memcpy((uint8_t *)dst + first, s->ring, len - first);
+}
+
+/* 起点 pos 的记录是否还没被覆盖 */
+static int sub_pos_valid(const ShmSub *s, uint64_t pos)
+{
+    return atomic_load_explicit(&s->hdr->reserve, memory_order_acquire) - pos <= (uint64_t)s->ring_mask + 1;
+}
+
+/* 读位置：最近的关键帧还在环里就从它开始，否则从下一个包开始 */
+static void sub_seek_key(ShmSub *s)
+{
+    ShmPubHeader *h = s->hdr;
+    uint64_t head = atomic_load_explicit(&h->head, memory_order_acquire);
+    uint64_t key  = atomic_load_explicit(&h->key_pos, memory_order_relaxed);
+    s->pos = atomic_load_explicit(&h->packets, memory_order_relaxed) && key <= head && sub_pos_valid(s, key)
+           ? key : head;
+}
+
+static void sub_resync(ShmSub *s)
+{
+    sub_seek_key(s);
+    s->drops++;
+    atomic_store_explicit(&s->hdr->readers[s->reader].drops, s->drops, memory_order_relaxed);
+}
+
+static int sub_recv_hello(ShmSub *s, ShmPubHello *hello, int *fds, int max_fds)
+{
+    char ctrl[CMSG_SPACE(sizeof(int) * (1 + SHM_PUB_MAX_RAW))];
+    struct iovec iov = { .iov_base = hello, .iov_len = sizeof(*hello) };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = ctrl, .msg_controllen = sizeof(ctrl) };
+    ssize_t n = recvmsg(s->sock, &msg, MSG_CMSG_CLOEXEC);
+    if (n != (ssize_t)sizeof(*hello)) return -1;
+
+    int nfds = 0;
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS) continue;
+        int cnt = (int)((cm->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+        for (int i = 0; i < cnt; i++) {
+            int fd;
+            memcpy(&fd, CMSG_DATA(cm) + i * sizeof(int), sizeof(int));
+            if (nfds < max_fds) fds[nfds++] = fd;
+            else close(fd);
+        }
+    }
+    return nfds;
+}
+
+int shm_sub_open(ShmSub *s, const char *sock_path, int want_raw)
+{
+    if (!s || !sock_path) return -1;
+    memset(s, 0, sizeof(*s));
+    s->sock   = -1;
+    s->reader = -1;
+    s->mem_fd = -1;
+    for (int i = 0; i < SHM_PUB_MAX_RAW; i++) s->raw_fds[i] = -1;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(sock_path) >= sizeof(addr.sun_path)) {
+        LOGE("[%s] socket path too long: %s", TAG, sock_path);
+        return -1;
+    }
+    strcpy(addr.sun_path, sock_path);
+    s->sock = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (s->sock < 0 || connect(s->sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        LOGE("[%s] connect %s failed: %s", TAG, sock_path, strerror(errno));
+        shm_sub_close(s);
+        return -1;
+    }
+
+    ShmPubHello hello;
+    int fds[1 + SHM_PUB_MAX_RAW];
+    int nfds = sub_recv_hello(s, &hello, fds, 1 + SHM_PUB_MAX_RAW);
+    if (nfds < 0 || hello.magic != SHM_PUB_MAGIC || hello.version != SHM_PUB_VERSION) {
+        LOGE("[%s] %s: bad hello", TAG, sock_path);
+        for (int i = 0; i < nfds; i++) close(fds[i]);
+        shm_sub_close(s);
+        return -1;
+    }
+    if (hello.reader < 0 || hello.reader >= SHM_PUB_MAX_READERS || nfds < 1) {
+        LOGE("[%s] %s: no free reader slot", TAG, sock_path);
+        for (int i = 0; i < nfds; i++) close(fds[i]);
+        shm_sub_close(s);
+        return -1;
+    }
+    s->reader = hello.reader;
+    s->mem_fd = fds[0];
+    for (int i = 1; i < nfds; i++) s->raw_fds[i - 1] = fds[i];
+
+    struct stat st;
+    if (fstat(s->mem_fd, &st) != 0 || (size_t)st.st_size < sizeof(ShmPubHeader)) {
+        LOGE("[%s] bad shared memory", TAG);
+        shm_sub_close(s);
+        return -1;
+    }
+    s->map_size = (size_t)st.st_size;
+    void *addr_map = mmap(NULL, s->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, s->mem_fd, 0);
+    if (addr_map == MAP_FAILED) {
+        LOGE("[%s] mmap failed: %s", TAG, strerror(errno));
+        shm_sub_close(s);
+        return -1;
+    }
+    s->hdr = (ShmPubHeader *)addr_map;
+    ShmPubHeader *h = s->hdr;
+    if (h->magic != SHM_PUB_MAGIC || (size_t)h->header_size + h->ring_size != s->map_size ||
+        (h->ring_size & (h->ring_size - 1)) || h->raw_slots > SHM_PUB_MAX_RAW || (unsigned int)nfds != 1 + h->raw_slots) {
+        LOGE("[%s] shared memory layout mismatch", TAG);
+        shm_sub_close(s);
+        return -1;
+    }
+    s->ring      = (const uint8_t *)addr_map + h->header_size;
+    s->ring_mask = h->ring_size - 1;
+    s->raw_slots = h->raw_slots;
+    for (unsigned int i = 0; i < s->raw_slots; i++) {
+        void *m = mmap(NULL, h->raw_size, PROT_READ, MAP_SHARED, s->raw_fds[i], 0);
+        if (m == MAP_FAILED) {
+            LOGE("[%s] mmap raw slot %u failed: %s", TAG, i, strerror(errno));
+            shm_sub_close(s);
+            return -1;
+        }
+        s->raw_maps[i] = (uint8_t *)m;
+    }
+
+    atomic_store(&h->readers[s->reader].flags, want_raw ? SHM_SUB_WANT_RAW : 0);
+    /* 只看连上之后的原始帧；notify_seen 错开一位，第一次 wait 不睡，先把环里已有的包读出来 */
+    s->raw_seen    = atomic_load(&h->raw_count);
+    s->notify_seen = atomic_load(&h->notify) - 1;
+    sub_seek_key(s);
+    atomic_store(&h->readers[s->reader].pkt_pos, s->pos);
+    return 0;
+}
+
+void shm_sub_close(ShmSub *s)
+{
+    if (!s) return;
+    for (unsigned int i = 0; i < SHM_PUB_MAX_RAW; i++) {
+        if (s->raw_maps[i]) munmap(s->raw_maps[i], s->hdr->raw_size);
+        if (s->raw_fds[i] >= 0) close(s->raw_fds[i]);
+        s->raw_maps[i] = NULL;
+        s->raw_fds[i]  = -1;
+    }
+    if (s->hdr) munmap(s->hdr, s->map_size);
+    s->hdr = NULL;
+    if (s->mem_fd >= 0) close(s->mem_fd);
+    s->mem_fd = -1;
+    if (s->sock >= 0) close(s->sock);
+    s->sock = -1;
+}
+
+int shm_sub_wait(ShmSub *s, int timeout_ms)
+{
+    ShmPubHeader *h = s->hdr;
+    if (atomic_load(&h->closed)) return -1;
+    uint32_t cur = atomic_load(&h->notify);
+    if (cur == s->notify_seen) {
+        struct timespec ts = { .tv_sec = timeout_ms / 1000, .tv_nsec = (long)(timeout_ms % 1000) * 1000000L };
+        atomic_fetch_add(&h->waiters, 1);
+        if (atomic_load(&h->notify) == cur)
+            syscall(SYS_futex, (uint32_t *)&h->notify, FUTEX_WAIT, cur, timeout_ms >= 0 ? &ts : NULL, NULL, 0);
+        atomic_fetch_sub(&h->waiters, 1);
+        cur = atomic_load(&h->notify);
+    }
+    s->notify_seen = cur;
+    return atomic_load(&h->closed) ? -1 : 0;
+}
+
+/*
+ * 读者一侧：先复制记录，再看 reserve；本条已被覆盖（reserve 超出一圈）就丢掉复制结果重新同步。
+ */
+int shm_sub_read_packet(ShmSub *s, uint8_t *buf, size_t cap, ShmSubPacket *pkt)
+{
+    ShmPubHeader *h = s->hdr;
+    memset(pkt, 0, sizeof(*pkt));
+    for (;;) {
+        uint64_t head = atomic_load_explicit(&h->head, memory_order_acquire);
+        if (s->pos == head) return atomic_load(&h->closed) ? -1 : 1;
+        if (head - s->pos > (uint64_t)s->ring_mask + 1) {
+            sub_resync(s);
+            continue;
+        }
+
+        ShmPubRecord rec;
+        ring_read(s, s->pos, &rec, sizeof(rec));
+        size_t need = rec_size(rec.len);
+        int sane = need <= (size_t)(s->ring_mask + 1) / 4 && s->pos + need <= head;
+        if (sane && rec.len <= cap) ring_read(s, s->pos + sizeof(rec), buf, rec.len);
+        atomic_thread_fence(memory_order_acquire);
+        if (!sub_pos_valid(s, s->pos) || !sane) {
+            sub_resync(s);
+            continue;
+        }
+
+        s->pos += need;
+        atomic_store_explicit(&h->readers[s->reader].pkt_pos, s->pos, memory_order_relaxed);
+        pkt->len      = rec.len;
+        pkt->pts_us   = rec.pts_us;
+        pkt->seq      = rec.seq;
+        pkt->keyframe = (rec.flags & SHM_PKT_KEY) != 0;
+        return rec.len <= cap ? 0 : -1;
+    }
+}
+
+int shm_sub_frame_begin(ShmSub *s, ShmSubFrame *f)
+{
+    ShmPubHeader *h = s->hdr;
+    if (!s->raw_slots) return -1;
+    uint64_t n = atomic_load_explicit(&h->raw_count, memory_order_acquire);
+    if (n == s->raw_seen) return 1;
+
+    unsigned int slot = (unsigned int)((n - 1) % s->raw_slots);
+    const ShmPubRawSlot *rs = &h->raw[slot];
+    uint64_t gen = atomic_load_explicit(&rs->gen, memory_order_acquire);
+    if (gen & 1) return 1;
+
+    memset(f, 0, sizeof(*f));
+    f->slot     = (int)slot;
+    f->fd       = s->raw_fds[slot];
+    f->y        = s->raw_maps[slot];
+    f->uv       = s->raw_maps[slot] + (size_t)h->raw_y_stride * h->raw_height;
+    f->width    = h->raw_width;
+    f->height   = h->raw_height;
+    f->y_stride = h->raw_y_stride;
+    f->seq      = atomic_load_explicit(&rs->seq, memory_order_relaxed);
+    f->pts_us   = atomic_load_explicit(&rs->pts_us, memory_order_relaxed);
+    f->gen      = gen;
+    slot_sync(f->fd, (int)h->raw_dmabuf, 1, 0);
+
+    if (n - s->raw_seen > 1) s->raw_missed += n - s->raw_seen - 1;
+    s->raw_seen = n;
+    atomic_store_explicit(&h->readers[s->reader].raw_seq, f->seq, memory_order_relaxed);
+    return 0;
+}
+
+int shm_sub_frame_end(ShmSub *s, const ShmSubFrame *f)
+{
+    slot_sync(f->fd, (int)s->hdr->raw_dmabuf, 0, 0);
+    atomic_thread_fence(memory_order_acquire);
+    return atomic_load_explicit(&s->hdr->raw[f->slot].gen, memory_order_relaxed) == f->gen ? 0 : 1;
+}
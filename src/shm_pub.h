@@ -0,0 +1,242 @@
+// shm_pub.h
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rga_scale.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 本机共享内存分发（--pub-sock）：同一台机器上的其他进程（NPU 分析、网页预览等）
+ * 直接读取录制流水线的帧，不必再开一次摄像头或回读落盘文件。
+ *
+ * - 控制面：UNIX SOCK_SEQPACKET socket。读者连上后收到一条 ShmPubHello，
+ *   SCM_RIGHTS 带过来 [包环 memfd, 原始帧槽 fd...]，之后这条连接只用来表示“读者还在”，断开即回收读者槽；
+ * - 编码包：memfd 里的单写者环（主码流 lane 0，取包线程写入），每个读者在共享头里有自己的读位置，
+ *   写者从不等待读者：读者落后超过一圈时被覆盖，读者检测到后跳到最近的关键帧重新同步并计入 drops；
+ * - 原始帧：NV12，按 --pub-raw-fps 由发布线程拷进 raw_slots 个自有 buffer（有 dma-heap 时为 DMABUF，
+ *   有 RGA 时由 RGA 拷贝，否则 memfd + CPU 拷贝），每个槽一个 seqlock 版本号；读者只看最新的一帧，
+ *   读完后核对版本号判断期间是否被覆盖。发布线程忙（上一帧还没拷完）或没有读者要原始帧时，这一帧直接不发布；
+ * - 通知：共享头里的 32 位计数器 + futex（跨进程，MAP_SHARED），写者只在有读者睡眠时才 FUTEX_WAKE。
+ *
+ * 为什么原始帧要拷贝一次、而不是直接把采集 buffer 的 DMABUF 交出去：采集 buffer 用完就要 QBUF 还给驱动，
+ * 读者什么时候读完不可控，要么等读者（阻塞采集），要么在读者读的时候被驱动覆盖（且读者无从得知）。
+ * 拷进发布者自有的槽池后，采集侧只多占一次引用（发布线程拷完即归还），读者按版本号自行判断有效性。
+ */
+#define SHM_PUB_MAGIC        0x31425052u   // "RPB1"
+#define SHM_PUB_VERSION      1
+#define SHM_PUB_MAX_READERS  8
+#define SHM_PUB_MAX_RAW      8
+#define SHM_PUB_RING_KB_DEFAULT 4096
+#define SHM_PUB_RAW_SLOTS_DEFAULT 4
+
+#define SHM_PKT_KEY          0x1u          // ShmPubRecord.flags：关键帧
+#define SHM_SUB_WANT_RAW     0x1u          // ShmPubReader.flags：读者要原始帧
+
+/* 原始帧槽：gen 为奇数表示正在写 */
+typedef struct {
+    _Atomic uint64_t gen;
+    _Atomic uint64_t seq;          // 第几个原始帧（从 1 开始）
+    _Atomic int64_t  pts_us;
+} ShmPubRawSlot;
+
+/* 读者槽：used 由发布者分配 / 回收，其余字段由读者自己写 */
+typedef struct {
+    _Atomic uint32_t used;
+    _Atomic uint32_t flags;        // SHM_SUB_*
+    _Atomic uint64_t pkt_pos;      // 包环读位置（发布者据此统计落后量）
+    _Atomic uint64_t raw_seq;      // 最近读到的原始帧
+    _Atomic uint64_t drops;        // 被覆盖后重新同步的次数
+} ShmPubReader;
+
+/* 包环 memfd 的头部（共享内存布局，读写双方一致） */
+typedef struct {
+    uint32_t         magic;
+    uint32_t         version;
+    uint32_t         header_size;  // 数据环起始偏移（页对齐）
+    uint32_t         ring_size;    // 数据环大小（2 的幂）
+    char             codec[8];     // 主码流编码格式名（"h264" / "h265"）
+    int64_t          clock_base_us;// 发布进程的媒体时钟原点：pts + base = CLOCK_MONOTONIC 微秒
+    /* 原始帧几何（raw_slots=0 表示不发布原始帧） */
+    uint32_t         raw_slots;
+    uint32_t         raw_width, raw_height;
+    uint32_t         raw_y_stride; // UV 平面起始于 raw_y_stride * raw_height
+    uint32_t         raw_size;     // 每个槽的字节数
+    uint32_t         raw_dmabuf;   // 1 = 槽是 DMABUF，CPU 读取前后需要 DMA_BUF_IOCTL_SYNC
+
+    _Atomic uint32_t notify;       // 每写入一个包 / 一帧加一（futex 字）
+    _Atomic uint32_t waiters;      // 睡在 notify 上的读者数
+    _Atomic uint32_t closed;       // 1 = 发布者已关闭
+    uint32_t         pad0;
+
+    /* 包环：写者先把 reserve 推到本条记录的末尾，再写数据，最后发布 head */
+    _Atomic uint64_t reserve;
+    _Atomic uint64_t head;
+    _Atomic uint64_t last_pos;     // 最近一条记录的起点
+    _Atomic uint64_t key_pos;      // 最近一个关键帧记录的起点
+    _Atomic uint64_t packets;
+    _Atomic uint64_t raw_count;    // 已发布的原始帧数
+
+    ShmPubRawSlot    raw[SHM_PUB_MAX_RAW];
+    ShmPubReader     readers[SHM_PUB_MAX_READERS];
+} ShmPubHeader;
+
+/* 包记录头，后接 len 字节数据，整条按 8 字节对齐 */
+typedef struct {
+    uint32_t len;
+    uint32_t flags;                // SHM_PKT_*
+    int64_t  pts_us;
+    uint64_t seq;                  // 第几个包（从 1 开始）
+} ShmPubRecord;
+
+/* 连接后发布者发来的第一条消息（fds：[包环 memfd, 原始帧槽 0..raw_slots-1]） */
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int32_t  reader;               // 分到的读者槽；-1 = 读者已满（不带 fd）
+    uint32_t nfds;
+} ShmPubHello;
+
+/* ===================== Publisher ===================== */
+
+typedef struct {
+    const char  *sock_path;
+    size_t       ring_bytes;       // 包环大小（向上取 2 的幂，至少 64KB）
+    unsigned int raw_fps;          // 0 = 不发布原始帧
+    unsigned int raw_slots;        // 2..SHM_PUB_MAX_RAW
+    unsigned int width, height;    // 原始帧尺寸（= 采集尺寸）
+    const char  *codec;            // 写入共享头
+    void       (*raw_release)(void *ctx, int index);  // 原始帧拷贝完成：归还采集 buffer 的引用
+    void        *raw_ctx;
+} ShmPubOpts;
+
+typedef struct {
+    ShmPubOpts    o;
+    int           listen_fd;
+    int           mem_fd;
+    ShmPubHeader *hdr;
+    size_t        map_size;
+    uint8_t      *ring;
+    uint32_t      ring_mask;
+    uint64_t      pkt_seq;         // 仅写包线程访问
+    uint64_t      pkt_too_big;
+
+    int           raw_fds[SHM_PUB_MAX_RAW];
+    uint8_t      *raw_maps[SHM_PUB_MAX_RAW];
+    RgaScaler     rga;
+    int64_t       raw_next_us;     // 仅采集线程访问：下一次发布原始帧的时刻
+    int64_t       raw_interval_us;
+
+    /* 原始帧信箱：采集线程 raw_busy 0->1 后投递，发布线程拷完后清零 */
+    atomic_int    raw_busy;
+    int           raw_index;
+    RgaImage      raw_src;
+    int64_t       raw_pts;
+    uint64_t      raw_copied;      // 仅发布线程访问
+    uint64_t      raw_copy_us;
+
+    int           conn_fds[SHM_PUB_MAX_READERS];  // 仅发布线程访问；-1 = 空闲
+    atomic_int    readers;
+    int           wake_fd;         // eventfd：投递原始帧 / 停止
+    atomic_int    stop;
+    pthread_t     th;
+    int           started;
+} ShmPub;
+
+/*
+ * 分配共享内存、监听 socket 并启动发布线程。
+ * @return 0 成功；-1 失败（已释放）
+ */
+int  shm_pub_open(ShmPub *p, const ShmPubOpts *o);
+
+/* 停止发布线程、通知读者发布者已关闭（读者已映射的内存仍然有效）、删除 socket 文件。未投递的原始帧经 raw_release 归还。 */
+void shm_pub_close(ShmPub *p);
+
+/*
+ * 写入一个编码包（单写者；从不阻塞，读者落后时被覆盖）。
+ * 大于包环 1/4 的包不写入（计数，打印一次警告）。
+ */
+void shm_pub_packet(ShmPub *p, const uint8_t *data, size_t len, int64_t pts_us, int keyframe);
+
+/*
+ * 采集线程：这一帧要不要交给发布线程（已到 --pub-raw-fps 的发布时刻、有读者要原始帧、发布线程空闲）。
+ * 返回 1 后必须调用一次 shm_pub_raw_submit。
+ */
+int  shm_pub_raw_want(ShmPub *p, int64_t now_us);
+
+/* 投递一帧（src 描述采集 buffer）。拷贝完成（或失败）后调用 raw_release(raw_ctx, index)。 */
+void shm_pub_raw_submit(ShmPub *p, int index, const RgaImage *src, int64_t pts_us);
+
+/* ===================== Subscriber ===================== */
+
+typedef struct {
+    int           sock;
+    int           reader;
+    int           mem_fd;
+    ShmPubHeader *hdr;
+    size_t        map_size;
+    const uint8_t *ring;
+    uint32_t      ring_mask;
+    uint64_t      pos;             // 包环读位置
+    uint32_t      notify_seen;
+
+    unsigned int  raw_slots;
+    int           raw_fds[SHM_PUB_MAX_RAW];
+    uint8_t      *raw_maps[SHM_PUB_MAX_RAW];
+    uint64_t      raw_seen;        // 已读到的 raw_count
+    uint64_t      raw_missed;      // 没来得及读、被后一帧顶替的原始帧
+
+    uint64_t      drops;           // 包环被覆盖后重新同步的次数
+} ShmSub;
+
+typedef struct {
+    size_t   len;
+    int64_t  pts_us;
+    uint64_t seq;
+    int      keyframe;
+} ShmSubPacket;
+
+/* 最新的一帧原始帧（指向共享 buffer，shm_sub_frame_end 之前有效） */
+typedef struct {
+    int            slot;
+    int            fd;             // 槽的 fd（DMABUF 时可以直接交给 NPU / RGA）
+    const uint8_t *y;
+    const uint8_t *uv;
+    unsigned int   width, height, y_stride;
+    uint64_t       seq;
+    int64_t        pts_us;
+    uint64_t       gen;
+} ShmSubFrame;
+
+/*
+ * 连接发布者并映射共享内存。包读位置从最近的关键帧开始（环里没有关键帧时从下一个包开始）。
+ * @param want_raw  1 = 要原始帧（发布者只在有读者要时才拷贝）
+ * @return 0 成功；-1 失败
+ */
+int  shm_sub_open(ShmSub *s, const char *sock_path, int want_raw);
+void shm_sub_close(ShmSub *s);
+
+/* 等待新的包或原始帧（futex）。@return 0 有新数据或超时；-1 发布者已关闭 */
+int  shm_sub_wait(ShmSub *s, int timeout_ms);
+
+/*
+ * 读下一个包。读者落后被覆盖时跳到最近的关键帧，s->drops 加一。
+ * @return 0 读到；1 暂无新包；-1 buf 放不下（跳过该包，pkt->len 为实际长度）或发布者已关闭且已读完（pkt->len 为 0）
+ */
+int  shm_sub_read_packet(ShmSub *s, uint8_t *buf, size_t cap, ShmSubPacket *pkt);
+
+/* 取最新的一帧原始帧。@return 0 有新的一帧；1 暂无（或正被写）；-1 发布者不发布原始帧 */
+int  shm_sub_frame_begin(ShmSub *s, ShmSubFrame *f);
+
+/* 读完一帧。@return 0 读取期间未被覆盖；1 已被覆盖（读到的数据作废） */
+int  shm_sub_frame_end(ShmSub *s, const ShmSubFrame *f);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,9 +1,38 @@
 // src/sink.c
 #include "sink.h"
 #include "log.h"
+#include "mem_arena.h"
+#include "trace.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
+
+/*
+ * 按名字解析 sink 类型（命令行 --sink 使用）。
+ *
+ * @param name  类型名
+ * @param type  输出：sink 类型
+ * @return      0 成功；-1 未知类型
+ */
+int enc_sink_type_from_name(const char *name, EncSinkType *type)
+{
+    if (!name || !type) return -1;
+    if (strcmp(name, "none") == 0)  { *type = ENC_SINK_NONE;        return 0; }
+    if (strcmp(name, "file") == 0)  { *type = ENC_SINK_FILE;        return 0; }
+    if (strcmp(name, "pipe") == 0)  { *type = ENC_SINK_PIPE_FFMPEG; return 0; }
+    if (strcmp(name, "async") == 0) { *type = ENC_SINK_ASYNC_FILE;  return 0; }
+    if (strcmp(name, "ts") == 0)    { *type = ENC_SINK_TS_FILE;     return 0; }
+    if (strcmp(name, "event") == 0) { *type = ENC_SINK_EVENT;       return 0; }
+    return -1;
+}
+
+int enc_sink_type_is_muxed(EncSinkType type)
+{
+    return type == ENC_SINK_TS_FILE || type == ENC_SINK_PIPE_FFMPEG || type == ENC_SINK_EVENT;
+}
 
 /*
  * 初始化编码输出 Sink（下游/落地端）。
@@ -22,6 +51,12 @@ int enc_sink_init(EncSink *sink, EncSinkType type, const char *target)
 
     memset(sink, 0, sizeof(*sink));
     sink->type = type;
+    sink->ts_fd = -1;
+    sink->ts_streams.video = 1;
+    sink_async_default_opts(&sink->async_opts);
+    sink_pipe_default_opts(&sink->pipe_opts);
+    sink_event_default_opts(&sink->event_opts);
+    sink_segment_default_opts(&sink->segment_opts);
 
     if (target) {
         /* 复制目标字符串到固定大小缓冲，保证以 '\0' 结尾。 */
@@ -32,12 +67,71 @@ int enc_sink_init(EncSink *sink, EncSinkType type, const char *target)
     return 0;
 }
 
+int enc_sink_set_async_opts(EncSink *sink, const SinkAsyncOpts *opts)
+{
+    if (!sink || !opts) return -1;
+    sink->async_opts = *opts;
+    return 0;
+}
+
+int enc_sink_set_pipe_opts(EncSink *sink, const SinkPipeOpts *opts)
+{
+    if (!sink || !opts) return -1;
+    sink->pipe_opts = *opts;
+    return 0;
+}
+
+int enc_sink_set_segment_opts(EncSink *sink, const SinkSegmentOpts *opts)
+{
+    if (!sink || !opts) return -1;
+    sink->segment_opts = *opts;
+    return 0;
+}
+
+int enc_sink_set_event_opts(EncSink *sink, const SinkEventOpts *opts)
+{
+    if (!sink || !opts) return -1;
+    sink->event_opts = *opts;
+    return 0;
+}
+
+int enc_sink_set_ts_streams(EncSink *sink, const TsMuxStreams *st)
+{
+    if (!sink || !st) return -1;
+    sink->ts_streams = *st;
+    return 0;
+}
+
+/*
+ * TS 封装器的写出回调：每个 PES 结束直接 write(2) 进文件，
+ * 不经过 stdio 缓冲，进程崩溃时已完成的 PES 都在页缓存里。
+ */
+static int ts_write_fd(void *opaque, const uint8_t *data, size_t len)
+{
+    EncSink *sink = (EncSink *)opaque;
+    if (sink->segmented) return sink_segment_write(&sink->segment, data, len);
+    while (len) {
+        ssize_t n = write(sink->ts_fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOGE("ts write failed: %s", strerror(errno));
+            return -1;
+        }
+        data += n;
+        len  -= (size_t)n;
+    }
+    return 0;
+}
+
 /*
  * 打开 sink 的底层资源（例如文件句柄/管道）。
  *
  * 根据 sink->type 选择不同的打开方式：
- * - ENC_SINK_FILE: 以二进制写方式打开目标文件
- * - ENC_SINK_PIPE_FFMPEG: 预留（暂未实现）
+ * - ENC_SINK_FILE: 以二进制写方式打开目标文件（分段时改为创建第一段，之后 write(2) 直接写段文件）
+ * - ENC_SINK_ASYNC_FILE: 打开目标文件并启动写线程
+ * - ENC_SINK_TS_FILE: 打开目标文件（或第一段）并初始化 TS 封装器
+ * - ENC_SINK_PIPE_FFMPEG: 启动 ffmpeg 子进程与发送线程，target 为推流地址
+ * - ENC_SINK_EVENT: 分配预录环并启动片段写线程，target 为片段文件名格式（触发前不建文件）
  * - ENC_SINK_NONE: 不做任何事
  *
  * @param sink  sink 实例
@@ -47,6 +141,16 @@ int enc_sink_open(EncSink *sink)
 {
     if (!sink) return -1;
 
+    if ((sink->type == ENC_SINK_FILE || sink->type == ENC_SINK_TS_FILE) &&
+        sink_segment_enabled(&sink->segment_opts)) {
+        if (sink_segment_open(&sink->segment, sink->target, &sink->segment_opts) != 0) {
+            LOGE("open segmented output failed: %s", sink->target);
+            return -1;
+        }
+        sink->segmented = 1;
+        if (sink->type == ENC_SINK_FILE) return 0;
+    }
+
     switch (sink->type) {
     case ENC_SINK_FILE:
         /* 文件落地：打开输出文件 */
@@ -55,13 +159,60 @@ int enc_sink_open(EncSink *sink)
             LOGE("open file failed: %s", sink->target);
             return -1;
         }
+        sink->file_buf = (uint8_t *)mem_arena_alloc(MEM_STAGE_SINK, BUFSIZ, 0);
+        if (!sink->file_buf || setvbuf(sink->file_fp, (char *)sink->file_buf, _IOFBF, BUFSIZ) != 0) {
+            LOGE("file sink buffer setup failed: %s", sink->target);
+            fclose(sink->file_fp);
+            sink->file_fp = NULL;
+            mem_arena_free(sink->file_buf);
+            sink->file_buf = NULL;
+            return -1;
+        }
         LOGI("file sink opened: %s", sink->target);
         break;
 
+    case ENC_SINK_ASYNC_FILE:
+        if (sink_async_open(&sink->async, sink->target, &sink->async_opts) != 0) {
+            LOGE("open async file failed: %s", sink->target);
+            return -1;
+        }
+        break;
+
+    case ENC_SINK_TS_FILE:
+        if (!sink->segmented) {
+            sink->ts_fd = open(sink->target, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (sink->ts_fd < 0) {
+                LOGE("open ts file failed: %s", sink->target);
+                return -1;
+            }
+        }
+        if (ts_mux_init(&sink->ts, &sink->ts_streams, ts_write_fd, sink) != 0) {
+            LOGE("ts mux init failed");
+            if (sink->segmented) sink_segment_close(&sink->segment);
+            else close(sink->ts_fd);
+            sink->segmented = 0;
+            sink->ts_fd = -1;
+            return -1;
+        }
+        pthread_mutex_init(&sink->ts_lock, NULL);
+        LOGI("ts sink opened: %s", sink->target);
+        break;
+
     case ENC_SINK_PIPE_FFMPEG:
-        /* 这一版先不实现，后面做 RTMP/推流再填 */
-        LOGW("PIPE_FFMPEG not implemented yet");
-        return -1;
+        sink->pipe_opts.streams = sink->ts_streams;
+        if (sink_pipe_open(&sink->pipe, sink->target, &sink->pipe_opts) != 0) {
+            LOGE("open pipe sink failed: %s", sink->target);
+            return -1;
+        }
+        break;
+
+    case ENC_SINK_EVENT:
+        sink->event_opts.streams = sink->ts_streams;
+        if (sink_event_open(&sink->event, sink->target, &sink->event_opts) != 0) {
+            LOGE("open event sink failed: %s", sink->target);
+            return -1;
+        }
+        break;
 
     case ENC_SINK_NONE:
     default:
@@ -77,12 +228,14 @@ int enc_sink_open(EncSink *sink)
  * 写入一段编码数据到 sink。
  *
  * 对文件 sink：调用 fwrite 直接落盘。
- * 对 NONE/PIPE_FFMPEG（未实现）：当前实现选择“静默丢弃并返回成功”。
+ * 对异步文件 sink：拷贝进环后立即返回；积压超过高水位时返回 1，由调用者决定重试或丢弃。
+ * 对 TS/推流/事件 sink：需要时间戳，必须走 enc_sink_write_ex。
+ * 对 NONE：当前实现选择“静默丢弃并返回成功”。
  *
  * @param sink  sink 实例
  * @param data  数据指针
  * @param len   数据长度（字节）
- * @return      0 成功；-1 失败
+ * @return      0 成功；1 背压（未写入）；-1 失败
  */
 int enc_sink_write(EncSink *sink, const uint8_t *data, size_t len)
 {
@@ -92,11 +245,23 @@ int enc_sink_write(EncSink *sink, const uint8_t *data, size_t len)
 
     switch (sink->type) {
     case ENC_SINK_FILE:
+        if (sink->segmented) return sink_segment_write(&sink->segment, data, len);
         if (!sink->file_fp) return -1;
+        TRACE_BEGIN("fwrite len=%zu", len);
         written = fwrite(data, 1, len, sink->file_fp);
+        TRACE_END();
         break;
 
+    case ENC_SINK_ASYNC_FILE:
+        return sink_async_write(&sink->async, data, len);
+
+    case ENC_SINK_TS_FILE:
     case ENC_SINK_PIPE_FFMPEG:
+    case ENC_SINK_EVENT:
+        /* 没有时间戳无法封装 */
+        LOGW("ts/pipe/event sink requires enc_sink_write_ex");
+        return -1;
+
     case ENC_SINK_NONE:
     default:
         return 0;  // 暂时什么都不做
@@ -111,11 +276,88 @@ int enc_sink_write(EncSink *sink, const uint8_t *data, size_t len)
     return 0;
 }
 
+/*
+ * 带元信息写入：记录 PTS 后按类型写出。
+ * 裸流文件 sink 不含时间信息，meta 只用于记录；TS sink 按 meta 封装进对应 PID。
+ *
+ * @param meta  PTS/关键帧信息（可为 NULL）
+ * @return      同 enc_sink_write
+ */
+int enc_sink_write_ex(EncSink *sink, const uint8_t *data, size_t len, const EncSinkMeta *meta)
+{
+    if (!sink) return -1;
+
+    if (sink->type == ENC_SINK_PIPE_FFMPEG && meta) {
+        /* 内部加锁，只拷贝进发送队列 */
+        sink->last_pts_us = meta->pts_us;
+        return sink_pipe_write(&sink->pipe, data, len, meta->stream == ENC_STREAM_AUDIO,
+                               meta->pts_us, meta->keyframe, meta->part);
+    }
+
+    if (sink->type == ENC_SINK_EVENT && meta) {
+        /* 内部加锁，只拷贝进预录环（最近 PTS 由 sink_event 在锁内记录） */
+        return sink_event_write(&sink->event, data, len, meta->stream == ENC_STREAM_AUDIO,
+                                meta->pts_us, meta->keyframe);
+    }
+
+    if (sink->type == ENC_SINK_TS_FILE && meta) {
+        if (!data || !len || (sink->ts_fd < 0 && !sink->segmented)) return -1;
+        int ret;
+        pthread_mutex_lock(&sink->ts_lock);
+        sink->last_pts_us = meta->pts_us;
+        /* 分段：只在视频关键帧处切换（分片 AU 只看开头一片），新段重新开始 TS（PAT/PMT、连续计数） */
+        if (sink->segmented && TS_AU_STARTS(meta->part) &&
+            sink_segment_begin(&sink->segment, meta->pts_us, meta->stream == ENC_STREAM_VIDEO && meta->keyframe))
+            ts_mux_reset(&sink->ts);
+        if (meta->stream == ENC_STREAM_AUDIO)
+            ret = ts_mux_write_audio(&sink->ts, data, len, meta->pts_us);
+        else
+            ret = ts_mux_write_video_part(&sink->ts, data, len, meta->pts_us, meta->keyframe, meta->part);
+        pthread_mutex_unlock(&sink->ts_lock);
+        return ret;
+    }
+
+    if (meta) {
+        sink->last_pts_us = meta->pts_us;
+        if (sink->segmented && data && len && TS_AU_STARTS(meta->part))
+            sink_segment_begin(&sink->segment, meta->pts_us, meta->keyframe);
+    }
+    return enc_sink_write(sink, data, len);
+}
+
+/*
+ * 请求事件 sink 写出一个片段：只置原子标志，可在信号处理函数中调用。
+ *
+ * @return  0 已请求；-1 不是事件 sink
+ */
+int enc_sink_trigger(EncSink *sink)
+{
+    if (!sink || sink->type != ENC_SINK_EVENT) return -1;
+    sink_event_trigger(&sink->event);
+    return 0;
+}
+
+/*
+ * 等待 sink 可写入 len 字节（配合 enc_sink_write 返回 1 使用）。
+ *
+ * @return  0 可写；1 超时；-1 失败
+ */
+int enc_sink_wait_writable(EncSink *sink, size_t len, int timeout_ms)
+{
+    if (!sink) return -1;
+    if (sink->type != ENC_SINK_ASYNC_FILE) return 0;
+    return sink_async_wait_writable(&sink->async, len, timeout_ms);
+}
+
 /*
  * 关闭 sink 并释放资源。
  *
  * - FILE: fclose(file_fp)
- * - PIPE: 目前用 fclose(pipe_fp)，后续若改为 popen 需对应 pclose
+ * - ASYNC_FILE: 写完环内剩余数据后关闭
+ * - TS_FILE: 释放封装缓冲并关闭文件（每个 PES 已即时写出，无需额外 flush）
+ * - 分段输出：收尾当前段（fdatasync），删除预建但未用到的下一段
+ * - PIPE: 尽量发完发送队列，关闭管道并等待 ffmpeg 退出
+ * - EVENT: 正在写的片段写到环尾后结束，释放预录环
  */
 void enc_sink_close(EncSink *sink)
 {
@@ -125,10 +367,21 @@ void enc_sink_close(EncSink *sink)
         fclose(sink->file_fp);
         sink->file_fp = NULL;
     }
-    if (sink->pipe_fp) {
-        /* 之后用 pclose（如果 pipe_fp 来自 popen） */
-        fclose(sink->pipe_fp);
-        sink->pipe_fp = NULL;
+    mem_arena_free(sink->file_buf);   // fclose 之后：缓冲里剩余的数据已写出
+    sink->file_buf = NULL;
+    if (sink->type == ENC_SINK_PIPE_FFMPEG) sink_pipe_close(&sink->pipe);
+    if (sink->type == ENC_SINK_ASYNC_FILE) sink_async_close(&sink->async);
+    if (sink->type == ENC_SINK_EVENT) sink_event_close(&sink->event);
+    if (sink->type == ENC_SINK_TS_FILE && (sink->ts_fd >= 0 || sink->segmented)) {
+        LOGI("ts sink: %llu bytes", (unsigned long long)sink->ts.bytes);
+        ts_mux_deinit(&sink->ts);
+        pthread_mutex_destroy(&sink->ts_lock);
+        if (sink->ts_fd >= 0) close(sink->ts_fd);
+        sink->ts_fd = -1;
+    }
+    if (sink->segmented) {
+        sink_segment_close(&sink->segment);
+        sink->segmented = 0;
     }
 
     LOGI("sink closed");
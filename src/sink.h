@@ -1,25 +1,95 @@
 // src/sink.h
 #pragma once
 
+#include <pthread.h>
 #include <stdio.h>
 #include <stdint.h>
 
+#include "sink_async.h"
+#include "sink_event.h"
+#include "sink_pipe.h"
+#include "sink_segment.h"
+#include "ts_mux.h"
+
 typedef enum {
     ENC_SINK_NONE = 0,
-    ENC_SINK_FILE,        // 写本地文件（本步只实现这个）
-    ENC_SINK_PIPE_FFMPEG, // 预留：之后用 popen(ffmpeg)
+    ENC_SINK_FILE,        // 写本地文件（调用线程内 fwrite）
+    ENC_SINK_PIPE_FFMPEG, // 推流：TS 经非阻塞管道交给 ffmpeg 转封装（见 sink_pipe.h，可多线程共用）
+    ENC_SINK_ASYNC_FILE,  // 写本地文件（预分配环 + 独立写线程批量写，见 sink_async.h）
+    ENC_SINK_TS_FILE,     // 音视频封装为一路 MPEG-TS 写本地文件（见 ts_mux.h，可多线程共用）
+    ENC_SINK_EVENT,       // 事件录像：内存预录环，触发后写出 TS 片段（见 sink_event.h，可多线程共用）
 } EncSinkType;
 
+typedef enum {
+    ENC_STREAM_VIDEO = 0,
+    ENC_STREAM_AUDIO,
+} EncStreamType;
+
+/* 随数据一起传给 sink 的元信息（裸流落盘时不写入文件，供封装/分段类 sink 使用） */
+typedef struct {
+    EncStreamType stream;
+    int64_t       pts_us;     // 媒体 PTS（media_clock_pts，微秒）
+    int           keyframe;   // 1=视频关键帧（分片时只在开头一片上置位）
+    TsAuPart      part;       // 视频：整帧或 AU 的第几片（--enc-slices）；音频恒为 TS_AU_WHOLE
+} EncSinkMeta;
+
 typedef struct {
     EncSinkType type;
     char target[512];
+    int64_t last_pts_us;       // 最近一次带 meta 写入的 PTS
 
-    FILE *file_fp;
-    FILE *pipe_fp;
+    FILE    *file_fp;
+    uint8_t *file_buf;         // file_fp 的 stdio 缓冲（arena，打开时分配，第一次 fwrite 不再 malloc）
 
+    SinkSegmentOpts segment_opts; // FILE / TS_FILE 分段参数（默认不分段，target 为名义文件名）
+    SinkSegment     segment;
+    int             segmented;
+
+    SinkAsyncOpts async_opts;  // ENC_SINK_ASYNC_FILE 参数（init 时填默认值）
+    SinkAsync     async;
+
+    SinkPipeOpts  pipe_opts;   // ENC_SINK_PIPE_FFMPEG 参数（target 为推流地址）
+    SinkPipe      pipe;
+
+    SinkEventOpts event_opts;  // ENC_SINK_EVENT 参数（target 为片段文件名格式）
+    SinkEvent     event;
+
+    TsMuxStreams    ts_streams; // TS_FILE / PIPE_FFMPEG / EVENT 节目流（open 之前设置）
+    TsMux           ts;
+    int             ts_fd;
+    pthread_mutex_t ts_lock;    // 视频写出线程与音频线程共用同一个 TS sink
 } EncSink;
 
+/* 按名字解析 sink 类型："none" / "file" / "pipe" / "async" / "ts" / "event"。@return 0 成功；-1 未知 */
+int enc_sink_type_from_name(const char *name, EncSinkType *type);
+/* 是否为音视频封装进同一路 TS 的 sink（TS_FILE / PIPE_FFMPEG / EVENT）：必须带 meta 写入，可由音视频线程共用。 */
+int enc_sink_type_is_muxed(EncSinkType type);
+
 int enc_sink_init(EncSink *sink, EncSinkType type, const char *target);
+/* 覆盖异步 sink 参数，需在 enc_sink_open 之前调用。 */
+int enc_sink_set_async_opts(EncSink *sink, const SinkAsyncOpts *opts);
+/* 覆盖推流 sink 参数（节目流以 enc_sink_set_ts_streams 为准），需在 enc_sink_open 之前调用。 */
+int enc_sink_set_pipe_opts(EncSink *sink, const SinkPipeOpts *opts);
+/* 设置分段录制参数（仅 FILE / TS_FILE 生效），需在 enc_sink_open 之前调用。 */
+int enc_sink_set_segment_opts(EncSink *sink, const SinkSegmentOpts *opts);
+/* 覆盖事件 sink 参数（节目流以 enc_sink_set_ts_streams 为准），需在 enc_sink_open 之前调用。 */
+int enc_sink_set_event_opts(EncSink *sink, const SinkEventOpts *opts);
+/* 设置 TS / 推流 / 事件 sink 的节目流（默认仅视频），需在 enc_sink_open 之前调用。 */
+int enc_sink_set_ts_streams(EncSink *sink, const TsMuxStreams *st);
 int enc_sink_open(EncSink *sink);
+/*
+ * @return 0 成功；1 背压（仅 ASYNC_FILE：超过高水位，本次未写入）；-1 失败
+ * PIPE_FFMPEG 从不背压：超延迟时按丢 GOP 策略在 sink 内部丢弃。
+ */
 int enc_sink_write(EncSink *sink, const uint8_t *data, size_t size);
+/*
+ * 带 PTS/关键帧信息写入（meta 可为 NULL，等价于 enc_sink_write）。返回值同 enc_sink_write。
+ * TS / 推流 / 事件 sink 必须带 meta（按 meta->stream 分发到视频/音频 PID），可被多个线程同时调用。
+ * 分片的视频 AU（meta->part 不是 TS_AU_WHOLE）按片依次写入；事件 sink 不支持分片。
+ */
+int enc_sink_write_ex(EncSink *sink, const uint8_t *data, size_t size, const EncSinkMeta *meta);
+/* 请求写出一个事件片段（仅 EVENT；异步信号安全）。@return 0 已请求；-1 不是事件 sink */
+int enc_sink_trigger(EncSink *sink);
+/* 等待可写入 size 字节。@return 0 可写；1 超时；-1 失败（非异步 sink 立即返回 0） */
+int enc_sink_wait_writable(EncSink *sink, size_t size, int timeout_ms);
 void enc_sink_close(EncSink *sink);
\ No newline at end of file
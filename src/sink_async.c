@@ -0,0 +1,453 @@
+// src/sink_async.c
+#include "sink_async.h"
+#include "log.h"
+#include "mem_arena.h"
+#include "rt_sched.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+/*
+ * io_uring 为可选依赖：需 make URING=1（定义 RK_URING_ENABLE 并链接 -luring），
+ * 且头文件存在。运行时 io_uring_queue_init 失败（老内核/seccomp）自动退回 pwritev。
+ */
+#if defined(RK_URING_ENABLE) && RK_URING_ENABLE && defined(__has_include)
+#  if __has_include(<liburing.h>)
+#    include <liburing.h>
+#    define RK_URING_AVAILABLE 1
+#  endif
+#endif
+#ifndef RK_URING_AVAILABLE
+#  define RK_URING_AVAILABLE 0
+#endif
+
+#define TAG "sink_async"
+
+#define SINK_ALIGN      4096u           // 写出粒度/偏移按页对齐
+#define SINK_MAX_BATCH  (4u << 20)      // 单次最多写 4MB，避免一次系统调用占用过久
+
+void sink_async_default_opts(SinkAsyncOpts *opts)
+{
+    if (!opts) return;
+    memset(opts, 0, sizeof(*opts));
+    opts->ring_bytes  = 8u << 20;
+    opts->high_water  = 0;
+    opts->write_chunk = 256u << 10;
+    opts->flush_ms    = 200;
+    opts->sync_mode   = SINK_SYNC_RANGE;
+    opts->sync_bytes  = 4u << 20;
+    opts->stats       = NULL;
+}
+
+static uint64_t mono_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ull + (uint64_t)ts.tv_nsec / 1000ull;
+}
+
+/* cond 使用 CLOCK_MONOTONIC，计算 timeout_ms 之后的绝对时间。 */
+static void deadline_after(struct timespec *ts, unsigned int timeout_ms)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec  += timeout_ms / 1000;
+    ts->tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+static size_t pending_bytes(SinkAsync *a)
+{
+    uint64_t h = atomic_load_explicit(&a->head, memory_order_acquire);
+    uint64_t t = atomic_load_explicit(&a->tail, memory_order_acquire);
+    return (size_t)(h - t);
+}
+
+/* ===================== Writer thread ===================== */
+
+static ssize_t do_writev(SinkAsync *a, const struct iovec *iov, int cnt, uint64_t off)
+{
+#if RK_URING_AVAILABLE
+    if (a->uring) {
+        struct io_uring *ring = (struct io_uring *)a->uring;
+        struct io_uring_sqe *sqe = io_uring_get_sqe(ring);
+        if (!sqe) return -EBUSY;
+        io_uring_prep_writev(sqe, a->fd, iov, (unsigned int)cnt, off);
+        int ret = io_uring_submit(ring);
+        if (ret < 0) return ret;
+        struct io_uring_cqe *cqe = NULL;
+        ret = io_uring_wait_cqe(ring, &cqe);
+        if (ret < 0) return ret;
+        ssize_t res = cqe->res;
+        io_uring_cqe_seen(ring, cqe);
+        return res;
+    }
+#endif
+    ssize_t n = pwritev(a->fd, iov, cnt, (off_t)off);
+    return n < 0 ? -errno : n;
+}
+
+/*
+ * 把环内 [tail, tail+n) 写到文件 file_off 处（环回绕时用 2 个 iovec），处理短写。
+ * @return 0 成功；-1 失败
+ */
+static int write_range(SinkAsync *a, size_t n)
+{
+    uint64_t t   = atomic_load_explicit(&a->tail, memory_order_relaxed);
+    size_t   pos = (size_t)(t % a->ring_bytes);
+    size_t   first = a->ring_bytes - pos;
+    if (first > n) first = n;
+
+    struct iovec iov[2];
+    int cnt = 1;
+    iov[0].iov_base = a->ring + pos;
+    iov[0].iov_len  = first;
+    if (n > first) {
+        iov[1].iov_base = a->ring;
+        iov[1].iov_len  = n - first;
+        cnt = 2;
+    }
+
+    uint64_t t0 = mono_now_us();
+    size_t done = 0;
+    while (done < n) {
+        TRACE_BEGIN("async_write len=%zu", n - done);
+        ssize_t w = do_writev(a, iov, cnt, a->file_off + done);
+        TRACE_END();
+        if (w == -EINTR || w == -EAGAIN) continue;
+        if (w <= 0) {
+            LOGE("[%s] write failed at %llu: %s", TAG, (unsigned long long)(a->file_off + done),
+                 w < 0 ? strerror((int)-w) : "short write");
+            return -1;
+        }
+        done += (size_t)w;
+
+        /* 短写：跳过已写部分 */
+        size_t skip = (size_t)w;
+        while (cnt > 0 && skip >= iov[0].iov_len) {
+            skip -= iov[0].iov_len;
+            iov[0] = iov[1];
+            cnt--;
+        }
+        if (cnt > 0) {
+            iov[0].iov_base = (uint8_t *)iov[0].iov_base + skip;
+            iov[0].iov_len -= skip;
+        }
+    }
+    if (a->stats) av_stats_observe_max(&a->stats->sink_write_max_us, mono_now_us() - t0);
+
+    a->file_off += n;
+    return 0;
+}
+
+/*
+ * 按字节节奏限制脏页：
+ * - RANGE：对新窗口发起异步回写，再等待上一窗口落盘并丢弃其页缓存，
+ *   回写被摊到每个窗口，不会攒到内核 dirty_ratio 阈值后集中阻塞；
+ * - FDATASYNC：直接同步。
+ */
+static void pace_sync(SinkAsync *a)
+{
+    if (a->sync_mode == SINK_SYNC_NONE || a->file_off - a->synced_off < a->sync_bytes) return;
+
+    TRACE_BEGIN("async_sync");
+    if (a->sync_mode == SINK_SYNC_RANGE) {
+        sync_file_range(a->fd, (off_t)a->synced_off, (off_t)(a->file_off - a->synced_off),
+                        SYNC_FILE_RANGE_WRITE);
+        if (a->synced_off > a->prev_sync_off) {
+            off_t len = (off_t)(a->synced_off - a->prev_sync_off);
+            sync_file_range(a->fd, (off_t)a->prev_sync_off, len,
+                            SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+            posix_fadvise(a->fd, (off_t)a->prev_sync_off, len, POSIX_FADV_DONTNEED);
+        }
+        a->prev_sync_off = a->synced_off;
+    } else {
+        if (fdatasync(a->fd) != 0) LOGW("[%s] fdatasync failed: %s", TAG, strerror(errno));
+    }
+    TRACE_END();
+    a->synced_off = a->file_off;
+}
+
+/*
+ * 写线程：
+ * - 攒够 write_chunk 才写，且只写 chunk 的整数倍（大块、对齐）；
+ * - 超过 flush_ms 仍不足一个 chunk 时只写页对齐部分，余下不足 4KB 的等下次；
+ * - 关闭时写出全部剩余数据。
+ */
+static void *writer_thread(void *arg)
+{
+    SinkAsync *a = (SinkAsync *)arg;
+    rt_sched_apply(RT_ROLE_SINK, "sink-async");
+
+    size_t max_batch = a->ring_bytes / 4;
+    if (max_batch > SINK_MAX_BATCH) max_batch = SINK_MAX_BATCH;
+    max_batch -= max_batch % a->write_chunk;
+    if (max_batch < a->write_chunk) max_batch = a->write_chunk;
+
+    for (;;) {
+        pthread_mutex_lock(&a->lock);
+        int timed_out = 0, have_deadline = 0;
+        struct timespec ts;
+        while (!a->closing && !timed_out && pending_bytes(a) < a->write_chunk) {
+            if (pending_bytes(a) == 0) {
+                /*
+                 * 完全空闲：无限等待，不产生周期唤醒。先公布 writer_idle 再复查 head（都是 seq_cst），
+                 * 生产者写入后要么看到 idle 来唤醒，要么这里看到新数据。
+                 */
+                atomic_store(&a->writer_idle, 1);
+                if (atomic_load(&a->head) == atomic_load_explicit(&a->tail, memory_order_relaxed))
+                    pthread_cond_wait(&a->cond_data, &a->lock);
+                atomic_store(&a->writer_idle, 0);
+                have_deadline = 0;   // flush_ms 从数据到达时算起
+                continue;
+            }
+            /* 截止时间每次等待只算一次：中途被唤醒但仍不足一个 chunk 时不顺延 */
+            if (!have_deadline) {
+                deadline_after(&ts, a->flush_ms);
+                have_deadline = 1;
+            }
+            if (pthread_cond_timedwait(&a->cond_data, &a->lock, &ts) == ETIMEDOUT) timed_out = 1;
+        }
+        int closing = a->closing;
+        pthread_mutex_unlock(&a->lock);
+        if (a->stats) av_stats_inc_wakeup(a->stats);
+
+        size_t avail = pending_bytes(a);
+        size_t n;
+        if (avail >= a->write_chunk) {
+            n = avail - avail % a->write_chunk;
+            if (n > max_batch) n = max_batch;
+        } else if (closing) {
+            n = avail;
+        } else {
+            n = avail & ~(size_t)(SINK_ALIGN - 1);
+        }
+
+        if (n == 0) {
+            if (closing) break;
+            continue;
+        }
+
+        int ret = write_range(a, n);
+        if (ret == 0)
+            atomic_store_explicit(&a->tail, atomic_load_explicit(&a->tail, memory_order_relaxed) + n,
+                                  memory_order_release);
+
+        pthread_mutex_lock(&a->lock);
+        if (ret != 0) a->error = 1;
+        pthread_cond_broadcast(&a->cond_space);
+        pthread_mutex_unlock(&a->lock);
+        if (ret != 0) break;
+
+        pace_sync(a);
+    }
+    return NULL;
+}
+
+/* ===================== Lifecycle ===================== */
+
+static void release_all(SinkAsync *a)
+{
+#if RK_URING_AVAILABLE
+    if (a->uring) {
+        io_uring_queue_exit((struct io_uring *)a->uring);
+        free(a->uring);
+    }
+#endif
+    a->uring = NULL;
+    if (a->fd >= 0) close(a->fd);
+    a->fd = -1;
+    mem_arena_free(a->ring);
+    a->ring = NULL;
+}
+
+/*
+ * 打开异步文件 sink。
+ *
+ * @param a     实例（输出）
+ * @param path  目标文件路径
+ * @param opts  参数（NULL = 默认值）
+ * @return      0 成功；-1 失败
+ */
+int sink_async_open(SinkAsync *a, const char *path, const SinkAsyncOpts *opts)
+{
+    if (!a || !path) return -1;
+
+    SinkAsyncOpts o;
+    if (opts) o = *opts;
+    else sink_async_default_opts(&o);
+
+    memset(a, 0, sizeof(*a));
+    a->fd = -1;
+
+    /* 参数兜底：chunk 页对齐且不超过环的一半，高水位不超过环大小减一个 chunk */
+    if (o.write_chunk < SINK_ALIGN) o.write_chunk = SINK_ALIGN;
+    o.write_chunk -= o.write_chunk % SINK_ALIGN;
+    if (o.ring_bytes < o.write_chunk * 2) o.ring_bytes = o.write_chunk * 2;
+    if (o.high_water == 0 || o.high_water > o.ring_bytes) o.high_water = o.ring_bytes / 4 * 3;
+    if (o.flush_ms == 0) o.flush_ms = 200;
+    if (o.sync_bytes < o.write_chunk) o.sync_bytes = o.write_chunk;
+
+    a->ring_bytes  = o.ring_bytes;
+    a->high_water  = o.high_water;
+    a->write_chunk = o.write_chunk;
+    a->flush_ms    = o.flush_ms;
+    a->sync_mode   = o.sync_mode;
+    a->sync_bytes  = o.sync_bytes;
+    a->stats       = o.stats;
+
+    a->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (a->fd < 0) {
+        LOGE("[%s] open %s failed: %s", TAG, path, strerror(errno));
+        return -1;
+    }
+
+    /* 从 arena 分配（已清零、已缺页），运行中首次写入不会触发缺页 */
+    a->ring = (uint8_t *)mem_arena_alloc(MEM_STAGE_SINK, a->ring_bytes, 0);
+    if (!a->ring) {
+        LOGE("[%s] alloc ring %zu failed", TAG, a->ring_bytes);
+        release_all(a);
+        return -1;
+    }
+
+    atomic_init(&a->head, 0);
+    atomic_init(&a->tail, 0);
+    atomic_init(&a->writer_idle, 0);
+
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_mutex_init(&a->lock, NULL);
+    pthread_cond_init(&a->cond_data, &ca);
+    pthread_cond_init(&a->cond_space, &ca);
+    pthread_condattr_destroy(&ca);
+
+    const char *backend = "pwritev";
+#if RK_URING_AVAILABLE
+    struct io_uring *ring = (struct io_uring *)calloc(1, sizeof(*ring));
+    if (ring && io_uring_queue_init(4, ring, 0) == 0) {
+        a->uring = ring;
+        backend  = "io_uring";
+    } else {
+        LOGW("[%s] io_uring unavailable, fallback to pwritev", TAG);
+        free(ring);
+    }
+#endif
+
+    if (pthread_create(&a->thread, NULL, writer_thread, a) != 0) {
+        LOGE("[%s] pthread_create writer failed", TAG);
+        pthread_mutex_destroy(&a->lock);
+        pthread_cond_destroy(&a->cond_data);
+        pthread_cond_destroy(&a->cond_space);
+        release_all(a);
+        return -1;
+    }
+    a->thread_started = 1;
+
+    static const char *sync_names[] = { "none", "range", "fdatasync" };
+    LOGI("[%s] opened %s (%s) ring=%zuKB high_water=%zuKB chunk=%zuKB sync=%s/%zuKB", TAG, path, backend,
+         a->ring_bytes >> 10, a->high_water >> 10, a->write_chunk >> 10,
+         sync_names[a->sync_mode], a->sync_bytes >> 10);
+    return 0;
+}
+
+int sink_async_write(SinkAsync *a, const uint8_t *data, size_t len)
+{
+    if (!a || !a->ring || !data) return -1;
+    if (len == 0) return 0;
+    if (len > a->high_water) {
+        LOGE("[%s] packet %zu larger than high water %zu", TAG, len, a->high_water);
+        return -1;
+    }
+
+    uint64_t h = atomic_load_explicit(&a->head, memory_order_relaxed);
+    uint64_t t = atomic_load_explicit(&a->tail, memory_order_acquire);
+    size_t used = (size_t)(h - t);
+
+    if (used + len > a->high_water) {
+        /* 写线程出错后 tail 不再前进：此时报告失败而不是无限背压 */
+        pthread_mutex_lock(&a->lock);
+        int err = a->error;
+        pthread_mutex_unlock(&a->lock);
+        if (err) return -1;
+        if (a->stats) atomic_fetch_add_explicit(&a->stats->sink_backpressure, 1, memory_order_relaxed);
+        return 1;
+    }
+
+    size_t pos   = (size_t)(h % a->ring_bytes);
+    size_t first = a->ring_bytes - pos;
+    if (first > len) first = len;
+    memcpy(a->ring + pos, data, first);
+    if (len > first) memcpy(a->ring, data + first, len - first);
+
+    atomic_store(&a->head, h + len);   // seq_cst：与下面读 writer_idle 配对
+    if (a->stats) av_stats_observe_max(&a->stats->sink_fill_max, used + len);
+
+    /*
+     * 唤醒写线程：跨过 chunk 阈值，或环由空变为非空（写线程可能在无超时等待，
+     * 不唤醒的话不足一个 chunk 的数据会一直滞留，超出 flush_ms）。其余情况由 flush_ms 超时兜底。
+     * used 按可能过时的 tail 计算，所以另看 writer_idle。
+     */
+    if ((used < a->write_chunk && used + len >= a->write_chunk) || (used == 0 && len > 0) ||
+        atomic_load(&a->writer_idle)) {
+        pthread_mutex_lock(&a->lock);
+        pthread_cond_signal(&a->cond_data);
+        pthread_mutex_unlock(&a->lock);
+    }
+    return 0;
+}
+
+int sink_async_wait_writable(SinkAsync *a, size_t len, int timeout_ms)
+{
+    if (!a || !a->ring) return -1;
+
+    struct timespec ts;
+    deadline_after(&ts, timeout_ms > 0 ? (unsigned int)timeout_ms : 0);
+
+    int ret = 0;
+    pthread_mutex_lock(&a->lock);
+    while (!a->error && pending_bytes(a) + len > a->high_water) {
+        if (pthread_cond_timedwait(&a->cond_space, &a->lock, &ts) == ETIMEDOUT) {
+            ret = 1;
+            break;
+        }
+    }
+    if (a->error) ret = -1;
+    pthread_mutex_unlock(&a->lock);
+    return ret;
+}
+
+/*
+ * 关闭：通知写线程写完剩余数据后退出；sync_mode 非 NONE 时最后 fdatasync 一次。
+ */
+void sink_async_close(SinkAsync *a)
+{
+    if (!a || !a->ring) return;
+
+    if (a->thread_started) {
+        pthread_mutex_lock(&a->lock);
+        a->closing = 1;
+        pthread_cond_signal(&a->cond_data);
+        pthread_mutex_unlock(&a->lock);
+        pthread_join(a->thread, NULL);
+        a->thread_started = 0;
+
+        if (a->sync_mode != SINK_SYNC_NONE && a->fd >= 0) fdatasync(a->fd);
+
+        LOGI("[%s] closed, bytes=%llu%s", TAG, (unsigned long long)a->file_off, a->error ? " (write error)" : "");
+
+        pthread_mutex_destroy(&a->lock);
+        pthread_cond_destroy(&a->cond_data);
+        pthread_cond_destroy(&a->cond_space);
+    }
+
+    release_all(a);
+}
@@ -0,0 +1,97 @@
+// sink_async.h
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "av_stats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 异步批量写文件：调用者只做 memcpy 进预分配的字节环，独立写线程按大块对齐写盘。
+ *
+ * - 写线程优先用 io_uring（编译时 URING=1 且运行时内核支持），否则 pwritev；
+ * - 环内数据超过高水位时 write 直接返回 1（背压），调用者决定等待重试还是丢弃，
+ *   而不是在编码/采集线程里被 SD 卡/eMMC 的回写抖动卡住几百毫秒；
+ * - 按字节数节奏做 sync_file_range / fdatasync，避免脏页堆积后集中回写。
+ */
+
+typedef enum {
+    SINK_SYNC_NONE = 0,   // 不主动 sync，交给内核回写
+    SINK_SYNC_RANGE,      // sync_file_range：启动新窗口回写，等待上一窗口完成并丢弃其页缓存
+    SINK_SYNC_FDATASYNC,  // 每 sync_bytes 做一次 fdatasync（最稳，开销最大）
+} SinkSyncMode;
+
+typedef struct {
+    size_t       ring_bytes;   // 环大小，默认 8MB
+    size_t       high_water;   // 高水位（字节），0 = ring_bytes * 3 / 4
+    size_t       write_chunk;  // 单次写出粒度，4KB 对齐，默认 256KB
+    unsigned int flush_ms;     // 不足一个 chunk 时数据最长滞留时间，默认 200ms
+    SinkSyncMode sync_mode;
+    size_t       sync_bytes;   // 每写出多少字节 sync 一次，默认 4MB
+    AvStats     *stats;        // 可为 NULL
+} SinkAsyncOpts;
+
+typedef struct {
+    int             fd;
+    uint8_t        *ring;
+    size_t          ring_bytes;
+    size_t          high_water;
+    size_t          write_chunk;
+    unsigned int    flush_ms;
+    SinkSyncMode    sync_mode;
+    size_t          sync_bytes;
+    AvStats        *stats;
+
+    /* 单调递增的字节计数：head 仅生产者写，tail 仅写线程写 */
+    _Alignas(64) atomic_uint_fast64_t head;
+    _Alignas(64) atomic_uint_fast64_t tail;
+    atomic_int      writer_idle; // 写线程因环空而无超时等待：生产者写入后必须唤醒（与 head 同为 seq_cst）
+
+    pthread_mutex_t lock;
+    pthread_cond_t  cond_data;   // 生产者 -> 写线程：有足够数据 / 关闭
+    pthread_cond_t  cond_space;  // 写线程 -> 生产者：已腾出空间
+    int             closing;
+    int             error;       // 写线程遇到不可恢复错误
+
+    uint64_t        file_off;    // 仅写线程
+    uint64_t        synced_off;  // 仅写线程：上一次 sync 窗口的结束位置
+    uint64_t        prev_sync_off; // 仅写线程：上一次 sync 窗口的起始位置
+
+    void           *uring;       // struct io_uring*（未启用时为 NULL）
+    pthread_t       thread;
+    int             thread_started;
+} SinkAsync;
+
+/* 填充默认参数。 */
+void sink_async_default_opts(SinkAsyncOpts *opts);
+
+/*
+ * 打开目标文件、分配环并启动写线程。
+ * @return 0 成功；-1 失败（已释放全部资源）
+ */
+int  sink_async_open(SinkAsync *a, const char *path, const SinkAsyncOpts *opts);
+
+/*
+ * 追加一段数据（只做 memcpy，不做 I/O）。
+ * @return 0 成功；1 超过高水位，本次未写入（背压）；-1 失败（数据过大或写线程已出错）
+ */
+int  sink_async_write(SinkAsync *a, const uint8_t *data, size_t len);
+
+/*
+ * 等待环内空间足够写入 len 字节（仍按高水位判断）。
+ * @return 0 可写；1 超时；-1 写线程已出错
+ */
+int  sink_async_wait_writable(SinkAsync *a, size_t len, int timeout_ms);
+
+/* 写出全部剩余数据、停止写线程、fdatasync 并关闭文件。 */
+void sink_async_close(SinkAsync *a);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,455 @@
+// sink_event.c
+#include "sink_event.h"
+#include "log.h"
+#include "mem_arena.h"
+#include "rt_sched.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TAG "sink_event"
+
+#define EVENT_POLL_MS 100   // 没有数据时写线程检查触发标志的间隔
+
+void sink_event_default_opts(SinkEventOpts *opts)
+{
+    if (!opts) return;
+    memset(opts, 0, sizeof(*opts));
+    opts->pre_sec       = 10;
+    opts->post_sec      = 5;
+    opts->ring_bytes    = 16u << 20;
+    opts->write_chunk   = 256u << 10;
+    opts->streams.video = 1;
+}
+
+/* cond 使用 CLOCK_MONOTONIC，计算 timeout_ms 之后的绝对时间。 */
+static void deadline_after(struct timespec *ts, unsigned int timeout_ms)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec  += timeout_ms / 1000;
+    ts->tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+/* ===================== 环（调用者持锁） ===================== */
+
+static SinkEventUnit *unit_at(SinkEvent *e, uint32_t seq)
+{
+    return &e->units[seq % SINK_EVENT_MAX_UNITS];
+}
+
+/* 环首之后第 i 个 GOP 的起点序号 */
+static uint32_t gop_at(const SinkEvent *e, uint32_t i)
+{
+    return e->gops[(e->g_tail + i) % SINK_EVENT_MAX_GOPS];
+}
+
+/* 环首可以推进到的最远位置：片段录制中不越过写线程的读位置。 */
+static uint32_t trim_limit(const SinkEvent *e)
+{
+    return e->recording ? e->rd : e->u_head;
+}
+
+static void event_reclaim(SinkEvent *e)
+{
+    e->d_tail = (e->u_tail == e->u_head) ? e->d_head : unit_at(e, e->u_tail)->off;
+}
+
+/*
+ * 回收环首的一个 GOP（环首推进到第二个 GOP 起点）。
+ * 只剩一个 GOP 且不受读位置保护时整环清空，下一个视频帧必须是关键帧。
+ *
+ * @return  0 已回收；-1 受读位置保护，不能回收
+ */
+static int event_drop_gop(SinkEvent *e)
+{
+    if (e->u_tail == e->u_head) return -1;
+
+    uint32_t limit = trim_limit(e) - e->u_tail;
+    if (e->g_head - e->g_tail >= 2) {
+        uint32_t next = gop_at(e, 1);
+        if (next - e->u_tail > limit) return -1;
+        e->u_tail = next;
+        e->g_tail++;
+    } else {
+        if (e->u_head - e->u_tail > limit) return -1;
+        e->u_tail   = e->u_head;
+        e->g_tail   = e->g_head;
+        e->wait_key = 1;
+    }
+    event_reclaim(e);
+    return 0;
+}
+
+/* 按预录时长回收：去掉最老的 GOP 后剩余部分仍覆盖 pre_sec 时才回收。 */
+static void event_trim_preroll(SinkEvent *e)
+{
+    int64_t pre_us = (int64_t)e->opts.pre_sec * 1000000;
+    uint32_t limit = trim_limit(e) - e->u_tail;
+    while (e->g_head - e->g_tail >= 2) {
+        uint32_t next = gop_at(e, 1);
+        if (next - e->u_tail > limit) break;
+        if (e->last_pts_us - unit_at(e, next)->pts_us < pre_us) break;
+        e->u_tail = next;
+        e->g_tail++;
+        limit = trim_limit(e) - e->u_tail;
+    }
+    event_reclaim(e);
+}
+
+/* 计算放入 len 字节需要的起始位置（不跨越环尾）。@return 0 放得下；-1 放不下 */
+static int event_alloc(const SinkEvent *e, size_t len, int keyframe, uint64_t *off)
+{
+    if (e->u_head - e->u_tail >= SINK_EVENT_MAX_UNITS) return -1;
+    if (keyframe && e->g_head - e->g_tail >= SINK_EVENT_MAX_GOPS) return -1;
+    uint64_t o = e->d_head;
+    size_t pos = (size_t)(o % e->cap);
+    if (pos + len > e->cap) o += e->cap - pos;
+    if (o + len - e->d_tail > e->cap) return -1;
+    *off = o;
+    return 0;
+}
+
+/* ===================== 片段写出（写线程） ===================== */
+
+static int event_write_all(SinkEvent *e, const uint8_t *buf, size_t len)
+{
+    while (len) {
+        ssize_t n = write(e->fd, buf, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOGE("[%s] write %s failed: %s", TAG, e->path, strerror(errno));
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+/* TS 封装回调：攒进 stage，满了写一次文件。 */
+static int event_ts_write(void *opaque, const uint8_t *data, size_t len)
+{
+    SinkEvent *e = (SinkEvent *)opaque;
+    while (len) {
+        size_t room = e->opts.write_chunk - e->stage_len;
+        size_t n = len < room ? len : room;
+        memcpy(e->stage + e->stage_len, data, n);
+        e->stage_len += n;
+        data += n;
+        len  -= n;
+        if (e->stage_len == e->opts.write_chunk) {
+            if (event_write_all(e, e->stage, e->stage_len) != 0) return -1;
+            e->clip_bytes += e->stage_len;
+            e->stage_len = 0;
+        }
+    }
+    return 0;
+}
+
+/*
+ * 按触发时刻展开文件名并独占创建；同名文件已存在（同一秒内的两次事件）时追加 -1..-9。
+ *
+ * @return  0 成功（e->fd / e->path 有效）；-1 失败
+ */
+static int event_open_file(SinkEvent *e)
+{
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    char base[sizeof(e->path)];
+    if (strftime(base, sizeof(base), e->pattern, &tm) == 0) {
+        LOGE("[%s] bad file pattern: %s", TAG, e->pattern);
+        return -1;
+    }
+
+    const char *dot = strrchr(base, '.');
+    const char *slash = strrchr(base, '/');
+    if (dot && slash && dot < slash) dot = NULL;
+    int stem = dot ? (int)(dot - base) : (int)strlen(base);
+
+    for (int n = 0; n < 10; n++) {
+        if (n == 0) snprintf(e->path, sizeof(e->path), "%s", base);
+        else snprintf(e->path, sizeof(e->path), "%.*s-%d%s", stem, base, n, dot ? dot : "");
+        e->fd = open(e->path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (e->fd >= 0) return 0;
+        if (errno != EEXIST) break;
+    }
+    LOGE("[%s] create %s failed: %s", TAG, e->path, strerror(errno));
+    return -1;
+}
+
+static void event_close_file(SinkEvent *e, int64_t first_pts, int64_t last_pts, int ok)
+{
+    if (ok && e->stage_len && event_write_all(e, e->stage, e->stage_len) == 0)
+        e->clip_bytes += e->stage_len;
+    e->stage_len = 0;
+    close(e->fd);
+    e->fd = -1;
+    e->events++;
+    LOGI("[%s] event #%llu %s: %.1fs, %lluKB%s", TAG, (unsigned long long)e->events, e->path,
+         (double)(last_pts - first_pts) / 1e6, (unsigned long long)(e->clip_bytes >> 10),
+         ok ? "" : " (write failed, truncated)");
+}
+
+/*
+ * 写线程：取走触发请求后从环首（关键帧）开始写片段。每次取出最多 write_chunk 字节的单元，
+ * 解锁后封装写盘，读位置在写完之后才推进，期间生产者不会回收这些单元。
+ */
+static void *event_thread(void *arg)
+{
+    SinkEvent *e = (SinkEvent *)arg;
+    rt_sched_apply(RT_ROLE_SINK, "sink-event");
+    int64_t post_us = (int64_t)e->opts.post_sec * 1000000;
+    int64_t first_pts = 0, last_pts = 0;
+
+    pthread_mutex_lock(&e->lock);
+    for (;;) {
+        if (e->recording && atomic_exchange(&e->trig_req, 0)) {
+            /* 片段未结束时再次触发：顺延结束时刻 */
+            e->end_pts_us = e->last_pts_us + post_us;
+        }
+        if (!e->recording && !e->closing && e->u_tail != e->u_head && atomic_exchange(&e->trig_req, 0)) {
+            /* 先占住读位置再解锁建文件，环首从此不越过 rd */
+            e->recording  = 1;
+            e->rd         = e->u_tail;
+            e->end_pts_us = e->last_pts_us + post_us;
+            first_pts = last_pts = unit_at(e, e->rd)->pts_us;
+            pthread_mutex_unlock(&e->lock);
+
+            int ok = event_open_file(e) == 0;
+            if (ok) {
+                ts_mux_reset(&e->ts);
+                e->clip_bytes = 0;
+                LOGI("[%s] triggered -> %s (pre-roll %.1fs)", TAG, e->path,
+                     (double)(e->end_pts_us - post_us - first_pts) / 1e6);
+            }
+            pthread_mutex_lock(&e->lock);
+            if (!ok) e->recording = 0;
+            continue;
+        }
+
+        if (!e->recording || e->rd == e->u_head) {
+            if (e->closing) {
+                if (e->recording) event_close_file(e, first_pts, last_pts, 1);
+                e->recording = 0;
+                break;
+            }
+            struct timespec ts;
+            deadline_after(&ts, EVENT_POLL_MS);
+            pthread_cond_timedwait(&e->cond, &e->lock, &ts);
+            continue;
+        }
+
+        /* 一个批次：到片段结束时刻为止（关闭时写完环内全部数据） */
+        uint32_t first = e->rd, last = e->rd;
+        size_t bytes = 0;
+        int done = 0;
+        while (last != e->u_head && bytes < e->opts.write_chunk) {
+            const SinkEventUnit *u = unit_at(e, last);
+            if (u->pts_us > e->end_pts_us && !e->closing) {
+                done = 1;
+                break;
+            }
+            bytes += u->len;
+            last++;
+        }
+        pthread_mutex_unlock(&e->lock);
+
+        int ret = 0;
+        for (uint32_t i = first; i != last && ret == 0; i++) {
+            const SinkEventUnit *u = unit_at(e, i);
+            const uint8_t *d = e->data + (size_t)(u->off % e->cap);
+            ret = u->audio ? ts_mux_write_audio(&e->ts, d, u->len, u->pts_us)
+                           : ts_mux_write_video(&e->ts, d, u->len, u->pts_us, u->keyframe);
+            if (u->pts_us > last_pts) last_pts = u->pts_us;
+        }
+
+        pthread_mutex_lock(&e->lock);
+        e->rd = last;
+        if (ret != 0 || done || (e->closing && e->rd == e->u_head)) {
+            event_close_file(e, first_pts, last_pts, ret == 0);
+            e->recording = 0;
+            event_trim_preroll(e);
+        }
+    }
+    pthread_mutex_unlock(&e->lock);
+    return NULL;
+}
+
+/* ===================== 对外接口 ===================== */
+
+/*
+ * 打开事件 sink：分配环与封装缓冲，启动写线程（此后写入路径不再分配内存）。
+ *
+ * @param e        实例（调用者分配）
+ * @param pattern  片段文件名（strftime 格式）
+ * @param opts     参数（NULL 使用默认值）
+ * @return         0 成功；-1 失败
+ */
+int sink_event_open(SinkEvent *e, const char *pattern, const SinkEventOpts *opts)
+{
+    if (!e || !pattern || !pattern[0]) return -1;
+
+    memset(e, 0, sizeof(*e));
+    e->fd = -1;
+    if (opts) e->opts = *opts;
+    else sink_event_default_opts(&e->opts);
+    if (e->opts.ring_bytes < (1u << 20)) e->opts.ring_bytes = 1u << 20;
+    if (!e->opts.write_chunk) e->opts.write_chunk = 256u << 10;
+    snprintf(e->pattern, sizeof(e->pattern), "%s", pattern);
+    e->wait_key = 1;
+    atomic_init(&e->trig_req, 0);
+
+    e->cap   = e->opts.ring_bytes;
+    e->data  = (uint8_t *)mem_arena_alloc(MEM_STAGE_SINK, e->cap, 0);
+    e->units = (SinkEventUnit *)mem_arena_alloc(MEM_STAGE_SINK, SINK_EVENT_MAX_UNITS * sizeof(SinkEventUnit), 0);
+    e->gops  = (uint32_t *)mem_arena_alloc(MEM_STAGE_SINK, SINK_EVENT_MAX_GOPS * sizeof(uint32_t), 0);
+    e->stage = (uint8_t *)mem_arena_alloc(MEM_STAGE_SINK, e->opts.write_chunk, 0);
+    int ok = e->data && e->units && e->gops && e->stage;
+    if (!ok) LOGE("[%s] alloc failed", TAG);
+    if (ok && ts_mux_init(&e->ts, &e->opts.streams, event_ts_write, e) != 0) ok = 0;
+
+    if (ok) {
+        pthread_condattr_t ca;
+        pthread_condattr_init(&ca);
+        pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+        pthread_mutex_init(&e->lock, NULL);
+        pthread_cond_init(&e->cond, &ca);
+        pthread_condattr_destroy(&ca);
+        if (pthread_create(&e->th, NULL, event_thread, e) != 0) {
+            LOGE("[%s] pthread_create failed", TAG);
+            pthread_cond_destroy(&e->cond);
+            pthread_mutex_destroy(&e->lock);
+            ts_mux_deinit(&e->ts);
+            ok = 0;
+        }
+    }
+    if (!ok) {
+        mem_arena_free(e->data);
+        mem_arena_free(e->units);
+        mem_arena_free(e->gops);
+        mem_arena_free(e->stage);
+        e->data = NULL;
+        e->units = NULL;
+        e->gops = NULL;
+        e->stage = NULL;
+        return -1;
+    }
+    e->th_started = 1;
+
+    LOGI("[%s] open ok ring=%zuKB pre=%us post=%us -> %s", TAG,
+         e->cap >> 10, e->opts.pre_sec, e->opts.post_sec, e->pattern);
+    return 0;
+}
+
+/* 因空间不足丢弃本单元：视频帧丢了之后的 P 帧无法解码，等下一个关键帧。 */
+static void event_drop_unit(SinkEvent *e, int audio)
+{
+    e->dropped_units++;
+    if (audio) return;
+    e->wait_key = 1;
+    if (e->recording && e->opts.stats) av_stats_add_drop(e->opts.stats, 1);
+}
+
+/*
+ * 入环：先按预录时长回收最老的 GOP，空间仍不够时继续回收（录制中不越过读位置），再拷贝数据。
+ * 环为空时只接受视频关键帧，保证环首可解码。
+ */
+int sink_event_write(SinkEvent *e, const uint8_t *data, size_t len, int audio, int64_t pts_us, int keyframe)
+{
+    if (!e || !e->data || !data || !len) return -1;
+
+    pthread_mutex_lock(&e->lock);
+    /*
+     * 等关键帧期间：环为空时什么都不收；环内还有数据（录制中丢过视频帧）时 PCM 照收，
+     * 只有录制中的缺口才计入丢弃。
+     */
+    int key = !audio && keyframe;
+    if (e->wait_key && !key && (!audio || e->u_tail == e->u_head)) {
+        if (e->recording) event_drop_unit(e, audio);
+        pthread_mutex_unlock(&e->lock);
+        return 0;
+    }
+
+    e->last_pts_us = pts_us;
+    event_trim_preroll(e);
+
+    uint64_t off = 0;
+    int fits = (len <= e->cap / 2) && event_alloc(e, len, key, &off) == 0;
+    while (!fits && len <= e->cap / 2) {
+        int64_t held = e->u_tail != e->u_head ? e->last_pts_us - unit_at(e, e->u_tail)->pts_us : 0;
+        if (event_drop_gop(e) != 0) break;
+        if (!e->recording && !e->warned) {
+            LOGW("[%s] ring %zuKB holds only %.1fs, less than the %us pre-roll", TAG,
+                 e->cap >> 10, (double)held / 1e6, e->opts.pre_sec);
+            e->warned = 1;
+        }
+        if (e->u_tail == e->u_head && !key) break;   // 整环清空后只能从关键帧重新开始
+        fits = event_alloc(e, len, key, &off) == 0;
+    }
+    if (!fits) {
+        pthread_mutex_unlock(&e->lock);
+        return 0;
+    }
+    if (key) e->wait_key = 0;
+
+    memcpy(e->data + (size_t)(off % e->cap), data, len);
+    SinkEventUnit *u = unit_at(e, e->u_head);
+    u->off      = off;
+    u->len      = (uint32_t)len;
+    u->audio    = (uint8_t)(audio ? 1 : 0);
+    u->keyframe = (uint8_t)(keyframe ? 1 : 0);
+    u->pts_us   = pts_us;
+    if (key) e->gops[e->g_head++ % SINK_EVENT_MAX_GOPS] = e->u_head;
+    e->u_head++;
+    e->d_head = off + len;
+
+    if (e->recording || atomic_load_explicit(&e->trig_req, memory_order_relaxed))
+        pthread_cond_signal(&e->cond);
+    pthread_mutex_unlock(&e->lock);
+    return 0;
+}
+
+void sink_event_trigger(SinkEvent *e)
+{
+    if (!e) return;
+    atomic_store(&e->trig_req, 1);
+}
+
+void sink_event_close(SinkEvent *e)
+{
+    if (!e || !e->data) return;
+
+    if (e->th_started) {
+        pthread_mutex_lock(&e->lock);
+        e->closing = 1;
+        pthread_cond_signal(&e->cond);
+        pthread_mutex_unlock(&e->lock);
+        pthread_join(e->th, NULL);
+        e->th_started = 0;
+        pthread_cond_destroy(&e->cond);
+        pthread_mutex_destroy(&e->lock);
+    }
+
+    LOGI("[%s] closed, events=%llu dropped_units=%llu", TAG,
+         (unsigned long long)e->events, (unsigned long long)e->dropped_units);
+
+    ts_mux_deinit(&e->ts);
+    mem_arena_free(e->data);
+    mem_arena_free(e->units);
+    mem_arena_free(e->gops);
+    mem_arena_free(e->stage);
+    e->data = NULL;
+    e->units = NULL;
+    e->gops = NULL;
+    e->stage = NULL;
+}
@@ -0,0 +1,120 @@
+// sink_event.h
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "av_stats.h"
+#include "ts_mux.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 事件录像 sink：平时只在内存里保留最近 pre_sec 秒的 AU / PCM，不写盘；
+ * 触发后把这段预录（pre-roll）连同之后 post_sec 秒（post-roll）封装成一个 MPEG-TS 片段。
+ *
+ * - 字节环、单元环、GOP 起点环都在 open 时一次分配，写入路径只做 memcpy；
+ * - 环首始终是视频关键帧：首个关键帧之前的数据不入环，超出预录时长或空间时整 GOP 地从环首回收，
+ *   片段从第一个字节起就能解码；
+ * - 触发（sink_event_trigger）只置一个原子标志，可在信号处理函数中调用；
+ *   写线程取走标志后打开片段文件，从环首开始封装写出，直到 PTS 超过 触发时刻 + post_sec；
+ *   片段未结束时再次触发只顺延结束时刻；
+ * - 写线程正在写的单元不会被回收：写盘跟不上时丢弃新到的数据（视频丢到下一个关键帧），计入 drop_count。
+ */
+
+#define SINK_EVENT_MAX_UNITS 8192   // 环内最多的 AU/PCM 段数
+#define SINK_EVENT_MAX_GOPS  1024   // 环内最多的 GOP 数
+
+typedef struct {
+    unsigned int pre_sec;         // 预录时长，默认 10
+    unsigned int post_sec;        // 触发后继续录制的时长，默认 5
+    size_t       ring_bytes;      // 字节环大小，默认 16MB（需容纳 pre_sec + 一个 GOP 的码流）
+    size_t       write_chunk;     // 片段写盘的批量大小，默认 256KB
+    TsMuxStreams streams;         // 节目包含的流
+    AvStats     *stats;           // 可为 NULL
+} SinkEventOpts;
+
+/* 环中的一个单元（AU 或一段 PCM），数据连续存放在字节环中，不跨越环尾 */
+typedef struct {
+    uint64_t off;       // 环内起始位置（单调递增字节计数）
+    uint32_t len;
+    uint8_t  audio;     // 0=视频 1=音频
+    uint8_t  keyframe;
+    int64_t  pts_us;
+} SinkEventUnit;
+
+typedef struct {
+    SinkEventOpts   opts;
+    char            pattern[512]; // 片段文件名（strftime 格式，按触发时刻展开）
+
+    uint8_t        *data;         // 字节环
+    size_t          cap;
+    uint64_t        d_head;
+    uint64_t        d_tail;
+
+    SinkEventUnit  *units;        // 单元环
+    uint32_t        u_head;       // 下一个入环序号
+    uint32_t        u_tail;       // 环首（视频关键帧）
+    uint32_t       *gops;         // 各 GOP 起点的单元序号
+    uint32_t        g_head;
+    uint32_t        g_tail;
+    int             wait_key;     // 环为空或丢过视频帧：关键帧到来前不入环
+    int64_t         last_pts_us;  // 最近一个入环单元的 PTS
+
+    atomic_int      trig_req;     // 待处理的触发请求（异步安全）
+    int             recording;    // 正在写一个片段
+    uint32_t        rd;           // 片段下一个待写出的单元（recording 时环首不越过它）
+    int64_t         end_pts_us;   // 片段结束 PTS
+
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    pthread_t       th;
+    int             th_started;
+    int             closing;
+
+    TsMux           ts;           // 仅写线程使用，每个片段 ts_mux_reset 一次
+    int             fd;           // 当前片段文件
+    char            path[512];
+    uint8_t        *stage;        // 写盘前的批量缓冲（write_chunk 字节）
+    size_t          stage_len;
+
+    uint64_t        events;       // 已完成的片段数
+    uint64_t        clip_bytes;   // 当前片段已写字节
+    uint64_t        dropped_units;
+    int             warned;       // 已提示过环装不下预录时长
+} SinkEvent;
+
+void sink_event_default_opts(SinkEventOpts *opts);
+
+/*
+ * 分配环与封装缓冲并启动写线程。
+ *
+ * @param pattern  片段文件名，按触发时刻（本地时间）经 strftime 展开，
+ *                 例如 "event_%Y%m%d-%H%M%S.ts"；同名文件已存在时追加 -1、-2…
+ * @return         0 成功；-1 失败
+ */
+int  sink_event_open(SinkEvent *e, const char *pattern, const SinkEventOpts *opts);
+
+/*
+ * 入环一个 AU / PCM 段（拷贝后立即返回，不做 I/O）。
+ *
+ * @return  0 成功（含按策略丢弃）；-1 参数错误
+ */
+int  sink_event_write(SinkEvent *e, const uint8_t *data, size_t len, int audio, int64_t pts_us, int keyframe);
+
+/*
+ * 请求写出一个事件片段。只写原子变量，可在信号处理函数中调用；
+ * 写线程在 100ms 内或下一次 sink_event_write 时响应。
+ */
+void sink_event_trigger(SinkEvent *e);
+
+/* 正在写的片段写到当前环尾后结束，停止写线程并释放内存。 */
+void sink_event_close(SinkEvent *e);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,534 @@
+// sink_pipe.c
+#include "sink_pipe.h"
+#include "log.h"
+#include "media_clock.h"
+#include "mem_arena.h"
+#include "rt_sched.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define TAG "sink_pipe"
+
+#define PIPE_POLL_MS        100     // 管道写满时单次等待
+#define PIPE_DRAIN_MS       1000    // 关闭时最多等 ffmpeg 读完的时间
+#define PIPE_REAP_MS        2000    // 关闭管道后等待 ffmpeg 退出的时间
+
+extern char **environ;
+
+void sink_pipe_default_opts(SinkPipeOpts *opts)
+{
+    if (!opts) return;
+    memset(opts, 0, sizeof(*opts));
+    opts->ffmpeg         = "ffmpeg";
+    opts->queue_bytes    = 4u << 20;
+    opts->max_latency_ms = 200;
+    opts->write_chunk    = 64u << 10;
+    opts->streams.video  = 1;
+}
+
+static int64_t now_pts_us(void)
+{
+    return media_clock_pts(media_clock_now_us());
+}
+
+/* ===================== 队列（调用者持锁） ===================== */
+
+/* 按发送线程的批次状态回收单元与字节空间。 */
+static void pipe_reclaim(SinkPipe *p)
+{
+    uint32_t first = p->inflight ? p->u_done : p->u_tail;
+    p->u_done = first;
+    p->d_tail = (first == p->u_head) ? p->d_head : p->units[first % SINK_PIPE_MAX_UNITS].off;
+}
+
+/* 单元是否为关键帧 AU 的开头（整帧或第一片）：丢 GOP 只能停在这里 */
+static int unit_is_key_start(const SinkPipeUnit *u)
+{
+    return !u->audio && u->keyframe && TS_AU_STARTS(u->part);
+}
+
+/*
+ * 发送线程已送出某个分片 AU 的前几片时，队首到该 AU 结尾一片（含夹在中间的音频）必须照常送出，
+ * 否则 ffmpeg 收到截断的 AU。
+ *
+ * @return  队首需要保留的单元数；结尾一片还没入队时为整个队列
+ */
+static uint32_t pipe_open_au_units(const SinkPipe *p)
+{
+    if (!p->tx_open_au) return 0;
+    for (uint32_t i = p->u_tail; i != p->u_head; i++) {
+        const SinkPipeUnit *u = &p->units[i % SINK_PIPE_MAX_UNITS];
+        if (!u->audio && TS_AU_ENDS(u->part)) return i + 1 - p->u_tail;
+    }
+    return p->u_head - p->u_tail;
+}
+
+/*
+ * 生产者丢掉了一个 AU 的结尾一片：结尾还没入队的已部分送出 AU 就是它，已不可能完整，不再保留。
+ */
+static void pipe_abandon_open_au(SinkPipe *p)
+{
+    if (!p->tx_open_au) return;
+    for (uint32_t i = p->u_tail; i != p->u_head; i++) {
+        const SinkPipeUnit *u = &p->units[i % SINK_PIPE_MAX_UNITS];
+        if (!u->audio && TS_AU_ENDS(u->part)) return;
+    }
+    p->tx_open_au = 0;
+}
+
+/*
+ * 丢弃最老的 GOP：从已部分送出的 AU 之后开始（见 pipe_open_au_units），至少丢一个单元，
+ * 然后丢到下一个视频关键帧为止。队列里没有后续关键帧时全部丢弃，并要求下一个视频帧必须是关键帧。
+ * 视频按 AU 计数：分片 AU 只在结尾一片处计一帧。
+ *
+ * @return  丢弃的单元数；0 = 没有可丢的单元
+ */
+static uint32_t pipe_drop_gop(SinkPipe *p)
+{
+    uint32_t keep  = pipe_open_au_units(p);
+    uint32_t start = p->u_tail + keep;
+    if (start == p->u_head) return 0;
+
+    uint32_t i = start;
+    uint32_t video = 0;
+    do {
+        const SinkPipeUnit *u = &p->units[i % SINK_PIPE_MAX_UNITS];
+        if (!u->audio && TS_AU_ENDS(u->part)) video++;
+        i++;
+    } while (i != p->u_head && !unit_is_key_start(&p->units[i % SINK_PIPE_MAX_UNITS]));
+
+    /* 保留的单元后移到丢弃区间末尾，与剩下的队列相接；它们的 off 更小，字节仍按顺序回收 */
+    uint32_t n = i - start;
+    for (uint32_t k = keep; k > 0; k--)
+        p->units[(p->u_tail + k - 1 + n) % SINK_PIPE_MAX_UNITS] = p->units[(p->u_tail + k - 1) % SINK_PIPE_MAX_UNITS];
+    p->u_tail += n;
+    if (i == p->u_head) p->wait_key = 1;
+    pipe_reclaim(p);
+
+    p->dropped_units += n;
+    if (p->opts.stats) {
+        atomic_fetch_add_explicit(&p->opts.stats->net_drop_gops, 1, memory_order_relaxed);
+        if (video) av_stats_add_drop(p->opts.stats, video);
+    }
+    return n;
+}
+
+/* 计算放入 len 字节需要的起始位置（不跨越环尾）。@return 0 放得下；-1 放不下 */
+static int pipe_alloc(const SinkPipe *p, size_t len, uint64_t *off)
+{
+    if (p->u_head - p->u_done >= SINK_PIPE_MAX_UNITS) return -1;
+    uint64_t o = p->d_head;
+    size_t pos = (size_t)(o % p->cap);
+    if (pos + len > p->cap) o += p->cap - pos;
+    if (o + len - p->d_tail > p->cap) return -1;
+    *off = o;
+    return 0;
+}
+
+/*
+ * 发送线程取一个批次：从 u_tail 起最多 write_chunk 字节的单元（批次为 u_done..返回值）。
+ * 批次可能停在分片 AU 中间，此时置 tx_open_au，该 AU 的其余片之后不会被丢 GOP 丢掉。
+ */
+static uint32_t pipe_take_batch(SinkPipe *p)
+{
+    size_t bytes = 0;
+    p->u_done = p->u_tail;
+    while (p->u_tail != p->u_head && bytes < p->opts.write_chunk) {
+        const SinkPipeUnit *u = &p->units[p->u_tail % SINK_PIPE_MAX_UNITS];
+        bytes += u->len;
+        if (!u->audio) p->tx_open_au = !TS_AU_ENDS(u->part);
+        p->u_tail++;
+    }
+    p->inflight = 1;
+    return p->u_tail;
+}
+
+/* ===================== 发送线程 ===================== */
+
+/*
+ * 非阻塞写满 len 字节：管道满时 poll 等待。关闭过程中累计等待超过 PIPE_DRAIN_MS 放弃。
+ *
+ * @return  0 成功；-1 管道断开或关闭超时
+ */
+static int pipe_write_all(SinkPipe *p, const uint8_t *buf, size_t len)
+{
+    int waited_ms = 0;
+    while (len) {
+        TRACE_BEGIN("pipe_write len=%zu", len);
+        ssize_t n = write(p->fd, buf, len);
+        TRACE_END();
+        if (n > 0) {
+            buf += n;
+            len -= (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno != EAGAIN) {
+            LOGE("[%s] write to ffmpeg failed: %s", TAG, strerror(errno));
+            return -1;
+        }
+
+        struct pollfd pfd = { .fd = p->fd, .events = POLLOUT };
+        int pr = poll(&pfd, 1, PIPE_POLL_MS);
+        if (pr > 0 && (pfd.revents & (POLLERR | POLLHUP))) {
+            LOGE("[%s] ffmpeg closed its input", TAG);
+            return -1;
+        }
+        if (pr == 0) {
+            waited_ms += PIPE_POLL_MS;
+            pthread_mutex_lock(&p->lock);
+            int closing = p->closing;
+            pthread_mutex_unlock(&p->lock);
+            if (closing && waited_ms >= PIPE_DRAIN_MS) {
+                LOGW("[%s] ffmpeg not reading, give up %zu bytes", TAG, len);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* TS 封装回调：攒进 stage，满了写一次管道。 */
+static int pipe_ts_write(void *opaque, const uint8_t *data, size_t len)
+{
+    SinkPipe *p = (SinkPipe *)opaque;
+    while (len) {
+        size_t room = p->opts.write_chunk - p->stage_len;
+        size_t n = len < room ? len : room;
+        memcpy(p->stage + p->stage_len, data, n);
+        p->stage_len += n;
+        data += n;
+        len  -= n;
+        if (p->stage_len == p->opts.write_chunk) {
+            if (pipe_write_all(p, p->stage, p->stage_len) != 0) return -1;
+            p->sent_bytes += p->stage_len;
+            p->stage_len = 0;
+        }
+    }
+    return 0;
+}
+
+/*
+ * 发送线程：每次取出队列中最多 write_chunk 字节的单元作为一个批次，
+ * 解锁后封装并写管道，写完再回收空间。批次期间生产者只能丢弃批次之后的单元。
+ */
+static void *pipe_thread(void *arg)
+{
+    SinkPipe *p = (SinkPipe *)arg;
+    rt_sched_apply(RT_ROLE_SINK, "sink-pipe");
+
+    pthread_mutex_lock(&p->lock);
+    for (;;) {
+        while (!p->closing && p->u_tail == p->u_head)
+            pthread_cond_wait(&p->cond, &p->lock);
+        if (p->u_tail == p->u_head) break;   // closing 且已发完
+
+        uint32_t first = p->u_tail;
+        uint32_t last  = pipe_take_batch(p);
+        pthread_mutex_unlock(&p->lock);
+
+        int ret = 0;
+        for (uint32_t i = first; i != last && ret == 0; i++) {
+            const SinkPipeUnit *u = &p->units[i % SINK_PIPE_MAX_UNITS];
+            const uint8_t *d = p->data + (size_t)(u->off % p->cap);
+            ret = u->audio ? ts_mux_write_audio(&p->ts, d, u->len, u->pts_us)
+                           : ts_mux_write_video_part(&p->ts, d, u->len, u->pts_us, u->keyframe,
+                                                     (TsAuPart)u->part);
+        }
+        if (ret == 0 && p->stage_len) {
+            ret = pipe_write_all(p, p->stage, p->stage_len);
+            if (ret == 0) p->sent_bytes += p->stage_len;
+            p->stage_len = 0;
+        }
+
+        /* 采集 -> 交给 ffmpeg 的延迟：取批次内最老的单元 */
+        if (ret == 0 && p->opts.stats) {
+            int64_t oldest = p->units[first % SINK_PIPE_MAX_UNITS].pts_us;
+            for (uint32_t i = first; i != last; i++) {
+                int64_t t = p->units[i % SINK_PIPE_MAX_UNITS].pts_us;
+                if (t < oldest) oldest = t;
+            }
+            int64_t lat = now_pts_us() - oldest;
+            av_stats_observe_max(&p->opts.stats->net_lat_max_us, (uint64_t)(lat > 0 ? lat : 0));
+        }
+
+        pthread_mutex_lock(&p->lock);
+        p->inflight = 0;
+        pipe_reclaim(p);
+        if (ret != 0) {
+            p->error = 1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&p->lock);
+    return NULL;
+}
+
+/* ===================== ffmpeg 子进程 ===================== */
+
+/* 按 URL scheme 选择输出封装；FLV/RTSP 不能承载 302M PCM，音频交给 ffmpeg 转 AAC。 */
+static const char *url_format(const char *url, int *need_aac)
+{
+    *need_aac = 0;
+    if (strncmp(url, "rtmp://", 7) == 0 || strncmp(url, "rtmps://", 8) == 0) { *need_aac = 1; return "flv"; }
+    if (strncmp(url, "rtsp://", 7) == 0) { *need_aac = 1; return "rtsp"; }
+    if (strncmp(url, "srt://", 6) == 0 || strncmp(url, "udp://", 6) == 0) return "mpegts";
+    return NULL;
+}
+
+static int spawn_ffmpeg(SinkPipe *p, const char *url)
+{
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+        LOGE("[%s] pipe2 failed: %s", TAG, strerror(errno));
+        return -1;
+    }
+
+    int need_aac = 0;
+    const char *fmt = url_format(url, &need_aac);
+    const char *argv[40];
+    int n = 0;
+    argv[n++] = p->opts.ffmpeg;
+    argv[n++] = "-hide_banner";
+    argv[n++] = "-loglevel";       argv[n++] = "warning";
+    /* 输入端：不探测、不缓冲，TS 头里已有全部流信息 */
+    argv[n++] = "-fflags";         argv[n++] = "nobuffer";
+    argv[n++] = "-flags";          argv[n++] = "low_delay";
+    argv[n++] = "-probesize";      argv[n++] = "32768";
+    argv[n++] = "-analyzeduration"; argv[n++] = "0";
+    argv[n++] = "-f";              argv[n++] = "mpegts";
+    argv[n++] = "-i";              argv[n++] = "pipe:0";
+    argv[n++] = "-map";            argv[n++] = "0";
+    argv[n++] = "-c:v";            argv[n++] = "copy";
+    if (p->opts.streams.audio_rate) {
+        argv[n++] = "-c:a";        argv[n++] = need_aac ? "aac" : "copy";
+    }
+    argv[n++] = "-flush_packets";  argv[n++] = "1";
+    if (fmt) {
+        argv[n++] = "-f";          argv[n++] = fmt;
+    }
+    argv[n++] = url;
+    argv[n]   = NULL;
+
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_adddup2(&fa, fds[0], STDIN_FILENO);
+
+    pid_t pid;
+    int ret = posix_spawnp(&pid, p->opts.ffmpeg, &fa, NULL, (char *const *)argv, environ);
+    posix_spawn_file_actions_destroy(&fa);
+    close(fds[0]);
+    if (ret != 0) {
+        LOGE("[%s] spawn %s failed: %s", TAG, p->opts.ffmpeg, strerror(ret));
+        close(fds[1]);
+        return -1;
+    }
+
+    fcntl(fds[1], F_SETFL, fcntl(fds[1], F_GETFL) | O_NONBLOCK);
+    p->fd  = fds[1];
+    p->pid = pid;
+    LOGI("[%s] ffmpeg pid=%d -> %s (%s%s)", TAG, (int)pid, url, fmt ? fmt : "auto",
+         need_aac ? ", audio->aac" : "");
+    return 0;
+}
+
+/* 关闭管道后等 ffmpeg 自行退出（写完尾部），超时则 SIGTERM。 */
+static void reap_ffmpeg(pid_t pid)
+{
+    for (int waited = 0; waited < PIPE_REAP_MS; waited += 50) {
+        int status;
+        pid_t r = waitpid(pid, &status, WNOHANG);
+        if (r == pid || r < 0) {
+            if (r == pid && WIFEXITED(status) && WEXITSTATUS(status) != 0)
+                LOGW("[%s] ffmpeg exited with %d", TAG, WEXITSTATUS(status));
+            return;
+        }
+        struct timespec ts = { 0, 50 * 1000000L };
+        nanosleep(&ts, NULL);
+    }
+    LOGW("[%s] ffmpeg did not exit, sending SIGTERM", TAG);
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+}
+
+/* ===================== 对外接口 ===================== */
+
+/*
+ * 打开推流 sink：分配队列与批量缓冲，初始化封装器，启动 ffmpeg 与发送线程。
+ *
+ * @param p     实例（调用者分配）
+ * @param url   推流地址
+ * @param opts  参数（NULL 使用默认值；ffmpeg 字符串需在 sink 生命周期内有效）
+ * @return      0 成功；-1 失败
+ */
+int sink_pipe_open(SinkPipe *p, const char *url, const SinkPipeOpts *opts)
+{
+    if (!p || !url || !url[0]) return -1;
+
+    memset(p, 0, sizeof(*p));
+    p->fd  = -1;
+    p->pid = -1;
+    if (opts) p->opts = *opts;
+    else sink_pipe_default_opts(&p->opts);
+    if (!p->opts.ffmpeg) p->opts.ffmpeg = "ffmpeg";
+    if (p->opts.queue_bytes < (256u << 10)) p->opts.queue_bytes = 256u << 10;
+    if (!p->opts.write_chunk) p->opts.write_chunk = 64u << 10;
+    if (!p->opts.max_latency_ms) p->opts.max_latency_ms = 200;
+
+    p->cap   = p->opts.queue_bytes;
+    p->data  = (uint8_t *)mem_arena_alloc(MEM_STAGE_SINK, p->cap, 0);
+    p->units = (SinkPipeUnit *)mem_arena_alloc(MEM_STAGE_SINK, SINK_PIPE_MAX_UNITS * sizeof(SinkPipeUnit), 0);
+    p->stage = (uint8_t *)mem_arena_alloc(MEM_STAGE_SINK, p->opts.write_chunk, 0);
+    if (!p->data || !p->units || !p->stage) {
+        LOGE("[%s] alloc failed", TAG);
+        goto fail;
+    }
+    if (ts_mux_init(&p->ts, &p->opts.streams, pipe_ts_write, p) != 0) goto fail;
+
+    /* ffmpeg 退出后写管道会收到 SIGPIPE，改为由 write 返回 EPIPE 处理。 */
+    signal(SIGPIPE, SIG_IGN);
+    if (spawn_ffmpeg(p, url) != 0) goto fail_mux;
+
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->cond, NULL);
+    if (pthread_create(&p->th, NULL, pipe_thread, p) != 0) {
+        LOGE("[%s] pthread_create failed", TAG);
+        pthread_cond_destroy(&p->cond);
+        pthread_mutex_destroy(&p->lock);
+        close(p->fd);
+        p->fd = -1;
+        reap_ffmpeg(p->pid);
+        goto fail_mux;
+    }
+    p->th_started = 1;
+
+    LOGI("[%s] open ok queue=%zuKB max_latency=%ums chunk=%zuKB", TAG,
+         p->cap >> 10, p->opts.max_latency_ms, p->opts.write_chunk >> 10);
+    return 0;
+
+fail_mux:
+    ts_mux_deinit(&p->ts);
+fail:
+    mem_arena_free(p->data);
+    mem_arena_free(p->units);
+    mem_arena_free(p->stage);
+    p->data = NULL;
+    p->units = NULL;
+    p->stage = NULL;
+    return -1;
+}
+
+/*
+ * 入队：先按延迟预算与空间丢弃最老 GOP，再拷贝数据。
+ * 视频帧因空间不足被丢时后续 P 帧无法解码，置 wait_key 直到下一个关键帧。
+ */
+int sink_pipe_write(SinkPipe *p, const uint8_t *data, size_t len, int audio, int64_t pts_us, int keyframe,
+                    TsAuPart part)
+{
+    if (!p || !p->data || !data || !len) return -1;
+
+    pthread_mutex_lock(&p->lock);
+    if (p->error) {
+        pthread_mutex_unlock(&p->lock);
+        return -1;
+    }
+
+    /* 延迟预算：可丢的最老数据（已部分送出的 AU 之后）已超时则整 GOP 丢弃 */
+    int64_t now = now_pts_us();
+    int64_t budget = (int64_t)p->opts.max_latency_ms * 1000;
+    for (;;) {
+        uint32_t s = p->u_tail + pipe_open_au_units(p);
+        if (s == p->u_head || now - p->units[s % SINK_PIPE_MAX_UNITS].pts_us <= budget) break;
+        pipe_drop_gop(p);
+    }
+
+    if (!audio && p->wait_key) {
+        if (!keyframe || !TS_AU_STARTS(part)) {
+            p->dropped_units++;
+            if (TS_AU_ENDS(part)) pipe_abandon_open_au(p);
+            if (p->opts.stats && TS_AU_ENDS(part)) av_stats_add_drop(p->opts.stats, 1);
+            pthread_mutex_unlock(&p->lock);
+            return 0;
+        }
+        p->wait_key = 0;
+    }
+
+    uint64_t off = 0;
+    int fits = (len <= p->cap / 2) && pipe_alloc(p, len, &off) == 0;
+    while (!fits && len <= p->cap / 2 && pipe_drop_gop(p))
+        fits = pipe_alloc(p, len, &off) == 0;
+    if (!fits) {
+        /* 发送线程手里的批次还没写完，或单元过大：丢弃本单元 */
+        p->dropped_units++;
+        if (!audio) {
+            /* 分片 AU 的其余片随后在 wait_key 处丢弃，整帧在结尾一片计一次 */
+            p->wait_key = 1;
+            if (TS_AU_ENDS(part)) pipe_abandon_open_au(p);
+            if (p->opts.stats && TS_AU_ENDS(part)) av_stats_add_drop(p->opts.stats, 1);
+        }
+        pthread_mutex_unlock(&p->lock);
+        return 0;
+    }
+
+    memcpy(p->data + (size_t)(off % p->cap), data, len);
+    SinkPipeUnit *u = &p->units[p->u_head % SINK_PIPE_MAX_UNITS];
+    u->off      = off;
+    u->len      = (uint32_t)len;
+    u->audio    = (uint8_t)(audio ? 1 : 0);
+    u->keyframe = (uint8_t)(keyframe ? 1 : 0);
+    u->part     = (uint8_t)(audio ? TS_AU_WHOLE : part);
+    u->pts_us   = pts_us;
+    p->u_head++;
+    p->d_head = off + len;
+
+    if (p->opts.stats) av_stats_observe_max(&p->opts.stats->net_queue_max, p->d_head - p->d_tail);
+    pthread_cond_signal(&p->cond);
+    pthread_mutex_unlock(&p->lock);
+    return 0;
+}
+
+void sink_pipe_close(SinkPipe *p)
+{
+    if (!p || !p->data) return;
+
+    if (p->th_started) {
+        pthread_mutex_lock(&p->lock);
+        p->closing = 1;
+        pthread_cond_signal(&p->cond);
+        pthread_mutex_unlock(&p->lock);
+        pthread_join(p->th, NULL);
+        p->th_started = 0;
+        pthread_cond_destroy(&p->cond);
+        pthread_mutex_destroy(&p->lock);
+    }
+
+    if (p->fd >= 0) {
+        close(p->fd);   // ffmpeg 读到 EOF 后写完尾部退出
+        p->fd = -1;
+    }
+    if (p->pid > 0) {
+        reap_ffmpeg(p->pid);
+        p->pid = -1;
+    }
+
+    LOGI("[%s] closed, sent=%lluKB dropped_units=%llu", TAG,
+         (unsigned long long)(p->sent_bytes >> 10), (unsigned long long)p->dropped_units);
+
+    ts_mux_deinit(&p->ts);
+    mem_arena_free(p->data);
+    mem_arena_free(p->units);
+    mem_arena_free(p->stage);
+    p->data = NULL;
+    p->units = NULL;
+    p->stage = NULL;
+}
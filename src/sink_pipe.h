@@ -0,0 +1,105 @@
+// sink_pipe.h
+#pragma once
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "av_stats.h"
+#include "ts_mux.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 低延迟推流 sink：子进程 ffmpeg 从 stdin 读 MPEG-TS，只做 -c copy 转封装推到 RTMP/SRT/RTSP。
+ *
+ * - 调用者（视频写出线程、音频线程）只把 AU / PCM 段拷进预分配的发送队列即返回，从不阻塞；
+ * - 独立发送线程把队列里的数据封装成 TS（ts_mux），攒成大块后非阻塞 write 进管道；
+ * - 队首数据的采集时刻超过 max_latency_ms，或队列满时，从队首丢弃整个最老的 GOP
+ *   （丢到下一个视频关键帧为止），不让延迟无限累积，也不送出缺参考帧的 P 帧；
+ * - 封装在发送线程里做，丢弃的是封装前的数据，TS 连续计数不会断。
+ */
+
+#define SINK_PIPE_MAX_UNITS 1024   // 队列中最多的 AU/PCM 段数
+
+typedef struct {
+    const char  *ffmpeg;          // ffmpeg 可执行文件，默认 "ffmpeg"（PATH 查找）
+    size_t       queue_bytes;     // 发送队列大小，默认 4MB
+    unsigned int max_latency_ms;  // 队首允许的最大“采集 -> 发送”延迟，默认 200
+    size_t       write_chunk;     // 单次写管道的批量大小，默认 64KB
+    TsMuxStreams streams;         // 节目包含的流
+    AvStats     *stats;           // 可为 NULL
+} SinkPipeOpts;
+
+/* 队列中的一个单元（AU 或一段 PCM），数据连续存放在字节环中，不跨越环尾 */
+typedef struct {
+    uint64_t off;       // 环内起始位置（单调递增字节计数）
+    uint32_t len;
+    uint8_t  audio;     // 0=视频 1=音频
+    uint8_t  keyframe;
+    uint8_t  part;      // TsAuPart：视频 AU 的第几片（整帧为 TS_AU_WHOLE）
+    int64_t  pts_us;
+} SinkPipeUnit;
+
+typedef struct {
+    int             fd;          // 管道写端（O_NONBLOCK）
+    pid_t           pid;         // ffmpeg 子进程
+    SinkPipeOpts    opts;
+
+    uint8_t        *data;        // 字节环
+    size_t          cap;
+    uint64_t        d_head;      // 下一个单元的写入位置
+    uint64_t        d_tail;      // 已可回收的位置
+
+    SinkPipeUnit   *units;       // 单元环
+    uint32_t        u_head;      // 下一个入队序号
+    uint32_t        u_tail;      // 下一个待发送序号（丢弃从这里开始）
+    uint32_t        u_done;      // 已回收序号（u_done..u_tail 为发送线程正在处理的批次）
+    int             inflight;    // 发送线程持有一个批次
+    int             wait_key;    // 丢过视频帧：关键帧到来前丢弃后续视频帧
+    int             tx_open_au;  // 发送线程已取走某个分片 AU 的前几片，其余片不能丢
+
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    pthread_t       th;
+    int             th_started;
+    int             closing;
+    int             error;       // 管道断开 / ffmpeg 退出
+
+    TsMux           ts;          // 仅发送线程使用
+    uint8_t        *stage;       // 写管道前的批量缓冲（write_chunk 字节）
+    size_t          stage_len;
+
+    uint64_t        sent_bytes;
+    uint64_t        dropped_units;
+} SinkPipe;
+
+void sink_pipe_default_opts(SinkPipeOpts *opts);
+
+/*
+ * 启动 ffmpeg 子进程并开始发送线程。
+ *
+ * @param url  推流地址：rtmp:// -> flv，rtsp:// -> rtsp，srt:// / udp:// -> mpegts，
+ *             其他交给 ffmpeg 按扩展名判断
+ * @return     0 成功；-1 失败
+ */
+int  sink_pipe_open(SinkPipe *p, const char *url, const SinkPipeOpts *opts);
+
+/*
+ * 入队一个 AU / PCM 段（拷贝后立即返回）。超延迟或队列满时按丢 GOP 策略丢弃，仍返回 0。
+ * 分片的视频 AU 每片一个单元（part 见 TsAuPart），丢弃只在关键帧 AU 的开头一片处停下。
+ *
+ * @return  0 成功（含被策略丢弃）；-1 管道已断开
+ */
+int  sink_pipe_write(SinkPipe *p, const uint8_t *data, size_t len, int audio, int64_t pts_us, int keyframe,
+                     TsAuPart part);
+
+/* 尽量发完队列（最多约 1 秒），关闭管道并回收 ffmpeg。 */
+void sink_pipe_close(SinkPipe *p);
+
+#ifdef __cplusplus
+}
+#endif
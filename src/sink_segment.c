@@ -0,0 +1,386 @@
+// sink_segment.c
+#include "sink_segment.h"
+#include "log.h"
+#include "rt_sched.h"
+
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TAG "segment"
+
+#define SEG_RETRY_MS 1000   // 创建下一段失败后的重试间隔
+
+void sink_segment_default_opts(SinkSegmentOpts *opts)
+{
+    if (!opts) return;
+    memset(opts, 0, sizeof(*opts));
+}
+
+int sink_segment_enabled(const SinkSegmentOpts *opts)
+{
+    return opts && (opts->seg_sec || opts->seg_bytes);
+}
+
+/* cond 使用 CLOCK_MONOTONIC，计算 timeout_ms 之后的绝对时间。 */
+static void deadline_after(struct timespec *ts, unsigned int timeout_ms)
+{
+    clock_gettime(CLOCK_MONOTONIC, ts);
+    ts->tv_sec  += timeout_ms / 1000;
+    ts->tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (ts->tv_nsec >= 1000000000L) {
+        ts->tv_sec++;
+        ts->tv_nsec -= 1000000000L;
+    }
+}
+
+/* "rec/out.h264" -> dir "rec"，stem "out"，ext ".h264"（没有目录时为 "."） */
+static void split_target(SinkSegment *s, const char *target)
+{
+    const char *slash = strrchr(target, '/');
+    const char *name  = slash ? slash + 1 : target;
+    if (slash) snprintf(s->dir, sizeof(s->dir), "%.*s", (int)(slash - target), target);
+    else snprintf(s->dir, sizeof(s->dir), ".");
+    if (!s->dir[0]) snprintf(s->dir, sizeof(s->dir), "/");
+
+    const char *dot = strrchr(name, '.');
+    if (!dot || dot == name) dot = name + strlen(name);
+    snprintf(s->stem, sizeof(s->stem), "%.*s", (int)(dot - name), name);
+    snprintf(s->ext, sizeof(s->ext), "%s", dot);
+}
+
+static void segment_path(const SinkSegment *s, uint32_t idx, char *out, size_t cap)
+{
+    snprintf(out, cap, "%s/%s_%s_%06u%s", s->dir, s->stem, s->session, idx, s->ext);
+}
+
+/*
+ * 创建一段文件并按 prealloc_bytes 预分配（KEEP_SIZE：文件长度仍为实际写入量）。
+ * 文件系统不支持 fallocate 时只告警一次，不影响录制。
+ *
+ * @return  fd；-1 失败
+ */
+static int segment_create(SinkSegment *s, const char *path)
+{
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOGE("[%s] create %s failed: %s", TAG, path, strerror(errno));
+        return -1;
+    }
+    if (s->opts.prealloc_bytes &&
+        fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)s->opts.prealloc_bytes) != 0) {
+        static atomic_int warned;
+        if (atomic_exchange(&warned, 1) == 0)
+            LOGW("[%s] fallocate %lluKB on %s failed: %s, segments are not preallocated", TAG,
+                 (unsigned long long)(s->opts.prealloc_bytes >> 10), path, strerror(errno));
+    }
+    return fd;
+}
+
+/*
+ * 收尾一段：数据落盘，截掉没用到的预分配空间后关闭。
+ * 断电时已完成的段都是完整的。
+ */
+static void segment_finish(int fd, uint64_t bytes, const char *path, int64_t dur_us)
+{
+    if (fdatasync(fd) != 0) LOGW("[%s] fdatasync %s failed: %s", TAG, path, strerror(errno));
+    if (ftruncate(fd, (off_t)bytes) != 0) LOGW("[%s] ftruncate %s failed: %s", TAG, path, strerror(errno));
+    close(fd);
+    LOGI("[%s] %s done: %.1fs %lluKB", TAG, path, (double)dur_us / 1e6, (unsigned long long)(bytes >> 10));
+}
+
+/* 是否为本路输出的分段文件：<stem>_YYYYmmdd-HHMMSS_<数字><ext>（不会匹配到别的码流的文件） */
+static int is_segment_name(const SinkSegment *s, const char *name)
+{
+    size_t ls = strlen(s->stem), le = strlen(s->ext), n = strlen(name);
+    if (n < ls + 1 + 15 + 1 + 1 + le) return 0;
+    if (strncmp(name, s->stem, ls) != 0 || name[ls] != '_') return 0;
+    if (strcmp(name + n - le, s->ext) != 0) return 0;
+
+    const char *p = name + ls + 1;
+    for (int i = 0; i < 15; i++) {
+        if (i == 8 ? p[i] != '-' : !isdigit((unsigned char)p[i])) return 0;
+    }
+    if (p[15] != '_') return 0;
+    const char *end = name + n - le;
+    for (p += 16; p < end; p++) {
+        if (!isdigit((unsigned char)*p)) return 0;
+    }
+    return 1;
+}
+
+static int cmp_name(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/*
+ * 保留策略：目录内本路的分段文件（含之前会话留下的）超过 keep 个时，按名字从最老的开始删除。
+ * 正在写的段与预建的下一段不删除。
+ */
+static void segment_retention(SinkSegment *s, const char *cur, const char *next)
+{
+    if (!s->opts.keep) return;
+    DIR *d = opendir(s->dir);
+    if (!d) {
+        LOGW("[%s] opendir %s failed: %s", TAG, s->dir, strerror(errno));
+        return;
+    }
+
+    char **names = NULL;
+    size_t n = 0, cap = 0;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        if (!is_segment_name(s, de->d_name)) continue;
+        if (n == cap) {
+            size_t nc = cap ? cap * 2 : 64;
+            char **nn = (char **)realloc(names, nc * sizeof(*names));
+            if (!nn) break;
+            names = nn;
+            cap = nc;
+        }
+        names[n] = strdup(de->d_name);
+        if (names[n]) n++;
+    }
+    closedir(d);
+
+    qsort(names, n, sizeof(*names), cmp_name);
+    /* 预建的下一段还是空文件，不算在保留数里 */
+    size_t live = n;
+    const char *next_base = strrchr(next, '/') ? strrchr(next, '/') + 1 : next;
+    for (size_t i = 0; i < n; i++) {
+        if (strcmp(names[i], next_base) == 0) live--;
+    }
+
+    const char *cur_base = strrchr(cur, '/') ? strrchr(cur, '/') + 1 : cur;
+    for (size_t i = 0; i < n && live > s->opts.keep; i++) {
+        if (strcmp(names[i], cur_base) == 0 || strcmp(names[i], next_base) == 0) continue;
+        char path[768];
+        snprintf(path, sizeof(path), "%s/%s", s->dir, names[i]);
+        if (unlink(path) == 0) LOGI("[%s] retention: removed %s", TAG, path);
+        else LOGW("[%s] remove %s failed: %s", TAG, path, strerror(errno));
+        live--;
+    }
+
+    for (size_t i = 0; i < n; i++) free(names[i]);
+    free(names);
+}
+
+/*
+ * 后台线程：收尾写线程交回来的旧段并执行保留策略，然后预建下一段。
+ * 文件系统操作都在这里做，只在交接 fd 时持锁。
+ */
+static void *segment_thread(void *arg)
+{
+    SinkSegment *s = (SinkSegment *)arg;
+    rt_sched_apply(RT_ROLE_SINK, "sink-segment");
+
+    pthread_mutex_lock(&s->lock);
+    for (;;) {
+        if (s->done_fd >= 0) {
+            int fd = s->done_fd;
+            uint64_t bytes = s->done_bytes;
+            int64_t dur = s->done_dur_us;
+            char path[512], cur[512], next[512];
+            snprintf(path, sizeof(path), "%s", s->done_path);
+            snprintf(cur, sizeof(cur), "%s", s->cur_name);
+            snprintf(next, sizeof(next), "%s", s->next_fd >= 0 ? s->next_path : "");
+            pthread_mutex_unlock(&s->lock);
+
+            segment_finish(fd, bytes, path, dur);
+            segment_retention(s, cur, next);
+
+            pthread_mutex_lock(&s->lock);
+            s->done_fd = -1;
+            s->segments++;
+            continue;
+        }
+        if (s->closing) break;
+        if (s->next_fd < 0) {
+            /* 写线程只在 next_fd 就绪后才推进 idx，这里读到的就是当前段 */
+            char path[512];
+            segment_path(s, s->idx + 1, path, sizeof(path));
+            pthread_mutex_unlock(&s->lock);
+
+            int fd = segment_create(s, path);
+
+            pthread_mutex_lock(&s->lock);
+            if (fd >= 0) {
+                s->next_fd = fd;
+                snprintf(s->next_path, sizeof(s->next_path), "%s", path);
+                continue;
+            }
+            struct timespec ts;
+            deadline_after(&ts, SEG_RETRY_MS);
+            pthread_cond_timedwait(&s->cond, &s->lock, &ts);
+            continue;
+        }
+        pthread_cond_wait(&s->cond, &s->lock);
+    }
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
+}
+
+/*
+ * 打开分段输出：创建第一段，启动后台线程预建第二段。
+ *
+ * @param s       实例（调用者分配）
+ * @param target  名义输出路径
+ * @param opts    参数（seg_sec / seg_bytes 至少一个非 0）
+ * @return        0 成功；-1 失败
+ */
+int sink_segment_open(SinkSegment *s, const char *target, const SinkSegmentOpts *opts)
+{
+    if (!s || !target || !target[0] || !sink_segment_enabled(opts)) return -1;
+
+    memset(s, 0, sizeof(*s));
+    s->opts    = *opts;
+    s->fd      = -1;
+    s->next_fd = -1;
+    s->done_fd = -1;
+    split_target(s, target);
+
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    strftime(s->session, sizeof(s->session), "%Y%m%d-%H%M%S", &tm);
+
+    segment_path(s, 0, s->path, sizeof(s->path));
+    s->fd = segment_create(s, s->path);
+    if (s->fd < 0) return -1;
+    snprintf(s->cur_name, sizeof(s->cur_name), "%s", s->path);
+
+    pthread_condattr_t ca;
+    pthread_condattr_init(&ca);
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, &ca);
+    pthread_condattr_destroy(&ca);
+    if (pthread_create(&s->th, NULL, segment_thread, s) != 0) {
+        LOGE("[%s] pthread_create failed", TAG);
+        pthread_cond_destroy(&s->cond);
+        pthread_mutex_destroy(&s->lock);
+        close(s->fd);
+        unlink(s->path);
+        s->fd = -1;
+        return -1;
+    }
+    s->th_started = 1;
+
+    LOGI("[%s] %s: every %us / %lluKB, keep %u, prealloc %lluKB%s", TAG, s->path, s->opts.seg_sec,
+         (unsigned long long)(s->opts.seg_bytes >> 10), s->opts.keep,
+         (unsigned long long)(s->opts.prealloc_bytes >> 10), s->opts.follow ? ", follows video cuts" : "");
+    return 0;
+}
+
+/*
+ * 是否到了切分点。
+ * - leader：关键帧处，时长或大小达到阈值；
+ * - follower：leader 已开始更新的一段且本单元 PTS 不早于其起点；leader 停了（视频没起来）时
+ *   按 2 倍时长 / 同样的大小自行切分，文件不会无限增长。
+ */
+static int segment_due(SinkSegment *s, int64_t pts_us, int keyframe)
+{
+    /* 留 100ms 余量：GOP 正好等于段长时，采集时间戳的抖动不至于让切分错过一个关键帧 */
+    int64_t dur = pts_us - s->start_pts_us + 100000;
+    int by_time  = s->opts.seg_sec && dur >= (int64_t)s->opts.seg_sec * 1000000;
+    int by_bytes = s->opts.seg_bytes && s->bytes >= s->opts.seg_bytes;
+
+    if (s->opts.follow && s->opts.clock) {
+        unsigned int seq = atomic_load_explicit(&s->opts.clock->seq, memory_order_acquire);
+        if (seq > s->idx && pts_us >= atomic_load_explicit(&s->opts.clock->start_pts, memory_order_relaxed))
+            return 1;
+        return (s->opts.seg_sec && dur >= 2 * (int64_t)s->opts.seg_sec * 1000000) || by_bytes;
+    }
+    if (!s->opts.follow && !keyframe) return 0;
+    return by_time || by_bytes;
+}
+
+int sink_segment_begin(SinkSegment *s, int64_t pts_us, int keyframe)
+{
+    if (!s || s->fd < 0) return 0;
+    if (!s->started) {
+        s->started      = 1;
+        s->start_pts_us = pts_us;
+    }
+    if (pts_us > s->last_pts_us) s->last_pts_us = pts_us;
+    if (!segment_due(s, pts_us, keyframe)) return 0;
+
+    pthread_mutex_lock(&s->lock);
+    if (s->next_fd < 0 || s->done_fd >= 0) {
+        /* 后台还没准备好：继续写当前段，下一个切分机会再试 */
+        if (s->late++ == 0) LOGW("[%s] next segment of %s not ready, cut postponed", TAG, s->path);
+        pthread_mutex_unlock(&s->lock);
+        return 0;
+    }
+    s->done_fd     = s->fd;
+    s->done_bytes  = s->bytes;
+    s->done_dur_us = pts_us - s->start_pts_us;
+    snprintf(s->done_path, sizeof(s->done_path), "%s", s->path);
+
+    s->fd = s->next_fd;
+    s->next_fd = -1;
+    s->idx++;
+    snprintf(s->path, sizeof(s->path), "%s", s->next_path);
+    snprintf(s->cur_name, sizeof(s->cur_name), "%s", s->path);
+    pthread_cond_signal(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+
+    s->bytes        = 0;
+    s->start_pts_us = pts_us;
+    if (!s->opts.follow && s->opts.clock) {
+        atomic_store_explicit(&s->opts.clock->start_pts, pts_us, memory_order_relaxed);
+        atomic_store_explicit(&s->opts.clock->seq, s->idx, memory_order_release);
+    }
+    return 1;
+}
+
+int sink_segment_write(SinkSegment *s, const uint8_t *data, size_t len)
+{
+    if (!s || s->fd < 0) return -1;
+    while (len) {
+        ssize_t n = write(s->fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOGE("[%s] write %s failed: %s", TAG, s->path, strerror(errno));
+            return -1;
+        }
+        data    += n;
+        len     -= (size_t)n;
+        s->bytes += (uint64_t)n;
+    }
+    return 0;
+}
+
+void sink_segment_close(SinkSegment *s)
+{
+    if (!s || s->fd < 0) return;
+
+    if (s->th_started) {
+        pthread_mutex_lock(&s->lock);
+        s->closing = 1;
+        pthread_cond_signal(&s->cond);
+        pthread_mutex_unlock(&s->lock);
+        pthread_join(s->th, NULL);   // 退出前收尾已交回的旧段
+        s->th_started = 0;
+        pthread_cond_destroy(&s->cond);
+        pthread_mutex_destroy(&s->lock);
+    }
+
+    if (s->next_fd >= 0) {
+        close(s->next_fd);
+        unlink(s->next_path);
+        s->next_fd = -1;
+    }
+    segment_finish(s->fd, s->bytes, s->path, s->last_pts_us - s->start_pts_us);
+    s->fd = -1;
+    s->segments++;
+    LOGI("[%s] closed, %llu segments%s", TAG, (unsigned long long)s->segments,
+         s->late ? " (some cuts were postponed)" : "");
+}
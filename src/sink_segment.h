@@ -0,0 +1,107 @@
+// sink_segment.h
+#pragma once
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 分段录制：按时长和/或大小把一路输出切成多个文件，供长时间（7×24）录制使用。
+ *
+ * - 文件名：<目录>/<主名>_<会话开始时刻>_<序号><扩展名>，例如 out_20240101-120000_000003.h264，
+ *   按名字排序即时间顺序，重启后新会话的文件排在后面；
+ * - 视频（leader）只在关键帧处切换，新文件从 IDR（带 SPS/PPS）开始，可以单独播放；
+ *   PCM（follower）跟随 leader 发布的切分 PTS 切换，两路同序号的文件覆盖同一段时间
+ *   （PCM 边界滞后的时间不超过视频编码 + 写出的延迟）；
+ * - 后台线程提前创建并 fallocate 下一个文件，旧文件的 fdatasync / 截掉多余预分配 / close 和保留策略
+ *   （只保留最近 keep 个，删除最老的）也在后台做，写线程切换时只交换 fd；
+ *   下一个文件还没准备好时推迟到下一个关键帧再切，从不在写线程里做文件系统操作。
+ *
+ * 写入接口不加锁，由调用者保证同一时刻只有一个线程写（TS sink 在 ts_lock 内调用）。
+ */
+
+/* leader 发布的最新切分点，follower 据此切换（一个 leader 对应一个 follower） */
+typedef struct {
+    atomic_uint          seq;        // leader 当前段的序号（0 = 还在第一段）
+    atomic_int_fast64_t  start_pts;  // 该段第一个单元的 PTS（微秒）
+} SinkSegmentClock;
+
+typedef struct {
+    unsigned int      seg_sec;        // 每段时长（秒），0 = 不按时长
+    uint64_t          seg_bytes;      // 每段大小上限，0 = 不按大小
+    unsigned int      keep;           // 最多保留的段数（含正在写的），0 = 不删除
+    uint64_t          prealloc_bytes; // 每段 fallocate 的大小，0 = 不预分配
+    int               follow;         // 1 = 跟随 clock 切分（不等关键帧）
+    SinkSegmentClock *clock;          // leader 发布 / follower 读取；可为 NULL
+} SinkSegmentOpts;
+
+typedef struct {
+    SinkSegmentOpts opts;
+    char            dir[256];
+    char            stem[128];
+    char            ext[32];
+    char            session[32];     // 会话开始时刻，YYYYmmdd-HHMMSS
+
+    /* 当前段（仅写线程访问） */
+    int             fd;
+    uint32_t        idx;
+    uint64_t        bytes;
+    int64_t         start_pts_us;
+    int64_t         last_pts_us;
+    int             started;         // 已收到第一个单元
+    char            path[512];
+
+    /* 后台线程交接（lock 保护） */
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    pthread_t       th;
+    int             th_started;
+    int             closing;
+    int             next_fd;         // 预先创建好的下一段；-1 = 未就绪
+    char            next_path[512];
+    int             done_fd;         // 待收尾的上一段；-1 = 无
+    uint64_t        done_bytes;
+    int64_t         done_dur_us;
+    char            done_path[512];
+    char            cur_name[512];   // 当前段路径（保留策略不删除）
+
+    uint64_t        segments;        // 已完成的段数
+    uint64_t        late;            // 到切分点时下一段未就绪而推迟的次数
+} SinkSegment;
+
+void sink_segment_default_opts(SinkSegmentOpts *opts);
+
+/* 是否需要分段（seg_sec 或 seg_bytes 非 0） */
+int  sink_segment_enabled(const SinkSegmentOpts *opts);
+
+/*
+ * 创建第一段并启动后台线程。
+ *
+ * @param target  名义输出路径（例如 "out.h264"），据此拆出目录、主名和扩展名
+ * @return        0 成功；-1 失败
+ */
+int  sink_segment_open(SinkSegment *s, const char *target, const SinkSegmentOpts *opts);
+
+/*
+ * 写一个单元之前调用：判断是否到了切分点，需要时切到预先创建好的下一段。
+ *
+ * @param pts_us    该单元的 PTS
+ * @param keyframe  1 = 视频关键帧（leader 只在关键帧处切换）
+ * @return          1 已切到新的一段（封装类调用者需要重新开始封装）；0 未切换
+ */
+int  sink_segment_begin(SinkSegment *s, int64_t pts_us, int keyframe);
+
+/* 写入当前段。@return 0 成功；-1 失败 */
+int  sink_segment_write(SinkSegment *s, const uint8_t *data, size_t len);
+
+/* 收尾当前段（fdatasync 后关闭），删除未用到的预建文件，停止后台线程。 */
+void sink_segment_close(SinkSegment *s);
+
+#ifdef __cplusplus
+}
+#endif
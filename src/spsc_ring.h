@@ -0,0 +1,74 @@
+// spsc_ring.h
+#pragma once
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 单生产者/单消费者（SPSC）无锁环形队列，元素为 32 位索引（buffer index / slot id）。
+ *
+ * 约束：
+ * - 只能有一个线程 push、一个线程 pop；
+ * - 容量为 2 的幂，且不超过 SPSC_RING_MAX；
+ * - head/tail 是单调递增的计数器，取模用 mask，天然处理回绕。
+ *
+ * 内存序：push 用 release 发布元素，pop 用 acquire 读取，保证元素内容先于索引可见。
+ */
+#define SPSC_RING_MAX 64
+
+typedef struct {
+    _Alignas(64) atomic_uint head;   // 生产者写入计数
+    _Alignas(64) atomic_uint tail;   // 消费者读取计数
+    unsigned int mask;
+    uint32_t     items[SPSC_RING_MAX];
+} SpscRing;
+
+/*
+ * 初始化队列。capacity 会向上取整为 2 的幂并截断到 SPSC_RING_MAX。
+ */
+static inline void spsc_ring_init(SpscRing *r, unsigned int capacity)
+{
+    unsigned int cap = 1;
+    while (cap < capacity && cap < SPSC_RING_MAX) cap <<= 1;
+    atomic_store_explicit(&r->head, 0, memory_order_relaxed);
+    atomic_store_explicit(&r->tail, 0, memory_order_relaxed);
+    r->mask = cap - 1;
+}
+
+/* 当前元素个数（任意线程可调用，结果为近似快照）。 */
+static inline unsigned int spsc_ring_depth(SpscRing *r)
+{
+    unsigned int h = atomic_load_explicit(&r->head, memory_order_acquire);
+    unsigned int t = atomic_load_explicit(&r->tail, memory_order_acquire);
+    return h - t;
+}
+
+/* 生产者：入队。@return 0 成功；-1 队列已满 */
+static inline int spsc_ring_push(SpscRing *r, uint32_t v)
+{
+    unsigned int h = atomic_load_explicit(&r->head, memory_order_relaxed);
+    unsigned int t = atomic_load_explicit(&r->tail, memory_order_acquire);
+    if (h - t > r->mask) return -1;
+    r->items[h & r->mask] = v;
+    atomic_store_explicit(&r->head, h + 1, memory_order_release);
+    return 0;
+}
+
+/* 消费者：出队。@return 0 成功；-1 队列为空 */
+static inline int spsc_ring_pop(SpscRing *r, uint32_t *v)
+{
+    unsigned int t = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    unsigned int h = atomic_load_explicit(&r->head, memory_order_acquire);
+    if (h == t) return -1;
+    *v = r->items[t & r->mask];
+    atomic_store_explicit(&r->tail, t + 1, memory_order_release);
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
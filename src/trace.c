@@ -0,0 +1,91 @@
+// trace.c
+#include "trace.h"
+
+#if defined(RK_TRACE_ENABLE) && RK_TRACE_ENABLE
+
+#include "log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define TAG "trace"
+
+#define TRACE_LINE_MAX 128   // 一条 marker 的上限（内核按一次 write 记一条事件）
+
+int trace_marker_fd = -1;
+static int g_pid;
+
+int trace_init(void)
+{
+    static const char *const k_paths[] = {
+        "/sys/kernel/tracing/trace_marker",
+        "/sys/kernel/debug/tracing/trace_marker",
+    };
+    if (trace_marker_fd >= 0) return 0;
+    g_pid = (int)getpid();
+    for (size_t i = 0; i < sizeof(k_paths) / sizeof(k_paths[0]); i++) {
+        int fd = open(k_paths[i], O_WRONLY | O_CLOEXEC);
+        if (fd < 0) continue;
+        trace_marker_fd = fd;
+        LOGI("[%s] writing markers to %s", TAG, k_paths[i]);
+        return 0;
+    }
+    LOGW("[%s] trace_marker unavailable (%s), trace points disabled", TAG, strerror(errno));
+    return -1;
+}
+
+void trace_close(void)
+{
+    if (trace_marker_fd < 0) return;
+    close(trace_marker_fd);
+    trace_marker_fd = -1;
+}
+
+/* 一次 write 一条；tracing 关闭时内核返回错误，这里不处理 */
+static void marker_write(const char *buf, int n)
+{
+    if (n <= 0) return;
+    if (n >= TRACE_LINE_MAX) n = TRACE_LINE_MAX - 1;
+    ssize_t r = write(trace_marker_fd, buf, (size_t)n);
+    (void)r;
+}
+
+void trace_begin_fmt(const char *fmt, ...)
+{
+    char buf[TRACE_LINE_MAX];
+    int n = snprintf(buf, sizeof(buf), "B|%d|", g_pid);
+    va_list ap;
+    va_start(ap, fmt);
+    int m = vsnprintf(buf + n, sizeof(buf) - (size_t)n, fmt, ap);
+    va_end(ap);
+    if (m > 0) marker_write(buf, n + m);
+}
+
+void trace_end_now(void)
+{
+    char buf[24];
+    marker_write(buf, snprintf(buf, sizeof(buf), "E|%d", g_pid));
+}
+
+void trace_counter_fmt(int64_t value, const char *fmt, ...)
+{
+    char buf[TRACE_LINE_MAX];
+    int n = snprintf(buf, sizeof(buf), "C|%d|", g_pid);
+    va_list ap;
+    va_start(ap, fmt);
+    int m = vsnprintf(buf + n, sizeof(buf) - (size_t)n, fmt, ap);
+    va_end(ap);
+    if (m <= 0 || n + m >= (int)sizeof(buf)) return;
+    marker_write(buf, n + m + snprintf(buf + n + m, sizeof(buf) - (size_t)(n + m), "|%lld", (long long)value));
+}
+
+#else
+
+/* 未启用：保持翻译单元非空（-Wpedantic 下空文件会告警） */
+typedef int trace_disabled_t;
+
+#endif
@@ -0,0 +1,61 @@
+// trace.h
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 流水线跟踪点（make TRACE=1）：各阶段写 ftrace trace_marker，与内核的 VPU / ISP / 调度事件落在同一条时间线上。
+ *
+ * - 格式为 atrace（systrace）约定，Perfetto / catapult 直接解析为每个线程上的切片与计数器轨道：
+ *   "B|pid|名字"（开始）、"E|pid"（结束，与同一线程上最近的 B 配对）、"C|pid|名字|值"（计数器）；
+ * - 以帧为单位的切片名字带 "f=<pts>"（采集 PTS，微秒），同一帧在采集 / 编码 / 写出各线程上的切片 f 相同，
+ *   采集切片另带 V4L2 sequence；
+ * - 运行时打不开 trace_marker（没挂 tracefs、没有权限）时跟踪点只剩一次比较；
+ * - 未定义 RK_TRACE_ENABLE 时所有 TRACE_* 宏展开为空，参数也不求值，没有任何开销。
+ *
+ * 抓取示例：
+ *   echo 1 > /sys/kernel/tracing/tracing_on; ./rkav_repro ...; cat /sys/kernel/tracing/trace > rkav.trace
+ * 或用 Perfetto 的 ftrace 数据源（atrace_apps / ftrace/print）。
+ */
+#if defined(RK_TRACE_ENABLE) && RK_TRACE_ENABLE
+
+extern int trace_marker_fd;    // -1 = 未打开
+
+/* 打开 trace_marker（tracefs 或 debugfs 下）。@return 0 成功；-1 不可用（跟踪点全部跳过） */
+int  trace_init(void);
+void trace_close(void);
+
+__attribute__((format(printf, 1, 2)))
+void trace_begin_fmt(const char *fmt, ...);
+void trace_end_now(void);
+__attribute__((format(printf, 2, 3)))
+void trace_counter_fmt(int64_t value, const char *fmt, ...);
+
+#define TRACE_INIT()            trace_init()
+#define TRACE_CLOSE()           trace_close()
+/* 开始一个切片（printf 格式的名字）；必须在同一线程上用 TRACE_END 结束 */
+#define TRACE_BEGIN(...)        do { if (trace_marker_fd >= 0) trace_begin_fmt(__VA_ARGS__); } while (0)
+#define TRACE_END()             do { if (trace_marker_fd >= 0) trace_end_now(); } while (0)
+/* 零长度切片：丢帧等瞬时事件 */
+#define TRACE_INSTANT(...)      do { if (trace_marker_fd >= 0) { trace_begin_fmt(__VA_ARGS__); trace_end_now(); } } while (0)
+/* 计数器轨道（名字同样为 printf 格式），例如 TRACE_COUNTER(depth, "q_sink%d", lane) */
+#define TRACE_COUNTER(v, ...)   do { if (trace_marker_fd >= 0) trace_counter_fmt((int64_t)(v), __VA_ARGS__); } while (0)
+
+#else
+
+#define TRACE_INIT()            ((void)0)
+#define TRACE_CLOSE()           ((void)0)
+#define TRACE_BEGIN(...)        ((void)0)
+#define TRACE_END()             ((void)0)
+#define TRACE_INSTANT(...)      ((void)0)
+#define TRACE_COUNTER(v, ...)   ((void)0)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,595 @@
+// ts_mux.c
+#include "ts_mux.h"
+#include "log.h"
+#include "mem_arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define TAG "ts_mux"
+
+#define TS_PSI_INTERVAL_US  100000    // PAT/PMT 最长重复间隔
+#define TS_PCR_INTERVAL_US  100000    // PCR 最长间隔（标准要求 ≤100ms）
+#define TS_PTS_DELAY        63000     // PTS 相对 PCR 的偏移（90kHz，700ms），给解码端留缓冲
+
+#define TS_STREAM_H264      0x1B
+#define TS_STREAM_HEVC      0x24
+#define TS_STREAM_PRIVATE   0x06      // PES private data（302M / Opus 由注册描述符标识）
+#define TS_STREAM_AAC_ADTS  0x0F
+#define PES_SID_VIDEO       0xE0
+#define PES_SID_AUDIO       0xC0
+#define PES_SID_PRIVATE1    0xBD
+
+#define AES3_HDR_LEN        4
+#define OPUS_CTRL_MAX       (2 + PES_MAX_LEN / 255 + 1)   // opus_control_header：前缀 + au_size 的 0xFF 串
+#define PES_HDR_LEN         14        // start code(3)+sid(1)+len(2)+flags(2)+hdr_len(1)+PTS(5)
+#define PES_MAX_LEN         65535
+/* 一个音频 PES 的 302M 负载上限（PES_packet_length 为 16 位） */
+#define TS_AES_MAX_PAYLOAD  (PES_MAX_LEN - (PES_HDR_LEN - 6) - AES3_HDR_LEN)
+
+/* ===================== 基础编码 ===================== */
+
+/* MPEG-2 CRC32（poly 0x04C11DB7，不反射，初值全 1），PSI 节很短，逐位计算即可。 */
+static uint32_t crc32_mpeg(const uint8_t *p, size_t len)
+{
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (uint32_t)p[i] << 24;
+        for (int b = 0; b < 8; b++)
+            crc = (crc & 0x80000000u) ? (crc << 1) ^ 0x04C11DB7u : (crc << 1);
+    }
+    return crc;
+}
+
+/* 字节内位序反转（AES3 按 LSB 先行传输） */
+static inline uint8_t rev8(uint8_t b)
+{
+    b = (uint8_t)((b & 0xF0) >> 4 | (b & 0x0F) << 4);
+    b = (uint8_t)((b & 0xCC) >> 2 | (b & 0x33) << 2);
+    b = (uint8_t)((b & 0xAA) >> 1 | (b & 0x55) << 1);
+    return b;
+}
+
+static uint64_t us_to_90k(int64_t us)
+{
+    return us > 0 ? (uint64_t)us * 9u / 100u : 0;
+}
+
+/* PES 头中的 5 字节 PTS（'0010' 前缀 + marker 位） */
+static void put_pts(uint8_t *p, uint64_t pts)
+{
+    pts &= 0x1FFFFFFFFull;
+    p[0] = (uint8_t)(0x21 | ((pts >> 29) & 0x0E));
+    p[1] = (uint8_t)(pts >> 22);
+    p[2] = (uint8_t)(((pts >> 14) & 0xFE) | 1);
+    p[3] = (uint8_t)(pts >> 7);
+    p[4] = (uint8_t)(((pts << 1) & 0xFE) | 1);
+}
+
+/* 适配域中的 6 字节 PCR（base 33 位 + ext 9 位，ext 恒为 0） */
+static void put_pcr(uint8_t *p, uint64_t base)
+{
+    base &= 0x1FFFFFFFFull;
+    p[0] = (uint8_t)(base >> 25);
+    p[1] = (uint8_t)(base >> 17);
+    p[2] = (uint8_t)(base >> 9);
+    p[3] = (uint8_t)(base >> 1);
+    p[4] = (uint8_t)(((base & 1) << 7) | 0x7E);
+    p[5] = 0;
+}
+
+/*
+ * 生成 PES 头（仅 PTS）。
+ *
+ * @param payload_len  头之后的 PES 负载字节数
+ * @return             头长度（PES_HDR_LEN）
+ */
+static size_t put_pes_header(uint8_t *p, uint8_t sid, size_t payload_len, uint64_t pts)
+{
+    size_t pes_len = (PES_HDR_LEN - 6) + payload_len;
+    if (pes_len > PES_MAX_LEN) pes_len = 0;   // 仅视频允许 0（长度不定）
+
+    p[0] = 0x00; p[1] = 0x00; p[2] = 0x01;
+    p[3] = sid;
+    p[4] = (uint8_t)(pes_len >> 8);
+    p[5] = (uint8_t)pes_len;
+    p[6] = 0x84;                 // '10' + data_alignment_indicator
+    p[7] = 0x80;                 // PTS only
+    p[8] = 5;
+    put_pts(p + 9, pts);
+    return PES_HDR_LEN;
+}
+
+/* ===================== 输出缓冲 ===================== */
+
+static int mux_flush(TsMux *m)
+{
+    if (!m->buf_len) return 0;
+    int ret = m->write(m->opaque, m->buf, m->buf_len);
+    if (ret == 0) m->bytes += m->buf_len;
+    m->buf_len = 0;
+    return ret;
+}
+
+/* 取下一个 TS 包的写入位置；缓冲已满时先写出。@return NULL 表示写出失败 */
+static uint8_t *mux_next_packet(TsMux *m)
+{
+    if (m->buf_len + TS_PACKET_SIZE > (size_t)TS_MUX_BUF_PKTS * TS_PACKET_SIZE) {
+        if (mux_flush(m) != 0) return NULL;
+    }
+    uint8_t *p = m->buf + m->buf_len;
+    m->buf_len += TS_PACKET_SIZE;
+    return p;
+}
+
+static void put_ts_header(uint8_t *p, uint16_t pid, int pusi, int afc, uint8_t cc)
+{
+    p[0] = 0x47;
+    p[1] = (uint8_t)((pusi ? 0x40 : 0) | ((pid >> 8) & 0x1F));
+    p[2] = (uint8_t)pid;
+    p[3] = (uint8_t)((afc << 4) | (cc & 0x0F));
+}
+
+/*
+ * 把 (hdr + data) 作为一个 PES 切成 TS 包写进输出缓冲。
+ * 第一个包可带 PCR / random_access_indicator；最后一个包用适配域填充到 188 字节。
+ *
+ * @param pcr    <0 表示不带 PCR
+ * @param start  1 = 开始一个新 PES（第一个包置 PUSI）；0 = 续写上一个 PES 的负载（分片 AU）
+ * @return       0 成功；-1 写出失败
+ */
+static int mux_put_pes(TsMux *m, uint16_t pid, uint8_t *cc,
+                       const uint8_t *hdr, size_t hdr_len,
+                       const uint8_t *data, size_t data_len,
+                       int64_t pcr, int rai, int start)
+{
+    size_t total = hdr_len + data_len;
+    size_t off = 0;
+    int first = 1;
+
+    while (off < total) {
+        uint8_t *p = mux_next_packet(m);
+        if (!p) return -1;
+
+        size_t  af_len   = 0;    // 适配域总字节数（含长度字节）
+        uint8_t af_flags = 0;
+        if (first && (pcr >= 0 || rai)) {
+            af_flags = (uint8_t)((rai ? 0x40 : 0) | (pcr >= 0 ? 0x10 : 0));
+            af_len   = 2 + (pcr >= 0 ? 6 : 0);
+        }
+        size_t space = TS_PACKET_SIZE - 4 - af_len;
+        size_t left  = total - off;
+        if (left < space) {
+            af_len = TS_PACKET_SIZE - 4 - left;   // 用适配域填充
+            space  = left;
+        }
+
+        put_ts_header(p, pid, first && start, af_len ? 3 : 1, *cc);
+        *cc = (uint8_t)((*cc + 1) & 0x0F);
+
+        uint8_t *q = p + 4;
+        if (af_len) {
+            q[0] = (uint8_t)(af_len - 1);
+            if (af_len >= 2) {
+                q[1] = af_flags;
+                size_t used = 2;
+                if (af_flags & 0x10) {
+                    put_pcr(q + 2, (uint64_t)pcr);
+                    used += 6;
+                }
+                memset(q + used, 0xFF, af_len - used);
+            }
+            q += af_len;
+        }
+
+        /* 负载跨越 hdr/data 边界时分两段拷贝 */
+        size_t n = space;
+        while (n) {
+            size_t chunk;
+            if (off < hdr_len) {
+                chunk = hdr_len - off < n ? hdr_len - off : n;
+                memcpy(q, hdr + off, chunk);
+            } else {
+                chunk = n;
+                memcpy(q, data + (off - hdr_len), chunk);
+            }
+            q   += chunk;
+            off += chunk;
+            n   -= chunk;
+        }
+        first = 0;
+    }
+    return 0;
+}
+
+/* 仅含 PCR 的包（adaptation_field_control=2，不占用连续计数） */
+static int mux_put_pcr_only(TsMux *m, uint16_t pid, uint8_t cc, uint64_t pcr)
+{
+    uint8_t *p = mux_next_packet(m);
+    if (!p) return -1;
+    put_ts_header(p, pid, 0, 2, (uint8_t)((cc - 1) & 0x0F));
+    p[4] = TS_PACKET_SIZE - 5;
+    p[5] = 0x10;
+    put_pcr(p + 6, pcr);
+    memset(p + 12, 0xFF, TS_PACKET_SIZE - 12);
+    return 0;
+}
+
+/* 写一个单包 PSI 节（PAT/PMT 都远小于 184 字节） */
+static int mux_put_section(TsMux *m, uint16_t pid, uint8_t *cc, const uint8_t *sec, size_t len)
+{
+    uint8_t *p = mux_next_packet(m);
+    if (!p) return -1;
+    put_ts_header(p, pid, 1, 1, *cc);
+    *cc = (uint8_t)((*cc + 1) & 0x0F);
+    p[4] = 0;                          // pointer_field
+    memcpy(p + 5, sec, len);
+    memset(p + 5 + len, 0xFF, TS_PACKET_SIZE - 5 - len);
+    return 0;
+}
+
+/* 补全节长度与 CRC。@return 节总长度 */
+static size_t finish_section(uint8_t *sec, size_t len_before_crc)
+{
+    size_t section_length = len_before_crc - 3 + 4;
+    sec[1] = (uint8_t)(0xB0 | ((section_length >> 8) & 0x0F));
+    sec[2] = (uint8_t)section_length;
+    uint32_t crc = crc32_mpeg(sec, len_before_crc);
+    sec[len_before_crc + 0] = (uint8_t)(crc >> 24);
+    sec[len_before_crc + 1] = (uint8_t)(crc >> 16);
+    sec[len_before_crc + 2] = (uint8_t)(crc >> 8);
+    sec[len_before_crc + 3] = (uint8_t)crc;
+    return len_before_crc + 4;
+}
+
+static uint16_t pcr_pid(const TsMux *m)
+{
+    return m->st.video ? TS_PID_VIDEO : TS_PID_AUDIO;
+}
+
+static int mux_put_psi(TsMux *m, int64_t pts_us)
+{
+    uint8_t sec[64];
+    size_t n;
+
+    /* PAT：单节目 1 -> PMT PID */
+    n = 0;
+    sec[n++] = 0x00;                   // table_id
+    n += 2;                            // section_length（finish_section 填写）
+    sec[n++] = 0x00; sec[n++] = 0x01;  // transport_stream_id
+    sec[n++] = 0xC1;                   // version 0, current_next 1
+    sec[n++] = 0x00; sec[n++] = 0x00;  // section / last_section
+    sec[n++] = 0x00; sec[n++] = 0x01;  // program_number
+    sec[n++] = (uint8_t)(0xE0 | (TS_PID_PMT >> 8));
+    sec[n++] = (uint8_t)TS_PID_PMT;
+    n = finish_section(sec, n);
+    if (mux_put_section(m, 0x0000, &m->cc_pat, sec, n) != 0) return -1;
+
+    /* PMT */
+    uint16_t ppid = pcr_pid(m);
+    n = 0;
+    sec[n++] = 0x02;
+    n += 2;
+    sec[n++] = 0x00; sec[n++] = 0x01;  // program_number
+    sec[n++] = 0xC1;
+    sec[n++] = 0x00; sec[n++] = 0x00;
+    sec[n++] = (uint8_t)(0xE0 | (ppid >> 8));
+    sec[n++] = (uint8_t)ppid;
+    sec[n++] = 0xF0; sec[n++] = 0x00;  // program_info_length
+    if (m->st.video) {
+        sec[n++] = m->st.hevc ? TS_STREAM_HEVC : TS_STREAM_H264;
+        sec[n++] = (uint8_t)(0xE0 | (TS_PID_VIDEO >> 8));
+        sec[n++] = (uint8_t)TS_PID_VIDEO;
+        sec[n++] = 0xF0; sec[n++] = 0x00;
+    }
+    if (m->has_audio && m->st.audio_codec == TS_AUDIO_AAC) {
+        sec[n++] = TS_STREAM_AAC_ADTS;
+        sec[n++] = (uint8_t)(0xE0 | (TS_PID_AUDIO >> 8));
+        sec[n++] = (uint8_t)TS_PID_AUDIO;
+        sec[n++] = 0xF0; sec[n++] = 0x00;
+    } else if (m->has_audio && m->st.audio_codec == TS_AUDIO_OPUS) {
+        sec[n++] = TS_STREAM_PRIVATE;
+        sec[n++] = (uint8_t)(0xE0 | (TS_PID_AUDIO >> 8));
+        sec[n++] = (uint8_t)TS_PID_AUDIO;
+        sec[n++] = 0xF0; sec[n++] = 10;
+        /* registration_descriptor "Opus" + DVB extension_descriptor（tag 0x80 = Opus，channel_config_code） */
+        sec[n++] = 0x05; sec[n++] = 4;
+        sec[n++] = 'O'; sec[n++] = 'p'; sec[n++] = 'u'; sec[n++] = 's';
+        sec[n++] = 0x7F; sec[n++] = 2;
+        sec[n++] = 0x80; sec[n++] = (uint8_t)m->st.audio_channels;
+    } else if (m->has_audio) {
+        sec[n++] = TS_STREAM_PRIVATE;
+        sec[n++] = (uint8_t)(0xE0 | (TS_PID_AUDIO >> 8));
+        sec[n++] = (uint8_t)TS_PID_AUDIO;
+        sec[n++] = 0xF0; sec[n++] = 6;
+        /* registration_descriptor：format_identifier = "BSSD"（SMPTE 302M） */
+        sec[n++] = 0x05; sec[n++] = 4;
+        sec[n++] = 'B'; sec[n++] = 'S'; sec[n++] = 'S'; sec[n++] = 'D';
+    }
+    n = finish_section(sec, n);
+    if (mux_put_section(m, TS_PID_PMT, &m->cc_pmt, sec, n) != 0) return -1;
+
+    m->psi_written = 1;
+    m->last_psi_us = pts_us;
+    return 0;
+}
+
+static int psi_due(const TsMux *m, int64_t pts_us)
+{
+    return !m->psi_written || pts_us - m->last_psi_us >= TS_PSI_INTERVAL_US || pts_us < m->last_psi_us;
+}
+
+/* PCR 取 PTS 减去 TS_PTS_DELAY 对应的时刻，并保证单调不减（音视频交替写入时可能略有回退） */
+static uint64_t next_pcr(TsMux *m, int64_t pts_us)
+{
+    uint64_t pcr = us_to_90k(pts_us);
+    if (pcr < m->last_pcr) pcr = m->last_pcr;
+    m->last_pcr    = pcr;
+    m->last_pcr_us = pts_us;
+    return pcr;
+}
+
+/* ===================== 对外接口 ===================== */
+
+/*
+ * 初始化 TS 封装器。
+ *
+ * @param m       实例（调用者分配）
+ * @param st      节目包含的流
+ * @param write   写出回调
+ * @param opaque  回调参数
+ * @return        0 成功；-1 失败
+ */
+int ts_mux_init(TsMux *m, const TsMuxStreams *st, TsMuxWriteFn write, void *opaque)
+{
+    if (!m || !st || !write) return -1;
+    memset(m, 0, sizeof(*m));
+    m->st     = *st;
+    m->write  = write;
+    m->opaque = opaque;
+
+    if (st->audio_rate && st->audio_codec != TS_AUDIO_S302M) {
+        /* 编码器已经决定了采样率与声道，这里只声明 */
+        if (st->audio_channels >= 1 && st->audio_channels <= 8) {
+            m->has_audio = 1;
+        } else {
+            LOGW("[%s] audio ch=%u not supported, muxing video only", TAG, st->audio_channels);
+        }
+    } else if (st->audio_rate) {
+        /* SMPTE 302M 只定义了 48kHz、2/4/6/8 声道 */
+        if (st->audio_rate == 48000 && st->audio_channels >= 2 && st->audio_channels <= 8 &&
+            (st->audio_channels & 1) == 0) {
+            m->has_audio = 1;
+        } else {
+            LOGW("[%s] audio %uHz ch=%u not representable as SMPTE 302M, muxing video only",
+                 TAG, st->audio_rate, st->audio_channels);
+        }
+    }
+    if (!m->st.video && !m->has_audio) {
+        LOGE("[%s] no stream to mux", TAG);
+        return -1;
+    }
+
+    m->buf = (uint8_t *)mem_arena_alloc(MEM_STAGE_SINK, (size_t)TS_MUX_BUF_PKTS * TS_PACKET_SIZE, 0);
+    if (!m->buf) return -1;
+    if (m->has_audio && m->st.audio_codec == TS_AUDIO_S302M) {
+        m->aes_cap = TS_AES_MAX_PAYLOAD;
+        m->aes = (uint8_t *)mem_arena_alloc(MEM_STAGE_SINK, m->aes_cap, 0);
+        if (!m->aes) {
+            ts_mux_deinit(m);
+            return -1;
+        }
+    }
+
+    static const char *const audio_names[] = { "s302m", "aac", "opus" };
+    const char *audio = "none";
+    if (m->has_audio && m->st.audio_codec >= 0 && m->st.audio_codec <= TS_AUDIO_OPUS)
+        audio = audio_names[m->st.audio_codec];
+    LOGI("[%s] init video=%s audio=%s", TAG,
+         m->st.video ? (m->st.hevc ? "h265" : "h264") : "none", audio);
+    return 0;
+}
+
+/*
+ * 写一个视频 AU：必要时先写 PAT/PMT，AU 前补 AUD（MPP 输出不带），首包带 PCR。
+ */
+int ts_mux_write_video(TsMux *m, const uint8_t *au, size_t len, int64_t pts_us, int keyframe)
+{
+    return ts_mux_write_video_part(m, au, len, pts_us, keyframe, TS_AU_WHOLE);
+}
+
+/*
+ * 写视频 AU 的一片：开头一片与整帧相同（PES 长度改为不定长），后续片只续写负载。
+ */
+int ts_mux_write_video_part(TsMux *m, const uint8_t *au, size_t len, int64_t pts_us, int keyframe,
+                            TsAuPart part)
+{
+    if (!m || !m->buf || !m->st.video || !au || !len) return -1;
+
+    if (!TS_AU_STARTS(part)) {
+        if (mux_put_pes(m, TS_PID_VIDEO, &m->cc_video, NULL, 0, au, len, -1, 0, 0) != 0) return -1;
+        return mux_flush(m);
+    }
+
+    if (keyframe || psi_due(m, pts_us)) {
+        if (mux_put_psi(m, pts_us) != 0) return -1;
+    }
+
+    /* H.264 AUD：nal_unit_type 9；H.265 AUD：nal_unit_type 35（两字节 NAL 头） */
+    static const uint8_t aud_avc[6]  = { 0x00, 0x00, 0x00, 0x01, 0x09, 0xF0 };
+    static const uint8_t aud_hevc[7] = { 0x00, 0x00, 0x00, 0x01, 0x46, 0x01, 0x50 };
+    const uint8_t *aud = m->st.hevc ? aud_hevc : aud_avc;
+    size_t aud_len     = m->st.hevc ? sizeof(aud_hevc) : sizeof(aud_avc);
+
+    int has_aud = 0;
+    if (len > 5 && au[0] == 0 && au[1] == 0) {
+        uint8_t b = au[2] == 1 ? au[3] : (au[2] == 0 && au[3] == 1) ? au[4] : 0;
+        has_aud = m->st.hevc ? ((b >> 1) & 0x3F) == 35 : (b & 0x1F) == 9;
+    }
+
+    uint8_t hdr[PES_HDR_LEN + sizeof(aud_hevc)];
+    /* 分片时 AU 总长还不知道：按超过上限处理，PES 长度写 0 */
+    size_t payload = part == TS_AU_FIRST ? PES_MAX_LEN : len + (has_aud ? 0 : aud_len);
+    size_t hlen = put_pes_header(hdr, PES_SID_VIDEO, payload, us_to_90k(pts_us) + TS_PTS_DELAY);
+    if (!has_aud) {
+        memcpy(hdr + hlen, aud, aud_len);
+        hlen += aud_len;
+    }
+
+    int64_t pcr = (int64_t)next_pcr(m, pts_us);
+    if (mux_put_pes(m, TS_PID_VIDEO, &m->cc_video, hdr, hlen, au, len, pcr, keyframe, 1) != 0)
+        return -1;
+    return mux_flush(m);
+}
+
+/*
+ * 把 S16LE 交织 PCM 转成 SMPTE 302M 负载（每对声道 20 位槽 x2 = 5 字节，位序反转）。
+ *
+ * @return  输出字节数
+ */
+static size_t pcm_to_s302m(TsMux *m, const int16_t *s, size_t frames, uint8_t *o)
+{
+    unsigned int ch = m->st.audio_channels;
+    uint8_t *start = o;
+    for (size_t f = 0; f < frames; f++) {
+        /* 每 192 帧一个 AES3 块，块首帧置 F 位 */
+        uint8_t vucf = (m->aes_frame_idx == 0) ? 0x10 : 0;
+        for (unsigned int c = 0; c < ch; c += 2) {
+            uint16_t l = (uint16_t)s[c];
+            uint16_t r = (uint16_t)s[c + 1];
+            o[0] = rev8((uint8_t)(l & 0xFF));
+            o[1] = rev8((uint8_t)(l >> 8));
+            o[2] = (uint8_t)(rev8((uint8_t)((r & 0x0F) << 4)) | vucf);
+            o[3] = rev8((uint8_t)((r & 0x0FF0) >> 4));
+            o[4] = rev8((uint8_t)((r & 0xF000) >> 12));
+            o += 5;
+        }
+        s += ch;
+        if (++m->aes_frame_idx >= 192) m->aes_frame_idx = 0;
+    }
+    return (size_t)(o - start);
+}
+
+/* 音频 PES 的 PCR：节目 PCR 在音频 PID 上时随 PES 带出；否则视频超过 100ms 没来时补一个仅 PCR 的包。 */
+static int audio_pcr(TsMux *m, int64_t pts_us, int64_t *pcr)
+{
+    *pcr = -1;
+    if (pcr_pid(m) == TS_PID_AUDIO) {
+        *pcr = (int64_t)next_pcr(m, pts_us);
+    } else if (pts_us - m->last_pcr_us >= TS_PCR_INTERVAL_US) {
+        if (mux_put_pcr_only(m, TS_PID_VIDEO, m->cc_video, next_pcr(m, pts_us)) != 0) return -1;
+    }
+    return 0;
+}
+
+/*
+ * 写一个编码帧：AAC 为完整 ADTS 帧（stream_id 0xC0）；
+ * Opus 放在 private_stream_1 里，前面加 opus_control_header（0x7FE0 + au_size，按 255 分段）。
+ */
+static int mux_write_coded(TsMux *m, const uint8_t *au, size_t len, int64_t pts_us)
+{
+    int opus = m->st.audio_codec == TS_AUDIO_OPUS;
+    size_t ctrl = opus ? 2 + len / 255 + 1 : 0;
+    if (len + ctrl > PES_MAX_LEN - (PES_HDR_LEN - 6)) {
+        LOGW("[%s] audio frame %zu bytes too large, dropped", TAG, len);
+        return 0;
+    }
+
+    if (psi_due(m, pts_us)) {
+        if (mux_put_psi(m, pts_us) != 0) return -1;
+    }
+    int64_t pcr;
+    if (audio_pcr(m, pts_us, &pcr) != 0) return -1;
+
+    uint8_t hdr[PES_HDR_LEN + OPUS_CTRL_MAX];
+    size_t hlen = put_pes_header(hdr, opus ? PES_SID_PRIVATE1 : PES_SID_AUDIO, ctrl + len,
+                                 us_to_90k(pts_us) + TS_PTS_DELAY);
+    if (opus) {
+        hdr[hlen++] = 0x7F;
+        hdr[hlen++] = 0xE0;   // 不带 start/end trim、不带 control_extension
+        size_t left = len;
+        while (left >= 255) {
+            hdr[hlen++] = 0xFF;
+            left -= 255;
+        }
+        hdr[hlen++] = (uint8_t)left;
+    }
+    if (mux_put_pes(m, TS_PID_AUDIO, &m->cc_audio, hdr, hlen, au, len, pcr, 0, 1) != 0) return -1;
+    return mux_flush(m);
+}
+
+/*
+ * 写一段 PCM：按 PES 长度上限拆分，每个 PES 带 AES3 头。
+ * 节目 PCR 在视频 PID 上；视频超过 100ms 没来（视频打不开/卡住）时补一个仅 PCR 的包。
+ * 编码音频（AAC/Opus）一次一帧，见 mux_write_coded。
+ */
+int ts_mux_write_audio(TsMux *m, const uint8_t *pcm, size_t len, int64_t pts_us)
+{
+    if (!m || !m->buf || !pcm) return -1;
+    if (!m->has_audio) return 0;
+    if (m->st.audio_codec != TS_AUDIO_S302M) return len ? mux_write_coded(m, pcm, len, pts_us) : 0;
+
+    unsigned int ch = m->st.audio_channels;
+    size_t in_bpf  = (size_t)ch * 2;
+    size_t out_bpf = (size_t)ch / 2 * 5;
+    size_t frames  = len / in_bpf;
+    size_t max_frames = m->aes_cap / out_bpf;
+    const int16_t *s = (const int16_t *)pcm;
+
+    while (frames) {
+        size_t n = frames < max_frames ? frames : max_frames;
+
+        if (psi_due(m, pts_us)) {
+            if (mux_put_psi(m, pts_us) != 0) return -1;
+        }
+
+        int64_t pcr;
+        if (audio_pcr(m, pts_us, &pcr) != 0) return -1;
+
+        size_t plen = pcm_to_s302m(m, s, n, m->aes);
+
+        uint8_t hdr[PES_HDR_LEN + AES3_HDR_LEN];
+        size_t hlen = put_pes_header(hdr, PES_SID_PRIVATE1, AES3_HDR_LEN + plen,
+                                     us_to_90k(pts_us) + TS_PTS_DELAY);
+        /* AES3 头：audio_packet_size(16) num_channels(2) channel_id(8) bits_per_sample(2) align(4) */
+        hdr[hlen + 0] = (uint8_t)(plen >> 8);
+        hdr[hlen + 1] = (uint8_t)plen;
+        hdr[hlen + 2] = (uint8_t)((((ch - 2) >> 1) & 0x03) << 6);
+        hdr[hlen + 3] = 0x00;   // channel_id 低 2 位 0，16 bit，对齐位 0
+        hlen += AES3_HDR_LEN;
+
+        if (mux_put_pes(m, TS_PID_AUDIO, &m->cc_audio, hdr, hlen, m->aes, plen, pcr, 0, 1) != 0)
+            return -1;
+        if (mux_flush(m) != 0) return -1;
+
+        s      += n * ch;
+        frames -= n;
+        pts_us += (int64_t)(n * 1000000u / m->st.audio_rate);
+    }
+    return 0;
+}
+
+void ts_mux_reset(TsMux *m)
+{
+    if (!m) return;
+    m->buf_len       = 0;
+    m->cc_pat        = 0;
+    m->cc_pmt        = 0;
+    m->cc_video      = 0;
+    m->cc_audio      = 0;
+    m->aes_frame_idx = 0;
+    m->psi_written   = 0;
+    m->last_psi_us   = 0;
+    m->last_pcr_us   = 0;
+    m->last_pcr      = 0;
+}
+
+void ts_mux_deinit(TsMux *m)
+{
+    if (!m) return;
+    mem_arena_free(m->buf);
+    mem_arena_free(m->aes);
+    m->buf = NULL;
+    m->aes = NULL;
+    m->buf_len = 0;
+}
@@ -0,0 +1,143 @@
+// ts_mux.h
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 流式 MPEG-TS 封装：H.264/H.265 Annex-B 视频 + 音频合成一路 TS。
+ * 音频为 PCM（SMPTE 302M）或已编码的 AAC（ADTS）/ Opus（见 audio_enc.h）。
+ *
+ * - 每个 access unit / PCM 段直接切成 188 字节 TS 包写进预分配的输出缓冲，
+ *   不为单个包 malloc；每个 PES 结束即通过回调写出，进程崩溃最多丢一个 PES；
+ * - PAT/PMT 在每个关键帧前以及至少每 100ms 重复一次，PCR 放在视频 PID 上；
+ * - 时间戳来自采集路径（media_clock_pts，微秒），换算为 90kHz。
+ *
+ * 非线程安全：视频与音频共用一个实例时由调用者加锁（见 sink.c）。
+ */
+
+#define TS_PACKET_SIZE   188
+#define TS_MUX_BUF_PKTS  64      // 输出缓冲可容纳的 TS 包数（满了先写出一次）
+
+#define TS_PID_PMT       0x1000
+#define TS_PID_VIDEO     0x0100
+#define TS_PID_AUDIO     0x0101
+
+/*
+ * 写出回调。@return 0 成功；-1 失败
+ */
+typedef int (*TsMuxWriteFn)(void *opaque, const uint8_t *data, size_t len);
+
+/* 音频流格式 */
+typedef enum {
+    TS_AUDIO_S302M = 0,            // S16LE 交织 PCM，封装为 SMPTE 302M
+    TS_AUDIO_AAC,                  // ADTS 帧（stream_type 0x0F），一次写入一帧
+    TS_AUDIO_OPUS,                 // Opus 包（Opus-in-TS 映射：private PES + control header），一次写入一包
+} TsAudioCodec;
+
+/* 节目包含的流 */
+typedef struct {
+    int          video;            // 1=含视频
+    int          hevc;             // 1=视频为 H.265（否则 H.264）
+    unsigned int audio_rate;       // 0=无音频；SMPTE 302M 只支持 48000
+    unsigned int audio_channels;   // 302M：2/4/6/8（S16LE 交织）；AAC/Opus：编码后的声道数
+    int          audio_codec;      // TsAudioCodec
+} TsMuxStreams;
+
+/*
+ * 视频 AU 的分片写入（低延迟分片编码，见 --enc-slices）：一个 AU 依次由 FIRST、若干 MID、LAST 组成，
+ * 每一片到达即写出，不等整帧编完；WHOLE 为一次写入完整 AU。关键帧标志只看开头那一片。
+ */
+typedef enum {
+    TS_AU_WHOLE = 0,
+    TS_AU_FIRST,
+    TS_AU_MID,
+    TS_AU_LAST,
+} TsAuPart;
+
+/* 这一片是否开始一个新的 AU（WHOLE / FIRST） */
+#define TS_AU_STARTS(part) ((part) == TS_AU_WHOLE || (part) == TS_AU_FIRST)
+/* 这一片是否结束一个 AU（WHOLE / LAST） */
+#define TS_AU_ENDS(part)   ((part) == TS_AU_WHOLE || (part) == TS_AU_LAST)
+
+typedef struct {
+    TsMuxStreams st;
+    int          has_audio;        // 编码后的音频，或参数满足 302M 约束的 PCM 时为 1
+    TsMuxWriteFn write;
+    void        *opaque;
+
+    uint8_t     *buf;              // TS_MUX_BUF_PKTS 个 TS 包
+    size_t       buf_len;
+    uint8_t     *aes;              // 302M 转换缓冲（一次 PES 的最大负载；编码音频不分配）
+    size_t       aes_cap;
+
+    uint8_t      cc_pat;
+    uint8_t      cc_pmt;
+    uint8_t      cc_video;
+    uint8_t      cc_audio;
+    uint32_t     aes_frame_idx;    // AES3 192 帧块内序号（V/U/C/F 位的 F 标志）
+
+    int          psi_written;
+    int64_t      last_psi_us;
+    int64_t      last_pcr_us;      // 最近一次写出的 PCR 对应的 PTS（微秒）
+    uint64_t     last_pcr;         // 最近一次写出的 PCR base（90kHz），保证单调
+
+    uint64_t     bytes;            // 累计写出字节数（ts_mux_reset 不清零）
+} TsMux;
+
+/*
+ * 初始化：分配输出缓冲与 302M 转换缓冲（之后写入路径不再分配内存）。
+ * 音频参数不满足 302M 约束时打印告警并只封装视频。
+ *
+ * @return  0 成功；-1 失败
+ */
+int  ts_mux_init(TsMux *m, const TsMuxStreams *st, TsMuxWriteFn write, void *opaque);
+
+/*
+ * 写一个 H.264 access unit（一个 MPP packet）。
+ *
+ * @param au        Annex-B 数据
+ * @param pts_us    采集 PTS（微秒）
+ * @param keyframe  1=IDR（先写 PAT/PMT，并置 random_access_indicator）
+ * @return          0 成功；-1 写出失败
+ */
+int  ts_mux_write_video(TsMux *m, const uint8_t *au, size_t len, int64_t pts_us, int keyframe);
+
+/*
+ * 写一个 AU 的一片（part 见 TsAuPart；TS_AU_WHOLE 等同 ts_mux_write_video）。
+ * FIRST 与整帧一样开始一个 PES（PSI / AUD / PCR），但 PES 长度写 0（不定长，总长此时未知）；
+ * MID / LAST 只追加 PES 负载，不带 PUSI / PCR，pts_us / keyframe 不使用。
+ * 每一片写完即经回调写出；片与片之间可以穿插音频 PES（不同 PID）。
+ *
+ * @return  0 成功；-1 写出失败
+ */
+int  ts_mux_write_video_part(TsMux *m, const uint8_t *data, size_t len, int64_t pts_us, int keyframe,
+                             TsAuPart part);
+
+/*
+ * 写一段音频（未启用音频时直接丢弃并返回 0）。
+ * 302M：S16LE 交织 PCM，按 PES 上限拆分；AAC/Opus：一个编码帧，占一个 PES。
+ *
+ * @param pcm     PCM 数据（字节数需为整帧）或一个编码帧
+ * @param pts_us  第一个采样帧的 PTS（微秒）
+ * @return        0 成功；-1 写出失败
+ */
+int  ts_mux_write_audio(TsMux *m, const uint8_t *pcm, size_t len, int64_t pts_us);
+
+/*
+ * 开始一路新的 TS（例如切换到下一个文件）：连续计数、PSI / PCR 状态归零，保留已分配的缓冲；
+ * bytes 跨段继续累计（关闭时的日志给出全部分段的总量）。
+ * 下一个视频 AU 前会重新写 PAT/PMT。
+ */
+void ts_mux_reset(TsMux *m);
+
+/* 释放缓冲（不负责关闭回调背后的文件）。 */
+void ts_mux_deinit(TsMux *m);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,8 +1,11 @@
 // src/v4l2_capture.c
 #include "v4l2_capture.h"
 #include "log.h"
+#include "media_clock.h"
+#include "mem_arena.h"
 
 #include <string.h>
+#include <strings.h>
 #include <stdlib.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -12,6 +15,20 @@
 
 #include <linux/videodev2.h>
 
+/* DMABUF 模式：dma-heap 分配采集 buffer；CPU 读取前后用 DMA_BUF_IOCTL_SYNC 维护 cache */
+#if __has_include(<linux/dma-heap.h>)
+#  include <linux/dma-heap.h>
+#  define V4L2_HAVE_DMA_HEAP 1
+#else
+#  define V4L2_HAVE_DMA_HEAP 0
+#endif
+#if __has_include(<linux/dma-buf.h>)
+#  include <linux/dma-buf.h>
+#  define V4L2_HAVE_DMABUF_SYNC 1
+#else
+#  define V4L2_HAVE_DMABUF_SYNC 0
+#endif
+
 #define TAG "v4l2"
 
 #ifndef VIDEO_MAX_PLANES
@@ -39,7 +56,7 @@ static int xioctl(int fd, int req, void *arg)
  * @param fourcc  输入 fourcc
  * @param out     输出缓冲区，要求至少 5 字节（含 '\0'）
  */
-static void fourcc_to_str(uint32_t fourcc, char out[5])
+void v4l2_fourcc_str(uint32_t fourcc, char out[5])
 {
     out[0] = (fourcc) & 0xff;
     out[1] = (fourcc >> 8) & 0xff;
@@ -48,6 +65,108 @@ static void fourcc_to_str(uint32_t fourcc, char out[5])
     out[4] = '\0';
 }
 
+static const char *const k_io_names[] = {
+    [V4L2_IO_MMAP]    = "mmap",
+    [V4L2_IO_USERPTR] = "userptr",
+    [V4L2_IO_DMABUF]  = "dmabuf",
+};
+
+int v4l2_io_from_name(const char *name, V4L2IoMode *out)
+{
+    if (!name || !out) return -1;
+    for (int i = 0; i < (int)(sizeof(k_io_names) / sizeof(k_io_names[0])); i++) {
+        if (strcmp(name, k_io_names[i]) == 0) {
+            *out = (V4L2IoMode)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *v4l2_io_name(V4L2IoMode io)
+{
+    if ((int)io < 0 || (int)io >= (int)(sizeof(k_io_names) / sizeof(k_io_names[0]))) return "?";
+    return k_io_names[io];
+}
+
+int v4l2_fourcc_from_name(const char *name, uint32_t *out)
+{
+    if (!name || !out) return -1;
+    if (strcasecmp(name, "auto") == 0) *out = 0;
+    else if (strcasecmp(name, "nv12") == 0) *out = V4L2_PIX_FMT_NV12;
+    else if (strcasecmp(name, "nv12m") == 0) *out = V4L2_PIX_FMT_NV12M;
+    else if (strcasecmp(name, "yuyv") == 0) *out = V4L2_PIX_FMT_YUYV;
+    else return -1;
+    return 0;
+}
+
+static uint32_t io_memory(V4L2IoMode io)
+{
+    switch (io) {
+    case V4L2_IO_USERPTR: return V4L2_MEMORY_USERPTR;
+    case V4L2_IO_DMABUF:  return V4L2_MEMORY_DMABUF;
+    default:              return V4L2_MEMORY_MMAP;
+    }
+}
+
+static int is_mplane(const V4L2Capture *cap)
+{
+    return cap->buf_type == V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+}
+
+/*
+ * 填好 QUERYBUF / QBUF / DQBUF 共用的 v4l2_buffer 头：类型、内存类型、索引，
+ * 多平面时挂上 planes 数组。QBUF 时再由 buf_set_mem 填 USERPTR 地址 / DMABUF fd。
+ */
+static void buf_prepare(const V4L2Capture *cap, struct v4l2_buffer *buf, struct v4l2_plane *planes,
+                        unsigned int index)
+{
+    memset(buf, 0, sizeof(*buf));
+    memset(planes, 0, sizeof(*planes) * VIDEO_MAX_PLANES);
+    buf->type   = cap->buf_type;
+    buf->memory = io_memory(cap->io);
+    buf->index  = index;
+    if (is_mplane(cap)) {
+        buf->length   = cap->num_planes;
+        buf->m.planes = planes;
+    }
+}
+
+static void buf_set_mem(const V4L2Capture *cap, struct v4l2_buffer *buf, struct v4l2_plane *planes,
+                        unsigned int index)
+{
+    const V4L2Buf *b = &cap->bufs[index];
+    if (cap->io == V4L2_IO_MMAP) return;
+    if (!is_mplane(cap)) {
+        if (cap->io == V4L2_IO_USERPTR) buf->m.userptr = (unsigned long)b->planes[0];
+        else buf->m.fd = b->dmabuf_fds[0];
+        buf->length = (uint32_t)b->lengths[0];
+        return;
+    }
+    for (unsigned int p = 0; p < cap->num_planes; p++) {
+        if (cap->io == V4L2_IO_USERPTR) planes[p].m.userptr = (unsigned long)b->planes[p];
+        else planes[p].m.fd = b->dmabuf_fds[p];
+        planes[p].length = (uint32_t)b->lengths[p];
+    }
+}
+
+/* DMABUF 模式：CPU 读取前（DQBUF 后）/ 读完后（QBUF 前）同步 cache。其他模式由 V4L2 自己维护。 */
+static void buf_cpu_sync(const V4L2Capture *cap, unsigned int index, int begin)
+{
+#if V4L2_HAVE_DMABUF_SYNC
+    if (cap->io != V4L2_IO_DMABUF) return;
+    struct dma_buf_sync sync = {
+        .flags = (begin ? DMA_BUF_SYNC_START : DMA_BUF_SYNC_END) | DMA_BUF_SYNC_READ,
+    };
+    for (unsigned int p = 0; p < cap->num_planes; p++)
+        if (cap->bufs[index].dmabuf_fds[p] >= 0) xioctl(cap->bufs[index].dmabuf_fds[p], DMA_BUF_IOCTL_SYNC, &sync);
+#else
+    (void)cap;
+    (void)index;
+    (void)begin;
+#endif
+}
+
 /*
  * 查询并打印当前设备实际生效的视频格式（VIDIOC_G_FMT）。
  *
@@ -57,19 +176,32 @@ static void fourcc_to_str(uint32_t fourcc, char out[5])
 void v4l2_capture_dump_format(V4L2Capture *cap)
 {
     if (!cap || cap->fd < 0) return;
+    if (cap->src.type != CAPTURE_SRC_DEVICE) {
+        LOGI("[%s] %s fmt: fourcc=NV12 w=%u h=%u bytesperline=%u", TAG,
+             capture_source_name(cap->src.type), cap->width, cap->height, cap->bytesperline[0]);
+        return;
+    }
 
     struct v4l2_format fmt;
     memset(&fmt, 0, sizeof(fmt));
-    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    fmt.type = cap->buf_type;
 
     if (xioctl(cap->fd, VIDIOC_G_FMT, &fmt) < 0) {
         LOGW("[%s] VIDIOC_G_FMT failed: %s", TAG, strerror(errno));
         return;
     }
 
-    const struct v4l2_pix_format_mplane *p = &fmt.fmt.pix_mp;
     char fourcc[5];
-    fourcc_to_str(p->pixelformat, fourcc);
+    if (!is_mplane(cap)) {
+        const struct v4l2_pix_format *p = &fmt.fmt.pix;
+        v4l2_fourcc_str(p->pixelformat, fourcc);
+        LOGI("[%s] device fmt: fourcc=%s w=%u h=%u single-planar bytesperline(stride)=%u sizeimage=%u", TAG,
+             fourcc, p->width, p->height, p->bytesperline, p->sizeimage);
+        return;
+    }
+
+    const struct v4l2_pix_format_mplane *p = &fmt.fmt.pix_mp;
+    v4l2_fourcc_str(p->pixelformat, fourcc);
 
     LOGI("[%s] device fmt: fourcc=%s w=%u h=%u num_planes=%u", TAG,
          fourcc, p->width, p->height, p->num_planes);
@@ -80,12 +212,173 @@ void v4l2_capture_dump_format(V4L2Capture *cap)
     }
 }
 
+/* ===================== Synthetic / replay source ===================== */
 /*
- * 打开 V4L2 设备并初始化采集：
- * 1) open 设备节点
- * 2) 设置采集格式（当前实现固定为 NV12M 两平面）
- * 3) 申请 MMAP buffers，逐个 mmap 映射每个 buffer 的各个 plane
- * 4) 将所有 buffer 入队（QBUF），为后续 STREAMON + DQBUF 做准备
+ * 非设备源的 buffer 轮转模拟驱动行为：
+ * - src_free 位图里的 buffer 相当于已 QBUF，节拍到来时取最低位的一个填充后“出队”；
+ * - realtime：节拍为 timerfd 到期次数，没有空闲 buffer 时这一帧丢弃（sequence 照常递增）；
+ * - 尽快模式：只要有空闲 buffer 就立即出帧；qbuf 时 kick eventfd 唤醒 poll 中的采集线程。
+ * buffer 数默认 SRC_BUF_COUNT，可由 opts->buf_count 指定（位图为 32 位，上限即 V4L2_MAX_BUFS）。
+ */
+#define SRC_BUF_COUNT 4
+
+static int src_open(V4L2Capture *cap, unsigned int width, unsigned int height,
+                    const V4L2CaptureOpts *opts)
+{
+    cap->src    = opts->source;
+    cap->src_fd = -1;
+    if (width < 2 || height < 2) return -1;
+    width  &= ~1u;
+    height &= ~1u;
+
+    if (opts->export_dmabuf)
+        LOGW("[%s] zero-copy needs a V4L2 device, %s source uses the copy path", TAG,
+             capture_source_name(cap->src.type));
+    if ((opts->fourcc && opts->fourcc != V4L2_PIX_FMT_NV12) || opts->io != V4L2_IO_MMAP)
+        LOGW("[%s] %s source always produces NV12 in plain memory, format/io options ignored", TAG,
+             capture_source_name(cap->src.type));
+
+    if (cap->src.type == CAPTURE_SRC_REPLAY) {
+        if (!cap->src.path) {
+            LOGE("[%s] replay source needs a file", TAG);
+            return -1;
+        }
+        cap->src_fd = open(cap->src.path, O_RDONLY | O_CLOEXEC);
+        if (cap->src_fd < 0) {
+            LOGE("[%s] open %s failed: %s", TAG, cap->src.path, strerror(errno));
+            return -1;
+        }
+    }
+
+    unsigned int fps = opts->fps ? opts->fps : 30;
+    if (capture_pacer_open(&cap->pacer, cap->src.realtime, 1000000 / fps) != 0)
+        return -1;   // 由调用者 src_close 清理
+    cap->fd = cap->pacer.fd;
+
+    /* 单平面 NV12，行跨度即宽度（回放文件按紧密排列读入） */
+    cap->width           = width;
+    cap->height          = height;
+    cap->pixelformat     = V4L2_PIX_FMT_NV12;
+    cap->num_planes      = 1;
+    cap->bytesperline[0] = width;
+    cap->frame_size      = (size_t)width * height * 3 / 2;
+    cap->sizeimage[0]    = (unsigned int)cap->frame_size;
+
+    unsigned int nbufs = opts->buf_count ? opts->buf_count : SRC_BUF_COUNT;
+    if (nbufs > V4L2_MAX_BUFS) nbufs = V4L2_MAX_BUFS;
+    if (nbufs < V4L2_MIN_BUFS) nbufs = V4L2_MIN_BUFS;
+    for (unsigned int i = 0; i < nbufs; i++) {
+        void *mem = mem_arena_alloc(MEM_STAGE_CAPTURE, cap->frame_size, 0);
+        if (!mem) {
+            LOGE("[%s] alloc source buffer failed", TAG);
+            return -1;   // 已分配的由 close 释放
+        }
+        cap->bufs[i].planes[0]  = mem;
+        cap->bufs[i].lengths[0] = cap->frame_size;
+        cap->buf_count = i + 1;
+    }
+    atomic_store(&cap->src_free, nbufs >= 32 ? ~0u : (1u << nbufs) - 1);
+
+    LOGI("[%s] %s source: %ux%u NV12 @%u fps, %u buffers, %s%s%s", TAG, capture_source_name(cap->src.type),
+         width, height, fps, nbufs, cap->src.realtime ? "realtime" : "as fast as possible",
+         cap->src_fd >= 0 ? ", file=" : "", cap->src_fd >= 0 ? cap->src.path : "");
+    return 0;
+}
+
+static int src_start(V4L2Capture *cap)
+{
+    cap->src_start_us = media_clock_now_us();
+    if (capture_pacer_start(&cap->pacer) != 0) return -1;
+    LOGI("[%s] source started", TAG);
+    return 0;
+}
+
+/* 取一个空闲 buffer 的索引；没有则返回 -1 */
+static int src_take_free(V4L2Capture *cap)
+{
+    unsigned int m = atomic_load(&cap->src_free);
+    while (m) {
+        unsigned int bit = m & -m;
+        if (atomic_compare_exchange_weak(&cap->src_free, &m, m & ~bit))
+            return __builtin_ctz(bit);
+    }
+    return -1;
+}
+
+static int src_dqbuf(V4L2Capture *cap, int *index)
+{
+    uint64_t seq = cap->src_seq;
+    int idx;
+
+    if (cap->src.realtime) {
+        uint64_t ticks = capture_pacer_take(&cap->pacer);
+        if (ticks == 0) return 1;
+        /* 多个节拍积压时只出最后一帧，之前的按丢帧处理（sequence 跳变） */
+        seq = cap->src_seq + ticks - 1;
+        cap->src_seq += ticks;
+        idx = src_take_free(cap);
+        if (idx < 0) return 1;   // 下游没归还 buffer：这一帧丢弃
+    } else {
+        idx = src_take_free(cap);
+        if (idx < 0) {
+            /* 清掉 kick 后再查一次，避免与 qbuf 的竞争丢失唤醒 */
+            capture_pacer_take(&cap->pacer);
+            idx = src_take_free(cap);
+            if (idx < 0) return 1;
+        }
+        cap->src_seq++;
+    }
+
+    V4L2Buf *b = &cap->bufs[idx];
+    if (cap->src.type == CAPTURE_SRC_REPLAY) {
+        if (capture_source_read_loop(cap->src_fd, (uint8_t *)b->planes[0], cap->frame_size) != 0) {
+            atomic_fetch_or(&cap->src_free, 1u << idx);
+            return -1;
+        }
+    } else {
+        Nv12Planes p;
+        v4l2_capture_get_planes(cap, idx, &p);
+        int with_uv = !(cap->src_uv_done & (1u << idx));
+        capture_source_synth_nv12(&p, cap->width, cap->height, seq, with_uv);
+        cap->src_uv_done |= 1u << idx;
+    }
+
+    b->sequence     = (uint32_t)seq;
+    b->bytesused[0] = cap->frame_size;
+    b->timestamp_us = cap->src_start_us + (int64_t)(seq * (uint64_t)cap->pacer.period_us);
+    cap->last_index    = idx;
+    cap->last_sequence = b->sequence;
+    *index = idx;
+    return 0;
+}
+
+static int src_qbuf(V4L2Capture *cap, int index)
+{
+    if (index < 0 || (unsigned int)index >= cap->buf_count) return -1;
+    atomic_fetch_or(&cap->src_free, 1u << index);
+    capture_pacer_kick(&cap->pacer);
+    return 0;
+}
+
+static void src_close(V4L2Capture *cap)
+{
+    for (unsigned int i = 0; i < cap->buf_count; i++) {
+        mem_arena_free(cap->bufs[i].planes[0]);
+        cap->bufs[i].planes[0]  = NULL;
+        cap->bufs[i].lengths[0] = 0;
+    }
+    capture_pacer_close(&cap->pacer);
+    cap->fd = -1;
+    if (cap->src_fd >= 0) close(cap->src_fd);
+    cap->src_fd    = -1;
+    cap->buf_count = 0;
+    cap->src.type  = CAPTURE_SRC_DEVICE;
+    LOGI("[%s] capture closed", TAG);
+}
+
+/*
+ * 打开 V4L2 设备并初始化采集（默认参数：自动协商格式，多平面设备优先 NV12M + 合帧拷贝；
+ * MMAP，V4L2_DEFAULT_BUFS 个 buffer）。
  *
  * @param cap    采集上下文（输出）
  * @param dev    设备路径（例如 /dev/video0）
@@ -96,132 +389,430 @@ void v4l2_capture_dump_format(V4L2Capture *cap)
 int v4l2_capture_open(V4L2Capture *cap, const char *dev,
                       unsigned int width, unsigned int height)
 {
-    if (!cap || !dev) return -1;
+    return v4l2_capture_open_opts(cap, dev, width, height, NULL);
+}
 
-    memset(cap, 0, sizeof(*cap));
-    cap->fd = -1;
+/* ===================== Device: format / buffers ===================== */
 
-    cap->fd = open(dev, O_RDWR | O_NONBLOCK, 0);
-    if (cap->fd < 0) {
-        LOGE("[%s] open %s failed: %s", TAG, dev, strerror(errno));
+/*
+ * 查询设备能力，确定 buffer 类型：支持多平面（rkisp 等）时用 VIDEO_CAPTURE_MPLANE，
+ * 只支持单平面（UVC 等）时用 VIDEO_CAPTURE。QUERYCAP 失败时按多平面处理。
+ *
+ * @return 0 成功；-1 不是支持流式 I/O 的视频采集设备
+ */
+static int query_buf_type(V4L2Capture *cap, const char *dev)
+{
+    struct v4l2_capability vc;
+    memset(&vc, 0, sizeof(vc));
+    if (xioctl(cap->fd, VIDIOC_QUERYCAP, &vc) < 0) {
+        LOGW("[%s] VIDIOC_QUERYCAP failed: %s, assuming multi-planar", TAG, strerror(errno));
+        cap->buf_type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        return 0;
+    }
+
+    uint32_t caps = (vc.capabilities & V4L2_CAP_DEVICE_CAPS) ? vc.device_caps : vc.capabilities;
+    if (caps & V4L2_CAP_VIDEO_CAPTURE_MPLANE) {
+        cap->buf_type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    } else if (caps & V4L2_CAP_VIDEO_CAPTURE) {
+        cap->buf_type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    } else {
+        LOGE("[%s] %s (%s) is not a video capture device (caps=0x%x)", TAG, dev, (const char *)vc.card, caps);
+        return -1;
+    }
+    if (!(caps & V4L2_CAP_STREAMING)) {
+        LOGE("[%s] %s (%s) does not support streaming I/O", TAG, dev, (const char *)vc.card);
         return -1;
     }
 
-    /*
-     * 设置格式：NV12M 多平面（Y/UV 两个 plane）。
-     * 注意：驱动可能会调整 width/height/stride/sizeimage，后面会 dump 一次。
-     */
+    LOGI("[%s] %s: driver=%s card=%s %s", TAG, dev, (const char *)vc.driver, (const char *)vc.card,
+         is_mplane(cap) ? "multi-planar" : "single-planar");
+    return 0;
+}
+
+/* 设备是否支持 fourcc。@return 1 支持；0 不支持；-1 驱动不支持 VIDIOC_ENUM_FMT（无法判断） */
+static int device_has_fmt(const V4L2Capture *cap, uint32_t fourcc)
+{
+    for (uint32_t i = 0;; i++) {
+        struct v4l2_fmtdesc d;
+        memset(&d, 0, sizeof(d));
+        d.index = i;
+        d.type  = cap->buf_type;
+        if (xioctl(cap->fd, VIDIOC_ENUM_FMT, &d) < 0) return i == 0 ? -1 : 0;
+        if (d.pixelformat == fourcc) return 1;
+    }
+}
+
+/*
+ * 选择采集格式。指定了 fourcc 时直接使用（能否设置由 S_FMT 决定）；
+ * 自动时取偏好顺序里设备支持的第一个：
+ * - 零拷贝：NV12 > NV12M > YUYV（只有整帧一块 buffer 的 NV12 能直接导入 MPP）
+ * - 拷贝：NV12M > NV12 > YUYV
+ * 单平面设备跳过 NV12M；驱动不支持枚举时取第一个候选。
+ */
+static uint32_t pick_fourcc(const V4L2Capture *cap, uint32_t want, int export_dmabuf)
+{
+    if (want) return want;
+
+    static const uint32_t pref_copy[] = { V4L2_PIX_FMT_NV12M, V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_YUYV };
+    static const uint32_t pref_zc[]   = { V4L2_PIX_FMT_NV12, V4L2_PIX_FMT_NV12M, V4L2_PIX_FMT_YUYV };
+    const uint32_t *pref = export_dmabuf ? pref_zc : pref_copy;
+
+    uint32_t first = 0;
+    for (int i = 0; i < 3; i++) {
+        if (pref[i] == V4L2_PIX_FMT_NV12M && !is_mplane(cap)) continue;
+        if (!first) first = pref[i];
+        int has = device_has_fmt(cap, pref[i]);
+        if (has < 0) break;
+        if (has) return pref[i];
+    }
+    return first;
+}
+
+/*
+ * 设置格式（VIDIOC_S_FMT）并记录驱动实际生效的值。
+ * 驱动可能调整 width/height/stride/sizeimage，以返回值为准；换成别的 fourcc 则视为不支持。
+ *
+ * @return 0 成功；-1 失败
+ */
+static int set_format(V4L2Capture *cap, uint32_t fourcc, unsigned int width, unsigned int height)
+{
     struct v4l2_format fmt;
     memset(&fmt, 0, sizeof(fmt));
-    fmt.type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-    fmt.fmt.pix_mp.width       = width;
-    fmt.fmt.pix_mp.height      = height;
-    fmt.fmt.pix_mp.pixelformat = V4L2_PIX_FMT_NV12M;
-    fmt.fmt.pix_mp.num_planes  = 2;
+    fmt.type = cap->buf_type;
+    if (is_mplane(cap)) {
+        fmt.fmt.pix_mp.width       = width;
+        fmt.fmt.pix_mp.height      = height;
+        fmt.fmt.pix_mp.pixelformat = fourcc;
+        fmt.fmt.pix_mp.num_planes  = fourcc == V4L2_PIX_FMT_NV12M ? 2 : 1;
+    } else {
+        fmt.fmt.pix.width       = width;
+        fmt.fmt.pix.height      = height;
+        fmt.fmt.pix.pixelformat = fourcc;
+    }
 
     if (xioctl(cap->fd, VIDIOC_S_FMT, &fmt) < 0) {
         LOGE("[%s] VIDIOC_S_FMT failed: %s", TAG, strerror(errno));
-        close(cap->fd);
-        cap->fd = -1;
         return -1;
     }
 
-    cap->width  = width;
-    cap->height = height;
-    cap->frame_size = width * height * 3 / 2;
+    uint32_t got, num_planes;
+    unsigned int w, h;
+    if (is_mplane(cap)) {
+        got        = fmt.fmt.pix_mp.pixelformat;
+        num_planes = fmt.fmt.pix_mp.num_planes;
+        w          = fmt.fmt.pix_mp.width;
+        h          = fmt.fmt.pix_mp.height;
+    } else {
+        got        = fmt.fmt.pix.pixelformat;
+        num_planes = 1;
+        w          = fmt.fmt.pix.width;
+        h          = fmt.fmt.pix.height;
+    }
 
-    /*
-     * 上层期望拿到连续内存的 NV12（Y + UV），而 NV12M 是多平面：
-     * 这里额外申请一块连续缓冲用于“合帧”。
-     */
-    cap->nv12_frame = (uint8_t *)malloc(cap->frame_size);
-    if (!cap->nv12_frame) {
-        LOGE("[%s] malloc nv12_frame failed", TAG);
-        close(cap->fd);
-        cap->fd = -1;
+    char fourcc_str[5], want_str[5];
+    v4l2_fourcc_str(got, fourcc_str);
+    v4l2_fourcc_str(fourcc, want_str);
+    if (got != fourcc || num_planes == 0 || num_planes > V4L2_MAX_PLANES) {
+        LOGE("[%s] driver returned unsupported fmt %s num_planes=%u (wanted %s)", TAG,
+             fourcc_str, num_planes, want_str);
+        return -1;
+    }
+
+    /* 以驱动实际生效的尺寸为准（可能会被调整），后续 repack 按它读取 */
+    if (w != width || h != height)
+        LOGW("[%s] driver adjusted size %ux%u -> %ux%u", TAG, width, height, w, h);
+    cap->width       = w;
+    cap->height      = h;
+    cap->pixelformat = got;
+    cap->num_planes  = num_planes;
+    if (is_mplane(cap)) {
+        for (unsigned int p = 0; p < num_planes; p++) {
+            cap->bytesperline[p] = fmt.fmt.pix_mp.plane_fmt[p].bytesperline;
+            cap->sizeimage[p]    = fmt.fmt.pix_mp.plane_fmt[p].sizeimage;
+        }
+    } else {
+        cap->bytesperline[0] = fmt.fmt.pix.bytesperline;
+        cap->sizeimage[0]    = fmt.fmt.pix.sizeimage;
+    }
+    return 0;
+}
+
+/* 第 p 个 plane 的字节数：驱动给了 sizeimage 就用它，否则按 fourcc 与 stride 推算 */
+static size_t plane_size(const V4L2Capture *cap, unsigned int p)
+{
+    if (cap->sizeimage[p]) return cap->sizeimage[p];
+    size_t h = cap->height;
+    switch (cap->pixelformat) {
+    case V4L2_PIX_FMT_YUYV:
+        return (size_t)(cap->bytesperline[0] ? cap->bytesperline[0] : cap->width * 2) * h;
+    case V4L2_PIX_FMT_NV12M:
+        return (size_t)(cap->bytesperline[p] ? cap->bytesperline[p] : cap->width) * (p == 0 ? h : h / 2);
+    default:
+        return (size_t)(cap->bytesperline[0] ? cap->bytesperline[0] : cap->width) * h * 3 / 2;
+    }
+}
+
+/*
+ * MMAP：QUERYBUF 取每个 plane 的 offset/length 后逐个 mmap（NV12M: Y / UV；其余: 整帧），
+ * 零拷贝模式下再用 VIDIOC_EXPBUF 导出 DMABUF fd，之后由编码器一次性导入。
+ *
+ * @return 0 成功；-1 失败（已映射的部分由 close 释放）
+ */
+static int map_mmap_buf(V4L2Capture *cap, unsigned int i, int export_dmabuf)
+{
+    struct v4l2_buffer buf;
+    struct v4l2_plane  planes[VIDEO_MAX_PLANES];
+    buf_prepare(cap, &buf, planes, i);
+
+    if (xioctl(cap->fd, VIDIOC_QUERYBUF, &buf) < 0) {
+        LOGE("[%s] QUERYBUF[%u] failed: %s", TAG, i, strerror(errno));
+        return -1;
+    }
+
+    for (unsigned int p = 0; p < cap->num_planes; p++) {
+        size_t len    = is_mplane(cap) ? planes[p].length : buf.length;
+        off_t  offset = is_mplane(cap) ? (off_t)planes[p].m.mem_offset : (off_t)buf.m.offset;
+        /* 驱动分配的 buffer 不在 arena 里，只计入预算 */
+        if (mem_arena_charge(MEM_STAGE_CAPTURE, len) != 0) return -1;
+        void *addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, cap->fd, offset);
+        if (addr == MAP_FAILED) {
+            LOGE("[%s] mmap[%u][%u] failed: %s", TAG, i, p, strerror(errno));
+            mem_arena_uncharge(MEM_STAGE_CAPTURE, len);
+            return -1;
+        }
+        cap->bufs[i].planes[p]  = addr;
+        cap->bufs[i].lengths[p] = len;
+
+        if (export_dmabuf) {
+            struct v4l2_exportbuffer expbuf;
+            memset(&expbuf, 0, sizeof(expbuf));
+            expbuf.type  = cap->buf_type;
+            expbuf.index = i;
+            expbuf.plane = p;
+            expbuf.flags = O_CLOEXEC | O_RDWR;
+
+            if (xioctl(cap->fd, VIDIOC_EXPBUF, &expbuf) < 0) {
+                LOGE("[%s] EXPBUF[%u][%u] failed: %s", TAG, i, p, strerror(errno));
+                return -1;
+            }
+            cap->bufs[i].dmabuf_fds[p] = expbuf.fd;
+        }
+    }
+    return 0;
+}
+
+/*
+ * USERPTR / DMABUF：为 buffer i 的各 plane 分配内存（按 plane_size，向上取整到页）。
+ * DMABUF 从 dma-heap 分配后 mmap，拷贝路径（CPU）与零拷贝导入（MPP）用的是同一个 fd。
+ *
+ * @param heap_fd  dma-heap 设备（仅 DMABUF）
+ * @return 0 成功；-1 失败（已分配的部分由 close 释放）
+ */
+static int alloc_user_buf(V4L2Capture *cap, unsigned int i, int heap_fd)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    for (unsigned int p = 0; p < cap->num_planes; p++) {
+        size_t len = (plane_size(cap, p) + page - 1) & ~(page - 1);
+        if (cap->io == V4L2_IO_USERPTR) {
+            void *mem = mem_arena_alloc(MEM_STAGE_CAPTURE, len, page);
+            if (!mem) {
+                LOGE("[%s] alloc userptr buffer[%u][%u] (%zu bytes) failed", TAG, i, p, len);
+                return -1;
+            }
+            cap->bufs[i].planes[p]  = mem;
+            cap->bufs[i].lengths[p] = len;
+            continue;
+        }
+#if V4L2_HAVE_DMA_HEAP
+        if (mem_arena_charge(MEM_STAGE_CAPTURE, len) != 0) return -1;
+        struct dma_heap_allocation_data alloc = { .len = len, .fd_flags = O_RDWR | O_CLOEXEC };
+        if (xioctl(heap_fd, DMA_HEAP_IOCTL_ALLOC, &alloc) < 0) {
+            LOGE("[%s] dma-heap alloc buffer[%u][%u] (%zu bytes) failed: %s", TAG, i, p, len, strerror(errno));
+            mem_arena_uncharge(MEM_STAGE_CAPTURE, len);
+            return -1;
+        }
+        cap->bufs[i].dmabuf_fds[p] = (int)alloc.fd;
+        void *addr = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, (int)alloc.fd, 0);
+        if (addr == MAP_FAILED) {
+            LOGE("[%s] mmap dma-heap buffer[%u][%u] failed: %s", TAG, i, p, strerror(errno));
+            mem_arena_uncharge(MEM_STAGE_CAPTURE, len);
+            return -1;
+        }
+        cap->bufs[i].planes[p]  = addr;
+        cap->bufs[i].lengths[p] = len;
+#else
+        (void)heap_fd;
+        LOGE("[%s] built without <linux/dma-heap.h>, dmabuf io unavailable", TAG);
+        return -1;
+#endif
+    }
+    return 0;
+}
+
+/* buffer 入队：让驱动可以往该 buffer 里填充下一帧数据。@return 0 成功；-1 失败 */
+static int queue_buf(V4L2Capture *cap, unsigned int index)
+{
+    struct v4l2_buffer buf;
+    struct v4l2_plane  planes[VIDEO_MAX_PLANES];
+    buf_prepare(cap, &buf, planes, index);
+    buf_set_mem(cap, &buf, planes, index);
+
+    if (xioctl(cap->fd, VIDIOC_QBUF, &buf) < 0) {
+        LOGE("[%s] QBUF[%u] failed: %s", TAG, index, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * 打开 V4L2 设备并初始化采集：
+ * 1) open 设备节点，QUERYCAP 确定多平面 / 单平面
+ * 2) 协商并设置采集格式（见 pick_fourcc；零拷贝需单平面 NV12，否则回退拷贝路径）
+ * 3) 按 opts->io 申请 buffers（驱动可能少给）：MMAP 逐 plane mmap（零拷贝时 VIDIOC_EXPBUF 导出），
+ *    USERPTR / DMABUF 由这里分配内存
+ * 4) 将所有 buffer 入队（QBUF），为后续 STREAMON + DQBUF 做准备
+ *
+ * @param cap    采集上下文（输出）
+ * @param dev    设备路径（例如 /dev/video0）
+ * @param width  期望宽度
+ * @param height 期望高度
+ * @param opts   打开参数，可为 NULL
+ * @return       0 成功；-1 失败（失败时内部会清理资源）
+ */
+int v4l2_capture_open_opts(V4L2Capture *cap, const char *dev,
+                           unsigned int width, unsigned int height,
+                           const V4L2CaptureOpts *opts)
+{
+    int is_src = opts && opts->source.type != CAPTURE_SRC_DEVICE;
+    if (!cap || (!dev && !is_src)) return -1;
+
+    memset(cap, 0, sizeof(*cap));
+    cap->fd = -1;
+    cap->src_fd = -1;
+    cap->pacer.fd = -1;
+    for (unsigned int i = 0; i < V4L2_MAX_BUFS; i++)
+        for (int p = 0; p < V4L2_MAX_PLANES; p++)
+            cap->bufs[i].dmabuf_fds[p] = -1;
+
+    if (is_src) {
+        if (src_open(cap, width, height, opts) != 0) {
+            src_close(cap);
+            return -1;
+        }
+        return 0;
+    }
+
+    int export_dmabuf = opts ? opts->export_dmabuf : 0;
+    unsigned int want_bufs = (opts && opts->buf_count) ? opts->buf_count : V4L2_DEFAULT_BUFS;
+    if (want_bufs > V4L2_MAX_BUFS) want_bufs = V4L2_MAX_BUFS;
+    cap->io = opts ? opts->io : V4L2_IO_MMAP;
+    int heap_fd = -1;
+
+    cap->fd = open(dev, O_RDWR | O_NONBLOCK, 0);
+    if (cap->fd < 0) {
+        LOGE("[%s] open %s failed: %s", TAG, dev, strerror(errno));
         return -1;
     }
+    if (query_buf_type(cap, dev) != 0) goto fail;
+
+    uint32_t fourcc = pick_fourcc(cap, opts ? opts->fourcc : 0, export_dmabuf);
+    char fourcc_str[5];
+    v4l2_fourcc_str(fourcc, fourcc_str);
+    if (export_dmabuf && fourcc != V4L2_PIX_FMT_NV12) {
+        LOGW("[%s] zero-copy needs single-plane NV12, %s uses the copy path", TAG, fourcc_str);
+        export_dmabuf = 0;
+    }
+    if (export_dmabuf && cap->io == V4L2_IO_USERPTR) {
+        LOGW("[%s] zero-copy needs mmap or dmabuf io, userptr uses the copy path", TAG);
+        export_dmabuf = 0;
+    }
+    if (set_format(cap, fourcc, width, height) != 0) goto fail;
+
+    if (export_dmabuf) {
+        /*
+         * 单平面 NV12：帧大小按驱动 stride 计算（UV 起始于 bytesperline*height）。
+         * 数据直接留在 V4L2 buffer 里，不需要合帧缓冲。
+         */
+        unsigned int stride = cap->bytesperline[0] ? cap->bytesperline[0] : cap->width;
+        cap->frame_size = (size_t)stride * cap->height * 3 / 2;
+    } else if (cap->pixelformat == V4L2_PIX_FMT_YUYV) {
+        /* YUYV：DQBUF 时转成紧密排列的 NV12，写进每个 buffer 自己的 shadow（见下） */
+        cap->frame_size = (size_t)cap->width * cap->height * 3 / 2;
+    } else {
+        cap->frame_size = (size_t)cap->width * cap->height * 3 / 2;
+
+        /*
+         * 上层期望拿到连续内存的 NV12（Y + UV），而 NV12M 是多平面：
+         * 这里额外申请一块连续缓冲用于“合帧”。
+         */
+        cap->nv12_frame = (uint8_t *)mem_arena_alloc(MEM_STAGE_CAPTURE, cap->frame_size, 0);
+        if (!cap->nv12_frame) {
+            LOGE("[%s] alloc nv12_frame failed", TAG);
+            goto fail;
+        }
+    }
 
-    LOGI("[%s] format set: %ux%u NV12M", TAG, cap->width, cap->height);
+    LOGI("[%s] format set: %ux%u %s%s io=%s", TAG, cap->width, cap->height, fourcc_str,
+         export_dmabuf ? " (dmabuf)" : "", v4l2_io_name(cap->io));
 
     v4l2_capture_dump_format(cap);
 
-    /*
-     * 申请内核侧采集 buffer（MMAP）。驱动会返回实际分配的 count。
-     * 一般至少需要 2 个 buffer 才能较平滑地采集。
-     */
+    /* 申请采集 buffer。驱动会返回实际分配的 count（可能少于请求值）。 */
     struct v4l2_requestbuffers req;
     memset(&req, 0, sizeof(req));
-    req.count  = V4L2_MAX_BUFS;
-    req.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-    req.memory = V4L2_MEMORY_MMAP;
+    req.count  = want_bufs;
+    req.type   = cap->buf_type;
+    req.memory = io_memory(cap->io);
 
     if (xioctl(cap->fd, VIDIOC_REQBUFS, &req) < 0) {
-        LOGE("[%s] REQBUFS failed: %s", TAG, strerror(errno));
+        LOGE("[%s] REQBUFS(%u, %s) failed: %s", TAG, want_bufs, v4l2_io_name(cap->io), strerror(errno));
         goto fail;
     }
-    if (req.count < 2) {
-        LOGE("[%s] not enough buffers", TAG);
+    if (req.count < V4L2_MIN_BUFS) {
+        LOGE("[%s] not enough buffers (%u)", TAG, req.count);
         goto fail;
     }
 
     cap->buf_count = req.count;
     if (cap->buf_count > V4L2_MAX_BUFS)
         cap->buf_count = V4L2_MAX_BUFS;   // 保护一下
+    if (cap->buf_count != want_bufs)
+        LOGW("[%s] requested %u buffers, driver gave %u", TAG, want_bufs, cap->buf_count);
 
-    /*
-     * mmap 每个 buffer 的两个 plane：Y / UV
-     * 典型流程：QUERYBUF 获取每个 plane 的 offset/length，然后逐 plane mmap。
-     */
-    for (unsigned int i = 0; i < cap->buf_count; i++) {
-        struct v4l2_buffer buf;
-        struct v4l2_plane  planes[VIDEO_MAX_PLANES];
-
-        memset(&buf, 0, sizeof(buf));
-        memset(planes, 0, sizeof(planes));
-
-        buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-        buf.memory = V4L2_MEMORY_MMAP;
-        buf.index  = i;
-        buf.length = 2;
-        buf.m.planes = planes;
-
-        if (xioctl(cap->fd, VIDIOC_QUERYBUF, &buf) < 0) {
-            LOGE("[%s] QUERYBUF[%u] failed: %s", TAG, i, strerror(errno));
+    if (cap->io == V4L2_IO_DMABUF) {
+        heap_fd = open(V4L2_DMA_HEAP_PATH, O_RDWR | O_CLOEXEC);
+        if (heap_fd < 0) {
+            LOGE("[%s] open %s failed: %s", TAG, V4L2_DMA_HEAP_PATH, strerror(errno));
             goto fail;
         }
+    }
 
-        /*
-         * 映射各 plane 内存。
-         * plane 0 通常是 Y，plane 1 通常是 UV（NV12M）。
-         */
-        for (unsigned int p = 0; p < buf.length && p < V4L2_MAX_PLANES && p < V4L2_MAX_PLANES; p++) {
-            size_t len = planes[p].length;
-            void *addr = mmap(NULL, len,
-                              PROT_READ | PROT_WRITE,
-                              MAP_SHARED,
-                              cap->fd,
-                              planes[p].m.mem_offset);
-            if (addr == MAP_FAILED) {
-                LOGE("[%s] mmap[%u][%u] failed: %s", TAG, i, p, strerror(errno));
+    for (unsigned int i = 0; i < cap->buf_count; i++) {
+        int ret = cap->io == V4L2_IO_MMAP ? map_mmap_buf(cap, i, export_dmabuf) : alloc_user_buf(cap, i, heap_fd);
+        if (ret != 0) goto fail;
+
+        if (cap->pixelformat == V4L2_PIX_FMT_YUYV) {
+            void *mem = mem_arena_alloc(MEM_STAGE_CAPTURE, cap->frame_size, 0);
+            if (!mem) {
+                LOGE("[%s] alloc yuyv shadow buffer failed", TAG);
                 goto fail;
             }
-
-            cap->bufs[i].planes[p]  = addr;
-            cap->bufs[i].lengths[p] = len;
+            cap->bufs[i].shadow = (uint8_t *)mem;
         }
 
-        /* buffer 入队：让驱动可以往该 buffer 里填充下一帧数据 */
-        if (xioctl(cap->fd, VIDIOC_QBUF, &buf) < 0) {
-            LOGE("[%s] QBUF[%u] failed: %s", TAG, i, strerror(errno));
-            goto fail;
-        }
+        if (queue_buf(cap, i) != 0) goto fail;
     }
+    if (heap_fd >= 0) close(heap_fd);
+
+    /* DMABUF 模式的 fd 本来就是 dma-heap 分配的，零拷贝时直接交给编码器导入 */
+    cap->dmabuf_exported = export_dmabuf;
 
-    LOGI("[%s] %u buffers prepared", TAG, cap->buf_count);
+    LOGI("[%s] %u buffers prepared (%s%s)", TAG, cap->buf_count, v4l2_io_name(cap->io),
+         export_dmabuf ? ", dmabuf exported" : "");
     return 0;
 
 fail:
+    if (heap_fd >= 0) close(heap_fd);
     v4l2_capture_close(cap);
     return -1;
 }
@@ -233,8 +824,9 @@ fail:
 int v4l2_capture_start(V4L2Capture *cap)
 {
     if (!cap || cap->fd < 0) return -1;
+    if (cap->src.type != CAPTURE_SRC_DEVICE) return src_start(cap);
 
-    enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+    enum v4l2_buf_type type = (enum v4l2_buf_type)cap->buf_type;
     if (xioctl(cap->fd, VIDIOC_STREAMON, &type) < 0) {
         LOGE("[%s] STREAMON failed: %s", TAG, strerror(errno));
         return -1;
@@ -245,31 +837,47 @@ int v4l2_capture_start(V4L2Capture *cap)
 }
 
 /*
- * 出队一个已填充的采集 buffer（VIDIOC_DQBUF），并将 NV12M 两个 plane
- * 合成为一帧连续 NV12（Y + UV）返回给上层。
+ * YUYV：把刚出队的 buffer 转成 NV12 写进它的 shadow。
+ * 在采集线程里做，之后各 lane 读 shadow（与 NV12 单平面 buffer 一样只读、可并发）。
+ *
+ * @return 0 成功；-1 数据不完整
+ */
+static int yuyv_convert(V4L2Capture *cap, V4L2Buf *b)
+{
+    unsigned int stride = cap->bytesperline[0] ? cap->bytesperline[0] : cap->width * 2;
+    unsigned int rows = cap->height;
+    if (b->bytesused[0] && b->bytesused[0] / stride < rows)
+        rows = (unsigned int)(b->bytesused[0] / stride);
+
+    Nv12Planes dst = {
+        .y         = b->shadow,
+        .uv        = b->shadow + (size_t)cap->width * cap->height,
+        .y_stride  = cap->width,
+        .uv_stride = cap->width,
+    };
+    return yuyv_to_nv12((const uint8_t *)b->planes[0], stride, &dst, cap->width, rows);
+}
+
+/*
+ * 出队一个已填充的采集 buffer（VIDIOC_DQBUF），只记录元数据，不访问像素数据
+ * （YUYV 例外：在这里转成 NV12）。
+ *
+ * 出队后 buffer 归调用者所有，直到 v4l2_capture_qbuf 归还；
+ * sequence/bytesused 保存在 cap->bufs[index] 里，可以和 index 一起传给下游线程。
  *
  * @param cap     采集上下文
- * @param index   输出：本次出队的 buffer 索引（后续需要用 qbuf 归还）
- * @param data    输出：指向连续 NV12 数据（cap->nv12_frame）
- * @param length  输出：数据长度（固定为 cap->frame_size）
- * @return        0 成功；1 暂时无数据（EAGAIN）；-1 失败
+ * @param index   输出：本次出队的 buffer 索引
+ * @return        0 成功；1 暂时无数据（EAGAIN，或 YUYV 帧不完整已归还）；-1 失败
  */
-int v4l2_capture_dqbuf(V4L2Capture *cap, int *index,
-                       void **data, size_t *length)
+int v4l2_capture_dqbuf_index(V4L2Capture *cap, int *index)
 {
-    if (!cap || cap->fd < 0 || !index || !data || !length)
+    if (!cap || cap->fd < 0 || !index)
         return -1;
+    if (cap->src.type != CAPTURE_SRC_DEVICE) return src_dqbuf(cap, index);
 
     struct v4l2_buffer buf;
     struct v4l2_plane  planes[VIDEO_MAX_PLANES];
-
-    memset(&buf, 0, sizeof(buf));
-    memset(planes, 0, sizeof(planes));
-
-    buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-    buf.memory = V4L2_MEMORY_MMAP;
-    buf.length = 2;
-    buf.m.planes = planes;
+    buf_prepare(cap, &buf, planes, 0);
 
     int r = xioctl(cap->fd, VIDIOC_DQBUF, &buf);
     if (r < 0) {
@@ -280,33 +888,103 @@ int v4l2_capture_dqbuf(V4L2Capture *cap, int *index,
     }
 
     int idx = buf.index;
+    if (idx < 0 || (unsigned int)idx >= cap->buf_count) {
+        LOGE("[%s] DQBUF returned bad index %d", TAG, idx);
+        return -1;
+    }
+
+    V4L2Buf *b = &cap->bufs[idx];
+    b->sequence = buf.sequence;
+    if (is_mplane(cap)) {
+        for (unsigned int p = 0; p < cap->num_planes && p < V4L2_MAX_PLANES; p++)
+            b->bytesused[p] = planes[p].bytesused;
+    } else {
+        b->bytesused[0] = buf.bytesused;
+    }
+    buf_cpu_sync(cap, (unsigned int)idx, 1);
+
+    if (b->shadow && yuyv_convert(cap, b) != 0) {
+        /* 不完整的帧直接还给驱动，下一帧的 sequence 跳变会计入丢帧 */
+        LOGW("[%s] short yuyv frame (bytesused=%zu), requeued", TAG, b->bytesused[0]);
+        v4l2_capture_qbuf(cap, idx);
+        return 1;
+    }
+
     *index  = idx;
     cap->last_index = idx;
     cap->last_sequence = buf.sequence;
 
-    /* NV12M: plane0 = Y, plane1 = UV */
-    size_t y_size  = cap->width * cap->height;
-    size_t uv_size = cap->width * cap->height / 2;
-
     /*
-     * 防止 bytesused 比理论值小：某些驱动可能返回更小的有效数据长度。
-     * 这里按较小者拷贝，避免越界读。
+     * 采集时间戳：驱动标记为 MONOTONIC 时直接使用（与 ALSA htimestamp 同一时间轴），
+     * 否则退化为出队时刻（含调度延迟，仅作兜底）。
      */
-    if (planes[0].bytesused && planes[0].bytesused < y_size)
-        y_size = planes[0].bytesused;
-    if (planes[1].bytesused && planes[1].bytesused < uv_size)
-        uv_size = planes[1].bytesused;
+    if ((buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC &&
+        (buf.timestamp.tv_sec || buf.timestamp.tv_usec)) {
+        b->timestamp_us = media_clock_timeval_us(&buf.timestamp);
+    } else {
+        if (cap->ts_fallback++ == 0)
+            LOGW("[%s] driver timestamp not monotonic (flags=0x%x), using dequeue time", TAG, buf.flags);
+        b->timestamp_us = media_clock_now_us();
+    }
 
-    uint8_t *dst = cap->nv12_frame;
+    return 0;
+}
 
-    /* 合帧：Y 紧跟 UV，组成连续 NV12 */
-    memcpy(dst,
-           cap->bufs[idx].planes[0],
-           y_size);
+/*
+ * 取出一个已出队 buffer 的连续 NV12 数据：
+ * - 单平面 NV12：数据本身就是连续的，直接返回 V4L2 buffer 的映射地址（零拷贝）
+ * - YUYV：返回出队时转好的 shadow
+ * - NV12M：将两个 plane 合成为一帧连续 NV12（Y + UV）写入 cap->nv12_frame
+ *
+ * 注意：nv12_frame 只有一块，同一时刻只能由一个线程调用本函数。
+ *
+ * @param cap     采集上下文
+ * @param index   buffer 索引（来自 dqbuf_index）
+ * @param data    输出：指向连续 NV12 数据
+ * @param length  输出：数据长度（固定为 cap->frame_size）
+ * @return        0 成功；-1 失败
+ */
+int v4l2_capture_get_frame(V4L2Capture *cap, int index,
+                           void **data, size_t *length)
+{
+    if (!cap || !data || !length || index < 0 || (unsigned int)index >= cap->buf_count)
+        return -1;
 
-    memcpy(dst + cap->width * cap->height,
-           cap->bufs[idx].planes[1],
-           uv_size);
+    V4L2Buf *b = &cap->bufs[index];
+
+    if (b->shadow || !cap->nv12_frame) {
+        *data   = b->shadow ? (void *)b->shadow : b->planes[0];
+        *length = cap->frame_size;
+        return 0;
+    }
+    /*
+     * NV12M: plane0 = Y, plane1 = UV。
+     * 驱动可能按行填充（bytesperline > width），逐行去掉填充后合成连续 NV12。
+     */
+    Nv12Planes src;
+    if (v4l2_capture_get_planes(cap, index, &src) != 0) return -1;
+
+    /*
+     * 防止 bytesused 比理论值小：某些驱动可能返回更小的有效数据长度。
+     * 这里按较小者限制行数，避免越界读。
+     */
+    unsigned int rows = cap->height;
+    if (b->bytesused[0] && src.y_stride && b->bytesused[0] / src.y_stride < rows)
+        rows = (unsigned int)(b->bytesused[0] / src.y_stride);
+    if (cap->num_planes > 1 && b->bytesused[1] && src.uv_stride &&
+        b->bytesused[1] / src.uv_stride * 2 < rows)
+        rows = (unsigned int)(b->bytesused[1] / src.uv_stride * 2);
+
+    Nv12Planes dst = {
+        .y         = cap->nv12_frame,
+        .uv        = cap->nv12_frame + (size_t)cap->width * cap->height,
+        .y_stride  = cap->width,
+        .uv_stride = cap->width,
+    };
+    if (nv12_repack(&src, &dst, cap->width, rows, 0, 0) != 0) {
+        LOGE("[%s] repack failed: bpl=%u/%u w=%u", TAG, src.y_stride, src.uv_stride, cap->width);
+        return -1;
+    }
 
     *data   = cap->nv12_frame;
     *length = cap->frame_size;
@@ -314,6 +992,77 @@ int v4l2_capture_dqbuf(V4L2Capture *cap, int *index,
     return 0;
 }
 
+/*
+ * 单平面 NV12 中 UV 平面相对 Y 起点的行数（V4L2 NV12 布局：UV 紧跟 height 行 Y，
+ * sizeimage 里多出的字节只在 UV 之后）。平面地址、RGA 描述与零拷贝编码器的 ver_stride
+ * 都按它计算，保证各方读到的是同一处色度。
+ */
+unsigned int v4l2_capture_uv_rows(const V4L2Capture *cap)
+{
+    return cap->height;
+}
+
+/*
+ * 取出已出队 buffer 的 NV12 平面描述（地址 + S_FMT 时记录的 bytesperline）。
+ *
+ * - NV12M：Y / UV 分别在 plane0 / plane1
+ * - 单平面 NV12：UV 紧跟在 bytesperline * height 字节的 Y 之后
+ * - YUYV：出队时转好的 shadow（紧密排列）
+ *
+ * @param cap     采集上下文
+ * @param index   buffer 索引（需已 DQBUF、尚未 QBUF）
+ * @param planes  输出：平面描述
+ * @return        0 成功；-1 失败
+ */
+int v4l2_capture_get_planes(V4L2Capture *cap, int index, Nv12Planes *planes)
+{
+    if (!cap || !planes || index < 0 || (unsigned int)index >= cap->buf_count)
+        return -1;
+
+    V4L2Buf *b = &cap->bufs[index];
+    if (b->shadow) {
+        planes->y         = b->shadow;
+        planes->uv        = b->shadow + (size_t)cap->width * cap->height;
+        planes->y_stride  = cap->width;
+        planes->uv_stride = cap->width;
+        return 0;
+    }
+    unsigned int y_stride = cap->bytesperline[0] ? cap->bytesperline[0] : cap->width;
+
+    planes->y        = (uint8_t *)b->planes[0];
+    planes->y_stride = y_stride;
+    if (cap->num_planes > 1) {
+        planes->uv        = (uint8_t *)b->planes[1];
+        planes->uv_stride = cap->bytesperline[1] ? cap->bytesperline[1] : y_stride;
+    } else {
+        planes->uv        = (uint8_t *)b->planes[0] + (size_t)y_stride * v4l2_capture_uv_rows(cap);
+        planes->uv_stride = y_stride;
+    }
+    return (planes->y && planes->uv) ? 0 : -1;
+}
+
+/*
+ * 出队一个已填充的采集 buffer 并取出连续 NV12 数据
+ * （等价于 v4l2_capture_dqbuf_index + v4l2_capture_get_frame）。
+ *
+ * @param cap     采集上下文
+ * @param index   输出：本次出队的 buffer 索引（后续需要用 qbuf 归还）
+ * @param data    输出：指向连续 NV12 数据（cap->nv12_frame 或 V4L2 buffer）
+ * @param length  输出：数据长度（固定为 cap->frame_size）
+ * @return        0 成功；1 暂时无数据（EAGAIN）；-1 失败
+ */
+int v4l2_capture_dqbuf(V4L2Capture *cap, int *index,
+                       void **data, size_t *length)
+{
+    if (!cap || !index || !data || !length)
+        return -1;
+
+    int r = v4l2_capture_dqbuf_index(cap, index);
+    if (r != 0) return r;
+
+    return v4l2_capture_get_frame(cap, *index, data, length);
+}
+
 /*
  * 将使用完的 buffer 重新入队（VIDIOC_QBUF），让驱动继续复用该 buffer 存放后续帧。
  *
@@ -324,53 +1073,62 @@ int v4l2_capture_dqbuf(V4L2Capture *cap, int *index,
 int v4l2_capture_qbuf(V4L2Capture *cap, int index)
 {
     if (!cap || cap->fd < 0) return -1;
+    if (cap->src.type != CAPTURE_SRC_DEVICE) return src_qbuf(cap, index);
+    if (index < 0 || (unsigned int)index >= cap->buf_count) return -1;
 
-    struct v4l2_buffer buf;
-    struct v4l2_plane  planes[VIDEO_MAX_PLANES];
-
-    memset(&buf, 0, sizeof(buf));
-    memset(planes, 0, sizeof(planes));
-
-    buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
-    buf.memory = V4L2_MEMORY_MMAP;
-    buf.index  = index;
-    buf.length = 2;
-    buf.m.planes = planes;
-
-    if (xioctl(cap->fd, VIDIOC_QBUF, &buf) < 0) {
-        LOGE("[%s] QBUF[%d] failed: %s", TAG, index, strerror(errno));
-        return -1;
-    }
-
-    return 0;
+    buf_cpu_sync(cap, (unsigned int)index, 0);
+    return queue_buf(cap, (unsigned int)index);
 }
 
 /*
  * 关闭采集并释放资源：
  * - 尝试 STREAMOFF
- * - munmap 所有已映射的 plane
+ * - close 导出的 DMABUF fd，munmap 所有已映射的 plane
  * - close fd
  * - free 合帧缓冲（nv12_frame）
  */
 void v4l2_capture_close(V4L2Capture *cap)
 {
     if (!cap) return;
+    if (cap->src.type != CAPTURE_SRC_DEVICE) {
+        src_close(cap);
+        return;
+    }
 
     if (cap->fd >= 0) {
         /* 即使未 STREAMON，STREAMOFF 失败也不致命，这里忽略返回值 */
-        enum v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE;
+        enum v4l2_buf_type type = (enum v4l2_buf_type)cap->buf_type;
         xioctl(cap->fd, VIDIOC_STREAMOFF, &type);
+
+        /* USERPTR / DMABUF：先让驱动放掉对用户内存的引用，再释放 */
+        if (cap->io != V4L2_IO_MMAP && cap->buf_count) {
+            struct v4l2_requestbuffers req;
+            memset(&req, 0, sizeof(req));
+            req.type   = cap->buf_type;
+            req.memory = io_memory(cap->io);
+            xioctl(cap->fd, VIDIOC_REQBUFS, &req);
+        }
     }
 
     for (unsigned int i = 0; i < cap->buf_count; i++) {
         for (int p = 0; p < V4L2_MAX_PLANES; p++) {
             if (cap->bufs[i].planes[p] && cap->bufs[i].lengths[p]) {
-                munmap(cap->bufs[i].planes[p],
-                       cap->bufs[i].lengths[p]);
+                if (cap->io == V4L2_IO_USERPTR) {
+                    mem_arena_free(cap->bufs[i].planes[p]);
+                } else {
+                    munmap(cap->bufs[i].planes[p], cap->bufs[i].lengths[p]);
+                    mem_arena_uncharge(MEM_STAGE_CAPTURE, cap->bufs[i].lengths[p]);
+                }
                 cap->bufs[i].planes[p]  = NULL;
                 cap->bufs[i].lengths[p] = 0;
             }
+            if (cap->bufs[i].dmabuf_fds[p] >= 0) {
+                close(cap->bufs[i].dmabuf_fds[p]);
+                cap->bufs[i].dmabuf_fds[p] = -1;
+            }
         }
+        mem_arena_free(cap->bufs[i].shadow);
+        cap->bufs[i].shadow = NULL;
     }
 
     if (cap->fd >= 0) {
@@ -379,12 +1137,13 @@ void v4l2_capture_close(V4L2Capture *cap)
     }
 
     if (cap->nv12_frame) {
-        free(cap->nv12_frame);
+        mem_arena_free(cap->nv12_frame);
         cap->nv12_frame = NULL;
     }
 
     cap->buf_count = 0;
     cap->last_index = -1;
+    cap->dmabuf_exported = 0;
 
     LOGI("[%s] capture closed", TAG);
 }
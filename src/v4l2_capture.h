@@ -1,41 +1,131 @@
 // v4l2_capture.h
 #pragma once
 
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdint.h>
 
-#define V4L2_MAX_BUFS    8
-#define V4L2_MAX_PLANES  2      // NV12M 用 2 个 plane：Y + UV
+#include "capture_source.h"
+#include "nv12_repack.h"
+
+#define V4L2_MAX_BUFS      32     // 采集 buffer 数上限（--v4l2-bufs）
+#define V4L2_DEFAULT_BUFS  8
+#define V4L2_MIN_BUFS      2
+#define V4L2_MAX_PLANES    2      // NV12M 用 2 个 plane：Y + UV
+
+/* DMABUF 模式下采集 buffer 的来源 */
+#define V4L2_DMA_HEAP_PATH "/dev/dma_heap/system"
+
+/*
+ * 采集 buffer 的内存类型（VIDIOC_REQBUFS 的 memory）：
+ * - MMAP：驱动分配，mmap 映射（默认）
+ * - USERPTR：用户态按页对齐分配，QBUF 时交给驱动（驱动需支持 scatter-gather 或 IOMMU）
+ * - DMABUF：从 dma-heap 分配，QBUF 时以 fd 交给驱动；fd 同时可供编码器零拷贝导入
+ */
+typedef enum {
+    V4L2_IO_MMAP = 0,
+    V4L2_IO_USERPTR,
+    V4L2_IO_DMABUF,
+} V4L2IoMode;
 
 typedef struct {
     void  *planes[V4L2_MAX_PLANES];   // 每个 plane 的起始地址
     size_t lengths[V4L2_MAX_PLANES];  // 每个 plane 的 mmap 长度
+    int    dmabuf_fds[V4L2_MAX_PLANES]; // VIDIOC_EXPBUF 导出的 fd（未导出为 -1）
+    size_t bytesused[V4L2_MAX_PLANES];  // 最近一次 DQBUF 的有效数据长度
+    uint32_t sequence;                // 最近一次 DQBUF 的 sequence
+    int64_t  timestamp_us;            // 最近一次 DQBUF 的采集时间（CLOCK_MONOTONIC，微秒）
+    uint8_t *shadow;                  // YUYV：DQBUF 时转出的连续 NV12（其余格式为 NULL）
 } V4L2Buf;
 
+/*
+ * 打开参数（可选）。传 NULL 等价于全部取默认值。
+ * - export_dmabuf: 1=零拷贝模式：改用单平面 NV12（Y/UV 在同一块 buffer 内连续），
+ *                  并把每个 buffer 通过 VIDIOC_EXPBUF 导出为 DMABUF，供 MPP 直接导入。
+ * - source:        非设备源（合成 / 文件回放）。此时 dev 被忽略，buffer 为普通内存，
+ *                  不支持零拷贝（export_dmabuf 被忽略，走拷贝路径）。
+ * - fps:           非设备源的名义帧率（默认 30）
+ * - buf_count:     申请的 buffer 数（0 = 设备 V4L2_DEFAULT_BUFS、非设备源 4；上限 V4L2_MAX_BUFS），
+ *                  驱动可以少给，不少于 V4L2_MIN_BUFS 即可
+ * - fourcc:        采集格式：V4L2_PIX_FMT_NV12 / NV12M / YUYV；0 = 自动（VIDIOC_ENUM_FMT 按
+ *                  零拷贝 NV12，否则 NV12M > NV12 > YUYV 的顺序选第一个支持的）。
+ *                  YUYV 在 DQBUF 时转成 NV12（每个 buffer 一块 shadow），不能零拷贝
+ * - io:            buffer 内存类型（见 V4L2IoMode）
+ */
+typedef struct {
+    int               export_dmabuf;
+    CaptureSourceOpts source;
+    unsigned int      fps;
+    unsigned int      buf_count;
+    uint32_t          fourcc;
+    V4L2IoMode        io;
+} V4L2CaptureOpts;
+
 typedef struct {
     int           fd;
+    uint32_t      buf_type;          // V4L2_BUF_TYPE_VIDEO_CAPTURE_MPLANE，或单平面设备的 VIDEO_CAPTURE
+    V4L2IoMode    io;
 
     unsigned int  width;
     unsigned int  height;
 
+    /* S_FMT 之后驱动实际生效的格式 */
+    uint32_t      pixelformat;
+    unsigned int  num_planes;
+    unsigned int  bytesperline[V4L2_MAX_PLANES];
+    unsigned int  sizeimage[V4L2_MAX_PLANES];
+    int           dmabuf_exported;   // 1=bufs[].dmabuf_fds 有效
+
     unsigned int  buf_count;
     int           last_index;
 
     V4L2Buf       bufs[V4L2_MAX_BUFS];
 
-    // 合成后的连续 NV12 帧缓冲
+    // 合成后的连续 NV12 帧缓冲（零拷贝模式下不分配）
     uint8_t      *nv12_frame;
     size_t        frame_size;
 
     // 最近一次 DQBUF 的 sequence（用于 drop 统计）
     uint32_t      last_sequence;
+
+    // 驱动未提供单调时间戳、退化为出队时刻的帧数
+    uint64_t      ts_fallback;
+
+    /* 非设备源：fd 为 pacer.fd，bufs[].planes[0] 为 malloc 的单平面 NV12 */
+    CaptureSourceOpts src;
+    CapturePacer  pacer;
+    atomic_uint   src_free;      // 位图：可填充的 buffer（相当于已 QBUF 给驱动）
+    uint32_t      src_uv_done;   // 位图：UV 已写过的 buffer（合成源 UV 不随帧变化）
+    int           src_fd;        // 回放文件
+    uint64_t      src_seq;       // 下一个节拍的序号
+    int64_t       src_start_us;
 } V4L2Capture;
 
+/* 名字 <-> 枚举（"mmap" / "userptr" / "dmabuf"）。@return 0 成功；-1 未知名字 */
+int         v4l2_io_from_name(const char *name, V4L2IoMode *out);
+const char *v4l2_io_name(V4L2IoMode io);
+/* 采集格式名（"auto" / "nv12" / "nv12m" / "yuyv"，大小写不敏感）-> fourcc（auto 为 0）。@return 0 成功；-1 未知名字 */
+int         v4l2_fourcc_from_name(const char *name, uint32_t *out);
+/* fourcc -> 4 字符字符串（例如 NV12M -> "NM12"），out 至少 5 字节 */
+void        v4l2_fourcc_str(uint32_t fourcc, char out[5]);
+
 int  v4l2_capture_open (V4L2Capture *cap, const char *dev,
                         unsigned int width, unsigned int height);
+int  v4l2_capture_open_opts(V4L2Capture *cap, const char *dev,
+                            unsigned int width, unsigned int height,
+                            const V4L2CaptureOpts *opts);
 int  v4l2_capture_start(V4L2Capture *cap);
 int  v4l2_capture_dqbuf(V4L2Capture *cap, int *index,
                         void **data, size_t *length);
+/* 只出队不合帧：帧元数据记录在 cap->bufs[index]，可交给其他线程处理 */
+int  v4l2_capture_dqbuf_index(V4L2Capture *cap, int *index);
+/* 取出已出队 buffer 的连续 NV12 数据（NV12M 时合帧到 nv12_frame，必要时拷贝） */
+int  v4l2_capture_get_frame(V4L2Capture *cap, int index,
+                            void **data, size_t *length);
+/* 取出已出队 buffer 的 Y/UV 平面地址与驱动行跨度（不拷贝，供 repack 直接读取） */
+int  v4l2_capture_get_planes(V4L2Capture *cap, int index, Nv12Planes *planes);
+/* 单平面 NV12 中 UV 相对 Y 的行偏移（即 MPP / RGA 的 ver_stride） */
+unsigned int v4l2_capture_uv_rows(const V4L2Capture *cap);
 int  v4l2_capture_qbuf (V4L2Capture *cap, int index);
 void v4l2_capture_dump_format(V4L2Capture *cap);
 void v4l2_capture_close(V4L2Capture *cap);
@@ -0,0 +1,1316 @@
+// src/video_pipeline.c
+#include "video_pipeline.h"
+#include "log.h"
+#include "mem_arena.h"
+#include "rt_sched.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TAG "video"
+
+/* MPP 提交/取包的等待时间：决定在途帧排空条件的检查间隔 */
+#define VP_WAIT_MS 50
+/*
+ * 队列/设备空闲时的最长阻塞时间。上游退出时会主动唤醒下游（vp_queue_wake），
+ * stop 经 eventfd 唤醒采集线程，所以这里只是兜底，可以取得较长以减少空闲唤醒。
+ */
+#define VP_IDLE_WAIT_MS 1000
+/* DQBUF 出错时的退避时间 */
+#define VP_ERR_BACKOFF_MS 10
+
+/* ===================== Queue helpers ===================== */
+
+static int vp_queue_init(VpQueue *q, unsigned int capacity)
+{
+    spsc_ring_init(&q->ring, capacity);
+    return sem_init(&q->items, 0, 0);
+}
+
+static void vp_queue_destroy(VpQueue *q)
+{
+    sem_destroy(&q->items);
+}
+
+/* 生产者：入队并唤醒消费者。@return 0 成功；-1 队列满 */
+static int vp_queue_push(VpQueue *q, uint32_t v)
+{
+    if (spsc_ring_push(&q->ring, v) != 0) return -1;
+    sem_post(&q->items);
+    return 0;
+}
+
+/* 生产者退出时调用：唤醒消费者，让它立即检查退出条件（不入队元素）。 */
+static void vp_queue_wake(VpQueue *q)
+{
+    sem_post(&q->items);
+}
+
+/*
+ * 消费者：出队，队列为空时最多阻塞 timeout_ms。
+ * @return 0 成功；-1 超时/被信号打断/被 vp_queue_wake 唤醒（调用者检查退出条件后重试）
+ */
+static int vp_queue_pop(VpQueue *q, uint32_t *v, int timeout_ms, AvStats *stats)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += (long)timeout_ms * 1000000L;
+    while (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+
+    int ret = sem_timedwait(&q->items, &ts);
+    av_stats_inc_wakeup(stats);
+    if (ret != 0) return -1;
+
+    /* 除 vp_queue_wake 的空唤醒外，信号量计数与环内元素一一对应。 */
+    return spsc_ring_pop(&q->ring, v);
+}
+
+/* ===================== Drop policy ===================== */
+
+static const char *const k_drop_names[] = {
+    [VP_DROP_NONE]   = "none",
+    [VP_DROP_NEWEST] = "newest",
+    [VP_DROP_OLDEST] = "oldest",
+    [VP_DROP_LATEST] = "latest",
+};
+
+int vp_drop_policy_from_name(const char *name, VpDropPolicy *out)
+{
+    if (!name || !out) return -1;
+    for (int i = 0; i < (int)(sizeof(k_drop_names) / sizeof(k_drop_names[0])); i++) {
+        if (strcmp(name, k_drop_names[i]) == 0) {
+            *out = (VpDropPolicy)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char *vp_drop_policy_name(VpDropPolicy policy)
+{
+    if ((int)policy < 0 || (int)policy >= (int)(sizeof(k_drop_names) / sizeof(k_drop_names[0]))) return "?";
+    return k_drop_names[policy];
+}
+
+/* ===================== Frame refcount ===================== */
+
+/*
+ * 一个 lane 用完采集 buffer：最后一个用完的 lane 负责 QBUF 归还。
+ * 只有一条 lane 时等价于直接 QBUF。
+ */
+static void vp_frame_put(VideoPipeline *vp, int index)
+{
+    if (atomic_fetch_sub_explicit(&vp->cap_refs[index], 1, memory_order_acq_rel) == 1)
+        v4l2_capture_qbuf(&vp->cap, index);
+}
+
+/* 一条 lane 处理完（写出或丢弃）一帧：停止录制时据此判断排空 */
+static void vp_frame_done(VideoPipeline *vp)
+{
+    atomic_fetch_sub(&vp->frames_pending, 1);
+}
+
+static double ms_since(int64_t t0_us)
+{
+    return (double)(media_clock_now_us() - t0_us) / 1000.0;
+}
+
+/* 当前 sink 的目标（日志用）；没有 sink 时为 none */
+static const char *sink_target(const VpLane *lane, const char *none)
+{
+    EncSink *out = atomic_load(&lane->out);
+    return out ? out->target : none;
+}
+
+/* 丢帧计入全局统计；子码流同时计入自己的统计（退出时汇总） */
+static void lane_add_drop(VpLane *lane, uint64_t n)
+{
+    TRACE_INSTANT("drop lane=%d n=%llu", lane->id, (unsigned long long)n);
+    av_stats_add_drop(lane->vp->stats, n);
+    if (lane->stats != lane->vp->stats) av_stats_add_drop(lane->stats, n);
+}
+
+/* 按丢帧策略主动丢弃，计数方式同 lane_add_drop */
+static void lane_add_shed(VpLane *lane, uint64_t n)
+{
+    TRACE_INSTANT("shed lane=%d n=%llu", lane->id, (unsigned long long)n);
+    av_stats_add_shed(lane->vp->stats, n);
+    if (lane->stats != lane->vp->stats) av_stats_add_shed(lane->stats, n);
+}
+
+/* NEWEST：这条 lane 的编码队列已排满 drop_depth 帧，新到的帧不再放进去 */
+static int lane_shed_newest(VpLane *lane)
+{
+    return lane->vp->drop_policy == VP_DROP_NEWEST &&
+           spsc_ring_depth(&lane->enc_q.ring) >= lane->vp->drop_depth;
+}
+
+/* OLDEST / LATEST：编码线程手上的帧身后已排着足够多更新的帧，丢掉手上这一帧 */
+static int lane_shed_stale(VpLane *lane)
+{
+    VideoPipeline *vp = lane->vp;
+    if (atomic_load(&vp->capture_done)) return 0;
+    unsigned int behind = spsc_ring_depth(&lane->enc_q.ring);
+    switch (vp->drop_policy) {
+    case VP_DROP_OLDEST: return behind >= vp->drop_depth;
+    case VP_DROP_LATEST: return behind >= 1;
+    default:             return 0;
+    }
+}
+
+/*
+ * 编码输入重试（在途槽已满时 submit 返回 1）的退出条件：已请求停止，或取包线程已退出、
+ * 不会再腾出在途槽。成立时放弃手上这一帧，编码线程才能看到退出条件并被 join。
+ */
+static int lane_submit_give_up(VpLane *lane)
+{
+    return *lane->vp->stop || atomic_load(&lane->packet_done);
+}
+
+/* ===================== Capture stage ===================== */
+/* 根据 v4l2 sequence 检测驱动丢帧（序号跳变），计入 drop */
+static void capture_count_seq(VideoPipeline *vp, uint32_t cur, uint32_t *last_seq, int *has_seq)
+{
+    if (!*has_seq) {
+        *has_seq = 1;
+    } else if (cur > *last_seq + 1) {
+        TRACE_INSTANT("v4l2_drop seq=%u missed=%u", cur, cur - *last_seq - 1);
+        av_stats_add_drop(vp->stats, (uint64_t)(cur - *last_seq - 1));
+    }
+    *last_seq = cur;
+}
+
+/* 采集 buffer 的 RGA 描述：导出过 DMABUF 时带 fd，RGA 直接读取 */
+static int capture_image(VideoPipeline *vp, int index, RgaImage *img)
+{
+    memset(img, 0, sizeof(*img));
+    img->fd      = vp->cap.dmabuf_exported ? vp->cap.bufs[index].dmabuf_fds[0] : -1;
+    img->width   = vp->cap.width;
+    img->height  = vp->cap.height;
+    img->hstride = v4l2_capture_uv_rows(&vp->cap);
+    return v4l2_capture_get_planes(&vp->cap, index, &img->planes);
+}
+
+/* --pub-sock：发布线程拷完原始帧，归还它持有的那一个引用 */
+static void pub_raw_release(void *ctx, int index)
+{
+    vp_frame_put((VideoPipeline *)ctx, index);
+}
+
+/* 把这一帧交给发布线程拷贝（引用已计入 cap_refs）；取不到平面地址时直接归还 */
+static void capture_publish(VideoPipeline *vp, int index)
+{
+    RgaImage img;
+    if (capture_image(vp, index, &img) != 0) {
+        vp_frame_put(vp, index);
+        return;
+    }
+    shm_pub_raw_submit(&vp->pub, index, &img, media_clock_pts(vp->cap.bufs[index].timestamp_us));
+}
+
+/* 不进编码器的帧（待机 / 静止跳过）：要发布时只留发布线程一个引用，否则直接归还 */
+static void capture_return(VideoPipeline *vp, int index, int pub_ref)
+{
+    if (!pub_ref) {
+        v4l2_capture_qbuf(&vp->cap, index);
+        return;
+    }
+    atomic_store_explicit(&vp->cap_refs[index], 1, memory_order_release);
+    capture_publish(vp, index);
+}
+
+/*
+ * --motion：分析这一帧的亮度（见 motion.h），活跃 / 空闲切换时打印一行；
+ * rate 模式下在切换时把每一路的码率改为空闲码率（配置码率 × --motion-idle-pct）或改回配置码率。
+ * @return 1 送编码；0 跳过（仅 skip 模式：空闲且不到保留时刻）
+ */
+static int capture_motion_keep(VideoPipeline *vp, int index)
+{
+    Nv12Planes planes;
+    if (v4l2_capture_get_planes(&vp->cap, index, &planes) != 0) return 1;
+    int64_t t0 = media_clock_now_us();
+    int keep = motion_update(&vp->motion, planes.y, planes.y_stride, t0);
+    av_stats_record(vp->stats, AV_HIST_MOTION, (uint64_t)(media_clock_now_us() - t0));
+    av_stats_observe_max(&vp->stats->motion_max, vp->motion.score);
+
+    int idle = !vp->motion.active;
+    if (idle != vp->motion_idle) {
+        vp->motion_idle = idle;
+        LOGI("[%s] motion %s (score=%u%%)", TAG, idle ? "idle" : "active", vp->motion.score);
+        if (vp->motion_mode == MOTION_RATE) {
+            for (int l = 0; l < vp->nlanes; l++) {
+                VpLane *lane = &vp->lanes[l];
+                int bps = idle ? (int)((int64_t)lane->bitrate * vp->cfg->motion_idle_pct / 100) : lane->bitrate;
+                encoder_mpp_set_bitrate(&lane->enc, bps > 0 ? bps : 1);
+            }
+        }
+    }
+    return vp->motion_mode == MOTION_SKIP ? keep : 1;
+}
+
+/*
+ * 采集线程：只做 DQBUF + 丢帧统计，把 buffer index 分发给每条 lane 的编码线程
+ * （按 --drop-policy 在这里丢弃新帧 / 跳过旧帧）。
+ * 除 --motion 的亮度抽样外不访问像素数据，因此节奏只取决于驱动出帧。
+ */
+static void *capture_stage(void *arg)
+{
+    VideoPipeline *vp = (VideoPipeline *)arg;
+    rt_sched_apply(RT_ROLE_CAPTURE, "v-capture");
+
+    uint32_t last_seq = 0;
+    int      has_seq = 0;
+    int64_t  err_since = 0;   // 连续出错的起始时间，0 = 上一次 DQBUF 正常
+
+    int64_t wait_start = media_clock_now_us();
+    while (!*vp->stop && (vp->frames_target == 0 || vp->frames_captured < vp->frames_target)) {
+        int index;
+        TRACE_BEGIN("v4l2_dqbuf");
+        int ret = v4l2_capture_dqbuf_index(&vp->cap, &index);
+        TRACE_END();
+        if (ret > 0) {
+            /* 暂时无帧（EAGAIN）：poll 到驱动出帧或 stop 再试，空闲时不唤醒。 */
+            reactor_wait_fd(vp->reactor, vp->cap.fd, POLLIN, VP_IDLE_WAIT_MS);
+            continue;
+        }
+        if (ret < 0) {
+            /* DQBUF 出错时 fd 可能持续 POLLERR，固定退避避免空转；持续出错则放弃（设备已失效） */
+            int64_t t = media_clock_now_us();
+            if (!err_since) err_since = t;
+            if (t - err_since >= (int64_t)VP_ERR_FATAL_MS * 1000) {
+                LOGE("[%s] %s: DQBUF failing for %d ms, giving up", TAG, vp->cfg->video_device, VP_ERR_FATAL_MS);
+                atomic_store(&vp->failed, 1);
+                break;
+            }
+            reactor_wait(vp->reactor, NULL, 0, VP_ERR_BACKOFF_MS);
+            continue;
+        }
+        err_since = 0;
+        /* dqbuf：从开始等待到拿到一帧的时间，基本等于帧间隔，偏大说明驱动出帧不稳 */
+        int64_t now = media_clock_now_us();
+        av_stats_record(vp->stats, AV_HIST_DQBUF_WAIT, (uint64_t)(now - wait_start));
+        wait_start = now;
+
+        /*
+         * LATEST：驱动里已经就绪的更旧的帧直接归还，只处理最新的一帧（最多取 buf_count 次）。
+         * 归还的帧计入 shed；它们的 sequence 照常参与下面的丢帧检测，不会被算成驱动丢帧。
+         */
+        int shed = 0;
+        if (vp->drop_policy == VP_DROP_LATEST && vp->cap.src.type == CAPTURE_SRC_DEVICE) {
+            int next;
+            while (shed < (int)vp->cap.buf_count && v4l2_capture_dqbuf_index(&vp->cap, &next) == 0) {
+                capture_count_seq(vp, vp->cap.bufs[index].sequence, &last_seq, &has_seq);
+                v4l2_capture_qbuf(&vp->cap, index);
+                index = next;
+                shed++;
+            }
+            if (shed) {
+                av_stats_add_shed(vp->stats, (uint64_t)shed);
+                vp->frames_captured += shed;
+            }
+        }
+
+        /* drop 统计：根据 v4l2 sequence 检测丢帧（序号跳变）。 */
+        capture_count_seq(vp, vp->cap.bufs[index].sequence, &last_seq, &has_seq);
+        if (vp->frames_captured == shed)
+            LOGI("[%s] first frame %.1f ms after start", TAG, (double)(now - vp->start_us) / 1000.0);
+
+        /* 时钟统计：按帧数推算的名义时间 vs 驱动时间戳 */
+        int64_t err, jitter;
+        media_track_update(&vp->vtrack, media_clock_pts(vp->cap.bufs[index].timestamp_us), 1, &err, &jitter);
+        TRACE_INSTANT("capture seq=%u f=%lld", vp->cap.bufs[index].sequence,
+                      (long long)media_clock_pts(vp->cap.bufs[index].timestamp_us));
+        av_stats_set_clock(vp->stats, 0, err, jitter);
+
+        /* --pub-sock 原始帧：到了发布时刻且发布线程空闲时多占一个引用，否则这一帧不发布（从不等待） */
+        int pub_ref = vp->pub_on && shm_pub_raw_want(&vp->pub, now);
+
+        /*
+         * 待机：直接归还 buffer，不进编码器。先计入 pending 再检查 active（均为 seq_cst），
+         * 与 record_stop 的“清 active、等 pending 归零”配成对，停止录制之后不会再有帧漏进 sink。
+         */
+        atomic_fetch_add(&vp->frames_pending, vp->nlanes);
+        if (!atomic_load(&vp->active)) {
+            atomic_fetch_sub(&vp->frames_pending, vp->nlanes);
+            capture_return(vp, index, pub_ref);
+            vp->frames_captured++;
+            vp->frames_standby++;
+            continue;
+        }
+
+        /* --motion skip：静止画面上不到保留时刻的帧直接归还，不进编码器，计入 v_skip（不算丢帧） */
+        if (vp->motion_mode != MOTION_OFF && !capture_motion_keep(vp, index)) {
+            atomic_fetch_sub(&vp->frames_pending, vp->nlanes);
+            capture_return(vp, index, pub_ref);
+            vp->frames_captured++;
+            av_stats_add_skip(vp->stats, 1);
+            continue;
+        }
+
+        /* 先把引用数置满再分发：任何 lane 都可能在分发结束前就用完这一帧 */
+        atomic_store_explicit(&vp->cap_refs[index], vp->nlanes + pub_ref, memory_order_release);
+        if (pub_ref) capture_publish(vp, index);
+        for (int l = 0; l < vp->nlanes; l++) {
+            VpLane *lane = &vp->lanes[l];
+            if (lane_shed_newest(lane)) {
+                lane_add_shed(lane, 1);
+                vp_frame_put(vp, index);
+                vp_frame_done(vp);
+                continue;
+            }
+            if (vp_queue_push(&lane->enc_q, (uint32_t)index) != 0) {
+                /* 队列容量不小于 buffer 数，理论上不会满；防御性地放弃这条 lane 的引用。 */
+                LOGW("[%s] lane %d encode queue full, drop buffer %d", TAG, lane->id, index);
+                lane_add_drop(lane, 1);
+                vp_frame_put(vp, index);
+                vp_frame_done(vp);
+                continue;
+            }
+            uint32_t depth = spsc_ring_depth(&lane->enc_q.ring);
+            TRACE_COUNTER(depth, "q_enc%d", lane->id);
+            av_stats_observe_max(&lane->stats->enc_queue_max, depth);
+            av_stats_record(lane->stats, AV_HIST_Q_ENC, depth);
+        }
+
+        vp->frames_captured++;
+    }
+
+    atomic_store(&vp->capture_done, 1);
+    for (int l = 0; l < vp->nlanes; l++) vp_queue_wake(&vp->lanes[l].enc_q);
+    if (vp->frames_standby)
+        LOGI("[%s] capture stage done, frames=%d (standby discarded %d)", TAG, vp->frames_captured,
+             vp->frames_standby);
+    else LOGI("[%s] capture stage done, frames=%d", TAG, vp->frames_captured);
+    return NULL;
+}
+
+/* ===================== Encode stage ===================== */
+
+/*
+ * 子码流：取一个编码器输入池 buffer，把采集帧缩放进去后投递。
+ * 缩放完成即归还本 lane 对采集 buffer 的引用，不等编码。
+ * @return 0 成功；-1 失败
+ */
+static int lane_scale_submit(VpLane *lane, int index, int64_t pts)
+{
+    VideoPipeline *vp = lane->vp;
+
+    EncInputBuf in;
+    int ret;
+    while ((ret = encoder_mpp_acquire_input(&lane->enc, VP_WAIT_MS, &in)) == 1) {
+        if (lane_submit_give_up(lane)) {
+            ret = -1;
+            break;
+        }
+    }
+    if (ret != 0) {
+        vp_frame_put(vp, index);
+        return -1;
+    }
+
+    RgaImage src;
+    RgaImage dst = {
+        .fd      = in.fd,
+        .planes  = {
+            .y         = in.ptr,
+            .uv        = in.ptr ? in.ptr + (size_t)in.hor_stride * in.ver_stride : NULL,
+            .y_stride  = (unsigned int)in.hor_stride,
+            .uv_stride = (unsigned int)in.hor_stride,
+        },
+        .width   = (unsigned int)in.width,
+        .height  = (unsigned int)in.height,
+        .hstride = (unsigned int)in.ver_stride,
+    };
+    int64_t t0 = media_clock_now_us();
+    TRACE_BEGIN("scale f=%lld", (long long)pts);
+    ret = capture_image(vp, index, &src);
+    if (ret == 0) ret = rga_scale_nv12(&lane->rga, &src, &dst);
+    TRACE_END();
+    av_stats_record(vp->stats, AV_HIST_SCALE, (uint64_t)(media_clock_now_us() - t0));
+    vp_frame_put(vp, index);
+
+    if (ret != 0) {
+        encoder_mpp_cancel_input(&lane->enc, &in);
+        return -1;
+    }
+    /* RGA 只写 width × height；与 repack 路径一样，复用的池 buffer 的 stride / ver_stride 填充区每帧清零 */
+    if (in.ptr)
+        nv12_clear_padding(&dst.planes, dst.width, dst.height, dst.hstride);
+    return encoder_mpp_submit_input(&lane->enc, &in, pts);
+}
+
+/*
+ * 编码提交线程：取 V4L2 index -> 异步提交给 MPP。
+ *
+ * - 拷贝路径：合帧后拷贝进编码器输入池，提交返回即可放掉采集 buffer
+ * - 缩放路径（子码流）：RGA 缩放进编码器输入池，缩放完成即放掉采集 buffer
+ * - 零拷贝：直接提交导入的 DMABUF，等取包线程拿到该帧的 packet 后再放掉
+ * 在途帧数达到上限时在 submit 内等待，相当于把背压传回采集侧。
+ */
+static void *encode_stage(void *arg)
+{
+    VpLane        *lane = (VpLane *)arg;
+    VideoPipeline *vp   = lane->vp;
+    char name[16];
+    snprintf(name, sizeof(name), "v-enc%d", lane->id);
+    rt_sched_apply(RT_ROLE_ENCODE, name);
+
+    for (;;) {
+        uint32_t index;
+        if (vp_queue_pop(&lane->enc_q, &index, VP_IDLE_WAIT_MS, lane->stats) != 0) {
+            if (atomic_load(&vp->capture_done) && spsc_ring_depth(&lane->enc_q.ring) == 0)
+                break;
+            continue;
+        }
+        if (lane_shed_stale(lane)) {
+            vp_frame_put(vp, (int)index);
+            lane_add_shed(lane, 1);
+            vp_frame_done(vp);
+            continue;
+        }
+
+        /* 多通道共用 VPU：先取在途配额；stop 之后仍取不到则放弃这一帧，不卡住退出 */
+        int got;
+        while ((got = vpu_client_acquire(&lane->vpu, VP_WAIT_MS)) == 1 && !*vp->stop) {
+        }
+        if (got != 0) {
+            vp_frame_put(vp, (int)index);
+            lane_add_drop(lane, 1);
+            vp_frame_done(vp);
+            continue;
+        }
+
+        /* MPP pts 即采集 PTS（微秒），随 packet 带回并传给 sink */
+        int64_t pts = media_clock_pts(vp->cap.bufs[index].timestamp_us);
+        int ret;
+        if (lane->zero_copy) {
+            while ((ret = encoder_mpp_submit_ext(&lane->enc, (int)index, pts, VP_WAIT_MS)) == 1) {
+                if (lane_submit_give_up(lane)) {
+                    ret = -1;
+                    break;
+                }
+            }
+            if (ret != 0) vp_frame_put(vp, (int)index);
+        } else if (lane->scaled) {
+            ret = lane_scale_submit(lane, (int)index, pts);
+        } else {
+            /* 按驱动 bytesperline 直接 repack 进编码器输入 buffer，不经过合帧缓冲 */
+            Nv12Planes planes;
+            ret = v4l2_capture_get_planes(&vp->cap, (int)index, &planes);
+            if (ret == 0) {
+                while ((ret = encoder_mpp_submit_nv12(&lane->enc, &planes, vp->cap.width, vp->cap.height,
+                                                      pts, VP_WAIT_MS)) == 1) {
+                    if (lane_submit_give_up(lane)) {
+                        ret = -1;
+                        break;
+                    }
+                }
+            }
+            vp_frame_put(vp, (int)index);
+        }
+
+        if (ret != 0) {
+            vpu_client_release(&lane->vpu, 1);
+            lane_add_drop(lane, 1);
+            vp_frame_done(vp);
+            continue;
+        }
+        lane->frames_submitted++;
+        if (!lane->zero_copy && !lane->scaled)
+            av_stats_record(lane->stats, AV_HIST_COPY, (uint64_t)lane->enc.last_copy_us);
+        av_stats_record(lane->stats, AV_HIST_ENC_PUT, (uint64_t)lane->enc.last_put_us);
+        av_stats_observe_max(&lane->stats->enc_inflight_max, (uint64_t)encoder_mpp_inflight(&lane->enc));
+    }
+
+    atomic_store(&lane->encode_done, 1);
+    LOGI("[%s] lane %d encode stage done, submitted=%lld", TAG, lane->id, (long long)lane->frames_submitted);
+    return NULL;
+}
+
+/* ===================== Packet stage ===================== */
+/*
+ * 把 packet 拷贝进 slot。压缩数据远小于原始帧，拷贝代价可忽略；
+ * 这样 MppPacket 可以立刻归还，不会因写出慢而占住 MPP 内部输出缓冲。
+ *
+ * 极少数超过 slot 大小的 I 帧借用 lane 唯一的 jumbo 缓冲（启动时预分配），写出线程写完后归还；
+ * 上一个超大帧还没写完时在这里等，与等空闲 slot 一样把背压传回采集侧。运行中不分配内存。
+ */
+static int fill_slot(VpLane *lane, VpPacketSlot *slot, const EncPacket *pkt)
+{
+    uint8_t *dst = slot->own;
+    if (pkt->len > slot->cap) {
+        if (!lane->jumbo || pkt->len > lane->jumbo_cap) {
+            LOGE("[%s] lane %d packet %zu bytes exceeds the largest slot (%zu)", TAG, lane->id, pkt->len,
+                 lane->jumbo ? lane->jumbo_cap : slot->cap);
+            return -1;
+        }
+        uint32_t token;
+        while (vp_queue_pop(&lane->jumbo_q, &token, VP_IDLE_WAIT_MS, lane->stats) != 0) {
+        }
+        dst = lane->jumbo;
+    }
+    memcpy(dst, pkt->data, pkt->len);
+    slot->data = dst;
+    slot->len  = pkt->len;
+    return 0;
+}
+
+/*
+ * 取包线程：从 MPP 取 packet -> （零拷贝时放掉对应的采集 buffer）
+ * -> 放入 slot 交给写出线程。
+ *
+ * 先拿到空闲 slot 再放入：写出线程严重滞后时在这里等待，
+ * 在途帧无法回收，背压逐级传回采集侧，由驱动按 sequence 丢帧（码流保持可解码），
+ * 而不是丢弃已编码的 P 帧导致花屏。
+ *
+ * --enc-slices：每一片单独占一个 slot、取到即交给写出线程；
+ * 按帧的记账（VPU 配额、采集 buffer 引用、编码耗时）只在最后一片上做。
+ */
+static void *packet_stage(void *arg)
+{
+    VpLane        *lane = (VpLane *)arg;
+    VideoPipeline *vp   = lane->vp;
+    char name[16];
+    snprintf(name, sizeof(name), "v-pkt%d", lane->id);
+    rt_sched_apply(RT_ROLE_ENCODE, name);
+
+    for (;;) {
+        EncPacket pkt;
+        int64_t t0 = media_clock_now_us();
+        int ret = encoder_mpp_poll_packet(&lane->enc, &pkt);
+        av_stats_inc_wakeup(lane->stats);
+        if (ret != 0) {
+            if (ret < 0) {
+                LOGE("[%s] lane %d poll packet failed", TAG, lane->id);
+                break;
+            }
+            if (atomic_load(&lane->encode_done) && encoder_mpp_inflight(&lane->enc) == 0)
+                break;
+            continue;
+        }
+        av_stats_record(lane->stats, AV_HIST_ENC_GET, (uint64_t)(media_clock_now_us() - t0));
+        TRACE_INSTANT("packet f=%lld len=%zu part=%d%s", (long long)pkt.pts, pkt.len, (int)pkt.part,
+                      pkt.keyframe ? " key" : "");
+        int au_end = TS_AU_ENDS(pkt.part);
+        if (au_end) {
+            vpu_client_release(&lane->vpu, 1);
+            if (pkt.ext_index >= 0)
+                vp_frame_put(vp, pkt.ext_index);
+            av_stats_add_enc_latency(lane->stats, (uint64_t)(pkt.latency_us > 0 ? pkt.latency_us : 0));
+        }
+
+        if (pkt.len == 0) {
+            encoder_mpp_packet_release(&pkt);
+            if (au_end) vp_frame_done(vp);
+            continue;
+        }
+
+        uint32_t s;
+        while (vp_queue_pop(&lane->free_q, &s, VP_IDLE_WAIT_MS, lane->stats) != 0) {
+        }
+
+        VpPacketSlot *slot = &lane->slots[s];
+        ret = fill_slot(lane, slot, &pkt);
+        slot->pts_us   = pkt.pts;
+        slot->keyframe = pkt.keyframe;
+        slot->part     = pkt.part;
+        slot->failed   = ret != 0;
+        encoder_mpp_packet_release(&pkt);
+        if (ret != 0) {
+            /* slot 未使用：经写出线程归还（len==0 不会写出），drop 由写出线程按 AU 结算 */
+            slot->len = 0;
+        } else if (lane->id == 0 && vp->pub_on) {
+            /* --pub-sock：主码流的包同时写进共享环（读者落后时被覆盖，不会阻塞这里）；分片时每片一条记录 */
+            shm_pub_packet(&vp->pub, slot->data, slot->len, slot->pts_us, slot->keyframe);
+        }
+
+        vp_queue_push(&lane->sink_q, s);
+        uint32_t depth = spsc_ring_depth(&lane->sink_q.ring);
+        TRACE_COUNTER(depth, "q_sink%d", lane->id);
+        av_stats_observe_max(&lane->stats->sink_queue_max, depth);
+        av_stats_record(lane->stats, AV_HIST_Q_SINK, depth);
+    }
+
+    atomic_store(&lane->packet_done, 1);
+    vp_queue_wake(&lane->sink_q);
+    LOGI("[%s] lane %d packet stage done", TAG, lane->id);
+    return NULL;
+}
+
+/* ===================== Sink stage ===================== */
+/*
+ * 写出线程：把 packet slot 写入 sink，再把 slot 还给取包线程。
+ */
+static void *sink_stage(void *arg)
+{
+    VpLane        *lane = (VpLane *)arg;
+    VideoPipeline *vp   = lane->vp;
+    char name[16];
+    snprintf(name, sizeof(name), "v-sink%d", lane->id);
+    rt_sched_apply(RT_ROLE_SINK, name);
+
+    for (;;) {
+        uint32_t s;
+        if (vp_queue_pop(&lane->sink_q, &s, VP_IDLE_WAIT_MS, lane->stats) != 0) {
+            if (atomic_load(&lane->packet_done) && spsc_ring_depth(&lane->sink_q.ring) == 0)
+                break;
+            continue;
+        }
+
+        VpPacketSlot *slot = &lane->slots[s];
+        /* 先置 busy 再取 out（均为 seq_cst）：撤下 sink 的一方要么看到 busy，要么这里取到 NULL */
+        atomic_store(&lane->out_busy, 1);
+        EncSink *out = atomic_load(&lane->out);
+        int au_start = TS_AU_STARTS(slot->part);
+        int au_end   = TS_AU_ENDS(slot->part);
+        int ret = 0;
+        if (au_start) lane->au_failed = 0;
+        if (slot->failed) lane->au_failed = 1;
+        if (!out) {
+            /* 待机时不会分发帧；防御性地丢弃，不计入 drop */
+            slot->len = 0;
+        } else if (lane->au_failed) {
+            /* 这个 AU 已有一片丢失或写失败：其余片不写，免得残缺的帧进入输出 */
+        } else if (slot->len) {
+            /*
+             * 异步 sink 背压：等写线程腾出空间后重试。码流不能丢 P 帧，
+             * 这里等待只占住 packet slot，背压由 slot 队列逐级传回采集侧。
+             */
+            EncSinkMeta meta = { .stream = ENC_STREAM_VIDEO, .pts_us = slot->pts_us, .keyframe = slot->keyframe,
+                                 .part = slot->part };
+            int64_t t0 = media_clock_now_us();
+            TRACE_BEGIN("enc_sink_write lane=%d f=%lld len=%zu", lane->id, (long long)slot->pts_us, slot->len);
+            while ((ret = enc_sink_write_ex(out, slot->data, slot->len, &meta)) == 1) {
+                /* sink 已被撤下（停止录制排空超时）：放弃这次写入，不再碰它 */
+                if (atomic_load(&lane->out) != out ||
+                    enc_sink_wait_writable(out, slot->len, VP_IDLE_WAIT_MS) < 0) {
+                    ret = -1;
+                    break;
+                }
+            }
+            TRACE_END();
+            int64_t t1 = media_clock_now_us();
+            av_stats_record(lane->stats, AV_HIST_SINK_WRITE, (uint64_t)(t1 - t0));
+            /* 采集 -> 这一帧的第一个字节交给 sink（分片时为开头一片写完） */
+            if (ret == 0 && au_start) {
+                int64_t lat = media_clock_pts(t1) - slot->pts_us;
+                av_stats_record(lane->stats, AV_HIST_FIRST_BYTE, (uint64_t)(lat > 0 ? lat : 0));
+            }
+        }
+        atomic_store(&lane->out_busy, 0);
+
+        if (slot->len == 0 || lane->au_failed) {
+            /* 取包线程放弃的 slot / 残缺 AU 的其余片，直接归还 */
+        } else if (ret != 0) {
+            lane->au_failed = 1;
+        } else {
+            av_stats_add_enc_bytes(lane->stats, (uint64_t)slot->len);
+            lane->bytes_written += slot->len;
+            /* 冷启动 / 开始录制到第一个关键帧落盘的时间 */
+            if (lane->id == 0 && slot->keyframe && atomic_exchange(&vp->first_key, 0))
+                LOGI("[%s] first IDR written %.1f ms after %s", TAG, ms_since(vp->arm_us),
+                     vp->cfg->standby ? "record start" : "start");
+        }
+        /* 按帧计数：分片 AU 在最后一片处结算，任一片写失败整帧计一次 drop */
+        if (au_end) {
+            if (lane->au_failed) {
+                lane_add_drop(lane, 1);
+            } else if (slot->len) {
+                av_stats_inc_video_frame(lane->stats);
+                lane->frames_written++;
+            }
+            lane->au_failed = 0;
+        }
+
+        slot->len    = 0;
+        slot->failed = 0;
+        if (slot->data != slot->own) {
+            slot->data = slot->own;
+            vp_queue_push(&lane->jumbo_q, 0);
+        }
+        vp_queue_push(&lane->free_q, s);
+        if (au_end) vp_frame_done(vp);
+    }
+
+    LOGI("[%s] lane %d sink stage done, packets=%d", TAG, lane->id, lane->frames_written);
+    return NULL;
+}
+
+/* ===================== Lifecycle ===================== */
+
+/* 释放一条 lane 的资源（线程必须已退出或未启动）。 */
+static void lane_release(VpLane *lane)
+{
+    if (atomic_load(&lane->out) == &lane->sink) enc_sink_close(&lane->sink);
+    atomic_store(&lane->out, NULL);
+    encoder_mpp_deinit(&lane->enc);
+
+    for (int i = 0; i < VP_PKT_SLOTS; i++) {
+        lane->slots[i].data = NULL;
+        lane->slots[i].own  = NULL;
+        lane->slots[i].cap  = 0;
+    }
+    mem_arena_free(lane->slot_mem);
+    mem_arena_free(lane->jumbo);
+    lane->slot_mem  = NULL;
+    lane->jumbo     = NULL;
+    lane->jumbo_cap = 0;
+
+    vp_queue_destroy(&lane->enc_q);
+    vp_queue_destroy(&lane->sink_q);
+    vp_queue_destroy(&lane->free_q);
+    vp_queue_destroy(&lane->jumbo_q);
+    vpu_client_detach(&lane->vpu);   // 丢弃的在途帧不会再有 packet，配额在这里归还
+
+    if (lane->stats != lane->vp->stats) free(lane->stats);
+    lane->stats = NULL;
+}
+
+/* 释放 start 阶段申请的资源（线程必须已退出或未启动）。 */
+static void pipeline_release(VideoPipeline *vp)
+{
+    /* 发布线程可能还持有一帧采集 buffer 的引用：在关采集之前停掉，由它归还 */
+    if (vp->pub_on) shm_pub_close(&vp->pub);
+    vp->pub_on = 0;
+    /* 先关编码器：零拷贝时它持有导入的 V4L2 DMABUF */
+    for (int l = 0; l < vp->nlanes; l++) lane_release(&vp->lanes[l]);
+    vp->nlanes = 0;
+    v4l2_capture_close(&vp->cap);
+    motion_close(&vp->motion);
+}
+
+/*
+ * 等待一条 lane 已启动的线程退出。上游退出条件必须已经成立（capture_done 已置位）：
+ * 编码线程排空 enc_q 后退出，随后依次放行取包与写出线程。
+ */
+static void lane_join_threads(VpLane *lane)
+{
+    if (lane->threads >= 3) pthread_join(lane->th_enc, NULL);
+    atomic_store(&lane->encode_done, 1);
+    if (lane->threads >= 2) pthread_join(lane->th_pkt, NULL);
+    atomic_store(&lane->packet_done, 1);
+    vp_queue_wake(&lane->sink_q);
+    if (lane->threads >= 1) pthread_join(lane->th_sink, NULL);
+    lane->threads = 0;
+}
+
+/* 启动失败：放行并等待已启动的 lane 线程，再释放全部资源。 */
+static void pipeline_abort(VideoPipeline *vp)
+{
+    atomic_store(&vp->capture_done, 1);
+    for (int l = 0; l < vp->nlanes; l++) {
+        vp_queue_wake(&vp->lanes[l].enc_q);
+        lane_join_threads(&vp->lanes[l]);
+    }
+    pipeline_release(vp);
+}
+
+/* 逆序启动一条 lane 的线程：先让下游就绪。 */
+static int lane_start_threads(VpLane *lane)
+{
+    if (pthread_create(&lane->th_sink, NULL, sink_stage, lane) != 0) {
+        LOGE("[%s] lane %d pthread_create sink failed", TAG, lane->id);
+        return -1;
+    }
+    lane->threads = 1;
+    if (pthread_create(&lane->th_pkt, NULL, packet_stage, lane) != 0) {
+        LOGE("[%s] lane %d pthread_create packet failed", TAG, lane->id);
+        return -1;
+    }
+    lane->threads = 2;
+    if (pthread_create(&lane->th_enc, NULL, encode_stage, lane) != 0) {
+        LOGE("[%s] lane %d pthread_create encode failed", TAG, lane->id);
+        return -1;
+    }
+    lane->threads = 3;
+    return 0;
+}
+
+/*
+ * 按类型自建一条 lane 的 sink（文件 / 异步文件 / 仅视频的 TS 或推流）。
+ * @return 0 成功；-1 打开失败
+ */
+static int lane_open_sink(VideoPipeline *vp, VpLane *lane, const char *sink_name, const char *target)
+{
+    const AppConfig *cfg = vp->cfg;
+    EncSinkType sink_type = ENC_SINK_FILE;
+    enc_sink_type_from_name(sink_name, &sink_type);
+    enc_sink_init(&lane->sink, sink_type, target);
+    SinkAsyncOpts async_opts;
+    app_config_sink_async_opts(cfg, lane->stats, &async_opts);
+    enc_sink_set_async_opts(&lane->sink, &async_opts);
+    if (enc_sink_type_is_muxed(sink_type)) {
+        TsMuxStreams st = { .video = 1, .hevc = lane->codec == MPP_VIDEO_CodingHEVC };
+        enc_sink_set_ts_streams(&lane->sink, &st);
+        SinkPipeOpts pipe_opts;
+        app_config_sink_pipe_opts(cfg, lane->stats, &pipe_opts);
+        enc_sink_set_pipe_opts(&lane->sink, &pipe_opts);
+    }
+    /* 分段：主码流是 leader，切分点供单独写的 PCM 跟随 */
+    SinkSegmentOpts seg_opts;
+    app_config_segment_opts(cfg, lane->bitrate, 0, &seg_opts);
+    if (lane->id == 0) seg_opts.clock = &vp->seg_clock;
+    enc_sink_set_segment_opts(&lane->sink, &seg_opts);
+    if (enc_sink_open(&lane->sink) != 0) {
+        LOGE("[%s] enc_sink_open failed: %s", TAG, target);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * 打开一条 lane：编码器、（零拷贝时）导入采集 DMABUF、异步模式、sink、packet slot。
+ * 调用前已填好 width/height/bitrate/codec/zero_copy/scaled。
+ *
+ * @param sink_name    sink 类型名（"file" / "async" / "ts" / "pipe"）
+ * @param target       文件路径或推流地址
+ * @param shared_sink  外部已打开的 sink（可为 NULL，此时按 sink_name 自建）
+ * @param standby      1 = 不打开 sink（待机，录制时再接上）
+ * @return             0 成功；-1 失败（资源由 pipeline_release 统一释放）
+ */
+static int lane_open(VideoPipeline *vp, VpLane *lane, const char *sink_name, const char *target,
+                     EncSink *shared_sink, int standby)
+{
+    const AppConfig *cfg = vp->cfg;
+    int64_t t0 = media_clock_now_us();
+
+    /*
+     * 零拷贝时 MPP 直接读取 V4L2 buffer，所以 stride 必须与驱动布局一致
+     * （ver_stride 取 v4l2_capture_uv_rows）；其余情况编码器输入池按 16 对齐自行分配。
+     */
+    EncoderMppOpts eo;
+    encoder_mpp_default_opts(&eo);
+    eo.type       = lane->codec;
+    eo.width      = lane->width;
+    eo.height     = lane->height;
+    eo.hor_stride = lane->zero_copy ? (int)vp->cap.bytesperline[0] : 0;
+    eo.ver_stride = lane->zero_copy ? (int)v4l2_capture_uv_rows(&vp->cap) : 0;
+    eo.fps        = cfg->fps;
+    eo.bitrate    = lane->bitrate;
+    eo.gop        = cfg->gop;
+    eo.qp         = cfg->qp;
+    eo.slices     = cfg->enc_slices;
+    encoder_mpp_rc_from_name(cfg->rc_mode, &eo.rc_mode);
+    if (encoder_mpp_init_opts(&lane->enc, &eo) != 0) {
+        LOGE("[%s] lane %d encoder_mpp_init failed", TAG, lane->id);
+        return -1;
+    }
+
+    /* 零拷贝：启动阶段一次性导入全部 V4L2 DMABUF；任一失败则整体回退到拷贝路径。 */
+    if (lane->zero_copy) {
+        for (unsigned int i = 0; i < vp->cap.buf_count; i++) {
+            if (encoder_mpp_import_dmabuf(&lane->enc, (int)i, vp->cap.bufs[i].dmabuf_fds[0],
+                                          vp->cap.bufs[i].lengths[0]) != 0) {
+                LOGW("[%s] dmabuf import failed, fallback to copy path", TAG);
+                lane->zero_copy = 0;
+                break;
+            }
+        }
+    }
+
+    /*
+     * 异步编码：最多 enc_depth 帧同时在途。
+     * 零拷贝时在途帧占用 V4L2 buffer，需给采集侧至少留 2 个 buffer。
+     */
+    int depth = cfg->enc_depth;
+    if (lane->zero_copy && depth > (int)vp->cap.buf_count - 2) depth = (int)vp->cap.buf_count - 2;
+    if (encoder_mpp_setup_async(&lane->enc, depth, !lane->zero_copy, VP_WAIT_MS) != 0) {
+        LOGE("[%s] lane %d encoder_mpp_setup_async failed", TAG, lane->id);
+        return -1;
+    }
+
+    if (lane->scaled) rga_scaler_init(&lane->rga);
+    int64_t t1 = media_clock_now_us();
+    vp->startup.encoder_init_us += t1 - t0;
+
+    /* 输出端：共享 sink（TS 封装），或按类型自建（文件 / 异步文件 / 仅视频的 TS 或推流）。 */
+    if (standby) {
+        atomic_store(&lane->out, NULL);
+    } else if (shared_sink) {
+        atomic_store(&lane->out, shared_sink);
+    } else {
+        if (lane_open_sink(vp, lane, sink_name, target) != 0) return -1;
+        atomic_store(&lane->out, &lane->sink);
+    }
+    int64_t t2 = media_clock_now_us();
+    vp->startup.sink_open_us += t2 - t1;
+
+    /*
+     * packet slot 预分配（arena 一整块）：按平均帧大小的 8 倍估算（覆盖 I 帧），
+     * 下限 256KB，上限为原始帧大小；slot 小于原始帧时另备一块原始帧大小的 jumbo 给超大 I 帧。
+     */
+    size_t slot_bytes = (cfg->fps > 0) ? (size_t)lane->bitrate / 8 / (size_t)cfg->fps * 8 : 0;
+    if (slot_bytes < 256 * 1024) slot_bytes = 256 * 1024;
+    if (lane->enc.frame_size && slot_bytes > lane->enc.frame_size) slot_bytes = lane->enc.frame_size;
+
+    lane->slot_mem = (uint8_t *)mem_arena_alloc(MEM_STAGE_ENCODE, (size_t)VP_PKT_SLOTS * slot_bytes, 0);
+    if (lane->enc.frame_size > slot_bytes) {
+        lane->jumbo_cap = lane->enc.frame_size;
+        lane->jumbo     = (uint8_t *)mem_arena_alloc(MEM_STAGE_ENCODE, lane->jumbo_cap, 0);
+    }
+    if (!lane->slot_mem || (lane->jumbo_cap && !lane->jumbo)) {
+        LOGE("[%s] alloc packet slots failed", TAG);
+        return -1;
+    }
+    for (int i = 0; i < VP_PKT_SLOTS; i++) {
+        lane->slots[i].own  = lane->slot_mem + (size_t)i * slot_bytes;
+        lane->slots[i].data = lane->slots[i].own;
+        lane->slots[i].cap  = slot_bytes;
+        vp_queue_push(&lane->free_q, (uint32_t)i);
+    }
+    if (lane->jumbo) vp_queue_push(&lane->jumbo_q, 0);
+    vp->startup.pools_us += media_clock_now_us() - t2;
+
+    LOGI("[%s] lane %d: %s %dx%d bitrate=%d -> %s%s%s", TAG, lane->id, encoder_mpp_coding_name(lane->codec),
+         lane->width, lane->height, lane->bitrate, sink_target(lane, "(standby)"),
+         lane->zero_copy ? " zero-copy" : "",
+         lane->scaled ? (rga_scale_hw_available() ? " scaled(rga)" : " scaled(cpu)") : "");
+    return 0;
+}
+
+/*
+ * 初始化第 id 条 lane 的队列与统计。
+ * @return 0 成功；-1 失败
+ */
+static int lane_init(VideoPipeline *vp, int id)
+{
+    VpLane *lane = &vp->lanes[id];
+    lane->vp = vp;
+    lane->id = id;
+    if (id == 0) {
+        lane->stats = vp->stats;
+    } else {
+        /* 子码流的计数与分布单独统计，不混进 [STAT] / [LAT] 的主码流数据 */
+        lane->stats = (AvStats *)calloc(1, sizeof(AvStats));
+        if (!lane->stats) {
+            LOGE("[%s] alloc lane %d stats failed", TAG, id);
+            return -1;
+        }
+        av_stats_init(lane->stats);
+    }
+
+    vp_queue_init(&lane->enc_q, V4L2_MAX_BUFS);
+    vp_queue_init(&lane->sink_q, VP_PKT_SLOTS);
+    vp_queue_init(&lane->free_q, VP_PKT_SLOTS);
+    vp_queue_init(&lane->jumbo_q, 1);
+    vpu_client_attach(&lane->vpu, vp->vpu);
+    vp->nlanes = id + 1;
+    return 0;
+}
+
+/*
+ * 启动视频流水线：
+ * - 打开 V4L2 采集（--v4l2-bufs / --v4l2-fmt / --v4l2-io；自动格式时默认 NV12M 多平面，
+ *   编码线程内 repack 为连续 NV12；--zero-copy、或带 RGA 的 simulcast 时为单平面 NV12 并导出 DMABUF）
+ * - lane 0 为主码流，初始化 MPP H.264 编码器（零拷贝时一次性导入所有 V4L2 buffer）；
+ *   每个 --simulcast 再开一条 lane（自己的编码器与 sink），均为异步模式
+ * - 打开 sink，预分配 packet slot，STREAMON 后启动各级线程
+ *
+ * @param vp     流水线实例（输出）
+ * @param cfg    配置（生命周期需覆盖整个流水线）
+ * @param stats  统计对象
+ * @param stop   全局停止标志
+ * @param reactor  stop eventfd（采集线程与 V4L2 fd 一起 poll）
+ * @param shared_sink  外部已打开的 sink（可为 NULL），仅主码流使用
+ * @param vpu    多通道共用的 VPU 配额（可为 NULL）
+ * @return       0 成功；-1 失败（失败时已释放全部资源）
+ */
+int video_pipeline_start(VideoPipeline *vp, const AppConfig *cfg,
+                         AvStats *stats, volatile sig_atomic_t *stop, Reactor *reactor,
+                         EncSink *shared_sink, VpuSched *vpu)
+{
+    if (!vp || !cfg || !stats || !stop || !reactor) return -1;
+
+    memset(vp, 0, sizeof(*vp));
+    vp->cfg      = cfg;
+    vp->stats    = stats;
+    vp->stop     = stop;
+    vp->reactor  = reactor;
+    vp->vpu      = vpu;
+    vp->start_us = media_clock_now_us();
+    vp->arm_us   = vp->start_us;
+    atomic_store(&vp->active, !cfg->standby);
+    atomic_store(&vp->first_key, !cfg->standby);
+
+    int nsim = cfg->simulcast_count;
+    if (nsim > VP_MAX_LANES - 1) nsim = VP_MAX_LANES - 1;
+
+    /* RGA 可以直接读 DMABUF，simulcast 时也导出，省掉 CPU 访问采集 buffer */
+    V4L2CaptureOpts cap_opts = {
+        .export_dmabuf = cfg->zero_copy || (nsim > 0 && rga_scale_hw_available()),
+        .fps           = (unsigned int)cfg->fps,
+        .buf_count     = cfg->v4l2_bufs > 0 ? (unsigned int)cfg->v4l2_bufs : 0,
+        .fourcc        = cfg->v4l2_fourcc,
+    };
+    app_config_video_source(cfg, &cap_opts.source);
+    v4l2_io_from_name(cfg->v4l2_io, &cap_opts.io);
+    vp_drop_policy_from_name(cfg->drop_policy, &vp->drop_policy);
+    vp->drop_depth = cfg->drop_depth > 0 ? (unsigned int)cfg->drop_depth : VP_DROP_DEPTH_DEFAULT;
+    if (v4l2_capture_open_opts(&vp->cap, cfg->video_device, (unsigned int)cfg->width, (unsigned int)cfg->height, &cap_opts) != 0) {
+        LOGE("[%s] v4l2_capture_open failed: %s", TAG, cfg->video_device);
+        return -1;
+    }
+    vp->startup.capture_open_us = media_clock_now_us() - vp->start_us;
+
+    motion_mode_from_name(cfg->motion, &vp->motion_mode);
+    if (vp->motion_mode != MOTION_OFF) {
+        MotionOpts mo;
+        app_config_motion_opts(cfg, &mo);
+        if (motion_init(&vp->motion, &mo, vp->cap.width, vp->cap.height) != 0) {
+            pipeline_release(vp);
+            return -1;
+        }
+    }
+
+    /* lane 0：主码流。驱动给出的尺寸比配置小时按实际尺寸编码；比配置大时 repack 居中裁剪 */
+    if (lane_init(vp, 0) != 0) {
+        pipeline_release(vp);
+        return -1;
+    }
+    VpLane *main_lane = &vp->lanes[0];
+    main_lane->width     = cfg->width  > (int)vp->cap.width  ? (int)vp->cap.width  : cfg->width;
+    main_lane->height    = cfg->height > (int)vp->cap.height ? (int)vp->cap.height : cfg->height;
+    main_lane->bitrate   = cfg->bitrate;
+    encoder_mpp_coding_from_name(cfg->codec, &main_lane->codec);
+    main_lane->zero_copy = cfg->zero_copy && vp->cap.dmabuf_exported;
+    if (lane_open(vp, main_lane, cfg->sink_type, cfg->output_path_h264, shared_sink, cfg->standby) != 0) {
+        pipeline_release(vp);
+        return -1;
+    }
+
+    /* 子码流：尺寸与采集不同则缩放，相同则与主码流一样走拷贝路径 */
+    for (int i = 0; i < nsim; i++) {
+        const AppSimulcast *sc = &cfg->simulcast[i];
+        if (lane_init(vp, i + 1) != 0) {
+            pipeline_release(vp);
+            return -1;
+        }
+        VpLane *lane = &vp->lanes[i + 1];
+        lane->width   = sc->width;
+        lane->height  = sc->height;
+        lane->bitrate = sc->bitrate;
+        encoder_mpp_coding_from_name(sc->codec, &lane->codec);
+        lane->scaled  = (unsigned int)sc->width != vp->cap.width || (unsigned int)sc->height != vp->cap.height;
+        if (lane_open(vp, lane, sc->sink_type, sc->output, NULL, 0) != 0) {
+            pipeline_release(vp);
+            return -1;
+        }
+    }
+
+    /* --pub-sock：STREAMON 之前就绪，读者可以先连上，等第一个关键帧 */
+    if (cfg->pub_sock) {
+        ShmPubOpts po;
+        app_config_pub_opts(cfg, &po);
+        po.width       = vp->cap.width;
+        po.height      = vp->cap.height;
+        po.codec       = encoder_mpp_coding_name(main_lane->codec);
+        po.raw_release = pub_raw_release;
+        po.raw_ctx     = vp;
+        if (shm_pub_open(&vp->pub, &po) != 0) {
+            pipeline_release(vp);
+            return -1;
+        }
+        vp->pub_on = 1;
+    }
+
+    /*
+     * 若配置了 sec 与 fps，则将录制时长转换为目标帧数；0 表示不限制（直到 stop）。
+     * 待机时采集一直运行，时长由调用者按截止时间 stop。
+     */
+    vp->frames_target = (cfg->duration_sec > 0 && cfg->fps > 0 && !cfg->standby)
+                      ? (int)(cfg->duration_sec * (unsigned int)cfg->fps) : 0;
+    media_track_init(&vp->vtrack, (uint32_t)cfg->fps);
+
+    int64_t t_on = media_clock_now_us();
+    if (v4l2_capture_start(&vp->cap) != 0) {
+        pipeline_release(vp);
+        return -1;
+    }
+    vp->startup.streamon_us = media_clock_now_us() - t_on;
+
+    LOGI("[%s] start encode %dx%d@%d, %d stream(s), %u capture buffers, drop policy %s (depth %u), motion %s", TAG,
+         (int)vp->cap.width, (int)vp->cap.height, cfg->fps, vp->nlanes, vp->cap.buf_count,
+         vp_drop_policy_name(vp->drop_policy), vp->drop_depth, motion_mode_name(vp->motion_mode));
+
+    /* 逆序启动：先让各 lane 就绪，再开始出帧。 */
+    for (int l = 0; l < vp->nlanes; l++) {
+        if (lane_start_threads(&vp->lanes[l]) != 0) {
+            pipeline_abort(vp);
+            return -1;
+        }
+    }
+    if (pthread_create(&vp->th_cap, NULL, capture_stage, vp) != 0) {
+        LOGE("[%s] pthread_create capture failed", TAG);
+        pipeline_abort(vp);
+        return -1;
+    }
+
+    vp->threads_started = 1;
+    const VpStartupTiming *t = &vp->startup;
+    vp->startup.total_us = media_clock_now_us() - vp->start_us;
+    LOGI("[%s] startup: capture_open=%.1fms encoder=%.1fms pools=%.1fms sink=%.1fms streamon=%.1fms total=%.1fms%s",
+         TAG, (double)t->capture_open_us / 1000.0, (double)t->encoder_init_us / 1000.0,
+         (double)t->pools_us / 1000.0, (double)t->sink_open_us / 1000.0, (double)t->streamon_us / 1000.0,
+         (double)t->total_us / 1000.0, cfg->standby ? " (standby)" : "");
+    return 0;
+}
+
+/*
+ * 撤下一条 lane 的 sink：清空 out，再等写出线程确认不在使用旧 sink（out_busy 清零）。
+ * 写出线程下一次取 out 时得到 NULL；正在背压等待的写入看到 out 变化后放弃，
+ * 所以等待最多一次写调用加 VP_IDLE_WAIT_MS。返回后旧 sink 可以安全关闭。
+ *
+ * @return 撤下的 sink（可能为 NULL）
+ */
+static EncSink *lane_detach_sink(VpLane *lane)
+{
+    EncSink *out = atomic_exchange(&lane->out, NULL);
+    int64_t t0 = media_clock_now_us();
+    int warned = 0;
+    while (atomic_load(&lane->out_busy)) {
+        if (!warned && ms_since(t0) >= VP_DRAIN_MS) {
+            LOGW("[%s] lane %d: sink write still in progress %d ms after detach, waiting", TAG, lane->id,
+                 VP_DRAIN_MS);
+            warned = 1;
+        }
+        poll(NULL, 0, 1);
+    }
+    return out;
+}
+
+int video_pipeline_record_start(VideoPipeline *vp, EncSink *shared_sink)
+{
+    if (!vp || !vp->threads_started || !vp->cfg->standby || atomic_load(&vp->active)) return -1;
+    const AppConfig *cfg = vp->cfg;
+    VpLane *lane = &vp->lanes[0];
+
+    int64_t t0 = media_clock_now_us();
+    if (shared_sink) {
+        atomic_store(&lane->out, shared_sink);
+    } else {
+        if (lane_open_sink(vp, lane, cfg->sink_type, cfg->output_path_h264) != 0) return -1;
+        atomic_store(&lane->out, &lane->sink);
+    }
+    /* IDR 请求由下一次提交取走：放行之后的第一帧即关键帧（EACH_IDR 模式带 SPS/PPS） */
+    video_pipeline_request_idr(vp, -1);
+    vp->rec_frames0  = lane->frames_written;
+    vp->rec_start_us = t0;
+    vp->arm_us       = t0;
+    atomic_store(&vp->first_key, 1);
+    atomic_store(&vp->active, 1);
+    LOGI("[%s] record start -> %s (sink open %.1f ms)", TAG, sink_target(lane, "-"), ms_since(t0));
+    return 0;
+}
+
+void video_pipeline_record_stop(VideoPipeline *vp)
+{
+    if (!vp || !vp->threads_started || !atomic_load(&vp->active)) return;
+    VpLane *lane = &vp->lanes[0];
+
+    atomic_store(&vp->active, 0);
+    int64_t t0 = media_clock_now_us();
+    while (atomic_load(&vp->frames_pending) > 0) {
+        if (ms_since(t0) >= VP_DRAIN_MS) {
+            LOGW("[%s] record stop: %d frame(s) still in flight after %d ms, detaching sink", TAG,
+                 atomic_load(&vp->frames_pending), VP_DRAIN_MS);
+            break;
+        }
+        poll(NULL, 0, 5);
+    }
+    EncSink *out = lane_detach_sink(lane);
+    LOGI("[%s] record stop -> %s: %.1f s, packets=%d (drain %.1f ms)", TAG, out ? out->target : "-",
+         (double)(t0 - vp->rec_start_us) / 1e6, lane->frames_written - vp->rec_frames0, ms_since(t0));
+    if (out == &lane->sink) enc_sink_close(&lane->sink);
+}
+
+/* 子码流退出时的汇总：包数、平均码率、编码延迟分布 */
+static void lane_report(const VpLane *lane)
+{
+    LatHistSnap enc;
+    lat_hist_drain(&lane->stats->hist[AV_HIST_ENCODE], &enc);
+    double sec  = (double)(media_clock_now_us() - lane->stats->start_us) / 1e6;
+    double kbps = sec > 0 ? (double)lane->bytes_written * 8.0 / 1000.0 / sec : 0.0;
+    LOGI("[%s] lane %d %s %dx%d -> %s: packets=%d bytes=%llu (%.0f kbps) drops=%llu "
+         "encode avg/p99=%.1f/%.1f ms%s%s",
+         TAG, lane->id, encoder_mpp_coding_name(lane->codec), lane->width, lane->height,
+         sink_target(lane, "-"), lane->frames_written,
+         (unsigned long long)lane->bytes_written, kbps,
+         (unsigned long long)atomic_load(&lane->stats->drop_count),
+         enc.count ? (double)enc.sum / (double)enc.count / 1000.0 : 0.0,
+         (double)lat_hist_percentile(&enc, 0.99) / 1000.0,
+         lane->scaled ? " scale=" : "", lane->scaled ? rga_scaler_impl(&lane->rga) : "");
+}
+
+/*
+ * 等待流水线退出：采集线程先停，各 lane 的编码/取包/写出线程排空各自队列后依次退出。
+ */
+void video_pipeline_join(VideoPipeline *vp)
+{
+    if (!vp || !vp->threads_started) return;
+
+    pthread_join(vp->th_cap, NULL);
+    for (int l = 0; l < vp->nlanes; l++) lane_join_threads(&vp->lanes[l]);
+    vp->threads_started = 0;
+
+    LOGI("[%s] done, frames=%d", TAG, vp->frames_captured);
+    for (int l = 1; l < vp->nlanes; l++) lane_report(&vp->lanes[l]);
+
+    pipeline_release(vp);
+}
+
+/* ===================== Runtime control ===================== */
+
+/* lane 范围：-1 为全部，否则为单路；越界时 *end <= *begin */
+static void lane_range(const VideoPipeline *vp, int lane, int *begin, int *end)
+{
+    if (lane < 0) {
+        *begin = 0;
+        *end   = vp->nlanes;
+    } else {
+        *begin = lane;
+        *end   = lane < vp->nlanes ? lane + 1 : lane;
+    }
+}
+
+int video_pipeline_set_bitrate(VideoPipeline *vp, int lane, int bitrate_bps)
+{
+    if (!vp) return -1;
+    int b, e, ret = -1;
+    lane_range(vp, lane, &b, &e);
+    for (int l = b; l < e; l++) {
+        ret = encoder_mpp_set_bitrate(&vp->lanes[l].enc, bitrate_bps);
+        if (ret != 0) break;
+    }
+    return ret;
+}
+
+int video_pipeline_set_fps(VideoPipeline *vp, int lane, int fps)
+{
+    if (!vp) return -1;
+    int b, e, ret = -1;
+    lane_range(vp, lane, &b, &e);
+    for (int l = b; l < e; l++) {
+        ret = encoder_mpp_set_fps(&vp->lanes[l].enc, fps);
+        if (ret != 0) break;
+    }
+    return ret;
+}
+
+int video_pipeline_request_idr(VideoPipeline *vp, int lane)
+{
+    if (!vp) return -1;
+    int b, e, ret = -1;
+    lane_range(vp, lane, &b, &e);
+    for (int l = b; l < e; l++) {
+        ret = encoder_mpp_request_idr(&vp->lanes[l].enc);
+        if (ret != 0) break;
+    }
+    return ret;
+}
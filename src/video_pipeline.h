@@ -0,0 +1,247 @@
+// video_pipeline.h
+#pragma once
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "app_config.h"
+#include "av_stats.h"
+#include "v4l2_capture.h"
+#include "encoder_mpp.h"
+#include "reactor.h"
+#include "media_clock.h"
+#include "motion.h"
+#include "rga_scale.h"
+#include "shm_pub.h"
+#include "sink.h"
+#include "spsc_ring.h"
+#include "vpu_sched.h"
+
+/*
+ * 视频流水线：采集 / 编码提交 / 取包 / 写出 四级，各自一个线程。
+ *
+ *   capture --(V4L2 index)--> encode ==(MPP 异步, N 帧在途)==> packet --(packet slot)--> sink
+ *                                                                ^                       |
+ *                                                                +-----(空闲 slot)--------+
+ *
+ * 级间只传索引，不传像素数据；队列为固定容量的 SPSC 无锁环，
+ * 配一个信号量用于空闲时阻塞等待（避免忙等）。采集线程 poll V4L2 fd，有帧才唤醒。
+ * 编码提交与取包分离，VPU 编码第 N 帧时 CPU 仍可处理第 N-1 帧的 packet；
+ * 写出线程慢（fwrite 抖动）时只会占满 packet slot，不会直接卡住 DQBUF。
+ *
+ * simulcast（--simulcast）：编码 / 取包 / 写出三级组成一条 lane，每路码流一条，
+ * 采集线程把同一个 V4L2 index 分发给所有 lane。采集 buffer 带引用计数，
+ * 全部 lane 用完（拷贝 / 缩放完成，或零拷贝帧的 packet 取出）后才 QBUF：
+ *
+ *   capture --+--> lane 0（主码流：拷贝或零拷贝）
+ *             +--> lane 1..（RGA 缩放进各自的编码器输入池）
+ */
+
+#define VP_PKT_SLOTS 16   // 取包 -> 写出之间最多缓存的 packet 数
+#define VP_MAX_LANES (1 + APP_MAX_SIMULCAST)
+#define VP_ERR_FATAL_MS 2000  // DQBUF 连续出错多久后认为设备已失效
+#define VP_DRAIN_MS     2000  // 停止录制时等待在途帧写出的上限
+#define VP_DROP_DEPTH_DEFAULT 2
+
+/*
+ * 编码跟不上时的丢帧策略（--drop-policy，每条 lane 各自判断，阈值为 --drop-depth）。
+ * 主动丢弃的帧计入 drop 与 v_shed，与驱动丢帧（sequence 跳变）区分；采集结束后不再丢弃。
+ * - NONE：不主动丢帧。队列与采集 buffer 占满后由驱动丢帧（延迟最大可达 buffer 数个帧间隔）
+ * - NEWEST：采集线程分发时，lane 的编码队列里已排着 depth 帧则不再放新帧进去
+ * - OLDEST：编码线程取到一帧时，身后还排着不少于 depth 帧则丢掉这一帧（较旧的），去取下一帧
+ * - LATEST：跳到最新一帧：采集线程一次取空驱动里已就绪的帧、只留最新的一帧（仅设备源），
+ *   编码线程身后有更新的帧时丢掉手上的这一帧
+ */
+typedef enum {
+    VP_DROP_NONE = 0,
+    VP_DROP_NEWEST,
+    VP_DROP_OLDEST,
+    VP_DROP_LATEST,
+} VpDropPolicy;
+
+/* 名字 <-> 枚举（"none" / "newest" / "oldest" / "latest"）。@return 0 成功；-1 未知名字 */
+int         vp_drop_policy_from_name(const char *name, VpDropPolicy *out);
+const char *vp_drop_policy_name(VpDropPolicy policy);
+
+/* 一个预分配的 packet 缓冲（取包线程填充，写出线程消费） */
+typedef struct {
+    uint8_t *data;       // 本次内容：own，或超大帧时借用的 lane->jumbo
+    uint8_t *own;        // slot 自己的缓冲（lane->slot_mem 中的一段）
+    size_t   cap;        // own 的大小
+    size_t   len;
+    int64_t  pts_us;     // 采集 PTS（media_clock_pts）
+    int      keyframe;
+    TsAuPart part;       // --enc-slices：AU 的第几片（整帧为 TS_AU_WHOLE）
+    int      failed;     // 取包线程没能放进 slot（len 为 0）：写出线程把整个 AU 记为一次 drop
+} VpPacketSlot;
+
+/* SPSC 环 + 可读计数信号量 */
+typedef struct {
+    SpscRing ring;
+    sem_t    items;
+} VpQueue;
+
+typedef struct VideoPipeline VideoPipeline;
+
+/* 启动各阶段耗时（微秒，全部 lane 累加），video_pipeline_start 填写并打印一行 [video] startup */
+typedef struct {
+    int64_t capture_open_us;   // S_FMT / REQBUFS / mmap（及 DMABUF 导出）
+    int64_t encoder_init_us;   // mpp_create / mpp_init / 编码器配置 / 输入池 / DMABUF 导入
+    int64_t pools_us;          // packet slot 预分配
+    int64_t sink_open_us;      // 打开输出（--standby 时为 0，每次录制单独计时）
+    int64_t streamon_us;
+    int64_t total_us;
+} VpStartupTiming;
+
+/* 一路编码输出：编码器 + sink + 三级线程 */
+typedef struct {
+    VideoPipeline *vp;
+    int            id;          // 0=主码流
+    AvStats       *stats;       // 主码流为全局统计；子码流为自有统计（退出时汇总打印）
+    int            width;
+    int            height;
+    int            bitrate;
+    MppCodingType  codec;
+    int            zero_copy;   // 直接编码 V4L2 DMABUF（仅主码流）
+    int            scaled;      // 尺寸与采集不同：缩放进编码器输入池
+    RgaScaler      rga;
+
+    EncoderMPP     enc;
+    VpuClient      vpu;         // 多通道共用 VPU 时的在途帧配额（单通道不限制）
+    EncSink        sink;
+    _Atomic(EncSink *) out;     // 实际写出的 sink：&sink，或外部共享的 sink（例如 TS，音视频共用）；待机时为 NULL
+    atomic_int     out_busy;    // 写出线程取到 out 并正在写（撤下 sink 时等它清零，见 lane_detach_sink）
+
+    VpQueue        enc_q;       // 采集 -> 编码：V4L2 buffer index
+    VpQueue        sink_q;      // 取包 -> 写出：packet slot index
+    VpQueue        free_q;      // 写出 -> 取包：空闲 packet slot index
+    VpPacketSlot   slots[VP_PKT_SLOTS];
+    uint8_t       *slot_mem;    // 全部 slot 的缓冲（arena 一块）
+    uint8_t       *jumbo;       // 超过 slot 大小的 packet 借用的缓冲（按原始帧大小，arena），NULL = 不需要
+    size_t         jumbo_cap;
+    VpQueue        jumbo_q;     // jumbo 空闲时里面有一个令牌：取包线程借出，写出线程写完归还
+
+    int64_t        frames_submitted;// 仅编码线程写
+    int            frames_written;  // 仅写出线程写
+    uint64_t       bytes_written;   // 仅写出线程写
+    int            au_failed;       // 仅写出线程：当前分片 AU 已有一片失败（放入或写出），其余片不再写
+
+    atomic_int     encode_done;
+    atomic_int     packet_done;
+
+    pthread_t      th_enc;
+    pthread_t      th_pkt;
+    pthread_t      th_sink;
+    int            threads;         // 已启动的线程数（按 sink、packet、encode 顺序）
+} VpLane;
+
+struct VideoPipeline {
+    const AppConfig       *cfg;
+    AvStats               *stats;
+    volatile sig_atomic_t *stop;
+    Reactor               *reactor;   // 采集线程 poll V4L2 fd + stop eventfd
+    VpuSched              *vpu;       // 多通道共用的 VPU 配额；NULL = 不限制
+
+    V4L2Capture   cap;
+    atomic_int    cap_refs[V4L2_MAX_BUFS];  // 每个采集 buffer 尚未用完的 lane 数（发布原始帧时另加一）
+    VpDropPolicy  drop_policy;
+    unsigned int  drop_depth;
+    MotionMode    motion_mode;
+    MotionDetector motion;         // 仅采集线程访问
+    int           motion_idle;     // 仅采集线程写：上一帧是否处于空闲（rate 模式下即是否已降码率）
+    ShmPub        pub;             // --pub-sock：主码流编码包 + 按 --pub-raw-fps 的原始帧
+    int           pub_on;
+
+    VpLane        lanes[VP_MAX_LANES];
+    int           nlanes;
+
+    int           frames_target;   // 0 = 不限制
+    int           frames_captured; // 仅采集线程写
+    MediaTrack    vtrack;          // 仅采集线程写：视频时间轴偏差/抖动
+    SinkSegmentClock seg_clock;    // 分段录制：主码流发布切分点，单独写的 PCM 跟随
+
+    atomic_int    capture_done;
+    atomic_int    failed;          // 采集设备持续出错，采集线程已放弃（见 video_pipeline_failed）
+
+    /*
+     * --standby：active=0 时采集线程 DQBUF 后立即 QBUF（只做统计），编码器与 sink stage 空闲。
+     * frames_pending 为已分发、尚未写出或丢弃的帧（按 lane 计），停止录制时据此等待排空。
+     */
+    atomic_int    active;
+    atomic_int    frames_pending;
+    int           frames_standby;  // 仅采集线程写：待机时丢弃的帧数
+    int           rec_frames0;     // 本次录制开始时主码流已写出的包数
+    int64_t       rec_start_us;
+    int64_t       start_us;        // video_pipeline_start 开始的时刻
+    int64_t       arm_us;          // 启动或开始录制的时刻：计算第一个 IDR 的写出延迟
+    atomic_int    first_key;       // 1 = 等待主码流写出第一个关键帧
+    VpStartupTiming startup;
+
+    pthread_t     th_cap;
+    int           threads_started;
+};
+
+/*
+ * 打开采集/编码器/sink 并启动四个线程。
+ * stop 置位（并经 reactor 通知）后采集线程停止出队，编码与写出线程把已入队的数据处理完再退出。
+ * shared_sink 非 NULL 时主码流写入该 sink（已打开，由调用者在 join 之后关闭），否则按 cfg 自建 .h264 sink；
+ * 子码流（cfg->simulcast）各自按配置打开 sink。
+ * vpu 非 NULL 时每条 lane 作为一个 client 按配额提交（多通道共用 VPU，见 vpu_sched.h）。
+ * cfg->standby 时主码流不打开 sink（忽略 shared_sink），STREAMON 后待机，由 video_pipeline_record_start 开始写出。
+ */
+int  video_pipeline_start(VideoPipeline *vp, const AppConfig *cfg,
+                          AvStats *stats, volatile sig_atomic_t *stop, Reactor *reactor,
+                          EncSink *shared_sink, VpuSched *vpu);
+
+/*
+ * 采集是否因设备错误结束：DQBUF 持续失败超过 VP_ERR_FATAL_MS（设备拔出、驱动出错）时采集线程退出，
+ * 编码与写出线程照常排空后退出。可在任意线程调用，start 成功之后、join 之前有效。
+ */
+static inline int video_pipeline_failed(VideoPipeline *vp)
+{
+    return atomic_load(&vp->failed);
+}
+
+/* 采集线程是否已结束（到达目标帧数、stop 或设备错误）。 */
+static inline int video_pipeline_capture_done(VideoPipeline *vp)
+{
+    return atomic_load(&vp->capture_done);
+}
+
+/* 等待全部线程退出并释放全部资源。 */
+void video_pipeline_join(VideoPipeline *vp);
+
+/*
+ * --standby（cfg->standby）：开始录制。主码流改写到 shared_sink（NULL 时按 cfg 当前的
+ * output_path_h264 / sink_type 自建 sink，录制结束时关闭），请求 IDR 后放行采集帧，
+ * 所以写出的第一帧即带 SPS/PPS 的关键帧。只能由一个控制线程调用，start 成功之后、join 之前有效。
+ *
+ * @return  0 成功；-1 非待机流水线、已在录制或 sink 打开失败
+ */
+int  video_pipeline_record_start(VideoPipeline *vp, EncSink *shared_sink);
+
+/*
+ * 停止录制：不再放行采集帧，等已分发的帧写出（最多 VP_DRAIN_MS），再撤下主码流的 sink。
+ * 返回时写出线程已确认不再使用旧 sink（超时时正在背压等待的写入会被放弃，不会在关闭后继续写），
+ * 自建的 sink 在这里关闭，shared_sink 由调用者在之后关闭。未在录制时直接返回。
+ */
+void video_pipeline_record_stop(VideoPipeline *vp);
+
+static inline int video_pipeline_recording(VideoPipeline *vp)
+{
+    return atomic_load(&vp->active);
+}
+
+/*
+ * 运行时调整某一路码流（lane 0 为主码流，1.. 为子码流，-1 为全部），见 encoder_mpp_set_bitrate。
+ * 可在任意线程调用，但只能在 start 成功之后、join 之前；新参数从该路的下一帧开始生效。
+ * set_fps 只改编码器的码率分配与 GOP 时长，不改变采集帧率。
+ * @return  0 成功；-1 lane 不存在或参数非法
+ */
+int  video_pipeline_set_bitrate(VideoPipeline *vp, int lane, int bitrate_bps);
+int  video_pipeline_set_fps(VideoPipeline *vp, int lane, int fps);
+int  video_pipeline_request_idr(VideoPipeline *vp, int lane);
@@ -0,0 +1,165 @@
+// vpu_sched.c
+#include "vpu_sched.h"
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+/* 一个排队中的 acquire（在调用者的栈上） */
+struct VpuWaiter {
+    VpuWaiter *next;
+    VpuClient *client;
+    int        granted;
+};
+
+static int64_t mono_now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int vpu_sched_init(VpuSched *s, int slots)
+{
+    if (!s || slots < 1) return -1;
+    memset(s, 0, sizeof(*s));
+    s->slots = slots;
+
+    pthread_condattr_t ca;
+    if (pthread_condattr_init(&ca) != 0) return -1;
+    pthread_condattr_setclock(&ca, CLOCK_MONOTONIC);
+    int ret = pthread_cond_init(&s->cond, &ca);
+    pthread_condattr_destroy(&ca);
+    if (ret != 0) return -1;
+    if (pthread_mutex_init(&s->lock, NULL) != 0) {
+        pthread_cond_destroy(&s->cond);
+        return -1;
+    }
+    return 0;
+}
+
+void vpu_sched_destroy(VpuSched *s)
+{
+    if (!s || !s->slots) return;
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->cond);
+    s->slots = 0;
+}
+
+/* 从队列里摘掉 w（prev 为其前驱，NULL 表示队首）。lock 内调用。 */
+static void unlink_waiter(VpuSched *s, VpuWaiter *w, VpuWaiter *prev)
+{
+    if (prev) prev->next = w->next;
+    else s->head = w->next;
+    if (s->tail == w) s->tail = prev;
+    w->next = NULL;
+}
+
+/*
+ * 把空闲 token 发给排队者：优先持有数低于公平份额的 client（按到达顺序），
+ * 都不低于份额时发给队首。lock 内调用。
+ */
+static void dispatch(VpuSched *s)
+{
+    int granted = 0;
+    while (s->inflight < s->slots && s->head) {
+        int share = s->slots / (s->clients > 0 ? s->clients : 1);
+        if (share < 1) share = 1;
+
+        VpuWaiter *pick = s->head, *pick_prev = NULL;
+        for (VpuWaiter *w = s->head, *prev = NULL; w; prev = w, w = w->next) {
+            if (w->client->held < share) {
+                pick      = w;
+                pick_prev = prev;
+                break;
+            }
+        }
+        unlink_waiter(s, pick, pick_prev);
+        pick->granted = 1;
+        pick->client->held++;
+        s->inflight++;
+        granted = 1;
+    }
+    if (granted) pthread_cond_broadcast(&s->cond);
+}
+
+void vpu_client_attach(VpuClient *c, VpuSched *sched)
+{
+    if (!c) return;
+    memset(c, 0, sizeof(*c));
+    c->sched = sched;
+    if (!sched) return;
+    pthread_mutex_lock(&sched->lock);
+    sched->clients++;
+    pthread_mutex_unlock(&sched->lock);
+}
+
+void vpu_client_detach(VpuClient *c)
+{
+    if (!c || !c->sched) return;
+    VpuSched *s = c->sched;
+    pthread_mutex_lock(&s->lock);
+    s->inflight -= c->held;
+    c->held = 0;
+    s->clients--;
+    dispatch(s);
+    pthread_mutex_unlock(&s->lock);
+    c->sched = NULL;
+}
+
+int vpu_client_acquire(VpuClient *c, int timeout_ms)
+{
+    if (!c || !c->sched) return 0;
+    VpuSched *s = c->sched;
+
+    pthread_mutex_lock(&s->lock);
+    if (!s->head && s->inflight < s->slots) {
+        s->inflight++;
+        c->held++;
+        pthread_mutex_unlock(&s->lock);
+        return 0;
+    }
+
+    /* 排队：挂到队尾，等 release 时由 dispatch 发放 */
+    VpuWaiter w = { .next = NULL, .client = c, .granted = 0 };
+    if (s->tail) s->tail->next = &w;
+    else s->head = &w;
+    s->tail = &w;
+    c->waits++;
+
+    int64_t t0 = mono_now_us();
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec  += timeout_ms / 1000;
+    ts.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    while (!w.granted) {
+        if (pthread_cond_timedwait(&s->cond, &s->lock, &ts) == ETIMEDOUT) break;
+    }
+    c->wait_us += (uint64_t)(mono_now_us() - t0);
+
+    int ret = 0;
+    if (!w.granted) {
+        VpuWaiter *prev = NULL;
+        for (VpuWaiter *p = s->head; p && p != &w; p = p->next) prev = p;
+        unlink_waiter(s, &w, prev);
+        ret = 1;
+    }
+    pthread_mutex_unlock(&s->lock);
+    return ret;
+}
+
+void vpu_client_release(VpuClient *c, int n)
+{
+    if (!c || !c->sched || n <= 0) return;
+    VpuSched *s = c->sched;
+    pthread_mutex_lock(&s->lock);
+    if (n > c->held) n = c->held;
+    c->held     -= n;
+    s->inflight -= n;
+    dispatch(s);
+    pthread_mutex_unlock(&s->lock);
+}
@@ -0,0 +1,63 @@
+// vpu_sched.h
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 多路共用 VPU 时的在途帧配额（--channels）。
+ *
+ * 每条编码 lane 是一个 client：提交一帧之前取一个 token，取到该帧的 packet 后归还。
+ * token 总数 slots 即全部通道同时压在 VPU 上的帧数上限；
+ * - 有空闲 token 且没有排队者时立即取得，不加等待；
+ * - token 用完时按到达顺序排队，归还时优先发给持有数低于公平份额（slots / client 数，至少 1）的 client，
+ *   全部排队者都超出份额时才按先来先得，所以高帧率的通道不能把 VPU 占满、饿死别的通道，
+ *   同时闲置的份额照样可以被别的通道用掉（不浪费 VPU）。
+ *
+ * 单通道运行时不使用（VpuClient.sched == NULL，acquire 直接成功）。
+ */
+typedef struct VpuWaiter VpuWaiter;
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+    int             slots;      // token 总数
+    int             inflight;   // 已发出的 token
+    int             clients;    // 已注册的 client 数
+    VpuWaiter      *head;       // 排队者（FIFO）
+    VpuWaiter      *tail;
+} VpuSched;
+
+typedef struct {
+    VpuSched *sched;            // NULL = 不限制
+    int       held;             // 当前持有的 token（lock 保护）
+    uint64_t  waits;            // 需要排队的次数
+    uint64_t  wait_us;          // 累计排队时间
+} VpuClient;
+
+/* @return 0 成功；-1 参数非法或初始化失败 */
+int  vpu_sched_init(VpuSched *s, int slots);
+void vpu_sched_destroy(VpuSched *s);
+
+/* 注册 / 注销一个 client（sched 可为 NULL，此时 client 不受限制）。注销时归还仍持有的 token。 */
+void vpu_client_attach(VpuClient *c, VpuSched *sched);
+void vpu_client_detach(VpuClient *c);
+
+/*
+ * 取一个 token（编码线程，提交前调用）。
+ *
+ * @param timeout_ms  最长排队时间
+ * @return            0 取得；1 超时（调用者检查退出条件后重试）
+ */
+int  vpu_client_acquire(VpuClient *c, int timeout_ms);
+
+/* 归还 n 个 token（取包线程，取到 packet 后调用；提交失败时编码线程调用）。超出持有数的部分忽略。 */
+void vpu_client_release(VpuClient *c, int n);
+
+#ifdef __cplusplus
+}
+#endif
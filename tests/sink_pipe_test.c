@@ -0,0 +1,185 @@
+// tests/sink_pipe_test.c
+/*
+ * sink_pipe 发送队列的丢 GOP 行为（不启动 ffmpeg 与发送线程，直接驱动队列）：
+ *   straddle : 分片 AU 跨两个发送批次，其余片连同夹在中间的音频必须保留，丢弃从下一个 AU 开始
+ *   pending  : 已送出前几片、结尾片还没入队时什么都不丢，后续片照常入队
+ *   latency  : 延迟预算触发的丢弃跳过已部分送出的 AU，且不会空转
+ *   whole    : 批次停在 AU 边界时照旧从队首丢到下一个关键帧
+ *
+ * 用法：sink_pipe_test（make test 构建并运行），全部通过时返回 0
+ */
+#include "../src/sink_pipe.c"
+
+#include <stdio.h>
+
+#define TEST_QUEUE_BYTES (256u << 10)
+
+static int g_failed;
+
+#define CHECK(cond)                                                              \
+    do {                                                                         \
+        if (!(cond)) {                                                           \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            g_failed = 1;                                                        \
+        }                                                                        \
+    } while (0)
+
+static uint8_t      g_data[TEST_QUEUE_BYTES];
+static SinkPipeUnit g_units[SINK_PIPE_MAX_UNITS];
+static uint8_t      g_payload[1024];
+
+/* 只初始化队列部分：fd / 线程不使用，sink_pipe_write 只入队 */
+static void queue_init(SinkPipe *p)
+{
+    memset(p, 0, sizeof(*p));
+    p->fd  = -1;
+    p->pid = -1;
+    sink_pipe_default_opts(&p->opts);
+    p->opts.max_latency_ms = 60000;
+    p->cap   = TEST_QUEUE_BYTES;
+    p->data  = g_data;
+    p->units = g_units;
+    pthread_mutex_init(&p->lock, NULL);
+    pthread_cond_init(&p->cond, NULL);
+}
+
+static void queue_deinit(SinkPipe *p)
+{
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->lock);
+}
+
+static void put_video(SinkPipe *p, int keyframe, TsAuPart part, int64_t pts)
+{
+    CHECK(sink_pipe_write(p, g_payload, 100, 0, pts, keyframe, part) == 0);
+}
+
+static void put_audio(SinkPipe *p, int64_t pts)
+{
+    CHECK(sink_pipe_write(p, g_payload, 100, 1, pts, 0, TS_AU_WHOLE) == 0);
+}
+
+/* 模拟发送线程送完一个批次（内容不封装） */
+static void send_batch(SinkPipe *p)
+{
+    pipe_take_batch(p);
+    p->inflight = 0;
+    pipe_reclaim(p);
+}
+
+static const SinkPipeUnit *unit_at(const SinkPipe *p, uint32_t k)
+{
+    return &p->units[(p->u_tail + k) % SINK_PIPE_MAX_UNITS];
+}
+
+static uint32_t queued(const SinkPipe *p)
+{
+    return p->u_head - p->u_tail;
+}
+
+static void test_straddle(void)
+{
+    SinkPipe p;
+    queue_init(&p);
+    int64_t t = now_pts_us();
+
+    put_video(&p, 1, TS_AU_FIRST, t);
+    send_batch(&p);
+    CHECK(p.tx_open_au == 1);
+
+    put_video(&p, 1, TS_AU_MID, t);
+    put_audio(&p, t);
+    put_video(&p, 1, TS_AU_LAST, t);
+    put_video(&p, 0, TS_AU_WHOLE, t + 33000);
+    put_video(&p, 1, TS_AU_WHOLE, t + 66000);
+
+    CHECK(pipe_drop_gop(&p) == 1);
+    CHECK(queued(&p) == 4);
+    CHECK(!unit_at(&p, 0)->audio && unit_at(&p, 0)->part == TS_AU_MID);
+    CHECK(unit_at(&p, 1)->audio);
+    CHECK(!unit_at(&p, 2)->audio && unit_at(&p, 2)->part == TS_AU_LAST);
+    CHECK(unit_is_key_start(unit_at(&p, 3)));
+    CHECK(p.wait_key == 0);
+    CHECK(p.d_tail == unit_at(&p, 0)->off);
+
+    /* 其余片与关键帧一起送出，AU 闭合 */
+    send_batch(&p);
+    CHECK(p.tx_open_au == 0);
+    CHECK(queued(&p) == 0);
+    queue_deinit(&p);
+}
+
+static void test_pending(void)
+{
+    SinkPipe p;
+    queue_init(&p);
+    int64_t t = now_pts_us();
+
+    put_video(&p, 1, TS_AU_FIRST, t);
+    send_batch(&p);
+    put_audio(&p, t);
+
+    CHECK(pipe_drop_gop(&p) == 0);
+    CHECK(queued(&p) == 1);
+    CHECK(p.wait_key == 0);
+
+    put_video(&p, 1, TS_AU_LAST, t);
+    CHECK(queued(&p) == 2);
+    CHECK(unit_at(&p, 1)->part == TS_AU_LAST);
+    queue_deinit(&p);
+}
+
+static void test_latency(void)
+{
+    SinkPipe p;
+    queue_init(&p);
+    p.opts.max_latency_ms = 200;
+    int64_t old = now_pts_us() - 10 * 1000000LL;
+
+    put_video(&p, 1, TS_AU_FIRST, old);
+    send_batch(&p);
+    put_video(&p, 1, TS_AU_LAST, old);
+    put_video(&p, 0, TS_AU_WHOLE, old + 33000);
+
+    /* 新的关键帧入队时两个旧单元都已超时：只丢 P 帧，结尾片保留 */
+    put_video(&p, 1, TS_AU_WHOLE, now_pts_us());
+    CHECK(queued(&p) == 2);
+    CHECK(unit_at(&p, 0)->part == TS_AU_LAST);
+    CHECK(unit_is_key_start(unit_at(&p, 1)));
+    CHECK(p.dropped_units == 1);
+    queue_deinit(&p);
+}
+
+static void test_whole(void)
+{
+    SinkPipe p;
+    queue_init(&p);
+    int64_t t = now_pts_us();
+
+    put_video(&p, 1, TS_AU_WHOLE, t);
+    send_batch(&p);
+    CHECK(p.tx_open_au == 0);
+
+    put_video(&p, 0, TS_AU_WHOLE, t + 33000);
+    put_audio(&p, t + 33000);
+    put_video(&p, 1, TS_AU_WHOLE, t + 66000);
+
+    CHECK(pipe_drop_gop(&p) == 2);
+    CHECK(queued(&p) == 1);
+    CHECK(unit_is_key_start(unit_at(&p, 0)));
+
+    CHECK(pipe_drop_gop(&p) == 1);
+    CHECK(queued(&p) == 0);
+    CHECK(p.wait_key == 1);
+    queue_deinit(&p);
+}
+
+int main(void)
+{
+    test_straddle();
+    test_pending();
+    test_latency();
+    test_whole();
+    printf("sink_pipe_test: %s\n", g_failed ? "FAILED" : "ok");
+    return g_failed;
+}